@@ -7,6 +7,14 @@ include $(CLEAR_VARS)
 LOCAL_SRC_FILES := \
         util/QCameraCmdThread.cpp \
         util/QCameraQueue.cpp \
+        util/QCameraJobPool.cpp \
+        util/QCameraFrameTiming.cpp \
+        util/QCameraLatencyStats.cpp \
+        util/QCameraPerfGovernor.cpp \
+        util/QCameraFormatConverter.cpp \
+        util/QCameraSceneDetector.cpp \
+        util/QCameraFramePacer.cpp \
+        util/QCameraCallbackMemoryRing.cpp \
         QCamera2Hal.cpp \
         QCamera2Factory.cpp
 
@@ -27,6 +35,7 @@ LOCAL_SRC_FILES += \
         HAL/QCameraChannel.cpp \
         HAL/QCameraStream.cpp \
         HAL/QCameraPostProc.cpp \
+        HAL/QCameraExif.cpp \
         HAL/QCamera2HWICallbacks.cpp \
         HAL/QCameraParameters.cpp \
         HAL/QCameraThermalAdapter.cpp
@@ -546,6 +546,16 @@ void QCamera2HardwareInterface::release_recording_frame(
         ALOGE("NULL camera device");
         return;
     }
+
+    // while recording, hand the frame straight back to the video stream
+    pthread_mutex_lock(&hw->m_recFrameLock);
+    if (hw->m_bRecFrameFastRelease) {
+        hw->releaseRecordingFrame(opaque);
+        pthread_mutex_unlock(&hw->m_recFrameLock);
+        return;
+    }
+    pthread_mutex_unlock(&hw->m_recFrameLock);
+
     CDBG_HIGH("%s: E", __func__);
     hw->lockAPI();
     qcamera_api_result_t apiResult;
@@ -1072,6 +1082,7 @@ QCamera2HardwareInterface::QCamera2HardwareInterface(int cameraId)
       m_pPowerModule(NULL),
       mDumpFrmCnt(0),
       mDumpSkipCnt(0),
+      m_pExifTemplate(NULL),
       mThermalLevel(QCAMERA_THERMAL_NO_ADJUSTMENT),
       mCancelAutoFocus(false),
       m_HDRSceneEnabled(false),
@@ -1087,7 +1098,21 @@ QCamera2HardwareInterface::QCamera2HardwareInterface(int cameraId)
       mPostviewJob(-1),
       mMetadataJob(-1),
       mReprocJob(-1),
-      mRawdataJob(-1)
+      mRawdataJob(-1),
+      m_fdResultRing("face detection"),
+      m_bPreviewConvEnabled(true),
+      m_previewCbRing("preview callback"),
+      m_nPreviewConvDrops(0),
+      m_nSceneDetectMode(1),
+      m_nSceneBudgetUs(QCAMERA_SCENE_BUDGET_US),
+      m_sceneDetectQ(releaseSceneDetectJob, this),
+      m_nSceneDetectDrops(0),
+      m_bPreviewPacing(false),
+      m_nDisplayDequeueFails(0),
+      m_nPaceEarly(0),
+      m_nPerfLastFrameIdx(0),
+      m_nPerfSampleFrames(0),
+      m_nPerfDroppedFrames(0)
 {
     getLogLevel();
     ATRACE_CALL();
@@ -1108,6 +1133,11 @@ QCamera2HardwareInterface::QCamera2HardwareInterface(int cameraId)
 
     pthread_mutex_init(&m_parm_lock, NULL);
 
+    pthread_mutex_init(&m_recFrameLock, NULL);
+    m_bRecFrameFastRelease = false;
+
+    pthread_mutex_init(&m_perfLock, NULL);
+
     memset(m_channels, 0, sizeof(m_channels));
 
 #ifdef HAS_MULTIMEDIA_HINTS
@@ -1120,6 +1150,10 @@ QCamera2HardwareInterface::QCamera2HardwareInterface(int cameraId)
 
     mDefferedWorkThread.launch(defferedWorkRoutine, this);
     mDefferedWorkThread.sendCmd(CAMERA_CMD_TYPE_START_DATA_PROC, FALSE, FALSE);
+
+    m_previewConvTh.launch(previewConvRoutine, this);
+    m_sceneDetectTh.launch(sceneDetectRoutine, this);
+    m_previewPaceTh.launch(previewPaceRoutine, this);
 }
 
 /*===========================================================================
@@ -1136,12 +1170,27 @@ QCamera2HardwareInterface::~QCamera2HardwareInterface()
     mDefferedWorkThread.sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, TRUE, TRUE);
     mDefferedWorkThread.exit();
 
+    m_previewConvTh.sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, TRUE, TRUE);
+    m_previewConvTh.exit();
+
+    m_sceneDetectTh.sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, TRUE, TRUE);
+    m_sceneDetectTh.exit();
+
+    m_previewPaceTh.sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, TRUE, TRUE);
+    m_previewPaceTh.exit();
+
     closeCamera();
+    if (m_pExifTemplate != NULL) {
+        delete m_pExifTemplate;
+        m_pExifTemplate = NULL;
+    }
     pthread_mutex_destroy(&m_lock);
     pthread_cond_destroy(&m_cond);
     pthread_mutex_destroy(&m_evtLock);
     pthread_cond_destroy(&m_evtCond);
     pthread_mutex_destroy(&m_parm_lock);
+    pthread_mutex_destroy(&m_recFrameLock);
+    pthread_mutex_destroy(&m_perfLock);
 }
 
 /*===========================================================================
@@ -1226,7 +1275,7 @@ int QCamera2HardwareInterface::openCamera()
       }
     }
 
-    int32_t rc = m_postprocessor.init(jpegEvtHandle, this);
+    int32_t rc = m_postprocessor.init(jpegEvtHandle, jpegChunkHandle, this);
     if (rc != 0) {
         ALOGE("Init Postprocessor failed");
         mCameraHandle->ops->close_camera(mCameraHandle->camera_handle);
@@ -1249,6 +1298,35 @@ int QCamera2HardwareInterface::openCamera()
 
     mParameters.init(gCamCaps[mCameraId], mCameraHandle, this, this);
 
+    char value[PROPERTY_VALUE_MAX];
+    // off by default: platform thermal levels are applied as they come,
+    // set to 1 to let the pipeline load raise them
+    property_get("persist.camera.perf.governor", value, "0");
+    pthread_mutex_lock(&m_perfLock);
+    m_perfGovernor.reset(systemTime());
+    m_perfGovernor.setEnabled(atoi(value) > 0);
+    m_nPerfLastFrameIdx = 0;
+    m_nPerfSampleFrames = 0;
+    m_nPerfDroppedFrames = 0;
+    pthread_mutex_unlock(&m_perfLock);
+
+    property_get("persist.camera.preview.cb.conv", value, "1");
+    m_bPreviewConvEnabled = atoi(value) > 0;
+
+    property_get("persist.camera.scene.detect", value, "1");
+    m_nSceneDetectMode = atoi(value);
+    property_get("persist.camera.scene.budget", value, "0");
+    if (atoi(value) > 0) {
+        m_sceneDetector.setBudget((uint32_t)atoi(value));
+    }
+    property_get("persist.camera.scene.budget_us", value, "2000");
+    m_nSceneBudgetUs = atoi(value);
+
+    property_get("persist.camera.preview.pacing", value, "0");
+    m_bPreviewPacing = atoi(value) > 0;
+    property_get("persist.camera.preview.pacing.latency_ms", value, "0");
+    m_previewPacer.setLatency(atoi(value) * 1000000LL);
+
     mCameraOpened = true;
 
     return NO_ERROR;
@@ -1287,6 +1365,10 @@ int QCamera2HardwareInterface::closeCamera()
     // exit notifier
     m_cbNotifier.exit();
 
+    // all pending callbacks are flushed, release the result buffers
+    m_fdResultRing.clear();
+    m_previewCbRing.clear();
+
     // stop and deinit postprocessor
     m_postprocessor.stop();
     m_postprocessor.deinit();
@@ -1304,6 +1386,10 @@ int QCamera2HardwareInterface::closeCamera()
 
     m_thermalAdapter.deinit();
 
+    pthread_mutex_lock(&m_recFrameLock);
+    m_bRecFrameFastRelease = false;
+    pthread_mutex_unlock(&m_recFrameLock);
+
     // delete all channels if not already deleted
     for (i = 0; i < QCAMERA_CH_TYPE_MAX; i++) {
         if (m_channels[i] != NULL) {
@@ -2059,6 +2145,18 @@ int QCamera2HardwareInterface::startPreview()
     ATRACE_CALL();
     int32_t rc = NO_ERROR;
     CDBG_HIGH("%s: E", __func__);
+    m_previewConvTime.reset();
+    m_nPreviewConvDrops = 0;
+    m_previewConvTh.sendCmd(CAMERA_CMD_TYPE_START_DATA_PROC, FALSE, FALSE);
+    m_sceneDetector.reset();
+    m_sceneDetectTime.reset();
+    m_nSceneDetectDrops = 0;
+    m_sceneDetectTh.sendCmd(CAMERA_CMD_TYPE_START_DATA_PROC, FALSE, FALSE);
+    m_previewPacer.reset();
+    m_displayQueued.reset();
+    m_nDisplayDequeueFails = 0;
+    m_nPaceEarly = 0;
+
     // start preview stream
     if (mParameters.isZSLMode() && mParameters.getRecordingHintValue() !=true) {
         rc = startChannel(QCAMERA_CH_TYPE_ZSL);
@@ -2093,9 +2191,49 @@ int QCamera2HardwareInterface::stopPreview()
 {
     ATRACE_CALL();
     CDBG_HIGH("%s: E", __func__);
+    // pending conversions read from the preview buffers
+    m_previewConvTh.sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, TRUE, TRUE);
+    if (m_previewConvTime.getCount() > 0) {
+        CDBG_HIGH("[KPI Perf] %s: preview callback conversion %d frames, "
+            "p50 %lld us, p99 %lld us, max %lld us, %d dropped",
+            __func__, m_previewConvTime.getCount(),
+            m_previewConvTime.getPercentile(50),
+            m_previewConvTime.getPercentile(99),
+            m_previewConvTime.getMax(), m_nPreviewConvDrops);
+    }
+    // held zsl frames go back to the channel before it stops
+    m_sceneDetectTh.sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, TRUE, TRUE);
+    if (m_sceneDetectTime.getCount() > 0) {
+        CDBG_HIGH("[KPI Perf] %s: scene detection %d frames, p50 %lld us, "
+            "p99 %lld us, max %lld us, %d skipped, budget %u pixels, "
+            "last scene %s", __func__, m_sceneDetectTime.getCount(),
+            m_sceneDetectTime.getPercentile(50),
+            m_sceneDetectTime.getPercentile(99),
+            m_sceneDetectTime.getMax(), m_nSceneDetectDrops,
+            m_sceneDetector.getBudget(),
+            QCameraSceneDetector::getSceneName(m_sceneDetector.getScene()));
+    }
+
     // stop preview stream
     stopChannel(QCAMERA_CH_TYPE_ZSL);
     stopChannel(QCAMERA_CH_TYPE_PREVIEW);
+    if (m_previewPacer.getDisplayJitter().getCount() > 0) {
+        CDBG_HIGH("[KPI Perf] %s: preview display %s, %d frames, interval "
+            "jitter on arrival p50 %lld us, p95 %lld us, p99 %lld us, on display "
+            "p50 %lld us, p95 %lld us, p99 %lld us, %d late, %d early, window "
+            "queue p50 %lld max %lld, %d dequeue failures", __func__,
+            m_bPreviewPacing ? "paced" : "on arrival",
+            m_previewPacer.getDisplayJitter().getCount(),
+            m_previewPacer.getArrivalJitter().getPercentile(50),
+            m_previewPacer.getArrivalJitter().getPercentile(95),
+            m_previewPacer.getArrivalJitter().getPercentile(99),
+            m_previewPacer.getDisplayJitter().getPercentile(50),
+            m_previewPacer.getDisplayJitter().getPercentile(95),
+            m_previewPacer.getDisplayJitter().getPercentile(99),
+            m_previewPacer.getLateFrames(), m_nPaceEarly,
+            m_displayQueued.getPercentile(50), m_displayQueued.getMax(),
+            m_nDisplayDequeueFails);
+    }
 
     // delete all channels from preparePreview
     unpreparePreview();
@@ -2152,6 +2290,12 @@ int QCamera2HardwareInterface::startRecording()
         rc = startChannel(QCAMERA_CH_TYPE_VIDEO);
     }
 
+    if (rc == NO_ERROR) {
+        pthread_mutex_lock(&m_recFrameLock);
+        m_bRecFrameFastRelease = true;
+        pthread_mutex_unlock(&m_recFrameLock);
+    }
+
 #ifdef HAS_MULTIMEDIA_HINTS
     if (rc == NO_ERROR) {
         if (m_pPowerModule) {
@@ -2178,6 +2322,11 @@ int QCamera2HardwareInterface::startRecording()
  *==========================================================================*/
 int QCamera2HardwareInterface::stopRecording()
 {
+    // wait for fast releases in progress before the channel goes away
+    pthread_mutex_lock(&m_recFrameLock);
+    m_bRecFrameFastRelease = false;
+    pthread_mutex_unlock(&m_recFrameLock);
+
     int rc = stopChannel(QCAMERA_CH_TYPE_VIDEO);
     CDBG_HIGH("%s: E", __func__);
 #ifdef HAS_MULTIMEDIA_HINTS
@@ -2208,7 +2357,7 @@ int QCamera2HardwareInterface::releaseRecordingFrame(const void * opaque)
     int32_t rc = UNKNOWN_ERROR;
     QCameraVideoChannel *pChannel =
         (QCameraVideoChannel *)m_channels[QCAMERA_CH_TYPE_VIDEO];
-    CDBG_HIGH("%s: opaque data = %p", __func__,opaque);
+    CDBG("%s: opaque data = %p", __func__,opaque);
     if(pChannel != NULL) {
         rc = pChannel->releaseFrame(opaque, mStoreMetaDataInFrame > 0);
     }
@@ -2667,7 +2816,13 @@ int QCamera2HardwareInterface::takePicture()
                         mCameraHandle->camera_handle,
                         pZSLChannel->getMyHandle());
             }
-            rc = pZSLChannel->takePicture(numSnapshots, numRetroSnapshots);
+            if (mLongshotEnabled && (numRetroSnapshots == 0)) {
+                // longshot frames are requested against the pipeline credits
+                rc = m_postprocessor.requestCaptureFrames(pZSLChannel,
+                        numSnapshots);
+            } else {
+                rc = pZSLChannel->takePicture(numSnapshots, numRetroSnapshots);
+            }
             if (rc != NO_ERROR) {
                 ALOGE("%s: cannot take ZSL picture, stop pproc", __func__);
                 m_postprocessor.stop();
@@ -2848,7 +3003,8 @@ int32_t QCamera2HardwareInterface::declareSnapshotStreams()
  * FUNCTION   : longShot
  *
  * DESCRIPTION: Queue one more ZSL frame
- *              in the longshot pipe.
+ *              in the longshot pipe. The frame is requested once the
+ *              postprocessor has a capture credit for it.
  *
  * PARAMETERS : none
  *
@@ -2869,7 +3025,7 @@ int32_t QCamera2HardwareInterface::longShot()
     }
 
     if (NULL != pChannel) {
-        rc = pChannel->takePicture(numSnapshots, 0);
+        rc = m_postprocessor.requestCaptureFrames(pChannel, numSnapshots);
     } else {
         ALOGE(" %s : Capture channel not initialized!", __func__);
         rc = NO_INIT;
@@ -3328,6 +3484,56 @@ int QCamera2HardwareInterface::dump(int fd)
     fdprintf(fd, "StoreMetaDataInFrame: %d \n", mStoreMetaDataInFrame);
     fdprintf(fd, "\n Configuration: %s", mParameters.dump().string());
     fdprintf(fd, "\n State Information: %s", m_stateMachine.dump().string());
+    QCameraChannel *pChannel = m_channels[QCAMERA_CH_TYPE_VIDEO];
+    if (pChannel != NULL) {
+        for (int i = 0; i < pChannel->getNumOfStreams(); i++) {
+            QCameraStream *pStream = pChannel->getStreamByIndex(i);
+            if (pStream != NULL && pStream->isTypeOf(CAM_STREAM_TYPE_VIDEO) &&
+                pStream->getStreamBufs() != NULL) {
+                QCameraVideoMemory *pVideoMem =
+                    (QCameraVideoMemory *)pStream->getStreamBufs();
+                fdprintf(fd, "\n Video Encoder Return Latency: %s",
+                    pVideoMem->dumpReturnLatency().string());
+            }
+        }
+    }
+    pthread_mutex_lock(&m_perfLock);
+    nsecs_t now = systemTime();
+    fdprintf(fd, "\n Perf Governor: %s, level %s, load %d%%, thermal %d, "
+        "transitions %d\n",
+        m_perfGovernor.isEnabled() ? "on" : "off",
+        QCameraPerfGovernor::getLevelName(m_perfGovernor.getLevel()),
+        m_perfGovernor.getLoad(), m_perfGovernor.getPlatformThermalLevel(),
+        m_perfGovernor.getTransitions());
+    for (int i = 0; i < QCAMERA_PERF_LEVEL_MAX; i++) {
+        fdprintf(fd, "   %s: %lld ms\n", QCameraPerfGovernor::getLevelName(i),
+            m_perfGovernor.getTimeInLevel(i, now) / 1000000LL);
+    }
+    pthread_mutex_unlock(&m_perfLock);
+    fdprintf(fd, "\n Preview Callback Conversion: %d frames, p50 %lld us, "
+        "p99 %lld us, max %lld us, %d dropped\n",
+        m_previewConvTime.getCount(), m_previewConvTime.getPercentile(50),
+        m_previewConvTime.getPercentile(99), m_previewConvTime.getMax(),
+        m_nPreviewConvDrops);
+    fdprintf(fd, "\n Scene Detection: %d frames, p50 %lld us, p99 %lld us, "
+        "max %lld us, %d skipped, budget %u pixels, scene %s\n",
+        m_sceneDetectTime.getCount(), m_sceneDetectTime.getPercentile(50),
+        m_sceneDetectTime.getPercentile(99), m_sceneDetectTime.getMax(),
+        m_nSceneDetectDrops, m_sceneDetector.getBudget(),
+        QCameraSceneDetector::getSceneName(m_sceneDetector.getScene()));
+    fdprintf(fd, "\n Preview Display (%s): interval jitter on arrival p50 %lld us, "
+        "p95 %lld us, p99 %lld us, on display p50 %lld us, p95 %lld us, "
+        "p99 %lld us, %d late, %d early, window queue p50 %lld max %lld, "
+        "%d dequeue failures\n", m_bPreviewPacing ? "paced" : "on arrival",
+        m_previewPacer.getArrivalJitter().getPercentile(50),
+        m_previewPacer.getArrivalJitter().getPercentile(95),
+        m_previewPacer.getArrivalJitter().getPercentile(99),
+        m_previewPacer.getDisplayJitter().getPercentile(50),
+        m_previewPacer.getDisplayJitter().getPercentile(95),
+        m_previewPacer.getDisplayJitter().getPercentile(99),
+        m_previewPacer.getLateFrames(), m_nPaceEarly,
+        m_displayQueued.getPercentile(50), m_displayQueued.getMax(),
+        m_nDisplayDequeueFails);
     fdprintf(fd, "\n Camera HAL information End \n");
     return NO_ERROR;
 }
@@ -3467,6 +3673,36 @@ void QCamera2HardwareInterface::jpegEvtHandle(jpeg_job_status_t status,
     }
 }
 
+/*===========================================================================
+ * FUNCTION   : jpegChunkHandle
+ *
+ * DESCRIPTION: callback function for partial output of a streaming jpeg
+ *              encode. Chunks are handed to postprocessor directly, since
+ *              they only feed the save thread and never change state.
+ *
+ * PARAMETERS :
+ *   @client_hdl : client handle from jpeg-interface
+ *   @jobId      : job Id of the jpeg encoding
+ *   @p_chunk    : ptr to the new bytes of the jpeg output
+ *   @offset     : file offset of the chunk
+ *   @userdata   : user data ptr
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCamera2HardwareInterface::jpegChunkHandle(uint32_t /*client_hdl*/,
+                                                uint32_t jobId,
+                                                mm_jpeg_output_t *p_chunk,
+                                                uint32_t offset,
+                                                void *userdata)
+{
+    QCamera2HardwareInterface *obj = (QCamera2HardwareInterface *)userdata;
+    if (obj && p_chunk) {
+        obj->m_postprocessor.processJpegChunk(jobId, p_chunk, offset);
+    } else {
+        ALOGE("%s: NULL user_data or chunk", __func__);
+    }
+}
+
 /*===========================================================================
  * FUNCTION   : thermalEvtHandle
  *
@@ -3492,6 +3728,11 @@ int QCamera2HardwareInterface::thermalEvtHandle(
     // Make sure thermal events are logged
     CDBG_HIGH("%s: level = %d, userdata = %p, data = %p",
         __func__, level, userdata, data);
+    // record the level right away so that a load triggered update queued
+    // behind this event can not bring back the previous platform level
+    pthread_mutex_lock(&m_perfLock);
+    m_perfGovernor.setThermalLevel(level, systemTime());
+    pthread_mutex_unlock(&m_perfLock);
     //We don't need to lockAPI, waitAPI here. QCAMERA_SM_EVT_THERMAL_NOTIFY
     // becomes an aync call. This also means we can only pass payload
     // by value, not by address.
@@ -4217,8 +4458,7 @@ int32_t QCamera2HardwareInterface::addSnapshotChannel()
 
     if (m_channels[QCAMERA_CH_TYPE_SNAPSHOT] != NULL) {
         // if we had ZSL channel before, delete it first
-        delete m_channels[QCAMERA_CH_TYPE_SNAPSHOT];
-        m_channels[QCAMERA_CH_TYPE_SNAPSHOT] = NULL;
+        delChannel(QCAMERA_CH_TYPE_SNAPSHOT);
     }
 
     pChannel = new QCameraChannel(mCameraHandle->camera_handle,
@@ -4326,8 +4566,7 @@ int32_t QCamera2HardwareInterface::addZSLChannel()
 
     if (m_channels[QCAMERA_CH_TYPE_ZSL] != NULL) {
         // if we had ZSL channel before, delete it first
-        delete m_channels[QCAMERA_CH_TYPE_ZSL];
-        m_channels[QCAMERA_CH_TYPE_ZSL] = NULL;
+        delChannel(QCAMERA_CH_TYPE_ZSL);
     }
 
      if (m_channels[QCAMERA_CH_TYPE_PREVIEW] != NULL) {
@@ -4354,6 +4593,7 @@ int32_t QCamera2HardwareInterface::addZSLChannel()
     attr.post_frame_skip = mParameters.getZSLBurstInterval();
     attr.water_mark = mParameters.getZSLQueueDepth();
     attr.max_unmatched_frames = mParameters.getMaxUnmatchedFramesInQueue();
+    attr.best_frame_window = mParameters.getZSLBestFrameWindow();
     rc = pChannel->init(&attr,
                         zsl_channel_cb,
                         this);
@@ -4433,8 +4673,7 @@ int32_t QCamera2HardwareInterface::addCaptureChannel()
     bool raw_yuv = false;
 
     if (m_channels[QCAMERA_CH_TYPE_CAPTURE] != NULL) {
-        delete m_channels[QCAMERA_CH_TYPE_CAPTURE];
-        m_channels[QCAMERA_CH_TYPE_CAPTURE] = NULL;
+        delChannel(QCAMERA_CH_TYPE_CAPTURE);
     }
 
     pChannel = new QCameraPicChannel(mCameraHandle->camera_handle,
@@ -4616,6 +4855,12 @@ QCameraReprocessChannel *QCamera2HardwareInterface::addReprocChannel(
     CDBG_HIGH("%s: Before pproc config check, ret = %x", __func__,
             gCamCaps[mCameraId]->min_required_pp_mask);
 
+    // optional features are skipped while the perf governor sheds load
+    bool ppReduced = isPerfPPReduced();
+    if (ppReduced) {
+        CDBG_HIGH("%s: perf governor reduced pp, skip WNR/CAC", __func__);
+    }
+
     // pp feature config
     cam_pp_feature_config_t pp_config;
     memset(&pp_config, 0, sizeof(cam_pp_feature_config_t));
@@ -4639,14 +4884,14 @@ QCameraReprocessChannel *QCamera2HardwareInterface::addReprocChannel(
             pp_config.feature_mask |= CAM_QCOM_FEATURE_CROP;
         }
 
-        if (mParameters.isWNREnabled()) {
+        if (mParameters.isWNREnabled() && !ppReduced) {
             pp_config.feature_mask |= CAM_QCOM_FEATURE_DENOISE2D;
             pp_config.denoise2d.denoise_enable = 1;
             pp_config.denoise2d.process_plates = mParameters.getWaveletDenoiseProcessPlate();
         }
     }
 
-    if (isCACEnabled()) {
+    if (isCACEnabled() && !ppReduced) {
         pp_config.feature_mask |= CAM_QCOM_FEATURE_CAC;
     }
 
@@ -4875,6 +5120,12 @@ int32_t QCamera2HardwareInterface::delChannel(qcamera_ch_type_enum_t ch_type,
                                               bool destroy)
 {
     if (m_channels[ch_type] != NULL) {
+        // jpeg sessions kept warm may be bound to its snapshot buffers
+        if ((QCAMERA_CH_TYPE_ZSL == ch_type) ||
+                (QCAMERA_CH_TYPE_CAPTURE == ch_type) ||
+                (QCAMERA_CH_TYPE_SNAPSHOT == ch_type)) {
+            m_postprocessor.invalidateJpegSessionCache();
+        }
         if (destroy) {
             delete m_channels[ch_type];
             m_channels[ch_type] = NULL;
@@ -4902,6 +5153,10 @@ int32_t QCamera2HardwareInterface::startChannel(qcamera_ch_type_enum_t ch_type)
 {
     int32_t rc = UNKNOWN_ERROR;
     if (m_channels[ch_type] != NULL) {
+        if ((QCAMERA_CH_TYPE_ZSL == ch_type) ||
+                (QCAMERA_CH_TYPE_PREVIEW == ch_type)) {
+            m_previewPaceTh.sendCmd(CAMERA_CMD_TYPE_START_DATA_PROC, FALSE, FALSE);
+        }
         rc = m_channels[ch_type]->config();
         if (NO_ERROR == rc) {
             rc = m_channels[ch_type]->start();
@@ -4928,6 +5183,11 @@ int32_t QCamera2HardwareInterface::stopChannel(qcamera_ch_type_enum_t ch_type)
     int32_t rc = UNKNOWN_ERROR;
     if (m_channels[ch_type] != NULL) {
         rc = m_channels[ch_type]->stop();
+        if ((QCAMERA_CH_TYPE_ZSL == ch_type) ||
+                (QCAMERA_CH_TYPE_PREVIEW == ch_type)) {
+            // preview frames still waiting for display are dropped
+            m_previewPaceTh.sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, TRUE, TRUE);
+        }
     }
 
     return rc;
@@ -5124,10 +5384,19 @@ int32_t QCamera2HardwareInterface::processFaceDetectionResult(cam_face_detection
                        + data_len;         //data
     }
 
-    camera_memory_t *faceResultBuffer = mGetMemory(-1,
-                                                   faceResultSize,
-                                                   1,
-                                                   mCallbackCookie);
+    // preview results come with every frame and have a fixed size,
+    // take them from the ring instead of allocating
+    camera_memory_t *faceResultBuffer = NULL;
+    if (fd_type == QCAMERA_FD_PREVIEW) {
+        faceResultBuffer = m_fdResultRing.get(mGetMemory,
+                                              faceResultSize,
+                                              mCallbackCookie);
+    } else {
+        faceResultBuffer = mGetMemory(-1,
+                                      faceResultSize,
+                                      1,
+                                      mCallbackCookie);
+    }
     if ( NULL == faceResultBuffer ) {
         ALOGE("%s: Not enough memory for face result data",
               __func__);
@@ -5249,12 +5518,17 @@ int32_t QCamera2HardwareInterface::processFaceDetectionResult(cam_face_detection
     cbArg.data = faceResultBuffer;
     cbArg.metadata = roiData;
     cbArg.user_data = faceResultBuffer;
-    cbArg.cookie = this;
-    cbArg.release_cb = releaseCameraMemory;
+    if(fd_type == QCAMERA_FD_PREVIEW){
+        cbArg.cookie = &m_fdResultRing;
+        cbArg.release_cb = QCameraCallbackMemoryRing::releaseCallback;
+    } else {
+        cbArg.cookie = this;
+        cbArg.release_cb = releaseCameraMemory;
+    }
     int32_t rc = m_cbNotifier.notifyCallback(cbArg);
     if (rc != NO_ERROR) {
         ALOGE("%s: fail sending notification", __func__);
-        faceResultBuffer->release(faceResultBuffer);
+        cbArg.release_cb(cbArg.user_data, cbArg.cookie, rc);
     }
 
     return rc;
@@ -5325,6 +5599,9 @@ int32_t QCamera2HardwareInterface::processHistogramStats(cam_hist_stats_t &stats
         return NO_ERROR;
     }
 
+    // a fresh buffer per frame: the client gets the histogram by reference
+    // and may still read it after the release callback, so it cannot be
+    // recycled like the face detection results
     camera_memory_t *histBuffer = mGetMemory(-1,
                                              sizeof(cam_histogram_data_t),
                                              1,
@@ -5338,6 +5615,7 @@ int32_t QCamera2HardwareInterface::processHistogramStats(cam_hist_stats_t &stats
     cam_histogram_data_t *pHistData = (cam_histogram_data_t *)histBuffer->data;
     if (pHistData == NULL) {
         ALOGE("%s: memory data ptr is NULL", __func__);
+        histBuffer->release(histBuffer);
         return UNKNOWN_ERROR;
     }
 
@@ -5556,6 +5834,12 @@ int QCamera2HardwareInterface::updateThermalLevel(
         return NO_ERROR;
     }
 
+    // the platform level was recorded by thermalEvtHandle, apply the
+    // governor level that also accounts for the pipeline load
+    pthread_mutex_lock(&m_perfLock);
+    level = (qcamera_thermal_level_enum_t)m_perfGovernor.getThermalLevel();
+    pthread_mutex_unlock(&m_perfLock);
+
     mParameters.getPreviewFpsRange(&minFPS, &maxFPS);
     qcamera_thermal_mode thermalMode = mParameters.getThermalMode();
     calcThermalLevel(level, minFPS, maxFPS, adjustedRange, skipPattern);
@@ -5574,6 +5858,95 @@ int QCamera2HardwareInterface::updateThermalLevel(
 
 }
 
+/*===========================================================================
+ * FUNCTION   : samplePerfLoad
+ *
+ * DESCRIPTION: account one metadata frame and, every
+ *              QCAMERA_PERF_SAMPLE_FRAMES frames, feed the postproc, jpeg
+ *              and callback backlogs plus the dropped frames to the perf
+ *              governor. A level change re-runs the thermal adjustment on
+ *              the state machine thread.
+ *
+ * PARAMETERS :
+ *   @frameIdx : frame idx of the metadata frame
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCamera2HardwareInterface::samplePerfLoad(uint32_t frameIdx)
+{
+    bool changed = false;
+    int thermalLevel = QCAMERA_THERMAL_NO_ADJUSTMENT;
+
+    pthread_mutex_lock(&m_perfLock);
+    if (!m_perfGovernor.isEnabled()) {
+        pthread_mutex_unlock(&m_perfLock);
+        return;
+    }
+
+    // gaps are only counted as drops while no fps/frame skip adjustment
+    // is applied, otherwise the skipped frames would keep the load high
+    if (m_nPerfLastFrameIdx > 0 && frameIdx > m_nPerfLastFrameIdx + 1 &&
+            m_perfGovernor.getThermalLevel() == QCAMERA_THERMAL_NO_ADJUSTMENT) {
+        uint32_t dropped = frameIdx - m_nPerfLastFrameIdx - 1;
+        m_nPerfDroppedFrames += dropped;
+        m_nPerfSampleFrames += dropped;
+    }
+    m_nPerfLastFrameIdx = frameIdx;
+    m_nPerfSampleFrames++;
+
+    if (m_nPerfSampleFrames >= QCAMERA_PERF_SAMPLE_FRAMES) {
+        qcamera_perf_load_t load;
+        load.jpegBacklog = m_postprocessor.getJpegBacklog();
+        load.ppBacklog = m_postprocessor.getPPBacklog();
+        load.cbBacklog = m_cbNotifier.getQueueDepth();
+        load.framesDropped = m_nPerfDroppedFrames;
+        load.framesTotal = m_nPerfSampleFrames;
+        m_nPerfSampleFrames = 0;
+        m_nPerfDroppedFrames = 0;
+
+        // same line format as the traces replayed by qcamera-perf-sim
+        nsecs_t now = systemTime();
+        CDBG("%s: perf_trace: %lld %d %d %d %d %d %d", __func__,
+            now / 1000000LL, m_perfGovernor.getPlatformThermalLevel(),
+            load.jpegBacklog, load.ppBacklog, load.cbBacklog,
+            load.framesDropped, load.framesTotal);
+        changed = m_perfGovernor.updateLoad(load, now);
+        thermalLevel = m_perfGovernor.getPlatformThermalLevel();
+        if (changed) {
+            CDBG_HIGH("%s: perf level %s, load %d%% (jpeg %d pp %d cb %d drop %d/%d)",
+                __func__,
+                QCameraPerfGovernor::getLevelName(m_perfGovernor.getLevel()),
+                m_perfGovernor.getLoad(), load.jpegBacklog, load.ppBacklog,
+                load.cbBacklog, load.framesDropped, load.framesTotal);
+        }
+    }
+    pthread_mutex_unlock(&m_perfLock);
+
+    if (changed) {
+        // async like thermalEvtHandle, payload is passed by value
+        processAPI(QCAMERA_SM_EVT_THERMAL_NOTIFY, (void *)thermalLevel);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : isPerfPPReduced
+ *
+ * DESCRIPTION: whether the perf governor currently sheds optional
+ *              reprocess features (WNR, CAC)
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : true -- skip optional features; false -- otherwise
+ *==========================================================================*/
+bool QCamera2HardwareInterface::isPerfPPReduced()
+{
+    bool reduced;
+    pthread_mutex_lock(&m_perfLock);
+    reduced = m_perfGovernor.isPPReduced();
+    pthread_mutex_unlock(&m_perfLock);
+    return reduced;
+}
+
 /*===========================================================================
  * FUNCTION   : updateParameters
  *
@@ -5765,8 +6138,9 @@ bool QCamera2HardwareInterface::needReprocess()
     }
 
     if (isZSLMode()) {
-        if (((gCamCaps[mCameraId]->min_required_pp_mask > 0) ||
-             mParameters.isWNREnabled() || isCACEnabled())) {
+        if ((gCamCaps[mCameraId]->min_required_pp_mask > 0) ||
+            ((mParameters.isWNREnabled() || isCACEnabled()) &&
+             !isPerfPPReduced())) {
             // TODO: add for ZSL HDR later
             CDBG_HIGH("%s: need do reprocess for ZSL WNR or min PP reprocess", __func__);
             pthread_mutex_unlock(&m_parm_lock);
@@ -5904,6 +6278,9 @@ int QCamera2HardwareInterface::getJpegQuality()
     int quality = 0;
     pthread_mutex_lock(&m_parm_lock);
     quality =  mParameters.getJpegQuality();
+    pthread_mutex_lock(&m_perfLock);
+    quality = m_perfGovernor.adjustJpegQuality(quality);
+    pthread_mutex_unlock(&m_perfLock);
     pthread_mutex_unlock(&m_parm_lock);
     return quality;
 }
@@ -5947,17 +6324,25 @@ void QCamera2HardwareInterface::getOrientation() {
  *==========================================================================*/
 QCameraExif *QCamera2HardwareInterface::getExifData()
 {
-    QCameraExif *exif = new QCameraExif();
-    if (exif == NULL) {
-        ALOGE("%s: No memory for QCameraExif", __func__);
-        return NULL;
-    }
-
+    nsecs_t startTime = systemTime();
     int32_t rc = NO_ERROR;
     uint32_t count = 0;
 
     pthread_mutex_lock(&m_parm_lock);
 
+    QCameraExif *exif = NULL;
+    QCameraExif *exifTemplate = getExifTemplate();
+    if (exifTemplate != NULL) {
+        exif = new QCameraExif(*exifTemplate);
+    } else {
+        exif = new QCameraExif();
+    }
+    if (exif == NULL) {
+        ALOGE("%s: No memory for QCameraExif", __func__);
+        pthread_mutex_unlock(&m_parm_lock);
+        return NULL;
+    }
+
     // add exif entries
     char dateTime[20];
     memset(dateTime, 0, sizeof(dateTime));
@@ -6068,6 +6453,38 @@ QCameraExif *QCamera2HardwareInterface::getExifData()
         ALOGE("%s: getExifGpsDataTimeStamp failed", __func__);
     }
 
+    pthread_mutex_unlock(&m_parm_lock);
+
+    CDBG_HIGH("[KPI Perf] %s: %d exif entries prepared in %lld us",
+              __func__, exif->getNumOfEntries(),
+              (systemTime() - startTime) / 1000LL);
+    return exif;
+}
+
+/*===========================================================================
+ * FUNCTION   : getExifTemplate
+ *
+ * DESCRIPTION: get exif object holding the tags that do not change between
+ *              shots. It is built on first use and cloned by getExifData,
+ *              so per shot only the dynamic tags need to be filled in.
+ *              Caller must hold m_parm_lock.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : exif template, NULL if no memory
+ *==========================================================================*/
+QCameraExif *QCamera2HardwareInterface::getExifTemplate()
+{
+    if (m_pExifTemplate != NULL) {
+        return m_pExifTemplate;
+    }
+
+    QCameraExif *exif = new QCameraExif();
+    if (exif == NULL) {
+        ALOGE("%s: No memory for QCameraExif", __func__);
+        return NULL;
+    }
+
     char value[PROPERTY_VALUE_MAX];
     if (property_get("ro.product.manufacturer", value, "QCOM-AA") > 0) {
         exif->addEntry(EXIFTAGID_MAKE,
@@ -6087,8 +6504,8 @@ QCameraExif *QCamera2HardwareInterface::getExifData()
         ALOGE("%s: getExifModel failed", __func__);
     }
 
-    pthread_mutex_unlock(&m_parm_lock);
-    return exif;
+    m_pExifTemplate = exif;
+    return m_pExifTemplate;
 }
 
 /*===========================================================================
@@ -46,6 +46,12 @@
 #include "QCameraPostProc.h"
 #include "QCameraThermalAdapter.h"
 #include "QCameraMem.h"
+#include "QCameraPerfGovernor.h"
+#include "QCameraFormatConverter.h"
+#include "QCameraSceneDetector.h"
+#include "QCameraFramePacer.h"
+#include "QCameraLatencyStats.h"
+#include "QCameraCallbackMemoryRing.h"
 
 extern "C" {
 #include <mm_camera_interface.h>
@@ -125,6 +131,10 @@ typedef struct {
 #define QCAMERA_ION_USE_CACHE   true
 #define QCAMERA_ION_USE_NOCACHE false
 #define MAX_ONGOING_JOBS 25
+#define QCAMERA_PERF_SAMPLE_FRAMES 15 // metadata frames per perf load sample
+#define QCAMERA_PREVIEW_CONV_MAX_PENDING 2 // preview callback conversions queued
+#define QCAMERA_SCENE_BUDGET_US 2000 // scene detection time per frame, usec
+#define QCAMERA_PREVIEW_PACE_MIN_KERNEL_BUFS 2 // preview buffers kept for the sensor
 
 extern volatile uint32_t gCamHalLogLevel;
 
@@ -153,6 +163,31 @@ typedef struct {
     camera_release_callback  release_cb; // release callback
 } qcamera_callback_argm_t;
 
+typedef struct {
+    int32_t buf_idx;                    // preview buffer index
+    const uint8_t *src;                 // preview buffer
+    qcamera_yuv_layout_t srcLayout;     // layout of the preview stream
+    qcamera_yuv_layout_t dstLayout;     // layout apps expect
+} qcamera_preview_conv_job_t;
+
+typedef struct {
+    QCameraChannel *channel;            // zsl channel
+    mm_camera_super_buf_t *frame;       // zsl super buffer, held until done
+    QCameraStream *previewStream;       // preview stream
+    mm_camera_buf_def_t *previewFrame;  // preview buffer in the super buffer
+    const uint32_t *hist;               // luma histogram in the metadata, or NULL
+    int32_t num_faces;                  // faces in the metadata
+} qcamera_scene_detect_job_t;
+
+typedef struct {
+    QCameraStream *stream;              // preview stream
+    QCameraGrallocMemory *memory;       // preview buffers
+    int32_t buf_idx;                    // preview buffer index
+    uint32_t frame_idx;                 // frame index
+    int64_t sensorTs;                   // sensor timestamp, nsec
+    int64_t arrival;                    // time the frame was delivered, nsec
+} qcamera_preview_pace_job_t;
+
 class QCameraCbNotifier {
 public:
     QCameraCbNotifier(QCamera2HardwareInterface *parent) :
@@ -174,6 +209,7 @@ public:
     virtual int32_t startSnapshots();
     virtual void stopSnapshots();
     virtual void exit();
+    inline uint32_t getQueueDepth() {return mDataQ.getCurrentSize();}
     static void * cbNotifyRoutine(void * data);
     static void releaseNotifications(void *data, void *user_data);
     static bool matchSnapshotNotifications(void *data, void *user_data);
@@ -324,6 +360,8 @@ private:
                 cam_fps_range_t &adjustedRange,
                 enum msm_vfe_frame_skip_pattern &skipPattern);
     int updateThermalLevel(qcamera_thermal_level_enum_t level);
+    void samplePerfLoad(uint32_t frameIdx);
+    bool isPerfPPReduced();
 
     // update entris to set parameters and check if restart is needed
     int updateParameters(const char *parms, bool &needRestart);
@@ -357,6 +395,7 @@ private:
     inline bool getCancelAutoFocus(){ return mCancelAutoFocus; }
     inline void setCancelAutoFocus(bool flag){ mCancelAutoFocus = flag; }
     QCameraExif *getExifData();
+    QCameraExif *getExifTemplate();
 
     int32_t processAutoFocusEvent(cam_auto_focus_data_t &focus_data);
     int32_t processZoomEvent(cam_crop_data_t &crop_info);
@@ -374,8 +413,20 @@ private:
 
     int32_t sendPreviewCallback(QCameraStream *stream,
             QCameraGrallocMemory *memory, int32_t idx);
+    void displayPreviewFrame(qcamera_preview_pace_job_t *job);
+    static void *previewPaceRoutine(void *obj);
+    bool getPreviewCbLayouts(QCameraStream *stream,
+            qcamera_yuv_layout_t &srcLayout, qcamera_yuv_layout_t &dstLayout);
+    int32_t convertPreviewCallback(qcamera_preview_conv_job_t *job);
+    static void *previewConvRoutine(void *obj);
     int32_t selectScene(QCameraChannel *pChannel,
             mm_camera_super_buf_t *recvd_frame);
+    int32_t queueSceneDetect(QCameraChannel *pChannel,
+            mm_camera_super_buf_t *frame, QCameraStream *previewStream,
+            mm_camera_buf_def_t *previewFrame, metadata_buffer_t *pMetaData);
+    int32_t detectScene(qcamera_scene_detect_job_t *job);
+    static void *sceneDetectRoutine(void *obj);
+    static void releaseSceneDetectJob(void *data, void *user_data);
 
     int32_t addChannel(qcamera_ch_type_enum_t ch_type);
     int32_t startChannel(qcamera_ch_type_enum_t ch_type);
@@ -449,6 +500,11 @@ private:
                               uint32_t jobId,
                               mm_jpeg_output_t *p_buf,
                               void *userdata);
+    static void jpegChunkHandle(uint32_t client_hdl,
+                                uint32_t jobId,
+                                mm_jpeg_output_t *p_chunk,
+                                uint32_t offset,
+                                void *userdata);
 
     static void *evtNotifyRoutine(void *data);
 
@@ -532,6 +588,11 @@ private:
 
     pthread_mutex_t m_parm_lock;
 
+    // guards the video channel for recording frames released without
+    // going through the state machine
+    pthread_mutex_t m_recFrameLock;
+    bool m_bRecFrameFastRelease;
+
     QCameraChannel *m_channels[QCAMERA_CH_TYPE_MAX]; // array holding channel ptr
 
     bool m_bShutterSoundPlayed;         // if shutter sound had been played
@@ -554,6 +615,7 @@ private:
     int mDumpFrmCnt;  // frame dump count
     int mDumpSkipCnt; // frame skip count
     mm_jpeg_exif_params_t mExifParams;
+    QCameraExif *m_pExifTemplate; // static exif tags, cloned per shot
     qcamera_thermal_level_enum_t mThermalLevel;
     bool mCancelAutoFocus;
     bool m_HDRSceneEnabled;
@@ -619,6 +681,47 @@ private:
     int32_t mReprocJob;
     int32_t mRawdataJob;
     int32_t mOutputCount;
+
+    // recycled buffers of preview face detection results, the faces are
+    // copied into the metadata parcel before the release callback
+    QCameraCallbackMemoryRing m_fdResultRing;
+
+    // preview callbacks whose layout differs from the preview stream are
+    // converted on their own thread into recycled buffers
+    bool m_bPreviewConvEnabled;
+    QCameraCmdThread m_previewConvTh;
+    QCameraQueue m_previewConvQ;
+    QCameraCallbackMemoryRing m_previewCbRing;
+    QCameraLatencyStats m_previewConvTime;  // conversion time per frame, usec
+    uint32_t m_nPreviewConvDrops;           // frames dropped, conversion busy
+
+    // software scene detection for scene selection, for sensors whose
+    // backend reports no current scene. Runs off the zsl callback thread
+    // on one held zsl frame at a time.
+    int32_t m_nSceneDetectMode;             // 0 off, 1 no backend scene, 2 always
+    int64_t m_nSceneBudgetUs;               // time allowed per frame, usec
+    QCameraCmdThread m_sceneDetectTh;
+    QCameraQueue m_sceneDetectQ;
+    QCameraSceneDetector m_sceneDetector;
+    QCameraLatencyStats m_sceneDetectTime;  // detection time per frame, usec
+    uint32_t m_nSceneDetectDrops;           // frames skipped, detection busy
+
+    // optional preview display pacing: frames wait in a jitter buffer and
+    // are displayed on the cadence of their sensor timestamps
+    bool m_bPreviewPacing;
+    QCameraCmdThread m_previewPaceTh;
+    QCameraQueue m_previewPaceQ;
+    QCameraFramePacer m_previewPacer;       // only used by the displaying thread
+    QCameraLatencyStats m_displayQueued;    // buffers held by the window
+    uint32_t m_nDisplayDequeueFails;        // no buffer back from the window
+    uint32_t m_nPaceEarly;                  // frames displayed early for the sensor
+
+    // closed loop perf governor, fed by thermal events and metadata callbacks
+    pthread_mutex_t m_perfLock;
+    QCameraPerfGovernor m_perfGovernor;
+    uint32_t m_nPerfLastFrameIdx;   // last metadata frame idx seen, 0 if none
+    uint32_t m_nPerfSampleFrames;   // frames expected since the last load sample
+    uint32_t m_nPerfDroppedFrames;  // frames dropped since the last load sample
 };
 
 }; // namespace qcamera
@@ -81,8 +81,8 @@ void QCamera2HardwareInterface::zsl_channel_cb(mm_camera_super_buf_t *recvd_fram
 
     if(pme->mParameters.isSceneSelectionEnabled() &&
             !pme->m_stateMachine.isCaptureRunning()) {
+        // frame is released by selectScene
         pme->selectScene(pChannel, recvd_frame);
-        pChannel->bufDone(recvd_frame);
         return;
     }
 
@@ -262,11 +262,15 @@ void QCamera2HardwareInterface::zsl_channel_cb(mm_camera_super_buf_t *recvd_fram
 /*===========================================================================
  * FUNCTION   : selectScene
  *
- * DESCRIPTION: send a preview callback when a specific selected scene is applied
+ * DESCRIPTION: send a preview callback when a specific selected scene is applied.
+ *              Without a current scene from the backend, or when forced by
+ *              persist.camera.scene.detect=2, the frame goes to software
+ *              scene detection instead.
  *
  * PARAMETERS :
  *   @pChannel: Camera channel
- *   @frame   : Bundled super buffer
+ *   @frame   : Bundled super buffer, released to the channel here or once
+ *              scene detection is done with it
  *
  * RETURN     : int32_t type of status
  *              NO_ERROR  -- success
@@ -276,7 +280,9 @@ int32_t QCamera2HardwareInterface::selectScene(QCameraChannel *pChannel,
         mm_camera_super_buf_t *frame)
 {
     mm_camera_buf_def_t *pMetaFrame = NULL;
+    mm_camera_buf_def_t *preview_frame = NULL;
     QCameraStream *pStream = NULL;
+    QCameraStream *pPreviewStream = NULL;
     cam_scene_mode_type *scene = NULL;
     cam_scene_mode_type selectedScene = CAM_SCENE_MODE_MAX;
     int32_t rc = NO_ERROR;
@@ -289,6 +295,7 @@ int32_t QCamera2HardwareInterface::selectScene(QCameraChannel *pChannel,
     selectedScene = mParameters.getSelectedScene();
     if (CAM_SCENE_MODE_MAX == selectedScene) {
         ALOGV("%s: No selected scene", __func__);
+        pChannel->bufDone(frame);
         return NO_ERROR;
     }
 
@@ -297,13 +304,16 @@ int32_t QCamera2HardwareInterface::selectScene(QCameraChannel *pChannel,
         if(pStream != NULL){
             if(pStream->isTypeOf(CAM_STREAM_TYPE_METADATA)){
                 pMetaFrame = frame->bufs[i];
-                break;
+            } else if(pStream->isTypeOf(CAM_STREAM_TYPE_PREVIEW)){
+                preview_frame = frame->bufs[i];
+                pPreviewStream = pStream;
             }
         }
     }
 
     if (NULL == pMetaFrame) {
         ALOGE("%s: No metadata buffer found in scene select super buffer", __func__);
+        pChannel->bufDone(frame);
         return NO_INIT;
     }
 
@@ -313,28 +323,25 @@ int32_t QCamera2HardwareInterface::selectScene(QCameraChannel *pChannel,
                 POINTER_OF_META(CAM_INTF_META_CURRENT_SCENE, pMetaData);
     }
 
+    if ((m_nSceneDetectMode > 1) ||
+            ((NULL == scene) && (m_nSceneDetectMode > 0))) {
+        return queueSceneDetect(pChannel, frame, pPreviewStream,
+                preview_frame, pMetaData);
+    }
+
     if (NULL == scene) {
         ALOGE("%s: No current scene metadata!", __func__);
+        pChannel->bufDone(frame);
         return NO_INIT;
     }
 
     if ((*scene == selectedScene) &&
             (mDataCb != NULL) &&
             (msgTypeEnabledWithLock(CAMERA_MSG_PREVIEW_FRAME) > 0)) {
-        mm_camera_buf_def_t *preview_frame = NULL;
-        for(int i = 0; i < frame->num_bufs; i++){
-            pStream = pChannel->getStreamByHandle(frame->bufs[i]->stream_id);
-            if(pStream != NULL){
-                if(pStream->isTypeOf(CAM_STREAM_TYPE_PREVIEW)){
-                    preview_frame = frame->bufs[i];
-                    break;
-                }
-            }
-        }
         if (preview_frame) {
             QCameraGrallocMemory *memory = (QCameraGrallocMemory *)preview_frame->mem_info;
             int32_t idx = preview_frame->buf_idx;
-            rc = sendPreviewCallback(pStream, memory, idx);
+            rc = sendPreviewCallback(pPreviewStream, memory, idx);
             if (NO_ERROR != rc) {
                 ALOGE("%s: Error triggering scene select preview callback", __func__);
             } else {
@@ -342,13 +349,261 @@ int32_t QCamera2HardwareInterface::selectScene(QCameraChannel *pChannel,
             }
         } else {
             ALOGE("%s: No preview buffer found in scene select super buffer", __func__);
-            return NO_INIT;
+            rc = NO_INIT;
+        }
+    }
+
+    pChannel->bufDone(frame);
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : queueSceneDetect
+ *
+ * DESCRIPTION: hand a zsl frame to the scene detection thread. Only one
+ *              frame waits at a time, frames arriving while detection is
+ *              busy go straight back to the channel.
+ *
+ * PARAMETERS :
+ *   @pChannel     : zsl channel
+ *   @frame        : zsl super buffer
+ *   @previewStream: preview stream of the super buffer
+ *   @previewFrame : preview buffer of the super buffer
+ *   @pMetaData    : metadata of the super buffer
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCamera2HardwareInterface::queueSceneDetect(QCameraChannel *pChannel,
+        mm_camera_super_buf_t *frame, QCameraStream *previewStream,
+        mm_camera_buf_def_t *previewFrame, metadata_buffer_t *pMetaData)
+{
+    if ((NULL == previewStream) || (NULL == previewFrame)) {
+        ALOGE("%s: No preview buffer found in scene select super buffer", __func__);
+        pChannel->bufDone(frame);
+        return NO_INIT;
+    }
+
+    if (!m_sceneDetectQ.isEmpty()) {
+        CDBG("%s: scene detection busy, skipping frame", __func__);
+        m_nSceneDetectDrops++;
+        pChannel->bufDone(frame);
+        return NO_ERROR;
+    }
+
+    qcamera_scene_detect_job_t *job =
+        (qcamera_scene_detect_job_t *)malloc(sizeof(qcamera_scene_detect_job_t));
+    mm_camera_super_buf_t *held =
+        (mm_camera_super_buf_t *)malloc(sizeof(mm_camera_super_buf_t));
+    if ((NULL == job) || (NULL == held)) {
+        ALOGE("%s: no mem for scene detection job", __func__);
+        free(job);
+        free(held);
+        pChannel->bufDone(frame);
+        return NO_MEMORY;
+    }
+    *held = *frame;
+
+    memset(job, 0, sizeof(qcamera_scene_detect_job_t));
+    job->channel = pChannel;
+    job->frame = held;
+    job->previewStream = previewStream;
+    job->previewFrame = previewFrame;
+    if (IS_META_AVAILABLE(CAM_INTF_META_HISTOGRAM, pMetaData)) {
+        cam_hist_stats_t *stats_data = (cam_hist_stats_t *)
+            POINTER_OF_META(CAM_INTF_META_HISTOGRAM, pMetaData);
+        // green is the closest bayer channel to luma
+        job->hist = (CAM_HISTOGRAM_TYPE_YUV == stats_data->type) ?
+            stats_data->yuv_stats.hist_buf :
+            stats_data->bayer_stats.gr_stats.hist_buf;
+    }
+    if (IS_META_AVAILABLE(CAM_INTF_META_FACE_DETECTION, pMetaData)) {
+        cam_face_detection_data_t *faces_data = (cam_face_detection_data_t *)
+            POINTER_OF_META(CAM_INTF_META_FACE_DETECTION, pMetaData);
+        if (faces_data->num_faces_detected <= MAX_ROI) {
+            job->num_faces = faces_data->num_faces_detected;
+        }
+    }
+
+    m_sceneDetectQ.enqueue((void *)job);
+    m_sceneDetectTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : detectScene
+ *
+ * DESCRIPTION: run software scene detection on a held zsl frame and send
+ *              the scene selection preview callback once the selected
+ *              scene is detected. Only called from the scene detection
+ *              thread.
+ *
+ * PARAMETERS :
+ *   @job     : scene detection job
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCamera2HardwareInterface::detectScene(qcamera_scene_detect_job_t *job)
+{
+    static const cam_scene_mode_type kSceneModes[QCAMERA_SCENE_MAX] = {
+        CAM_SCENE_MODE_AUTO,            // QCAMERA_SCENE_AUTO
+        CAM_SCENE_MODE_NIGHT,           // QCAMERA_SCENE_NIGHT
+        CAM_SCENE_MODE_NIGHT_PORTRAIT,  // QCAMERA_SCENE_NIGHT_PORTRAIT
+        CAM_SCENE_MODE_BACKLIGHT,       // QCAMERA_SCENE_BACKLIGHT
+        CAM_SCENE_MODE_PORTRAIT,        // QCAMERA_SCENE_PORTRAIT
+        CAM_SCENE_MODE_SNOW,            // QCAMERA_SCENE_SNOW
+        CAM_SCENE_MODE_LANDSCAPE,       // QCAMERA_SCENE_LANDSCAPE
+    };
+    cam_dimension_t dim;
+    cam_frame_len_offset_t offset;
+    qcamera_scene_frame_t sceneFrame;
+    int32_t rc = NO_ERROR;
+
+    job->previewStream->getFrameDimension(dim);
+    memset(&offset, 0, sizeof(cam_frame_len_offset_t));
+    job->previewStream->getFrameOffset(offset);
+    job->previewStream->invalidateBuf(job->previewFrame->buf_idx);
+
+    sceneFrame.luma = (const uint8_t *)job->previewFrame->buffer + offset.mp[0].offset;
+    sceneFrame.width = dim.width;
+    sceneFrame.height = dim.height;
+    sceneFrame.stride = offset.mp[0].stride;
+    sceneFrame.hist = job->hist;
+    sceneFrame.num_faces = job->num_faces;
+
+    nsecs_t start = systemTime();
+    qcamera_scene_t detected = m_sceneDetector.process(sceneFrame);
+    int64_t detectTime = (systemTime() - start) / 1000;
+    m_sceneDetectTime.add(detectTime);
+    if (m_sceneDetector.updateBudget(detectTime, m_nSceneBudgetUs)) {
+        CDBG_HIGH("%s: %lld us per frame, budget now %u pixels", __func__,
+            detectTime, m_sceneDetector.getBudget());
+    }
+    CDBG("%s: frame %d scene %s, %u pixels in %lld us", __func__,
+        job->previewFrame->frame_idx,
+        QCameraSceneDetector::getSceneName(detected),
+        m_sceneDetector.getStats().samples, detectTime);
+
+    cam_scene_mode_type selectedScene = mParameters.getSelectedScene();
+    if ((CAM_SCENE_MODE_MAX == selectedScene) ||
+            (kSceneModes[detected] != selectedScene)) {
+        return NO_ERROR;
+    }
+
+    if ((mDataCb != NULL) &&
+            (msgTypeEnabledWithLock(CAMERA_MSG_PREVIEW_FRAME) > 0)) {
+        QCameraGrallocMemory *memory =
+            (QCameraGrallocMemory *)job->previewFrame->mem_info;
+        rc = sendPreviewCallback(job->previewStream, memory,
+                job->previewFrame->buf_idx);
+        if (NO_ERROR != rc) {
+            ALOGE("%s: Error triggering scene select preview callback", __func__);
+        } else {
+            CDBG_HIGH("%s: selected scene %s detected", __func__,
+                QCameraSceneDetector::getSceneName(detected));
+            mParameters.setSelectedScene(CAM_SCENE_MODE_MAX);
         }
     }
 
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : releaseSceneDetectJob
+ *
+ * DESCRIPTION: return the zsl frame of a scene detection job to its channel
+ *
+ * PARAMETERS :
+ *   @data      : ptr to scene detection job
+ *   @user_data : user data ptr (QCamera2HardwareInterface)
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCamera2HardwareInterface::releaseSceneDetectJob(void *data,
+        void * /*user_data*/)
+{
+    qcamera_scene_detect_job_t *job = (qcamera_scene_detect_job_t *)data;
+    if ((NULL != job) && (NULL != job->frame)) {
+        job->channel->bufDone(job->frame);
+        free(job->frame);
+        job->frame = NULL;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : sceneDetectRoutine
+ *
+ * DESCRIPTION: scene detection thread. Jobs are only run while preview is
+ *              active, stopping it returns the held frames to the channel.
+ *
+ * PARAMETERS :
+ *   @obj     : user data ptr (QCamera2HardwareInterface)
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void *QCamera2HardwareInterface::sceneDetectRoutine(void *obj)
+{
+    int running = 1;
+    int ret;
+    uint8_t is_active = FALSE;
+
+    QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)obj;
+    QCameraCmdThread *cmdThread = &pme->m_sceneDetectTh;
+    cmdThread->setName("CAM_sceneDet");
+
+    do {
+        do {
+            ret = cam_sem_wait(&cmdThread->cmd_sem);
+            if (ret != 0 && errno != EINVAL) {
+                ALOGE("%s: cam_sem_wait error (%s)",
+                           __func__, strerror(errno));
+                return NULL;
+            }
+        } while (ret != 0);
+
+        // we got notified about new cmd avail in cmd queue
+        camera_cmd_type_t cmd = cmdThread->getCmd();
+        switch (cmd) {
+        case CAMERA_CMD_TYPE_START_DATA_PROC:
+            CDBG_HIGH("%s: start data proc", __func__);
+            is_active = TRUE;
+            break;
+        case CAMERA_CMD_TYPE_STOP_DATA_PROC:
+            CDBG_HIGH("%s: stop data proc", __func__);
+            is_active = FALSE;
+            // zsl channel is about to stop
+            pme->m_sceneDetectQ.flush();
+            // signal cmd is completed
+            cam_sem_post(&cmdThread->sync_sem);
+            break;
+        case CAMERA_CMD_TYPE_DO_NEXT_JOB:
+            {
+                qcamera_scene_detect_job_t *job =
+                    (qcamera_scene_detect_job_t *)pme->m_sceneDetectQ.dequeue();
+                if (NULL == job) {
+                    break;
+                }
+                if (is_active) {
+                    pme->detectScene(job);
+                }
+                releaseSceneDetectJob(job, pme);
+                free(job);
+            }
+            break;
+        case CAMERA_CMD_TYPE_EXIT:
+            running = 0;
+            break;
+        default:
+            break;
+        }
+    } while (running);
+
+    return NULL;
+}
+
 /*===========================================================================
  * FUNCTION   : capture_channel_cb_routine
  *
@@ -532,7 +787,6 @@ void QCamera2HardwareInterface::preview_stream_cb_routine(mm_camera_super_buf_t
 {
     ATRACE_CALL();
     CDBG_HIGH("[KPI Perf] %s : BEGIN", __func__);
-    int err = NO_ERROR;
     QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)userdata;
     QCameraGrallocMemory *memory = (QCameraGrallocMemory *)super_frame->bufs[0]->mem_info;
 
@@ -573,18 +827,24 @@ void QCamera2HardwareInterface::preview_stream_cb_routine(mm_camera_super_buf_t
        pme->m_bPreviewStarted = false ;
     }
 
-    // Display the buffer.
-    CDBG("%p displayBuffer %d E", pme, idx);
-    int dequeuedIdx = memory->displayBuffer(idx);
-    if (dequeuedIdx < 0 || dequeuedIdx >= memory->getCnt()) {
-        CDBG_HIGH("%s: Invalid dequeued buffer index %d from display",
-              __func__, dequeuedIdx);
+    // Display the buffer, right away or once its display time comes
+    qcamera_preview_pace_job_t paceJob;
+    paceJob.stream = stream;
+    paceJob.memory = memory;
+    paceJob.buf_idx = idx;
+    paceJob.frame_idx = frame->frame_idx;
+    paceJob.sensorTs = (int64_t)frame->ts.tv_sec * 1000000000LL + frame->ts.tv_nsec;
+    paceJob.arrival = systemTime();
+    qcamera_preview_pace_job_t *job = NULL;
+    if (pme->m_bPreviewPacing) {
+        job = (qcamera_preview_pace_job_t *)malloc(sizeof(qcamera_preview_pace_job_t));
+    }
+    if (NULL != job) {
+        *job = paceJob;
+        pme->m_previewPaceQ.enqueue((void *)job);
+        pme->m_previewPaceTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
     } else {
-        // Return dequeued buffer back to driver
-        err = stream->bufDone(dequeuedIdx);
-        if ( err < 0) {
-            ALOGE("stream bufDone failed %d", err);
-        }
+        pme->displayPreviewFrame(&paceJob);
     }
 
     // Handle preview data callback
@@ -602,10 +862,142 @@ void QCamera2HardwareInterface::preview_stream_cb_routine(mm_camera_super_buf_t
     return;
 }
 
+/*===========================================================================
+ * FUNCTION   : displayPreviewFrame
+ *
+ * DESCRIPTION: send a preview frame to display and return the buffer the
+ *              display gives back to the driver
+ *
+ * PARAMETERS :
+ *   @job     : preview frame
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCamera2HardwareInterface::displayPreviewFrame(qcamera_preview_pace_job_t *job)
+{
+    CDBG("%p displayBuffer %d E", this, job->buf_idx);
+    int dequeuedIdx = job->memory->displayBuffer(job->buf_idx);
+    m_previewPacer.displayed(job->sensorTs, job->arrival, systemTime());
+    m_displayQueued.add(job->memory->getDisplayQueuedCount());
+    if (dequeuedIdx < 0 || dequeuedIdx >= job->memory->getCnt()) {
+        CDBG_HIGH("%s: Invalid dequeued buffer index %d from display",
+              __func__, dequeuedIdx);
+        m_nDisplayDequeueFails++;
+    } else {
+        // Return dequeued buffer back to driver
+        int err = job->stream->bufDone(dequeuedIdx);
+        if ( err < 0) {
+            ALOGE("stream bufDone failed %d", err);
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : previewPaceRoutine
+ *
+ * DESCRIPTION: preview display pacing thread. Frames are taken in delivery
+ *              order and displayed at the time the pacer gives them. A
+ *              frame goes out early when waiting would leave the driver
+ *              with fewer than QCAMERA_PREVIEW_PACE_MIN_KERNEL_BUFS
+ *              buffers. Stopping, once the preview channel stopped, drops
+ *              the waiting frames; the gralloc memory cancels them.
+ *
+ * PARAMETERS :
+ *   @obj     : user data ptr (QCamera2HardwareInterface)
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void *QCamera2HardwareInterface::previewPaceRoutine(void *obj)
+{
+    int running = 1;
+    int ret;
+    uint8_t is_active = FALSE;
+    qcamera_preview_pace_job_t *job = NULL;   // frame waiting for its time
+    int64_t target = 0;                       // display time of that frame
+
+    QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)obj;
+    QCameraCmdThread *cmdThread = &pme->m_previewPaceTh;
+    cmdThread->setName("CAM_prvPace");
+
+    do {
+        if ((NULL == job) && is_active) {
+            job = (qcamera_preview_pace_job_t *)pme->m_previewPaceQ.dequeue();
+            if (NULL != job) {
+                target = pme->m_previewPacer.schedule(job->frame_idx,
+                        job->sensorTs, job->arrival);
+            }
+        }
+
+        if (NULL != job) {
+            int held = 1 + pme->m_previewPaceQ.getCurrentSize();
+            int kernel = job->memory->getCnt() -
+                    job->memory->getDisplayQueuedCount() - held;
+            int64_t wait = target - systemTime();
+            if ((wait <= 0) || (kernel < QCAMERA_PREVIEW_PACE_MIN_KERNEL_BUFS)) {
+                if (wait > 0) {
+                    pme->m_nPaceEarly++;
+                }
+                pme->displayPreviewFrame(job);
+                free(job);
+                job = NULL;
+                continue;
+            }
+            ret = cam_sem_timedwait(&cmdThread->cmd_sem, wait);
+            if (ETIMEDOUT == ret) {
+                // display time reached
+                continue;
+            }
+        } else {
+            ret = cam_sem_wait(&cmdThread->cmd_sem);
+        }
+        if (ret != 0) {
+            if (errno != EINVAL) {
+                ALOGE("%s: cam_sem_wait error (%s)",
+                           __func__, strerror(errno));
+                free(job);
+                return NULL;
+            }
+            continue;
+        }
+
+        // we got notified about new cmd avail in cmd queue
+        camera_cmd_type_t cmd = cmdThread->getCmd();
+        switch (cmd) {
+        case CAMERA_CMD_TYPE_START_DATA_PROC:
+            CDBG_HIGH("%s: start data proc", __func__);
+            is_active = TRUE;
+            break;
+        case CAMERA_CMD_TYPE_STOP_DATA_PROC:
+            CDBG_HIGH("%s: stop data proc", __func__);
+            is_active = FALSE;
+            // the preview stream is stopped, its buffers stay with the HAL
+            // until the gralloc memory cancels them
+            free(job);
+            job = NULL;
+            pme->m_previewPaceQ.flush();
+            // signal cmd is completed
+            cam_sem_post(&cmdThread->sync_sem);
+            break;
+        case CAMERA_CMD_TYPE_DO_NEXT_JOB:
+            // new frame, picked up at the top of the loop
+            break;
+        case CAMERA_CMD_TYPE_EXIT:
+            running = 0;
+            break;
+        default:
+            break;
+        }
+    } while (running);
+
+    return NULL;
+}
+
 /*===========================================================================
  * FUNCTION   : sendPreviewCallback
  *
- * DESCRIPTION: helper function for triggering preview callbacks
+ * DESCRIPTION: helper function for triggering preview callbacks. Frames
+ *              whose layout differs from what apps expect are handed to
+ *              the conversion thread instead.
  *
  * PARAMETERS :
  *   @stream    : stream object
@@ -631,6 +1023,36 @@ int32_t QCamera2HardwareInterface::sendPreviewCallback(QCameraStream *stream,
         return BAD_VALUE;
     }
 
+    qcamera_yuv_layout_t srcLayout, dstLayout;
+    if (m_bPreviewConvEnabled &&
+            getPreviewCbLayouts(stream, srcLayout, dstLayout) &&
+            !QCameraFormatConverter::isSameLayout(srcLayout, dstLayout)) {
+        if (m_previewConvQ.getCurrentSize() >= QCAMERA_PREVIEW_CONV_MAX_PENDING) {
+            // preview callbacks may drop frames, falling behind may not
+            CDBG("%s: conversion busy, dropping preview callback", __func__);
+            m_nPreviewConvDrops++;
+            return NO_ERROR;
+        }
+        qcamera_preview_conv_job_t *job =
+            (qcamera_preview_conv_job_t *)malloc(sizeof(qcamera_preview_conv_job_t));
+        if (NULL == job) {
+            ALOGE("%s: no mem for preview conversion job", __func__);
+            return NO_MEMORY;
+        }
+        job->buf_idx = idx;
+        job->src = (const uint8_t *)memory->getPtr(idx);
+        job->srcLayout = srcLayout;
+        job->dstLayout = dstLayout;
+        if (NULL == job->src) {
+            ALOGE("%s: preview buffer %d not mapped", __func__, idx);
+            free(job);
+            return BAD_VALUE;
+        }
+        m_previewConvQ.enqueue((void *)job);
+        m_previewConvTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+        return NO_ERROR;
+    }
+
     stream->getFrameDimension(preview_dim);
     stream->getFormat(previewFmt);
 
@@ -684,6 +1106,194 @@ int32_t QCamera2HardwareInterface::sendPreviewCallback(QCameraStream *stream,
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : getPreviewCbLayouts
+ *
+ * DESCRIPTION: get the layout of the preview stream and the layout apps
+ *              expect in preview callbacks. Vendor formats are handed out
+ *              in their stream layout and have no callback layout.
+ *
+ * PARAMETERS :
+ *   @stream    : preview stream
+ *   @srcLayout : [output] layout of the preview stream buffers
+ *   @dstLayout : [output] layout of the preview callback
+ *
+ * RETURN     : true -- layouts are valid; false -- no conversion possible
+ *==========================================================================*/
+bool QCamera2HardwareInterface::getPreviewCbLayouts(QCameraStream *stream,
+        qcamera_yuv_layout_t &srcLayout, qcamera_yuv_layout_t &dstLayout)
+{
+    cam_format_t fmt;
+    cam_dimension_t dim;
+    cam_frame_len_offset_t offset;
+    qcamera_yuv_fmt_t yuvFmt;
+
+    stream->getFormat(fmt);
+    switch (fmt) {
+    case CAM_FORMAT_YUV_420_NV21:
+        yuvFmt = QCAMERA_YUV_FMT_NV21;
+        break;
+    case CAM_FORMAT_YUV_420_NV12:
+        yuvFmt = QCAMERA_YUV_FMT_NV12;
+        break;
+    case CAM_FORMAT_YUV_420_YV12:
+        yuvFmt = QCAMERA_YUV_FMT_YV12;
+        break;
+    default:
+        return false;
+    }
+
+    stream->getFrameDimension(dim);
+    memset(&offset, 0, sizeof(cam_frame_len_offset_t));
+    stream->getFrameOffset(offset);
+    memset(&srcLayout, 0, sizeof(qcamera_yuv_layout_t));
+    srcLayout.fmt = yuvFmt;
+    srcLayout.width = dim.width;
+    srcLayout.height = dim.height;
+    srcLayout.num_planes = (QCAMERA_YUV_FMT_YV12 == yuvFmt) ? 3 : 2;
+    if (offset.num_planes != srcLayout.num_planes) {
+        return false;
+    }
+    uint32_t planeStart = 0;
+    for (int i = 0; i < offset.num_planes; i++) {
+        srcLayout.offset[i] = planeStart + offset.mp[i].offset;
+        srcLayout.stride[i] = offset.mp[i].stride;
+        planeStart += offset.mp[i].len;
+    }
+    srcLayout.frame_len = offset.frame_len;
+
+    return QCameraFormatConverter::getPackedLayout(yuvFmt, dim.width,
+            dim.height, dstLayout);
+}
+
+/*===========================================================================
+ * FUNCTION   : convertPreviewCallback
+ *
+ * DESCRIPTION: convert a preview frame into a recycled callback buffer and
+ *              send the preview callback. Only called from the conversion
+ *              thread.
+ *
+ * PARAMETERS :
+ *   @job     : conversion job
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCamera2HardwareInterface::convertPreviewCallback(
+        qcamera_preview_conv_job_t *job)
+{
+    camera_memory_t *cbMem = m_previewCbRing.get(mGetMemory,
+            job->dstLayout.frame_len, mCallbackCookie);
+    if ((NULL == cbMem) || (NULL == cbMem->data)) {
+        ALOGE("%s: no mem for preview callback", __func__);
+        m_previewCbRing.put(cbMem);
+        return NO_MEMORY;
+    }
+
+    nsecs_t start = systemTime();
+    if (!QCameraFormatConverter::convert(job->src, job->srcLayout,
+            (uint8_t *)cbMem->data, job->dstLayout)) {
+        ALOGE("%s: cannot convert preview buffer %d", __func__, job->buf_idx);
+        m_previewCbRing.put(cbMem);
+        return BAD_VALUE;
+    }
+    int64_t convTime = (systemTime() - start) / 1000;
+    m_previewConvTime.add(convTime);
+    CDBG("%s: buffer %d %s stride %d -> %s stride %d in %lld us", __func__,
+        job->buf_idx,
+        QCameraFormatConverter::getFormatName(job->srcLayout.fmt),
+        job->srcLayout.stride[0],
+        QCameraFormatConverter::getFormatName(job->dstLayout.fmt),
+        job->dstLayout.stride[0], convTime);
+
+    qcamera_callback_argm_t cbArg;
+    memset(&cbArg, 0, sizeof(qcamera_callback_argm_t));
+    cbArg.cb_type = QCAMERA_DATA_CALLBACK;
+    cbArg.msg_type = CAMERA_MSG_PREVIEW_FRAME;
+    cbArg.data = cbMem;
+    cbArg.user_data = cbMem;
+    cbArg.cookie = &m_previewCbRing;
+    cbArg.release_cb = QCameraCallbackMemoryRing::releaseCallback;
+    int32_t rc = m_cbNotifier.notifyCallback(cbArg);
+    if (rc != NO_ERROR) {
+        ALOGE("%s: fail sending notification", __func__);
+        m_previewCbRing.put(cbMem);
+    }
+
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : previewConvRoutine
+ *
+ * DESCRIPTION: preview callback conversion thread. Jobs are only run while
+ *              preview is active, stopping it flushes the pending ones.
+ *
+ * PARAMETERS :
+ *   @obj     : user data ptr (QCamera2HardwareInterface)
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void *QCamera2HardwareInterface::previewConvRoutine(void *obj)
+{
+    int running = 1;
+    int ret;
+    uint8_t is_active = FALSE;
+
+    QCamera2HardwareInterface *pme = (QCamera2HardwareInterface *)obj;
+    QCameraCmdThread *cmdThread = &pme->m_previewConvTh;
+    cmdThread->setName("CAM_prvConv");
+
+    do {
+        do {
+            ret = cam_sem_wait(&cmdThread->cmd_sem);
+            if (ret != 0 && errno != EINVAL) {
+                ALOGE("%s: cam_sem_wait error (%s)",
+                           __func__, strerror(errno));
+                return NULL;
+            }
+        } while (ret != 0);
+
+        // we got notified about new cmd avail in cmd queue
+        camera_cmd_type_t cmd = cmdThread->getCmd();
+        switch (cmd) {
+        case CAMERA_CMD_TYPE_START_DATA_PROC:
+            CDBG_HIGH("%s: start data proc", __func__);
+            is_active = TRUE;
+            break;
+        case CAMERA_CMD_TYPE_STOP_DATA_PROC:
+            CDBG_HIGH("%s: stop data proc", __func__);
+            is_active = FALSE;
+            // preview buffers are about to go away
+            pme->m_previewConvQ.flush();
+            // signal cmd is completed
+            cam_sem_post(&cmdThread->sync_sem);
+            break;
+        case CAMERA_CMD_TYPE_DO_NEXT_JOB:
+            {
+                qcamera_preview_conv_job_t *job =
+                    (qcamera_preview_conv_job_t *)pme->m_previewConvQ.dequeue();
+                if (NULL == job) {
+                    break;
+                }
+                if (is_active) {
+                    pme->convertPreviewCallback(job);
+                }
+                free(job);
+            }
+            break;
+        case CAMERA_CMD_TYPE_EXIT:
+            running = 0;
+            break;
+        default:
+            break;
+        }
+    } while (running);
+
+    return NULL;
+}
+
 /*===========================================================================
  * FUNCTION   : nodisplay_preview_stream_cb_routine
  *
@@ -1018,6 +1628,7 @@ void QCamera2HardwareInterface::video_stream_cb_routine(mm_camera_super_buf_t *s
             cbArg.msg_type = CAMERA_MSG_VIDEO_FRAME;
             cbArg.data = video_mem;
             cbArg.timestamp = timeStamp;
+            ((QCameraVideoMemory *)videoMemObj)->markFrameSent(frame->buf_idx);
             int32_t rc = pme->m_cbNotifier.notifyCallback(cbArg);
             if (rc != NO_ERROR) {
                 ALOGE("%s: fail sending data notify", __func__);
@@ -1470,6 +2081,8 @@ void QCamera2HardwareInterface::metadata_stream_cb_routine(mm_camera_super_buf_t
         pme->mExifParams.sensor_params = *sensor_params;
     }
 
+    pme->samplePerfLoad(frame->frame_idx);
+
     stream->bufDone(frame->buf_idx);
     free(super_frame);
 
@@ -706,7 +706,22 @@ int32_t QCameraVideoChannel::releaseFrame(const void * opaque, bool isMetaData)
         return BAD_VALUE;
     }
 
-    int32_t rc = pVideoStream->bufDone(opaque, isMetaData);
+    // video streams always use QCameraVideoMemory
+    QCameraVideoMemory *pVideoMem =
+        (QCameraVideoMemory *)pVideoStream->getStreamBufs();
+    if (NULL == pVideoMem) {
+        ALOGE("%s: No video buffers in the stream", __func__);
+        return BAD_VALUE;
+    }
+
+    int index = pVideoMem->getMatchBufIndex(opaque, isMetaData);
+    if (index < 0) {
+        ALOGE("%s: Cannot find buf for opaque data = %p", __func__, opaque);
+        return BAD_INDEX;
+    }
+    pVideoMem->markFrameReturned(index);
+
+    int32_t rc = pVideoStream->bufDone(index);
     return rc;
 }
 
@@ -0,0 +1,315 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#define LOG_TAG "QCameraExif"
+
+#include <stdlib.h>
+#include <string.h>
+#include <utils/Errors.h>
+#include <utils/Log.h>
+
+#include "QCameraExif.h"
+
+using namespace android;
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : QCameraExif
+ *
+ * DESCRIPTION: constructor of QCameraExif
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraExif::QCameraExif()
+    : m_Entries(NULL),
+      m_nNumEntries(0),
+      m_nCapacity(0)
+{
+}
+
+/*===========================================================================
+ * FUNCTION   : QCameraExif
+ *
+ * DESCRIPTION: copy constructor of QCameraExif. Used to start a per-shot
+ *              exif object from a template holding the static tags.
+ *
+ * PARAMETERS :
+ *   @other   : exif object to be copied
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraExif::QCameraExif(const QCameraExif &other)
+    : m_Entries(NULL),
+      m_nNumEntries(0),
+      m_nCapacity(0)
+{
+    if (reserve(other.m_nNumEntries) != NO_ERROR) {
+        return;
+    }
+    for (uint32_t i = 0; i < other.m_nNumEntries; i++) {
+        QEXIF_INFO_DATA &src = other.m_Entries[i];
+        addEntry(src.tag_id, src.tag_entry.type, src.tag_entry.count,
+                 getEntryData(src));
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraExif
+ *
+ * DESCRIPTION: deconstructor of QCameraExif. Will release internal memory ptr.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraExif::~QCameraExif()
+{
+    for (uint32_t i = 0; i < m_nNumEntries; i++) {
+        releaseEntry(m_Entries[i]);
+    }
+    free(m_Entries);
+    m_Entries = NULL;
+}
+
+/*===========================================================================
+ * FUNCTION   : reserve
+ *
+ * DESCRIPTION: make room for at least numEntries entries. The table grows
+ *              geometrically, so the number of tags is not bounded.
+ *
+ * PARAMETERS :
+ *   @numEntries : number of entries to hold
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraExif::reserve(uint32_t numEntries)
+{
+    if (numEntries <= m_nCapacity) {
+        return NO_ERROR;
+    }
+
+    uint32_t capacity = (m_nCapacity > 0) ? m_nCapacity : MAX_EXIF_TABLE_ENTRIES;
+    while (capacity < numEntries) {
+        capacity *= 2;
+    }
+    QEXIF_INFO_DATA *entries = (QEXIF_INFO_DATA *)realloc(m_Entries,
+            capacity * sizeof(QEXIF_INFO_DATA));
+    if (entries == NULL) {
+        ALOGE("%s: No memory for %d exif entries", __func__, capacity);
+        return NO_MEMORY;
+    }
+    memset(entries + m_nCapacity, 0,
+           (capacity - m_nCapacity) * sizeof(QEXIF_INFO_DATA));
+    m_Entries = entries;
+    m_nCapacity = capacity;
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : getTypeSize
+ *
+ * DESCRIPTION: size in bytes of one unit of an exif data type
+ *
+ * PARAMETERS :
+ *   @type    : data type
+ *
+ * RETURN     : size of one unit, 0 for unknown type
+ *==========================================================================*/
+uint32_t QCameraExif::getTypeSize(exif_tag_type_t type)
+{
+    switch (type) {
+    case EXIF_BYTE:
+    case EXIF_ASCII:
+    case EXIF_UNDEFINED:
+        return sizeof(uint8_t);
+    case EXIF_SHORT:
+        return sizeof(uint16_t);
+    case EXIF_LONG:
+        return sizeof(uint32_t);
+    case EXIF_RATIONAL:
+        return sizeof(rat_t);
+    case EXIF_SLONG:
+        return sizeof(int32_t);
+    case EXIF_SRATIONAL:
+        return sizeof(srat_t);
+    default:
+        return 0;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : isInlineEntry
+ *
+ * DESCRIPTION: whether the value of an entry is stored in the entry itself
+ *              rather than in a separately allocated array
+ *
+ * PARAMETERS :
+ *   @type    : data type
+ *   @count   : number of data in uint of its type
+ *
+ * RETURN     : true if stored inline
+ *==========================================================================*/
+bool QCameraExif::isInlineEntry(exif_tag_type_t type, uint32_t count)
+{
+    return (count <= 1) && (type != EXIF_ASCII) && (type != EXIF_UNDEFINED);
+}
+
+/*===========================================================================
+ * FUNCTION   : getEntryData
+ *
+ * DESCRIPTION: ptr to the value of an entry, in the layout addEntry takes
+ *
+ * PARAMETERS :
+ *   @entry   : exif entry
+ *
+ * RETURN     : ptr to value
+ *==========================================================================*/
+void *QCameraExif::getEntryData(QEXIF_INFO_DATA &entry)
+{
+    if (isInlineEntry(entry.tag_entry.type, entry.tag_entry.count)) {
+        return &entry.tag_entry.data;
+    }
+    // all array members of the data union alias the same pointer
+    return entry.tag_entry.data._bytes;
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseEntry
+ *
+ * DESCRIPTION: free the memory owned by an entry
+ *
+ * PARAMETERS :
+ *   @entry   : exif entry
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraExif::releaseEntry(QEXIF_INFO_DATA &entry)
+{
+    if (!isInlineEntry(entry.tag_entry.type, entry.tag_entry.count) &&
+            entry.tag_entry.data._bytes != NULL) {
+        free(entry.tag_entry.data._bytes);
+        entry.tag_entry.data._bytes = NULL;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : fillEntry
+ *
+ * DESCRIPTION: set tag, type and value of an entry, allocating memory for
+ *              array and string values
+ *
+ * PARAMETERS :
+ *   @entry   : exif entry to be filled
+ *   @tagid   : exif tag ID
+ *   @type    : data type
+ *   @count   : number of data in uint of its type
+ *   @data    : input data ptr
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraExif::fillEntry(QEXIF_INFO_DATA &entry,
+                               exif_tag_id_t tagid,
+                               exif_tag_type_t type,
+                               uint32_t count,
+                               void *data)
+{
+    uint32_t unit = getTypeSize(type);
+    if (unit == 0) {
+        ALOGE("%s: Unknown exif type %d", __func__, type);
+        return BAD_VALUE;
+    }
+
+    entry.tag_id = tagid;
+    entry.tag_entry.type = type;
+    entry.tag_entry.count = count;
+    entry.tag_entry.copy = 1;
+
+    if (isInlineEntry(type, count)) {
+        memset(&entry.tag_entry.data, 0, sizeof(entry.tag_entry.data));
+        memcpy(&entry.tag_entry.data, data, unit);
+        return NO_ERROR;
+    }
+
+    // strings get an extra byte for the terminator
+    uint32_t size = count * unit + ((type == EXIF_ASCII) ? 1 : 0);
+    uint8_t *values = (uint8_t *)malloc(size);
+    if (values == NULL) {
+        ALOGE("%s: No memory for exif tag 0x%x", __func__, tagid);
+        entry.tag_entry.data._bytes = NULL;
+        return NO_MEMORY;
+    }
+    memset(values, 0, size);
+    memcpy(values, data, count * unit);
+    entry.tag_entry.data._bytes = values;
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : addEntry
+ *
+ * DESCRIPTION: function to add an entry to exif data
+ *
+ * PARAMETERS :
+ *   @tagid   : exif tag ID
+ *   @type    : data type
+ *   @count   : number of data in uint of its type
+ *   @data    : input data ptr
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraExif::addEntry(exif_tag_id_t tagid,
+                              exif_tag_type_t type,
+                              uint32_t count,
+                              void *data)
+{
+    int32_t rc = reserve(m_nNumEntries + 1);
+    if (rc != NO_ERROR) {
+        return rc;
+    }
+
+    rc = fillEntry(m_Entries[m_nNumEntries], tagid, type, count, data);
+    if (rc != NO_ERROR) {
+        return rc;
+    }
+
+    // Increase number of entries
+    m_nNumEntries++;
+    return rc;
+}
+
+}; // namespace qcamera
@@ -0,0 +1,74 @@
+/* Copyright (c) 2014, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_EXIF_H__
+#define __QCAMERA_EXIF_H__
+
+extern "C" {
+#include <mm_jpeg_interface.h>
+}
+
+namespace qcamera {
+
+#define MAX_EXIF_TABLE_ENTRIES 17 // initial capacity, table grows on demand
+class QCameraExif
+{
+public:
+    QCameraExif();
+    QCameraExif(const QCameraExif &other);
+    virtual ~QCameraExif();
+
+    int32_t addEntry(exif_tag_id_t tagid,
+                     exif_tag_type_t type,
+                     uint32_t count,
+                     void *data);
+    uint32_t getNumOfEntries() {return m_nNumEntries;};
+    QEXIF_INFO_DATA *getEntries() {return m_Entries;};
+
+private:
+    QCameraExif &operator=(const QCameraExif &);
+    int32_t reserve(uint32_t numEntries);
+    static uint32_t getTypeSize(exif_tag_type_t type);
+    static bool isInlineEntry(exif_tag_type_t type, uint32_t count);
+    static void *getEntryData(QEXIF_INFO_DATA &entry);
+    static void releaseEntry(QEXIF_INFO_DATA &entry);
+    static int32_t fillEntry(QEXIF_INFO_DATA &entry,
+                             exif_tag_id_t tagid,
+                             exif_tag_type_t type,
+                             uint32_t count,
+                             void *data);
+
+    QEXIF_INFO_DATA *m_Entries;  // exif tags for JPEG encoder
+    uint32_t  m_nNumEntries;     // number of valid entries
+    uint32_t  m_nCapacity;       // number of allocated entries
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_EXIF_H__ */
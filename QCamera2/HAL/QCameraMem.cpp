@@ -49,6 +49,17 @@ using namespace android;
 
 namespace qcamera {
 
+#define QCAMERA_VIDEO_META_MAGIC 0x5643494D /* "VCIM" */
+
+// metadata buffer handed to the encoder. The encoder only looks at the
+// leading encoder_media_buffer_type, the trailer maps the buffer back
+// to its index when it is returned.
+typedef struct {
+    struct encoder_media_buffer_type packet;
+    uint32_t magic;
+    int32_t index;
+} qcamera_video_meta_buf_t;
+
 // QCaemra2Memory base class
 
 /*===========================================================================
@@ -1125,9 +1136,15 @@ void *QCameraStreamMemory::getPtr(int index) const
  *==========================================================================*/
 QCameraVideoMemory::QCameraVideoMemory(camera_request_memory getMemory,
                                        bool cached)
-    : QCameraStreamMemory(getMemory, cached)
+    : QCameraStreamMemory(getMemory, cached),
+      mReturnCnt(0),
+      mReturnTotal(0),
+      mReturnMax(0)
 {
     memset(mMetadata, 0, sizeof(mMetadata));
+    memset(mSentTime, 0, sizeof(mSentTime));
+    memset(mReturnHist, 0, sizeof(mReturnHist));
+    pthread_mutex_init(&mStatsLock, NULL);
 }
 
 /*===========================================================================
@@ -1141,6 +1158,7 @@ QCameraVideoMemory::QCameraVideoMemory(camera_request_memory getMemory,
  *==========================================================================*/
 QCameraVideoMemory::~QCameraVideoMemory()
 {
+    pthread_mutex_destroy(&mStatsLock);
 }
 
 /*===========================================================================
@@ -1165,7 +1183,7 @@ int QCameraVideoMemory::allocate(int count, int size, uint32_t isSecure)
 
     for (int i = 0; i < count; i ++) {
         mMetadata[i] = mGetMemory(-1,
-                sizeof(struct encoder_media_buffer_type), 1, this);
+                sizeof(qcamera_video_meta_buf_t), 1, this);
         if (!mMetadata[i]) {
             ALOGE("allocation of video metadata failed.");
             for (int j = 0; j <= i-1; j ++)
@@ -1182,6 +1200,11 @@ int QCameraVideoMemory::allocate(int count, int size, uint32_t isSecure)
         nh->data[1] = 0;
         nh->data[2] = mMemInfo[i].size;
         nh->data[3] = private_handle_t::PRIV_FLAGS_ITU_R_709;
+
+        qcamera_video_meta_buf_t *metaBuf =
+            (qcamera_video_meta_buf_t *)mMetadata[i]->data;
+        metaBuf->magic = QCAMERA_VIDEO_META_MAGIC;
+        metaBuf->index = i;
     }
     mBufferCount = count;
     traceLogAllocEnd((size * count));
@@ -1210,7 +1233,7 @@ int QCameraVideoMemory::allocateMore(int count, int size)
 
     for (int i = mBufferCount; i < count + mBufferCount; i ++) {
         mMetadata[i] = mGetMemory(-1,
-                sizeof(struct encoder_media_buffer_type), 1, this);
+                sizeof(qcamera_video_meta_buf_t), 1, this);
         if (!mMetadata[i]) {
             ALOGE("allocation of video metadata failed.");
             for (int j = mBufferCount; j <= i-1; j ++) {
@@ -1229,6 +1252,11 @@ int QCameraVideoMemory::allocateMore(int count, int size)
         nh->data[0] = mMemInfo[i].fd;
         nh->data[1] = 0;
         nh->data[2] = mMemInfo[i].size;
+
+        qcamera_video_meta_buf_t *metaBuf =
+            (qcamera_video_meta_buf_t *)mMetadata[i]->data;
+        metaBuf->magic = QCAMERA_VIDEO_META_MAGIC;
+        metaBuf->index = i;
     }
     mBufferCount += count;
     traceLogAllocEnd((size * count));
@@ -1246,6 +1274,7 @@ int QCameraVideoMemory::allocateMore(int count, int size)
  *==========================================================================*/
 void QCameraVideoMemory::deallocate()
 {
+    logReturnLatency();
     for (int i = 0; i < mBufferCount; i ++) {
         struct encoder_media_buffer_type * packet =
             (struct encoder_media_buffer_type *)mMetadata[i]->data;
@@ -1308,6 +1337,18 @@ int QCameraVideoMemory::getMatchBufIndex(const void *opaque,
                                          bool metadata) const
 {
     int index = -1;
+    if (metadata && NULL != opaque) {
+        const qcamera_video_meta_buf_t *metaBuf =
+            (const qcamera_video_meta_buf_t *)opaque;
+        index = metaBuf->index;
+        if (metaBuf->magic == QCAMERA_VIDEO_META_MAGIC &&
+            index >= 0 && index < mBufferCount &&
+            mMetadata[index]->data == opaque) {
+            return index;
+        }
+        ALOGE("%s: stale metadata buffer %p, searching", __func__, opaque);
+        index = -1;
+    }
     for (int i = 0; i < mBufferCount; i++) {
         if (metadata) {
             if (mMetadata[i]->data == opaque) {
@@ -1324,6 +1365,117 @@ int QCameraVideoMemory::getMatchBufIndex(const void *opaque,
     return index;
 }
 
+/*===========================================================================
+ * FUNCTION   : markFrameSent
+ *
+ * DESCRIPTION: record the time a video buffer is sent to the encoder
+ *
+ * PARAMETERS :
+ *   @index   : buffer index
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraVideoMemory::markFrameSent(int index)
+{
+    if (index < 0 || index >= MM_CAMERA_MAX_NUM_FRAMES) {
+        return;
+    }
+    mSentTime[index] = systemTime();
+}
+
+/*===========================================================================
+ * FUNCTION   : markFrameReturned
+ *
+ * DESCRIPTION: account the encoder latency of a returned video buffer
+ *
+ * PARAMETERS :
+ *   @index   : buffer index
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraVideoMemory::markFrameReturned(int index)
+{
+    if (index < 0 || index >= MM_CAMERA_MAX_NUM_FRAMES ||
+        0 == mSentTime[index]) {
+        return;
+    }
+    nsecs_t latency = systemTime() - mSentTime[index];
+    mSentTime[index] = 0;
+
+    int bin = 0;
+    nsecs_t ms = latency / 1000000LL;
+    while (ms > 0 && bin < QCAMERA_VIDEO_RETURN_HIST_BINS - 1) {
+        ms >>= 1;
+        bin++;
+    }
+
+    pthread_mutex_lock(&mStatsLock);
+    mReturnHist[bin]++;
+    mReturnCnt++;
+    mReturnTotal += latency;
+    if (latency > mReturnMax) {
+        mReturnMax = latency;
+    }
+    pthread_mutex_unlock(&mStatsLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : dumpReturnLatency
+ *
+ * DESCRIPTION: print the encoder return latency histogram. Bin n counts
+ *              buffers returned within [2^(n-1), 2^n) ms, bin 0 within 1 ms.
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : histogram as string
+ *==========================================================================*/
+String8 QCameraVideoMemory::dumpReturnLatency()
+{
+    String8 str;
+
+    pthread_mutex_lock(&mStatsLock);
+    str.appendFormat("returned %u avg %lld us max %lld us\n",
+        mReturnCnt,
+        mReturnCnt ? (long long)(mReturnTotal / mReturnCnt) / 1000LL : 0LL,
+        (long long)mReturnMax / 1000LL);
+    for (int i = 0; i < QCAMERA_VIDEO_RETURN_HIST_BINS; i++) {
+        if (i < QCAMERA_VIDEO_RETURN_HIST_BINS - 1) {
+            str.appendFormat("  < %4d ms: %u\n", 1 << i, mReturnHist[i]);
+        } else {
+            str.appendFormat("  >= %3d ms: %u\n", 1 << (i - 1), mReturnHist[i]);
+        }
+    }
+    pthread_mutex_unlock(&mStatsLock);
+
+    return str;
+}
+
+/*===========================================================================
+ * FUNCTION   : logReturnLatency
+ *
+ * DESCRIPTION: log a summary of the encoder return latency and reset it
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : none
+ *==========================================================================*/
+void QCameraVideoMemory::logReturnLatency()
+{
+    pthread_mutex_lock(&mStatsLock);
+    if (mReturnCnt > 0) {
+        CDBG_HIGH("[KPI Perf] %s: %u buffers returned, avg %lld us, max %lld us",
+            __func__, mReturnCnt,
+            (long long)(mReturnTotal / mReturnCnt) / 1000LL,
+            (long long)mReturnMax / 1000LL);
+    }
+    memset(mSentTime, 0, sizeof(mSentTime));
+    memset(mReturnHist, 0, sizeof(mReturnHist));
+    mReturnCnt = 0;
+    mReturnTotal = 0;
+    mReturnMax = 0;
+    pthread_mutex_unlock(&mStatsLock);
+}
+
 /*===========================================================================
  * FUNCTION   : QCameraGrallocMemory
  *
@@ -1439,6 +1591,28 @@ int QCameraGrallocMemory::displayBuffer(int index)
     return dequeuedIdx;
 }
 
+/*===========================================================================
+ * FUNCTION   : getDisplayQueuedCount
+ *
+ * DESCRIPTION: number of buffers held by the native window, i.e. queued for
+ *              display, on screen or free for dequeue. The rest are with
+ *              the HAL or the driver.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : number of buffers
+ *==========================================================================*/
+int QCameraGrallocMemory::getDisplayQueuedCount() const
+{
+    int count = 0;
+    for (int i = 0; i < mBufferCount; i++) {
+        if (BUFFER_NOT_OWNED == mLocalFlag[i]) {
+            count++;
+        }
+    }
+    return count;
+}
+
 /*===========================================================================
  * FUNCTION   : allocate
  *
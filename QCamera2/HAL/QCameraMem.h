@@ -33,6 +33,8 @@
 #include <hardware/camera.h>
 #include <utils/Mutex.h>
 #include <utils/List.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
 
 extern "C" {
 #include <sys/types.h>
@@ -180,6 +182,10 @@ protected:
 
 // Externel heap memory is used for memories shared with
 // framework. They are allocated from /dev/ion or gralloc.
+// Video metadata buffers carry their own index so buffers returned
+// by the encoder are matched without a search.
+#define QCAMERA_VIDEO_RETURN_HIST_BINS 10
+
 class QCameraVideoMemory : public QCameraStreamMemory {
 public:
     QCameraVideoMemory(camera_request_memory getMemory, bool cached);
@@ -191,8 +197,22 @@ public:
     virtual camera_memory_t *getMemory(int index, bool metadata) const;
     virtual int getMatchBufIndex(const void *opaque, bool metadata) const;
 
+    void markFrameSent(int index);
+    void markFrameReturned(int index);
+    android::String8 dumpReturnLatency();
+
 private:
+    void logReturnLatency();
+
     camera_memory_t *mMetadata[MM_CAMERA_MAX_NUM_FRAMES];
+
+    // encoder return latency, log2 ms bins
+    nsecs_t mSentTime[MM_CAMERA_MAX_NUM_FRAMES];
+    uint32_t mReturnHist[QCAMERA_VIDEO_RETURN_HIST_BINS];
+    uint32_t mReturnCnt;
+    nsecs_t mReturnTotal;
+    nsecs_t mReturnMax;
+    pthread_mutex_t mStatsLock;
 };
 ;
 
@@ -222,6 +242,8 @@ public:
     // and dequeue one buffer from it.
     // Returns the buffer index of the dequeued buffer.
     int displayBuffer(int index);
+    int getDisplayQueuedCount() const;
+    int getMinUndequeuedCount() const { return mMinUndequeuedBuffers; };
 
 private:
     buffer_handle_t *mBufferHandle[MM_CAMERA_MAX_NUM_FRAMES];
@@ -7198,6 +7198,10 @@ int QCameraParameters::getZSLQueueDepth()
     if (qdepth < 0) {
         qdepth = 2;
     }
+    // keep enough frames around to choose from
+    if (qdepth < getZSLBestFrameWindow()) {
+        qdepth = getZSLBestFrameWindow();
+    }
     return qdepth;
 }
 
@@ -7216,9 +7220,37 @@ int QCameraParameters::getZSLBackLookCount()
     if (look_back < 0) {
         look_back = 2;
     }
+    if (look_back < getZSLBestFrameWindow()) {
+        look_back = getZSLBestFrameWindow();
+    }
     return look_back;
 }
 
+/*===========================================================================
+ * FUNCTION   : getZSLBestFrameWindow
+ *
+ * DESCRIPTION: get the number of queued ZSL frames a single shot picks the
+ *              sharpest one from, based on their 3A metadata
+ *
+ * PARAMETERS : none
+ *
+ * RETURN     : window size, 0 if disabled
+ *==========================================================================*/
+int QCameraParameters::getZSLBestFrameWindow()
+{
+    char prop[PROPERTY_VALUE_MAX];
+    memset(prop, 0, sizeof(prop));
+    property_get("persist.camera.zsl.bestframe", prop, "0");
+    int window = atoi(prop);
+    if (window <= 1) {
+        return 0;
+    }
+    if (window > MM_CAMERA_MAX_NUM_FRAMES / 2) {
+        window = MM_CAMERA_MAX_NUM_FRAMES / 2;
+    }
+    return window;
+}
+
 /*===========================================================================
  * FUNCTION   : getZSLMaxUnmatchedFrames
  *
@@ -9267,6 +9299,9 @@ String8 QCameraParameters::dump()
     snprintf(s, 128, "ZSL Back Look Count %d\n", getZSLBackLookCount());
     str += s;
 
+    snprintf(s, 128, "ZSL Best Frame Window %d\n", getZSLBestFrameWindow());
+    str += s;
+
     snprintf(s, 128, "Max Unmatched Frames In Queue: %d\n",
         getMaxUnmatchedFramesInQueue());
     str += s;
@@ -515,6 +515,7 @@ public:
     int getZSLBurstInterval();
     int getZSLQueueDepth();
     int getZSLBackLookCount();
+    int getZSLBestFrameWindow();
     int getMaxUnmatchedFramesInQueue();
     bool isZSLMode() {return m_bZslMode;};
     bool isRdiMode() {return m_bRdiMode;};
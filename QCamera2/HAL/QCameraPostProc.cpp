@@ -42,6 +42,12 @@ namespace qcamera {
 
 const char *QCameraPostProcessor::STORE_LOCATION = "/sdcard/img_%d.jpg";
 
+// reprocess result lookup in the ongoing PP queue
+typedef struct {
+    uint32_t frame_idx;              // frame idx of the reprocess output
+    uint32_t skipped;                // older jobs passed before the match
+} qcamera_pp_match_t;
+
 #define FREE_JPEG_OUTPUT_BUFFER(ptr,cnt)     \
     int jpeg_bufs; \
     for (jpeg_bufs = 0; jpeg_bufs < (int)cnt; jpeg_bufs++)  { \
@@ -64,15 +70,18 @@ const char *QCameraPostProcessor::STORE_LOCATION = "/sdcard/img_%d.jpg";
 QCameraPostProcessor::QCameraPostProcessor(QCamera2HardwareInterface *cam_ctrl)
     : m_parent(cam_ctrl),
       mJpegCB(NULL),
+      mJpegChunkCB(NULL),
       mJpegUserData(NULL),
       mJpegClientHandle(0),
       mJpegSessionId(0),
       m_pJpegExifObj(NULL),
       m_bThumbnailNeeded(TRUE),
       m_pReprocChannel(NULL),
+      m_bNeedReprocess(false),
       m_bInited(FALSE),
       m_inputPPQ(releasePPInputData, this),
       m_ongoingPPQ(releaseOngoingPPData, this),
+      mPPInFlightMax(0),
       m_inputJpegQ(releaseJpegData, this),
       m_ongoingJpegQ(releaseJpegData, this),
       m_inputRawQ(releaseRawData, this),
@@ -80,11 +89,42 @@ QCameraPostProcessor::QCameraPostProcessor(QCamera2HardwareInterface *cam_ctrl)
       mUseSaveProc(false),
       mUseJpegBurst(false),
       mJpegMemOpt(true),
+      mJpegAutoOutBuf(false),
       m_JpegOutputMemCount(0),
-      mNewJpegSessionNeeded(true)
+      m_JpegOutputMemSize(0),
+      m_JpegBufGeneration(1),
+      mNewJpegSessionNeeded(true),
+      mJpegSessionCache(false),
+      mJpegStreaming(false),
+      mThumbFirst(false),
+      mThumbFirstSession(false),
+      mJpegThumbSessionId(0),
+      mJpegThumbSrcStream(NULL),
+      mJpegThumbRotation(0),
+      m_pJpegThumbOutputMem(NULL),
+      m_JpegThumbOutputMemSize(0),
+      mThumbJobId(0),
+      mThumbDropJobId(0),
+      m_pThumbJpeg(NULL),
+      m_nThumbJpegLen(0),
+      mThumbStartTime(0),
+      m_pThumbRoomMem(NULL),
+      mThumbRoom(0),
+      mCaptureCredits(0),
+      m_pCreditChannel(NULL),
+      mPendingRequests(0),
+      mDeferredRequests(0),
+      mIssuingRequests(false),
+      mRawZeroCopy(false),
+      mRawFramesHeld(0)
 {
     memset(&mJpegHandle, 0, sizeof(mJpegHandle));
     memset(&m_pJpegOutputMem, 0, sizeof(m_pJpegOutputMem));
+    memset(&mJpegThumbDim, 0, sizeof(mJpegThumbDim));
+    memset(&mPipeStats, 0, sizeof(mPipeStats));
+    pthread_mutex_init(&mThumbLock, NULL);
+    pthread_mutex_init(&mCreditLock, NULL);
+    pthread_cond_init(&mCreditCond, NULL);
 }
 
 /*===========================================================================
@@ -99,6 +139,14 @@ QCameraPostProcessor::QCameraPostProcessor(QCamera2HardwareInterface *cam_ctrl)
 QCameraPostProcessor::~QCameraPostProcessor()
 {
     FREE_JPEG_OUTPUT_BUFFER(m_pJpegOutputMem,m_JpegOutputMemCount);
+    if (m_pJpegThumbOutputMem != NULL) {
+        free(m_pJpegThumbOutputMem);
+        m_pJpegThumbOutputMem = NULL;
+    }
+    if (m_pThumbJpeg != NULL) {
+        free(m_pThumbJpeg);
+        m_pThumbJpeg = NULL;
+    }
     if (m_pJpegExifObj != NULL) {
         delete m_pJpegExifObj;
         m_pJpegExifObj = NULL;
@@ -108,6 +156,9 @@ QCameraPostProcessor::~QCameraPostProcessor()
         delete m_pReprocChannel;
         m_pReprocChannel = NULL;
     }
+    pthread_mutex_destroy(&mThumbLock);
+    pthread_cond_destroy(&mCreditCond);
+    pthread_mutex_destroy(&mCreditLock);
 }
 
 /*===========================================================================
@@ -117,15 +168,19 @@ QCameraPostProcessor::~QCameraPostProcessor()
  *
  * PARAMETERS :
  *   @jpeg_cb      : callback to handle jpeg event from mm-camera-interface
+ *   @jpeg_chunk_cb: callback to handle partial output of streaming encodes
  *   @user_data    : user data ptr for jpeg callback
  *
  * RETURN     : int32_t type of status
  *              NO_ERROR  -- success
  *              none-zero failure code
  *==========================================================================*/
-int32_t QCameraPostProcessor::init(jpeg_encode_callback_t jpeg_cb, void *user_data)
+int32_t QCameraPostProcessor::init(jpeg_encode_callback_t jpeg_cb,
+                                   jpeg_encode_chunk_callback_t jpeg_chunk_cb,
+                                   void *user_data)
 {
     mJpegCB = jpeg_cb;
+    mJpegChunkCB = jpeg_chunk_cb;
     mJpegUserData = user_data;
     mm_dimension max_size;
 
@@ -140,6 +195,30 @@ int32_t QCameraPostProcessor::init(jpeg_encode_callback_t jpeg_cb, void *user_da
         return UNKNOWN_ERROR;
     }
 
+    // mm-jpeg keeps released sessions warm if this is set
+    char prop[PROPERTY_VALUE_MAX];
+    property_get("persist.camera.jpeg.sesscache", prop, "0");
+    mJpegSessionCache = atoi(prop) > 0;
+
+    // longshot jpegs saved by the save thread are written while encoding
+    property_get("persist.camera.jpeg.streaming", prop, "0");
+    mJpegStreaming = (atoi(prop) > 0) && (NULL != mJpegChunkCB);
+
+    // encode the thumbnail in its own job ahead of the main image, so it
+    // is ready to be added when the main image is done
+    property_get("persist.camera.jpeg.thumbfirst", prop, "0");
+    mThumbFirst = (atoi(prop) > 0) && (NULL != mJpegHandle.insert_thumbnail);
+
+    // frames a longshot may hold in reprocess, encode and save together,
+    // 0 lets requests through as soon as the previous one arrived
+    property_get("persist.camera.longshot.credits", prop, "4");
+    mCaptureCredits = atoi(prop) > 0 ? atoi(prop) : 0;
+
+    // share the stream buffer with raw/yuv callbacks of single shot
+    // captures, streaming modes always copy
+    property_get("persist.camera.raw.zerocopy", prop, "0");
+    mRawZeroCopy = atoi(prop) > 0 ? true : false;
+
     m_dataProcTh.launch(dataProcessRoutine, this);
     m_saveProcTh.launch(dataSaveRoutine, this);
 
@@ -201,7 +280,10 @@ int32_t QCameraPostProcessor::start(QCameraChannel *pSrcChannel)
         return UNKNOWN_ERROR;
     }
 
-    if (m_parent->needReprocess()) {
+    // the perf governor can change what needs reprocess at any time, so
+    // the decision is kept for the whole capture to match the channels
+    m_bNeedReprocess = m_parent->needReprocess();
+    if (m_bNeedReprocess) {
         if (m_pReprocChannel != NULL) {
             delete m_pReprocChannel;
             m_pReprocChannel = NULL;
@@ -225,6 +307,24 @@ int32_t QCameraPostProcessor::start(QCameraChannel *pSrcChannel)
     property_get("persist.camera.longshot.save", prop, "0");
     mUseSaveProc = atoi(prop) > 0 ? true : false;
 
+    // reprocess requests are sent as soon as frames arrive, as many as the
+    // reprocess output has buffers for unless set explicitly
+    property_get("persist.camera.pp.inflight", prop, "0");
+    mPPInFlightMax = atoi(prop) > 0 ? atoi(prop) : 0;
+    if ((0 == mPPInFlightMax) && (NULL != m_pReprocChannel)) {
+        for (int i = 0; i < m_pReprocChannel->getNumOfStreams(); i++) {
+            QCameraStream *pStream = m_pReprocChannel->getStreamByIndex(i);
+            if ((NULL != pStream) && !pStream->isTypeOf(CAM_STREAM_TYPE_METADATA) &&
+                    (NULL != pStream->getStreamBufs())) {
+                uint32_t cnt = pStream->getStreamBufs()->getCnt();
+                if ((0 == mPPInFlightMax) || (cnt < mPPInFlightMax)) {
+                    mPPInFlightMax = cnt;
+                }
+            }
+        }
+    }
+    CDBG_HIGH("%s: reprocess requests in flight %d", __func__, mPPInFlightMax);
+
     m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_START_DATA_PROC, TRUE, FALSE);
     m_parent->m_cbNotifier.startSnapshots();
 
@@ -234,7 +334,7 @@ int32_t QCameraPostProcessor::start(QCameraChannel *pSrcChannel)
             !m_parent->isZSLMode()) {
 
         QCameraChannel *pChannel = NULL;
-        pChannel = m_parent->needReprocess() ? m_pReprocChannel : pSrcChannel;
+        pChannel = m_bNeedReprocess ? m_pReprocChannel : pSrcChannel;
         QCameraStream *pSnapshotStream = NULL;
         QCameraStream *pThumbStream = NULL;
 
@@ -292,11 +392,107 @@ int32_t QCameraPostProcessor::start(QCameraChannel *pSrcChannel)
             }
             mNewJpegSessionNeeded = false;
         }
+    } else if (m_parent->isZSLMode() &&
+            !m_parent->isLongshotEnabled() &&
+            !m_bNeedReprocess) {
+        // ZSL creates its session with the first frame, warm it up here
+        prewarmJpegSession(pSrcChannel);
     }
 
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : prewarmJpegSession
+ *
+ * DESCRIPTION: create a jpeg session for the streams of a ZSL channel and
+ *              leave it in the mm-jpeg session cache, so the session
+ *              encodeData creates with the first frame is already set up.
+ *              Stream selection mirrors queryStreams.
+ *
+ * PARAMETERS :
+ *   @pChannel : ZSL channel providing the frames to be encoded
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::prewarmJpegSession(QCameraChannel *pChannel)
+{
+    if (!mJpegSessionCache || (NULL == pChannel) ||
+            (NULL == mJpegHandle.prewarm_session)) {
+        return;
+    }
+
+    bool thumb_stream_needed =
+        (m_parent->mParameters.getFlipMode(CAM_STREAM_TYPE_SNAPSHOT) ==
+         m_parent->mParameters.getFlipMode(CAM_STREAM_TYPE_PREVIEW));
+    QCameraStream *pSnapshotStream = NULL;
+    QCameraStream *pThumbStream = NULL;
+
+    for (int i = 0; i < pChannel->getNumOfStreams(); ++i) {
+        QCameraStream *pStream = pChannel->getStreamByIndex(i);
+        if (NULL == pStream) {
+            break;
+        }
+        if (pStream->isTypeOf(CAM_STREAM_TYPE_SNAPSHOT) ||
+                pStream->isOrignalTypeOf(CAM_STREAM_TYPE_SNAPSHOT)) {
+            pSnapshotStream = pStream;
+        } else if (thumb_stream_needed &&
+                (pStream->isTypeOf(CAM_STREAM_TYPE_PREVIEW) ||
+                 pStream->isTypeOf(CAM_STREAM_TYPE_POSTVIEW) ||
+                 pStream->isOrignalTypeOf(CAM_STREAM_TYPE_PREVIEW) ||
+                 pStream->isOrignalTypeOf(CAM_STREAM_TYPE_POSTVIEW))) {
+            pThumbStream = pStream;
+        }
+    }
+
+    if (m_parent->mParameters.generateThumbFromMain()) {
+        pThumbStream = NULL;
+    }
+
+    if (NULL == pSnapshotStream) {
+        return;
+    }
+
+    mm_jpeg_encode_params_t encodeParam;
+    memset(&encodeParam, 0, sizeof(mm_jpeg_encode_params_t));
+    if (NO_ERROR != getJpegEncodingConfig(encodeParam, pSnapshotStream,
+            pThumbStream)) {
+        return;
+    }
+
+    CDBG_HIGH("[KPI Perf] %s : prewarm jpeg session", __func__);
+    if (mJpegHandle.prewarm_session(mJpegClientHandle, &encodeParam) != 0) {
+        CDBG_HIGH("%s: jpeg session not prewarmed", __func__);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : invalidateJpegSessionCache
+ *
+ * DESCRIPTION: called when buffers a jpeg session may be bound to are freed.
+ *              Moves to a new buffer generation so no session set up with
+ *              the old buffers is reused, and releases the sessions mm-jpeg
+ *              keeps warm together with their OMX instances.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::invalidateJpegSessionCache()
+{
+    if (!mJpegSessionCache) {
+        return;
+    }
+
+    // generation 0 tells mm-jpeg not to cache the session
+    if (0 == ++m_JpegBufGeneration) {
+        m_JpegBufGeneration = 1;
+    }
+    if ((mJpegClientHandle > 0) && (NULL != mJpegHandle.flush_session_cache)) {
+        mJpegHandle.flush_session_cache(mJpegClientHandle);
+    }
+}
+
 /*===========================================================================
  * FUNCTION   : stop
  *
@@ -313,14 +509,245 @@ int32_t QCameraPostProcessor::start(QCameraChannel *pSrcChannel)
 int32_t QCameraPostProcessor::stop()
 {
     if (m_bInited == TRUE) {
+        // no more frame requests once the capture is being torn down
+        resetCaptureCredits();
         m_parent->m_cbNotifier.stopSnapshots();
         // dataProc Thread need to process "stop" as sync call because abort jpeg job should be a sync call
         m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_STOP_DATA_PROC, TRUE, TRUE);
+        m_bNeedReprocess = false;
+
+        pthread_mutex_lock(&mCreditLock);
+        if (mPipeStats.shots > 0) {
+            uint32_t rate = 0; // shots per 100 sec
+            if ((mPipeStats.shots > 1) &&
+                    (mPipeStats.lastDone > mPipeStats.firstDone)) {
+                rate = (uint32_t)((int64_t)(mPipeStats.shots - 1) *
+                    100000000000LL / (mPipeStats.lastDone - mPipeStats.firstDone));
+            }
+            CDBG_HIGH("[KPI Perf] %s: capture pipeline %d shots, sustained "
+                "%d.%02d shots/s, peak %d frames in flight (%d KB), "
+                "peak depth pp %d jpeg %d save %d, %d requests deferred, "
+                "%d reprocess results out of order",
+                __func__, mPipeStats.shots, rate / 100, rate % 100,
+                mPipeStats.peakFrames,
+                mPipeStats.peakFrames * (mPipeStats.frameLen / 1024),
+                mPipeStats.peakPP, mPipeStats.peakJpeg, mPipeStats.peakSave,
+                mPipeStats.deferred, mPipeStats.ppOutOfOrder);
+        }
+        if ((mPipeStats.rawShared + mPipeStats.rawCopied) > 0) {
+            CDBG_HIGH("[KPI Perf] %s: raw/yuv callbacks %d shared (%lld KB), "
+                "%d copied (%lld KB), %d frames still held",
+                __func__, mPipeStats.rawShared,
+                (long long)(mPipeStats.rawSharedBytes / 1024),
+                mPipeStats.rawCopied,
+                (long long)(mPipeStats.rawCopiedBytes / 1024),
+                mRawFramesHeld);
+        }
+        if ((mPipeStats.jpegShared + mPipeStats.jpegCopied) > 0) {
+            CDBG_HIGH("[KPI Perf] %s: jpeg callbacks %d in encoder output "
+                "(%lld KB), %d copied (%lld KB)",
+                __func__, mPipeStats.jpegShared,
+                (long long)(mPipeStats.jpegSharedBytes / 1024),
+                mPipeStats.jpegCopied,
+                (long long)(mPipeStats.jpegCopiedBytes / 1024));
+        }
+        memset(&mPipeStats, 0, sizeof(mPipeStats));
+        pthread_mutex_unlock(&mCreditLock);
     }
 
     return NO_ERROR;
 }
 
+/*===========================================================================
+ * FUNCTION   : requestCaptureFrames
+ *
+ * DESCRIPTION: request capture frames from the pic channel against the
+ *              capture credits. Frames beyond the credits are held back
+ *              and requested once reprocess, encode or save drains, so a
+ *              longshot can not pile up more buffers than the pipeline
+ *              can take while jpeg lags behind the sensor.
+ *
+ * PARAMETERS :
+ *   @pChannel : pic channel to request the frames from
+ *   @num      : number of frames
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraPostProcessor::requestCaptureFrames(QCameraPicChannel *pChannel,
+                                                   uint8_t num)
+{
+    int32_t rc = NO_ERROR;
+
+    if (NULL == pChannel) {
+        ALOGE("%s: invalid channel", __func__);
+        return BAD_VALUE;
+    }
+
+    pthread_mutex_lock(&mCreditLock);
+    m_pCreditChannel = pChannel;
+    mDeferredRequests += num;
+    pthread_mutex_unlock(&mCreditLock);
+
+    rc = issueCaptureRequests();
+
+    pthread_mutex_lock(&mCreditLock);
+    if (mDeferredRequests > 0) {
+        mPipeStats.deferred++;
+        CDBG_HIGH("%s: %d frames wait for capture credits, %d pending",
+            __func__, mDeferredRequests, mPendingRequests);
+    }
+    pthread_mutex_unlock(&mCreditLock);
+
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : getFramesInFlight
+ *
+ * DESCRIPTION: number of frames currently held by the pipeline stages
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : frames in reprocess, encode, raw and save stages
+ *==========================================================================*/
+uint32_t QCameraPostProcessor::getFramesInFlight()
+{
+    return getPPBacklog() + getJpegBacklog() +
+        m_inputRawQ.getCurrentSize() + m_inputSaveQ.getCurrentSize();
+}
+
+/*===========================================================================
+ * FUNCTION   : issueCaptureRequests
+ *
+ * DESCRIPTION: request the frames waiting for credits, as many as the
+ *              pipeline has room for. A new request is only sent once the
+ *              previous one has been delivered, since the channel takes
+ *              the count of a request as its new pending count. The
+ *              counters are updated under mCreditLock, the request itself
+ *              goes to the channel without it.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraPostProcessor::issueCaptureRequests()
+{
+    int32_t rc = NO_ERROR;
+    QCameraPicChannel *pChannel = NULL;
+
+    pthread_mutex_lock(&mCreditLock);
+    if ((NULL == m_pCreditChannel) || (0 == mDeferredRequests) ||
+            (mPendingRequests > 0) || mIssuingRequests) {
+        pthread_mutex_unlock(&mCreditLock);
+        return NO_ERROR;
+    }
+
+    uint32_t num = mDeferredRequests;
+    if (mCaptureCredits > 0) {
+        uint32_t inFlight = getFramesInFlight();
+        if (inFlight >= mCaptureCredits) {
+            pthread_mutex_unlock(&mCreditLock);
+            return NO_ERROR;
+        }
+        if (num > mCaptureCredits - inFlight) {
+            num = mCaptureCredits - inFlight;
+        }
+    }
+
+    if (num > 0xFF) {
+        // the channel takes an 8 bit count
+        num = 0xFF;
+    }
+    // book the frames before the lock is dropped, frames can arrive
+    // before takePicture returns
+    pChannel = m_pCreditChannel;
+    mDeferredRequests -= num;
+    mPendingRequests = num;
+    mIssuingRequests = true;
+    pthread_mutex_unlock(&mCreditLock);
+
+    rc = pChannel->takePicture((uint8_t)num, 0);
+
+    pthread_mutex_lock(&mCreditLock);
+    if (NO_ERROR != rc) {
+        ALOGE("%s: cannot request %d capture frames, rc = %d",
+            __func__, num, rc);
+        if (m_pCreditChannel == pChannel) {
+            // nothing is coming, the waiting requests go as well
+            mPendingRequests = 0;
+            mDeferredRequests = 0;
+        }
+    }
+    mIssuingRequests = false;
+    pthread_cond_broadcast(&mCreditCond);
+    pthread_mutex_unlock(&mCreditLock);
+
+    return rc;
+}
+
+/*===========================================================================
+ * FUNCTION   : updateCaptureCredits
+ *
+ * DESCRIPTION: sample the stage depths after a stage made progress, keep
+ *              the peaks and hand freed credits to waiting requests
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::updateCaptureCredits()
+{
+    uint32_t pp = getPPBacklog();
+    uint32_t jpeg = getJpegBacklog();
+    uint32_t save = m_inputSaveQ.getCurrentSize();
+    uint32_t frames = pp + jpeg + save + m_inputRawQ.getCurrentSize();
+
+    pthread_mutex_lock(&mCreditLock);
+    frames += mRawFramesHeld;
+    if (pp > mPipeStats.peakPP) {
+        mPipeStats.peakPP = pp;
+    }
+    if (jpeg > mPipeStats.peakJpeg) {
+        mPipeStats.peakJpeg = jpeg;
+    }
+    if (save > mPipeStats.peakSave) {
+        mPipeStats.peakSave = save;
+    }
+    if (frames > mPipeStats.peakFrames) {
+        mPipeStats.peakFrames = frames;
+    }
+    pthread_mutex_unlock(&mCreditLock);
+
+    issueCaptureRequests();
+}
+
+/*===========================================================================
+ * FUNCTION   : resetCaptureCredits
+ *
+ * DESCRIPTION: drop waiting and pending frame requests. Waits for a
+ *              request being sent to the channel, so the channel is not
+ *              used anymore once this returns.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::resetCaptureCredits()
+{
+    pthread_mutex_lock(&mCreditLock);
+    while (mIssuingRequests) {
+        pthread_cond_wait(&mCreditCond, &mCreditLock);
+    }
+    m_pCreditChannel = NULL;
+    mPendingRequests = 0;
+    mDeferredRequests = 0;
+    pthread_mutex_unlock(&mCreditLock);
+}
+
 /*===========================================================================
  * FUNCTION   : getJpegEncodingConfig
  *
@@ -340,6 +767,9 @@ int32_t QCameraPostProcessor::getJpegEncodingConfig(mm_jpeg_encode_params_t& enc
     CDBG("%s : E", __func__);
     int32_t ret = NO_ERROR;
     uint32_t out_size;
+    bool streamSave;
+    uint32_t num_out_mem;
+    bool outMemChanged = false;
 
     char prop[PROPERTY_VALUE_MAX];
     property_get("persist.camera.jpeg_burst", prop, "0");
@@ -481,21 +911,67 @@ int32_t QCameraPostProcessor::getJpegEncodingConfig(mm_jpeg_encode_params_t& enc
     if (mUseJpegBurst) {
         encode_parm.num_dst_bufs = MAX_JPEG_BURST;
     }
+    // streamed jpegs go to file chunk by chunk, so they need the
+    // encoder output in plain buffers rather than in callback memory
+    streamSave = mJpegStreaming && mUseSaveProc &&
+            m_parent->isLongshotEnabled();
+    encode_parm.jpeg_chunk_cb = streamSave ? mJpegChunkCB : NULL;
+    // thumbnail first pairs each thumbnail with the next main image,
+    // so it needs jobs that complete one at a time
+    bool thumbFirst = mThumbFirst && m_bThumbnailNeeded &&
+            !mUseJpegBurst && !streamSave && !m_parent->isLongshotEnabled();
+    // read by the jpeg callbacks, see isThumbFirstSession()
+    pthread_mutex_lock(&mThumbLock);
+    mThumbFirstSession = thumbFirst;
+    pthread_mutex_unlock(&mThumbLock);
+    if (thumbFirst) {
+        encode_parm.encode_thumbnail = FALSE;
+    }
     encode_parm.get_memory = NULL;
     out_size = main_offset.frame_len;
-    if (mJpegMemOpt) {
+    if (mJpegMemOpt && !streamSave) {
         encode_parm.get_memory = getJpegMemory;
         out_size = sizeof(omx_jpeg_ouput_buf_t);
         encode_parm.num_dst_bufs = encode_parm.num_src_bufs;
     }
-    m_JpegOutputMemCount = encode_parm.num_dst_bufs;
+    // without mem opt mm-jpeg allocates each output to the size of the
+    // image instead of a frame_len buffer per slot. Longshot keeps plain
+    // buffers since the save thread outlives the jpeg event.
+    mJpegAutoOutBuf = (NULL == encode_parm.get_memory) && !streamSave &&
+            !m_parent->isLongshotEnabled() &&
+            (NULL != mJpegHandle.release_out_buf);
+    // release output bufs the new config no longer uses
+    num_out_mem = mJpegAutoOutBuf ? 0 : encode_parm.num_dst_bufs;
+    for (int i = num_out_mem; i < (int)m_JpegOutputMemCount; i++) {
+        if (m_pJpegOutputMem[i] != NULL) {
+            free(m_pJpegOutputMem[i]);
+            m_pJpegOutputMem[i] = NULL;
+            outMemChanged = true;
+        }
+    }
+    m_JpegOutputMemCount = num_out_mem;
+    for (int i = 0; mJpegAutoOutBuf && (i < (int)encode_parm.num_dst_bufs); i++) {
+        encode_parm.dest_buf[i].index = i;
+        encode_parm.dest_buf[i].buf_size = 0;
+        encode_parm.dest_buf[i].buf_vaddr = NULL;
+        encode_parm.dest_buf[i].fd = 0;
+        encode_parm.dest_buf[i].format = MM_JPEG_FMT_YUV;
+        encode_parm.dest_buf[i].offset = main_offset;
+    }
     for (int i = 0; i < (int)m_JpegOutputMemCount; i++) {
-        if (m_pJpegOutputMem[i] != NULL)
-          free(m_pJpegOutputMem[i]);
+        // output bufs of the same size are kept, a cached jpeg session
+        // is only reused when it is bound to the same buffers
+        if ((m_pJpegOutputMem[i] != NULL) && (out_size != m_JpegOutputMemSize)) {
+            free(m_pJpegOutputMem[i]);
+            m_pJpegOutputMem[i] = NULL;
+        }
         omx_jpeg_ouput_buf_t omx_out_buf;
         omx_out_buf.handle = this;
         // allocate output buf for jpeg encoding
-        m_pJpegOutputMem[i] = malloc(out_size);
+        if (NULL == m_pJpegOutputMem[i]) {
+            m_pJpegOutputMem[i] = malloc(out_size);
+            outMemChanged = true;
+        }
 
         if (NULL == m_pJpegOutputMem[i]) {
           ret = NO_MEMORY;
@@ -503,7 +979,7 @@ int32_t QCameraPostProcessor::getJpegEncodingConfig(mm_jpeg_encode_params_t& enc
           goto on_error;
         }
 
-        if (mJpegMemOpt) {
+        if (NULL != encode_parm.get_memory) {
             memcpy(m_pJpegOutputMem[i], &omx_out_buf, sizeof(omx_out_buf));
         }
 
@@ -515,6 +991,13 @@ int32_t QCameraPostProcessor::getJpegEncodingConfig(mm_jpeg_encode_params_t& enc
         encode_parm.dest_buf[i].format = MM_JPEG_FMT_YUV;
         encode_parm.dest_buf[i].offset = main_offset;
     }
+    m_JpegOutputMemSize = out_size;
+
+    // a new output buf may sit at the address of a freed one
+    if (outMemChanged) {
+        invalidateJpegSessionCache();
+    }
+    encode_parm.buf_generation = mJpegSessionCache ? m_JpegBufGeneration : 0;
 
 
     CDBG("%s : X", __func__);
@@ -587,7 +1070,9 @@ int32_t QCameraPostProcessor::sendDataNotify(int32_t msg_type,
 
     qcamera_callback_argm_t cbArg;
     memset(&cbArg, 0, sizeof(qcamera_callback_argm_t));
-    cbArg.cb_type = QCAMERA_DATA_SNAPSHOT_CALLBACK;
+    // only compressed images count towards the expected snapshots
+    cbArg.cb_type = (CAMERA_MSG_COMPRESSED_IMAGE == msg_type) ?
+        QCAMERA_DATA_SNAPSHOT_CALLBACK : QCAMERA_DATA_CALLBACK;
     cbArg.msg_type = msg_type;
     cbArg.data = data;
     cbArg.metadata = metadata;
@@ -626,7 +1111,18 @@ int32_t QCameraPostProcessor::processData(mm_camera_super_buf_t *frame)
         return UNKNOWN_ERROR;
     }
 
-    if (m_parent->needReprocess()) {
+    uint32_t frameLen = 0;
+    for (int i = 0; i < frame->num_bufs; i++) {
+        frameLen += frame->bufs[i]->frame_len;
+    }
+    pthread_mutex_lock(&mCreditLock);
+    if (mPendingRequests > 0) {
+        mPendingRequests--;
+    }
+    mPipeStats.frameLen = frameLen;
+    pthread_mutex_unlock(&mCreditLock);
+
+    if (m_bNeedReprocess) {
         if ((!m_parent->isLongshotEnabled() &&
              !m_parent->m_stateMachine.isNonZSLCaptureRunning()) ||
             (m_parent->isLongshotEnabled() &&
@@ -682,6 +1178,7 @@ int32_t QCameraPostProcessor::processData(mm_camera_super_buf_t *frame)
         m_inputJpegQ.enqueue((void *)jpeg_job);
     }
     m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+    updateCaptureCredits();
 
     return NO_ERROR;
 }
@@ -737,7 +1234,26 @@ int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
 
     int32_t rc = NO_ERROR;
     camera_memory_t *jpeg_mem = NULL;
+    camera_memory_t *thumb_jpeg_mem = NULL;
     omx_jpeg_ouput_buf_t *jpeg_out = NULL;
+    uint8_t *auto_out = NULL;
+    uint32_t copied_len = 0;
+
+    // thumbnail first jobs do not hold up the data proc thread
+    if (processJpegThumbEvt(evt)) {
+        return NO_ERROR;
+    }
+
+    if (!evt->partial && (evt->status != JPEG_JOB_STATUS_ERROR)) {
+        nsecs_t now = systemTime();
+        pthread_mutex_lock(&mCreditLock);
+        if (0 == mPipeStats.shots) {
+            mPipeStats.firstDone = now;
+        }
+        mPipeStats.lastDone = now;
+        mPipeStats.shots++;
+        pthread_mutex_unlock(&mCreditLock);
+    }
 
     if (mUseSaveProc && m_parent->isLongshotEnabled()) {
         qcamera_jpeg_evt_payload_t *saveData = ( qcamera_jpeg_evt_payload_t * ) malloc(sizeof(qcamera_jpeg_evt_payload_t));
@@ -754,10 +1270,28 @@ int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
 
         CDBG_HIGH("[KPI Perf] %s : jpeg job %d", __func__, evt->jobId);
 
+        // With jpeg mem opt the encoder writes straight into callback
+        // memory and out_data only carries the descriptor of it. Take
+        // ownership first so that every path below can release it.
+        if (mJpegMemOpt && (evt->status != JPEG_JOB_STATUS_ERROR)) {
+            jpeg_out  = (omx_jpeg_ouput_buf_t*) evt->out_data.buf_vaddr;
+            if (NULL != jpeg_out) {
+                jpeg_mem = (camera_memory_t *)jpeg_out->mem_hdl;
+            }
+        }
+        // auto sized output is held until given back at the end
+        if (mJpegAutoOutBuf && (evt->status != JPEG_JOB_STATUS_ERROR)) {
+            auto_out = evt->out_data.buf_vaddr;
+        }
+
         if (m_parent->mDataCb == NULL ||
             m_parent->msgTypeEnabledWithLock(CAMERA_MSG_COMPRESSED_IMAGE) == 0 ) {
             CDBG_HIGH("%s: No dataCB or CAMERA_MSG_COMPRESSED_IMAGE not enabled",
                   __func__);
+            if (NULL != jpeg_mem) {
+                jpeg_mem->release(jpeg_mem);
+                jpeg_mem = NULL;
+            }
             rc = NO_ERROR;
             goto end;
         }
@@ -769,17 +1303,60 @@ int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
             goto end;
         }
 
-        m_parent->dumpJpegToFile(evt->out_data.buf_vaddr,
-                                  evt->out_data.buf_filled_len,
-                                  evt->jobId);
+        if (mJpegMemOpt && (NULL == jpeg_mem)) {
+            ALOGE("%s: No output memory from jpeg encoder", __func__);
+            rc = NO_MEMORY;
+            goto end;
+        }
+
+        if (isThumbFirstSession()) {
+            // add the thumbnail encoded ahead of this image, in place if
+            // getJpegMemory left room for it ahead of the image
+            uint32_t room = takeJpegThumbnailRoom(jpeg_mem);
+            if (NULL != jpeg_mem) {
+                thumb_jpeg_mem = insertJpegThumbnail(
+                        (uint8_t *)jpeg_mem->data + room,
+                        jpeg_mem->size - room, (0 < room) ? jpeg_mem : NULL);
+            } else {
+                thumb_jpeg_mem = insertJpegThumbnail(evt->out_data.buf_vaddr,
+                        evt->out_data.buf_filled_len, NULL);
+            }
+            if ((NULL == thumb_jpeg_mem) && (0 < room)) {
+                // no thumbnail after all, the room has to go
+                thumb_jpeg_mem = m_parent->mGetMemory(-1,
+                        jpeg_mem->size - room, 1, m_parent->mCallbackCookie);
+                if (NULL == thumb_jpeg_mem) {
+                    ALOGE("%s: no memory for jpeg", __func__);
+                    jpeg_mem->release(jpeg_mem);
+                    jpeg_mem = NULL;
+                    rc = NO_MEMORY;
+                    goto end;
+                }
+                memcpy(thumb_jpeg_mem->data, (uint8_t *)jpeg_mem->data + room,
+                       thumb_jpeg_mem->size);
+            }
+            if ((NULL != thumb_jpeg_mem) && (thumb_jpeg_mem != jpeg_mem)) {
+                if (NULL != jpeg_mem) {
+                    jpeg_mem->release(jpeg_mem);
+                }
+                jpeg_mem = thumb_jpeg_mem;
+                copied_len = jpeg_mem->size;
+            }
+        }
+
+        if (NULL != jpeg_mem) {
+            m_parent->dumpJpegToFile(jpeg_mem->data, jpeg_mem->size, evt->jobId);
+        } else {
+            m_parent->dumpJpegToFile(evt->out_data.buf_vaddr,
+                                      evt->out_data.buf_filled_len,
+                                      evt->jobId);
+        }
         CDBG_HIGH("%s: Dump jpeg_size=%d", __func__, evt->out_data.buf_filled_len);
 
         /* check if the all the captures are done */
         if (m_parent->mParameters.isUbiRefocus() &&
             (m_parent->getOutputImageCount() <
             m_parent->mParameters.UfOutputCount())) {
-            jpeg_out  = (omx_jpeg_ouput_buf_t*) evt->out_data.buf_vaddr;
-            jpeg_mem = (camera_memory_t *)jpeg_out->mem_hdl;
             if (NULL != jpeg_mem) {
                 jpeg_mem->release(jpeg_mem);
                 jpeg_mem = NULL;
@@ -787,7 +1364,7 @@ int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
             goto end;
         }
 
-        if (!mJpegMemOpt) {
+        if (NULL == jpeg_mem) {
             // alloc jpeg memory to pass to upper layer
             jpeg_mem = m_parent->mGetMemory(-1, evt->out_data.buf_filled_len,
                 1, m_parent->mCallbackCookie);
@@ -797,10 +1374,20 @@ int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
                 goto end;
             }
             memcpy(jpeg_mem->data, evt->out_data.buf_vaddr, evt->out_data.buf_filled_len);
+            copied_len = evt->out_data.buf_filled_len;
+        }
+
+        pthread_mutex_lock(&mCreditLock);
+        if (0 < copied_len) {
+            mPipeStats.jpegCopied++;
+            mPipeStats.jpegCopiedBytes += copied_len;
         } else {
-            jpeg_out  = (omx_jpeg_ouput_buf_t*) evt->out_data.buf_vaddr;
-            jpeg_mem = (camera_memory_t *)jpeg_out->mem_hdl;
+            mPipeStats.jpegShared++;
+            mPipeStats.jpegSharedBytes += jpeg_mem->size;
         }
+        pthread_mutex_unlock(&mCreditLock);
+        CDBG_HIGH("[KPI Perf] %s: jpeg job %d copied %d bytes", __func__,
+                  evt->jobId, copied_len);
 
         CDBG_HIGH("%s : Calling upperlayer callback to store JPEG image", __func__);
         qcamera_release_data_t release_data;
@@ -814,6 +1401,14 @@ int32_t QCameraPostProcessor::processJpegEvt(qcamera_jpeg_evt_payload_t *evt)
                             &release_data);
 
 end:
+        // a thumbnail left over must not end up in the next image
+        dropJpegThumbnail();
+
+        if (NULL != auto_out) {
+            mJpegHandle.release_out_buf(auto_out);
+            auto_out = NULL;
+        }
+
         if (rc != NO_ERROR) {
             // send error msg to upper layer
             sendEvtNotify(CAMERA_MSG_ERROR,
@@ -830,10 +1425,70 @@ end:
     // wait up data proc thread to do next job,
     // if previous request is blocked due to ongoing jpeg job
     m_dataProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+    updateCaptureCredits();
 
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : processJpegChunk
+ *
+ * DESCRIPTION: process partial output of a streaming jpeg encode. The chunk
+ *              is copied, since the encoder may reuse its output buffer for
+ *              the next job before the save thread gets to it.
+ *
+ * PARAMETERS :
+ *   @jobId   : job Id of the jpeg encoding
+ *   @p_chunk : new bytes of the jpeg output
+ *   @offset  : file offset of the chunk
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraPostProcessor::processJpegChunk(uint32_t jobId,
+                                               mm_jpeg_output_t *p_chunk,
+                                               uint32_t offset)
+{
+    if (m_bInited == FALSE) {
+        ALOGE("%s: postproc not initialized yet", __func__);
+        return UNKNOWN_ERROR;
+    }
+
+    // chunk data lives right behind the payload, so that flushing the
+    // save queue releases both
+    qcamera_jpeg_evt_payload_t *chunk = (qcamera_jpeg_evt_payload_t *)
+            malloc(sizeof(qcamera_jpeg_evt_payload_t) + p_chunk->buf_filled_len);
+    if (NULL != chunk) {
+        memset(chunk, 0, sizeof(qcamera_jpeg_evt_payload_t));
+        chunk->out_data.buf_vaddr = (uint8_t *)(chunk + 1);
+        chunk->out_data.buf_filled_len = p_chunk->buf_filled_len;
+        memcpy(chunk->out_data.buf_vaddr, p_chunk->buf_vaddr,
+               p_chunk->buf_filled_len);
+        pthread_mutex_lock(&mCreditLock);
+        mPipeStats.jpegCopiedBytes += p_chunk->buf_filled_len;
+        pthread_mutex_unlock(&mCreditLock);
+    } else {
+        // the save thread still has to learn the job is streamed
+        ALOGE("%s: Can not allocate jpeg chunk of %d bytes",
+              __func__, p_chunk->buf_filled_len);
+        chunk = (qcamera_jpeg_evt_payload_t *)
+                malloc(sizeof(qcamera_jpeg_evt_payload_t));
+        if (NULL == chunk) {
+            return NO_MEMORY;
+        }
+        memset(chunk, 0, sizeof(qcamera_jpeg_evt_payload_t));
+    }
+    chunk->jobId = jobId;
+    chunk->status = JPEG_JOB_STATUS_DONE;
+    chunk->partial = true;
+    chunk->offset = offset;
+
+    m_inputSaveQ.enqueue((void *)chunk);
+    m_saveProcTh.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, FALSE, FALSE);
+    return NO_ERROR;
+}
+
 /*===========================================================================
  * FUNCTION   : processPPData
  *
@@ -856,7 +1511,26 @@ int32_t QCameraPostProcessor::processPPData(mm_camera_super_buf_t *frame)
         return UNKNOWN_ERROR;
     }
 
-    qcamera_pp_data_t *job = (qcamera_pp_data_t *)m_ongoingPPQ.dequeue();
+    // several reprocess requests are in flight and the backend may finish
+    // them out of order, match the output to its source by frame idx
+    qcamera_pp_data_t *job = NULL;
+    if (frame->num_bufs > 0) {
+        qcamera_pp_match_t match;
+        match.frame_idx = frame->bufs[0]->frame_idx;
+        match.skipped = 0;
+        job = (qcamera_pp_data_t *)m_ongoingPPQ.dequeue(matchPPFrame, &match);
+        if ((NULL != job) && (match.skipped > 0)) {
+            CDBG("%s: reprocess of frame %d done ahead of %d older",
+                __func__, match.frame_idx, match.skipped);
+            pthread_mutex_lock(&mCreditLock);
+            mPipeStats.ppOutOfOrder++;
+            pthread_mutex_unlock(&mCreditLock);
+        }
+    }
+    if (NULL == job) {
+        // output carries no source frame idx, results come in order
+        job = (qcamera_pp_data_t *)m_ongoingPPQ.dequeue();
+    }
 
     if (!needSuperBufMatch && (job == NULL || job->src_frame == NULL) ) {
         ALOGE("%s: Cannot find reprocess job", __func__);
@@ -1070,6 +1744,15 @@ void QCameraPostProcessor::releaseNotifyData(void *user_data,
             postProc->releaseSuperBuf(app_cb->release_data.frame);
             free(app_cb->release_data.frame);
             app_cb->release_data.frame = NULL;
+            if (app_cb->release_data.rawHeld) {
+                pthread_mutex_lock(&postProc->mCreditLock);
+                if (postProc->mRawFramesHeld > 0) {
+                    postProc->mRawFramesHeld--;
+                }
+                pthread_mutex_unlock(&postProc->mCreditLock);
+                // a held frame may be what waiting longshot requests need
+                postProc->updateCaptureCredits();
+            }
         }
         if (app_cb && NULL != app_cb->release_data.streamBufs) {
             app_cb->release_data.streamBufs->deallocate();
@@ -1739,52 +2422,423 @@ int32_t QCameraPostProcessor::encodeData(qcamera_jpeg_data_t *jpeg_job_data,
         jpg_job.encode_job.qtable_set[i] = 0;
     }
 
+    bool thumbFirst = isThumbFirstSession();
+    if (thumbFirst && (m_bThumbnailNeeded == TRUE) &&
+        (thumb_frame != NULL)) {
+        // the thumbnail is rotated by the encoder unless it comes from
+        // a main frame that is rotated by reprocess already
+        int thumb_rotation = 0;
+        if (!m_parent->needRotationReprocess() || (thumb_frame != main_frame)) {
+            thumb_rotation = jpeg_rotation;
+        }
+        // without the thumbnail the main image just goes out without one
+        encodeThumbnailFirst(thumb_stream, jpg_job.encode_job, thumb_rotation);
+    }
+
     CDBG_HIGH("[KPI Perf] %s : PROFILE_JPEG_JOB_START", __func__);
     ret = mJpegHandle.start_job(&jpg_job, &jobId);
     if (ret == NO_ERROR) {
         // remember job info
         jpeg_job_data->jobId = jobId;
+    } else if (thumbFirst) {
+        dropJpegThumbnail();
     }
 
     return ret;
 }
 
 /*===========================================================================
- * FUNCTION   : processRawImageImpl
+ * FUNCTION   : encodeThumbnailFirst
  *
- * DESCRIPTION: function to send raw image to upper layer
+ * DESCRIPTION: encode the thumbnail of a capture as a separate jpeg ahead of
+ *              the main image. The thumbnail session is kept until the
+ *              source stream or the thumbnail config changes.
  *
  * PARAMETERS :
- *   @recvd_frame   : frame to be encoded
+ *   @thumb_stream : stream the thumbnail frame comes from
+ *   @main_job     : encode job of the main image
+ *   @rotation     : rotation to apply to the thumbnail
  *
  * RETURN     : int32_t type of status
  *              NO_ERROR  -- success
  *              none-zero failure code
  *==========================================================================*/
-int32_t QCameraPostProcessor::processRawImageImpl(mm_camera_super_buf_t *recvd_frame)
+int32_t QCameraPostProcessor::encodeThumbnailFirst(QCameraStream *thumb_stream,
+                                                   const mm_jpeg_encode_job_t &main_job,
+                                                   int rotation)
 {
-    int32_t rc = NO_ERROR;
+    int32_t ret = NO_ERROR;
+    uint32_t jobId = 0;
+    const mm_jpeg_dim_t &thumb_dim = main_job.thumb_dim;
 
-    QCameraChannel *pChannel = m_parent->getChannelByHandle(recvd_frame->ch_id);
-    QCameraStream *pStream = NULL;
-    mm_camera_buf_def_t *frame = NULL;
-    // check reprocess channel if not found
-    if (pChannel == NULL) {
-        if (m_pReprocChannel != NULL &&
-            m_pReprocChannel->getMyHandle() == recvd_frame->ch_id) {
-            pChannel = m_pReprocChannel;
-        }
-    }
-    if (pChannel == NULL) {
-        ALOGE("%s:%d] No corresponding channel (ch_id = %d) exist, return here",
-              __func__, __LINE__, recvd_frame->ch_id);
-        return BAD_VALUE;
+    if ((0 < mJpegThumbSessionId) &&
+        ((mJpegThumbSrcStream != thumb_stream) ||
+         (mJpegThumbRotation != rotation) ||
+         (mJpegThumbDim.src_dim.width != thumb_dim.src_dim.width) ||
+         (mJpegThumbDim.src_dim.height != thumb_dim.src_dim.height) ||
+         (mJpegThumbDim.dst_dim.width != thumb_dim.dst_dim.width) ||
+         (mJpegThumbDim.dst_dim.height != thumb_dim.dst_dim.height))) {
+        destroyJpegThumbSession();
     }
 
-    // find snapshot frame
-    for (int i = 0; i < recvd_frame->num_bufs; i++) {
-        QCameraStream *pCurStream =
-            pChannel->getStreamByHandle(recvd_frame->bufs[i]->stream_id);
+    if (0 == mJpegThumbSessionId) {
+        mm_jpeg_encode_params_t encodeParam;
+        memset(&encodeParam, 0, sizeof(mm_jpeg_encode_params_t));
+
+        QCameraMemory *pStreamMem = thumb_stream->getStreamBufs();
+        if (pStreamMem == NULL) {
+            ALOGE("%s: cannot get stream bufs from thumb stream", __func__);
+            return BAD_VALUE;
+        }
+        cam_frame_len_offset_t thumb_offset;
+        memset(&thumb_offset, 0, sizeof(cam_frame_len_offset_t));
+        thumb_stream->getFrameOffset(thumb_offset);
+        encodeParam.num_src_bufs = pStreamMem->getCnt();
+        for (uint32_t i = 0; i < encodeParam.num_src_bufs; i++) {
+            camera_memory_t *stream_mem = pStreamMem->getMemory(i, false);
+            if (stream_mem != NULL) {
+                encodeParam.src_main_buf[i].index = i;
+                encodeParam.src_main_buf[i].buf_size = stream_mem->size;
+                encodeParam.src_main_buf[i].buf_vaddr = (uint8_t *)stream_mem->data;
+                encodeParam.src_main_buf[i].fd = pStreamMem->getFd(i);
+                encodeParam.src_main_buf[i].format = MM_JPEG_FMT_YUV;
+                encodeParam.src_main_buf[i].offset = thumb_offset;
+            }
+        }
+
+        cam_format_t img_fmt = CAM_FORMAT_YUV_420_NV12;
+        thumb_stream->getFormat(img_fmt);
+        encodeParam.color_format = getColorfmtFromImgFmt(img_fmt);
+        encodeParam.quality = m_parent->mParameters.getInt(
+                QCameraParameters::KEY_JPEG_THUMBNAIL_QUALITY);
+        if (encodeParam.quality <= 0) {
+            encodeParam.quality = 85;
+        }
+        encodeParam.encode_thumbnail = FALSE;
+        encodeParam.main_dim = thumb_dim;
+        encodeParam.rotation = rotation;
+        encodeParam.jpeg_cb = mJpegCB;
+        encodeParam.userdata = mJpegUserData;
+
+        // the thumbnail is small, a plain output buf is cheaper than
+        // going through callback memory
+        if ((m_pJpegThumbOutputMem != NULL) &&
+            (m_JpegThumbOutputMemSize != thumb_offset.frame_len)) {
+            free(m_pJpegThumbOutputMem);
+            m_pJpegThumbOutputMem = NULL;
+        }
+        if (m_pJpegThumbOutputMem == NULL) {
+            m_pJpegThumbOutputMem = malloc(thumb_offset.frame_len);
+        }
+        if (m_pJpegThumbOutputMem == NULL) {
+            ALOGE("%s : no mem for thumbnail jpeg", __func__);
+            return NO_MEMORY;
+        }
+        m_JpegThumbOutputMemSize = thumb_offset.frame_len;
+        encodeParam.num_dst_bufs = 1;
+        encodeParam.dest_buf[0].index = 0;
+        encodeParam.dest_buf[0].buf_size = m_JpegThumbOutputMemSize;
+        encodeParam.dest_buf[0].buf_vaddr = (uint8_t *)m_pJpegThumbOutputMem;
+        encodeParam.dest_buf[0].fd = 0;
+        encodeParam.dest_buf[0].format = MM_JPEG_FMT_YUV;
+        encodeParam.dest_buf[0].offset = thumb_offset;
+
+        ret = mJpegHandle.create_session(mJpegClientHandle, &encodeParam,
+                &mJpegThumbSessionId);
+        if (ret != NO_ERROR) {
+            ALOGE("%s: error creating thumbnail jpeg session", __func__);
+            mJpegThumbSessionId = 0;
+            return ret;
+        }
+        mJpegThumbSrcStream = thumb_stream;
+        mJpegThumbDim = thumb_dim;
+        mJpegThumbRotation = rotation;
+    }
+
+    mm_jpeg_job_t thumb_job;
+    memset(&thumb_job, 0, sizeof(mm_jpeg_job_t));
+    thumb_job.job_type = JPEG_JOB_TYPE_ENCODE;
+    thumb_job.encode_job.session_id = mJpegThumbSessionId;
+    thumb_job.encode_job.src_index = main_job.thumb_index;
+    thumb_job.encode_job.dst_index = 0;
+    thumb_job.encode_job.main_dim = thumb_dim;
+    thumb_job.encode_job.rotation = rotation;
+    thumb_job.encode_job.hal_version = CAM_HAL_V1;
+    thumb_job.encode_job.high_priority = TRUE;
+
+    pthread_mutex_lock(&mThumbLock);
+    mThumbStartTime = systemTime();
+    ret = mJpegHandle.start_job(&thumb_job, &jobId);
+    if (ret == NO_ERROR) {
+        mThumbJobId = jobId;
+    }
+    pthread_mutex_unlock(&mThumbLock);
+
+    CDBG_HIGH("[KPI Perf] %s: thumbnail job %d queued, rc = %d", __func__,
+              jobId, ret);
+    return ret;
+}
+
+/*===========================================================================
+ * FUNCTION   : destroyJpegThumbSession
+ *
+ * DESCRIPTION: destroy the session of the thumbnail first jobs. The output
+ *              buf is kept, mm-jpeg may keep the session warm.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::destroyJpegThumbSession()
+{
+    if (0 < mJpegThumbSessionId) {
+        mJpegHandle.destroy_session(mJpegThumbSessionId);
+        mJpegThumbSessionId = 0;
+    }
+    mJpegThumbSrcStream = NULL;
+    dropJpegThumbnail();
+}
+
+/*===========================================================================
+ * FUNCTION   : dropJpegThumbnail
+ *
+ * DESCRIPTION: forget the thumbnail of the current capture, a thumbnail job
+ *              still in flight gets its event ignored
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::dropJpegThumbnail()
+{
+    pthread_mutex_lock(&mThumbLock);
+    if (0 < mThumbJobId) {
+        mThumbDropJobId = mThumbJobId;
+        mThumbJobId = 0;
+    }
+    if (m_pThumbJpeg != NULL) {
+        free(m_pThumbJpeg);
+        m_pThumbJpeg = NULL;
+    }
+    m_nThumbJpegLen = 0;
+    pthread_mutex_unlock(&mThumbLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : isThumbFirstSession
+ *
+ * DESCRIPTION: whether the main jpeg session leaves the thumbnail out for a
+ *              thumbnail encoded ahead. Set on the data proc thread, read
+ *              from the jpeg callbacks too.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : true if the thumbnail is encoded first
+ *==========================================================================*/
+bool QCameraPostProcessor::isThumbFirstSession()
+{
+    bool thumbFirst;
+
+    pthread_mutex_lock(&mThumbLock);
+    thumbFirst = mThumbFirstSession;
+    pthread_mutex_unlock(&mThumbLock);
+
+    return thumbFirst;
+}
+
+/*===========================================================================
+ * FUNCTION   : processJpegThumbEvt
+ *
+ * DESCRIPTION: handle the jpeg event of a thumbnail first job. The thumbnail
+ *              is kept for the main image. It is not sent to the app, HAL1
+ *              postview frames are uncompressed.
+ *
+ * PARAMETERS :
+ *   @evt     : ptr to jpeg event payload
+ *
+ * RETURN     : true if the event belongs to a thumbnail job
+ *==========================================================================*/
+bool QCameraPostProcessor::processJpegThumbEvt(qcamera_jpeg_evt_payload_t *evt)
+{
+    pthread_mutex_lock(&mThumbLock);
+    if ((0 < mThumbDropJobId) && (evt->jobId == mThumbDropJobId)) {
+        // main image went out already
+        mThumbDropJobId = 0;
+        pthread_mutex_unlock(&mThumbLock);
+        return true;
+    }
+    if ((0 == mThumbJobId) || (evt->jobId != mThumbJobId)) {
+        pthread_mutex_unlock(&mThumbLock);
+        return false;
+    }
+    mThumbJobId = 0;
+
+    if ((evt->status != JPEG_JOB_STATUS_ERROR) &&
+        (NULL != evt->out_data.buf_vaddr) &&
+        (0 < evt->out_data.buf_filled_len)) {
+        if (m_pThumbJpeg != NULL) {
+            free(m_pThumbJpeg);
+        }
+        m_pThumbJpeg = (uint8_t *)malloc(evt->out_data.buf_filled_len);
+        if (m_pThumbJpeg != NULL) {
+            memcpy(m_pThumbJpeg, evt->out_data.buf_vaddr,
+                   evt->out_data.buf_filled_len);
+            m_nThumbJpegLen = evt->out_data.buf_filled_len;
+        }
+        CDBG_HIGH("[KPI Perf] %s: thumbnail job %d done in %lld us, %d bytes",
+                  __func__, evt->jobId,
+                  (long long)((systemTime() - mThumbStartTime) / 1000),
+                  evt->out_data.buf_filled_len);
+    } else {
+        ALOGE("%s: thumbnail job %d failed, main image goes without",
+              __func__, evt->jobId);
+    }
+    pthread_mutex_unlock(&mThumbLock);
+
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : insertJpegThumbnail
+ *
+ * DESCRIPTION: add the thumbnail encoded ahead to the main image. If the
+ *              main image sits at the end of room_mem with just the room
+ *              the thumbnail needs ahead of it, only the headers move.
+ *              Otherwise the complete jpeg goes into new memory.
+ *
+ * PARAMETERS :
+ *   @jpeg_data : main image encoded without thumbnail
+ *   @jpeg_len  : length of the main image
+ *   @room_mem  : memory holding jpeg_data at its end, NULL if none
+ *
+ * RETURN     : memory with the complete jpeg, room_mem if done in place,
+ *              NULL if there is no thumbnail to add
+ *==========================================================================*/
+camera_memory_t *QCameraPostProcessor::insertJpegThumbnail(uint8_t *jpeg_data,
+                                                           uint32_t jpeg_len,
+                                                           camera_memory_t *room_mem)
+{
+    uint8_t *thumb = NULL;
+    uint32_t thumb_len = 0;
+    uint32_t out_len = 0;
+    camera_memory_t *jpeg_mem = NULL;
+
+    pthread_mutex_lock(&mThumbLock);
+    thumb = m_pThumbJpeg;
+    thumb_len = m_nThumbJpegLen;
+    m_pThumbJpeg = NULL;
+    m_nThumbJpegLen = 0;
+    if (0 < mThumbJobId) {
+        CDBG_HIGH("%s: thumbnail job %d not done, main image goes without",
+                  __func__, mThumbJobId);
+        mThumbDropJobId = mThumbJobId;
+        mThumbJobId = 0;
+    }
+    pthread_mutex_unlock(&mThumbLock);
+
+    if (NULL == thumb) {
+        return NULL;
+    }
+
+    if (0 != mJpegHandle.insert_thumbnail(jpeg_data, jpeg_len, thumb, thumb_len,
+            NULL, 0, &out_len)) {
+        ALOGE("%s: thumbnail does not fit in the exif", __func__);
+        free(thumb);
+        return NULL;
+    }
+
+    if ((NULL != room_mem) && (room_mem->size == out_len) &&
+        ((uint8_t *)room_mem->data + out_len == jpeg_data + jpeg_len)) {
+        if (0 != mJpegHandle.insert_thumbnail(jpeg_data, jpeg_len, thumb,
+                thumb_len, (uint8_t *)room_mem->data, out_len, &out_len)) {
+            ALOGE("%s: failed adding thumbnail", __func__);
+            room_mem = NULL;
+        }
+        free(thumb);
+        return room_mem;
+    }
+
+    jpeg_mem = m_parent->mGetMemory(-1, out_len, 1, m_parent->mCallbackCookie);
+    if (NULL != jpeg_mem) {
+        if (0 != mJpegHandle.insert_thumbnail(jpeg_data, jpeg_len, thumb,
+                thumb_len, (uint8_t *)jpeg_mem->data, out_len, &out_len)) {
+            ALOGE("%s: failed adding thumbnail", __func__);
+            jpeg_mem->release(jpeg_mem);
+            jpeg_mem = NULL;
+        }
+    }
+    free(thumb);
+
+    return jpeg_mem;
+}
+
+/*===========================================================================
+ * FUNCTION   : takeJpegThumbnailRoom
+ *
+ * DESCRIPTION: get the room getJpegMemory left for the thumbnail ahead of
+ *              the main image
+ *
+ * PARAMETERS :
+ *   @jpeg_mem : callback memory of the main image
+ *
+ * RETURN     : bytes ahead of the main image in jpeg_mem
+ *==========================================================================*/
+uint32_t QCameraPostProcessor::takeJpegThumbnailRoom(camera_memory_t *jpeg_mem)
+{
+    uint32_t room = 0;
+
+    pthread_mutex_lock(&mThumbLock);
+    if ((NULL != jpeg_mem) && (jpeg_mem == m_pThumbRoomMem)) {
+        room = mThumbRoom;
+    }
+    m_pThumbRoomMem = NULL;
+    mThumbRoom = 0;
+    pthread_mutex_unlock(&mThumbLock);
+
+    return room;
+}
+
+/*===========================================================================
+ * FUNCTION   : processRawImageImpl
+ *
+ * DESCRIPTION: function to send raw image to upper layer. The callbacks
+ *              get the stream buffer itself where the stream can spare it,
+ *              otherwise a copy.
+ *
+ * PARAMETERS :
+ *   @recvd_frame   : frame to be encoded
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *
+ * NOTE       : recvd_frame is only left to the caller on failure. Otherwise
+ *              it is returned here or once the app is done with it.
+ *==========================================================================*/
+int32_t QCameraPostProcessor::processRawImageImpl(mm_camera_super_buf_t *recvd_frame)
+{
+    int32_t rc = NO_ERROR;
+
+    QCameraChannel *pChannel = m_parent->getChannelByHandle(recvd_frame->ch_id);
+    QCameraStream *pStream = NULL;
+    mm_camera_buf_def_t *frame = NULL;
+    // check reprocess channel if not found
+    if (pChannel == NULL) {
+        if (m_pReprocChannel != NULL &&
+            m_pReprocChannel->getMyHandle() == recvd_frame->ch_id) {
+            pChannel = m_pReprocChannel;
+        }
+    }
+    if (pChannel == NULL) {
+        ALOGE("%s:%d] No corresponding channel (ch_id = %d) exist, return here",
+              __func__, __LINE__, recvd_frame->ch_id);
+        return BAD_VALUE;
+    }
+
+    // find snapshot frame
+    for (int i = 0; i < recvd_frame->num_bufs; i++) {
+        QCameraStream *pCurStream =
+            pChannel->getStreamByHandle(recvd_frame->bufs[i]->stream_id);
         if (pCurStream != NULL) {
             if (pCurStream->isTypeOf(CAM_STREAM_TYPE_SNAPSHOT) ||
                 pCurStream->isTypeOf(CAM_STREAM_TYPE_RAW) ||
@@ -1803,39 +2857,86 @@ int32_t QCameraPostProcessor::processRawImageImpl(mm_camera_super_buf_t *recvd_f
     }
 
     QCameraMemory *rawMemObj = (QCameraMemory *)frame->mem_info;
-    bool zslChannelUsed = m_parent->isZSLMode() &&
-            ( pChannel != m_pReprocChannel );
-    camera_memory_t *raw_mem = NULL;
+    if (NULL == rawMemObj) {
+        ALOGE("%s: Cannot get raw mem", __func__);
+        return UNKNOWN_ERROR;
+    }
 
-    if (rawMemObj != NULL) {
-        if (zslChannelUsed) {
-            raw_mem = rawMemObj->getMemory(frame->buf_idx, false);
+    bool rawCb = (NULL != m_parent->mDataCb) &&
+            (m_parent->msgTypeEnabledWithLock(CAMERA_MSG_RAW_IMAGE) > 0);
+    bool jpegCb = (NULL != m_parent->mDataCb) &&
+            (m_parent->msgTypeEnabledWithLock(CAMERA_MSG_COMPRESSED_IMAGE) > 0);
+    camera_memory_t *raw_mem = NULL;
+    qcamera_release_data_t release_data;
+    memset(&release_data, 0, sizeof(qcamera_release_data_t));
+
+    // zsl, reprocess and longshot queue their buffers again, a plain
+    // capture has one per snapshot
+    bool streaming = m_parent->isZSLMode() ||
+            (pChannel == m_pReprocChannel) || m_parent->isLongshotEnabled();
+
+    if ((rawCb || jpegCb) && holdRawFrame(streaming)) {
+        // hand out the stream buffer itself. It is not queued again once
+        // the app is done with the callback, so the app may keep the
+        // memory as long as it likes. Own mapping, the capture channel
+        // may be gone before the app releases it.
+        raw_mem = m_parent->mGetMemory(rawMemObj->getFd(frame->buf_idx),
+                                       frame->frame_len,
+                                       1,
+                                       m_parent->mCallbackCookie);
+        if ((NULL != raw_mem) && (NULL == raw_mem->data)) {
+            raw_mem->release(raw_mem);
+            raw_mem = NULL;
+        }
+        release_data.data = raw_mem;
+        pthread_mutex_lock(&mCreditLock);
+        if (NULL != raw_mem) {
+            release_data.frame = recvd_frame;
+            release_data.rawHeld = true;
+            mPipeStats.rawShared++;
+            mPipeStats.rawSharedBytes += frame->frame_len;
         } else {
-            raw_mem = m_parent->mGetMemory(-1,
-                                           frame->frame_len,
-                                           1,
-                                           m_parent->mCallbackCookie);
-            if (NULL == raw_mem) {
-                ALOGE("%s : Not enough memory for RAW cb ", __func__);
-                return NO_MEMORY;
-            }
-            memcpy(raw_mem->data, frame->buffer, frame->frame_len);
+            mRawFramesHeld--;
         }
+        pthread_mutex_unlock(&mCreditLock);
     }
 
-    if (NULL != rawMemObj && NULL != raw_mem) {
-        // dump frame into file
-        if (frame->stream_type == CAM_STREAM_TYPE_SNAPSHOT ||
-            pStream->isOrignalTypeOf(CAM_STREAM_TYPE_SNAPSHOT)) {
-            // for YUV422 NV16 case
-            m_parent->dumpFrameToFile(pStream, frame, QCAMERA_DUMP_FRM_SNAPSHOT);
-        } else {
-            m_parent->dumpFrameToFile(pStream, frame, QCAMERA_DUMP_FRM_RAW);
+    if ((rawCb || jpegCb) && (NULL == raw_mem)) {
+        raw_mem = m_parent->mGetMemory(-1,
+                                       frame->frame_len,
+                                       1,
+                                       m_parent->mCallbackCookie);
+        if (NULL == raw_mem) {
+            ALOGE("%s : Not enough memory for RAW cb ", __func__);
+            return NO_MEMORY;
         }
+        memcpy(raw_mem->data, frame->buffer, frame->frame_len);
+        release_data.data = raw_mem;
+        pthread_mutex_lock(&mCreditLock);
+        mPipeStats.rawCopied++;
+        mPipeStats.rawCopiedBytes += frame->frame_len;
+        pthread_mutex_unlock(&mCreditLock);
+    }
 
-        // send data callback / notify for RAW_IMAGE
-        if (NULL != m_parent->mDataCb &&
-            m_parent->msgTypeEnabledWithLock(CAMERA_MSG_RAW_IMAGE) > 0) {
+    // dump frame into file
+    if (frame->stream_type == CAM_STREAM_TYPE_SNAPSHOT ||
+        pStream->isOrignalTypeOf(CAM_STREAM_TYPE_SNAPSHOT)) {
+        // for YUV422 NV16 case
+        m_parent->dumpFrameToFile(pStream, frame, QCAMERA_DUMP_FRM_SNAPSHOT);
+    } else {
+        m_parent->dumpFrameToFile(pStream, frame, QCAMERA_DUMP_FRM_RAW);
+    }
+
+    if (NULL == release_data.frame) {
+        // copied or not needed, the buffer can go back right away
+        releaseSuperBuf(recvd_frame);
+        free(recvd_frame);
+    }
+
+    // send data callback / notify for RAW_IMAGE
+    if (rawCb) {
+        if (jpegCb) {
+            // released along with the compressed image callback below
             qcamera_callback_argm_t cbArg;
             memset(&cbArg, 0, sizeof(qcamera_callback_argm_t));
             cbArg.cb_type = QCAMERA_DATA_CALLBACK;
@@ -1843,43 +2944,243 @@ int32_t QCameraPostProcessor::processRawImageImpl(mm_camera_super_buf_t *recvd_f
             cbArg.data = raw_mem;
             cbArg.index = 0;
             m_parent->m_cbNotifier.notifyCallback(cbArg);
+        } else {
+            rc = sendDataNotify(CAMERA_MSG_RAW_IMAGE,
+                                raw_mem,
+                                0,
+                                NULL,
+                                &release_data);
         }
-        if (NULL != m_parent->mNotifyCb &&
-            m_parent->msgTypeEnabledWithLock(CAMERA_MSG_RAW_IMAGE_NOTIFY) > 0) {
-            qcamera_callback_argm_t cbArg;
-            memset(&cbArg, 0, sizeof(qcamera_callback_argm_t));
-            cbArg.cb_type = QCAMERA_NOTIFY_CALLBACK;
-            cbArg.msg_type = CAMERA_MSG_RAW_IMAGE_NOTIFY;
-            cbArg.ext1 = 0;
-            cbArg.ext2 = 0;
-            m_parent->m_cbNotifier.notifyCallback(cbArg);
+    }
+    if (NULL != m_parent->mNotifyCb &&
+        m_parent->msgTypeEnabledWithLock(CAMERA_MSG_RAW_IMAGE_NOTIFY) > 0) {
+        qcamera_callback_argm_t cbArg;
+        memset(&cbArg, 0, sizeof(qcamera_callback_argm_t));
+        cbArg.cb_type = QCAMERA_NOTIFY_CALLBACK;
+        cbArg.msg_type = CAMERA_MSG_RAW_IMAGE_NOTIFY;
+        cbArg.ext1 = 0;
+        cbArg.ext2 = 0;
+        m_parent->m_cbNotifier.notifyCallback(cbArg);
+    }
+
+    if (jpegCb) {
+        rc = sendDataNotify(CAMERA_MSG_COMPRESSED_IMAGE,
+                            raw_mem,
+                            0,
+                            NULL,
+                            &release_data);
+    }
+
+    if (NO_ERROR != rc) {
+        // frame went back with the failed notify, only report it
+        ALOGE("%s: Failed to send raw callback", __func__);
+        sendEvtNotify(CAMERA_MSG_ERROR, UNKNOWN_ERROR, 0);
+    }
+
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : holdRawFrame
+ *
+ * DESCRIPTION: decide whether a raw/yuv callback can keep its frame until
+ *              the app is done with it. Only a frame whose buffer is not
+ *              queued again afterwards can be shared, the app may still
+ *              read the callback memory after releasing it. A stream that
+ *              keeps streaming gets a copy and the frame goes back right
+ *              away.
+ *
+ * PARAMETERS :
+ *   @streaming : stream keeps streaming during the callback
+ *
+ * RETURN     : true -- frame is accounted as held; false -- copy needed
+ *==========================================================================*/
+bool QCameraPostProcessor::holdRawFrame(bool streaming)
+{
+    if (!mRawZeroCopy || streaming) {
+        return false;
+    }
+
+    pthread_mutex_lock(&mCreditLock);
+    mRawFramesHeld++;
+    pthread_mutex_unlock(&mCreditLock);
+
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : getJpegStreamFile
+ *
+ * DESCRIPTION: find the file of a streaming jpeg encode. Only called from
+ *              the save thread.
+ *
+ * PARAMETERS :
+ *   @jobId   : job Id of the jpeg encoding
+ *
+ * RETURN     : ptr to stream file, NULL if the job was not streamed
+ *==========================================================================*/
+qcamera_jpeg_stream_file_t *QCameraPostProcessor::getJpegStreamFile(uint32_t jobId)
+{
+    android::List<qcamera_jpeg_stream_file_t>::iterator it;
+    for (it = mJpegStreamFiles.begin(); it != mJpegStreamFiles.end(); it++) {
+        if (it->jobId == jobId) {
+            return &(*it);
         }
+    }
+    return NULL;
+}
 
-        if ((m_parent->mDataCb != NULL) &&
-            m_parent->msgTypeEnabledWithLock(CAMERA_MSG_COMPRESSED_IMAGE) > 0) {
-            qcamera_release_data_t release_data;
-            memset(&release_data, 0, sizeof(qcamera_release_data_t));
-            if ( zslChannelUsed ) {
-                release_data.frame = recvd_frame;
+/*===========================================================================
+ * FUNCTION   : saveJpegChunk
+ *
+ * DESCRIPTION: append a chunk of a streaming jpeg encode to its file. The
+ *              file is created with the first chunk. A stream file is kept
+ *              even when nothing gets written, it tells the save thread the
+ *              final output of the job is a plain buffer.
+ *
+ * PARAMETERS :
+ *   @chunk   : chunk payload
+ *   @save    : whether the save thread is active
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::saveJpegChunk(qcamera_jpeg_evt_payload_t *chunk,
+                                         bool save)
+{
+    qcamera_jpeg_stream_file_t *stream = getJpegStreamFile(chunk->jobId);
+    if (NULL == stream) {
+        qcamera_jpeg_stream_file_t newStream;
+        memset(&newStream, 0, sizeof(newStream));
+        newStream.jobId = chunk->jobId;
+        newStream.fd = -1;
+        if (save && (0 == chunk->offset) &&
+                (NULL != chunk->out_data.buf_vaddr)) {
+            snprintf(newStream.name, sizeof(newStream.name),
+                     QCameraPostProcessor::STORE_LOCATION, mSaveFrmCnt);
+            newStream.fd = open(newStream.name, O_RDWR | O_CREAT | O_TRUNC, 0655);
+            if (newStream.fd < 0) {
+                ALOGE("%s: fail to open %s for streaming", __func__, newStream.name);
             } else {
-                release_data.data = raw_mem;
+                mSaveFrmCnt++;
+                CDBG_HIGH("[KPI Perf] %s: first chunk of jpeg job %d",
+                          __func__, chunk->jobId);
             }
-            rc = sendDataNotify(CAMERA_MSG_COMPRESSED_IMAGE,
-                                raw_mem,
-                                0,
-                                NULL,
-                                &release_data);
+        }
+        mJpegStreamFiles.push_back(newStream);
+        stream = getJpegStreamFile(chunk->jobId);
+    }
+
+    if ((NULL == stream) || (stream->fd < 0)) {
+        return;
+    }
+
+    ssize_t written_len = -1;
+    if ((NULL != chunk->out_data.buf_vaddr) &&
+            (chunk->offset == stream->written)) {
+        written_len = write(stream->fd,
+                            chunk->out_data.buf_vaddr,
+                            chunk->out_data.buf_filled_len);
+    }
+    if (written_len != (ssize_t)chunk->out_data.buf_filled_len) {
+        // give up on the file, the final output is written in one go
+        ALOGE("%s: Failed to stream %d bytes at %d of jpeg job %d",
+              __func__, chunk->out_data.buf_filled_len, chunk->offset,
+              chunk->jobId);
+        close(stream->fd);
+        unlink(stream->name);
+        stream->fd = -1;
+        return;
+    }
+    stream->written += chunk->out_data.buf_filled_len;
+}
+
+/*===========================================================================
+ * FUNCTION   : finishJpegStreamFile
+ *
+ * DESCRIPTION: complete the file of a streaming jpeg encode with whatever
+ *              was not streamed yet and close it
+ *
+ * PARAMETERS :
+ *   @stream    : stream file
+ *   @jpeg_data : final jpeg output
+ *   @jpeg_len  : length of final jpeg output
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraPostProcessor::finishJpegStreamFile(qcamera_jpeg_stream_file_t *stream,
+                                                   uint8_t *jpeg_data,
+                                                   uint32_t jpeg_len)
+{
+    int32_t rc = NO_ERROR;
+
+    if (stream->written < jpeg_len) {
+        uint32_t remaining = jpeg_len - stream->written;
+        ssize_t written_len = write(stream->fd,
+                                    jpeg_data + stream->written,
+                                    remaining);
+        if (written_len != (ssize_t)remaining) {
+            ALOGE("%s: Failed save complete data %d bytes written instead of %d bytes!",
+                  __func__, (int)written_len, remaining);
+            rc = UNKNOWN_ERROR;
         } else {
-            raw_mem->release(raw_mem);
+            stream->written = jpeg_len;
         }
-    } else {
-        ALOGE("%s: Cannot get raw mem", __func__);
-        rc = UNKNOWN_ERROR;
     }
+    CDBG_HIGH("%s: jpeg job %d streamed %d bytes", __func__,
+              stream->jobId, stream->written);
 
+    close(stream->fd);
+    stream->fd = -1;
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : releaseJpegStreamFile
+ *
+ * DESCRIPTION: forget the file of a streaming jpeg encode
+ *
+ * PARAMETERS :
+ *   @jobId      : job Id of the jpeg encoding
+ *   @unlinkFile : remove the file, it will not be delivered
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::releaseJpegStreamFile(uint32_t jobId, bool unlinkFile)
+{
+    android::List<qcamera_jpeg_stream_file_t>::iterator it;
+    for (it = mJpegStreamFiles.begin(); it != mJpegStreamFiles.end(); it++) {
+        if (it->jobId == jobId) {
+            if (it->fd >= 0) {
+                close(it->fd);
+                unlinkFile = true;
+            }
+            if (unlinkFile && (it->name[0] != '\0')) {
+                unlink(it->name);
+            }
+            mJpegStreamFiles.erase(it);
+            return;
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseJpegStreamFiles
+ *
+ * DESCRIPTION: drop all files of streaming jpeg encodes in progress
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPostProcessor::releaseJpegStreamFiles()
+{
+    while (!mJpegStreamFiles.empty()) {
+        releaseJpegStreamFile(mJpegStreamFiles.begin()->jobId, true);
+    }
+}
+
 /*===========================================================================
  * FUNCTION   : dataSaveRoutine
  *
@@ -1925,6 +3226,7 @@ void *QCameraPostProcessor::dataSaveRoutine(void *data)
 
                 // flush input save Queue
                 pme->m_inputSaveQ.flush();
+                pme->releaseJpegStreamFiles();
 
                 // signal cmd is completed
                 cam_sem_post(&cmdThread->sync_sem);
@@ -1940,36 +3242,81 @@ void *QCameraPostProcessor::dataSaveRoutine(void *data)
                     continue;
                 }
 
+                if (job_data->partial) {
+                    pme->saveJpegChunk(job_data, (is_active == TRUE));
+                    free(job_data);
+                    break;
+                }
+
                 pme->m_ongoingJpegQ.flushNodes(matchJobId, (void*)&job_data->jobId);
+                qcamera_jpeg_stream_file_t *stream =
+                        pme->getJpegStreamFile(job_data->jobId);
+                bool delivered = false;
 
                 CDBG_HIGH("[KPI Perf] %s : jpeg job %d", __func__, job_data->jobId);
 
-                if (is_active == TRUE) {
+                // encoded data lives in callback memory with jpeg mem opt
+                uint8_t *jpeg_data = job_data->out_data.buf_vaddr;
+                uint32_t jpeg_len = job_data->out_data.buf_filled_len;
+                camera_memory_t *enc_mem = NULL;
+                if (pme->mJpegMemOpt && (NULL == stream)) {
+                    omx_jpeg_ouput_buf_t *jpeg_out =
+                        (omx_jpeg_ouput_buf_t *)job_data->out_data.buf_vaddr;
+                    if ((NULL != jpeg_out) &&
+                            (job_data->status != JPEG_JOB_STATUS_ERROR)) {
+                        enc_mem = (camera_memory_t *)jpeg_out->mem_hdl;
+                    }
+                    jpeg_data = (NULL != enc_mem) ? (uint8_t *)enc_mem->data : NULL;
+                    jpeg_len = (NULL != enc_mem) ? enc_mem->size : 0;
+                }
+
+                if ((is_active == TRUE) && (NULL != jpeg_data)) {
                     memset(saveName, '\0', sizeof(saveName));
-                    snprintf(saveName,
-                             sizeof(saveName),
-                             QCameraPostProcessor::STORE_LOCATION,
-                             pme->mSaveFrmCnt);
-
-                    int file_fd = open(saveName, O_RDWR | O_CREAT, 0655);
-                    if (file_fd > 0) {
-                        size_t written_len = write(file_fd,
-                                                job_data->out_data.buf_vaddr,
-                                                job_data->out_data.buf_filled_len);
-                        if ( job_data->out_data.buf_filled_len != written_len ) {
-                            ALOGE("%s: Failed save complete data %d bytes written instead of %d bytes!",
-                                  __func__,
-                                  written_len,
-                                  job_data->out_data.buf_filled_len);
+                    if ((NULL != stream) && (stream->fd >= 0)) {
+                        // most of the file is on disk already
+                        strlcpy(saveName, stream->name, sizeof(saveName));
+                        if (NO_ERROR != pme->finishJpegStreamFile(stream,
+                                                                  jpeg_data,
+                                                                  jpeg_len)) {
+                            goto end;
+                        }
+                    } else {
+                        snprintf(saveName,
+                                 sizeof(saveName),
+                                 QCameraPostProcessor::STORE_LOCATION,
+                                 pme->mSaveFrmCnt);
+
+                        int file_fd = open(saveName, O_RDWR | O_CREAT, 0655);
+                        if (file_fd > 0) {
+                            size_t written_len = write(file_fd,
+                                                    jpeg_data,
+                                                    jpeg_len);
+                            if ( jpeg_len != written_len ) {
+                                ALOGE("%s: Failed save complete data %d bytes written instead of %d bytes!",
+                                      __func__,
+                                      written_len,
+                                      jpeg_len);
+                            } else {
+                                CDBG_HIGH("%s: written number of bytes %d\n", __func__, written_len);
+                            }
+
+                            close(file_fd);
                         } else {
-                            CDBG_HIGH("%s: written number of bytes %d\n", __func__, written_len);
+                            ALOGE("%s: fail t open file for saving", __func__);
                         }
+                        pme->mSaveFrmCnt++;
+                    }
 
-                        close(file_fd);
+                    // a streamed file got copies of all but the last chunk,
+                    // otherwise it is written from the encoder output
+                    pthread_mutex_lock(&pme->mCreditLock);
+                    if (NULL != stream) {
+                        pme->mPipeStats.jpegCopied++;
                     } else {
-                        ALOGE("%s: fail t open file for saving", __func__);
+                        pme->mPipeStats.jpegShared++;
+                        pme->mPipeStats.jpegSharedBytes += jpeg_len;
                     }
-                    pme->mSaveFrmCnt++;
+                    pthread_mutex_unlock(&pme->mCreditLock);
 
                     camera_memory_t* jpeg_mem = pme->m_parent->mGetMemory(-1,
                                                          strlen(saveName),
@@ -1988,6 +3335,8 @@ void *QCameraPostProcessor::dataSaveRoutine(void *data)
                     release_data.data = jpeg_mem;
                     release_data.unlinkFile = true;
                     CDBG_HIGH("[KPI Perf] %s: PROFILE_JPEG_CB ",__func__);
+                    // file is owned by release_data from here on
+                    delivered = true;
                     ret = pme->sendDataNotify(CAMERA_MSG_COMPRESSED_IMAGE,
                                         jpeg_mem,
                                         0,
@@ -1996,7 +3345,16 @@ void *QCameraPostProcessor::dataSaveRoutine(void *data)
                 }
 
 end:
+                if (NULL != stream) {
+                    pme->releaseJpegStreamFile(job_data->jobId, !delivered);
+                }
+                if (NULL != enc_mem) {
+                    enc_mem->release(enc_mem);
+                    enc_mem = NULL;
+                }
                 free(job_data);
+                // the saved frame gave its credit back
+                pme->updateCaptureCredits();
             }
             break;
         case CAMERA_CMD_TYPE_EXIT:
@@ -2082,10 +3440,14 @@ void *QCameraPostProcessor::dataProcessRoutine(void *data)
                     pme->mJpegHandle.destroy_session(pme->mJpegSessionId);
                     pme->mJpegSessionId = 0;
                 }
+                pme->destroyJpegThumbSession();
 
-                // free jpeg out buf and exif obj
-                FREE_JPEG_OUTPUT_BUFFER(pme->m_pJpegOutputMem,
-                    pme->m_JpegOutputMemCount);
+                // free jpeg out buf and exif obj, out bufs stay with
+                // the session when mm-jpeg keeps it warm
+                if (!pme->mJpegSessionCache) {
+                    FREE_JPEG_OUTPUT_BUFFER(pme->m_pJpegOutputMem,
+                        pme->m_JpegOutputMemCount);
+                }
 
                 if (pme->m_pJpegExifObj != NULL) {
                     delete pme->m_pJpegExifObj;
@@ -2097,6 +3459,8 @@ void *QCameraPostProcessor::dataProcessRoutine(void *data)
                     pme->m_pReprocChannel->stop();
                     delete pme->m_pReprocChannel;
                     pme->m_pReprocChannel = NULL;
+                    // the jpeg session encoded from its buffers
+                    pme->invalidateJpegSessionCache();
                 }
 
                 // flush ongoing postproc Queue
@@ -2158,9 +3522,16 @@ void *QCameraPostProcessor::dataProcessRoutine(void *data)
                         }
                     }
 
-                    mm_camera_super_buf_t *pp_frame =
-                        (mm_camera_super_buf_t *)pme->m_inputPPQ.dequeue();
-                    if (NULL != pp_frame) {
+                    // send reprocess requests while the backend has room for
+                    // them, the rest wait in the input queue for a result
+                    while ((0 == pme->mPPInFlightMax) ||
+                           ((uint32_t)pme->m_ongoingPPQ.getCurrentSize() <
+                            pme->mPPInFlightMax)) {
+                        mm_camera_super_buf_t *pp_frame =
+                            (mm_camera_super_buf_t *)pme->m_inputPPQ.dequeue();
+                        if (NULL == pp_frame) {
+                            break;
+                        }
                         qcamera_pp_data_t *pp_job =
                             (qcamera_pp_data_t *)malloc(sizeof(qcamera_pp_data_t));
                         if (pp_job != NULL) {
@@ -2216,6 +3587,7 @@ void *QCameraPostProcessor::dataProcessRoutine(void *data)
                         free(super_buf);
                     }
                 }
+                pme->updateCaptureCredits();
             }
             break;
         case CAMERA_CMD_TYPE_EXIT:
@@ -2409,290 +3781,71 @@ bool QCameraPostProcessor::matchJobId(void *data, void *, void *match_data)
 }
 
 /*===========================================================================
- * FUNCTION   : getJpegMemory
+ * FUNCTION   : matchPPFrame
  *
- * DESCRIPTION: buffer allocation function
- *   to pass to jpeg interface
+ * DESCRIPTION: match an ongoing reprocess job to the frame idx of its
+ *              output, counting the older jobs passed on the way
  *
  * PARAMETERS :
- *   @out_buf : buffer descriptor struct
+ *   @data       : qcamera_pp_data_t of the ongoing job
+ *   @match_data : qcamera_pp_match_t to match against
  *
- * RETURN     : int32_t type of status
- *              NO_ERROR  -- success
- *              none-zero failure code
+ * RETURN     : true -- job matches; false -- otherwise
  *==========================================================================*/
-int QCameraPostProcessor::getJpegMemory(omx_jpeg_ouput_buf_t *out_buf)
+bool QCameraPostProcessor::matchPPFrame(void *data, void *, void *match_data)
 {
-    CDBG_HIGH("%s: Allocating jpeg out buffer of size: %d", __func__, out_buf->size);
-    QCameraPostProcessor *procInst = (QCameraPostProcessor *) out_buf->handle;
-    camera_memory_t *cam_mem = procInst->m_parent->mGetMemory(-1, out_buf->size,
-        1, procInst->m_parent->mCallbackCookie);
-    out_buf->mem_hdl = cam_mem;
-    out_buf->vaddr = cam_mem->data;
-
-    return 0;
-}
+    qcamera_pp_data_t *job = (qcamera_pp_data_t *)data;
+    qcamera_pp_match_t *match = (qcamera_pp_match_t *)match_data;
 
-/*===========================================================================
- * FUNCTION   : QCameraExif
- *
- * DESCRIPTION: constructor of QCameraExif
- *
- * PARAMETERS : None
- *
- * RETURN     : None
- *==========================================================================*/
-QCameraExif::QCameraExif()
-    : m_nNumEntries(0)
-{
-    memset(m_Entries, 0, sizeof(m_Entries));
-}
-
-/*===========================================================================
- * FUNCTION   : ~QCameraExif
- *
- * DESCRIPTION: deconstructor of QCameraExif. Will release internal memory ptr.
- *
- * PARAMETERS : None
- *
- * RETURN     : None
- *==========================================================================*/
-QCameraExif::~QCameraExif()
-{
-    for (uint32_t i = 0; i < m_nNumEntries; i++) {
-        switch (m_Entries[i].tag_entry.type) {
-        case EXIF_BYTE:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._bytes != NULL) {
-                    free(m_Entries[i].tag_entry.data._bytes);
-                    m_Entries[i].tag_entry.data._bytes = NULL;
-                }
-            }
-            break;
-        case EXIF_ASCII:
-            {
-                if (m_Entries[i].tag_entry.data._ascii != NULL) {
-                    free(m_Entries[i].tag_entry.data._ascii);
-                    m_Entries[i].tag_entry.data._ascii = NULL;
-                }
-            }
-            break;
-        case EXIF_SHORT:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._shorts != NULL) {
-                    free(m_Entries[i].tag_entry.data._shorts);
-                    m_Entries[i].tag_entry.data._shorts = NULL;
-                }
-            }
-            break;
-        case EXIF_LONG:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._longs != NULL) {
-                    free(m_Entries[i].tag_entry.data._longs);
-                    m_Entries[i].tag_entry.data._longs = NULL;
-                }
-            }
-            break;
-        case EXIF_RATIONAL:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._rats != NULL) {
-                    free(m_Entries[i].tag_entry.data._rats);
-                    m_Entries[i].tag_entry.data._rats = NULL;
-                }
-            }
-            break;
-        case EXIF_UNDEFINED:
-            {
-                if (m_Entries[i].tag_entry.data._undefined != NULL) {
-                    free(m_Entries[i].tag_entry.data._undefined);
-                    m_Entries[i].tag_entry.data._undefined = NULL;
-                }
-            }
-            break;
-        case EXIF_SLONG:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._slongs != NULL) {
-                    free(m_Entries[i].tag_entry.data._slongs);
-                    m_Entries[i].tag_entry.data._slongs = NULL;
-                }
-            }
-            break;
-        case EXIF_SRATIONAL:
-            {
-                if (m_Entries[i].tag_entry.count > 1 &&
-                    m_Entries[i].tag_entry.data._srats != NULL) {
-                    free(m_Entries[i].tag_entry.data._srats);
-                    m_Entries[i].tag_entry.data._srats = NULL;
-                }
-            }
-            break;
-        }
+    if ((NULL != job->src_frame) && (job->src_frame->num_bufs > 0) &&
+            (job->src_frame->bufs[0]->frame_idx == match->frame_idx)) {
+        return true;
     }
+    match->skipped++;
+    return false;
 }
 
 /*===========================================================================
- * FUNCTION   : addEntry
+ * FUNCTION   : getJpegMemory
  *
- * DESCRIPTION: function to add an entry to exif data
+ * DESCRIPTION: buffer allocation function
+ *   to pass to jpeg interface. In thumbnail first mode the
+ *   image goes behind room for the thumbnail if that is done,
+ *   so that it can be added without copying the image.
  *
  * PARAMETERS :
- *   @tagid   : exif tag ID
- *   @type    : data type
- *   @count   : number of data in uint of its type
- *   @data    : input data ptr
+ *   @out_buf : buffer descriptor struct
  *
  * RETURN     : int32_t type of status
  *              NO_ERROR  -- success
  *              none-zero failure code
  *==========================================================================*/
-int32_t QCameraExif::addEntry(exif_tag_id_t tagid,
-                              exif_tag_type_t type,
-                              uint32_t count,
-                              void *data)
+int QCameraPostProcessor::getJpegMemory(omx_jpeg_ouput_buf_t *out_buf)
 {
-    int32_t rc = NO_ERROR;
-    if(m_nNumEntries >= MAX_EXIF_TABLE_ENTRIES) {
-        ALOGE("%s: Number of entries exceeded limit", __func__);
-        return NO_MEMORY;
-    }
-
-    m_Entries[m_nNumEntries].tag_id = tagid;
-    m_Entries[m_nNumEntries].tag_entry.type = type;
-    m_Entries[m_nNumEntries].tag_entry.count = count;
-    m_Entries[m_nNumEntries].tag_entry.copy = 1;
-    switch (type) {
-    case EXIF_BYTE:
-        {
-            if (count > 1) {
-                uint8_t *values = (uint8_t *)malloc(count);
-                if (values == NULL) {
-                    ALOGE("%s: No memory for byte array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count);
-                    m_Entries[m_nNumEntries].tag_entry.data._bytes = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._byte = *(uint8_t *)data;
-            }
-        }
-        break;
-    case EXIF_ASCII:
-        {
-            char *str = NULL;
-            str = (char *)malloc(count + 1);
-            if (str == NULL) {
-                ALOGE("%s: No memory for ascii string", __func__);
-                rc = NO_MEMORY;
-            } else {
-                memset(str, 0, count + 1);
-                memcpy(str, data, count);
-                m_Entries[m_nNumEntries].tag_entry.data._ascii = str;
-            }
-        }
-        break;
-    case EXIF_SHORT:
-        {
-            if (count > 1) {
-                uint16_t *values = (uint16_t *)malloc(count * sizeof(uint16_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for short array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(uint16_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._shorts = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._short = *(uint16_t *)data;
-            }
-        }
-        break;
-    case EXIF_LONG:
-        {
-            if (count > 1) {
-                uint32_t *values = (uint32_t *)malloc(count * sizeof(uint32_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for long array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(uint32_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._longs = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._long = *(uint32_t *)data;
-            }
-        }
-        break;
-    case EXIF_RATIONAL:
-        {
-            if (count > 1) {
-                rat_t *values = (rat_t *)malloc(count * sizeof(rat_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for rational array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(rat_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._rats = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._rat = *(rat_t *)data;
-            }
-        }
-        break;
-    case EXIF_UNDEFINED:
-        {
-            uint8_t *values = (uint8_t *)malloc(count);
-            if (values == NULL) {
-                ALOGE("%s: No memory for undefined array", __func__);
-                rc = NO_MEMORY;
-            } else {
-                memcpy(values, data, count);
-                m_Entries[m_nNumEntries].tag_entry.data._undefined = values;
-            }
-        }
-        break;
-    case EXIF_SLONG:
-        {
-            if (count > 1) {
-                int32_t *values = (int32_t *)malloc(count * sizeof(int32_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for signed long array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(int32_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._slongs = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._slong = *(int32_t *)data;
-            }
-        }
-        break;
-    case EXIF_SRATIONAL:
-        {
-            if (count > 1) {
-                srat_t *values = (srat_t *)malloc(count * sizeof(srat_t));
-                if (values == NULL) {
-                    ALOGE("%s: No memory for signed rational array", __func__);
-                    rc = NO_MEMORY;
-                } else {
-                    memcpy(values, data, count * sizeof(srat_t));
-                    m_Entries[m_nNumEntries].tag_entry.data._srats = values;
-                }
-            } else {
-                m_Entries[m_nNumEntries].tag_entry.data._srat = *(srat_t *)data;
-            }
-        }
-        break;
+    CDBG_HIGH("%s: Allocating jpeg out buffer of size: %d", __func__, out_buf->size);
+    QCameraPostProcessor *procInst = (QCameraPostProcessor *) out_buf->handle;
+    uint32_t room = 0;
+
+    pthread_mutex_lock(&procInst->mThumbLock);
+    if (procInst->mThumbFirstSession && (NULL != procInst->m_pThumbJpeg) &&
+        (0 != procInst->mJpegHandle.insert_thumbnail(NULL, 0,
+            procInst->m_pThumbJpeg, procInst->m_nThumbJpegLen, NULL, 0,
+            &room))) {
+        room = 0;
+    }
+    camera_memory_t *cam_mem = procInst->m_parent->mGetMemory(-1,
+        out_buf->size + room, 1, procInst->m_parent->mCallbackCookie);
+    procInst->m_pThumbRoomMem = (0 < room) ? cam_mem : NULL;
+    procInst->mThumbRoom = room;
+    pthread_mutex_unlock(&procInst->mThumbLock);
+    if (NULL == cam_mem) {
+        ALOGE("%s: no memory for jpeg", __func__);
+        return -1;
     }
+    out_buf->mem_hdl = cam_mem;
+    out_buf->vaddr = (uint8_t *)cam_mem->data + room;
 
-    // Increase number of entries
-    m_nNumEntries++;
-    return rc;
+    return 0;
 }
 
 }; // namespace qcamera
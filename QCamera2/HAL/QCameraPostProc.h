@@ -34,14 +34,13 @@ extern "C" {
 #include <mm_camera_interface.h>
 #include <mm_jpeg_interface.h>
 }
+#include "QCameraExif.h"
 #include "QCamera2HWI.h"
 
 #define MAX_JPEG_BURST 2
 
 namespace qcamera {
 
-class QCameraExif;
-
 typedef struct {
     uint32_t jobId;                  // job ID
     uint32_t client_hdl;             // handle of jpeg client (obtained when open jpeg)
@@ -65,13 +64,23 @@ typedef struct {
     uint32_t jobId;                  // job ID (obtained when start_jpeg_job)
     jpeg_job_status_t status;        // jpeg encoding status
     mm_jpeg_output_t out_data;         // ptr to jpeg output buf
+    bool partial;                    // out_data is a chunk of a streaming encode
+    uint32_t offset;                 // file offset of the chunk
 } qcamera_jpeg_evt_payload_t;
 
+typedef struct {
+    uint32_t jobId;                  // job ID of the streaming encode
+    int fd;                          // fd of the file, -1 if not saved
+    uint32_t written;                // bytes written to the file
+    char name[PROPERTY_VALUE_MAX];   // file name
+} qcamera_jpeg_stream_file_t;
+
 typedef struct {
     camera_memory_t *        data;     // ptr to data memory struct
     mm_camera_super_buf_t *  frame;    // ptr to frame
     QCameraMemory *          streamBufs; //ptr to stream buffers
     bool                     unlinkFile; // unlink any stored buffers on error
+    bool                     rawHeld;  // frame held by a raw/yuv callback
 } qcamera_release_data_t;
 
 typedef struct {
@@ -82,24 +91,26 @@ typedef struct {
     qcamera_release_data_t   release_data; // any data needs to be release after notify
 } qcamera_data_argm_t;
 
-#define MAX_EXIF_TABLE_ENTRIES 17
-class QCameraExif
-{
-public:
-    QCameraExif();
-    virtual ~QCameraExif();
-
-    int32_t addEntry(exif_tag_id_t tagid,
-                     exif_tag_type_t type,
-                     uint32_t count,
-                     void *data);
-    uint32_t getNumOfEntries() {return m_nNumEntries;};
-    QEXIF_INFO_DATA *getEntries() {return m_Entries;};
-
-private:
-    QEXIF_INFO_DATA m_Entries[MAX_EXIF_TABLE_ENTRIES];  // exif tags for JPEG encoder
-    uint32_t  m_nNumEntries;                            // number of valid entries
-};
+typedef struct {
+    nsecs_t firstDone;               // first encoded image of the capture
+    nsecs_t lastDone;                // latest encoded image of the capture
+    uint32_t shots;                  // encoded images
+    uint32_t deferred;               // requests that waited for a credit
+    uint32_t frameLen;               // bytes of the latest captured superbuf
+    uint32_t peakFrames;             // peak frames held by the pipeline
+    uint32_t peakPP;                 // peak depth of the reprocess stage
+    uint32_t ppOutOfOrder;           // reprocess results ahead of an older one
+    uint32_t peakJpeg;               // peak depth of the encode stage
+    uint32_t peakSave;               // peak depth of the save stage
+    uint32_t rawShared;              // raw/yuv callbacks on the stream buffer
+    uint32_t rawCopied;              // raw/yuv callbacks on a copy
+    uint64_t rawSharedBytes;         // bytes handed out without a copy
+    uint64_t rawCopiedBytes;         // bytes copied for raw/yuv callbacks
+    uint32_t jpegShared;             // jpegs delivered in encoder output
+    uint32_t jpegCopied;             // jpegs delivered on a copy
+    uint64_t jpegSharedBytes;        // jpeg bytes delivered without a copy
+    uint64_t jpegCopiedBytes;        // jpeg bytes copied for the callback
+} qcamera_capture_pipe_stats_t;
 
 class QCameraPostProcessor
 {
@@ -107,17 +118,28 @@ public:
     QCameraPostProcessor(QCamera2HardwareInterface *cam_ctrl);
     virtual ~QCameraPostProcessor();
 
-    int32_t init(jpeg_encode_callback_t jpeg_cb, void *user_data);
+    int32_t init(jpeg_encode_callback_t jpeg_cb,
+                 jpeg_encode_chunk_callback_t jpeg_chunk_cb,
+                 void *user_data);
     int32_t deinit();
     int32_t start(QCameraChannel *pSrcChannel);
     int32_t stop();
     int32_t processData(mm_camera_super_buf_t *frame);
+    int32_t requestCaptureFrames(QCameraPicChannel *pChannel, uint8_t num);
     int32_t processRawData(mm_camera_super_buf_t *frame);
     int32_t processPPData(mm_camera_super_buf_t *frame);
     int32_t processJpegEvt(qcamera_jpeg_evt_payload_t *evt);
+    int32_t processJpegChunk(uint32_t jobId,
+                             mm_jpeg_output_t *p_chunk,
+                             uint32_t offset);
     int32_t getJpegPaddingReq(cam_padding_info_t &padding_info);
     QCameraReprocessChannel * getReprocChannel() {return m_pReprocChannel;};
+    void invalidateJpegSessionCache();
     inline bool getJpegMemOpt() {return mJpegMemOpt;}
+    inline uint32_t getPPBacklog()
+        {return m_inputPPQ.getCurrentSize() + m_ongoingPPQ.getCurrentSize();}
+    inline uint32_t getJpegBacklog()
+        {return m_inputJpegQ.getCurrentSize() + m_ongoingJpegQ.getCurrentSize();}
 
 private:
     int32_t sendDataNotify(int32_t msg_type,
@@ -129,6 +151,7 @@ private:
     qcamera_jpeg_data_t *findJpegJobByJobId(uint32_t jobId);
     mm_jpeg_color_format getColorfmtFromImgFmt(cam_format_t img_fmt);
     mm_jpeg_format_t getJpegImgTypeFromImgFmt(cam_format_t img_fmt);
+    void prewarmJpegSession(QCameraChannel *pChannel);
     int32_t getJpegEncodingConfig(mm_jpeg_encode_params_t& encode_parm,
                                   QCameraStream *main_stream,
                                   QCameraStream *thumb_stream);
@@ -149,8 +172,27 @@ private:
                                   int32_t cb_status);
     void releaseJpegJobData(qcamera_jpeg_data_t *job);
     static void releaseSaveJobData(void *data, void *user_data);
+    qcamera_jpeg_stream_file_t *getJpegStreamFile(uint32_t jobId);
+    void saveJpegChunk(qcamera_jpeg_evt_payload_t *chunk, bool save);
+    int32_t finishJpegStreamFile(qcamera_jpeg_stream_file_t *stream,
+                                 uint8_t *jpeg_data,
+                                 uint32_t jpeg_len);
+    void releaseJpegStreamFile(uint32_t jobId, bool unlinkFile);
+    void releaseJpegStreamFiles();
+    int32_t encodeThumbnailFirst(QCameraStream *thumb_stream,
+                                 const mm_jpeg_encode_job_t &main_job,
+                                 int rotation);
+    void destroyJpegThumbSession();
+    void dropJpegThumbnail();
+    bool processJpegThumbEvt(qcamera_jpeg_evt_payload_t *evt);
+    bool isThumbFirstSession();
+    camera_memory_t *insertJpegThumbnail(uint8_t *jpeg_data,
+                                         uint32_t jpeg_len,
+                                         camera_memory_t *room_mem);
+    uint32_t takeJpegThumbnailRoom(camera_memory_t *jpeg_mem);
     static void releaseRawData(void *data, void *user_data);
     int32_t processRawImageImpl(mm_camera_super_buf_t *recvd_frame);
+    bool holdRawFrame(bool streaming);
 
     static void releaseJpegData(void *data, void *user_data);
     static void releasePPInputData(void *data, void *user_data);
@@ -161,14 +203,20 @@ private:
 
     int32_t setYUVFrameInfo(mm_camera_super_buf_t *recvd_frame);
     static bool matchJobId(void *data, void *user_data, void *match_data);
+    static bool matchPPFrame(void *data, void *user_data, void *match_data);
     static int getJpegMemory(omx_jpeg_ouput_buf_t *out_buf);
 
     int32_t reprocess(qcamera_pp_data_t *pp_job);
     int32_t stopCapture();
+    uint32_t getFramesInFlight();
+    int32_t issueCaptureRequests();
+    void updateCaptureCredits();
+    void resetCaptureCredits();
 
 private:
     QCamera2HardwareInterface *m_parent;
     jpeg_encode_callback_t     mJpegCB;
+    jpeg_encode_chunk_callback_t mJpegChunkCB;
     void *                     mJpegUserData;
     mm_jpeg_ops_t              mJpegHandle;
     uint32_t                   mJpegClientHandle;
@@ -178,11 +226,13 @@ private:
     QCameraExif *              m_pJpegExifObj;
     int8_t                     m_bThumbnailNeeded;
     QCameraReprocessChannel *  m_pReprocChannel;
+    bool                       m_bNeedReprocess; // decided in start(), kept until stop()
 
     int8_t                     m_bInited; // if postproc is inited
 
     QCameraQueue m_inputPPQ;            // input queue for postproc
     QCameraQueue m_ongoingPPQ;          // ongoing postproc queue
+    uint32_t mPPInFlightMax;            // reprocess requests in flight, 0 if unbounded
     QCameraQueue m_inputJpegQ;          // input jpeg job queue
     QCameraQueue m_ongoingJpegQ;        // ongoing jpeg job queue
     QCameraQueue m_inputRawQ;           // input raw job queue
@@ -194,8 +244,44 @@ private:
     bool mUseSaveProc;                  // use store thread
     bool mUseJpegBurst;                 // use jpeg burst encoding mode
     bool mJpegMemOpt;
+    bool mJpegAutoOutBuf;               // mm-jpeg sizes and owns output bufs
     uint32_t   m_JpegOutputMemCount;
+    uint32_t   m_JpegOutputMemSize;
+    uint32_t   m_JpegBufGeneration;     // buffers bound to a warm jpeg session
     uint8_t mNewJpegSessionNeeded;
+    bool mJpegSessionCache;             // mm-jpeg keeps sessions warm
+    bool mJpegStreaming;                // stream longshot jpegs to file
+    // files of streaming encodes, only touched by the save thread
+    android::List<qcamera_jpeg_stream_file_t> mJpegStreamFiles;
+    bool mThumbFirst;                   // encode thumbnail ahead of main image
+    bool mThumbFirstSession;            // main session leaves thumbnail out,
+                                        // protected by mThumbLock
+    uint32_t mJpegThumbSessionId;       // session of the thumbnail jobs
+    QCameraStream *mJpegThumbSrcStream; // source of the thumbnail session
+    mm_jpeg_dim_t mJpegThumbDim;        // dims of the thumbnail session
+    int mJpegThumbRotation;             // rotation of the thumbnail session
+    void *m_pJpegThumbOutputMem;        // output buf of the thumbnail session
+    uint32_t m_JpegThumbOutputMemSize;
+    pthread_mutex_t mThumbLock;         // protects the thumbnail job state
+    uint32_t mThumbJobId;               // thumbnail job in flight, 0 if none
+    uint32_t mThumbDropJobId;           // thumbnail job not needed anymore
+    uint8_t *m_pThumbJpeg;              // thumbnail for the next main image
+    uint32_t m_nThumbJpegLen;
+    nsecs_t mThumbStartTime;            // start of the current capture
+    camera_memory_t *m_pThumbRoomMem;   // main jpeg mem with thumbnail room
+    uint32_t mThumbRoom;                // bytes left ahead of the main jpeg
+    // capture credits bound the frames held by the pipeline in longshot,
+    // frame requests beyond them wait until a stage drains
+    pthread_mutex_t mCreditLock;
+    uint32_t mCaptureCredits;           // max frames in flight, 0 if unbounded
+    QCameraPicChannel *m_pCreditChannel;// channel of the waiting requests
+    uint32_t mPendingRequests;          // frames requested, not received yet
+    uint32_t mDeferredRequests;         // frames waiting for a credit
+    bool mIssuingRequests;              // takePicture running without the lock
+    pthread_cond_t mCreditCond;         // signalled when the issue is done
+    qcamera_capture_pipe_stats_t mPipeStats;
+    bool mRawZeroCopy;                  // raw/yuv callbacks share stream bufs
+    uint32_t mRawFramesHeld;            // frames held by raw/yuv callbacks, under mCreditLock
 };
 
 }; // namespace qcamera
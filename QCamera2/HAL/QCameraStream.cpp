@@ -30,6 +30,7 @@
 #define LOG_TAG "QCameraStream"
 
 #include <utils/Errors.h>
+#include <cutils/properties.h>
 #include "QCamera2HWI.h"
 #include "QCameraStream.h"
 
@@ -826,6 +827,81 @@ int32_t QCameraStream::bufDone(const void *opaque, bool isMetaData)
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : mapStreamBufs
+ *
+ * DESCRIPTION: map the first numBufs stream buffers to server. When
+ *              persist.camera.bundled.map is set, buffers are sent in bundles
+ *              of up to CAM_MAX_NUM_BUFS_PER_MSG fds with one ack per bundle
+ *              instead of one round trip per buffer.
+ *
+ * PARAMETERS :
+ *   @ops_tbl    : ptr to buf mapping/unmapping ops
+ *   @numBufs    : number of buffers to be mapped
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code. Nothing is left mapped on failure.
+ *==========================================================================*/
+int32_t QCameraStream::mapStreamBufs(mm_camera_map_unmap_ops_tbl_t *ops_tbl,
+                                     uint8_t numBufs)
+{
+    int32_t rc = NO_ERROR;
+    int mapped = 0;
+    nsecs_t startTime = systemTime();
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.camera.bundled.map", value, "0");
+    bool bundled = (atoi(value) > 0) && (ops_tbl->bundled_map_ops != NULL);
+
+    while (mapped < numBufs) {
+        if (bundled) {
+            cam_buf_map_type_list bufMapList;
+            memset(&bufMapList, 0, sizeof(bufMapList));
+            while ((mapped + (int)bufMapList.length < numBufs) &&
+                    (bufMapList.length < CAM_MAX_NUM_BUFS_PER_MSG)) {
+                int idx = mapped + bufMapList.length;
+                cam_buf_map_type &bufMap = bufMapList.buf_maps[bufMapList.length++];
+                bufMap.type = CAM_MAPPING_BUF_TYPE_STREAM_BUF;
+                bufMap.frame_idx = idx;
+                bufMap.plane_idx = -1;
+                bufMap.fd = mStreamBufs->getFd(idx);
+                bufMap.size = mStreamBufs->getSize(idx);
+            }
+            rc = ops_tbl->bundled_map_ops(&bufMapList, ops_tbl->userdata);
+            if (rc < 0) {
+                // Server acks a bundle as a whole, so release the failed
+                // bundle along with everything mapped before it
+                ALOGE("%s: bundled map of bufs %d..%d failed: %d", __func__,
+                      mapped, mapped + (int)bufMapList.length - 1, rc);
+                mapped += bufMapList.length;
+                break;
+            }
+            mapped += bufMapList.length;
+        } else {
+            rc = ops_tbl->map_ops(mapped, -1, mStreamBufs->getFd(mapped),
+                    mStreamBufs->getSize(mapped), ops_tbl->userdata);
+            if (rc < 0) {
+                ALOGE("%s: map_stream_buf failed: %d", __func__, rc);
+                break;
+            }
+            mapped++;
+        }
+    }
+
+    if (rc < 0) {
+        for (int j = 0; j < mapped; j++) {
+            ops_tbl->unmap_ops(j, -1, ops_tbl->userdata);
+        }
+        return rc;
+    }
+
+    CDBG_HIGH("[KPI Perf] %s: stream type %d mapped %d bufs in %lld us, bundled %d",
+              __func__, mStreamInfo->stream_type, numBufs,
+              (systemTime() - startTime) / 1000LL, bundled);
+    return NO_ERROR;
+}
+
 /*===========================================================================
  * FUNCTION   : getBufs
  *
@@ -884,19 +960,12 @@ int32_t QCameraStream::getBufs(cam_frame_len_offset_t *offset,
         return NO_MEMORY;
     }
 
-    for (int i = 0; i < numBufAlloc; i++) {
-        rc = ops_tbl->map_ops(i, -1, mStreamBufs->getFd(i),
-                mStreamBufs->getSize(i), ops_tbl->userdata);
-        if (rc < 0) {
-            ALOGE("%s: map_stream_buf failed: %d", __func__, rc);
-            for (int j = 0; j < i; j++) {
-                ops_tbl->unmap_ops(j, -1, ops_tbl->userdata);
-            }
-            mStreamBufs->deallocate();
-            delete mStreamBufs;
-            mStreamBufs = NULL;
-            return INVALID_OPERATION;
-        }
+    rc = mapStreamBufs(ops_tbl, numBufAlloc);
+    if (rc < 0) {
+        mStreamBufs->deallocate();
+        delete mStreamBufs;
+        mStreamBufs = NULL;
+        return INVALID_OPERATION;
     }
 
     //regFlags array is allocated by us, but consumed and freed by mm-camera-interface
@@ -1609,6 +1678,16 @@ int32_t QCameraStream::configStream()
     stream_config.stream_cb = dataNotifyCB;
     stream_config.padding_info = mPaddingInfo;
     stream_config.userdata = this;
+
+    // Opt-in dispatch of frames straight from the data poll thread, one
+    // bit per cam_stream_type_t. dataNotifyCB only queues the frame to
+    // mProcTh, so it never blocks the poll thread.
+    char value[PROPERTY_VALUE_MAX];
+    property_get("persist.camera.direct.dispatch", value, "0");
+    uint32_t dispatchMask = (uint32_t)strtoul(value, NULL, 0);
+    stream_config.direct_dispatch =
+        (dispatchMask & (1 << mStreamInfo->stream_type)) ? 1 : 0;
+
     rc = mCamOps->config_stream(mCamHandle,
                 mChannelHandle, mHandle, &stream_config);
     if (rc < 0) {
@@ -176,6 +176,8 @@ private:
                      mm_camera_buf_def_t **bufs,
                      mm_camera_map_unmap_ops_tbl_t *ops_tbl);
     int32_t putBufs(mm_camera_map_unmap_ops_tbl_t *ops_tbl);
+    int32_t mapStreamBufs(mm_camera_map_unmap_ops_tbl_t *ops_tbl,
+                          uint8_t numBufs);
     int32_t invalidateBuf(int index);
     int32_t cleanInvalidateBuf(int index);
     int32_t calcOffset(cam_stream_info_t *streamInfo);
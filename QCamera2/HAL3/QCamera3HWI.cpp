@@ -37,6 +37,7 @@
 #include <fcntl.h>
 #include <utils/Log.h>
 #include <utils/Errors.h>
+#include <utils/Timers.h>
 #include <ui/Fence.h>
 #include <gralloc_priv.h>
 #include "QCamera3HWI.h"
@@ -55,6 +56,7 @@ namespace qcamera {
 cam_capability_t *gCamCapability[MM_CAMERA_MAX_NUM_SENSORS];
 parm_buffer_t *prevSettings;
 const camera_metadata_t *gStaticMetadata[MM_CAMERA_MAX_NUM_SENSORS];
+derived_info_t *gCamDerivedInfo[MM_CAMERA_MAX_NUM_SENSORS];
 volatile uint32_t gCamHal3LogLevel = 1;
 
 pthread_mutex_t QCamera3HardwareInterface::mCameraSessionLock =
@@ -192,6 +194,10 @@ camera3_device_ops_t QCamera3HardwareInterface::mCameraOps = {
 };
 
 int QCamera3HardwareInterface::kMaxInFlight = 5;
+// flush is expected to return within 100ms
+const nsecs_t QCamera3HardwareInterface::kFlushWarnTime = 100000000LL;
+// channels stopped in parallel by flush, further channels queue behind them
+const uint32_t QCamera3HardwareInterface::kFlushStopWorkers = 4;
 
 /*===========================================================================
  * FUNCTION   : QCamera3HardwareInterface
@@ -248,6 +254,11 @@ QCamera3HardwareInterface::QCamera3HardwareInterface(int cameraId,
     mCurrentRequestId = -1;
     pthread_mutex_init(&mMutex, NULL);
 
+    // workers are launched once and reused by every flush
+    if (mStopPool.init(kFlushStopWorkers, "CAM_flushStop") != NO_ERROR) {
+        ALOGE("%s: flush stop pool init failed, channels stop serially", __func__);
+    }
+
     for (size_t i = 0; i < CAMERA3_TEMPLATE_COUNT; i++)
         mDefaultMetadata[i] = NULL;
 
@@ -331,6 +342,8 @@ QCamera3HardwareInterface::~QCamera3HardwareInterface()
         if (mDefaultMetadata[i])
             free_camera_metadata(mDefaultMetadata[i]);
 
+    mStopPool.deinit();
+
     pthread_cond_destroy(&mRequestCond);
 
     pthread_mutex_destroy(&mMutex);
@@ -834,7 +847,11 @@ int QCamera3HardwareInterface::configureStreams(
 
     /* Initialize mPendingRequestInfo and mPendnigBuffersMap */
     mPendingRequestsList.clear();
-    mPendingFrameDropList.clear();
+    mFrameDropMap.clear();
+    mFrameTiming.reset();
+    mRequestLatency.reset();
+    mInFlightStats.reset();
+    mResultCbCpuTime.reset();
     // Initialize/Reset the pending buffers list
     mPendingBuffersMap.num_buffers = 0;
     mPendingBuffersMap.mPendingBufferList.clear();
@@ -994,14 +1011,15 @@ void QCamera3HardwareInterface::deriveMinFrameDuration()
 
     //Find minimum durations for processed, jpeg, and raw
     mMinRawFrameDuration = gCamCapability[mCameraId]->raw_min_duration;
-    for (int i = 0; i < gCamCapability[mCameraId]->picture_sizes_tbl_cnt; i++) {
-        if (maxProcessedDimension ==
-            gCamCapability[mCameraId]->picture_sizes_tbl[i].width *
-            gCamCapability[mCameraId]->picture_sizes_tbl[i].height) {
-            mMinProcessedFrameDuration = gCamCapability[mCameraId]->jpeg_min_duration[i];
-            mMinJpegFrameDuration = gCamCapability[mCameraId]->jpeg_min_duration[i];
-            break;
-        }
+    if (NULL == gCamDerivedInfo[mCameraId] && initDerivedInfo(mCameraId) < 0) {
+        return;
+    }
+    ssize_t idx =
+        gCamDerivedInfo[mCameraId]->min_duration.indexOfKey(maxProcessedDimension);
+    if (idx >= 0) {
+        mMinProcessedFrameDuration =
+            gCamDerivedInfo[mCameraId]->min_duration.valueAt(idx);
+        mMinJpegFrameDuration = mMinProcessedFrameDuration;
     }
 }
 
@@ -1061,9 +1079,15 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
     uint32_t urgent_frame_number = *(uint32_t *)
         POINTER_OF_META(CAM_INTF_META_URGENT_FRAME_NUMBER, metadata);
 
+    if (IS_META_AVAILABLE(CAM_INTF_META_SENSOR_FRAME_DURATION, metadata)) {
+        mFrameTiming.setFrameDuration(*(int64_t *)
+            POINTER_OF_META(CAM_INTF_META_SENSOR_FRAME_DURATION, metadata));
+    }
+
     if (urgent_frame_number_valid) {
         CDBG("%s: valid urgent frame_number = %d, capture_time = %lld",
           __func__, urgent_frame_number, capture_time);
+        mFrameTiming.update(urgent_frame_number, capture_time);
 
         //Recieved an urgent Frame Number, handle it
         //using HAL3.1 quirk for partial results
@@ -1077,8 +1101,8 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
                 i->bNotified == 0) {
                 notify_msg.type = CAMERA3_MSG_SHUTTER;
                 notify_msg.message.shutter.frame_number = i->frame_number;
-                notify_msg.message.shutter.timestamp = capture_time -
-                    (urgent_frame_number - i->frame_number) * NSEC_PER_33MSEC;
+                notify_msg.message.shutter.timestamp =
+                    mFrameTiming.estimateTimestamp(i->frame_number);
                 mCallbackOps->notify(mCallbackOps, &notify_msg);
                 i->timestamp = notify_msg.message.shutter.timestamp;
                 i->bNotified = 1;
@@ -1123,6 +1147,7 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
     }
     CDBG("%s: valid frame_number = %d, capture_time = %lld", __func__,
             frame_number, capture_time);
+    mFrameTiming.update(frame_number, capture_time);
 
     // Go through the pending requests info and send shutter/results to frameworks
     for (List<PendingRequestInfo>::iterator i = mPendingRequestsList.begin();
@@ -1135,31 +1160,32 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
 
         // Check whether any stream buffer corresponding to this is dropped or not
         // If dropped, then send the ERROR_BUFFER for the corresponding stream
-        if (cam_frame_drop.frame_dropped) {
-            camera3_notify_msg_t notify_msg;
-            for (List<RequestedBufferInfo>::iterator j = i->buffers.begin();
-                    j != i->buffers.end(); j++) {
-                QCamera3Channel *channel = (QCamera3Channel *)j->stream->priv;
-                uint32_t streamID = channel->getStreamID(channel->getStreamTypeMask());
-                for (uint32_t k = 0; k < cam_frame_drop.cam_stream_ID.num_streams; k++) {
-                   if (streamID == cam_frame_drop.cam_stream_ID.streamID[k]) {
-                       // Send Error notify to frameworks with CAMERA3_MSG_ERROR_BUFFER
-                       CDBG("%s: Start of reporting error frame#=%d, streamID=%d",
-                              __func__, i->frame_number, streamID);
-                       notify_msg.type = CAMERA3_MSG_ERROR;
-                       notify_msg.message.error.frame_number = i->frame_number;
-                       notify_msg.message.error.error_code = CAMERA3_MSG_ERROR_BUFFER ;
-                       notify_msg.message.error.error_stream = j->stream;
-                       mCallbackOps->notify(mCallbackOps, &notify_msg);
-                       CDBG("%s: End of reporting error frame#=%d, streamID=%d",
-                              __func__, i->frame_number, streamID);
-                       PendingFrameDropInfo PendingFrameDrop;
-                       PendingFrameDrop.frame_number=i->frame_number;
-                       PendingFrameDrop.stream_ID = streamID;
-                       // Add the Frame drop info to mPendingFrameDropList
-                       mPendingFrameDropList.push_back(PendingFrameDrop);
-                   }
-                }
+        for (List<RequestedBufferInfo>::iterator j = i->buffers.begin();
+                j != i->buffers.end(); j++) {
+            QCamera3Channel *channel = (QCamera3Channel *)j->stream->priv;
+            uint32_t streamID = channel->getStreamID(channel->getStreamTypeMask());
+            FrameDropInfo &dropInfo = getFrameDropInfo(streamID);
+            dropInfo.num_frames++;
+            if (!cam_frame_drop.frame_dropped) {
+                continue;
+            }
+            for (uint32_t k = 0; k < cam_frame_drop.cam_stream_ID.num_streams; k++) {
+               if (streamID == cam_frame_drop.cam_stream_ID.streamID[k]) {
+                   // Send Error notify to frameworks with CAMERA3_MSG_ERROR_BUFFER
+                   CDBG("%s: Start of reporting error frame#=%d, streamID=%d",
+                          __func__, i->frame_number, streamID);
+                   camera3_notify_msg_t notify_msg;
+                   notify_msg.type = CAMERA3_MSG_ERROR;
+                   notify_msg.message.error.frame_number = i->frame_number;
+                   notify_msg.message.error.error_code = CAMERA3_MSG_ERROR_BUFFER ;
+                   notify_msg.message.error.error_stream = j->stream;
+                   mCallbackOps->notify(mCallbackOps, &notify_msg);
+                   CDBG("%s: End of reporting error frame#=%d, streamID=%d",
+                          __func__, i->frame_number, streamID);
+                   // Book-keep the drop until the buffer comes back
+                   markFrameDropped(dropInfo, i->frame_number);
+                   break;
+               }
             }
         }
 
@@ -1249,17 +1275,12 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
             for (List<RequestedBufferInfo>::iterator j = i->buffers.begin();
                     j != i->buffers.end(); j++) {
                 if (j->buffer) {
-                    for (List<PendingFrameDropInfo>::iterator m = mPendingFrameDropList.begin();
-                            m != mPendingFrameDropList.end(); m++) {
-                        QCamera3Channel *channel = (QCamera3Channel *)j->buffer->stream->priv;
-                        uint32_t streamID = channel->getStreamID(channel->getStreamTypeMask());
-                        if((m->stream_ID == streamID) && (m->frame_number==frame_number)) {
-                            j->buffer->status=CAMERA3_BUFFER_STATUS_ERROR;
-                            CDBG("%s: Stream STATUS_ERROR frame_number=%d, streamID=%d",
-                                  __func__, frame_number, streamID);
-                            m = mPendingFrameDropList.erase(m);
-                            break;
-                        }
+                    QCamera3Channel *channel = (QCamera3Channel *)j->buffer->stream->priv;
+                    uint32_t streamID = channel->getStreamID(channel->getStreamTypeMask());
+                    if (clearFrameDropped(streamID, i->frame_number)) {
+                        j->buffer->status=CAMERA3_BUFFER_STATUS_ERROR;
+                        CDBG("%s: Stream STATUS_ERROR frame_number=%d, streamID=%d",
+                              __func__, i->frame_number, streamID);
                     }
 
                     for (List<PendingBufferInfo>::iterator k =
@@ -1293,6 +1314,11 @@ void QCamera3HardwareInterface::handleMetadataWithLock(
                         __func__, result.frame_number, i->timestamp);
             free_camera_metadata((camera_metadata_t *)result.result);
         }
+        // buffers still outstanding complete the request in handleBufferWithLock
+        if (!hasPendingBuffers(i->frame_number)) {
+            mRequestLatency.add((systemTime(SYSTEM_TIME_MONOTONIC) -
+                    i->request_time) / NSEC_PER_USEC);
+        }
         // erase the element from the list
         i = mPendingRequestsList.erase(i);
     }
@@ -1337,22 +1363,18 @@ void QCamera3HardwareInterface::handleBufferWithLock(
         result.result = NULL;
         result.frame_number = frame_number;
         result.num_output_buffers = 1;
-        for (List<PendingFrameDropInfo>::iterator m = mPendingFrameDropList.begin();
-                m != mPendingFrameDropList.end(); m++) {
-            QCamera3Channel *channel = (QCamera3Channel *)buffer->stream->priv;
-            uint32_t streamID = channel->getStreamID(channel->getStreamTypeMask());
-            if((m->stream_ID == streamID) && (m->frame_number==frame_number) ) {
-                buffer->status=CAMERA3_BUFFER_STATUS_ERROR;
-                CDBG("%s: Stream STATUS_ERROR frame_number=%d, streamID=%d",
-                        __func__, frame_number, streamID);
-                m = mPendingFrameDropList.erase(m);
-                break;
-            }
+        QCamera3Channel *channel = (QCamera3Channel *)buffer->stream->priv;
+        uint32_t streamID = channel->getStreamID(channel->getStreamTypeMask());
+        if (clearFrameDropped(streamID, frame_number)) {
+            buffer->status=CAMERA3_BUFFER_STATUS_ERROR;
+            CDBG("%s: Stream STATUS_ERROR frame_number=%d, streamID=%d",
+                    __func__, frame_number, streamID);
         }
         result.output_buffers = buffer;
         CDBG("%s: result frame_number = %d, buffer = %p",
                 __func__, frame_number, buffer->buffer);
 
+        nsecs_t request_time = 0;
         for (List<PendingBufferInfo>::iterator k =
                 mPendingBuffersMap.mPendingBufferList.begin();
                 k != mPendingBuffersMap.mPendingBufferList.end(); k++ ) {
@@ -1360,6 +1382,7 @@ void QCamera3HardwareInterface::handleBufferWithLock(
                 CDBG("%s: Found Frame buffer, take it out from list",
                         __func__);
 
+                request_time = k->request_time;
                 mPendingBuffersMap.num_buffers--;
                 k = mPendingBuffersMap.mPendingBufferList.erase(k);
                 break;
@@ -1368,6 +1391,12 @@ void QCamera3HardwareInterface::handleBufferWithLock(
         CDBG("%s: mPendingBuffersMap.num_buffers = %d",
             __func__, mPendingBuffersMap.num_buffers);
 
+        // metadata is already out, the last buffer completes the request
+        if ((request_time > 0) && !hasPendingBuffers(frame_number)) {
+            mRequestLatency.add((systemTime(SYSTEM_TIME_MONOTONIC) -
+                    request_time) / NSEC_PER_USEC);
+        }
+
         if (buffer->stream->stream_type == CAMERA3_STREAM_BIDIRECTIONAL) {
             int found = 0;
             for (List<MetadataBufferInfo>::iterator k = mStoredMetadataList.begin();
@@ -1404,6 +1433,139 @@ void QCamera3HardwareInterface::handleBufferWithLock(
     }
 }
 
+/*===========================================================================
+ * FUNCTION   : getFrameDropInfo
+ *
+ * DESCRIPTION: Get the frame drop book-keeping of a stream, creating it on
+ *              first use. Note that mMutex is held when this function is
+ *              called.
+ *
+ * PARAMETERS : @streamID: server stream ID
+ *
+ * RETURN     : reference to the frame drop info of the stream
+ *
+ *==========================================================================*/
+QCamera3HardwareInterface::FrameDropInfo &
+        QCamera3HardwareInterface::getFrameDropInfo(uint32_t streamID)
+{
+    ssize_t idx = mFrameDropMap.indexOfKey(streamID);
+    if (idx < 0) {
+        FrameDropInfo dropInfo;
+        memset(&dropInfo, 0, sizeof(dropInfo));
+        idx = mFrameDropMap.add(streamID, dropInfo);
+    }
+    return mFrameDropMap.editValueAt(idx);
+}
+
+/*===========================================================================
+ * FUNCTION   : markFrameDropped
+ *
+ * DESCRIPTION: Record a dropped frame in the pending drop bitmap of a stream.
+ *              The bitmap window starts at the oldest pending drop and
+ *              slides forward when a drop falls outside of it; drops slid
+ *              out of the window were never claimed by a buffer and are
+ *              discarded.
+ *
+ * PARAMETERS : @dropInfo: frame drop info of the stream
+ *              @frame_number: dropped frame number
+ *
+ * RETURN     :
+ *
+ *==========================================================================*/
+void QCamera3HardwareInterface::markFrameDropped(FrameDropInfo &dropInfo,
+        uint32_t frame_number)
+{
+    dropInfo.num_dropped++;
+    if (dropInfo.pending == 0) {
+        dropInfo.base_frame = frame_number;
+    } else if (frame_number < dropInfo.base_frame) {
+        uint32_t shift = dropInfo.base_frame - frame_number;
+        if (shift >= MAX_PENDING_DROPS ||
+                (dropInfo.pending >> (MAX_PENDING_DROPS - shift)) != 0) {
+            ALOGE("%s: frame %d is too old to track, oldest pending drop %d",
+                    __func__, frame_number, dropInfo.base_frame);
+            return;
+        }
+        dropInfo.pending <<= shift;
+        dropInfo.base_frame = frame_number;
+    } else if (frame_number - dropInfo.base_frame >= MAX_PENDING_DROPS) {
+        uint32_t shift = frame_number - dropInfo.base_frame -
+                MAX_PENDING_DROPS + 1;
+        ALOGE("%s: discarding stale drops before frame %d", __func__,
+                dropInfo.base_frame + shift);
+        dropInfo.pending = (shift >= MAX_PENDING_DROPS) ?
+                0 : (dropInfo.pending >> shift);
+        dropInfo.base_frame += shift;
+    }
+    dropInfo.pending |= 1ULL << (frame_number - dropInfo.base_frame);
+}
+
+/*===========================================================================
+ * FUNCTION   : hasPendingBuffers
+ *
+ * DESCRIPTION: Check whether buffers of a frame are still to be returned to
+ *              the framework. Note that mMutex is held when this function
+ *              is called.
+ *
+ * PARAMETERS : @frame_number: frame number of the request
+ *
+ * RETURN     : true if a buffer of the frame is pending
+ *
+ *==========================================================================*/
+bool QCamera3HardwareInterface::hasPendingBuffers(uint32_t frame_number)
+{
+    for (List<PendingBufferInfo>::iterator k =
+            mPendingBuffersMap.mPendingBufferList.begin();
+            k != mPendingBuffersMap.mPendingBufferList.end(); k++) {
+        if (k->frame_number == frame_number) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*===========================================================================
+ * FUNCTION   : clearFrameDropped
+ *
+ * DESCRIPTION: Check whether the frame of a stream was dropped, and if so
+ *              clear it from the pending drop bitmap. Note that mMutex is
+ *              held when this function is called.
+ *
+ * PARAMETERS : @streamID: server stream ID
+ *              @frame_number: frame number of the buffer
+ *
+ * RETURN     : true if the frame was dropped
+ *
+ *==========================================================================*/
+bool QCamera3HardwareInterface::clearFrameDropped(uint32_t streamID,
+        uint32_t frame_number)
+{
+    ssize_t idx = mFrameDropMap.indexOfKey(streamID);
+    if (idx < 0) {
+        return false;
+    }
+
+    FrameDropInfo &dropInfo = mFrameDropMap.editValueAt(idx);
+    if (dropInfo.pending == 0 || frame_number < dropInfo.base_frame ||
+            frame_number - dropInfo.base_frame >= MAX_PENDING_DROPS) {
+        return false;
+    }
+
+    uint64_t bit = 1ULL << (frame_number - dropInfo.base_frame);
+    if (!(dropInfo.pending & bit)) {
+        return false;
+    }
+
+    dropInfo.pending &= ~bit;
+    if (dropInfo.pending != 0) {
+        // Re-anchor the window at the oldest pending drop
+        uint32_t oldest = __builtin_ctzll(dropInfo.pending);
+        dropInfo.pending >>= oldest;
+        dropInfo.base_frame += oldest;
+    }
+    return true;
+}
+
 /*===========================================================================
  * FUNCTION   : unblockRequestIfNecessary
  *
@@ -1613,6 +1775,7 @@ int QCamera3HardwareInterface::processCaptureRequest(
     pendingRequest.request_id = request_id;
     pendingRequest.blob_request = blob_request;
     pendingRequest.bNotified = 0;
+    pendingRequest.request_time = systemTime(SYSTEM_TIME_MONOTONIC);
     if (blob_request)
         pendingRequest.input_jpeg_settings = *mJpegSettings;
     pendingRequest.input_buffer_present = (request->input_buffer != NULL)? 1 : 0;
@@ -1628,6 +1791,7 @@ int QCamera3HardwareInterface::processCaptureRequest(
         bufferInfo.frame_number = frameNumber;
         bufferInfo.buffer = request->output_buffers[i].buffer;
         bufferInfo.stream = request->output_buffers[i].stream;
+        bufferInfo.request_time = pendingRequest.request_time;
         mPendingBuffersMap.mPendingBufferList.push_back(bufferInfo);
         mPendingBuffersMap.num_buffers++;
         CDBG("%s: frame = %d, buffer = %p, stream = %p, stream format = %d",
@@ -1637,6 +1801,7 @@ int QCamera3HardwareInterface::processCaptureRequest(
     CDBG("%s: mPendingBuffersMap.num_buffers = %d",
           __func__, mPendingBuffersMap.num_buffers);
     mPendingRequestsList.push_back(pendingRequest);
+    mInFlightStats.add(mPendingRequestsList.size());
 
     // Notify metadata channel we receive a request
     mMetadataChannel->request(NULL, frameNumber);
@@ -1834,27 +1999,73 @@ void QCamera3HardwareInterface::dump(int fd)
     }
     fdprintf(fd, "-------+-------------\n");
 
-    fdprintf(fd, "\nPending frame drop list: %d\n",
-        mPendingFrameDropList.size());
-    fdprintf(fd, "-------+-----------\n");
-    fdprintf(fd, " Frame | Stream ID \n");
-    fdprintf(fd, "-------+-----------\n");
-    for(List<PendingFrameDropInfo>::iterator i = mPendingFrameDropList.begin();
-        i != mPendingFrameDropList.end(); i++) {
-        fdprintf(fd, " %5d | %9d \n",
-            i->frame_number, i->stream_ID);
-    }
-    fdprintf(fd, "-------+-----------\n");
+    fdprintf(fd, "\nFrame drops per stream: %d\n",
+        mFrameDropMap.size());
+    fdprintf(fd, "-----------+----------+---------+-----------+------------+--------------\n");
+    fdprintf(fd, " Stream ID |  Frames  | Dropped | Drop rate | Base frame | Pending mask \n");
+    fdprintf(fd, "-----------+----------+---------+-----------+------------+--------------\n");
+    for (size_t i = 0; i < mFrameDropMap.size(); i++) {
+        const FrameDropInfo &dropInfo = mFrameDropMap.valueAt(i);
+        fdprintf(fd, " %9d | %8d | %7d | %8d%% | %10d | 0x%llx \n",
+            mFrameDropMap.keyAt(i), dropInfo.num_frames, dropInfo.num_dropped,
+            dropInfo.num_frames ?
+                dropInfo.num_dropped * 100 / dropInfo.num_frames : 0,
+            dropInfo.base_frame, dropInfo.pending);
+    }
+    fdprintf(fd, "-----------+----------+---------+-----------+------------+--------------\n");
+
+    fdprintf(fd, "\nEstimated sensor frame interval: %lld ns\n",
+        mFrameTiming.getFrameInterval());
+
+    fdprintf(fd, "\nRequest statistics since configure_streams\n");
+    fdprintf(fd, "-------------------------+-------+-------+-------+-------+-------\n");
+    fdprintf(fd, "                         | Count |  P50  |  P90  |  P99  |  Max  \n");
+    fdprintf(fd, "-------------------------+-------+-------+-------+-------+-------\n");
+    fdprintf(fd, " Request to complete (us)| %5d | %5lld | %5lld | %5lld | %5lld \n",
+        mRequestLatency.getCount(), mRequestLatency.getPercentile(50),
+        mRequestLatency.getPercentile(90), mRequestLatency.getPercentile(99),
+        mRequestLatency.getMax());
+    fdprintf(fd, " In-flight requests      | %5d | %5lld | %5lld | %5lld | %5lld \n",
+        mInFlightStats.getCount(), mInFlightStats.getPercentile(50),
+        mInFlightStats.getPercentile(90), mInFlightStats.getPercentile(99),
+        mInFlightStats.getMax());
+    fdprintf(fd, " Result callback CPU (us)| %5d | %5lld | %5lld | %5lld | %5lld \n",
+        mResultCbCpuTime.getCount(), mResultCbCpuTime.getPercentile(50),
+        mResultCbCpuTime.getPercentile(90), mResultCbCpuTime.getPercentile(99),
+        mResultCbCpuTime.getMax());
+    fdprintf(fd, " Flush duration (us)     | %5d | %5lld | %5lld | %5lld | %5lld \n",
+        mFlushLatency.getCount(), mFlushLatency.getPercentile(50),
+        mFlushLatency.getPercentile(90), mFlushLatency.getPercentile(99),
+        mFlushLatency.getMax());
+    fdprintf(fd, "-------------------------+-------+-------+-------+-------+-------\n");
 
     fdprintf(fd, "\n Camera HAL3 information End \n");
     pthread_mutex_unlock(&mMutex);
     return;
 }
 
+/*===========================================================================
+ * FUNCTION   : stopChannelJob
+ *
+ * DESCRIPTION: flush job stopping one channel on a stop pool worker
+ *
+ * PARAMETERS :
+ *   @data    : QCamera3Channel to be stopped
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCamera3HardwareInterface::stopChannelJob(void *data)
+{
+    QCamera3Channel *channel = (QCamera3Channel *)data;
+    channel->stop();
+}
+
 /*===========================================================================
  * FUNCTION   : flush
  *
- * DESCRIPTION:
+ * DESCRIPTION: stop all channels concurrently and return all pending
+ *              requests and buffers with errors, one capture result per
+ *              frame number.
  *
  * PARAMETERS :
  *
@@ -1863,26 +2074,33 @@ void QCamera3HardwareInterface::dump(int fd)
  *==========================================================================*/
 int QCamera3HardwareInterface::flush()
 {
-
-    unsigned int frameNum = 0;
     camera3_notify_msg_t notify_msg;
     camera3_capture_result_t result;
-    camera3_stream_buffer_t pStream_Buf;
+    nsecs_t flushStart = systemTime(SYSTEM_TIME_MONOTONIC);
+    Vector<void *> stopChannels;
+    Vector<camera3_stream_buffer_t> errorBuffers;
 
     CDBG("%s: Unblocking Process Capture Request", __func__);
 
-    // Stop the Streams/Channels
+    // Stop the Streams/Channels concurrently on the stop pool workers
     for (List<stream_info_t *>::iterator it = mStreamInfo.begin();
         it != mStreamInfo.end(); it++) {
-        QCamera3Channel *channel = (QCamera3Channel *)(*it)->stream->priv;
-        channel->stop();
+        stopChannels.push_back((*it)->stream->priv);
         (*it)->status = INVALID;
     }
+    if (!stopChannels.isEmpty()) {
+        mStopPool.run(stopChannelJob, stopChannels.editArray(),
+                (uint32_t)stopChannels.size());
+    }
 
     if (mMetadataChannel) {
-        /* If content of mStreamInfo is not 0, there is metadata stream */
+        /* If content of mStreamInfo is not 0, there is metadata stream.
+         * It is stopped last so metadata of in-flight frames still flows
+         * while the streams are being stopped */
         mMetadataChannel->stop();
     }
+    CDBG_HIGH("[KPI Perf] %s: channels stopped in %lld us", __func__,
+            (systemTime(SYSTEM_TIME_MONOTONIC) - flushStart) / NSEC_PER_USEC);
 
     // Mutex Lock
     pthread_mutex_lock(&mMutex);
@@ -1891,111 +2109,85 @@ int QCamera3HardwareInterface::flush()
     mPendingRequest = 0;
     pthread_cond_signal(&mRequestCond);
 
-    List<PendingRequestInfo>::iterator i = mPendingRequestsList.begin();
-    frameNum = i->frame_number;
-    CDBG("%s: Latest frame num on  mPendingRequestsList = %d",
-      __func__, frameNum);
+    CDBG("%s:Sending ERROR for all pending requests and buffers", __func__);
 
-    // Go through the pending buffers and send buffer errors
-    for (List<PendingBufferInfo>::iterator k =
-         mPendingBuffersMap.mPendingBufferList.begin();
-         k != mPendingBuffersMap.mPendingBufferList.end();  ) {
-         CDBG("%s: frame = %d, buffer = %p, stream = %p, stream format = %d",
-          __func__, k->frame_number, k->buffer, k->stream,
-          k->stream->format);
-
-        if (k->frame_number < frameNum) {
-            // Send Error notify to frameworks for each buffer for which
-            // metadata buffer is already sent
-            CDBG("%s: Sending ERROR BUFFER for frame %d, buffer %p",
-              __func__, k->frame_number, k->buffer);
+    // Both lists are ordered by frame number. Walk them together so that
+    // each frame gets its error notify(s) followed by a single result
+    // carrying all of its buffers.
+    List<PendingRequestInfo>::iterator i = mPendingRequestsList.begin();
+    List<PendingBufferInfo>::iterator k =
+            mPendingBuffersMap.mPendingBufferList.begin();
+    while (i != mPendingRequestsList.end() ||
+            k != mPendingBuffersMap.mPendingBufferList.end()) {
+        uint32_t frameNum;
+        bool requestError = false;
+
+        if (k == mPendingBuffersMap.mPendingBufferList.end() ||
+                (i != mPendingRequestsList.end() &&
+                 i->frame_number <= k->frame_number)) {
+            frameNum = i->frame_number;
+        } else {
+            frameNum = k->frame_number;
+        }
 
+        if (i != mPendingRequestsList.end() && i->frame_number == frameNum) {
+            // Metadata not sent yet, fail the whole request
+            CDBG("%s:Sending ERROR REQUEST for frame %d", __func__, frameNum);
             notify_msg.type = CAMERA3_MSG_ERROR;
-            notify_msg.message.error.error_code = CAMERA3_MSG_ERROR_BUFFER;
-            notify_msg.message.error.error_stream = k->stream;
-            notify_msg.message.error.frame_number = k->frame_number;
+            notify_msg.message.error.error_code = CAMERA3_MSG_ERROR_REQUEST;
+            notify_msg.message.error.error_stream = NULL;
+            notify_msg.message.error.frame_number = frameNum;
             mCallbackOps->notify(mCallbackOps, &notify_msg);
-            CDBG("%s: notify frame_number = %d", __func__,
-                    i->frame_number);
-
-            pStream_Buf.acquire_fence = -1;
-            pStream_Buf.release_fence = -1;
-            pStream_Buf.buffer = k->buffer;
-            pStream_Buf.status = CAMERA3_BUFFER_STATUS_ERROR;
-            pStream_Buf.stream = k->stream;
-
-            result.result = NULL;
-            result.frame_number = k->frame_number;
-            result.num_output_buffers = 1;
-            result.output_buffers = &pStream_Buf ;
-            mCallbackOps->process_capture_result(mCallbackOps, &result);
-
-            mPendingBuffersMap.num_buffers--;
-            k = mPendingBuffersMap.mPendingBufferList.erase(k);
-        }
-        else {
-          k++;
+            requestError = true;
+            i = mPendingRequestsList.erase(i);
         }
-    }
-
-    CDBG("%s:Sending ERROR REQUEST for all pending requests", __func__);
 
-    // Go through the pending requests info and send error request to framework
-    for (i = mPendingRequestsList.begin(); i != mPendingRequestsList.end(); ) {
-        int numBuffers = 0;
-        CDBG("%s:Sending ERROR REQUEST for frame %d",
-              __func__, i->frame_number);
-
-        // Send shutter notify to frameworks
-        notify_msg.type = CAMERA3_MSG_ERROR;
-        notify_msg.message.error.error_code = CAMERA3_MSG_ERROR_REQUEST;
-        notify_msg.message.error.error_stream = NULL;
-        notify_msg.message.error.frame_number = i->frame_number;
-        mCallbackOps->notify(mCallbackOps, &notify_msg);
-
-        result.frame_number = i->frame_number;
-        result.num_output_buffers = 0;
-        result.output_buffers = NULL;
-        numBuffers = 0;
-
-        for (List<PendingBufferInfo>::iterator k =
-             mPendingBuffersMap.mPendingBufferList.begin();
-             k != mPendingBuffersMap.mPendingBufferList.end(); ) {
-          if (k->frame_number == i->frame_number) {
+        errorBuffers.clear();
+        while (k != mPendingBuffersMap.mPendingBufferList.end() &&
+                k->frame_number == frameNum) {
             CDBG("%s: Sending Error for frame = %d, buffer = %p,"
                    " stream = %p, stream format = %d",__func__,
                    k->frame_number, k->buffer, k->stream, k->stream->format);
+            if (!requestError) {
+                // Metadata for this frame is already sent, fail the buffer
+                notify_msg.type = CAMERA3_MSG_ERROR;
+                notify_msg.message.error.error_code = CAMERA3_MSG_ERROR_BUFFER;
+                notify_msg.message.error.error_stream = k->stream;
+                notify_msg.message.error.frame_number = frameNum;
+                mCallbackOps->notify(mCallbackOps, &notify_msg);
+            }
 
+            camera3_stream_buffer_t pStream_Buf;
             pStream_Buf.acquire_fence = -1;
             pStream_Buf.release_fence = -1;
             pStream_Buf.buffer = k->buffer;
             pStream_Buf.status = CAMERA3_BUFFER_STATUS_ERROR;
             pStream_Buf.stream = k->stream;
+            errorBuffers.push_back(pStream_Buf);
 
-            result.num_output_buffers = 1;
-            result.output_buffers = &pStream_Buf;
-            result.result = NULL;
-            result.frame_number = i->frame_number;
-
-            mCallbackOps->process_capture_result(mCallbackOps, &result);
             mPendingBuffersMap.num_buffers--;
             k = mPendingBuffersMap.mPendingBufferList.erase(k);
-            numBuffers++;
-          }
-          else {
-            k++;
-          }
         }
-        CDBG("%s: mPendingBuffersMap.num_buffers = %d",
-              __func__, mPendingBuffersMap.num_buffers);
 
-        i = mPendingRequestsList.erase(i);
+        if (!errorBuffers.isEmpty()) {
+            result.result = NULL;
+            result.frame_number = frameNum;
+            result.num_output_buffers = errorBuffers.size();
+            result.output_buffers = errorBuffers.array();
+            mCallbackOps->process_capture_result(mCallbackOps, &result);
+        }
     }
+    CDBG("%s: mPendingBuffersMap.num_buffers = %d",
+          __func__, mPendingBuffersMap.num_buffers);
 
     /* Reset pending buffer list and requests list */
     mPendingRequestsList.clear();
-    /* Reset pending frame Drop list and requests list */
-    mPendingFrameDropList.clear();
+    /* Reset pending frame drops, drop statistics are kept */
+    for (size_t d = 0; d < mFrameDropMap.size(); d++) {
+        mFrameDropMap.editValueAt(d).pending = 0;
+    }
+    /* Streams restart after flush, timing history is stale */
+    mFrameTiming.reset();
 
     mPendingBuffersMap.num_buffers = 0;
     mPendingBuffersMap.mPendingBufferList.clear();
@@ -2014,6 +2206,16 @@ int QCamera3HardwareInterface::flush()
 
 
     mFirstRequest = true;
+
+    nsecs_t flushTime = systemTime(SYSTEM_TIME_MONOTONIC) - flushStart;
+    mFlushLatency.add(flushTime / NSEC_PER_USEC);
+    if (flushTime > kFlushWarnTime) {
+        ALOGE("%s: flush took %lld us, longer than %lld us", __func__,
+                flushTime / NSEC_PER_USEC, kFlushWarnTime / NSEC_PER_USEC);
+    }
+    CDBG_HIGH("[KPI Perf] %s: X flush took %lld us", __func__,
+            flushTime / NSEC_PER_USEC);
+
     pthread_mutex_unlock(&mMutex);
     return 0;
 }
@@ -2034,6 +2236,9 @@ int QCamera3HardwareInterface::flush()
 void QCamera3HardwareInterface::captureResultCb(mm_camera_super_buf_t *metadata_buf,
                 camera3_stream_buffer_t *buffer, uint32_t frame_number)
 {
+    struct timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+
     pthread_mutex_lock(&mMutex);
 
     if (metadata_buf)
@@ -2041,6 +2246,10 @@ void QCamera3HardwareInterface::captureResultCb(mm_camera_super_buf_t *metadata_
     else
         handleBufferWithLock(buffer, frame_number);
     pthread_mutex_unlock(&mMutex);
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    mResultCbCpuTime.add(((int64_t)(end.tv_sec - start.tv_sec) * NSEC_PER_SEC +
+            (end.tv_nsec - start.tv_nsec)) / NSEC_PER_USEC);
     return;
 }
 
@@ -2952,17 +3161,10 @@ void QCamera3HardwareInterface::deinitParameters()
  *==========================================================================*/
 int QCamera3HardwareInterface::calcMaxJpegSize(uint8_t camera_id)
 {
-    int32_t max_jpeg_size = 0;
-    int temp_width, temp_height;
-    for (int i = 0; i < gCamCapability[camera_id]->picture_sizes_tbl_cnt; i++) {
-        temp_width = gCamCapability[camera_id]->picture_sizes_tbl[i].width;
-        temp_height = gCamCapability[camera_id]->picture_sizes_tbl[i].height;
-        if (temp_width * temp_height > max_jpeg_size ) {
-            max_jpeg_size = temp_width * temp_height;
-        }
+    if (NULL == gCamDerivedInfo[camera_id] && initDerivedInfo(camera_id) < 0) {
+        return 0;
     }
-    max_jpeg_size = max_jpeg_size * 3/2 + sizeof(camera3_jpeg_blob_t);
-    return max_jpeg_size;
+    return gCamDerivedInfo[camera_id]->max_jpeg_size;
 }
 
 /*===========================================================================
@@ -2976,22 +3178,62 @@ int QCamera3HardwareInterface::calcMaxJpegSize(uint8_t camera_id)
  *==========================================================================*/
 cam_dimension_t QCamera3HardwareInterface::calcMaxJpegDim()
 {
-    cam_dimension_t max_jpeg_dim;
-    cam_dimension_t curr_jpeg_dim;
-    max_jpeg_dim.width = 0;
-    max_jpeg_dim.height = 0;
-    curr_jpeg_dim.width = 0;
-    curr_jpeg_dim.height = 0;
-    for (int i = 0; i < gCamCapability[mCameraId]->picture_sizes_tbl_cnt; i++) {
-        curr_jpeg_dim.width = gCamCapability[mCameraId]->picture_sizes_tbl[i].width;
-        curr_jpeg_dim.height = gCamCapability[mCameraId]->picture_sizes_tbl[i].height;
-        if (curr_jpeg_dim.width * curr_jpeg_dim.height >
-            max_jpeg_dim.width * max_jpeg_dim.height ) {
-            max_jpeg_dim.width = curr_jpeg_dim.width;
-            max_jpeg_dim.height = curr_jpeg_dim.height;
+    if (NULL == gCamDerivedInfo[mCameraId] && initDerivedInfo(mCameraId) < 0) {
+        cam_dimension_t max_jpeg_dim;
+        max_jpeg_dim.width = 0;
+        max_jpeg_dim.height = 0;
+        return max_jpeg_dim;
+    }
+    return gCamDerivedInfo[mCameraId]->max_jpeg_dim;
+}
+
+/*===========================================================================
+ * FUNCTION   : initDerivedInfo
+ *
+ * DESCRIPTION: derive lookup tables from the camera capabilities once per
+ *              camera id. They are kept across camera opens so that per
+ *              session/request lookups don't walk the capability tables.
+ *
+ * PARAMETERS :
+ *   @cameraId  : camera Id
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int QCamera3HardwareInterface::initDerivedInfo(int cameraId)
+{
+    if (NULL == gCamCapability[cameraId]) {
+        ALOGE("%s: capabilities of camera %d not queried yet", __func__, cameraId);
+        return BAD_VALUE;
+    }
+
+    derived_info_t *info = new derived_info_t;
+    if (NULL == info) {
+        ALOGE("%s: out of memory", __func__);
+        return NO_MEMORY;
+    }
+
+    int32_t max_jpeg_area = 0;
+    info->max_jpeg_dim.width = 0;
+    info->max_jpeg_dim.height = 0;
+    for (int i = 0; i < gCamCapability[cameraId]->picture_sizes_tbl_cnt; i++) {
+        cam_dimension_t dim = gCamCapability[cameraId]->picture_sizes_tbl[i];
+        int32_t area = dim.width * dim.height;
+        if (area > max_jpeg_area) {
+            max_jpeg_area = area;
+            info->max_jpeg_dim = dim;
+        }
+        // first table entry wins for sizes of equal area
+        if (info->min_duration.indexOfKey(area) < 0) {
+            info->min_duration.add(area,
+                gCamCapability[cameraId]->jpeg_min_duration[i]);
         }
     }
-    return max_jpeg_dim;
+    info->max_jpeg_size = max_jpeg_area * 3/2 + sizeof(camera3_jpeg_blob_t);
+
+    gCamDerivedInfo[cameraId] = info;
+    return NO_ERROR;
 }
 
 
@@ -3758,6 +4000,13 @@ int QCamera3HardwareInterface::getCamInfo(int cameraId,
         }
     }
 
+    if (NULL == gCamDerivedInfo[cameraId]) {
+        rc = initDerivedInfo(cameraId);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
     if (NULL == gStaticMetadata[cameraId]) {
         rc = initStaticMetadata(cameraId);
         if (rc < 0) {
@@ -37,6 +37,9 @@
 #include <camera/CameraMetadata.h>
 #include "QCamera3HALHeader.h"
 #include "QCamera3Channel.h"
+#include "QCameraFrameTiming.h"
+#include "QCameraLatencyStats.h"
+#include "QCameraJobPool.h"
 
 #include <hardware/power.h>
 
@@ -74,6 +77,14 @@ typedef int64_t nsecs_t;
 
 extern volatile uint32_t gCamHal3LogLevel;
 
+/* Lookup tables derived once per camera id from its capabilities */
+typedef struct {
+    int32_t max_jpeg_size;
+    cam_dimension_t max_jpeg_dim;
+    // picture area -> minimum processed/jpeg frame duration
+    KeyedVector<int32_t, int64_t> min_duration;
+} derived_info_t;
+
 class QCamera3MetadataChannel;
 class QCamera3PicChannel;
 class QCamera3HeapMemory;
@@ -109,6 +120,7 @@ public:
     static int getCamInfo(int cameraId, struct camera_info *info);
     static int initCapabilities(int cameraId);
     static int initStaticMetadata(int cameraId);
+    static int initDerivedInfo(int cameraId);
     static void makeTable(cam_dimension_t* dimTable, uint8_t size, uint8_t max_size,
                           int32_t* sizeTable);
     static void makeFPSTable(cam_fps_range_t* fpsTable, uint8_t size,
@@ -172,6 +184,15 @@ public:
     } QCameraPropMap;
 
 private:
+    /* Per stream frame drop book-keeping. Pending drops are kept as a
+     * bitmap of MAX_PENDING_DROPS frames starting at base_frame */
+    typedef struct {
+        uint32_t base_frame;
+        uint64_t pending;
+        uint32_t num_frames;
+        uint32_t num_dropped;
+    } FrameDropInfo;
+    enum { MAX_PENDING_DROPS = 64 };
 
     int openCamera();
     int closeCamera();
@@ -195,6 +216,11 @@ private:
     void handleBufferWithLock(camera3_stream_buffer_t *buffer,
         uint32_t frame_number);
     void unblockRequestIfNecessary();
+    static void stopChannelJob(void *data);
+    FrameDropInfo &getFrameDropInfo(uint32_t streamID);
+    void markFrameDropped(FrameDropInfo &dropInfo, uint32_t frame_number);
+    bool clearFrameDropped(uint32_t streamID, uint32_t frame_number);
+    bool hasPendingBuffers(uint32_t frame_number);
     void dumpMetadataToFile(tuning_params_t &meta,
                             uint32_t &dumpFrameCount,
                             int32_t enabled,
@@ -209,6 +235,8 @@ public:
     QCamera3Exif *getExifData();
 public:
     static int kMaxInFlight;
+    static const nsecs_t kFlushWarnTime;
+    static const uint32_t kFlushStopWorkers;
 private:
     camera3_device_t   mCameraDevice;
     uint8_t            mCameraId;
@@ -246,11 +274,8 @@ private:
         nsecs_t timestamp;
         uint8_t bNotified;
         int input_buffer_present;
+        nsecs_t request_time;
     } PendingRequestInfo;
-    typedef struct {
-        uint32_t frame_number;
-        uint32_t stream_ID;
-    } PendingFrameDropInfo;
     /*Data structure to store metadata information*/
     typedef struct {
        mm_camera_super_buf_t* meta_buf;
@@ -265,6 +290,8 @@ private:
         camera3_stream_t *stream;
         // Buffer handle
         buffer_handle_t *buffer;
+        // Submit time of the request, for the request latency
+        nsecs_t request_time;
     } PendingBufferInfo;
 
     typedef struct {
@@ -276,7 +303,8 @@ private:
 
     List<MetadataBufferInfo> mStoredMetadataList;
     List<PendingRequestInfo> mPendingRequestsList;
-    List<PendingFrameDropInfo> mPendingFrameDropList;
+    // Frame drop info keyed by server stream ID
+    KeyedVector<uint32_t, FrameDropInfo> mFrameDropMap;
     PendingBuffersMap mPendingBuffersMap;
     pthread_cond_t mRequestCond;
     int mPendingRequest;
@@ -293,6 +321,15 @@ private:
     int64_t mMinProcessedFrameDuration;
     int64_t mMinJpegFrameDuration;
     int64_t mMinRawFrameDuration;
+    // sensor frame timing, used to back-fill skipped shutter timestamps
+    QCameraFrameTiming mFrameTiming;
+
+    // request pipeline statistics reported by dump()
+    QCameraLatencyStats mRequestLatency;   // request to last buffer or metadata, usec
+    QCameraLatencyStats mInFlightStats;    // pending requests at submit time
+    QCameraLatencyStats mResultCbCpuTime;  // captureResultCb thread cpu, usec
+    QCameraLatencyStats mFlushLatency;     // flush duration, usec
+    QCameraJobPool mStopPool;              // flush channel stop workers
     bool mRawDump;
     power_module_t *m_pPowerModule;   // power module
 
@@ -30,6 +30,10 @@
 #ifndef __QCAMERA_SEMAPHORE_H__
 #define __QCAMERA_SEMAPHORE_H__
 
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -71,6 +75,29 @@ static inline int cam_sem_wait(cam_semaphore_t *s)
     return rc;
 }
 
+/* wait at most timeout_ns, returns ETIMEDOUT if the semaphore was not posted */
+static inline int cam_sem_timedwait(cam_semaphore_t *s, int64_t timeout_ns)
+{
+    int rc = 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += (time_t)(timeout_ns / 1000000000LL);
+    ts.tv_nsec += (long)(timeout_ns % 1000000000LL);
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&(s->mutex));
+    while (s->val == 0 && rc == 0)
+        rc = pthread_cond_timedwait(&(s->cond), &(s->mutex), &ts);
+    if (s->val > 0) {
+        s->val--;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&(s->mutex));
+    return rc;
+}
+
 static inline void cam_sem_destroy(cam_semaphore_t *s)
 {
     pthread_mutex_destroy(&(s->mutex));
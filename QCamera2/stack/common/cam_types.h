@@ -334,6 +334,24 @@ typedef struct {
     } payload;
 } cam_sock_packet_t;
 
+/* Bundled mapping msg, sent instead of one cam_sock_packet_t per buffer
+ * only when the server supports it (persist.camera.bundled.map). It is a
+ * packet of its own so cam_sock_packet_t and cam_mapping_type keep their
+ * layout; msg_type sits where cam_sock_packet_t has it. All fds travel in
+ * a single SCM_RIGHTS control msg and are acked by one MAP_UNMAP_DONE. */
+#define CAM_MAPPING_TYPE_FD_BUNDLED_MAPPING 0x100
+#define CAM_MAX_NUM_BUFS_PER_MSG 24
+
+typedef struct {
+    uint32_t length;      /* number of valid entries in buf_maps */
+    cam_buf_map_type buf_maps[CAM_MAX_NUM_BUFS_PER_MSG];
+} cam_buf_map_type_list;
+
+typedef struct {
+    uint32_t msg_type;    /* CAM_MAPPING_TYPE_FD_BUNDLED_MAPPING */
+    cam_buf_map_type_list payload;
+} cam_sock_bundled_packet_t;
+
 typedef enum {
     CAM_MODE_2D = (1<<0),
     CAM_MODE_3D = (1<<1)
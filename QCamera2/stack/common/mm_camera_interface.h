@@ -154,16 +154,28 @@ typedef int32_t (*unmap_stream_buf_op_t) (uint32_t frame_idx,
                                           int32_t plane_idx,
                                           void *userdata);
 
+/** map_stream_bufs_op_t: function definition for operation of
+*                        mapping a batch of stream buffers via
+*                        domain socket in one bundled message
+*    @buf_map_list : list of buffers to be mapped, at most
+*                    CAM_MAX_NUM_BUFS_PER_MSG entries
+*    @userdata : user data pointer
+**/
+typedef int32_t (*map_stream_bufs_op_t) (const cam_buf_map_type_list *buf_map_list,
+                                         void *userdata);
+
 /** mm_camera_map_unmap_ops_tbl_t: virtual table
 *                      for mapping/unmapping stream buffers via
 *                      domain socket
 *    @map_ops : operation for mapping
 *    @unmap_ops : operation for unmapping
+*    @bundled_map_ops : operation for mapping a batch of buffers
 *    @userdata: user data pointer
 **/
 typedef struct {
     map_stream_buf_op_t map_ops;
     unmap_stream_buf_op_t unmap_ops;
+    map_stream_bufs_op_t bundled_map_ops;
     void *userdata;
 } mm_camera_map_unmap_ops_tbl_t;
 
@@ -197,6 +209,9 @@ typedef struct {
 *              allocating/deallocating stream buffers
 *    @stream_cb : callback handling stream frame notify
 *    @userdata : user data pointer
+*    @direct_dispatch : if set, stream_cb is called directly from the
+*              data poll thread instead of the stream cmd thread, so it
+*              must not block
 **/
 typedef struct {
     cam_stream_info_t *stream_info;
@@ -204,6 +219,7 @@ typedef struct {
     mm_camera_stream_mem_vtbl_t mem_vtbl;
     mm_camera_buf_notify_t stream_cb;
     void *userdata;
+    uint8_t direct_dispatch;
 } mm_camera_stream_config_t;
 
 /** mm_camera_super_buf_notify_mode_t: enum for super uffer
@@ -267,6 +283,10 @@ typedef enum {
 *    @max_unmatched_frames : max number of unmatched frames in
 *                     queue
 *    @priority : save matched priority frames only
+*    @best_frame_window : for a single frame request, deliver the
+*                     best of this many queued frames as scored
+*                     from their metadata. 0 delivers the oldest
+*                     look back frame. Only valid for burst mode
 **/
 typedef struct {
     mm_camera_super_buf_notify_mode_t notify_mode;
@@ -275,6 +295,7 @@ typedef struct {
     uint8_t post_frame_skip;
     uint8_t max_unmatched_frames;
     mm_camera_super_buf_priority_t priority;
+    uint8_t best_frame_window;
 } mm_camera_channel_attr_t;
 
 typedef struct {
@@ -91,6 +91,23 @@ typedef void (*jpeg_encode_callback_t)(jpeg_job_status_t status,
   mm_jpeg_output_t *p_output,
   void *userData);
 
+/* partial output of a streaming encode: p_chunk holds the bytes
+ * of the jpeg file starting at offset. Chunks arrive in order and
+ * all of them are delivered before jpeg_cb reports the job done */
+typedef void (*jpeg_encode_chunk_callback_t)(uint32_t client_hdl,
+  uint32_t jobId,
+  mm_jpeg_output_t *p_chunk,
+  uint32_t offset,
+  void *userData);
+
+/* progress of a decode: the first rows of the image in p_output are
+ * final and can be consumed before jpeg_cb reports the job done */
+typedef void (*jpeg_decode_slice_callback_t)(uint32_t client_hdl,
+  uint32_t jobId,
+  mm_jpeg_output_t *p_output,
+  uint32_t rows,
+  void *userData);
+
 typedef struct {
   /* src img dimension */
   cam_dimension_t src_dim;
@@ -120,7 +137,9 @@ typedef struct {
   /* this will be used only for bitstream */
   mm_jpeg_buf_t src_thumb_buf[MM_JPEG_MAX_BUF];
 
-  /* this will be used only for bitstream */
+  /* this will be used only for bitstream. With buf_vaddr of the
+   * first one NULL and no get_memory the output is allocated to
+   * size, see release_out_buf */
   mm_jpeg_buf_t dest_buf[MM_JPEG_MAX_BUF];
 
   /* mainimage color format */
@@ -142,6 +161,10 @@ typedef struct {
   /*Callback registered to be called after encode*/
   jpeg_encode_callback_t jpeg_cb;
 
+  /*Optional callback for streaming the output while encoding,
+   * not supported together with get_memory*/
+  jpeg_encode_chunk_callback_t jpeg_chunk_cb;
+
   /*Appdata passed by the user*/
   void* userdata;
 
@@ -162,6 +185,12 @@ typedef struct {
 
   /* get memory function ptr */
   int (*get_memory)( omx_jpeg_ouput_buf_t *p_out_buf);
+
+  /* client generation of the src/thumb/dst buffers. A destroyed session
+   * is kept warm only if it is non-zero and reused only by a session with
+   * the same generation. Must change whenever any of the buffers is freed,
+   * since fds and addresses get reused by new buffers */
+  uint32_t buf_generation;
 } mm_jpeg_encode_params_t;
 
 typedef struct {
@@ -183,6 +212,11 @@ typedef struct {
   jpeg_encode_callback_t jpeg_cb;
   void* userdata;
 
+  /* optional, called every time at least slice_height more rows are
+   * decoded. Needs a decoder that supports the decode pipeline */
+  jpeg_decode_slice_callback_t jpeg_slice_cb;
+  uint32_t slice_height;
+
 } mm_jpeg_decode_params_t;
 
 typedef struct {
@@ -217,6 +251,9 @@ typedef struct {
   /* jpeg encoder QTable */
   uint8_t qtable_set[QTABLE_MAX];
   OMX_IMAGE_PARAM_QUANTIZATIONTABLETYPE qtable[QTABLE_MAX];
+
+  /* run ahead of the jobs already queued */
+  uint8_t high_priority;
 } mm_jpeg_encode_job_t;
 
 typedef struct {
@@ -268,6 +305,31 @@ typedef struct {
   /* destroy session */
   int (*destroy_session)(uint32_t session_id);
 
+  /* create a session ahead of capture and keep it warm, so that a
+   * later create_session with the same params is served from cache */
+  int (*prewarm_session)(uint32_t client_hdl,
+    mm_jpeg_encode_params_t *p_params);
+
+  /* release the sessions kept warm for a client, to be called when the
+   * buffers they are bound to are freed */
+  int (*flush_session_cache)(uint32_t client_hdl);
+
+  /* add a separately encoded thumbnail to the exif of a jpeg
+   * encoded without one. With p_out NULL only the output length
+   * is returned, with p_jpeg NULL the growth, which only depends
+   * on the thumbnail. p_out may be that much ahead of p_jpeg in
+   * the same buffer to add the thumbnail in place -- sync call */
+  int (*insert_thumbnail)(uint8_t *p_jpeg, uint32_t jpeg_len,
+    uint8_t *p_thumb, uint32_t thumb_len,
+    uint8_t *p_out, uint32_t out_size, uint32_t *p_out_len);
+
+  /* give back the output of a session created with a NULL
+   * dest_buf[0].buf_vaddr. Such sessions get their output buffer
+   * from an internal pool sized to the encoded image, and the
+   * buffer passed in the jpeg callback stays valid until released
+   * -- sync call */
+  int (*release_out_buf)(uint8_t *p_buf);
+
   /* close a jpeg client -- sync call */
   int (*close) (uint32_t clientHdl);
 } mm_jpeg_ops_t;
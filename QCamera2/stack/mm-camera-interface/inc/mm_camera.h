@@ -245,6 +245,7 @@ typedef struct mm_stream {
     struct mm_channel* ch_obj;
 
     uint8_t is_bundled; /* flag if stream is bundled */
+    uint8_t direct_dispatch; /* flag if dataCB is dispatched from poll thread */
 
     mm_camera_stream_mem_vtbl_t mem_vtbl; /* mem ops tbl */
 
@@ -469,6 +470,12 @@ extern int32_t mm_camera_util_sendmsg(mm_camera_obj_t *my_obj,
                                       void *msg,
                                       uint32_t buf_size,
                                       int sendfd);
+/* send one msg carrying multiple fds throught domain socket for fd mapping */
+extern int32_t mm_camera_util_bundled_sendmsg(mm_camera_obj_t *my_obj,
+                                              void *msg,
+                                              uint32_t buf_size,
+                                              int sendfds[CAM_MAX_NUM_BUFS_PER_MSG],
+                                              int numfds);
 /* Check if hardware target is A family */
 uint8_t mm_camera_util_chip_is_a_family(void);
 
@@ -599,6 +606,8 @@ extern int32_t mm_stream_map_buf(mm_stream_t *my_obj,
                                  int32_t plane_idx,
                                  int fd,
                                  uint32_t size);
+extern int32_t mm_stream_map_bufs(mm_stream_t *my_obj,
+                                  const cam_buf_map_type_list *buf_map_list);
 extern int32_t mm_stream_unmap_buf(mm_stream_t *my_obj,
                                    uint8_t buf_type,
                                    uint32_t frame_idx,
@@ -31,6 +31,7 @@
 #define __MM_CAMERA_SOCKET_H__
 
 #include <inttypes.h>
+#include "cam_types.h"
 
 typedef enum {
     MM_CAMERA_SOCK_TYPE_UDP,
@@ -45,6 +46,13 @@ int mm_camera_socket_sendmsg(
   uint32_t buf_size,
   int sendfd);
 
+int mm_camera_socket_bundle_sendmsg(
+  int fd,
+  void *msg,
+  uint32_t buf_size,
+  int sendfds[CAM_MAX_NUM_BUFS_PER_MSG],
+  int numfds);
+
 int mm_camera_socket_recvmsg(
   int fd,
   void *msg,
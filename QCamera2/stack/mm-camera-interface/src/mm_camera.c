@@ -1601,6 +1601,47 @@ int32_t mm_camera_util_sendmsg(mm_camera_obj_t *my_obj,
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : mm_camera_util_bundled_sendmsg
+ *
+ * DESCRIPTION: utility function to send a bundled msg carrying multiple fds
+ *              via domain socket. Server acks the whole bundle with a single
+ *              MAP_UNMAP_DONE event, so one round trip covers all buffers.
+ *
+ * PARAMETERS :
+ *   @my_obj       : camera object
+ *   @msg          : message to be sent
+ *   @buf_size     : size of the message to be sent
+ *   @sendfds      : array of file descriptors to be sent
+ *   @numfds       : number of file descriptors in sendfds
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+int32_t mm_camera_util_bundled_sendmsg(mm_camera_obj_t *my_obj,
+                                       void *msg,
+                                       uint32_t buf_size,
+                                       int sendfds[CAM_MAX_NUM_BUFS_PER_MSG],
+                                       int numfds)
+{
+    int32_t rc = -1;
+    int32_t status;
+
+    /* need to lock msg_lock, since sendmsg until reposonse back is deemed as one operation*/
+    pthread_mutex_lock(&my_obj->msg_lock);
+    if(mm_camera_socket_bundle_sendmsg(my_obj->ds_fd, msg, buf_size,
+            sendfds, numfds) > 0) {
+        /* wait for event that mapping of the whole bundle is done */
+        mm_camera_util_wait_for_event(my_obj, CAM_EVENT_TYPE_MAP_UNMAP_DONE, &status);
+        if (MSM_CAMERA_STATUS_SUCCESS == status) {
+            rc = 0;
+        }
+    }
+    pthread_mutex_unlock(&my_obj->msg_lock);
+    return rc;
+}
+
 /*===========================================================================
  * FUNCTION   : mm_camera_map_buf
  *
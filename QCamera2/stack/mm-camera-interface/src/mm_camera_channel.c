@@ -112,6 +112,8 @@ int32_t mm_channel_superbuf_bufdone_overflow(mm_channel_t *my_obj,
                                              mm_channel_queue_t *queue);
 int32_t mm_channel_superbuf_skip(mm_channel_t *my_obj,
                                  mm_channel_queue_t *queue);
+int32_t mm_channel_superbuf_select_best(mm_channel_t *my_obj,
+                                        mm_channel_queue_t *queue);
 
 static int32_t mm_channel_proc_general_cmd(mm_channel_t *my_obj,
                                            mm_camera_generic_cmd_t *p_gen_cmd);
@@ -229,6 +231,17 @@ static void mm_channel_process_stream_buf(mm_camera_cmdcb_t * cmd_cb,
 
         mm_channel_superbuf_skip(ch_obj, &ch_obj->bundle.superbuf_queue);
 
+        /* a plain single shot can take any queued frame, pick the best one */
+        if ((1 == ch_obj->pending_cnt) &&
+            (0 == ch_obj->pending_retro_cnt) &&
+            !ch_obj->needLEDFlash &&
+            !ch_obj->need3ABracketing &&
+            !ch_obj->isFlashBracketingEnabled &&
+            !ch_obj->isZoom1xFrameRequested) {
+            mm_channel_superbuf_select_best(ch_obj,
+                &ch_obj->bundle.superbuf_queue);
+        }
+
     } else if (MM_CAMERA_CMD_TYPE_START_ZSL == cmd_cb->cmd_type) {
             ch_obj->manualZSLSnapshot = TRUE;
             mm_camera_start_zsl_snapshot(ch_obj->cam_obj);
@@ -2334,6 +2347,224 @@ int32_t mm_channel_superbuf_skip(mm_channel_t* my_obj,
     return rc;
 }
 
+/*===========================================================================
+ * FUNCTION   : mm_channel_metadata_score
+ *
+ * DESCRIPTION: rate how likely a frame is sharp from the 3A state in its
+ *              metadata. Focus and a still lens weigh most, then settled
+ *              exposure. Long exposure times lose a little for the risk
+ *              of motion blur.
+ *
+ * PARAMETERS :
+ *   @metadata  : metadata of the frame
+ *   @sharpness : [out] mean of the sharpness map, 0 if not reported.
+ *                Used to break ties
+ *
+ * RETURN     : score, higher is better
+ *==========================================================================*/
+int32_t mm_channel_metadata_score(const metadata_buffer_t *metadata,
+                                  int32_t *sharpness)
+{
+    int32_t score = 0;
+    int32_t i, j;
+
+    *sharpness = 0;
+
+    if (IS_META_AVAILABLE(CAM_INTF_META_AF_STATE, metadata)) {
+        uint32_t af_state = *((uint32_t *)
+            POINTER_OF_META(CAM_INTF_META_AF_STATE, metadata));
+        switch (af_state) {
+        case CAM_AF_STATE_PASSIVE_FOCUSED:
+        case CAM_AF_STATE_FOCUSED_LOCKED:
+            score += 400;
+            break;
+        case CAM_AF_STATE_INACTIVE:
+            score += 200;
+            break;
+        case CAM_AF_STATE_NOT_FOCUSED_LOCKED:
+        case CAM_AF_STATE_PASSIVE_UNFOCUSED:
+            score += 100;
+            break;
+        default:
+            /* scanning */
+            break;
+        }
+    }
+
+    if (IS_META_AVAILABLE(CAM_INTF_META_LENS_STATE, metadata)) {
+        cam_af_lens_state_t lens_state = *((cam_af_lens_state_t *)
+            POINTER_OF_META(CAM_INTF_META_LENS_STATE, metadata));
+        if (CAM_AF_LENS_STATE_STATIONARY == lens_state) {
+            score += 200;
+        }
+    }
+
+    if (IS_META_AVAILABLE(CAM_INTF_META_AEC_STATE, metadata)) {
+        uint32_t aec_state = *((uint32_t *)
+            POINTER_OF_META(CAM_INTF_META_AEC_STATE, metadata));
+        if (CAM_AE_STATE_CONVERGED == aec_state ||
+            CAM_AE_STATE_LOCKED == aec_state) {
+            score += 200;
+        }
+    } else if (IS_META_AVAILABLE(CAM_INTF_META_AEC_INFO, metadata)) {
+        cam_3a_params_t *aec_info = (cam_3a_params_t *)
+            POINTER_OF_META(CAM_INTF_META_AEC_INFO, metadata);
+        if (aec_info->settled) {
+            score += 200;
+        }
+    }
+
+    if (IS_META_AVAILABLE(CAM_INTF_META_AEC_INFO, metadata)) {
+        cam_3a_params_t *aec_info = (cam_3a_params_t *)
+            POINTER_OF_META(CAM_INTF_META_AEC_INFO, metadata);
+        int32_t exp_ms = (int32_t)(aec_info->exp_time * 1000);
+        if (exp_ms > 99) {
+            exp_ms = 99;
+        } else if (exp_ms < 0) {
+            exp_ms = 0;
+        }
+        score -= exp_ms;
+    }
+
+    if (IS_META_AVAILABLE(CAM_INTF_META_STATS_SHARPNESS_MAP, metadata)) {
+        cam_sharpness_map_t *map = (cam_sharpness_map_t *)
+            POINTER_OF_META(CAM_INTF_META_STATS_SHARPNESS_MAP, metadata);
+        int64_t sum = 0;
+        for (i = 0; i < CAM_MAX_MAP_WIDTH; i++) {
+            for (j = 0; j < CAM_MAX_MAP_HEIGHT; j++) {
+                sum += map->sharpness[i][j];
+            }
+        }
+        *sharpness = (int32_t)(sum / (CAM_MAX_MAP_WIDTH * CAM_MAX_MAP_HEIGHT));
+    }
+
+    return score;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_channel_superbuf_score
+ *
+ * DESCRIPTION: score a matched superbuf from its metadata buffer
+ *
+ * PARAMETERS :
+ *   @my_obj    : channel object
+ *   @super_buf : matched superbuf
+ *   @sharpness : [out] mean sharpness, 0 if not reported
+ *
+ * RETURN     : score, higher is better. 0 if there is no metadata
+ *==========================================================================*/
+int32_t mm_channel_superbuf_score(mm_channel_t *my_obj,
+                                  mm_channel_queue_node_t *super_buf,
+                                  int32_t *sharpness)
+{
+    uint32_t i;
+    mm_stream_t *stream_obj = NULL;
+
+    *sharpness = 0;
+    for (i = 0; i < super_buf->num_of_bufs; i++) {
+        if (NULL == super_buf->super_buf[i].buf) {
+            continue;
+        }
+        stream_obj = mm_channel_util_get_stream_by_handler(my_obj,
+            super_buf->super_buf[i].stream_id);
+        if (NULL != stream_obj && NULL != stream_obj->stream_info &&
+            CAM_STREAM_TYPE_METADATA == stream_obj->stream_info->stream_type &&
+            NULL != super_buf->super_buf[i].buf->buffer) {
+            return mm_channel_metadata_score((const metadata_buffer_t *)
+                super_buf->super_buf[i].buf->buffer, sharpness);
+        }
+    }
+
+    return 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : mm_channel_superbuf_select_best
+ *
+ * DESCRIPTION: score the oldest best_frame_window matched superbufs and
+ *              release the ones queued before the best, so that it is the
+ *              next one dispatched. Nothing waits for new frames.
+ *
+ * PARAMETERS :
+ *   @my_obj  : channel object
+ *   @queue   : superbuf queue
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+int32_t mm_channel_superbuf_select_best(mm_channel_t* my_obj,
+                                        mm_channel_queue_t * queue)
+{
+    cam_node_t* node = NULL;
+    struct cam_list *head = NULL;
+    struct cam_list *pos = NULL;
+    struct cam_list *best_pos = NULL;
+    mm_channel_queue_node_t* super_buf = NULL;
+    int32_t score, sharpness, best_score = 0, best_sharpness = 0;
+    uint32_t cnt = 0, best_frame_idx = 0, first_frame_idx = 0;
+    uint8_t i;
+
+    if (MM_CAMERA_SUPER_BUF_NOTIFY_BURST != queue->attr.notify_mode ||
+        queue->attr.best_frame_window <= 1) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&queue->que.lock);
+    head = &queue->que.head.list;
+    pos = head->next;
+    while (pos != head && cnt < queue->attr.best_frame_window) {
+        node = member_of(pos, cam_node_t, list);
+        super_buf = (mm_channel_queue_node_t*)node->data;
+        if (NULL != super_buf && super_buf->matched) {
+            score = mm_channel_superbuf_score(my_obj, super_buf, &sharpness);
+            CDBG("%s: [ZSL Best] frame %d score %d sharpness %d",
+                 __func__, super_buf->frame_idx, score, sharpness);
+            /* ties keep the older frame, closest to the shutter press */
+            if (NULL == best_pos || score > best_score ||
+                (score == best_score && sharpness > best_sharpness)) {
+                best_pos = pos;
+                best_score = score;
+                best_sharpness = sharpness;
+                best_frame_idx = super_buf->frame_idx;
+            }
+            if (0 == cnt) {
+                first_frame_idx = super_buf->frame_idx;
+            }
+            cnt++;
+        }
+        pos = pos->next;
+    }
+
+    if (NULL != best_pos) {
+        /* release the matched superbufs ahead of the best one */
+        pos = head->next;
+        while (pos != best_pos) {
+            node = member_of(pos, cam_node_t, list);
+            super_buf = (mm_channel_queue_node_t*)node->data;
+            pos = pos->next;
+            if (NULL == super_buf || !super_buf->matched) {
+                continue;
+            }
+            for (i = 0; i < super_buf->num_of_bufs; i++) {
+                if (NULL != super_buf->super_buf[i].buf) {
+                    mm_channel_qbuf(my_obj, super_buf->super_buf[i].buf);
+                }
+            }
+            cam_list_del_node(&node->list);
+            queue->que.size--;
+            queue->match_cnt--;
+            free(node);
+            free(super_buf);
+        }
+        CDBG_HIGH("%s: [ZSL Best] picked frame %d score %d, %d frames from %d",
+                  __func__, best_frame_idx, best_score, cnt, first_frame_idx);
+    }
+    pthread_mutex_unlock(&queue->que.lock);
+
+    return 0;
+}
+
 /*===========================================================================
  * FUNCTION   : mm_channel_superbuf_flush
  *
@@ -161,6 +161,68 @@ int mm_camera_socket_sendmsg(
     return sendmsg(fd, &(msgh), 0);
 }
 
+/*===========================================================================
+ * FUNCTION   : mm_camera_socket_bundle_sendmsg
+ *
+ * DESCRIPTION:  send msg carrying multiple fds through domain socket. All fds
+ *               are packed into one SCM_RIGHTS control msg so the server can
+ *               map a whole set of buffers from a single datagram.
+ *   @fd      : socket fd
+ *   @msg     : pointer to msg to be sent over domain socket
+ *   @buf_size: size of the msg to be sent
+ *   @sendfds : array of file descriptors to be sent
+ *   @numfds  : number of file descriptors in sendfds
+ *
+ * RETURN     : the total bytes of sent msg
+ *==========================================================================*/
+int mm_camera_socket_bundle_sendmsg(
+  int fd,
+  void *msg,
+  uint32_t buf_size,
+  int sendfds[CAM_MAX_NUM_BUFS_PER_MSG],
+  int numfds)
+{
+    struct msghdr msgh;
+    struct iovec iov[1];
+    struct cmsghdr * cmsghp = NULL;
+    char control[CMSG_SPACE(sizeof(int) * CAM_MAX_NUM_BUFS_PER_MSG)];
+    int *fds_ptr = NULL;
+
+    if (msg == NULL) {
+      CDBG("%s: msg is NULL", __func__);
+      return -1;
+    }
+    if ((numfds <= 0) || (numfds > CAM_MAX_NUM_BUFS_PER_MSG)) {
+      CDBG_ERROR("%s: invalid number of fds %d", __func__, numfds);
+      return -1;
+    }
+    memset(&msgh, 0, sizeof(msgh));
+    msgh.msg_name = NULL;
+    msgh.msg_namelen = 0;
+
+    iov[0].iov_base = msg;
+    iov[0].iov_len = buf_size;
+    msgh.msg_iov = iov;
+    msgh.msg_iovlen = 1;
+    CDBG("%s: iov_len=%d, numfds=%d", __func__, iov[0].iov_len, numfds);
+
+    msgh.msg_control = control;
+    msgh.msg_controllen = CMSG_SPACE(sizeof(int) * numfds);
+    cmsghp = CMSG_FIRSTHDR(&msgh);
+    if (cmsghp != NULL) {
+      cmsghp->cmsg_level = SOL_SOCKET;
+      cmsghp->cmsg_type = SCM_RIGHTS;
+      cmsghp->cmsg_len = CMSG_LEN(sizeof(int) * numfds);
+      fds_ptr = (int *)CMSG_DATA(cmsghp);
+      memcpy(fds_ptr, sendfds, sizeof(int) * numfds);
+    } else {
+      CDBG("%s: ctrl msg NULL", __func__);
+      return -1;
+    }
+
+    return sendmsg(fd, &(msgh), 0);
+}
+
 /*===========================================================================
  * FUNCTION   : mm_camera_socket_recvmsg
  *
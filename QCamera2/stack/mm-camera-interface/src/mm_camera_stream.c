@@ -69,6 +69,8 @@ int32_t mm_stream_read_msm_frame(mm_stream_t * my_obj,
 int32_t mm_stream_config(mm_stream_t *my_obj,
                          mm_camera_stream_config_t *config);
 int32_t mm_stream_reg_buf(mm_stream_t * my_obj);
+static void mm_stream_dispatch_buf(mm_stream_t *my_obj,
+                                   mm_camera_buf_info_t *buf_info);
 int32_t mm_stream_buf_done(mm_stream_t * my_obj,
                            mm_camera_buf_def_t *frame);
 int32_t mm_stream_calc_offset(mm_stream_t *my_obj);
@@ -164,7 +166,11 @@ void mm_stream_handle_rcvd_buf(mm_stream_t *my_obj,
         }
     }
 
-    if(has_cb) {
+    if(has_cb && my_obj->direct_dispatch) {
+        /* dispatch dataCB right here in the poll thread, saving the
+         * handoff to the stream cmd thread */
+        mm_stream_dispatch_buf(my_obj, buf_info);
+    } else if(has_cb) {
         mm_camera_cmdcb_t* node = NULL;
 
         /* send cam_sem_post to wake up cmd thread to dispatch dataCB */
@@ -249,38 +255,23 @@ static void mm_stream_data_notify(void* user_data)
 }
 
 /*===========================================================================
- * FUNCTION   : mm_stream_dispatch_app_data
+ * FUNCTION   : mm_stream_dispatch_buf
  *
- * DESCRIPTION: dispatch stream buffer to registered users
+ * DESCRIPTION: dispatch stream buffer to registered users. Caller has
+ *              already increased buf ref count by one for dispatching.
  *
  * PARAMETERS :
- *   @cmd_cb  : ptr storing stream buffer information
- *   @userdata: user data ptr (stream object)
+ *   @my_obj  : stream object
+ *   @buf_info: ptr to struct storing buffer information
  *
  * RETURN     : none
  *==========================================================================*/
-static void mm_stream_dispatch_app_data(mm_camera_cmdcb_t *cmd_cb,
-                                        void* user_data)
+static void mm_stream_dispatch_buf(mm_stream_t *my_obj,
+                                   mm_camera_buf_info_t *buf_info)
 {
     int i;
-    mm_stream_t * my_obj = (mm_stream_t *)user_data;
-    mm_camera_buf_info_t* buf_info = NULL;
     mm_camera_super_buf_t super_buf;
-    mm_camera_cmd_thread_name("mm_cam_stream");
-
-    if (NULL == my_obj) {
-        return;
-    }
-    CDBG("%s: E, my_handle = 0x%x, fd = %d, state = %d",
-         __func__, my_obj->my_hdl, my_obj->fd, my_obj->state);
 
-    if (MM_CAMERA_CMD_TYPE_DATA_CB != cmd_cb->cmd_type) {
-        CDBG_ERROR("%s: Wrong cmd_type (%d) for dataCB",
-                   __func__, cmd_cb->cmd_type);
-        return;
-    }
-
-    buf_info = &cmd_cb->u.buf;
     memset(&super_buf, 0, sizeof(mm_camera_super_buf_t));
     super_buf.num_bufs = 1;
     super_buf.bufs[0] = buf_info->buf;
@@ -322,6 +313,39 @@ static void mm_stream_dispatch_app_data(mm_camera_cmdcb_t *cmd_cb,
     mm_stream_buf_done(my_obj, buf_info->buf);
 }
 
+/*===========================================================================
+ * FUNCTION   : mm_stream_dispatch_app_data
+ *
+ * DESCRIPTION: dispatch stream buffer to registered users from the stream
+ *              cmd thread
+ *
+ * PARAMETERS :
+ *   @cmd_cb  : ptr storing stream buffer information
+ *   @userdata: user data ptr (stream object)
+ *
+ * RETURN     : none
+ *==========================================================================*/
+static void mm_stream_dispatch_app_data(mm_camera_cmdcb_t *cmd_cb,
+                                        void* user_data)
+{
+    mm_stream_t * my_obj = (mm_stream_t *)user_data;
+    mm_camera_cmd_thread_name("mm_cam_stream");
+
+    if (NULL == my_obj) {
+        return;
+    }
+    CDBG("%s: E, my_handle = 0x%x, fd = %d, state = %d",
+         __func__, my_obj->my_hdl, my_obj->fd, my_obj->state);
+
+    if (MM_CAMERA_CMD_TYPE_DATA_CB != cmd_cb->cmd_type) {
+        CDBG_ERROR("%s: Wrong cmd_type (%d) for dataCB",
+                   __func__, cmd_cb->cmd_type);
+        return;
+    }
+
+    mm_stream_dispatch_buf(my_obj, &cmd_cb->u.buf);
+}
+
 /*===========================================================================
  * FUNCTION   : mm_stream_fsm_fn
  *
@@ -691,7 +715,9 @@ int32_t mm_stream_fsm_reg(mm_stream_t * my_obj,
             }
             pthread_mutex_unlock(&my_obj->cb_lock);
 
-            if (has_cb) {
+            /* no cmd thread needed if buffers are dispatched directly
+             * from the poll thread */
+            if (has_cb && !my_obj->direct_dispatch) {
                 snprintf(my_obj->cmd_thread.threadName, THREAD_NAME_SIZE, "CAM_StrmAppData");
                 mm_camera_cmd_thread_launch(&my_obj->cmd_thread,
                                             mm_stream_dispatch_app_data,
@@ -702,7 +728,7 @@ int32_t mm_stream_fsm_reg(mm_stream_t * my_obj,
             rc = mm_stream_streamon(my_obj);
             if (0 != rc) {
                 /* failed stream on, need to release cmd thread if it's launched */
-                if (has_cb) {
+                if (has_cb && !my_obj->direct_dispatch) {
                     mm_camera_cmd_thread_release(&my_obj->cmd_thread);
                 }
                 my_obj->state = MM_STREAM_STATE_REG;
@@ -775,7 +801,7 @@ int32_t mm_stream_fsm_active(mm_stream_t * my_obj,
             }
             pthread_mutex_unlock(&my_obj->cb_lock);
 
-            if (has_cb) {
+            if (has_cb && !my_obj->direct_dispatch) {
                 mm_camera_cmd_thread_release(&my_obj->cmd_thread);
             }
             my_obj->state = MM_STREAM_STATE_REG;
@@ -833,6 +859,7 @@ int32_t mm_stream_config(mm_stream_t *my_obj,
     my_obj->buf_cb[0].cb = config->stream_cb;
     my_obj->buf_cb[0].user_data = config->userdata;
     my_obj->buf_cb[0].cb_count = -1; /* infinite by default */
+    my_obj->direct_dispatch = config->direct_dispatch;
 
     rc = mm_stream_sync_info(my_obj);
     if (rc == 0) {
@@ -1325,6 +1352,52 @@ int32_t mm_stream_map_buf(mm_stream_t * my_obj,
                                   fd);
 }
 
+/*===========================================================================
+ * FUNCTION   : mm_stream_map_bufs
+ *
+ * DESCRIPTION: mapping a batch of stream buffers via domain socket to server.
+ *              All fds are sent in one message and acked once by server.
+ *
+ * PARAMETERS :
+ *   @my_obj       : stream object
+ *   @buf_map_list : list of buffers to be mapped, at most
+ *                   CAM_MAX_NUM_BUFS_PER_MSG entries
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+int32_t mm_stream_map_bufs(mm_stream_t * my_obj,
+                           const cam_buf_map_type_list *buf_map_list)
+{
+    uint32_t i;
+    int sendfds[CAM_MAX_NUM_BUFS_PER_MSG];
+    cam_sock_bundled_packet_t packet;
+
+    if (NULL == my_obj || NULL == my_obj->ch_obj || NULL == my_obj->ch_obj->cam_obj) {
+        CDBG_ERROR("%s: NULL obj of stream/channel/camera", __func__);
+        return -1;
+    }
+    if (NULL == buf_map_list || 0 == buf_map_list->length ||
+            buf_map_list->length > CAM_MAX_NUM_BUFS_PER_MSG) {
+        CDBG_ERROR("%s: Invalid buffer list", __func__);
+        return -1;
+    }
+
+    memset(&packet, 0, sizeof(cam_sock_bundled_packet_t));
+    packet.msg_type = CAM_MAPPING_TYPE_FD_BUNDLED_MAPPING;
+    packet.payload = *buf_map_list;
+    for (i = 0; i < buf_map_list->length; i++) {
+        packet.payload.buf_maps[i].stream_id = my_obj->server_stream_id;
+        sendfds[i] = buf_map_list->buf_maps[i].fd;
+    }
+    return mm_camera_util_bundled_sendmsg(my_obj->ch_obj->cam_obj,
+                                          &packet,
+                                          sizeof(cam_sock_bundled_packet_t),
+                                          sendfds,
+                                          buf_map_list->length);
+}
+
 /*===========================================================================
  * FUNCTION   : mm_stream_unmap_buf
  *
@@ -1405,6 +1478,28 @@ static int32_t mm_stream_map_buf_ops(uint32_t frame_idx,
                              frame_idx, plane_idx, fd, size);
 }
 
+/*===========================================================================
+ * FUNCTION   : mm_stream_map_bufs_ops
+ *
+ * DESCRIPTION: ops for mapping a batch of stream buffers via domain socket to
+ *              server in one bundled message. This function will be passed to
+ *              upper layer as part of ops table.
+ *
+ * PARAMETERS :
+ *   @buf_map_list : list of buffers to be mapped
+ *   @userdata     : user data ptr (stream object)
+ *
+ * RETURN     : int32_t type of status
+ *              0  -- success
+ *              -1 -- failure
+ *==========================================================================*/
+static int32_t mm_stream_map_bufs_ops(const cam_buf_map_type_list *buf_map_list,
+                                      void *userdata)
+{
+    mm_stream_t *my_obj = (mm_stream_t *)userdata;
+    return mm_stream_map_bufs(my_obj, buf_map_list);
+}
+
 /*===========================================================================
  * FUNCTION   : mm_stream_unmap_buf_ops
  *
@@ -1465,6 +1560,7 @@ int32_t mm_stream_init_bufs(mm_stream_t * my_obj)
 
     my_obj->map_ops.map_ops = mm_stream_map_buf_ops;
     my_obj->map_ops.unmap_ops = mm_stream_unmap_buf_ops;
+    my_obj->map_ops.bundled_map_ops = mm_stream_map_bufs_ops;
     my_obj->map_ops.userdata = my_obj;
 
     rc = my_obj->mem_vtbl.get_bufs(&my_obj->frame_offset,
@@ -1533,6 +1629,7 @@ int32_t mm_stream_deinit_bufs(mm_stream_t * my_obj)
     /* release bufs */
     ops_tbl.map_ops = mm_stream_map_buf_ops;
     ops_tbl.unmap_ops = mm_stream_unmap_buf_ops;
+    ops_tbl.bundled_map_ops = mm_stream_map_bufs_ops;
     ops_tbl.userdata = my_obj;
 
     rc = my_obj->mem_vtbl.put_bufs(&ops_tbl,
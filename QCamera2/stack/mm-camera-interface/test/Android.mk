@@ -0,0 +1,29 @@
+#best frame selection test
+OLD_LOCAL_PATH := $(LOCAL_PATH)
+MM_CAMERA_TEST_PATH := $(call my-dir)
+
+include $(LOCAL_PATH)/../../common.mk
+include $(CLEAR_VARS)
+LOCAL_PATH := $(MM_CAMERA_TEST_PATH)
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_CFLAGS := -Wall -Werror -Wno-unused-parameter
+LOCAL_CFLAGS += -D_ANDROID_
+
+LOCAL_C_INCLUDES := $(MM_CAMERA_TEST_PATH)/../inc
+LOCAL_C_INCLUDES += $(MM_CAMERA_TEST_PATH)/../../common
+
+LOCAL_C_INCLUDES+= $(kernel_includes)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
+
+# the stream and thread functions are stubbed by the test itself
+LOCAL_SRC_FILES := mm_camera_best_frame_test.c \
+    ../src/mm_camera_channel.c
+
+LOCAL_MODULE           := mm-camera-best-frame-test
+LOCAL_PRELINK_MODULE   := false
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+
+include $(BUILD_EXECUTABLE)
+
+LOCAL_PATH := $(OLD_LOCAL_PATH)
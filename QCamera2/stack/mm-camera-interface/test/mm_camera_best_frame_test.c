@@ -0,0 +1,511 @@
+/* Copyright (c) 2012-2014, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* ZSL best frame selection test with synthetic metadata. The channel
+ * source is built into the test; the stream state machine and the
+ * thread helpers it calls are stubbed here, and the stubbed QBUF records
+ * which buffers went back to the kernel. It checks the 3A based frame
+ * score, that the best of the window is moved to the head of the queue
+ * with the frames ahead of it released, and that ties keep the older
+ * frame. Exits with 1 if a check failed. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <poll.h>
+#include "mm_camera_dbg.h"
+#include "mm_camera_interface.h"
+#include "mm_camera.h"
+
+#define TEST_PREVIEW_HDL   0x101
+#define TEST_META_HDL      0x102
+#define TEST_MAX_FRAMES    8
+
+extern int32_t mm_channel_metadata_score(const metadata_buffer_t *metadata,
+                                         int32_t *sharpness);
+extern int32_t mm_channel_superbuf_select_best(mm_channel_t *my_obj,
+                                               mm_channel_queue_t *queue);
+
+typedef struct {
+    mm_camera_buf_def_t *bufs[2 * TEST_MAX_FRAMES];
+    int num_bufs;
+} test_qbuf_log_t;
+
+static test_qbuf_log_t g_qbuf;
+static int g_failures;
+
+#define TEST_CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("FAIL %s:%d: ", __func__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        g_failures++; \
+    } \
+} while (0)
+
+/* stubs of the stream and thread functions used by mm_camera_channel.c */
+int32_t mm_stream_fsm_fn(mm_stream_t *my_obj,
+                         mm_stream_evt_type_t evt,
+                         void *in_val,
+                         void *out_val)
+{
+    if (MM_STREAM_EVT_QBUF == evt && g_qbuf.num_bufs < 2 * TEST_MAX_FRAMES) {
+        g_qbuf.bufs[g_qbuf.num_bufs++] = (mm_camera_buf_def_t *)in_val;
+        return 0;
+    }
+    return -1;
+}
+
+int32_t mm_stream_map_buf(mm_stream_t *my_obj, uint8_t buf_type,
+                          uint32_t frame_idx, int32_t plane_idx,
+                          int fd, uint32_t size)
+{
+    return -1;
+}
+
+int32_t mm_stream_unmap_buf(mm_stream_t *my_obj, uint8_t buf_type,
+                            uint32_t frame_idx, int32_t plane_idx)
+{
+    return -1;
+}
+
+uint32_t mm_camera_util_generate_handler(uint8_t index)
+{
+    return index;
+}
+
+int32_t mm_camera_poll_thread_launch(mm_camera_poll_thread_t *poll_cb,
+                                     mm_camera_poll_thread_type_t poll_type)
+{
+    return -1;
+}
+
+int32_t mm_camera_poll_thread_release(mm_camera_poll_thread_t *poll_cb)
+{
+    return 0;
+}
+
+int32_t mm_camera_cmd_thread_launch(mm_camera_cmd_thread_t *cmd_thread,
+                                    mm_camera_cmd_cb_t cb,
+                                    void *user_data)
+{
+    return -1;
+}
+
+int32_t mm_camera_cmd_thread_name(const char *name)
+{
+    return 0;
+}
+
+int32_t mm_camera_cmd_thread_release(mm_camera_cmd_thread_t *cmd_thread)
+{
+    return 0;
+}
+
+int32_t mm_camera_start_zsl_snapshot(mm_camera_obj_t *my_obj)
+{
+    return 0;
+}
+
+int32_t mm_camera_stop_zsl_snapshot(mm_camera_obj_t *my_obj)
+{
+    return 0;
+}
+
+/* synthetic 3A state of a frame, a negative value leaves it out */
+typedef struct {
+    int32_t af_state;
+    int32_t lens_state;
+    int32_t aec_state;
+    int32_t aec_settled;
+    float exp_time;
+    int32_t sharpness;
+} test_meta_t;
+
+static void test_fill_meta(metadata_buffer_t *meta, const test_meta_t *t)
+{
+    int32_t i, j;
+
+    memset(meta, 0, sizeof(*meta));
+    if (t->af_state >= 0) {
+        *((uint32_t *)POINTER_OF_META(CAM_INTF_META_AF_STATE, meta)) =
+            (uint32_t)t->af_state;
+        meta->is_valid[CAM_INTF_META_AF_STATE] = 1;
+    }
+    if (t->lens_state >= 0) {
+        *((cam_af_lens_state_t *)POINTER_OF_META(CAM_INTF_META_LENS_STATE, meta)) =
+            (cam_af_lens_state_t)t->lens_state;
+        meta->is_valid[CAM_INTF_META_LENS_STATE] = 1;
+    }
+    if (t->aec_state >= 0) {
+        *((uint32_t *)POINTER_OF_META(CAM_INTF_META_AEC_STATE, meta)) =
+            (uint32_t)t->aec_state;
+        meta->is_valid[CAM_INTF_META_AEC_STATE] = 1;
+    }
+    if (t->aec_settled >= 0) {
+        cam_3a_params_t *aec_info = (cam_3a_params_t *)
+            POINTER_OF_META(CAM_INTF_META_AEC_INFO, meta);
+        aec_info->settled = t->aec_settled;
+        aec_info->exp_time = t->exp_time;
+        meta->is_valid[CAM_INTF_META_AEC_INFO] = 1;
+    }
+    if (t->sharpness >= 0) {
+        cam_sharpness_map_t *map = (cam_sharpness_map_t *)
+            POINTER_OF_META(CAM_INTF_META_STATS_SHARPNESS_MAP, meta);
+        for (i = 0; i < CAM_MAX_MAP_WIDTH; i++) {
+            for (j = 0; j < CAM_MAX_MAP_HEIGHT; j++) {
+                /* mean is t->sharpness, with some spread over the map */
+                map->sharpness[i][j] = t->sharpness + ((i + j) % 2 ? 1 : -1);
+            }
+        }
+        meta->is_valid[CAM_INTF_META_STATS_SHARPNESS_MAP] = 1;
+    }
+}
+
+static int32_t test_score(const test_meta_t *t, int32_t *sharpness)
+{
+    int32_t score;
+    metadata_buffer_t *meta = (metadata_buffer_t *)malloc(sizeof(*meta));
+
+    if (NULL == meta) {
+        printf("no mem for metadata\n");
+        exit(1);
+    }
+    test_fill_meta(meta, t);
+    score = mm_channel_metadata_score(meta, sharpness);
+    free(meta);
+    return score;
+}
+
+static const test_meta_t g_sharp = {
+    CAM_AF_STATE_FOCUSED_LOCKED, CAM_AF_LENS_STATE_STATIONARY,
+    CAM_AE_STATE_CONVERGED, 1, 0.0f, 10};
+static const test_meta_t g_hunting = {
+    CAM_AF_STATE_PASSIVE_SCAN, CAM_AF_LENS_STATE_MOVING,
+    CAM_AE_STATE_SEARCHING, 0, 0.0f, 3};
+
+static void test_metadata_score()
+{
+    test_meta_t t;
+    int32_t score, sharpness;
+
+    memset(&t, 0xff, sizeof(t));
+    score = test_score(&t, &sharpness);
+    TEST_CHECK(0 == score && 0 == sharpness,
+        "empty metadata scored %d sharpness %d", score, sharpness);
+
+    score = test_score(&g_sharp, &sharpness);
+    TEST_CHECK(800 == score, "sharp frame scored %d", score);
+    TEST_CHECK(10 == sharpness, "sharpness mean %d", sharpness);
+
+    score = test_score(&g_hunting, &sharpness);
+    TEST_CHECK(0 == score, "hunting frame scored %d", score);
+
+    /* AF state ranks before lens and AEC */
+    t = g_sharp;
+    t.af_state = CAM_AF_STATE_INACTIVE;
+    score = test_score(&t, &sharpness);
+    TEST_CHECK(600 == score, "AF inactive scored %d", score);
+    t.af_state = CAM_AF_STATE_NOT_FOCUSED_LOCKED;
+    score = test_score(&t, &sharpness);
+    TEST_CHECK(500 == score, "AF not focused scored %d", score);
+    t.af_state = CAM_AF_STATE_ACTIVE_SCAN;
+    score = test_score(&t, &sharpness);
+    TEST_CHECK(400 == score, "AF scanning scored %d", score);
+
+    /* AEC info stands in for a missing AEC state */
+    t = g_sharp;
+    t.aec_state = -1;
+    score = test_score(&t, &sharpness);
+    TEST_CHECK(800 == score, "settled AEC info scored %d", score);
+    t.aec_settled = 0;
+    score = test_score(&t, &sharpness);
+    TEST_CHECK(600 == score, "unsettled AEC info scored %d", score);
+
+    /* exposure time costs a point per ms, at most 99 */
+    t = g_sharp;
+    t.exp_time = 0.030f;
+    score = test_score(&t, &sharpness);
+    TEST_CHECK(770 == score || 771 == score, "30ms exposure scored %d", score);
+    t.exp_time = 0.5f;
+    score = test_score(&t, &sharpness);
+    TEST_CHECK(701 == score, "500ms exposure scored %d", score);
+    t.exp_time = -1.0f;
+    score = test_score(&t, &sharpness);
+    TEST_CHECK(800 == score, "negative exposure scored %d", score);
+}
+
+/* channel with a preview and a metadata stream, and a queue of superbufs */
+typedef struct {
+    mm_channel_t ch;
+    mm_channel_queue_t queue;
+    cam_stream_info_t preview_info;
+    cam_stream_info_t meta_info;
+    mm_camera_buf_def_t preview_bufs[TEST_MAX_FRAMES];
+    mm_camera_buf_def_t meta_bufs[TEST_MAX_FRAMES];
+    metadata_buffer_t *meta[TEST_MAX_FRAMES];
+} test_channel_t;
+
+static test_channel_t *test_channel_create(uint8_t window)
+{
+    int i;
+    test_channel_t *t = (test_channel_t *)calloc(1, sizeof(*t));
+
+    if (NULL == t) {
+        printf("no mem for channel\n");
+        exit(1);
+    }
+    t->preview_info.stream_type = CAM_STREAM_TYPE_PREVIEW;
+    t->meta_info.stream_type = CAM_STREAM_TYPE_METADATA;
+    t->ch.streams[0].state = MM_STREAM_STATE_ACTIVE;
+    t->ch.streams[0].my_hdl = TEST_PREVIEW_HDL;
+    t->ch.streams[0].stream_info = &t->preview_info;
+    t->ch.streams[1].state = MM_STREAM_STATE_ACTIVE;
+    t->ch.streams[1].my_hdl = TEST_META_HDL;
+    t->ch.streams[1].stream_info = &t->meta_info;
+
+    cam_queue_init(&t->queue.que);
+    t->queue.num_streams = 2;
+    t->queue.bundled_streams[0] = TEST_PREVIEW_HDL;
+    t->queue.bundled_streams[1] = TEST_META_HDL;
+    t->queue.attr.notify_mode = MM_CAMERA_SUPER_BUF_NOTIFY_BURST;
+    t->queue.attr.best_frame_window = window;
+
+    for (i = 0; i < TEST_MAX_FRAMES; i++) {
+        t->meta[i] = (metadata_buffer_t *)calloc(1, sizeof(metadata_buffer_t));
+        if (NULL == t->meta[i]) {
+            printf("no mem for metadata\n");
+            exit(1);
+        }
+    }
+    memset(&g_qbuf, 0, sizeof(g_qbuf));
+    return t;
+}
+
+/* queue frame i, its metadata carries t_meta, NULL for no metadata */
+static void test_channel_add(test_channel_t *t, uint32_t i,
+                             const test_meta_t *t_meta, uint8_t matched)
+{
+    mm_channel_queue_node_t *node =
+        (mm_channel_queue_node_t *)calloc(1, sizeof(*node));
+
+    if (NULL == node) {
+        printf("no mem for superbuf\n");
+        exit(1);
+    }
+    node->frame_idx = 100 + i;
+    node->matched = matched;
+    t->preview_bufs[i].stream_id = TEST_PREVIEW_HDL;
+    t->preview_bufs[i].frame_idx = node->frame_idx;
+    node->super_buf[0].stream_id = TEST_PREVIEW_HDL;
+    node->super_buf[0].buf = &t->preview_bufs[i];
+    node->num_of_bufs = 1;
+    if (NULL != t_meta) {
+        test_fill_meta(t->meta[i], t_meta);
+        t->meta_bufs[i].stream_id = TEST_META_HDL;
+        t->meta_bufs[i].frame_idx = node->frame_idx;
+        t->meta_bufs[i].buffer = t->meta[i];
+        node->super_buf[1].stream_id = TEST_META_HDL;
+        node->super_buf[1].buf = &t->meta_bufs[i];
+        node->num_of_bufs = 2;
+    }
+    cam_queue_enq(&t->queue.que, node);
+    if (matched) {
+        t->queue.match_cnt++;
+    }
+}
+
+static uint32_t test_channel_head(test_channel_t *t)
+{
+    struct cam_list *pos = t->queue.que.head.list.next;
+    cam_node_t *node;
+
+    if (pos == &t->queue.que.head.list) {
+        return 0;
+    }
+    node = member_of(pos, cam_node_t, list);
+    return ((mm_channel_queue_node_t *)node->data)->frame_idx;
+}
+
+static int test_qbuf_has(mm_camera_buf_def_t *buf)
+{
+    int i;
+
+    for (i = 0; i < g_qbuf.num_bufs; i++) {
+        if (g_qbuf.bufs[i] == buf) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void test_channel_destroy(test_channel_t *t)
+{
+    int i;
+    void *super_buf;
+
+    while (NULL != (super_buf = cam_queue_deq(&t->queue.que))) {
+        free(super_buf);
+    }
+    cam_queue_deinit(&t->queue.que);
+    for (i = 0; i < TEST_MAX_FRAMES; i++) {
+        free(t->meta[i]);
+    }
+    free(t);
+}
+
+static void test_select_best()
+{
+    test_channel_t *t = test_channel_create(4);
+    test_meta_t mid = g_sharp;
+
+    mid.lens_state = CAM_AF_LENS_STATE_MOVING;
+    test_channel_add(t, 0, &g_hunting, 1);
+    test_channel_add(t, 1, &mid, 1);
+    test_channel_add(t, 2, &g_sharp, 1);
+    test_channel_add(t, 3, &mid, 1);
+    test_channel_add(t, 4, &g_sharp, 1);
+    mm_channel_superbuf_select_best(&t->ch, &t->queue);
+
+    TEST_CHECK(102 == test_channel_head(t), "head is frame %u",
+        test_channel_head(t));
+    TEST_CHECK(3 == t->queue.que.size && 3 == t->queue.match_cnt,
+        "%u queued, %u matched", t->queue.que.size, t->queue.match_cnt);
+    TEST_CHECK(4 == g_qbuf.num_bufs, "%d buffers released", g_qbuf.num_bufs);
+    TEST_CHECK(test_qbuf_has(&t->preview_bufs[0]) &&
+        test_qbuf_has(&t->meta_bufs[0]) &&
+        test_qbuf_has(&t->preview_bufs[1]) &&
+        test_qbuf_has(&t->meta_bufs[1]),
+        "frames ahead of the best not released");
+    TEST_CHECK(!test_qbuf_has(&t->preview_bufs[2]),
+        "best frame released");
+    test_channel_destroy(t);
+}
+
+static void test_select_ties()
+{
+    test_channel_t *t = test_channel_create(4);
+    test_meta_t sharper = g_sharp;
+
+    /* equal scores keep the older frame */
+    test_channel_add(t, 0, &g_hunting, 1);
+    test_channel_add(t, 1, &g_sharp, 1);
+    test_channel_add(t, 2, &g_sharp, 1);
+    mm_channel_superbuf_select_best(&t->ch, &t->queue);
+    TEST_CHECK(101 == test_channel_head(t), "tie picked frame %u",
+        test_channel_head(t));
+    test_channel_destroy(t);
+
+    /* then sharpness breaks the tie */
+    t = test_channel_create(4);
+    sharper.sharpness = g_sharp.sharpness + 5;
+    test_channel_add(t, 0, &g_sharp, 1);
+    test_channel_add(t, 1, &sharper, 1);
+    test_channel_add(t, 2, &g_sharp, 1);
+    mm_channel_superbuf_select_best(&t->ch, &t->queue);
+    TEST_CHECK(101 == test_channel_head(t), "sharpness tie picked frame %u",
+        test_channel_head(t));
+    test_channel_destroy(t);
+}
+
+static void test_select_window()
+{
+    test_channel_t *t = test_channel_create(2);
+
+    /* the best frame is past the window */
+    test_channel_add(t, 0, &g_hunting, 1);
+    test_channel_add(t, 1, &g_hunting, 1);
+    test_channel_add(t, 2, &g_sharp, 1);
+    mm_channel_superbuf_select_best(&t->ch, &t->queue);
+    TEST_CHECK(100 == test_channel_head(t) && 0 == g_qbuf.num_bufs,
+        "frame %u picked outside the window", test_channel_head(t));
+    test_channel_destroy(t);
+
+    /* unmatched superbufs are not scored nor released */
+    t = test_channel_create(2);
+    test_channel_add(t, 0, &g_sharp, 0);
+    test_channel_add(t, 1, &g_hunting, 1);
+    test_channel_add(t, 2, &g_sharp, 1);
+    mm_channel_superbuf_select_best(&t->ch, &t->queue);
+    TEST_CHECK(100 == test_channel_head(t) && 2 == t->queue.que.size,
+        "head %u, %u queued", test_channel_head(t), t->queue.que.size);
+    TEST_CHECK(2 == g_qbuf.num_bufs && test_qbuf_has(&t->preview_bufs[1]),
+        "%d buffers released", g_qbuf.num_bufs);
+    test_channel_destroy(t);
+
+    /* frames without metadata score 0 and lose to any scored frame */
+    t = test_channel_create(3);
+    test_channel_add(t, 0, NULL, 1);
+    test_channel_add(t, 1, &g_hunting, 1);
+    test_channel_add(t, 2, &g_sharp, 1);
+    mm_channel_superbuf_select_best(&t->ch, &t->queue);
+    TEST_CHECK(102 == test_channel_head(t), "head is frame %u",
+        test_channel_head(t));
+    test_channel_destroy(t);
+}
+
+static void test_select_off()
+{
+    test_channel_t *t = test_channel_create(1);
+
+    /* a window of 1 keeps the oldest frame */
+    test_channel_add(t, 0, &g_hunting, 1);
+    test_channel_add(t, 1, &g_sharp, 1);
+    mm_channel_superbuf_select_best(&t->ch, &t->queue);
+    TEST_CHECK(100 == test_channel_head(t) && 0 == g_qbuf.num_bufs,
+        "window 1 picked frame %u", test_channel_head(t));
+    test_channel_destroy(t);
+
+    /* only burst mode looks for the best frame */
+    t = test_channel_create(4);
+    t->queue.attr.notify_mode = MM_CAMERA_SUPER_BUF_NOTIFY_CONTINUOUS;
+    test_channel_add(t, 0, &g_hunting, 1);
+    test_channel_add(t, 1, &g_sharp, 1);
+    mm_channel_superbuf_select_best(&t->ch, &t->queue);
+    TEST_CHECK(100 == test_channel_head(t) && 0 == g_qbuf.num_bufs,
+        "continuous mode picked frame %u", test_channel_head(t));
+    test_channel_destroy(t);
+}
+
+int main(int argc, char *argv[])
+{
+    test_metadata_score();
+    test_select_best();
+    test_select_ties();
+    test_select_window();
+    test_select_off();
+
+    if (g_failures) {
+        printf("%d checks failed\n", g_failures);
+        return 1;
+    }
+    printf("best frame selection ok\n");
+    return 0;
+}
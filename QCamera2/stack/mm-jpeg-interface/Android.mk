@@ -37,6 +37,7 @@ LOCAL_SRC_FILES := \
     src/mm_jpeg.c \
     src/mm_jpeg_interface.c \
     src/mm_jpeg_ionbuf.c \
+    src/mm_jpeg_outbuf.c \
     src/mm_jpegdec_interface.c \
     src/mm_jpegdec.c
 
@@ -39,6 +39,7 @@
 #include "OMX_Component.h"
 #include "QOMX_JpegExtensions.h"
 #include "mm_jpeg_ionbuf.h"
+#include "mm_jpeg_outbuf.h"
 
 #define MM_JPEG_MAX_THREADS 30
 #define MM_JPEG_CIRQ_SIZE 30
@@ -46,6 +47,16 @@
 #define MAX_EXIF_TABLE_ENTRIES 50
 #define MAX_JPEG_SIZE 20000000
 #define MAX_OMX_HANDLES (5)
+#define MM_JPEG_STREAMING_CHUNK_SIZE (64 * 1024)
+
+/* software encoder use, persist.camera.jpeg.swenc */
+#define MM_JPEG_SW_ENC_OFF 0
+#define MM_JPEG_SW_ENC_FALLBACK 1
+#define MM_JPEG_SW_ENC_ONLY 2
+#define MM_JPEG_SW_ENC_NAME "OMX.qcom.image.jpeg.encoder_sw"
+
+/* software decoder use, persist.camera.jpeg.swdec, MM_JPEG_SW_ENC_* modes */
+#define MM_JPEG_SW_DEC_NAME "OMX.qcom.image.jpeg.decoder_sw"
 
 
 /** mm_jpeg_abort_state_t:
@@ -66,6 +77,10 @@ typedef enum {
  * Current, only one per time */
 #define NUM_MAX_JPEG_CNCURRENT_JOBS 2
 
+/* decode jobs handed to OMX at once, a pipelined decoder queues the
+ * ones it cannot start yet */
+#define NUM_MAX_JPEGDEC_CNCURRENT_JOBS 8
+
 #define JOB_ID_MAGICVAL 0x1
 #define JOB_HIST_MAX 10000
 
@@ -259,6 +274,20 @@ typedef enum {
   MM_JPEG_CMD_TYPE_MAX
 } mm_jpeg_cmd_type_t;
 
+/** mm_jpeg_dec_slot_t:
+ *  @job_id: job decoding into the output buffer, 0 if the result
+ *           is dropped
+ *  @src_index: input buffer of the job
+ *  @busy: the output buffer is with the component
+ *
+ *  Output buffer of a pipelined decode session
+ **/
+typedef struct {
+  uint32_t job_id;
+  uint32_t src_index;
+  OMX_BOOL busy;
+} mm_jpeg_dec_slot_t;
+
 typedef struct mm_jpeg_job_session {
   uint32_t client_hdl;           /* client handler */
   uint32_t jobId;                /* job ID */
@@ -328,6 +357,35 @@ typedef struct mm_jpeg_job_session {
 
   mm_jpeg_queue_t *session_handle_q;
   mm_jpeg_queue_t *out_buf_q;
+
+  /* session is destroyed by client but kept warm for reuse */
+  OMX_BOOL cached;
+  /* LRU stamp of the last time the session was parked */
+  uint32_t cache_seq;
+
+  /* component returns partial output, see QOMX_JPEG_STREAMING */
+  OMX_BOOL streaming;
+  /* bytes of the current job already passed to jpeg_chunk_cb */
+  uint32_t stream_offset;
+  uint32_t stream_chunks;
+  uint64_t encode_start_us;
+
+  /* output buffers come from the jpeg obj pool, sized to the result */
+  OMX_BOOL auto_size;
+  omx_jpeg_ouput_buf_t out_desc[MM_JPEG_MAX_BUF];
+  /* pool buffer holding the output of the current job */
+  mm_jpeg_out_buf_t *p_out_buf;
+  /* output memory accounting, shared by the sessions of a burst */
+  mm_jpeg_out_buf_stats_t out_stats;
+  mm_jpeg_out_buf_stats_t *p_out_stats;
+
+  /* decoder keeps its ports across jobs and runs several of them at
+   * once, see QOMX_JPEG_DECODE_PIPELINE */
+  OMX_BOOL dec_pipeline;
+  /* output buffers are registered with the decoder */
+  OMX_BOOL dec_out_ready;
+  uint32_t dec_num_active;
+  mm_jpeg_dec_slot_t dec_slot[MM_JPEG_MAX_BUF];
 } mm_jpeg_job_session_t;
 
 typedef struct {
@@ -387,6 +445,26 @@ typedef struct mm_jpeg_obj_t {
 
   int num_sessions;
 
+  /* max idle sessions kept warm per client, 0 disables caching */
+  uint32_t session_cache_size;
+  uint32_t cache_seq;
+
+  /* when to use the software encoder, MM_JPEG_SW_ENC_* */
+  uint32_t sw_enc_mode;
+
+  /* output buffers of auto sized sessions */
+  mm_jpeg_out_buf_pool_t out_pool;
+  uint32_t out_pool_limit;
+
+  /* jobs handed to OMX at once */
+  uint32_t max_ongoing_jobs;
+
+  /* when to use the software decoder, MM_JPEG_SW_ENC_* */
+  uint32_t sw_dec_mode;
+  /* concurrent decodes of a pipelined session, 0 for the decoder
+   * default */
+  uint32_t dec_jobs;
+
 } mm_jpeg_obj;
 
 /** mm_jpeg_pending_func_t:
@@ -411,6 +489,13 @@ extern int32_t mm_jpeg_create_session(mm_jpeg_obj *my_obj,
   uint32_t* p_session_id);
 extern int32_t mm_jpeg_destroy_session_by_id(mm_jpeg_obj *my_obj,
   uint32_t session_id);
+extern int32_t mm_jpeg_prewarm_session(mm_jpeg_obj *my_obj,
+  uint32_t client_hdl,
+  mm_jpeg_encode_params_t *p_params);
+extern int32_t mm_jpeg_flush_session_cache(mm_jpeg_obj *my_obj,
+  uint32_t client_hdl);
+extern int32_t mm_jpeg_release_out_buf(mm_jpeg_obj *my_obj,
+  uint8_t *p_buf);
 
 extern int32_t mm_jpegdec_init(mm_jpeg_obj *my_obj);
 extern int32_t mm_jpegdec_deinit(mm_jpeg_obj *my_obj);
@@ -451,6 +536,9 @@ extern void* mm_jpeg_queue_peek(mm_jpeg_queue_t* queue);
 extern int32_t addExifEntry(QOMX_EXIF_INFO *p_exif_info, exif_tag_id_t tagid,
   exif_tag_type_t type, uint32_t count, void *data);
 extern int32_t releaseExifEntry(QEXIF_INFO_DATA *p_exif_data);
+extern int32_t mm_jpeg_exif_insert_thumbnail(uint8_t *p_jpeg,
+  uint32_t jpeg_len, uint8_t *p_thumb, uint32_t thumb_len,
+  uint8_t *p_out, uint32_t out_size, uint32_t *p_out_len);
 extern int process_meta_data(metadata_buffer_t *p_meta,
   QOMX_EXIF_INFO *exif_info, mm_jpeg_exif_params_t *p_cam3a_params,
   cam_hal_version_t hal_version);
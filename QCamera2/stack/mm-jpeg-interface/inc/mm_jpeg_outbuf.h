@@ -0,0 +1,308 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __MM_JPEG_OUTBUF_H__
+#define __MM_JPEG_OUTBUF_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+/* size classes grow by half an octave from 64K, larger requests are
+ * allocated exactly and not kept */
+#define MM_JPEG_OUT_BUF_MIN_SIZE (64 * 1024)
+#define MM_JPEG_OUT_BUF_NUM_CLASSES 20
+
+/* compression ratios are tracked per 10 quality steps */
+#define MM_JPEG_OUT_BUF_NUM_QBUCKETS 11
+
+/** mm_jpeg_out_buf_stats_t:
+ *  @owner_id: id of the session charged for the buffers, 0 if
+ *           the stats are no longer tracked
+ *  @cur_bytes: output memory currently held
+ *  @peak_bytes: highest value of cur_bytes
+ *  @num_allocs: buffers newly allocated
+ *  @num_reused: buffers served from the pool
+ *  @num_waits: jobs held back because of the memory limit
+ *
+ *  Output memory accounting of one session
+ **/
+typedef struct {
+  uint32_t owner_id;
+  uint32_t cur_bytes;
+  uint32_t peak_bytes;
+  uint32_t num_allocs;
+  uint32_t num_reused;
+  uint32_t num_waits;
+} mm_jpeg_out_buf_stats_t;
+
+/** mm_jpeg_out_buf_t:
+ *  @magic: identifies pool buffers
+ *  @pool_id: id of the pool the buffer belongs to
+ *  @p_pool: owning pool
+ *  @next: free list link
+ *  @ref_count: number of holders
+ *  @size: usable size
+ *  @class_idx: size class, MM_JPEG_OUT_BUF_NUM_CLASSES if unpooled
+ *  @p_stats: accounting the buffer is charged to
+ *  @owner_id: p_stats owner at the time of the charge
+ *  @vaddr: buffer data
+ *
+ *  Output buffer header, the data follows the header in the same
+ *  allocation
+ **/
+typedef struct mm_jpeg_out_buf {
+  uint32_t magic;
+  uint32_t pool_id;
+  struct mm_jpeg_out_buf_pool *p_pool;
+  struct mm_jpeg_out_buf *next;
+  int32_t ref_count;
+  uint32_t size;
+  uint32_t class_idx;
+  mm_jpeg_out_buf_stats_t *p_stats;
+  uint32_t owner_id;
+  uint8_t *vaddr;
+} mm_jpeg_out_buf_t;
+
+/** mm_jpeg_out_buf_pool_t:
+ *  @lock: pool lock
+ *  @id: unique pool id
+ *  @free_list: released buffers per size class
+ *  @free_bytes: memory held in the free lists
+ *  @free_limit: max memory kept in the free lists
+ *  @used_bytes: memory of the buffers in use
+ *  @used_limit: memory in use above which new jobs wait
+ *  @peak_bytes: highest value of used_bytes
+ *  @bpp: observed output bytes per pixel for each quality bucket
+ *  @owner_seq: last owner id handed out
+ *
+ *  Refcounted pool of encoder output buffers
+ **/
+typedef struct mm_jpeg_out_buf_pool {
+  pthread_mutex_t lock;
+  uint32_t id;
+  mm_jpeg_out_buf_t *free_list[MM_JPEG_OUT_BUF_NUM_CLASSES];
+  uint32_t free_bytes;
+  uint32_t free_limit;
+  uint32_t used_bytes;
+  uint32_t used_limit;
+  uint32_t peak_bytes;
+  float bpp[MM_JPEG_OUT_BUF_NUM_QBUCKETS];
+  uint32_t owner_seq;
+} mm_jpeg_out_buf_pool_t;
+
+/** mm_jpeg_out_buf_pool_init:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @used_limit: memory in use above which new jobs wait, 0 for
+ *                no limit
+ *
+ *  Return:
+ *     0 for success else failure
+ *
+ *  Description:
+ *      Initialize the output buffer pool
+ *
+ **/
+int mm_jpeg_out_buf_pool_init(mm_jpeg_out_buf_pool_t *p_pool,
+  uint32_t used_limit);
+
+/** mm_jpeg_out_buf_pool_deinit:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *
+ *  Return:
+ *     none
+ *
+ *  Description:
+ *      Free the pooled buffers. Buffers still held by clients are
+ *      freed directly when released
+ *
+ **/
+void mm_jpeg_out_buf_pool_deinit(mm_jpeg_out_buf_pool_t *p_pool);
+
+/** mm_jpeg_out_buf_get:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @size: bytes needed
+ *     @p_stats: accounting to charge, can be NULL
+ *
+ *  Return:
+ *     buffer with one reference, NULL on failure
+ *
+ *  Description:
+ *      Get a buffer of at least size bytes
+ *
+ **/
+mm_jpeg_out_buf_t *mm_jpeg_out_buf_get(mm_jpeg_out_buf_pool_t *p_pool,
+  uint32_t size, mm_jpeg_out_buf_stats_t *p_stats);
+
+/** mm_jpeg_out_buf_unref:
+ *
+ *  Arguments:
+ *     @p_buf: buffer
+ *
+ *  Return:
+ *     1 if the last reference was dropped, 0 otherwise
+ *
+ *  Description:
+ *      Drop a reference, the buffer goes back to the pool when
+ *      the last one is dropped
+ *
+ **/
+int mm_jpeg_out_buf_unref(mm_jpeg_out_buf_t *p_buf);
+
+/** mm_jpeg_out_buf_swap:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @pp_slot: buffer slot
+ *     @p_buf: new buffer, can be NULL
+ *
+ *  Return:
+ *     buffer previously in the slot
+ *
+ *  Description:
+ *      Replace the buffer held in a slot, serialized by the pool
+ *      lock for slots shared between threads
+ *
+ **/
+mm_jpeg_out_buf_t *mm_jpeg_out_buf_swap(mm_jpeg_out_buf_pool_t *p_pool,
+  mm_jpeg_out_buf_t **pp_slot, mm_jpeg_out_buf_t *p_buf);
+
+/** mm_jpeg_out_buf_release:
+ *
+ *  Arguments:
+ *     @p_pool: current pool, NULL if there is none
+ *     @vaddr: buffer data passed to the client
+ *
+ *  Return:
+ *     1 if output memory was freed, 0 if not, -1 if vaddr is not
+ *     a pool buffer
+ *
+ *  Description:
+ *      Drop the client reference of a delivered buffer. Buffers of
+ *      a pool that is gone are freed directly
+ *
+ **/
+int mm_jpeg_out_buf_release(mm_jpeg_out_buf_pool_t *p_pool, uint8_t *vaddr);
+
+/** mm_jpeg_out_buf_estimate:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @quality: jpeg quality
+ *     @pixels: output pixels
+ *
+ *  Return:
+ *     expected output size with headroom
+ *
+ *  Description:
+ *      Estimate the output size from the compression ratios seen
+ *      so far at this quality
+ *
+ **/
+uint32_t mm_jpeg_out_buf_estimate(mm_jpeg_out_buf_pool_t *p_pool,
+  uint32_t quality, uint32_t pixels);
+
+/** mm_jpeg_out_buf_record:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @quality: jpeg quality
+ *     @pixels: output pixels
+ *     @len: output size
+ *
+ *  Return:
+ *     none
+ *
+ *  Description:
+ *      Update the compression ratio for the quality
+ *
+ **/
+void mm_jpeg_out_buf_record(mm_jpeg_out_buf_pool_t *p_pool,
+  uint32_t quality, uint32_t pixels, uint32_t len);
+
+/** mm_jpeg_out_buf_admit:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @size: expected output size
+ *     @p_stats: accounting of the session, can be NULL
+ *
+ *  Return:
+ *     1 if the job can start, 0 if it has to wait for buffers to
+ *     be released
+ *
+ *  Description:
+ *      Check a new job against the memory limit. A job is always
+ *      admitted when its session holds no output memory, so that
+ *      buffers kept by other clients cannot stall it
+ *
+ **/
+int mm_jpeg_out_buf_admit(mm_jpeg_out_buf_pool_t *p_pool, uint32_t size,
+  mm_jpeg_out_buf_stats_t *p_stats);
+
+/** mm_jpeg_out_buf_stats_open:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @p_stats: accounting of the session
+ *
+ *  Return:
+ *     none
+ *
+ *  Description:
+ *      Reset the session accounting and give it a new owner id
+ *
+ **/
+void mm_jpeg_out_buf_stats_open(mm_jpeg_out_buf_pool_t *p_pool,
+  mm_jpeg_out_buf_stats_t *p_stats);
+
+/** mm_jpeg_out_buf_stats_close:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @p_stats: accounting of the session
+ *     @p_out: copy of the final stats
+ *
+ *  Return:
+ *     none
+ *
+ *  Description:
+ *      Stop charging the session, buffers it still holds are no
+ *      longer accounted to it
+ *
+ **/
+void mm_jpeg_out_buf_stats_close(mm_jpeg_out_buf_pool_t *p_pool,
+  mm_jpeg_out_buf_stats_t *p_stats, mm_jpeg_out_buf_stats_t *p_out);
+
+#endif /* __MM_JPEG_OUTBUF_H__ */
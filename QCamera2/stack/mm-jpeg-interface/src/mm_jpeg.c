@@ -35,6 +35,7 @@
 #include <sys/prctl.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <time.h>
 
 #include "mm_jpeg_dbg.h"
 #include "mm_jpeg_interface.h"
@@ -70,6 +71,13 @@ static void mm_jpegenc_job_done(mm_jpeg_job_session_t *p_session);
 mm_jpeg_job_q_node_t* mm_jpeg_queue_remove_job_by_dst_ptr(
   mm_jpeg_queue_t* queue, void * dst_ptr);
 static OMX_ERRORTYPE mm_jpeg_session_configure(mm_jpeg_job_session_t *p_session);
+static mm_jpeg_job_session_t *mm_jpeg_session_cache_lookup(mm_jpeg_obj *my_obj,
+  uint8_t clnt_idx, mm_jpeg_encode_params_t *p_params);
+static OMX_BOOL mm_jpeg_session_cache_park(mm_jpeg_obj *my_obj,
+  mm_jpeg_job_session_t *p_session);
+static OMX_BOOL mm_jpeg_session_cache_evict(mm_jpeg_obj *my_obj);
+static uint64_t mm_jpeg_get_time_us(void);
+static int mm_jpeg_session_put_out_buf(mm_jpeg_job_session_t *p_session);
 
 /** mm_jpeg_session_send_buffers:
  *
@@ -120,9 +128,18 @@ OMX_ERRORTYPE mm_jpeg_session_send_buffers(void *data)
 
   for (i = 0; i < p_params->num_dst_bufs; i++) {
     CDBG("%s:%d] Dest buffer %d", __func__, __LINE__, i);
-    ret = OMX_UseBuffer(p_session->omx_handle, &(p_session->p_out_omx_buf[i]),
-      1, NULL, p_params->dest_buf[i].buf_size,
-      p_params->dest_buf[i].buf_vaddr);
+    if (OMX_TRUE == p_session->auto_size) {
+      /* the component asks mm_jpeg_get_out_memory for the buffer */
+      memset(&p_session->out_desc[i], 0x0, sizeof(omx_jpeg_ouput_buf_t));
+      p_session->out_desc[i].handle = p_session;
+      ret = OMX_UseBuffer(p_session->omx_handle,
+        &(p_session->p_out_omx_buf[i]), 1, NULL,
+        sizeof(omx_jpeg_ouput_buf_t), (OMX_U8 *)&p_session->out_desc[i]);
+    } else {
+      ret = OMX_UseBuffer(p_session->omx_handle,
+        &(p_session->p_out_omx_buf[i]), 1, NULL,
+        p_params->dest_buf[i].buf_size, p_params->dest_buf[i].buf_vaddr);
+    }
     if (ret) {
       CDBG_ERROR("%s:%d] Error", __func__, __LINE__);
       return ret;
@@ -291,16 +308,40 @@ OMX_ERRORTYPE mm_jpeg_session_create(mm_jpeg_job_session_t* p_session)
   p_session->config = OMX_FALSE;
   p_session->exif_count_local = 0;
   p_session->auto_out_buf = OMX_FALSE;
+  p_session->cached = OMX_FALSE;
+  p_session->streaming = OMX_FALSE;
+  p_session->auto_size = OMX_FALSE;
+  p_session->p_out_buf = NULL;
+  p_session->p_out_stats = &p_session->out_stats;
 
   p_session->omx_callbacks.EmptyBufferDone = mm_jpeg_ebd;
   p_session->omx_callbacks.FillBufferDone = mm_jpeg_fbd;
   p_session->omx_callbacks.EventHandler = mm_jpeg_event_handler;
 
 
-  rc = OMX_GetHandle(&p_session->omx_handle,
-      "OMX.qcom.image.jpeg.encoder",
-      (void *)p_session,
-      &p_session->omx_callbacks);
+  rc = OMX_ErrorComponentNotFound;
+  if (MM_JPEG_SW_ENC_ONLY != my_obj->sw_enc_mode) {
+    rc = OMX_GetHandle(&p_session->omx_handle,
+        "OMX.qcom.image.jpeg.encoder",
+        (void *)p_session,
+        &p_session->omx_callbacks);
+    /* warm sessions hold hw encoder instances, give them back first */
+    while ((OMX_ErrorNone != rc) &&
+      (OMX_TRUE == mm_jpeg_session_cache_evict(my_obj))) {
+      rc = OMX_GetHandle(&p_session->omx_handle,
+          "OMX.qcom.image.jpeg.encoder",
+          (void *)p_session,
+          &p_session->omx_callbacks);
+    }
+  }
+  if ((OMX_ErrorNone != rc) && (MM_JPEG_SW_ENC_OFF != my_obj->sw_enc_mode)) {
+    CDBG_ERROR("%s:%d] hw encoder unavailable (%d), falling back to %s",
+      __func__, __LINE__, rc, MM_JPEG_SW_ENC_NAME);
+    rc = OMX_GetHandle(&p_session->omx_handle,
+        MM_JPEG_SW_ENC_NAME,
+        (void *)p_session,
+        &p_session->omx_callbacks);
+  }
   if (OMX_ErrorNone != rc) {
     CDBG_ERROR("%s:%d] OMX_GetHandle failed (%d)", __func__, __LINE__, rc);
     return rc;
@@ -363,6 +404,8 @@ void mm_jpeg_session_destroy(mm_jpeg_job_session_t* p_session)
   }
   p_session->omx_handle = NULL;
 
+  mm_jpeg_session_put_out_buf(p_session);
+
   pthread_mutex_destroy(&p_session->lock);
   pthread_cond_destroy(&p_session->cond);
 
@@ -532,6 +575,140 @@ OMX_ERRORTYPE mm_jpeg_speed_mode(
 }
 
 
+/** mm_jpeg_get_out_memory:
+ *
+ *  Arguments:
+ *    @p_out_buf: output descriptor of the session
+ *
+ *  Return:
+ *       0 for success else failure
+ *
+ *  Description:
+ *       Allocator of auto sized sessions. The component asks for
+ *       the final size once the image is encoded, the buffer is
+ *       taken from the output pool and held by the session until
+ *       it is delivered
+ *
+ **/
+static int mm_jpeg_get_out_memory(omx_jpeg_ouput_buf_t *p_out_buf)
+{
+  mm_jpeg_job_session_t *p_session =
+    (mm_jpeg_job_session_t *)p_out_buf->handle;
+  mm_jpeg_obj *my_obj = (mm_jpeg_obj *)p_session->jpeg_obj;
+  mm_jpeg_out_buf_t *p_buf;
+
+  p_buf = mm_jpeg_out_buf_get(&my_obj->out_pool, (uint32_t)p_out_buf->size,
+    p_session->p_out_stats);
+  if (NULL == p_buf) {
+    CDBG_ERROR("%s:%d] no output memory for %d bytes", __func__, __LINE__,
+      p_out_buf->size);
+    return -1;
+  }
+
+  /* an output left over from an aborted job is dropped */
+  p_buf = mm_jpeg_out_buf_swap(&my_obj->out_pool, &p_session->p_out_buf,
+    p_buf);
+  if (NULL != p_buf) {
+    mm_jpeg_out_buf_unref(p_buf);
+  }
+
+  p_out_buf->vaddr = p_session->p_out_buf->vaddr;
+  p_out_buf->mem_hdl = p_session->p_out_buf;
+  p_out_buf->isheap = 1;
+  p_out_buf->fd = -1;
+  return 0;
+}
+
+/** mm_jpeg_session_put_out_buf:
+ *
+ *  Arguments:
+ *    @p_session: job session
+ *
+ *  Return:
+ *       1 if output memory was freed, 0 otherwise
+ *
+ *  Description:
+ *       Drop the output buffer the session still holds
+ *
+ **/
+static int mm_jpeg_session_put_out_buf(mm_jpeg_job_session_t *p_session)
+{
+  mm_jpeg_obj *my_obj = (mm_jpeg_obj *)p_session->jpeg_obj;
+  mm_jpeg_out_buf_t *p_buf;
+
+  if (OMX_TRUE != p_session->auto_size) {
+    return 0;
+  }
+  p_buf = mm_jpeg_out_buf_swap(&my_obj->out_pool, &p_session->p_out_buf,
+    NULL);
+  if (NULL == p_buf) {
+    return 0;
+  }
+  return mm_jpeg_out_buf_unref(p_buf);
+}
+
+/** mm_jpeg_session_out_mem_open:
+ *
+ *  Arguments:
+ *    @my_obj: jpeg object
+ *    @p_session: first session of the client session
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Start the output memory accounting of a client session.
+ *       The sessions of a burst share the stats of the first one
+ *
+ **/
+static void mm_jpeg_session_out_mem_open(mm_jpeg_obj *my_obj,
+  mm_jpeg_job_session_t *p_session)
+{
+  mm_jpeg_job_session_t *p_cur_sess = p_session;
+  mm_jpeg_encode_params_t *p_params = &p_session->params;
+  uint32_t i;
+
+  mm_jpeg_out_buf_stats_open(&my_obj->out_pool, &p_session->out_stats);
+  do {
+    p_cur_sess->p_out_stats = &p_session->out_stats;
+  } while (NULL != (p_cur_sess = p_cur_sess->next_session));
+
+  /* client buffers are all held for the life of the session */
+  if (OMX_TRUE != p_session->auto_size) {
+    for (i = 0; i < p_params->num_dst_bufs; i++) {
+      p_session->out_stats.peak_bytes += p_params->dest_buf[i].buf_size;
+    }
+  }
+}
+
+/** mm_jpeg_session_out_mem_report:
+ *
+ *  Arguments:
+ *    @my_obj: jpeg object
+ *    @p_session: first session of the client session
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Report the output memory used by a client session and
+ *       stop its accounting
+ *
+ **/
+static void mm_jpeg_session_out_mem_report(mm_jpeg_obj *my_obj,
+  mm_jpeg_job_session_t *p_session)
+{
+  mm_jpeg_out_buf_stats_t stats;
+
+  mm_jpeg_out_buf_stats_close(&my_obj->out_pool, &p_session->out_stats,
+    &stats);
+  CDBG_HIGH("%s:%d] [KPI Perf] session %x %s output peak %u bytes, "
+    "allocs %u reused %u waits %u", __func__, __LINE__,
+    p_session->sessionId,
+    (OMX_TRUE == p_session->auto_size) ? "auto" : "fixed",
+    stats.peak_bytes, stats.num_allocs, stats.num_reused, stats.num_waits);
+}
+
 /** mm_jpeg_mem_ops:
  *
  *  Arguments:
@@ -557,6 +734,9 @@ OMX_ERRORTYPE mm_jpeg_mem_ops(
   mm_jpeg_encode_job_t *p_jobparams = &p_session->encode_job;
 
   mem_ops.get_memory = p_params->get_memory;
+  if (OMX_TRUE == p_session->auto_size) {
+    mem_ops.get_memory = mm_jpeg_get_out_memory;
+  }
 
   rc = OMX_GetExtensionIndex(p_session->omx_handle,
     QOMX_IMAGE_EXT_MEM_OPS_NAME, &indextype);
@@ -573,6 +753,56 @@ OMX_ERRORTYPE mm_jpeg_mem_ops(
   return rc;
 }
 
+/** mm_jpeg_streaming_mode:
+ *
+ *  Arguments:
+ *    @p_session: job session
+ *
+ *  Return:
+ *       OMX error values
+ *
+ *  Description:
+ *       Ask the component for partial output when the client
+ *       registered a chunk callback. Components without the
+ *       extension return the whole image at once, which is then
+ *       delivered as a single chunk
+ *
+ **/
+OMX_ERRORTYPE mm_jpeg_streaming_mode(
+  mm_jpeg_job_session_t* p_session)
+{
+  OMX_ERRORTYPE rc = 0;
+  OMX_INDEXTYPE indextype;
+  QOMX_JPEG_STREAMING streaming;
+  mm_jpeg_encode_params_t *p_params = &p_session->params;
+
+  p_session->streaming = OMX_FALSE;
+  if ((NULL == p_params->jpeg_chunk_cb) || (NULL != p_params->get_memory) ||
+    (OMX_TRUE == p_session->auto_size)) {
+    return OMX_ErrorNone;
+  }
+
+  rc = OMX_GetExtensionIndex(p_session->omx_handle,
+    QOMX_IMAGE_EXT_STREAMING_NAME, &indextype);
+  if (rc != OMX_ErrorNone) {
+    CDBG_HIGH("%s:%d] streaming not supported, single chunk output",
+      __func__, __LINE__);
+    return OMX_ErrorNone;
+  }
+
+  streaming.bEnable = OMX_TRUE;
+  streaming.nChunkSize = MM_JPEG_STREAMING_CHUNK_SIZE;
+  rc = OMX_SetParameter(p_session->omx_handle, indextype, &streaming);
+  if (rc != OMX_ErrorNone) {
+    CDBG_HIGH("%s:%d] streaming rejected %d, single chunk output",
+      __func__, __LINE__, rc);
+    return OMX_ErrorNone;
+  }
+
+  p_session->streaming = OMX_TRUE;
+  return rc;
+}
+
 /** mm_jpeg_metadata:
  *
  *  Arguments:
@@ -1091,6 +1321,13 @@ OMX_ERRORTYPE mm_jpeg_session_config_main(mm_jpeg_job_session_t *p_session)
     return rc;
   }
 
+  /* set partial output for streaming clients */
+  rc = mm_jpeg_streaming_mode(p_session);
+  if (OMX_ErrorNone != rc) {
+    CDBG_ERROR("%s: config streaming mode failed", __func__);
+    return rc;
+  }
+
   return rc;
 }
 
@@ -1441,6 +1678,9 @@ static OMX_ERRORTYPE mm_jpeg_session_encode(mm_jpeg_job_session_t *p_session)
   }
   pthread_mutex_lock(&p_session->lock);
   p_session->encoding = OMX_TRUE;
+  p_session->stream_offset = 0;
+  p_session->stream_chunks = 0;
+  p_session->encode_start_us = mm_jpeg_get_time_us();
   pthread_mutex_unlock(&p_session->lock);
 
   MM_JPEG_CHK_ABORT(p_session, ret, error);
@@ -1513,6 +1753,8 @@ int32_t mm_jpeg_process_encoding_job(mm_jpeg_obj *my_obj, mm_jpeg_job_q_node_t*
   mm_jpeg_job_q_node_t *node = NULL;
   OMX_HANDLETYPE omx_handle = NULL;
   uint32_t buf_idx;
+  uint32_t out_size;
+  cam_dimension_t *p_dim;
 
   /* check if valid session */
   p_session = mm_jpeg_get_session(my_obj, job_node->enc_info.job_id);
@@ -1540,15 +1782,32 @@ int32_t mm_jpeg_process_encoding_job(mm_jpeg_obj *my_obj, mm_jpeg_job_q_node_t*
 
   }
 
+  if (OMX_TRUE == p_session->auto_size) {
+    p_dim = &job_node->enc_info.encode_job.main_dim.dst_dim;
+    out_size = mm_jpeg_out_buf_estimate(&my_obj->out_pool,
+      p_session->params.quality, (uint32_t)(p_dim->width * p_dim->height));
+    if (!mm_jpeg_out_buf_admit(&my_obj->out_pool, out_size,
+      p_session->p_out_stats)) {
+      /* retried when the client releases an output buffer */
+      mm_jpeg_queue_enq(p_session->session_handle_q, p_session);
+      mm_jpeg_queue_enq_head(&my_obj->job_mgr.job_queue, job_node);
+      return rc;
+    }
+  }
+
   p_session->auto_out_buf = OMX_FALSE;
   if (job_node->enc_info.encode_job.dst_index < 0) {
     /* dequeue available output buffer idx */
     buf_idx = (uint32_t)mm_jpeg_queue_deq(p_session->out_buf_q);
 
     if (NULL == (void*)buf_idx) {
-      CDBG_ERROR("%s:%d] No available output buffers %d",
-          __func__, __LINE__, ret);
-      return OMX_ErrorUndefined;
+      CDBG_HIGH("%s:%d] No available output buffers, job waits",
+          __func__, __LINE__);
+      /* retried when a job completes and returns its buffer */
+      p_session->p_out_stats->num_waits++;
+      mm_jpeg_queue_enq(p_session->session_handle_q, p_session);
+      mm_jpeg_queue_enq_head(&my_obj->job_mgr.job_queue, job_node);
+      return rc;
     }
 
     buf_idx--;
@@ -1633,7 +1892,7 @@ static void *mm_jpeg_jobmgr_thread(void *data)
 
     /* check ongoing q size */
     num_ongoing_jobs = mm_jpeg_queue_get_size(&my_obj->ongoing_job_q);
-    if (num_ongoing_jobs >= NUM_MAX_JPEG_CNCURRENT_JOBS) {
+    if (num_ongoing_jobs >= my_obj->max_ongoing_jobs) {
       CDBG("%s:%d] ongoing job already reach max %d", __func__,
         __LINE__, num_ongoing_jobs);
       continue;
@@ -1799,6 +2058,19 @@ int32_t mm_jpeg_init(mm_jpeg_obj *my_obj)
 
   my_obj->work_buf_cnt = i;
 
+  /* output buffers of auto sized sessions */
+  if (0 != mm_jpeg_out_buf_pool_init(&my_obj->out_pool,
+    my_obj->out_pool_limit)) {
+    for (i = 0; i < initial_workbufs_cnt; i++) {
+      buffer_deallocate(&my_obj->ionBuffer[i]);
+    }
+    mm_jpeg_jobmgr_thread_release(my_obj);
+    mm_jpeg_queue_deinit(&my_obj->ongoing_job_q);
+    pthread_mutex_destroy(&my_obj->job_lock);
+    CDBG_ERROR("%s:%d] Output pool init failed", __func__, __LINE__);
+    return -1;
+  }
+
   /* load OMX */
   if (OMX_ErrorNone != OMX_Init()) {
     /* roll back in error case */
@@ -1806,6 +2078,7 @@ int32_t mm_jpeg_init(mm_jpeg_obj *my_obj)
     for (i = 0; i < initial_workbufs_cnt; i++) {
       buffer_deallocate(&my_obj->ionBuffer[i]);
     }
+    mm_jpeg_out_buf_pool_deinit(&my_obj->out_pool);
     mm_jpeg_jobmgr_thread_release(my_obj);
     mm_jpeg_queue_deinit(&my_obj->ongoing_job_q);
     pthread_mutex_destroy(&my_obj->job_lock);
@@ -1863,6 +2136,9 @@ int32_t mm_jpeg_deinit(mm_jpeg_obj *my_obj)
     }
   }
 
+  /* buffers still held by clients are freed on release */
+  mm_jpeg_out_buf_pool_deinit(&my_obj->out_pool);
+
   /* destroy locks */
   pthread_mutex_destroy(&my_obj->job_lock);
 
@@ -1992,7 +2268,11 @@ int32_t mm_jpeg_start_job(mm_jpeg_obj *my_obj,
 
 
 
-  rc = mm_jpeg_queue_enq(&my_obj->job_mgr.job_queue, node);
+  if (p_jobparams->high_priority) {
+    rc = mm_jpeg_queue_enq_head(&my_obj->job_mgr.job_queue, node);
+  } else {
+    rc = mm_jpeg_queue_enq(&my_obj->job_mgr.job_queue, node);
+  }
   if (0 == rc) {
       cam_sem_post(&my_obj->job_mgr.job_sem);
   }
@@ -2135,6 +2415,16 @@ int32_t mm_jpeg_create_session(mm_jpeg_obj *my_obj,
     return -1;
   }
 
+  /* reuse a warm session bound to the same buffers and settings */
+  p_session = mm_jpeg_session_cache_lookup(my_obj, clnt_idx, p_params);
+  if (NULL != p_session) {
+    *p_session_id = p_session->sessionId;
+    mm_jpeg_session_out_mem_open(my_obj, p_session);
+    CDBG_HIGH("%s:%d] [KPI Perf] reuse cached session %x", __func__, __LINE__,
+      *p_session_id);
+    return 0;
+  }
+
   num_omx_sessions = 1;
   if (p_params->burst_mode) {
     num_omx_sessions = MM_JPEG_CONCURRENT_SESSIONS_COUNT;
@@ -2234,6 +2524,9 @@ int32_t mm_jpeg_create_session(mm_jpeg_obj *my_obj,
     p_session->sessionId = session_id;
     p_session->session_handle_q = p_session_handle_q;
     p_session->out_buf_q = p_out_buf_q;
+    p_session->auto_size = ((p_params->num_dst_bufs > 0) &&
+      (NULL == p_params->dest_buf[0].buf_vaddr) &&
+      (NULL == p_params->get_memory)) ? OMX_TRUE : OMX_FALSE;
 
     mm_jpeg_queue_enq(p_session_handle_q, p_session);
 
@@ -2262,6 +2555,11 @@ int32_t mm_jpeg_create_session(mm_jpeg_obj *my_obj,
     mm_jpeg_queue_enq(p_out_buf_q, (void *)(i+1));
   }
 
+  p_session = mm_jpeg_get_session(my_obj, *p_session_id);
+  if (NULL != p_session) {
+    mm_jpeg_session_out_mem_open(my_obj, p_session);
+  }
+
   return rc;
 }
 
@@ -2293,6 +2591,9 @@ static int32_t mm_jpegenc_destroy_job(mm_jpeg_job_session_t *p_session)
   }
   p_session->exif_count_local = 0;
 
+  /* output not delivered to the client */
+  mm_jpeg_session_put_out_buf(p_session);
+
   return rc;
 }
 
@@ -2490,9 +2791,381 @@ int32_t mm_jpeg_destroy_session_by_id(mm_jpeg_obj *my_obj, uint32_t session_id)
 {
   mm_jpeg_job_session_t *p_session = mm_jpeg_get_session(my_obj, session_id);
 
+  if (NULL != p_session) {
+    mm_jpeg_session_out_mem_report(my_obj, p_session);
+  }
+
+  if ((NULL != p_session) &&
+    (OMX_TRUE == mm_jpeg_session_cache_park(my_obj, p_session))) {
+    return 0;
+  }
+
   return mm_jpeg_destroy_session(my_obj, p_session);
 }
 
+/** mm_jpeg_session_params_match:
+ *
+ *  Arguments:
+ *    @p_a: encode params of the cached session
+ *    @p_b: requested encode params
+ *
+ *  Return:
+ *       OMX_TRUE if a session configured with p_a can serve p_b
+ *
+ *  Description:
+ *       OMX ports are configured and the buffers are registered
+ *       at session creation, so besides dimension, format,
+ *       rotation, quality and burst mode the buffers must match.
+ *       fd and address alone do not identify a buffer once it is
+ *       freed, so the client buffer generation has to match too.
+ *
+ **/
+static OMX_BOOL mm_jpeg_session_params_match(mm_jpeg_encode_params_t *p_a,
+  mm_jpeg_encode_params_t *p_b)
+{
+  uint32_t i;
+
+  if ((0 == p_a->buf_generation) ||
+    (p_a->buf_generation != p_b->buf_generation) ||
+    (p_a->num_src_bufs != p_b->num_src_bufs) ||
+    (p_a->num_tmb_bufs != p_b->num_tmb_bufs) ||
+    (p_a->num_dst_bufs != p_b->num_dst_bufs) ||
+    (p_a->encode_thumbnail != p_b->encode_thumbnail) ||
+    (p_a->color_format != p_b->color_format) ||
+    (p_a->thumb_color_format != p_b->thumb_color_format) ||
+    (p_a->quality != p_b->quality) ||
+    (p_a->thumb_quality != p_b->thumb_quality) ||
+    (p_a->rotation != p_b->rotation) ||
+    (p_a->thumb_rotation != p_b->thumb_rotation) ||
+    (p_a->burst_mode != p_b->burst_mode) ||
+    ((NULL == p_a->jpeg_chunk_cb) != (NULL == p_b->jpeg_chunk_cb)) ||
+    memcmp(&p_a->main_dim, &p_b->main_dim, sizeof(mm_jpeg_dim_t)) ||
+    memcmp(&p_a->thumb_dim, &p_b->thumb_dim, sizeof(mm_jpeg_dim_t))) {
+    return OMX_FALSE;
+  }
+
+  for (i = 0; i < p_a->num_src_bufs; i++) {
+    if ((p_a->src_main_buf[i].fd != p_b->src_main_buf[i].fd) ||
+      (p_a->src_main_buf[i].buf_vaddr != p_b->src_main_buf[i].buf_vaddr) ||
+      (p_a->src_main_buf[i].buf_size != p_b->src_main_buf[i].buf_size)) {
+      return OMX_FALSE;
+    }
+  }
+  for (i = 0; i < p_a->num_tmb_bufs; i++) {
+    if ((p_a->src_thumb_buf[i].fd != p_b->src_thumb_buf[i].fd) ||
+      (p_a->src_thumb_buf[i].buf_vaddr != p_b->src_thumb_buf[i].buf_vaddr) ||
+      (p_a->src_thumb_buf[i].buf_size != p_b->src_thumb_buf[i].buf_size)) {
+      return OMX_FALSE;
+    }
+  }
+  for (i = 0; i < p_a->num_dst_bufs; i++) {
+    if ((p_a->dest_buf[i].fd != p_b->dest_buf[i].fd) ||
+      (p_a->dest_buf[i].buf_vaddr != p_b->dest_buf[i].buf_vaddr) ||
+      (p_a->dest_buf[i].buf_size != p_b->dest_buf[i].buf_size)) {
+      return OMX_FALSE;
+    }
+  }
+  return OMX_TRUE;
+}
+
+/** mm_jpeg_session_cache_lookup:
+ *
+ *  Arguments:
+ *    @my_obj: jpeg object
+ *    @clnt_idx: client index
+ *    @p_params: requested encode params
+ *
+ *  Return:
+ *       warm session ready for use, NULL if none matches
+ *
+ *  Description:
+ *       Take a matching session out of the cache. Callbacks and
+ *       userdata are refreshed from the new params and the output
+ *       buffer queue is refilled.
+ *
+ **/
+static mm_jpeg_job_session_t *mm_jpeg_session_cache_lookup(mm_jpeg_obj *my_obj,
+  uint8_t clnt_idx, mm_jpeg_encode_params_t *p_params)
+{
+  mm_jpeg_job_session_t *p_session = NULL;
+  mm_jpeg_job_session_t *p_cur_sess;
+  uint32_t i;
+
+  pthread_mutex_lock(&my_obj->job_lock);
+  for (i = 0; i < MM_JPEG_MAX_SESSION; i++) {
+    p_cur_sess = &my_obj->clnt_mgr[clnt_idx].session[i];
+    if ((OMX_TRUE == p_cur_sess->active) &&
+      (OMX_TRUE == p_cur_sess->cached) &&
+      (OMX_TRUE == mm_jpeg_session_params_match(&p_cur_sess->params,
+      p_params))) {
+      p_session = p_cur_sess;
+      break;
+    }
+  }
+
+  if (NULL != p_session) {
+    p_session->cached = OMX_FALSE;
+    p_cur_sess = p_session;
+    do {
+      p_cur_sess->params = *p_params;
+    } while (NULL != (p_cur_sess = p_cur_sess->next_session));
+
+    while (NULL != mm_jpeg_queue_deq(p_session->out_buf_q))
+      ;
+    for (i = 0; i < p_params->num_dst_bufs; i++) {
+      mm_jpeg_queue_enq(p_session->out_buf_q, (void *)(i+1));
+    }
+  }
+  pthread_mutex_unlock(&my_obj->job_lock);
+
+  return p_session;
+}
+
+/** mm_jpeg_session_cache_park:
+ *
+ *  Arguments:
+ *    @my_obj: jpeg object
+ *    @p_session: session released by the client
+ *
+ *  Return:
+ *       OMX_TRUE if the session was kept warm, OMX_FALSE if the
+ *       caller has to destroy it
+ *
+ *  Description:
+ *       Drop the pending jobs of the session and keep it in
+ *       executing state for a later create_session with the same
+ *       params. The least recently parked session of the client is
+ *       destroyed when the cache is full.
+ *
+ **/
+static OMX_BOOL mm_jpeg_session_cache_park(mm_jpeg_obj *my_obj,
+  mm_jpeg_job_session_t *p_session)
+{
+  mm_jpeg_job_session_t *p_cur_sess;
+  mm_jpeg_job_session_t *p_evict = NULL;
+  mm_jpeg_job_q_node_t *node = NULL;
+  OMX_STATETYPE state;
+  uint32_t num_cached = 0;
+  uint8_t clnt_idx;
+  int i;
+
+  if ((0 == my_obj->session_cache_size) ||
+    (0 == p_session->params.buf_generation) ||
+    (OMX_TRUE != p_session->active) ||
+    (OMX_TRUE == p_session->cached)) {
+    return OMX_FALSE;
+  }
+
+  pthread_mutex_lock(&my_obj->job_lock);
+
+  node = mm_jpeg_queue_remove_job_by_session_id(&my_obj->job_mgr.job_queue,
+    p_session->sessionId);
+  while (NULL != node) {
+    free(node);
+    node = mm_jpeg_queue_remove_job_by_session_id(&my_obj->job_mgr.job_queue,
+      p_session->sessionId);
+  }
+
+  /* a session with an encode in flight goes back to idle on abort */
+  p_cur_sess = p_session;
+  do {
+    if ((OMX_TRUE == p_cur_sess->encoding) ||
+      (OMX_ErrorNone != p_cur_sess->error_flag) ||
+      (OMX_ErrorNone != OMX_GetState(p_cur_sess->omx_handle, &state)) ||
+      (OMX_StateExecuting != state)) {
+      pthread_mutex_unlock(&my_obj->job_lock);
+      return OMX_FALSE;
+    }
+  } while (NULL != (p_cur_sess = p_cur_sess->next_session));
+
+  p_session->cached = OMX_TRUE;
+  p_session->cache_seq = ++my_obj->cache_seq;
+
+  clnt_idx = GET_CLIENT_IDX(p_session->sessionId);
+  for (i = 0; i < MM_JPEG_MAX_SESSION; i++) {
+    p_cur_sess = &my_obj->clnt_mgr[clnt_idx].session[i];
+    if ((OMX_TRUE == p_cur_sess->active) &&
+      (OMX_TRUE == p_cur_sess->cached)) {
+      num_cached++;
+      if ((NULL == p_evict) || (p_cur_sess->cache_seq < p_evict->cache_seq)) {
+        p_evict = p_cur_sess;
+      }
+    }
+  }
+  if (num_cached <= my_obj->session_cache_size) {
+    p_evict = NULL;
+  } else {
+    p_evict->cached = OMX_FALSE;
+  }
+  pthread_mutex_unlock(&my_obj->job_lock);
+
+  CDBG_HIGH("%s:%d] session %x cached, evict %x", __func__, __LINE__,
+    p_session->sessionId, (NULL != p_evict) ? p_evict->sessionId : 0);
+  if (NULL != p_evict) {
+    mm_jpeg_destroy_session(my_obj, p_evict);
+  }
+
+  return OMX_TRUE;
+}
+
+/** mm_jpeg_session_cache_evict:
+ *
+ *  Arguments:
+ *    @my_obj: jpeg object
+ *
+ *  Return:
+ *       OMX_TRUE if a session was destroyed, OMX_FALSE if nothing
+ *       is cached
+ *
+ *  Description:
+ *       Destroy the least recently parked session of any client,
+ *       so that its OMX component instance can be reused.
+ *
+ **/
+static OMX_BOOL mm_jpeg_session_cache_evict(mm_jpeg_obj *my_obj)
+{
+  mm_jpeg_job_session_t *p_cur_sess;
+  mm_jpeg_job_session_t *p_evict = NULL;
+  int i, j;
+
+  pthread_mutex_lock(&my_obj->job_lock);
+  for (i = 0; i < MAX_JPEG_CLIENT_NUM; i++) {
+    for (j = 0; j < MM_JPEG_MAX_SESSION; j++) {
+      p_cur_sess = &my_obj->clnt_mgr[i].session[j];
+      if ((OMX_TRUE == p_cur_sess->active) &&
+        (OMX_TRUE == p_cur_sess->cached) &&
+        ((NULL == p_evict) || (p_cur_sess->cache_seq < p_evict->cache_seq))) {
+        p_evict = p_cur_sess;
+      }
+    }
+  }
+  if (NULL != p_evict) {
+    p_evict->cached = OMX_FALSE;
+  }
+  pthread_mutex_unlock(&my_obj->job_lock);
+
+  if (NULL == p_evict) {
+    return OMX_FALSE;
+  }
+  CDBG_HIGH("%s:%d] evict cached session %x", __func__, __LINE__,
+    p_evict->sessionId);
+  mm_jpeg_destroy_session(my_obj, p_evict);
+  return OMX_TRUE;
+}
+
+/** mm_jpeg_prewarm_session:
+ *
+ *  Arguments:
+ *    @my_obj: jpeg object
+ *    @client_hdl: client handle
+ *    @p_params: encode params expected by the next capture
+ *
+ *  Return:
+ *       0 for success else failure
+ *
+ *  Description:
+ *       Create a session ahead of the capture and park it in the
+ *       session cache, so the create_session issued by the first
+ *       encode finds it warm.
+ *
+ **/
+int32_t mm_jpeg_prewarm_session(mm_jpeg_obj *my_obj,
+  uint32_t client_hdl,
+  mm_jpeg_encode_params_t *p_params)
+{
+  int32_t rc = 0;
+  uint32_t session_id = 0;
+  mm_jpeg_job_session_t *p_session = NULL;
+
+  if (0 == my_obj->session_cache_size) {
+    CDBG("%s:%d] session cache disabled", __func__, __LINE__);
+    return -1;
+  }
+
+  rc = mm_jpeg_create_session(my_obj, client_hdl, p_params, &session_id);
+  if ((0 != rc) || (0 == session_id)) {
+    CDBG_ERROR("%s:%d] prewarm session create failed", __func__, __LINE__);
+    return -1;
+  }
+
+  p_session = mm_jpeg_get_session(my_obj, session_id);
+  if ((NULL == p_session) ||
+    (OMX_TRUE != mm_jpeg_session_cache_park(my_obj, p_session))) {
+    mm_jpeg_destroy_session(my_obj, p_session);
+    return -1;
+  }
+
+  return rc;
+}
+
+/** mm_jpeg_flush_session_cache:
+ *
+ *  Arguments:
+ *    @my_obj: jpeg object
+ *    @client_hdl: client handle
+ *
+ *  Return:
+ *       0 for success else failure
+ *
+ *  Description:
+ *       Destroy the sessions kept warm for the client. Called
+ *       when the buffers bound to them are freed and on close.
+ *
+ **/
+int32_t mm_jpeg_flush_session_cache(mm_jpeg_obj *my_obj,
+  uint32_t client_hdl)
+{
+  mm_jpeg_job_session_t *p_session;
+  uint8_t clnt_idx = 0;
+  int i;
+
+  clnt_idx = mm_jpeg_util_get_index_by_handler(client_hdl);
+  if (clnt_idx >= MAX_JPEG_CLIENT_NUM) {
+    CDBG_ERROR("%s: invalid client with handler (%d)", __func__, client_hdl);
+    return -1;
+  }
+
+  for (i = 0; i < MM_JPEG_MAX_SESSION; i++) {
+    p_session = &my_obj->clnt_mgr[clnt_idx].session[i];
+    pthread_mutex_lock(&my_obj->job_lock);
+    if ((OMX_TRUE != p_session->active) || (OMX_TRUE != p_session->cached)) {
+      pthread_mutex_unlock(&my_obj->job_lock);
+      continue;
+    }
+    p_session->cached = OMX_FALSE;
+    pthread_mutex_unlock(&my_obj->job_lock);
+    mm_jpeg_destroy_session(my_obj, p_session);
+  }
+  return 0;
+}
+
+/** mm_jpeg_release_out_buf:
+ *
+ *  Arguments:
+ *    @my_obj: jpeg object
+ *    @p_buf: output of an auto sized session
+ *
+ *  Return:
+ *       0 for success else failure
+ *
+ *  Description:
+ *       Give an output buffer back to the pool. Jobs waiting for
+ *       output memory are retried
+ *
+ **/
+int32_t mm_jpeg_release_out_buf(mm_jpeg_obj *my_obj, uint8_t *p_buf)
+{
+  int rc = mm_jpeg_out_buf_release(&my_obj->out_pool, p_buf);
+
+  if (rc < 0) {
+    return -1;
+  }
+  if (rc > 0) {
+    cam_sem_post(&my_obj->job_mgr.job_sem);
+  }
+  return 0;
+}
+
 
 
 /** mm_jpeg_close:
@@ -2525,6 +3198,9 @@ int32_t mm_jpeg_close(mm_jpeg_obj *my_obj, uint32_t client_hdl)
 
   CDBG("%s:%d] E", __func__, __LINE__);
 
+  /* release sessions kept warm for the client */
+  mm_jpeg_flush_session_cache(my_obj, client_hdl);
+
   /* abort all jobs from the client */
   pthread_mutex_lock(&my_obj->job_lock);
 
@@ -2571,15 +3247,81 @@ OMX_ERRORTYPE mm_jpeg_ebd(OMX_HANDLETYPE hComponent,
   return 0;
 }
 
+/** mm_jpeg_get_time_us:
+ *
+ *  Arguments:
+ *
+ *  Return:
+ *       monotonic time in microseconds
+ *
+ *  Description:
+ *       Time base for the encode latency logs
+ *
+ **/
+static uint64_t mm_jpeg_get_time_us(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+/** mm_jpeg_deliver_chunk:
+ *
+ *  Arguments:
+ *    @p_session: job session
+ *    @pBuffer: output buffer returned by the component
+ *
+ *  Return:
+ *       None
+ *
+ *  Description:
+ *       Pass the bytes added to the output buffer since the
+ *       last chunk to the client. Called with session lock held
+ *
+ **/
+static void mm_jpeg_deliver_chunk(mm_jpeg_job_session_t *p_session,
+  OMX_BUFFERHEADERTYPE *pBuffer)
+{
+  mm_jpeg_output_t chunk;
+  uint32_t filled_len = (uint32_t)pBuffer->nFilledLen;
+
+  if (filled_len <= p_session->stream_offset) {
+    return;
+  }
+
+  if (0 == p_session->stream_chunks) {
+    CDBG_HIGH("[KPI Perf] %s: job %x time to first byte %llu us", __func__,
+      p_session->jobId,
+      mm_jpeg_get_time_us() - p_session->encode_start_us);
+  }
+
+  chunk.buf_vaddr = pBuffer->pBuffer + p_session->stream_offset;
+  chunk.fd = 0;
+  chunk.buf_filled_len = filled_len - p_session->stream_offset;
+  p_session->params.jpeg_chunk_cb(p_session->client_hdl,
+    p_session->jobId,
+    &chunk,
+    p_session->stream_offset,
+    p_session->params.userdata);
+
+  p_session->stream_offset = filled_len;
+  p_session->stream_chunks++;
+}
+
 OMX_ERRORTYPE mm_jpeg_fbd(OMX_HANDLETYPE hComponent,
   OMX_PTR pAppData,
   OMX_BUFFERHEADERTYPE *pBuffer)
 {
   OMX_ERRORTYPE ret = OMX_ErrorNone;
   mm_jpeg_job_session_t *p_session = (mm_jpeg_job_session_t *) pAppData;
+  mm_jpeg_obj *my_obj = (mm_jpeg_obj *)p_session->jpeg_obj;
   uint32_t i = 0;
   int rc = 0;
   mm_jpeg_output_t output_buf;
+  mm_jpeg_out_buf_t *p_out_buf;
+  omx_jpeg_ouput_buf_t *p_out_desc;
+  cam_dimension_t *p_dim;
   CDBG("%s:%d] count %d ", __func__, __LINE__, p_session->fbd_count);
   CDBG_HIGH("[KPI Perf] : PROFILE_JPEG_FBD");
 
@@ -2591,18 +3333,81 @@ OMX_ERRORTYPE mm_jpeg_fbd(OMX_HANDLETYPE hComponent,
   }
 
   p_session->fbd_count++;
+
+  if ((NULL != p_session->params.jpeg_chunk_cb) &&
+    (NULL == p_session->params.get_memory) &&
+    (OMX_TRUE != p_session->auto_size)) {
+    mm_jpeg_deliver_chunk(p_session, pBuffer);
+
+    if ((OMX_TRUE == p_session->streaming) &&
+      !(pBuffer->nFlags & OMX_BUFFERFLAG_EOS)) {
+      /* more output to come, hand the buffer back */
+      ret = OMX_FillThisBuffer(hComponent, pBuffer);
+      if (OMX_ErrorNone == ret) {
+        pthread_mutex_unlock(&p_session->lock);
+        return ret;
+      }
+      CDBG_ERROR("%s:%d] FillThisBuffer failed %d", __func__, __LINE__, ret);
+      if (NULL != p_session->params.jpeg_cb) {
+        p_session->job_status = JPEG_JOB_STATUS_ERROR;
+        p_session->params.jpeg_cb(p_session->job_status,
+          p_session->client_hdl,
+          p_session->jobId,
+          NULL,
+          p_session->params.userdata);
+      }
+      mm_jpegenc_job_done(p_session);
+      pthread_mutex_unlock(&p_session->lock);
+      return ret;
+    }
+
+    CDBG_HIGH("[KPI Perf] %s: job %x streamed %u bytes in %u chunks, %llu us",
+      __func__, p_session->jobId, p_session->stream_offset,
+      p_session->stream_chunks,
+      mm_jpeg_get_time_us() - p_session->encode_start_us);
+  }
+
+  p_session->job_status = JPEG_JOB_STATUS_DONE;
+  output_buf.buf_filled_len = (uint32_t)pBuffer->nFilledLen;
+  output_buf.buf_vaddr = pBuffer->pBuffer;
+  output_buf.fd = 0;
+
+  if (OMX_TRUE == p_session->auto_size) {
+    /* the session reference goes to the client, which drops it
+     * with release_out_buf */
+    p_out_buf = mm_jpeg_out_buf_swap(&my_obj->out_pool,
+      &p_session->p_out_buf, NULL);
+    p_out_desc = (omx_jpeg_ouput_buf_t *)pBuffer->pBuffer;
+    if (0 == output_buf.buf_filled_len) {
+      output_buf.buf_filled_len = (uint32_t)p_out_desc->size;
+    }
+    if (NULL == p_out_buf) {
+      CDBG_ERROR("%s:%d] no output buffer", __func__, __LINE__);
+      p_session->job_status = JPEG_JOB_STATUS_ERROR;
+    } else if (NULL == p_session->params.jpeg_cb) {
+      mm_jpeg_out_buf_unref(p_out_buf);
+    } else {
+      output_buf.buf_vaddr = p_out_buf->vaddr;
+    }
+  }
+
+  /* learn the compression ratio for sizing later outputs */
+  p_dim = &p_session->encode_job.main_dim.dst_dim;
+  if ((JPEG_JOB_STATUS_DONE == p_session->job_status) &&
+    (OMX_TRUE != p_session->streaming)) {
+    mm_jpeg_out_buf_record(&my_obj->out_pool, p_session->params.quality,
+      (uint32_t)(p_dim->width * p_dim->height), output_buf.buf_filled_len);
+  }
+
   if (NULL != p_session->params.jpeg_cb) {
 
-    p_session->job_status = JPEG_JOB_STATUS_DONE;
-    output_buf.buf_filled_len = (uint32_t)pBuffer->nFilledLen;
-    output_buf.buf_vaddr = pBuffer->pBuffer;
-    output_buf.fd = 0;
     CDBG("%s:%d] send jpeg callback %d buf 0x%p len %u JobID %u", __func__, __LINE__,
-      p_session->job_status, pBuffer->pBuffer, pBuffer->nFilledLen, p_session->jobId);
+      p_session->job_status, output_buf.buf_vaddr,
+      output_buf.buf_filled_len, p_session->jobId);
     p_session->params.jpeg_cb(p_session->job_status,
       p_session->client_hdl,
       p_session->jobId,
-      &output_buf,
+      (JPEG_JOB_STATUS_DONE == p_session->job_status) ? &output_buf : NULL,
       p_session->params.userdata);
 
     mm_jpegenc_job_done(p_session);
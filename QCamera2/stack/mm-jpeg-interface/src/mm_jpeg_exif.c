@@ -609,3 +609,265 @@ int process_meta_data(metadata_buffer_t *p_meta, QOMX_EXIF_INFO *exif_info,
   }
   return rc;
 }
+
+/** mm_jpeg_exif_rd16:
+ *
+ *  Arguments:
+ *   @p : ptr to the value
+ *   @le : TIFF byte order is little endian
+ *
+ *  Return     : 16 bit value
+ *
+ *  Description:
+ *       Read a 16 bit TIFF value
+ *
+ **/
+static uint32_t mm_jpeg_exif_rd16(uint8_t *p, int le)
+{
+  return le ? (uint32_t)(p[0] | (p[1] << 8)) : (uint32_t)((p[0] << 8) | p[1]);
+}
+
+/** mm_jpeg_exif_rd32:
+ *
+ *  Arguments:
+ *   @p : ptr to the value
+ *   @le : TIFF byte order is little endian
+ *
+ *  Return     : 32 bit value
+ *
+ *  Description:
+ *       Read a 32 bit TIFF value
+ *
+ **/
+static uint32_t mm_jpeg_exif_rd32(uint8_t *p, int le)
+{
+  return le ? (mm_jpeg_exif_rd16(p, le) | (mm_jpeg_exif_rd16(p + 2, le) << 16)) :
+    ((mm_jpeg_exif_rd16(p, le) << 16) | mm_jpeg_exif_rd16(p + 2, le));
+}
+
+/** mm_jpeg_exif_wr16:
+ *
+ *  Arguments:
+ *   @p : ptr to the destination
+ *   @val : value
+ *   @le : TIFF byte order is little endian
+ *
+ *  Return     : None
+ *
+ *  Description:
+ *       Write a 16 bit TIFF value
+ *
+ **/
+static void mm_jpeg_exif_wr16(uint8_t *p, uint32_t val, int le)
+{
+  p[le ? 0 : 1] = (uint8_t)(val & 0xFF);
+  p[le ? 1 : 0] = (uint8_t)((val >> 8) & 0xFF);
+}
+
+/** mm_jpeg_exif_wr32:
+ *
+ *  Arguments:
+ *   @p : ptr to the destination
+ *   @val : value
+ *   @le : TIFF byte order is little endian
+ *
+ *  Return     : None
+ *
+ *  Description:
+ *       Write a 32 bit TIFF value
+ *
+ **/
+static void mm_jpeg_exif_wr32(uint8_t *p, uint32_t val, int le)
+{
+  mm_jpeg_exif_wr16(p + (le ? 0 : 2), val & 0xFFFF, le);
+  mm_jpeg_exif_wr16(p + (le ? 2 : 0), (val >> 16) & 0xFFFF, le);
+}
+
+/** mm_jpeg_exif_wr_ifd_entry:
+ *
+ *  Arguments:
+ *   @p : ptr to the destination
+ *   @tag : tag number
+ *   @type : EXIF_SHORT or EXIF_LONG
+ *   @val : single value of the tag
+ *   @le : TIFF byte order is little endian
+ *
+ *  Return     : None
+ *
+ *  Description:
+ *       Write a 12 byte IFD entry holding a single value
+ *
+ **/
+static void mm_jpeg_exif_wr_ifd_entry(uint8_t *p, uint32_t tag,
+  uint32_t type, uint32_t val, int le)
+{
+  memset(p, 0, 12);
+  mm_jpeg_exif_wr16(p, tag, le);
+  mm_jpeg_exif_wr16(p + 2, type, le);
+  mm_jpeg_exif_wr32(p + 4, 1, le);
+  if (EXIF_SHORT == type) {
+    mm_jpeg_exif_wr16(p + 8, val, le);
+  } else {
+    mm_jpeg_exif_wr32(p + 8, val, le);
+  }
+}
+
+/** mm_jpeg_exif_insert_thumbnail:
+ *
+ *  Arguments:
+ *   @p_jpeg : jpeg encoded without thumbnail, NULL to only
+ *             query how much longer the jpeg gets
+ *   @jpeg_len : length of p_jpeg
+ *   @p_thumb : thumbnail encoded as separate jpeg
+ *   @thumb_len : length of p_thumb
+ *   @p_out : output buffer, NULL to only query the output length
+ *   @out_size : size of p_out
+ *   @p_out_len : length of the output, or the growth if p_jpeg
+ *                is NULL
+ *
+ *  Return     : int32_t type of status
+ *               0  -- success
+ *              none-zero failure code
+ *
+ *  Description:
+ *       Add a thumbnail to the exif APP1 of a jpeg without
+ *       encoding again. The APP1 of the thumbnail itself is
+ *       dropped, the thumbnail goes in as IFD1 behind the
+ *       existing IFDs. Fails if the jpeg has no exif, already
+ *       has a thumbnail or the APP1 would exceed 64k.
+ *       The growth only depends on the thumbnail, so a client
+ *       can leave that much room ahead of the jpeg and pass
+ *       p_out == p_jpeg - growth. Only the headers are
+ *       rewritten then, the image data stays where it is.
+ *
+ **/
+int32_t mm_jpeg_exif_insert_thumbnail(uint8_t *p_jpeg, uint32_t jpeg_len,
+  uint8_t *p_thumb, uint32_t thumb_len, uint8_t *p_out, uint32_t out_size,
+  uint32_t *p_out_len)
+{
+  uint32_t app1_len, tiff_len, ifd0, num_entries, next_pos;
+  uint32_t pad, ifd1_len, grow, data_len, thumb_skip = 0;
+  uint8_t *p_tiff, *p_ifd1;
+  int le;
+
+  if ((NULL == p_thumb) || (NULL == p_out_len) || (thumb_len < 4)) {
+    return -1;
+  }
+
+  /* the thumbnail goes in as SOI + everything behind its own APP1 */
+  if ((p_thumb[0] != 0xFF) || (p_thumb[1] != 0xD8)) {
+    ALOGE("%s: invalid thumbnail", __func__);
+    return -1;
+  }
+  if ((p_thumb[2] == 0xFF) && (p_thumb[3] == 0xE1)) {
+    thumb_skip = 2 + (uint32_t)((p_thumb[4] << 8) | p_thumb[5]);
+    if (2 + thumb_skip >= thumb_len) {
+      ALOGE("%s: invalid thumbnail APP1", __func__);
+      return -1;
+    }
+  }
+
+  /* IFD1: count, compression, offset, length, next IFD. One byte
+   * aligns IFD1, or follows the thumbnail if IFD1 is aligned already,
+   * so that the growth does not depend on the main image */
+  ifd1_len = 2 + 3 * 12 + 4;
+  data_len = thumb_len - thumb_skip;
+  grow = 1 + ifd1_len + data_len;
+  if (NULL == p_jpeg) {
+    *p_out_len = grow;
+    return 0;
+  }
+
+  /* SOI followed by the exif APP1 */
+  if ((jpeg_len < 20) || (p_jpeg[0] != 0xFF) || (p_jpeg[1] != 0xD8) ||
+    (p_jpeg[2] != 0xFF) || (p_jpeg[3] != 0xE1) ||
+    memcmp(p_jpeg + 6, "Exif\0\0", 6)) {
+    ALOGE("%s: no exif APP1", __func__);
+    return -1;
+  }
+  app1_len = (uint32_t)((p_jpeg[4] << 8) | p_jpeg[5]);
+  if ((app1_len < 16) || (4 + app1_len > jpeg_len)) {
+    ALOGE("%s: invalid APP1 length %d", __func__, app1_len);
+    return -1;
+  }
+  p_tiff = p_jpeg + 12;
+  tiff_len = app1_len - 8;
+
+  if (!memcmp(p_tiff, "II", 2)) {
+    le = 1;
+  } else if (!memcmp(p_tiff, "MM", 2)) {
+    le = 0;
+  } else {
+    ALOGE("%s: invalid TIFF header", __func__);
+    return -1;
+  }
+
+  ifd0 = mm_jpeg_exif_rd32(p_tiff + 4, le);
+  if (ifd0 + 2 > tiff_len) {
+    ALOGE("%s: invalid IFD0 offset %d", __func__, ifd0);
+    return -1;
+  }
+  num_entries = mm_jpeg_exif_rd16(p_tiff + ifd0, le);
+  next_pos = ifd0 + 2 + num_entries * 12;
+  if (next_pos + 4 > tiff_len) {
+    ALOGE("%s: invalid IFD0 with %d entries", __func__, num_entries);
+    return -1;
+  }
+  if (0 != mm_jpeg_exif_rd32(p_tiff + next_pos, le)) {
+    ALOGE("%s: thumbnail present already", __func__);
+    return -1;
+  }
+
+  if (app1_len + grow > 0xFFFF) {
+    ALOGE("%s: thumbnail of %d bytes does not fit exif", __func__,
+      data_len);
+    return -1;
+  }
+
+  *p_out_len = jpeg_len + grow;
+  if (NULL == p_out) {
+    return 0;
+  }
+  if (out_size < *p_out_len) {
+    return -1;
+  }
+  pad = tiff_len & 1;
+
+  /* existing exif first, it may move down within the same buffer */
+  memmove(p_out + 6, p_jpeg + 6, app1_len - 2);
+  /* SOI, APP1 marker and new length */
+  p_out[0] = 0xFF;
+  p_out[1] = 0xD8;
+  p_out[2] = 0xFF;
+  p_out[3] = 0xE1;
+  p_out[4] = (uint8_t)((app1_len + grow) >> 8);
+  p_out[5] = (uint8_t)((app1_len + grow) & 0xFF);
+  /* link IFD0 to IFD1 */
+  mm_jpeg_exif_wr32(p_out + 12 + next_pos, tiff_len + pad, le);
+  if (pad) {
+    p_out[4 + app1_len] = 0;
+  }
+
+  p_ifd1 = p_out + 4 + app1_len + pad;
+  mm_jpeg_exif_wr16(p_ifd1, 3, le);
+  mm_jpeg_exif_wr_ifd_entry(p_ifd1 + 2, 0x0103, EXIF_SHORT, 6, le);
+  mm_jpeg_exif_wr_ifd_entry(p_ifd1 + 14, 0x0201, EXIF_LONG,
+    tiff_len + pad + ifd1_len, le);
+  mm_jpeg_exif_wr_ifd_entry(p_ifd1 + 26, 0x0202, EXIF_LONG, data_len, le);
+  mm_jpeg_exif_wr32(p_ifd1 + 38, 0, le);
+
+  /* thumbnail without its APP1 */
+  memcpy(p_ifd1 + ifd1_len, p_thumb, 2);
+  memcpy(p_ifd1 + ifd1_len + 2, p_thumb + 2 + thumb_skip, data_len - 2);
+  if (!pad) {
+    p_ifd1[ifd1_len + data_len] = 0;
+  }
+
+  /* rest of the main image, in place already when spliced */
+  if (p_out + grow != p_jpeg) {
+    memcpy(p_out + 4 + app1_len + grow, p_jpeg + 4 + app1_len,
+      jpeg_len - 4 - app1_len);
+  }
+
+  return 0;
+}
@@ -197,6 +197,110 @@ static int32_t mm_jpeg_intf_destroy_session(uint32_t session_id)
   return rc;
 }
 
+/** mm_jpeg_intf_prewarm_session:
+ *
+ *  Arguments:
+ *    @client_hdl: client handle
+ *    @p_params: encode parameters
+ *
+ *  Return:
+ *       0 success, failure otherwise
+ *
+ *  Description:
+ *       Create a jpeg session and keep it warm in the session cache
+ *
+ **/
+static int32_t mm_jpeg_intf_prewarm_session(uint32_t client_hdl,
+    mm_jpeg_encode_params_t *p_params)
+{
+  int32_t rc = -1;
+
+  if (0 == client_hdl || NULL == p_params) {
+    CDBG_ERROR("%s:%d] invalid client_hdl or params", __func__, __LINE__);
+    return rc;
+  }
+
+  pthread_mutex_lock(&g_intf_lock);
+  if (NULL == g_jpeg_obj) {
+    /* mm_jpeg obj not exists, return error */
+    CDBG_ERROR("%s:%d] mm_jpeg is not opened yet", __func__, __LINE__);
+    pthread_mutex_unlock(&g_intf_lock);
+    return rc;
+  }
+
+  rc = mm_jpeg_prewarm_session(g_jpeg_obj, client_hdl, p_params);
+  pthread_mutex_unlock(&g_intf_lock);
+  return rc;
+}
+
+/** mm_jpeg_intf_release_out_buf:
+ *
+ *  Arguments:
+ *    @p_buf: output buffer passed in the jpeg callback
+ *
+ *  Return:
+ *       0 success, failure otherwise
+ *
+ *  Description:
+ *       Release the output of an auto sized session
+ *
+ **/
+static int32_t mm_jpeg_intf_release_out_buf(uint8_t *p_buf)
+{
+  int32_t rc = -1;
+
+  if (NULL == p_buf) {
+    CDBG_ERROR("%s:%d] invalid buffer", __func__, __LINE__);
+    return rc;
+  }
+
+  pthread_mutex_lock(&g_intf_lock);
+  if (NULL == g_jpeg_obj) {
+    /* mm_jpeg was closed while the client held the buffer */
+    rc = (mm_jpeg_out_buf_release(NULL, p_buf) < 0) ? -1 : 0;
+    pthread_mutex_unlock(&g_intf_lock);
+    return rc;
+  }
+
+  rc = mm_jpeg_release_out_buf(g_jpeg_obj, p_buf);
+  pthread_mutex_unlock(&g_intf_lock);
+  return rc;
+}
+
+/** mm_jpeg_intf_flush_session_cache:
+ *
+ *  Arguments:
+ *    @client_hdl: client handle
+ *
+ *  Return:
+ *       0 success, failure otherwise
+ *
+ *  Description:
+ *       Release the jpeg sessions kept warm for the client
+ *
+ **/
+static int32_t mm_jpeg_intf_flush_session_cache(uint32_t client_hdl)
+{
+  int32_t rc = -1;
+
+  if (0 == client_hdl) {
+    CDBG_ERROR("%s:%d] invalid client_hdl", __func__, __LINE__);
+    return rc;
+  }
+
+  pthread_mutex_lock(&g_intf_lock);
+  if (NULL == g_jpeg_obj) {
+    /* mm_jpeg obj not exists, return error */
+    CDBG_ERROR("%s:%d] mm_jpeg is not opened yet", __func__, __LINE__);
+    pthread_mutex_unlock(&g_intf_lock);
+    return rc;
+  }
+
+  rc = mm_jpeg_flush_session_cache(g_jpeg_obj, client_hdl);
+  pthread_mutex_unlock(&g_intf_lock);
+  return rc;
+}
+
 /** mm_jpeg_intf_abort_job:
  *
  *  Arguments:
@@ -314,6 +418,24 @@ uint32_t jpeg_open(mm_jpeg_ops_t *ops, mm_dimension picture_size)
     jpeg_obj->max_pic_w = picture_size.w;
     jpeg_obj->max_pic_h = picture_size.h;
 
+    /* idle sessions kept warm per client for reuse. Off by default, a
+     * parked session holds a hw encoder instance and a work buffer */
+    property_get("persist.camera.jpeg.sesscache", prop, "0");
+    jpeg_obj->session_cache_size = atoi(prop);
+
+    /* 0 - hardware only, 1 - software if hardware is unavailable,
+     * 2 - software only. The software encoder is several times slower,
+     * so it is only used when asked for */
+    property_get("persist.camera.jpeg.swenc", prop, "0");
+    jpeg_obj->sw_enc_mode = atoi(prop);
+
+    /* output memory in MB of auto sized sessions before new jobs
+     * wait for the client to release buffers, 0 for no limit */
+    property_get("persist.camera.jpeg.outpool", prop, "64");
+    jpeg_obj->out_pool_limit = (uint32_t)atoi(prop) * 1024 * 1024;
+
+    jpeg_obj->max_ongoing_jobs = NUM_MAX_JPEG_CNCURRENT_JOBS;
+
     rc = mm_jpeg_init(jpeg_obj);
     if(0 != rc) {
       CDBG_ERROR("%s:%d] mm_jpeg_init err = %d", __func__, __LINE__, rc);
@@ -336,6 +458,10 @@ uint32_t jpeg_open(mm_jpeg_ops_t *ops, mm_dimension picture_size)
       ops->abort_job = mm_jpeg_intf_abort_job;
       ops->create_session = mm_jpeg_intf_create_session;
       ops->destroy_session = mm_jpeg_intf_destroy_session;
+      ops->prewarm_session = mm_jpeg_intf_prewarm_session;
+      ops->flush_session_cache = mm_jpeg_intf_flush_session_cache;
+      ops->insert_thumbnail = mm_jpeg_exif_insert_thumbnail;
+      ops->release_out_buf = mm_jpeg_intf_release_out_buf;
       ops->close = mm_jpeg_intf_close;
     }
   } else {
@@ -0,0 +1,543 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "mm_jpeg_outbuf.h"
+#include "mm_jpeg_dbg.h"
+
+#define MM_JPEG_OUT_BUF_MAGIC 0x4a4f4246
+
+/* headroom over the estimate for the headers and content variation */
+#define MM_JPEG_OUT_BUF_HDR_BYTES (64 * 1024)
+
+/* data starts at a cache line boundary */
+#define MM_JPEG_OUT_BUF_HDR_SIZE \
+  ((sizeof(mm_jpeg_out_buf_t) + 63) & ~((size_t)63))
+
+/* initial output bytes per pixel for each quality bucket */
+static const float g_def_bpp[MM_JPEG_OUT_BUF_NUM_QBUCKETS] = {
+  0.06f, 0.08f, 0.10f, 0.12f, 0.14f, 0.17f, 0.21f, 0.27f, 0.36f, 0.55f, 0.55f
+};
+
+static pthread_mutex_t g_pool_id_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t g_pool_id = 0;
+
+/** mm_jpeg_out_buf_class_size:
+ *
+ *  Arguments:
+ *     @idx: size class
+ *
+ *  Return:
+ *     size of the class
+ *
+ *  Description:
+ *      Class sizes alternate between powers of two and 1.5 times
+ *      powers of two
+ *
+ **/
+static uint32_t mm_jpeg_out_buf_class_size(uint32_t idx)
+{
+  uint32_t size = MM_JPEG_OUT_BUF_MIN_SIZE << (idx >> 1);
+  return (idx & 1) ? size + (size >> 1) : size;
+}
+
+/** mm_jpeg_out_buf_class:
+ *
+ *  Arguments:
+ *     @size: bytes needed
+ *
+ *  Return:
+ *     smallest class holding size, MM_JPEG_OUT_BUF_NUM_CLASSES if
+ *     none does
+ *
+ *  Description:
+ *      Map a size to its class
+ *
+ **/
+static uint32_t mm_jpeg_out_buf_class(uint32_t size)
+{
+  uint32_t i;
+  for (i = 0; i < MM_JPEG_OUT_BUF_NUM_CLASSES; i++) {
+    if (size <= mm_jpeg_out_buf_class_size(i))
+      break;
+  }
+  return i;
+}
+
+/** mm_jpeg_out_buf_charge:
+ *
+ *  Arguments:
+ *     @p_buf: buffer
+ *     @p_stats: accounting to charge, can be NULL
+ *
+ *  Return:
+ *     none
+ *
+ *  Description:
+ *      Account a buffer to a session. Called with the pool lock
+ *
+ **/
+static void mm_jpeg_out_buf_charge(mm_jpeg_out_buf_t *p_buf,
+  mm_jpeg_out_buf_stats_t *p_stats)
+{
+  p_buf->p_stats = p_stats;
+  p_buf->owner_id = 0;
+  if ((NULL != p_stats) && (0 != p_stats->owner_id)) {
+    p_buf->owner_id = p_stats->owner_id;
+    p_stats->cur_bytes += p_buf->size;
+    if (p_stats->cur_bytes > p_stats->peak_bytes)
+      p_stats->peak_bytes = p_stats->cur_bytes;
+  }
+}
+
+/** mm_jpeg_out_buf_pool_init:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @used_limit: memory in use above which new jobs wait, 0 for
+ *                no limit
+ *
+ *  Return:
+ *     0 for success else failure
+ *
+ *  Description:
+ *      Initialize the output buffer pool. Up to half of the limit
+ *      is kept in the free lists
+ *
+ **/
+int mm_jpeg_out_buf_pool_init(mm_jpeg_out_buf_pool_t *p_pool,
+  uint32_t used_limit)
+{
+  memset(p_pool, 0x0, sizeof(mm_jpeg_out_buf_pool_t));
+  if (pthread_mutex_init(&p_pool->lock, NULL)) {
+    CDBG_ERROR("%s:%d] mutex init failed", __func__, __LINE__);
+    return -1;
+  }
+
+  pthread_mutex_lock(&g_pool_id_lock);
+  p_pool->id = ++g_pool_id;
+  if (0 == p_pool->id)
+    p_pool->id = ++g_pool_id;
+  pthread_mutex_unlock(&g_pool_id_lock);
+
+  p_pool->used_limit = used_limit;
+  p_pool->free_limit = used_limit / 2;
+  memcpy(p_pool->bpp, g_def_bpp, sizeof(p_pool->bpp));
+  return 0;
+}
+
+/** mm_jpeg_out_buf_pool_deinit:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *
+ *  Return:
+ *     none
+ *
+ *  Description:
+ *      Free the pooled buffers. Buffers still held by clients are
+ *      freed directly when released
+ *
+ **/
+void mm_jpeg_out_buf_pool_deinit(mm_jpeg_out_buf_pool_t *p_pool)
+{
+  uint32_t i;
+  mm_jpeg_out_buf_t *p_buf;
+
+  pthread_mutex_lock(&p_pool->lock);
+  for (i = 0; i < MM_JPEG_OUT_BUF_NUM_CLASSES; i++) {
+    while (NULL != p_pool->free_list[i]) {
+      p_buf = p_pool->free_list[i];
+      p_pool->free_list[i] = p_buf->next;
+      p_buf->magic = 0;
+      free(p_buf);
+    }
+  }
+  CDBG_HIGH("%s:%d] [KPI Perf] outstanding %d peak %d", __func__, __LINE__,
+    p_pool->used_bytes, p_pool->peak_bytes);
+  p_pool->free_bytes = 0;
+  pthread_mutex_unlock(&p_pool->lock);
+  pthread_mutex_destroy(&p_pool->lock);
+}
+
+/** mm_jpeg_out_buf_get:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @size: bytes needed
+ *     @p_stats: accounting to charge, can be NULL
+ *
+ *  Return:
+ *     buffer with one reference, NULL on failure
+ *
+ *  Description:
+ *      Get a buffer of at least size bytes. A free buffer of the
+ *      matching class or the next larger one is reused before
+ *      allocating
+ *
+ **/
+mm_jpeg_out_buf_t *mm_jpeg_out_buf_get(mm_jpeg_out_buf_pool_t *p_pool,
+  uint32_t size, mm_jpeg_out_buf_stats_t *p_stats)
+{
+  uint32_t idx = mm_jpeg_out_buf_class(size);
+  uint32_t i;
+  uint32_t alloc_size;
+  mm_jpeg_out_buf_t *p_buf = NULL;
+
+  pthread_mutex_lock(&p_pool->lock);
+  for (i = idx; (i < MM_JPEG_OUT_BUF_NUM_CLASSES) && (i <= idx + 1); i++) {
+    if (NULL != p_pool->free_list[i]) {
+      p_buf = p_pool->free_list[i];
+      p_pool->free_list[i] = p_buf->next;
+      p_pool->free_bytes -= p_buf->size;
+      break;
+    }
+  }
+  if (NULL != p_buf) {
+    if (NULL != p_stats)
+      p_stats->num_reused++;
+  } else {
+    pthread_mutex_unlock(&p_pool->lock);
+    alloc_size = (idx < MM_JPEG_OUT_BUF_NUM_CLASSES) ?
+      mm_jpeg_out_buf_class_size(idx) : size;
+    p_buf = malloc(MM_JPEG_OUT_BUF_HDR_SIZE + alloc_size);
+    if (NULL == p_buf) {
+      CDBG_ERROR("%s:%d] cannot allocate %d bytes", __func__, __LINE__,
+        alloc_size);
+      return NULL;
+    }
+    memset(p_buf, 0x0, sizeof(mm_jpeg_out_buf_t));
+    p_buf->magic = MM_JPEG_OUT_BUF_MAGIC;
+    p_buf->pool_id = p_pool->id;
+    p_buf->p_pool = p_pool;
+    p_buf->size = alloc_size;
+    p_buf->class_idx = idx;
+    p_buf->vaddr = (uint8_t *)p_buf + MM_JPEG_OUT_BUF_HDR_SIZE;
+    pthread_mutex_lock(&p_pool->lock);
+    if (NULL != p_stats)
+      p_stats->num_allocs++;
+  }
+
+  p_buf->next = NULL;
+  p_buf->ref_count = 1;
+  mm_jpeg_out_buf_charge(p_buf, p_stats);
+  p_pool->used_bytes += p_buf->size;
+  if (p_pool->used_bytes > p_pool->peak_bytes)
+    p_pool->peak_bytes = p_pool->used_bytes;
+  pthread_mutex_unlock(&p_pool->lock);
+
+  CDBG("%s:%d] size %d class %d buf %p", __func__, __LINE__, size,
+    p_buf->class_idx, p_buf->vaddr);
+  return p_buf;
+}
+
+/** mm_jpeg_out_buf_unref:
+ *
+ *  Arguments:
+ *     @p_buf: buffer
+ *
+ *  Return:
+ *     1 if the last reference was dropped, 0 otherwise
+ *
+ *  Description:
+ *      Drop a reference, the buffer goes back to the pool when
+ *      the last one is dropped. Buffers above the free limit or
+ *      outside the size classes are freed
+ *
+ **/
+int mm_jpeg_out_buf_unref(mm_jpeg_out_buf_t *p_buf)
+{
+  mm_jpeg_out_buf_pool_t *p_pool = p_buf->p_pool;
+  mm_jpeg_out_buf_stats_t *p_stats;
+
+  pthread_mutex_lock(&p_pool->lock);
+  if (--p_buf->ref_count > 0) {
+    pthread_mutex_unlock(&p_pool->lock);
+    return 0;
+  }
+
+  p_stats = p_buf->p_stats;
+  if ((NULL != p_stats) && (0 != p_buf->owner_id) &&
+    (p_stats->owner_id == p_buf->owner_id)) {
+    p_stats->cur_bytes -= p_buf->size;
+  }
+  p_buf->p_stats = NULL;
+  p_pool->used_bytes -= p_buf->size;
+
+  if ((p_buf->class_idx < MM_JPEG_OUT_BUF_NUM_CLASSES) &&
+    (p_pool->free_bytes + p_buf->size <= p_pool->free_limit)) {
+    p_buf->next = p_pool->free_list[p_buf->class_idx];
+    p_pool->free_list[p_buf->class_idx] = p_buf;
+    p_pool->free_bytes += p_buf->size;
+    p_buf = NULL;
+  }
+  pthread_mutex_unlock(&p_pool->lock);
+
+  if (NULL != p_buf) {
+    p_buf->magic = 0;
+    free(p_buf);
+  }
+  return 1;
+}
+
+/** mm_jpeg_out_buf_swap:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @pp_slot: buffer slot
+ *     @p_buf: new buffer, can be NULL
+ *
+ *  Return:
+ *     buffer previously in the slot
+ *
+ *  Description:
+ *      Replace the buffer held in a slot, serialized by the pool
+ *      lock for slots shared between threads
+ *
+ **/
+mm_jpeg_out_buf_t *mm_jpeg_out_buf_swap(mm_jpeg_out_buf_pool_t *p_pool,
+  mm_jpeg_out_buf_t **pp_slot, mm_jpeg_out_buf_t *p_buf)
+{
+  mm_jpeg_out_buf_t *p_old;
+
+  pthread_mutex_lock(&p_pool->lock);
+  p_old = *pp_slot;
+  *pp_slot = p_buf;
+  pthread_mutex_unlock(&p_pool->lock);
+  return p_old;
+}
+
+/** mm_jpeg_out_buf_release:
+ *
+ *  Arguments:
+ *     @p_pool: current pool, NULL if there is none
+ *     @vaddr: buffer data passed to the client
+ *
+ *  Return:
+ *     1 if output memory was freed, 0 if not, -1 if vaddr is not
+ *     a pool buffer
+ *
+ *  Description:
+ *      Drop the client reference of a delivered buffer. Buffers of
+ *      a pool that is gone are freed directly
+ *
+ **/
+int mm_jpeg_out_buf_release(mm_jpeg_out_buf_pool_t *p_pool, uint8_t *vaddr)
+{
+  mm_jpeg_out_buf_t *p_buf;
+
+  if (NULL == vaddr)
+    return -1;
+  p_buf = (mm_jpeg_out_buf_t *)(vaddr - MM_JPEG_OUT_BUF_HDR_SIZE);
+  if ((MM_JPEG_OUT_BUF_MAGIC != p_buf->magic) || (p_buf->vaddr != vaddr)) {
+    CDBG_ERROR("%s:%d] %p is not an output buffer", __func__, __LINE__,
+      vaddr);
+    return -1;
+  }
+
+  if ((NULL != p_pool) && (p_buf->pool_id == p_pool->id))
+    return mm_jpeg_out_buf_unref(p_buf);
+
+  /* the pool was closed while the client held the buffer */
+  p_buf->magic = 0;
+  free(p_buf);
+  return 1;
+}
+
+/** mm_jpeg_out_buf_qbucket:
+ *
+ *  Arguments:
+ *     @quality: jpeg quality
+ *
+ *  Return:
+ *     quality bucket
+ *
+ *  Description:
+ *      Map a quality to its bucket
+ *
+ **/
+static uint32_t mm_jpeg_out_buf_qbucket(uint32_t quality)
+{
+  uint32_t idx = quality / 10;
+  return (idx < MM_JPEG_OUT_BUF_NUM_QBUCKETS) ?
+    idx : MM_JPEG_OUT_BUF_NUM_QBUCKETS - 1;
+}
+
+/** mm_jpeg_out_buf_estimate:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @quality: jpeg quality
+ *     @pixels: output pixels
+ *
+ *  Return:
+ *     expected output size with headroom
+ *
+ *  Description:
+ *      Estimate the output size from the compression ratios seen
+ *      so far at this quality, with 25% margin for scene content
+ *
+ **/
+uint32_t mm_jpeg_out_buf_estimate(mm_jpeg_out_buf_pool_t *p_pool,
+  uint32_t quality, uint32_t pixels)
+{
+  float bpp;
+
+  pthread_mutex_lock(&p_pool->lock);
+  bpp = p_pool->bpp[mm_jpeg_out_buf_qbucket(quality)];
+  pthread_mutex_unlock(&p_pool->lock);
+
+  return (uint32_t)((float)pixels * bpp * 1.25f) + MM_JPEG_OUT_BUF_HDR_BYTES;
+}
+
+/** mm_jpeg_out_buf_record:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @quality: jpeg quality
+ *     @pixels: output pixels
+ *     @len: output size
+ *
+ *  Return:
+ *     none
+ *
+ *  Description:
+ *      Update the compression ratio for the quality. Increases
+ *      are taken right away so that the next estimate covers the
+ *      scene, decreases are averaged in
+ *
+ **/
+void mm_jpeg_out_buf_record(mm_jpeg_out_buf_pool_t *p_pool,
+  uint32_t quality, uint32_t pixels, uint32_t len)
+{
+  float bpp;
+  float *p_bpp;
+
+  if ((0 == pixels) || (0 == len))
+    return;
+
+  bpp = (float)len / (float)pixels;
+  pthread_mutex_lock(&p_pool->lock);
+  p_bpp = &p_pool->bpp[mm_jpeg_out_buf_qbucket(quality)];
+  if (bpp > *p_bpp)
+    *p_bpp = bpp;
+  else
+    *p_bpp += (bpp - *p_bpp) / 4.0f;
+  pthread_mutex_unlock(&p_pool->lock);
+
+  CDBG("%s:%d] quality %d bpp %f", __func__, __LINE__, quality, bpp);
+}
+
+/** mm_jpeg_out_buf_admit:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @size: expected output size
+ *     @p_stats: accounting of the session, can be NULL
+ *
+ *  Return:
+ *     1 if the job can start, 0 if it has to wait for buffers to
+ *     be released
+ *
+ *  Description:
+ *      Check a new job against the memory limit. A job is always
+ *      admitted when its session holds no output memory, so that
+ *      buffers kept by other clients cannot stall it
+ *
+ **/
+int mm_jpeg_out_buf_admit(mm_jpeg_out_buf_pool_t *p_pool, uint32_t size,
+  mm_jpeg_out_buf_stats_t *p_stats)
+{
+  int admit;
+
+  pthread_mutex_lock(&p_pool->lock);
+  admit = (0 == p_pool->used_limit) ||
+    ((NULL != p_stats) && (0 == p_stats->cur_bytes)) ||
+    (p_pool->used_bytes + size <= p_pool->used_limit);
+  if (!admit && (NULL != p_stats))
+    p_stats->num_waits++;
+  pthread_mutex_unlock(&p_pool->lock);
+
+  if (!admit) {
+    CDBG_HIGH("%s:%d] waiting for output memory, used %d need %d",
+      __func__, __LINE__, p_pool->used_bytes, size);
+  }
+  return admit;
+}
+
+/** mm_jpeg_out_buf_stats_open:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @p_stats: accounting of the session
+ *
+ *  Return:
+ *     none
+ *
+ *  Description:
+ *      Reset the session accounting and give it a new owner id
+ *
+ **/
+void mm_jpeg_out_buf_stats_open(mm_jpeg_out_buf_pool_t *p_pool,
+  mm_jpeg_out_buf_stats_t *p_stats)
+{
+  pthread_mutex_lock(&p_pool->lock);
+  memset(p_stats, 0x0, sizeof(mm_jpeg_out_buf_stats_t));
+  if (0 == ++p_pool->owner_seq)
+    ++p_pool->owner_seq;
+  p_stats->owner_id = p_pool->owner_seq;
+  pthread_mutex_unlock(&p_pool->lock);
+}
+
+/** mm_jpeg_out_buf_stats_close:
+ *
+ *  Arguments:
+ *     @p_pool: pool
+ *     @p_stats: accounting of the session
+ *     @p_out: copy of the final stats
+ *
+ *  Return:
+ *     none
+ *
+ *  Description:
+ *      Stop charging the session, buffers it still holds are no
+ *      longer accounted to it
+ *
+ **/
+void mm_jpeg_out_buf_stats_close(mm_jpeg_out_buf_pool_t *p_pool,
+  mm_jpeg_out_buf_stats_t *p_stats, mm_jpeg_out_buf_stats_t *p_out)
+{
+  pthread_mutex_lock(&p_pool->lock);
+  if (NULL != p_out)
+    *p_out = *p_stats;
+  p_stats->owner_id = 0;
+  pthread_mutex_unlock(&p_pool->lock);
+}
@@ -52,6 +52,8 @@ OMX_ERRORTYPE mm_jpegdec_event_handler(OMX_HANDLETYPE hComponent,
     OMX_U32 nData1,
     OMX_U32 nData2,
     OMX_PTR pEventData);
+static OMX_ERRORTYPE mm_jpegdec_session_decode_pipeline(
+  mm_jpeg_job_session_t *p_session);
 
 
 /** mm_jpegdec_destroy_job
@@ -100,13 +102,104 @@ static void mm_jpegdec_job_done(mm_jpeg_job_session_t *p_session)
   if (node) {
     free(node);
   }
-  p_session->encoding = OMX_FALSE;
+  p_session->encoding = p_session->dec_num_active ? OMX_TRUE : OMX_FALSE;
 
   /* wake up jobMgr thread to work on new job if there is any */
   cam_sem_post(&my_obj->job_mgr.job_sem);
 }
 
 
+/** mm_jpegdec_pipeline_job_done:
+ *
+ *  Arguments:
+ *    @p_session: decode session
+ *    @idx: output buffer index
+ *    @status: job status
+ *    @p_output: decoded image, NULL on error
+ *
+ *  Return:
+ *       none
+ *
+ *  Description:
+ *       Finalize the pipelined job decoding into the output
+ *       buffer. Called with the session lock held
+ *
+ **/
+static void mm_jpegdec_pipeline_job_done(mm_jpeg_job_session_t *p_session,
+  uint32_t idx, jpeg_job_status_t status, mm_jpeg_output_t *p_output)
+{
+  mm_jpeg_obj *my_obj = (mm_jpeg_obj *)p_session->jpeg_obj;
+  mm_jpeg_dec_slot_t *p_slot = &p_session->dec_slot[idx];
+  mm_jpeg_job_q_node_t *node = NULL;
+  uint32_t job_id = p_slot->job_id;
+
+  p_slot->busy = OMX_FALSE;
+  p_slot->job_id = 0;
+  p_session->dec_num_active--;
+  p_session->encoding = p_session->dec_num_active ? OMX_TRUE : OMX_FALSE;
+
+  /* a dropped job was already removed by the abort */
+  if (job_id) {
+    if ((MM_JPEG_ABORT_NONE == p_session->abort_state) &&
+      (NULL != p_session->dec_params.jpeg_cb)) {
+      CDBG("%s:%d] send jpeg callback %d job %x", __func__, __LINE__,
+        status, job_id);
+      p_session->dec_params.jpeg_cb(status,
+        p_session->client_hdl,
+        job_id,
+        p_output,
+        p_session->dec_params.userdata);
+    }
+    node = mm_jpeg_queue_remove_job_by_job_id(&my_obj->ongoing_job_q,
+      job_id);
+    if (node) {
+      free(node);
+    }
+  }
+
+  /* the output buffer is free again, wake up jobMgr thread */
+  cam_sem_post(&my_obj->job_mgr.job_sem);
+}
+
+/** mm_jpegdec_pipeline_find:
+ *
+ *  Arguments:
+ *    @p_session: decode session
+ *    @p_buffer: buffer header from the decoder
+ *
+ *  Return:
+ *       output buffer index of the job using the header, -1 if
+ *       none. Called with the session lock held
+ *
+ *  Description:
+ *       Find the pipelined job an event is about
+ *
+ **/
+static int32_t mm_jpegdec_pipeline_find(mm_jpeg_job_session_t *p_session,
+  OMX_PTR p_buffer)
+{
+  mm_jpeg_decode_params_t *p_params = &p_session->dec_params;
+  uint32_t i;
+
+  if (NULL == p_buffer) {
+    return -1;
+  }
+  for (i = 0; i < p_params->num_dst_bufs; i++) {
+    if (p_session->dec_slot[i].busy &&
+      (p_buffer == p_session->p_out_omx_buf[i])) {
+      return (int32_t)i;
+    }
+  }
+  /* errors before the image got an output buffer carry the input */
+  for (i = 0; i < p_params->num_dst_bufs; i++) {
+    if (p_session->dec_slot[i].busy && (p_buffer ==
+      p_session->p_in_omx_buf[p_session->dec_slot[i].src_index])) {
+      return (int32_t)i;
+    }
+  }
+  return -1;
+}
+
 /** mm_jpegdec_session_send_buffers:
  *
  *  Arguments:
@@ -175,6 +268,10 @@ OMX_ERRORTYPE mm_jpegdec_session_free_buffers(void *data)
   }
 
   for (i = 0; i < p_params->num_dst_bufs; i++) {
+    if (NULL == p_session->p_out_omx_buf[i]) {
+      /* the session never got to decode */
+      continue;
+    }
     CDBG("%s:%d] Dest buffer %d", __func__, __LINE__, i);
     ret = OMX_FreeBuffer(p_session->omx_handle, 1, p_session->p_out_omx_buf[i]);
     if (ret) {
@@ -202,6 +299,7 @@ OMX_ERRORTYPE mm_jpegdec_session_create(mm_jpeg_job_session_t* p_session)
 {
   OMX_ERRORTYPE rc = OMX_ErrorNone;
   mm_jpeg_cirq_t *p_cirq = NULL;
+  mm_jpeg_obj *my_obj = (mm_jpeg_obj *)p_session->jpeg_obj;
 
   pthread_mutex_init(&p_session->lock, NULL);
   pthread_cond_init(&p_session->cond, NULL);
@@ -213,17 +311,33 @@ OMX_ERRORTYPE mm_jpegdec_session_create(mm_jpeg_job_session_t* p_session)
   p_session->fbd_count = 0;
   p_session->encode_pid = -1;
   p_session->config = OMX_FALSE;
+  p_session->dec_pipeline = OMX_FALSE;
+  p_session->dec_out_ready = OMX_FALSE;
+  p_session->dec_num_active = 0;
+  memset(p_session->dec_slot, 0, sizeof(p_session->dec_slot));
+  memset(p_session->p_in_omx_buf, 0, sizeof(p_session->p_in_omx_buf));
+  memset(p_session->p_out_omx_buf, 0, sizeof(p_session->p_out_omx_buf));
 
   p_session->omx_callbacks.EmptyBufferDone = mm_jpegdec_ebd;
   p_session->omx_callbacks.FillBufferDone = mm_jpegdec_fbd;
   p_session->omx_callbacks.EventHandler = mm_jpegdec_event_handler;
   p_session->exif_count_local = 0;
 
-  rc = OMX_GetHandle(&p_session->omx_handle,
-    "OMX.qcom.image.jpeg.decoder",
-    (void *)p_session,
-    &p_session->omx_callbacks);
-
+  rc = OMX_ErrorComponentNotFound;
+  if (MM_JPEG_SW_ENC_ONLY != my_obj->sw_dec_mode) {
+    rc = OMX_GetHandle(&p_session->omx_handle,
+      "OMX.qcom.image.jpeg.decoder",
+      (void *)p_session,
+      &p_session->omx_callbacks);
+  }
+  if ((OMX_ErrorNone != rc) && (MM_JPEG_SW_ENC_OFF != my_obj->sw_dec_mode)) {
+    CDBG_HIGH("%s:%d] hw decoder unavailable (%d), using %s", __func__,
+      __LINE__, rc, MM_JPEG_SW_DEC_NAME);
+    rc = OMX_GetHandle(&p_session->omx_handle,
+      MM_JPEG_SW_DEC_NAME,
+      (void *)p_session,
+      &p_session->omx_callbacks);
+  }
   if (OMX_ErrorNone != rc) {
     CDBG_ERROR("%s:%d] OMX_GetHandle failed (%d)", __func__, __LINE__, rc);
     return rc;
@@ -372,6 +486,108 @@ OMX_ERRORTYPE mm_jpegdec_session_config_main(mm_jpeg_job_session_t *p_session)
   return rc;
 }
 
+/** mm_jpegdec_session_pipeline:
+ *
+ *  Arguments:
+ *    @p_session: job session
+ *
+ *  Return:
+ *       OMX error values
+ *
+ *  Description:
+ *       Ask the decoder to keep its ports across jobs and to run
+ *       several of them at once. Decoders without the extension
+ *       go through the port reconfiguration for every job
+ *
+ **/
+static OMX_ERRORTYPE mm_jpegdec_session_pipeline(
+  mm_jpeg_job_session_t *p_session)
+{
+  OMX_ERRORTYPE rc = OMX_ErrorNone;
+  OMX_INDEXTYPE indextype;
+  QOMX_JPEG_DECODE_PIPELINE pipeline;
+  mm_jpeg_decode_params_t *p_params = &p_session->dec_params;
+  mm_jpeg_obj *my_obj = (mm_jpeg_obj *)p_session->jpeg_obj;
+
+  p_session->dec_pipeline = OMX_FALSE;
+  rc = OMX_GetExtensionIndex(p_session->omx_handle,
+    QOMX_IMAGE_EXT_DECODE_PIPELINE_NAME, &indextype);
+  if (rc != OMX_ErrorNone) {
+    CDBG_HIGH("%s:%d] decode pipeline not supported", __func__, __LINE__);
+    return OMX_ErrorNone;
+  }
+
+  pipeline.nMaxJobs = my_obj->dec_jobs;
+  pipeline.nSliceHeight = (NULL != p_params->jpeg_slice_cb) ?
+    p_params->slice_height : 0;
+  rc = OMX_SetParameter(p_session->omx_handle, indextype, &pipeline);
+  if (rc != OMX_ErrorNone) {
+    CDBG_HIGH("%s:%d] decode pipeline rejected %d", __func__, __LINE__, rc);
+    return OMX_ErrorNone;
+  }
+
+  rc = OMX_GetParameter(p_session->omx_handle, indextype, &pipeline);
+  if (rc == OMX_ErrorNone) {
+    CDBG_HIGH("%s:%d] decode pipeline jobs %d slice %d", __func__, __LINE__,
+      (int)pipeline.nMaxJobs, (int)pipeline.nSliceHeight);
+  }
+  p_session->dec_pipeline = OMX_TRUE;
+  return OMX_ErrorNone;
+}
+
+/** mm_jpegdec_pipeline_config_output:
+ *
+ *  Arguments:
+ *    @p_session: job session
+ *
+ *  Return:
+ *       OMX error values
+ *
+ *  Description:
+ *       Take the output size the decoder asked for. The client
+ *       buffer layout is kept as long as the image fits in it
+ *
+ **/
+static OMX_ERRORTYPE mm_jpegdec_pipeline_config_output(
+  mm_jpeg_job_session_t *p_session)
+{
+  OMX_ERRORTYPE ret = OMX_ErrorNone;
+  mm_jpeg_decode_params_t *p_params = &p_session->dec_params;
+  OMX_PARAM_PORTDEFINITIONTYPE port;
+  mm_jpeg_buf_t *p_dst_buf = &p_params->dest_buf[0];
+
+  memcpy(&port, &p_session->outputPort, sizeof(port));
+  ret = OMX_GetParameter(p_session->omx_handle, OMX_IndexParamPortDefinition,
+    &port);
+  if (ret) {
+    CDBG_ERROR("%s:%d] failed", __func__, __LINE__);
+    return ret;
+  }
+
+  port.format.image.eColorFormat = map_jpeg_format(p_params->color_format);
+  if (((OMX_U32)p_dst_buf->offset.mp[0].stride >=
+    port.format.image.nFrameWidth) &&
+    ((OMX_U32)p_dst_buf->offset.mp[0].scanline >=
+    port.format.image.nFrameHeight)) {
+    port.format.image.nStride = p_dst_buf->offset.mp[0].stride;
+    port.format.image.nSliceHeight = p_dst_buf->offset.mp[0].scanline;
+  }
+  port.nBufferSize = p_dst_buf->buf_size;
+  port.nBufferCountActual = p_params->num_dst_bufs;
+
+  ret = OMX_SetParameter(p_session->omx_handle, OMX_IndexParamPortDefinition,
+    &port);
+  if (ret) {
+    CDBG_ERROR("%s:%d] failed", __func__, __LINE__);
+    return ret;
+  }
+  memcpy(&p_session->outputPort, &port, sizeof(port));
+  CDBG_HIGH("%s:%d] output %dx%d stride %d scanline %d", __func__, __LINE__,
+    (int)port.format.image.nFrameWidth, (int)port.format.image.nFrameHeight,
+    (int)port.format.image.nStride, (int)port.format.image.nSliceHeight);
+  return ret;
+}
+
 /** mm_jpeg_session_configure:
  *
  *  Arguments:
@@ -404,6 +620,12 @@ static OMX_ERRORTYPE mm_jpegdec_session_configure(mm_jpeg_job_session_t *p_sessi
 
   /* TODO: common config (if needed) */
 
+  ret = mm_jpegdec_session_pipeline(p_session);
+  if (OMX_ErrorNone != ret) {
+    CDBG_ERROR("%s:%d] decode pipeline failed", __func__, __LINE__);
+    goto error;
+  }
+
   ret = mm_jpeg_session_change_state(p_session, OMX_StateIdle,
     mm_jpegdec_session_send_buffers);
   if (ret) {
@@ -527,13 +749,13 @@ static OMX_ERRORTYPE mm_jpegdec_session_decode(mm_jpeg_job_session_t *p_session)
   OMX_EVENTTYPE lEvent;
   OMX_U32 i;
   QOMX_BUFFER_INFO lbuffer_info;
-
-  pthread_mutex_lock(&p_session->lock);
-  p_session->abort_state = MM_JPEG_ABORT_NONE;
-  p_session->encoding = OMX_FALSE;
-  pthread_mutex_unlock(&p_session->lock);
+  mm_jpeg_dec_slot_t *p_slot = &p_session->dec_slot[p_jobparams->dst_index];
 
   if (OMX_FALSE == p_session->config) {
+    pthread_mutex_lock(&p_session->lock);
+    p_session->abort_state = MM_JPEG_ABORT_NONE;
+    pthread_mutex_unlock(&p_session->lock);
+
     ret = mm_jpegdec_session_configure(p_session);
     if (ret) {
       CDBG_ERROR("%s:%d] Error", __func__, __LINE__);
@@ -542,6 +764,31 @@ static OMX_ERRORTYPE mm_jpegdec_session_decode(mm_jpeg_job_session_t *p_session)
     p_session->config = OMX_TRUE;
   }
 
+  if (OMX_TRUE == p_session->dec_pipeline) {
+    pthread_mutex_lock(&p_session->lock);
+    p_slot->job_id = p_session->jobId;
+    p_slot->src_index = p_jobparams->src_index;
+    p_slot->busy = OMX_TRUE;
+    p_session->dec_num_active++;
+    p_session->encoding = OMX_TRUE;
+    pthread_mutex_unlock(&p_session->lock);
+
+    ret = mm_jpegdec_session_decode_pipeline(p_session);
+    if (ret) {
+      pthread_mutex_lock(&p_session->lock);
+      p_slot->busy = OMX_FALSE;
+      p_slot->job_id = 0;
+      p_session->dec_num_active--;
+      pthread_mutex_unlock(&p_session->lock);
+    }
+    return ret;
+  }
+
+  pthread_mutex_lock(&p_session->lock);
+  p_session->abort_state = MM_JPEG_ABORT_NONE;
+  p_session->encoding = OMX_FALSE;
+  pthread_mutex_unlock(&p_session->lock);
+
   pthread_mutex_lock(&p_session->lock);
   p_session->encoding = OMX_TRUE;
   pthread_mutex_unlock(&p_session->lock);
@@ -659,6 +906,120 @@ error:
   return ret;
 }
 
+/** mm_jpegdec_session_decode_pipeline:
+ *
+ *  Arguments:
+ *    @p_session: decode session
+ *
+ *  Return:
+ *       OMX_ERRORTYPE
+ *
+ *  Description:
+ *       Queue the job to a pipelined decoder. The output buffers
+ *       are registered once, with the first image. After that a
+ *       job is only an input and an output buffer, the decoder
+ *       pairs them in order and runs several at once
+ *
+ **/
+static OMX_ERRORTYPE mm_jpegdec_session_decode_pipeline(
+  mm_jpeg_job_session_t *p_session)
+{
+  OMX_ERRORTYPE ret = OMX_ErrorNone;
+  mm_jpeg_decode_params_t *p_params = &p_session->dec_params;
+  mm_jpeg_decode_job_t *p_jobparams = &p_session->decode_job;
+  OMX_EVENTTYPE lEvent;
+  OMX_U32 i;
+  QOMX_BUFFER_INFO lbuffer_info;
+
+  if (OMX_TRUE == p_session->dec_out_ready) {
+    ret = OMX_EmptyThisBuffer(p_session->omx_handle,
+      p_session->p_in_omx_buf[p_jobparams->src_index]);
+    if (ret) {
+      CDBG_ERROR("%s:%d] Error", __func__, __LINE__);
+      return ret;
+    }
+    goto fill;
+  }
+
+  pthread_mutex_lock(&p_session->lock);
+  p_session->event_pending = OMX_TRUE;
+  pthread_mutex_unlock(&p_session->lock);
+
+  ret = OMX_EmptyThisBuffer(p_session->omx_handle,
+    p_session->p_in_omx_buf[p_jobparams->src_index]);
+  if (ret) {
+    CDBG_ERROR("%s:%d] Error", __func__, __LINE__);
+    return ret;
+  }
+
+  // Wait for the first port settings
+  pthread_mutex_lock(&p_session->lock);
+  if (p_session->event_pending == OMX_TRUE) {
+    CDBG("%s:%d] before wait", __func__, __LINE__);
+    pthread_cond_wait(&p_session->cond, &p_session->lock);
+  }
+  lEvent = p_session->omxEvent;
+  CDBG("%s:%d] after wait", __func__, __LINE__);
+  pthread_mutex_unlock(&p_session->lock);
+
+  if (lEvent != OMX_EventPortSettingsChanged) {
+    CDBG_ERROR("%s:%d] Unexpected event %d", __func__, __LINE__, lEvent);
+    /* decode errors are reported to the client by the event handler */
+    return (lEvent == OMX_EventError) ? OMX_ErrorNone : OMX_ErrorUndefined;
+  }
+
+  ret = mm_jpegdec_pipeline_config_output(p_session);
+  if (ret) {
+    return ret;
+  }
+
+  // Enable port (no wait), completes once the buffers are in
+  ret = mm_jpeg_session_port_enable(p_session,
+    p_session->outputPort.nPortIndex,
+    OMX_FALSE);
+  if (ret) {
+    return ret;
+  }
+
+  memset(&lbuffer_info, 0x0, sizeof(QOMX_BUFFER_INFO));
+  for (i = 0; i < p_params->num_dst_bufs; i++) {
+    lbuffer_info.fd = p_params->dest_buf[i].fd;
+    CDBG("%s:%d] Dest buffer %d", __func__, __LINE__, i);
+    ret = OMX_UseBuffer(p_session->omx_handle, &(p_session->p_out_omx_buf[i]),
+      1, &lbuffer_info, p_params->dest_buf[i].buf_size,
+      p_params->dest_buf[i].buf_vaddr);
+    if (ret) {
+      CDBG_ERROR("%s:%d] Error", __func__, __LINE__);
+      return ret;
+    }
+  }
+
+  // Wait for port enable completion
+  pthread_mutex_lock(&p_session->lock);
+  if (p_session->event_pending == OMX_TRUE) {
+    CDBG("%s:%d] before wait", __func__, __LINE__);
+    pthread_cond_wait(&p_session->cond, &p_session->lock);
+  }
+  lEvent = p_session->omxEvent;
+  if (lEvent == OMX_EventCmdComplete) {
+    p_session->dec_out_ready = OMX_TRUE;
+  }
+  pthread_mutex_unlock(&p_session->lock);
+
+  if (lEvent != OMX_EventCmdComplete) {
+    CDBG_ERROR("%s:%d] Unexpected event %d", __func__, __LINE__, lEvent);
+    return OMX_ErrorUndefined;
+  }
+
+fill:
+  ret = OMX_FillThisBuffer(p_session->omx_handle,
+    p_session->p_out_omx_buf[p_jobparams->dst_index]);
+  if (ret) {
+    CDBG_ERROR("%s:%d] Error", __func__, __LINE__);
+  }
+  return ret;
+}
+
 /** mm_jpegdec_process_decoding_job:
  *
  *  Arguments:
@@ -678,6 +1039,7 @@ int32_t mm_jpegdec_process_decoding_job(mm_jpeg_obj *my_obj, mm_jpeg_job_q_node_
   OMX_ERRORTYPE ret = OMX_ErrorNone;
   mm_jpeg_job_session_t *p_session = NULL;
   mm_jpeg_job_q_node_t *node = NULL;
+  OMX_BOOL busy;
 
   /* check if valid session */
   p_session = mm_jpeg_get_session(my_obj, job_node->dec_info.job_id);
@@ -687,6 +1049,20 @@ int32_t mm_jpegdec_process_decoding_job(mm_jpeg_obj *my_obj, mm_jpeg_job_q_node_
     return -1;
   }
 
+  pthread_mutex_lock(&p_session->lock);
+  if (OMX_TRUE == p_session->dec_pipeline) {
+    busy = p_session->dec_slot[job_node->dec_info.decode_job.dst_index].busy;
+  } else {
+    /* one job at a time without the pipeline */
+    busy = p_session->encoding;
+  }
+  pthread_mutex_unlock(&p_session->lock);
+  if (OMX_TRUE == busy) {
+    /* retried when a job of the session completes */
+    mm_jpeg_queue_enq_head(&my_obj->job_mgr.job_queue, job_node);
+    return rc;
+  }
+
   /* sent encode cmd to OMX, queue job into ongoing queue */
   rc = mm_jpeg_queue_enq(&my_obj->ongoing_job_q, job_node);
   if (rc) {
@@ -852,6 +1228,7 @@ int32_t mm_jpegdec_create_session(mm_jpeg_obj *my_obj,
     return rc;
   }
 
+  p_session->jpeg_obj = (void*)my_obj; /* save a ptr to jpeg_obj */
   ret = mm_jpegdec_session_create(p_session);
   if (OMX_ErrorNone != ret) {
     p_session->active = OMX_FALSE;
@@ -865,7 +1242,6 @@ int32_t mm_jpegdec_create_session(mm_jpeg_obj *my_obj,
   p_session->dec_params = *p_params;
   p_session->client_hdl = client_hdl;
   p_session->sessionId = *p_session_id;
-  p_session->jpeg_obj = (void*)my_obj; /* save a ptr to jpeg_obj */
   CDBG("%s:%d] session id %x", __func__, __LINE__, *p_session_id);
 
   return rc;
@@ -978,12 +1354,29 @@ OMX_ERRORTYPE mm_jpegdec_fbd(OMX_HANDLETYPE hComponent,
   mm_jpeg_job_session_t *p_session = (mm_jpeg_job_session_t *) pAppData;
   uint32_t i = 0;
   int rc = 0;
+  int32_t idx;
   mm_jpeg_output_t output_buf;
 
   CDBG("%s:%d] count %d ", __func__, __LINE__, p_session->fbd_count);
 
   pthread_mutex_lock(&p_session->lock);
 
+  if (OMX_TRUE == p_session->dec_pipeline) {
+    idx = mm_jpegdec_pipeline_find(p_session, pBuffer);
+    if (idx >= 0) {
+      p_session->fbd_count++;
+      output_buf.buf_filled_len = (uint32_t)pBuffer->nFilledLen;
+      output_buf.buf_vaddr = pBuffer->pBuffer;
+      output_buf.fd = 0;
+      mm_jpegdec_pipeline_job_done(p_session, (uint32_t)idx,
+        JPEG_JOB_STATUS_DONE, &output_buf);
+    } else {
+      CDBG_ERROR("%s:%d] unknown buffer %p", __func__, __LINE__, pBuffer);
+    }
+    pthread_mutex_unlock(&p_session->lock);
+    return ret;
+  }
+
   if (MM_JPEG_ABORT_NONE != p_session->abort_state) {
     pthread_mutex_unlock(&p_session->lock);
     return ret;
@@ -1020,6 +1413,9 @@ OMX_ERRORTYPE mm_jpegdec_event_handler(OMX_HANDLETYPE hComponent,
   OMX_PTR pEventData)
 {
   mm_jpeg_job_session_t *p_session = (mm_jpeg_job_session_t *) pAppData;
+  OMX_BUFFERHEADERTYPE *p_buffer;
+  mm_jpeg_output_t output_buf;
+  int32_t idx;
 
   CDBG("%s:%d] %d %d %d state %d", __func__, __LINE__, eEvent, (int)nData1,
     (int)nData2, p_session->abort_state);
@@ -1027,6 +1423,40 @@ OMX_ERRORTYPE mm_jpegdec_event_handler(OMX_HANDLETYPE hComponent,
   CDBG("%s:%d] AppData=%p ", __func__, __LINE__, pAppData);
 
   pthread_mutex_lock(&p_session->lock);
+  if ((OMX_TRUE == p_session->dec_pipeline) &&
+    (OMX_EVENT_JPEG_SLICE_DONE == (int)eEvent)) {
+    idx = mm_jpegdec_pipeline_find(p_session, pEventData);
+    if ((idx >= 0) && p_session->dec_slot[idx].job_id &&
+      (MM_JPEG_ABORT_NONE == p_session->abort_state) &&
+      (NULL != p_session->dec_params.jpeg_slice_cb)) {
+      p_buffer = (OMX_BUFFERHEADERTYPE *)pEventData;
+      output_buf.buf_filled_len = (uint32_t)p_buffer->nFilledLen;
+      output_buf.buf_vaddr = p_buffer->pBuffer;
+      output_buf.fd = p_session->dec_params.dest_buf[idx].fd;
+      p_session->dec_params.jpeg_slice_cb(p_session->client_hdl,
+        p_session->dec_slot[idx].job_id,
+        &output_buf,
+        (uint32_t)nData1,
+        p_session->dec_params.userdata);
+    }
+    pthread_mutex_unlock(&p_session->lock);
+    return OMX_ErrorNone;
+  }
+
+  if ((OMX_TRUE == p_session->dec_pipeline) &&
+    (OMX_TRUE == p_session->dec_out_ready) &&
+    (eEvent == OMX_EventPortSettingsChanged)) {
+    /* the image size changed, the registered buffers are kept and the
+     * jobs behind it wait in the decoder until the port is enabled */
+    pthread_mutex_unlock(&p_session->lock);
+    if ((OMX_ErrorNone != mm_jpegdec_pipeline_config_output(p_session)) ||
+      (OMX_ErrorNone != OMX_SendCommand(p_session->omx_handle,
+      OMX_CommandPortEnable, p_session->outputPort.nPortIndex, NULL))) {
+      CDBG_ERROR("%s:%d] output reconfiguration failed", __func__, __LINE__);
+    }
+    return OMX_ErrorNone;
+  }
+
   p_session->omxEvent = eEvent;
   if (MM_JPEG_ABORT_INIT == p_session->abort_state) {
     p_session->abort_state = MM_JPEG_ABORT_DONE;
@@ -1035,7 +1465,18 @@ OMX_ERRORTYPE mm_jpegdec_event_handler(OMX_HANDLETYPE hComponent,
     return OMX_ErrorNone;
   }
 
-  if (eEvent == OMX_EventError) {
+  if ((eEvent == OMX_EventError) && (OMX_TRUE == p_session->dec_pipeline)) {
+    /* the first job may be waiting for the port settings */
+    p_session->event_pending = OMX_FALSE;
+    idx = mm_jpegdec_pipeline_find(p_session, pEventData);
+    CDBG_ERROR("%s:%d] decode error %d job %x", __func__, __LINE__,
+      (int)nData1, (idx >= 0) ? p_session->dec_slot[idx].job_id : 0);
+    if (idx >= 0) {
+      mm_jpegdec_pipeline_job_done(p_session, (uint32_t)idx,
+        JPEG_JOB_STATUS_ERROR, NULL);
+    }
+    pthread_cond_signal(&p_session->cond);
+  } else if (eEvent == OMX_EventError) {
     if (p_session->encoding == OMX_TRUE) {
       CDBG("%s:%d] Error during encoding", __func__, __LINE__);
 
@@ -1091,6 +1532,7 @@ int32_t mm_jpegdec_abort_job(mm_jpeg_obj *my_obj,
   mm_jpeg_job_q_node_t *node = NULL;
   OMX_BOOL ret = OMX_FALSE;
   mm_jpeg_job_session_t *p_session = NULL;
+  uint32_t i;
 
   CDBG("%s:%d] ", __func__, __LINE__);
   pthread_mutex_lock(&my_obj->job_lock);
@@ -1107,7 +1549,17 @@ int32_t mm_jpegdec_abort_job(mm_jpeg_obj *my_obj,
   if (NULL != node) {
     /* find job that is OMX ongoing, ask OMX to abort the job */
     p_session = mm_jpeg_get_session(my_obj, node->dec_info.job_id);
-    if (p_session) {
+    if (p_session && (OMX_TRUE == p_session->dec_pipeline)) {
+      /* the other jobs keep going, the result of this one is dropped */
+      pthread_mutex_lock(&p_session->lock);
+      for (i = 0; i < MM_JPEG_MAX_BUF; i++) {
+        if (p_session->dec_slot[i].busy &&
+          (jobId == p_session->dec_slot[i].job_id)) {
+          p_session->dec_slot[i].job_id = 0;
+        }
+      }
+      pthread_mutex_unlock(&p_session->lock);
+    } else if (p_session) {
       mm_jpeg_session_abort(p_session);
     } else {
       CDBG_ERROR("%s:%d] Invalid job id 0x%x", __func__, __LINE__,
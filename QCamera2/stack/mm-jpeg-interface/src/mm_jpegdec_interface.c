@@ -33,6 +33,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <cutils/properties.h>
 
 #include "mm_jpeg_dbg.h"
 #include "mm_jpeg_interface.h"
@@ -250,6 +251,7 @@ uint32_t jpegdec_open(mm_jpegdec_ops_t *ops)
   int32_t rc = 0;
   uint32_t clnt_hdl = 0;
   mm_jpeg_obj* jpeg_obj = NULL;
+  char prop[PROPERTY_VALUE_MAX];
 
   pthread_mutex_lock(&g_dec_intf_lock);
   /* first time open */
@@ -263,6 +265,18 @@ uint32_t jpegdec_open(mm_jpegdec_ops_t *ops)
 
     /* initialize jpeg obj */
     memset(jpeg_obj, 0, sizeof(mm_jpeg_obj));
+
+    /* 0 - hardware only, 1 - software if hardware is unavailable,
+     * 2 - software only */
+    property_get("persist.camera.jpeg.swdec", prop, "1");
+    jpeg_obj->sw_dec_mode = atoi(prop);
+
+    /* concurrent decodes of a pipelined session, 0 lets the decoder
+     * pick from the number of cores */
+    property_get("persist.camera.jpeg.dec.jobs", prop, "0");
+    jpeg_obj->dec_jobs = atoi(prop);
+    jpeg_obj->max_ongoing_jobs = NUM_MAX_JPEGDEC_CNCURRENT_JOBS;
+
     rc = mm_jpegdec_init(jpeg_obj);
     if(0 != rc) {
       CDBG_ERROR("%s:%d] mm_jpeg_init err = %d", __func__, __LINE__, rc);
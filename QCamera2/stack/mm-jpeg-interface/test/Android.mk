@@ -73,4 +73,43 @@ LOCAL_SHARED_LIBRARIES := libcutils libdl libmmjpeg_interface
 
 include $(BUILD_EXECUTABLE)
 
+#session cache test
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(MM_JPEG_TEST_PATH)
+LOCAL_MODULE_TAGS := tests
+
+LOCAL_CFLAGS := -Werror -Wno-unused-parameter
+LOCAL_CFLAGS += -D_ANDROID_
+LOCAL_CFLAGS += -DMM_JPEG_CONCURRENT_SESSIONS_COUNT=1
+
+OMX_HEADER_DIR := frameworks/native/include/media/openmax
+OMX_CORE_DIR := hardware/qcom/camera/mm-image-codec
+
+LOCAL_C_INCLUDES := $(MM_JPEG_TEST_PATH)
+LOCAL_C_INCLUDES += $(MM_JPEG_TEST_PATH)/../inc
+LOCAL_C_INCLUDES += $(MM_JPEG_TEST_PATH)/../../common
+LOCAL_C_INCLUDES += $(OMX_HEADER_DIR)
+LOCAL_C_INCLUDES += $(OMX_CORE_DIR)/qexif
+LOCAL_C_INCLUDES += $(OMX_CORE_DIR)/qomx_core
+
+LOCAL_C_INCLUDES+= $(kernel_includes)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
+
+# the OMX core and ion buffers are stubbed by the test itself
+LOCAL_SRC_FILES := mm_jpeg_session_cache_test.c \
+    ../src/mm_jpeg_queue.c \
+    ../src/mm_jpeg_exif.c \
+    ../src/mm_jpeg.c \
+    ../src/mm_jpeg_interface.c \
+    ../src/mm_jpeg_outbuf.c \
+    ../src/mm_jpegdec_interface.c \
+    ../src/mm_jpegdec.c
+
+LOCAL_MODULE           := mm-jpeg-session-cache-test
+LOCAL_PRELINK_MODULE   := false
+LOCAL_SHARED_LIBRARIES := libcutils libdl liblog
+
+include $(BUILD_EXECUTABLE)
+
 LOCAL_PATH := $(OLD_LOCAL_PATH)
@@ -0,0 +1,460 @@
+/* Copyright (c) 2013-2014, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Session cache test on a stub OMX core. The mm-jpeg sources are built
+ * into the test together with a stub encoder component that completes
+ * state changes at once and, like the hw encoder, allows only a few
+ * instances (OMX_COMP_MAX_INSTANCES), and with heap backed work buffers
+ * instead of ion. It checks that a destroyed session is reused only for
+ * the same buffer generation, that flush and close release parked
+ * sessions, and that parked sessions give up their hw instances before
+ * a new session falls back to the software encoder. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mm_jpeg_dbg.h"
+#include "mm_jpeg_interface.h"
+#include "mm_jpeg.h"
+
+#define STUB_HW_NAME           "OMX.qcom.image.jpeg.encoder"
+#define STUB_HW_MAX_INSTANCES  3
+#define TEST_WIDTH             64
+#define TEST_HEIGHT            48
+#define TEST_NUM_BUFS          2
+
+typedef struct {
+  OMX_COMPONENTTYPE comp;
+  OMX_CALLBACKTYPE cb;
+  OMX_PTR app_data;
+  OMX_STATETYPE state;
+  OMX_BOOL hw;
+} stub_omx_comp_t;
+
+typedef struct {
+  int hw_live;               /* hw encoder instances in use */
+  int sw_live;               /* sw encoder instances in use */
+  int hw_gets;               /* hw instances handed out */
+  int hw_rejects;            /* hw requests over the instance limit */
+  int sw_gets;
+  int bufs_live;             /* buffers registered with UseBuffer */
+} stub_omx_stats_t;
+
+static stub_omx_stats_t g_stub;
+static int g_failures;
+
+#define TEST_CHECK(cond, ...) do { \
+  if (!(cond)) { \
+    printf("FAIL %s:%d: ", __func__, __LINE__); \
+    printf(__VA_ARGS__); \
+    printf("\n"); \
+    g_failures++; \
+  } \
+} while (0)
+
+/* work buffers come from the heap instead of ion */
+void *buffer_allocate(buffer_t *p_buffer, int cached)
+{
+  (void)cached;
+  p_buffer->addr = (uint8_t *)malloc(p_buffer->size);
+  p_buffer->ion_fd = -1;
+  p_buffer->p_pmem_fd = -1;
+  return p_buffer->addr;
+}
+
+int buffer_deallocate(buffer_t *p_buffer)
+{
+  free(p_buffer->addr);
+  p_buffer->addr = NULL;
+  return 0;
+}
+
+int buffer_invalidate(buffer_t *p_buffer)
+{
+  (void)p_buffer;
+  return 0;
+}
+
+static OMX_ERRORTYPE stub_send_command(OMX_HANDLETYPE h, OMX_COMMANDTYPE cmd,
+  OMX_U32 param, OMX_PTR data)
+{
+  stub_omx_comp_t *p_comp = (stub_omx_comp_t *)h;
+  (void)data;
+
+  if (OMX_CommandStateSet == cmd) {
+    p_comp->state = (OMX_STATETYPE)param;
+  }
+  p_comp->cb.EventHandler(h, p_comp->app_data, OMX_EventCmdComplete, cmd,
+    param, NULL);
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE stub_get_state(OMX_HANDLETYPE h, OMX_STATETYPE *p_state)
+{
+  *p_state = ((stub_omx_comp_t *)h)->state;
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE stub_get_set(OMX_HANDLETYPE h, OMX_INDEXTYPE idx,
+  OMX_PTR data)
+{
+  (void)h;
+  (void)idx;
+  (void)data;
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE stub_get_extension_index(OMX_HANDLETYPE h,
+  OMX_STRING name, OMX_INDEXTYPE *p_idx)
+{
+  (void)h;
+  (void)name;
+  *p_idx = OMX_IndexVendorStartUnused;
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE stub_use_buffer(OMX_HANDLETYPE h,
+  OMX_BUFFERHEADERTYPE **pp_hdr, OMX_U32 port, OMX_PTR app_private,
+  OMX_U32 size, OMX_U8 *p_buf)
+{
+  OMX_BUFFERHEADERTYPE *p_hdr = calloc(1, sizeof(OMX_BUFFERHEADERTYPE));
+  (void)h;
+
+  if (NULL == p_hdr) {
+    return OMX_ErrorInsufficientResources;
+  }
+  p_hdr->pBuffer = p_buf;
+  p_hdr->nAllocLen = size;
+  p_hdr->pAppPrivate = app_private;
+  p_hdr->nInputPortIndex = port;
+  *pp_hdr = p_hdr;
+  g_stub.bufs_live++;
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE stub_free_buffer(OMX_HANDLETYPE h, OMX_U32 port,
+  OMX_BUFFERHEADERTYPE *p_hdr)
+{
+  (void)h;
+  (void)port;
+  free(p_hdr);
+  g_stub.bufs_live--;
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE stub_this_buffer(OMX_HANDLETYPE h,
+  OMX_BUFFERHEADERTYPE *p_hdr)
+{
+  (void)h;
+  (void)p_hdr;
+  return OMX_ErrorNotImplemented;
+}
+
+OMX_ERRORTYPE OMX_Init(void)
+{
+  return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_Deinit(void)
+{
+  return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_GetHandle(OMX_HANDLETYPE *p_handle, OMX_STRING name,
+  OMX_PTR app_data, OMX_CALLBACKTYPE *p_cb)
+{
+  stub_omx_comp_t *p_comp;
+  OMX_BOOL hw = strcmp(name, STUB_HW_NAME) ? OMX_FALSE : OMX_TRUE;
+
+  if ((OMX_TRUE == hw) && (g_stub.hw_live >= STUB_HW_MAX_INSTANCES)) {
+    g_stub.hw_rejects++;
+    return OMX_ErrorInsufficientResources;
+  }
+  p_comp = calloc(1, sizeof(stub_omx_comp_t));
+  if (NULL == p_comp) {
+    return OMX_ErrorInsufficientResources;
+  }
+  p_comp->comp.SendCommand = stub_send_command;
+  p_comp->comp.GetState = stub_get_state;
+  p_comp->comp.GetParameter = stub_get_set;
+  p_comp->comp.SetParameter = stub_get_set;
+  p_comp->comp.GetConfig = stub_get_set;
+  p_comp->comp.SetConfig = stub_get_set;
+  p_comp->comp.GetExtensionIndex = stub_get_extension_index;
+  p_comp->comp.UseBuffer = stub_use_buffer;
+  p_comp->comp.FreeBuffer = stub_free_buffer;
+  p_comp->comp.EmptyThisBuffer = stub_this_buffer;
+  p_comp->comp.FillThisBuffer = stub_this_buffer;
+  p_comp->cb = *p_cb;
+  p_comp->app_data = app_data;
+  p_comp->state = OMX_StateLoaded;
+  p_comp->hw = hw;
+  if (OMX_TRUE == hw) {
+    g_stub.hw_live++;
+    g_stub.hw_gets++;
+  } else {
+    g_stub.sw_live++;
+    g_stub.sw_gets++;
+  }
+  *p_handle = (OMX_HANDLETYPE)p_comp;
+  return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE OMX_FreeHandle(OMX_HANDLETYPE handle)
+{
+  stub_omx_comp_t *p_comp = (stub_omx_comp_t *)handle;
+
+  if (OMX_TRUE == p_comp->hw) {
+    g_stub.hw_live--;
+  } else {
+    g_stub.sw_live--;
+  }
+  free(p_comp);
+  return OMX_ErrorNone;
+}
+
+/* src/dst buffers only need stable addresses, the stub never touches them */
+static uint8_t g_src[TEST_NUM_BUFS][TEST_WIDTH * TEST_HEIGHT * 3 / 2];
+static uint8_t g_dst[TEST_NUM_BUFS][TEST_WIDTH * TEST_HEIGHT * 3 / 2];
+
+static void test_jpeg_cb(jpeg_job_status_t status, uint32_t client_hdl,
+  uint32_t jobId, mm_jpeg_output_t *p_output, void *userData)
+{
+  (void)status;
+  (void)client_hdl;
+  (void)jobId;
+  (void)p_output;
+  (void)userData;
+}
+
+static void test_fill_params(mm_jpeg_encode_params_t *p_params,
+  uint32_t quality, uint32_t generation)
+{
+  uint32_t i;
+
+  memset(p_params, 0, sizeof(*p_params));
+  p_params->jpeg_cb = test_jpeg_cb;
+  p_params->color_format = MM_JPEG_COLOR_FORMAT_YCRCBLP_H2V2;
+  p_params->thumb_color_format = MM_JPEG_COLOR_FORMAT_YCRCBLP_H2V2;
+  p_params->quality = quality;
+  p_params->main_dim.src_dim.width = TEST_WIDTH;
+  p_params->main_dim.src_dim.height = TEST_HEIGHT;
+  p_params->main_dim.dst_dim = p_params->main_dim.src_dim;
+  p_params->num_src_bufs = TEST_NUM_BUFS;
+  p_params->num_dst_bufs = TEST_NUM_BUFS;
+  for (i = 0; i < TEST_NUM_BUFS; i++) {
+    p_params->src_main_buf[i].index = i;
+    p_params->src_main_buf[i].buf_size = sizeof(g_src[i]);
+    p_params->src_main_buf[i].buf_vaddr = g_src[i];
+    p_params->src_main_buf[i].fd = 100 + i;
+    p_params->src_main_buf[i].format = MM_JPEG_FMT_YUV;
+    p_params->dest_buf[i].index = i;
+    p_params->dest_buf[i].buf_size = sizeof(g_dst[i]);
+    p_params->dest_buf[i].buf_vaddr = g_dst[i];
+    p_params->dest_buf[i].format = MM_JPEG_FMT_YUV;
+  }
+  p_params->buf_generation = generation;
+}
+
+static uint32_t test_create(mm_jpeg_obj *p_obj, uint32_t client_hdl,
+  uint32_t quality, uint32_t generation)
+{
+  mm_jpeg_encode_params_t params;
+  uint32_t session_id = 0;
+
+  test_fill_params(&params, quality, generation);
+  if ((0 != mm_jpeg_create_session(p_obj, client_hdl, &params,
+    &session_id)) || (0 == session_id)) {
+    TEST_CHECK(0, "create session q%u gen %u failed", quality, generation);
+    return 0;
+  }
+  return session_id;
+}
+
+static int test_init(mm_jpeg_obj *p_obj, uint32_t cache_size,
+  uint32_t *p_client_hdl)
+{
+  memset(p_obj, 0, sizeof(*p_obj));
+  p_obj->max_pic_w = TEST_WIDTH;
+  p_obj->max_pic_h = TEST_HEIGHT;
+  p_obj->session_cache_size = cache_size;
+  p_obj->sw_enc_mode = MM_JPEG_SW_ENC_FALLBACK;
+  p_obj->max_ongoing_jobs = NUM_MAX_JPEG_CNCURRENT_JOBS;
+  memset(&g_stub, 0, sizeof(g_stub));
+  if (0 != mm_jpeg_init(p_obj)) {
+    printf("mm_jpeg_init failed\n");
+    return -1;
+  }
+  *p_client_hdl = mm_jpeg_new_client(p_obj);
+  if (0 == *p_client_hdl) {
+    printf("mm_jpeg_new_client failed\n");
+    mm_jpeg_deinit(p_obj);
+    return -1;
+  }
+  return 0;
+}
+
+static void test_deinit(mm_jpeg_obj *p_obj, uint32_t client_hdl)
+{
+  mm_jpeg_close(p_obj, client_hdl);
+  mm_jpeg_deinit(p_obj);
+  TEST_CHECK(0 == g_stub.hw_live + g_stub.sw_live,
+    "%d instances left after close", g_stub.hw_live + g_stub.sw_live);
+  TEST_CHECK(0 == g_stub.bufs_live, "%d buffers left after close",
+    g_stub.bufs_live);
+}
+
+/* same params and generation reuse the parked session */
+static void test_reuse(void)
+{
+  mm_jpeg_obj obj;
+  uint32_t client_hdl;
+  uint32_t first, second;
+
+  if (0 != test_init(&obj, 1, &client_hdl)) {
+    g_failures++;
+    return;
+  }
+  first = test_create(&obj, client_hdl, 85, 1);
+  mm_jpeg_destroy_session_by_id(&obj, first);
+  TEST_CHECK(1 == g_stub.hw_live, "parked session released its instance");
+  second = test_create(&obj, client_hdl, 85, 1);
+  TEST_CHECK(first == second, "session %x not reused, got %x", first, second);
+  TEST_CHECK(1 == g_stub.hw_gets, "%d hw instances created", g_stub.hw_gets);
+  mm_jpeg_destroy_session_by_id(&obj, second);
+  test_deinit(&obj, client_hdl);
+}
+
+/* buffers at the same fd and address but of a new generation are not the
+ * buffers the parked session registered */
+static void test_generation(void)
+{
+  mm_jpeg_obj obj;
+  uint32_t client_hdl;
+  uint32_t first, second;
+
+  if (0 != test_init(&obj, 1, &client_hdl)) {
+    g_failures++;
+    return;
+  }
+  first = test_create(&obj, client_hdl, 85, 1);
+  mm_jpeg_destroy_session_by_id(&obj, first);
+  second = test_create(&obj, client_hdl, 85, 2);
+  TEST_CHECK(2 == g_stub.hw_gets, "stale session reused for new buffers");
+  mm_jpeg_destroy_session_by_id(&obj, second);
+  /* the parked gen 1 session is evicted by the gen 2 one */
+  TEST_CHECK(1 == g_stub.hw_live, "%d instances with cache size 1",
+    g_stub.hw_live);
+
+  /* generation 0 opts out of caching */
+  first = test_create(&obj, client_hdl, 90, 0);
+  mm_jpeg_destroy_session_by_id(&obj, first);
+  TEST_CHECK(1 == g_stub.hw_live, "uncached session kept, %d instances",
+    g_stub.hw_live);
+  second = test_create(&obj, client_hdl, 90, 0);
+  TEST_CHECK(4 == g_stub.hw_gets, "generation 0 session reused");
+  mm_jpeg_destroy_session_by_id(&obj, second);
+  test_deinit(&obj, client_hdl);
+}
+
+/* flush releases parked sessions and their registered buffers */
+static void test_flush(void)
+{
+  mm_jpeg_obj obj;
+  uint32_t client_hdl;
+  uint32_t session_id;
+
+  if (0 != test_init(&obj, 2, &client_hdl)) {
+    g_failures++;
+    return;
+  }
+  session_id = test_create(&obj, client_hdl, 85, 1);
+  mm_jpeg_destroy_session_by_id(&obj, session_id);
+  session_id = test_create(&obj, client_hdl, 90, 1);
+  mm_jpeg_destroy_session_by_id(&obj, session_id);
+  TEST_CHECK(2 == g_stub.hw_live, "%d parked sessions", g_stub.hw_live);
+  mm_jpeg_flush_session_cache(&obj, client_hdl);
+  TEST_CHECK(0 == g_stub.hw_live, "%d instances after flush", g_stub.hw_live);
+  TEST_CHECK(0 == g_stub.bufs_live, "%d buffers after flush",
+    g_stub.bufs_live);
+  session_id = test_create(&obj, client_hdl, 85, 1);
+  TEST_CHECK(3 == g_stub.hw_gets, "flushed session reused");
+  mm_jpeg_destroy_session_by_id(&obj, session_id);
+  test_deinit(&obj, client_hdl);
+}
+
+/* parked sessions hold every hw instance, a new session evicts one of
+ * them instead of falling back to the software encoder */
+static void test_instance_limit(void)
+{
+  mm_jpeg_obj obj;
+  uint32_t client_hdl;
+  uint32_t session_id;
+  uint32_t q;
+
+  if (0 != test_init(&obj, STUB_HW_MAX_INSTANCES, &client_hdl)) {
+    g_failures++;
+    return;
+  }
+  for (q = 0; q < STUB_HW_MAX_INSTANCES; q++) {
+    session_id = test_create(&obj, client_hdl, 80 + q, 1);
+    mm_jpeg_destroy_session_by_id(&obj, session_id);
+  }
+  TEST_CHECK(STUB_HW_MAX_INSTANCES == g_stub.hw_live, "%d parked sessions",
+    g_stub.hw_live);
+
+  session_id = test_create(&obj, client_hdl, 95, 1);
+  TEST_CHECK(1 == g_stub.hw_rejects, "%d hw requests rejected",
+    g_stub.hw_rejects);
+  TEST_CHECK(0 == g_stub.sw_gets, "fell back to the software encoder");
+  TEST_CHECK(STUB_HW_MAX_INSTANCES == g_stub.hw_live, "%d hw instances",
+    g_stub.hw_live);
+  mm_jpeg_destroy_session_by_id(&obj, session_id);
+
+  /* the least recently parked one (q80) went first */
+  session_id = test_create(&obj, client_hdl, 81, 1);
+  TEST_CHECK(STUB_HW_MAX_INSTANCES + 1 == g_stub.hw_gets,
+    "recently parked session not reused");
+  mm_jpeg_destroy_session_by_id(&obj, session_id);
+  test_deinit(&obj, client_hdl);
+}
+
+int main(int argc, char *argv[])
+{
+  (void)argc;
+  (void)argv;
+
+  test_reuse();
+  test_generation();
+  test_flush();
+  test_instance_limit();
+
+  printf("%s\n", g_failures ? "FAILED" : "PASSED");
+  return g_failures ? 1 : 0;
+}
@@ -58,7 +58,10 @@ struct timeval dtime[2];
   } \
 })
 
-static int g_count = 1, g_i;
+#define MM_JPEGDEC_TEST_MAX_JOBS 64
+#define MM_JPEGDEC_TEST_MAX_BUFS 8
+
+static int g_count = 1, g_i, g_slices;
 
 typedef struct {
   char *filename;
@@ -66,6 +69,8 @@ typedef struct {
   int height;
   char *out_filename;
   int format;
+  int num_bufs;
+  int slice_height;
 } jpeg_test_input_t;
 
 static jpeg_test_input_t jpeg_input[] = {
@@ -81,11 +86,12 @@ typedef struct {
   pthread_mutex_t lock;
   pthread_cond_t cond;
   buffer_t input;
-  buffer_t output;
+  buffer_t output[MM_JPEGDEC_TEST_MAX_BUFS];
+  int num_bufs;
   int use_ion;
   uint32_t handle;
   mm_jpegdec_ops_t ops;
-  uint32_t job_id[5];
+  uint32_t job_id[MM_JPEGDEC_TEST_MAX_JOBS];
   mm_jpeg_decode_params_t params;
   mm_jpeg_job_t job;
   uint32_t session_id;
@@ -118,6 +124,7 @@ static void mm_jpegdec_decode_callback(jpeg_job_status_t status,
 {
   mm_jpegdec_intf_test_t *p_obj = (mm_jpegdec_intf_test_t *)userData;
 
+  pthread_mutex_lock(&p_obj->lock);
   if (status == JPEG_JOB_STATUS_ERROR) {
     CDBG_ERROR("%s:%d] Decode error", __func__, __LINE__);
   } else {
@@ -128,13 +135,31 @@ static void mm_jpegdec_decode_callback(jpeg_job_status_t status,
     CDBG_ERROR("%s:%d] Decode success file%s addr %p len %d",
       __func__, __LINE__, p_obj->out_filename,
       p_output->buf_vaddr, p_output->buf_filled_len);
-    DUMP_TO_FILE(p_obj->out_filename, p_output->buf_vaddr, p_output->buf_filled_len);
+    if (g_i == g_count - 1) {
+      DUMP_TO_FILE(p_obj->out_filename, p_output->buf_vaddr,
+        p_output->buf_filled_len);
+    }
   }
   g_i++;
   if (g_i >= g_count) {
     CDBG_ERROR("%s:%d] Signal the thread", __func__, __LINE__);
     pthread_cond_signal(&p_obj->cond);
   }
+  pthread_mutex_unlock(&p_obj->lock);
+}
+
+static void mm_jpegdec_slice_callback(uint32_t client_hdl,
+  uint32_t jobId,
+  mm_jpeg_output_t *p_output,
+  uint32_t rows,
+  void *userData)
+{
+  mm_jpegdec_intf_test_t *p_obj = (mm_jpegdec_intf_test_t *)userData;
+
+  pthread_mutex_lock(&p_obj->lock);
+  g_slices++;
+  pthread_mutex_unlock(&p_obj->lock);
+  CDBG("%s:%d] job %x rows %d", __func__, __LINE__, jobId, rows);
 }
 
 int mm_jpegdec_test_alloc(buffer_t *p_buffer, int use_pmem)
@@ -237,6 +262,7 @@ static int decode_init(jpeg_test_input_t *p_input, mm_jpegdec_intf_test_t *p_obj
   int rc = -1;
   int size = CEILING16(p_input->width) * CEILING16(p_input->height);
   float cScale;
+  int i;
   mm_jpeg_decode_params_t *p_params = &p_obj->params;
   mm_jpeg_decode_job_t *p_job_params = &p_obj->job.decode_job;
 
@@ -245,16 +271,19 @@ static int decode_init(jpeg_test_input_t *p_input, mm_jpegdec_intf_test_t *p_obj
   p_obj->height = p_input->height;
   p_obj->out_filename = p_input->out_filename;
   p_obj->use_ion = 1;
+  p_obj->num_bufs = CLAMP(p_input->num_bufs, 1, MM_JPEGDEC_TEST_MAX_BUFS);
 
   pthread_mutex_init(&p_obj->lock, NULL);
   pthread_cond_init(&p_obj->cond, NULL);
 
   chromaScale(p_input->format, &cScale);
-  p_obj->output.size = size * cScale;
-  rc = mm_jpegdec_test_alloc(&p_obj->output, p_obj->use_ion);
-  if (rc) {
-    CDBG_ERROR("%s:%d] Error",__func__, __LINE__);
-    return -1;
+  for (i = 0; i < p_obj->num_bufs; i++) {
+    p_obj->output[i].size = size * cScale;
+    rc = mm_jpegdec_test_alloc(&p_obj->output[i], p_obj->use_ion);
+    if (rc) {
+      CDBG_ERROR("%s:%d] Error",__func__, __LINE__);
+      return -1;
+    }
   }
 
   rc = mm_jpegdec_test_read(p_obj);
@@ -267,20 +296,26 @@ static int decode_init(jpeg_test_input_t *p_input, mm_jpegdec_intf_test_t *p_obj
   p_params->jpeg_cb = mm_jpegdec_decode_callback;
   p_params->userdata = p_obj;
   p_params->color_format = p_input->format;
+  if (p_input->slice_height > 0) {
+    p_params->jpeg_slice_cb = mm_jpegdec_slice_callback;
+    p_params->slice_height = p_input->slice_height;
+  }
 
-  /* dest buffer config */
-  p_params->dest_buf[0].buf_size = p_obj->output.size;
-  p_params->dest_buf[0].buf_vaddr = p_obj->output.addr;
-  p_params->dest_buf[0].fd = p_obj->output.p_pmem_fd;
-  p_params->dest_buf[0].format = MM_JPEG_FMT_YUV;
-  p_params->dest_buf[0].offset.mp[0].len = size;
-  p_params->dest_buf[0].offset.mp[1].len = size * (cScale-1.0);
-  p_params->dest_buf[0].offset.mp[0].stride = CEILING16(p_input->width);
-  p_params->dest_buf[0].offset.mp[0].scanline = CEILING16(p_input->height);
-  p_params->dest_buf[0].offset.mp[1].stride = CEILING16(p_input->width);
-  p_params->dest_buf[0].offset.mp[1].scanline = CEILING16(p_input->height);
-  p_params->dest_buf[0].index = 0;
-  p_params->num_dst_bufs = 1;
+  /* dest buffer config, jobs take turns */
+  for (i = 0; i < p_obj->num_bufs; i++) {
+    p_params->dest_buf[i].buf_size = p_obj->output[i].size;
+    p_params->dest_buf[i].buf_vaddr = p_obj->output[i].addr;
+    p_params->dest_buf[i].fd = p_obj->output[i].p_pmem_fd;
+    p_params->dest_buf[i].format = MM_JPEG_FMT_YUV;
+    p_params->dest_buf[i].offset.mp[0].len = size;
+    p_params->dest_buf[i].offset.mp[1].len = size * (cScale-1.0);
+    p_params->dest_buf[i].offset.mp[0].stride = CEILING16(p_input->width);
+    p_params->dest_buf[i].offset.mp[0].scanline = CEILING16(p_input->height);
+    p_params->dest_buf[i].offset.mp[1].stride = CEILING16(p_input->width);
+    p_params->dest_buf[i].offset.mp[1].scanline = CEILING16(p_input->height);
+    p_params->dest_buf[i].index = i;
+  }
+  p_params->num_dst_bufs = p_obj->num_bufs;
 
   /* src buffer config*/
   p_params->src_main_buf[0].buf_size = p_obj->input.size;
@@ -329,6 +364,9 @@ void omx_test_dec_print_usage()
     col_formats[4].format_str, col_formats[5].format_str,
     col_formats[6].format_str, col_formats[7].format_str
     );
+  fprintf(stderr, "  -n COUNT\t\tNumber of decodes, reports frames per second\n");
+  fprintf(stderr, "  -b BUFS\t\tOutput buffers, decodes run in parallel\n");
+  fprintf(stderr, "  -s ROWS\t\tReport decoded rows in slices of ROWS\n");
 
   fprintf(stderr, "\n");
 }
@@ -338,7 +376,8 @@ static int mm_jpegdec_test_get_input(int argc, char *argv[],
 {
   int c;
 
-  while ((c = getopt(argc, argv, "I:O:W:H:F:")) != -1) {
+  p_test->num_bufs = 1;
+  while ((c = getopt(argc, argv, "I:O:W:H:F:n:b:s:")) != -1) {
     switch (c) {
     case 'O':
       p_test->out_filename = optarg;
@@ -367,6 +406,18 @@ static int mm_jpegdec_test_get_input(int argc, char *argv[],
         col_formats[format].format_str);
       break;
     }
+    case 'n':
+      g_count = CLAMP(atoi(optarg), 1, MM_JPEGDEC_TEST_MAX_JOBS);
+      fprintf(stderr, "%-25s%d\n", "Decode count", g_count);
+      break;
+    case 'b':
+      p_test->num_bufs = atoi(optarg);
+      fprintf(stderr, "%-25s%d\n", "Output buffers", p_test->num_bufs);
+      break;
+    case 's':
+      p_test->slice_height = atoi(optarg);
+      fprintf(stderr, "%-25s%d\n", "Slice height", p_test->slice_height);
+      break;
     default:;
     }
   }
@@ -405,11 +456,12 @@ static int decode_test(jpeg_test_input_t *p_input)
     goto end;
   }
 
+  gettimeofday(&dtime[0], NULL);
   for (i = 0; i < g_count; i++) {
     jpeg_obj.job.job_type = JPEG_JOB_TYPE_DECODE;
+    jpeg_obj.job.decode_job.dst_index = i % jpeg_obj.num_bufs;
 
     CDBG_ERROR("%s:%d] Starting decode job",__func__, __LINE__);
-    gettimeofday(&dtime[0], NULL);
 
     fprintf(stderr, "Starting decode of %s into %s outw %d outh %d\n\n",
         p_input->filename, p_input->out_filename,
@@ -426,11 +478,18 @@ static int decode_test(jpeg_test_input_t *p_input)
   jpeg_obj.ops.abort_job(jpeg_obj.job_id[0]);
   */
   pthread_mutex_lock(&jpeg_obj.lock);
-  pthread_cond_wait(&jpeg_obj.cond, &jpeg_obj.lock);
+  while (g_i < g_count) {
+    pthread_cond_wait(&jpeg_obj.cond, &jpeg_obj.lock);
+  }
   pthread_mutex_unlock(&jpeg_obj.lock);
 
   fprintf(stderr, "Decode time %llu ms\n",
       ((TIME_IN_US(dtime[1]) - TIME_IN_US(dtime[0]))/1000));
+  if (TIME_IN_US(dtime[1]) > TIME_IN_US(dtime[0])) {
+    fprintf(stderr, "%d decodes %.2f fps, %d slices\n", g_count,
+      g_count * 1000000.0 / (TIME_IN_US(dtime[1]) - TIME_IN_US(dtime[0])),
+      g_slices);
+  }
 
 
   jpeg_obj.ops.destroy_session(jpeg_obj.job.decode_job.session_id);
@@ -440,7 +499,9 @@ static int decode_test(jpeg_test_input_t *p_input)
 
 end:
   mm_jpegdec_test_free(&jpeg_obj.input);
-  mm_jpegdec_test_free(&jpeg_obj.output);
+  for (i = 0; i < MM_JPEGDEC_TEST_MAX_BUFS; i++) {
+    mm_jpegdec_test_free(&jpeg_obj.output[i]);
+  }
   return 0;
 }
 
@@ -0,0 +1,236 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <string.h>
+#include <utils/Log.h>
+#include "QCameraCallbackMemoryRing.h"
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : QCameraCallbackMemoryRing
+ *
+ * DESCRIPTION: constructor of QCameraCallbackMemoryRing
+ *
+ * PARAMETERS :
+ *   @name    : name used in statistics logs
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraCallbackMemoryRing::QCameraCallbackMemoryRing(const char *name)
+    : mName(name),
+      mSize(0),
+      mNext(0),
+      mAllocCnt(0),
+      mReuseCnt(0),
+      mOverflowCnt(0)
+{
+    memset(mMemory, 0, sizeof(mMemory));
+    memset(mBusy, 0, sizeof(mBusy));
+    pthread_mutex_init(&mLock, NULL);
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraCallbackMemoryRing
+ *
+ * DESCRIPTION: deconstructor of QCameraCallbackMemoryRing
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraCallbackMemoryRing::~QCameraCallbackMemoryRing()
+{
+    clear();
+    pthread_mutex_destroy(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : get
+ *
+ * DESCRIPTION: get an idle buffer of the ring, allocating it on first use.
+ *              Falls back to a one-off allocation if all buffers are
+ *              still owned by pending callbacks.
+ *
+ * PARAMETERS :
+ *   @getMemory : camera memory allocation function
+ *   @size      : buffer size
+ *   @cbCookie  : callback cookie of the allocation function
+ *
+ * RETURN     : camera memory ptr
+ *              NULL if allocation failed
+ *==========================================================================*/
+camera_memory_t *QCameraCallbackMemoryRing::get(camera_request_memory getMemory,
+                                                size_t size,
+                                                void *cbCookie)
+{
+    camera_memory_t *mem = NULL;
+
+    if (NULL == getMemory) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&mLock);
+    if (size != mSize) {
+        // busy buffers of the old size are released in put()
+        for (int i = 0; i < QCAMERA_CB_MEM_RING_SIZE; i++) {
+            if (NULL != mMemory[i] && !mBusy[i]) {
+                mMemory[i]->release(mMemory[i]);
+            }
+            mMemory[i] = NULL;
+            mBusy[i] = false;
+        }
+        mSize = size;
+    }
+
+    for (int n = 0; n < QCAMERA_CB_MEM_RING_SIZE; n++) {
+        int i = (mNext + n) % QCAMERA_CB_MEM_RING_SIZE;
+        if (mBusy[i]) {
+            continue;
+        }
+        if (NULL == mMemory[i]) {
+            mMemory[i] = getMemory(-1, size, 1, cbCookie);
+            if (NULL == mMemory[i]) {
+                break;
+            }
+            mAllocCnt++;
+        } else {
+            mReuseCnt++;
+        }
+        mBusy[i] = true;
+        mNext = (i + 1) % QCAMERA_CB_MEM_RING_SIZE;
+        mem = mMemory[i];
+        break;
+    }
+    if (NULL == mem) {
+        mOverflowCnt++;
+    }
+    pthread_mutex_unlock(&mLock);
+
+    if (NULL == mem) {
+        ALOGV("%s: %s ring exhausted, one-off allocation", __func__, mName);
+        mem = getMemory(-1, size, 1, cbCookie);
+    }
+
+    return mem;
+}
+
+/*===========================================================================
+ * FUNCTION   : put
+ *
+ * DESCRIPTION: give a buffer back to the ring. Buffers which do not belong
+ *              to the ring are released.
+ *
+ * PARAMETERS :
+ *   @mem     : camera memory ptr
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCallbackMemoryRing::put(camera_memory_t *mem)
+{
+    bool found = false;
+
+    if (NULL == mem) {
+        return;
+    }
+
+    pthread_mutex_lock(&mLock);
+    for (int i = 0; i < QCAMERA_CB_MEM_RING_SIZE; i++) {
+        if (mMemory[i] == mem) {
+            mBusy[i] = false;
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+
+    if (!found) {
+        mem->release(mem);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : clear
+ *
+ * DESCRIPTION: release all idle buffers and log the ring statistics.
+ *              Buffers still in flight are released when they come back.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCallbackMemoryRing::clear()
+{
+    pthread_mutex_lock(&mLock);
+    if (mAllocCnt || mOverflowCnt) {
+        ALOGD("%s: %s ring: %u allocations, %u reuses, %u overflows",
+              __func__, mName, mAllocCnt, mReuseCnt, mOverflowCnt);
+    }
+    for (int i = 0; i < QCAMERA_CB_MEM_RING_SIZE; i++) {
+        if (NULL != mMemory[i] && !mBusy[i]) {
+            mMemory[i]->release(mMemory[i]);
+        }
+        mMemory[i] = NULL;
+        mBusy[i] = false;
+    }
+    mSize = 0;
+    mNext = 0;
+    mAllocCnt = 0;
+    mReuseCnt = 0;
+    mOverflowCnt = 0;
+    pthread_mutex_unlock(&mLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : releaseCallback
+ *
+ * DESCRIPTION: release function of callback arguments using ring buffers
+ *
+ * PARAMETERS :
+ *   @data    : camera memory ptr
+ *   @cookie  : ring the buffer belongs to
+ *   @cbStatus: callback status
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraCallbackMemoryRing::releaseCallback(void *data,
+                                                void *cookie,
+                                                int32_t /*cbStatus*/)
+{
+    QCameraCallbackMemoryRing *ring = (QCameraCallbackMemoryRing *)cookie;
+    camera_memory_t *mem = (camera_memory_t *)data;
+
+    if (NULL != ring) {
+        ring->put(mem);
+    } else if (NULL != mem) {
+        mem->release(mem);
+    }
+}
+
+}; // namespace qcamera
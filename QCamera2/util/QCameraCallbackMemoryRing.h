@@ -0,0 +1,78 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_CALLBACK_MEMORY_RING_H__
+#define __QCAMERA_CALLBACK_MEMORY_RING_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include <hardware/camera.h>
+
+namespace qcamera {
+
+// Ring of fixed size callback buffers for data sent with every frame.
+// Buffers are allocated once and handed back through the callback release
+// path, so steady state needs no allocations. When all buffers are in
+// flight a one-off buffer is used. A buffer is reused as soon as its
+// release callback ran, so only use the ring for callbacks whose receiver
+// is done with the data by then, i.e. copies it before the callback
+// returns.
+#define QCAMERA_CB_MEM_RING_SIZE 4
+
+class QCameraCallbackMemoryRing {
+
+public:
+
+    QCameraCallbackMemoryRing(const char *name);
+    virtual ~QCameraCallbackMemoryRing();
+
+    camera_memory_t *get(camera_request_memory getMemory,
+                         size_t size,
+                         void *cbCookie);
+    void put(camera_memory_t *mem);
+    void clear();
+
+    static void releaseCallback(void *data, void *cookie, int32_t cbStatus);
+
+protected:
+
+    const char *mName;
+    camera_memory_t *mMemory[QCAMERA_CB_MEM_RING_SIZE];
+    bool mBusy[QCAMERA_CB_MEM_RING_SIZE];
+    size_t mSize;
+    int mNext;
+    uint32_t mAllocCnt;
+    uint32_t mReuseCnt;
+    uint32_t mOverflowCnt;
+    pthread_mutex_t mLock;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_CALLBACK_MEMORY_RING_H__ */
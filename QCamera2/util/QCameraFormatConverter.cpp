@@ -0,0 +1,410 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "QCameraFormatConverter.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define QCAMERA_CONV_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define QCAMERA_CONV_SSE2
+#endif
+
+#define QCAMERA_CONV_ALIGN(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+namespace qcamera {
+
+static const char *kFormatNames[QCAMERA_YUV_FMT_MAX] = {
+    "nv21",
+    "nv12",
+    "yv12",
+};
+
+/*===========================================================================
+ * FUNCTION   : getPackedLayout
+ *
+ * DESCRIPTION: layout of a frame as apps expect it in preview callbacks.
+ *              NV21/NV12 rows carry no padding. YV12 follows the Android
+ *              definition with 16 byte aligned luma and chroma strides.
+ *
+ * PARAMETERS :
+ *   @fmt     : frame format
+ *   @width   : frame width
+ *   @height  : frame height
+ *   @layout  : [output] frame layout
+ *
+ * RETURN     : true -- layout is valid; false -- unsupported input
+ *==========================================================================*/
+bool QCameraFormatConverter::getPackedLayout(qcamera_yuv_fmt_t fmt,
+                                             int32_t width,
+                                             int32_t height,
+                                             qcamera_yuv_layout_t &layout)
+{
+    memset(&layout, 0, sizeof(layout));
+    if (((int)fmt < 0) || (fmt >= QCAMERA_YUV_FMT_MAX) || (width <= 0) || (height <= 0)) {
+        return false;
+    }
+
+    int32_t chromaRows = (height + 1) / 2;
+    layout.fmt = fmt;
+    layout.width = width;
+    layout.height = height;
+    if (QCAMERA_YUV_FMT_YV12 == fmt) {
+        layout.num_planes = 3;
+        layout.stride[0] = QCAMERA_CONV_ALIGN(width, 16);
+        layout.stride[1] = QCAMERA_CONV_ALIGN(layout.stride[0] / 2, 16);
+        layout.stride[2] = layout.stride[1];
+        layout.offset[0] = 0;
+        layout.offset[1] = layout.stride[0] * height;
+        layout.offset[2] = layout.offset[1] + layout.stride[1] * chromaRows;
+        layout.frame_len = layout.offset[2] + layout.stride[2] * chromaRows;
+    } else {
+        layout.num_planes = 2;
+        layout.stride[0] = width;
+        layout.stride[1] = 2 * ((width + 1) / 2);
+        layout.offset[0] = 0;
+        layout.offset[1] = width * height;
+        layout.frame_len = layout.offset[1] + layout.stride[1] * chromaRows;
+    }
+
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : isSameLayout
+ *
+ * DESCRIPTION: check whether a frame can be handed out as is
+ *
+ * PARAMETERS :
+ *   @a       : first layout
+ *   @b       : second layout
+ *
+ * RETURN     : true -- same format, planes and strides; false -- otherwise
+ *==========================================================================*/
+bool QCameraFormatConverter::isSameLayout(const qcamera_yuv_layout_t &a,
+                                          const qcamera_yuv_layout_t &b)
+{
+    if ((a.fmt != b.fmt) || (a.width != b.width) || (a.height != b.height) ||
+            (a.num_planes != b.num_planes)) {
+        return false;
+    }
+    for (int32_t i = 0; i < a.num_planes; i++) {
+        if ((a.offset[i] != b.offset[i]) || (a.stride[i] != b.stride[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : isValidLayout
+ *
+ * DESCRIPTION: check that all planes of a layout fit in its frame
+ *
+ * PARAMETERS :
+ *   @layout  : frame layout
+ *
+ * RETURN     : true -- valid; false -- otherwise
+ *==========================================================================*/
+bool QCameraFormatConverter::isValidLayout(const qcamera_yuv_layout_t &layout)
+{
+    if (((int)layout.fmt < 0) || (layout.fmt >= QCAMERA_YUV_FMT_MAX) ||
+            (layout.width <= 0) || (layout.height <= 0)) {
+        return false;
+    }
+
+    int32_t planes = (QCAMERA_YUV_FMT_YV12 == layout.fmt) ? 3 : 2;
+    int32_t chromaBytes = (layout.width + 1) / 2;
+    if (QCAMERA_YUV_FMT_YV12 != layout.fmt) {
+        chromaBytes *= 2;
+    }
+    if (layout.num_planes != planes) {
+        return false;
+    }
+    for (int32_t i = 0; i < planes; i++) {
+        int32_t bytes = (0 == i) ? layout.width : chromaBytes;
+        int32_t rows = (0 == i) ? layout.height : (layout.height + 1) / 2;
+        if (layout.stride[i] < bytes) {
+            return false;
+        }
+        uint64_t end = (uint64_t)layout.offset[i] +
+            (uint64_t)layout.stride[i] * (rows - 1) + bytes;
+        if (end > layout.frame_len) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : convert
+ *
+ * DESCRIPTION: convert a frame from one layout into another of the same
+ *              size. Bytes of the destination outside the planes (stride
+ *              padding) are left untouched.
+ *
+ * PARAMETERS :
+ *   @src       : source frame
+ *   @srcLayout : layout of the source frame
+ *   @dst       : destination frame
+ *   @dstLayout : layout of the destination frame
+ *
+ * RETURN     : true -- converted; false -- invalid or mismatching layouts
+ *==========================================================================*/
+bool QCameraFormatConverter::convert(const uint8_t *src,
+                                     const qcamera_yuv_layout_t &srcLayout,
+                                     uint8_t *dst,
+                                     const qcamera_yuv_layout_t &dstLayout)
+{
+    if ((NULL == src) || (NULL == dst) ||
+            !isValidLayout(srcLayout) || !isValidLayout(dstLayout) ||
+            (srcLayout.width != dstLayout.width) ||
+            (srcLayout.height != dstLayout.height)) {
+        return false;
+    }
+
+    const int32_t width = srcLayout.width;
+    const int32_t height = srcLayout.height;
+    const int32_t pairs = (width + 1) / 2;
+    const int32_t chromaRows = (height + 1) / 2;
+    const bool srcSemiPlanar = (QCAMERA_YUV_FMT_YV12 != srcLayout.fmt);
+    const bool dstSemiPlanar = (QCAMERA_YUV_FMT_YV12 != dstLayout.fmt);
+    const uint8_t *srcC = src + srcLayout.offset[1];
+    uint8_t *dstC = dst + dstLayout.offset[1];
+
+    copyPlane(src + srcLayout.offset[0], srcLayout.stride[0],
+              dst + dstLayout.offset[0], dstLayout.stride[0],
+              width, height);
+
+    if (srcSemiPlanar && dstSemiPlanar) {
+        if (srcLayout.fmt == dstLayout.fmt) {
+            copyPlane(srcC, srcLayout.stride[1], dstC, dstLayout.stride[1],
+                      2 * pairs, chromaRows);
+        } else {
+            for (int32_t r = 0; r < chromaRows; r++) {
+                swapRow(srcC + r * srcLayout.stride[1],
+                        dstC + r * dstLayout.stride[1], pairs);
+            }
+        }
+    } else if (srcSemiPlanar) {
+        // YV12 keeps Cr in plane 1 and Cb in plane 2, NV21 leads with Cr
+        int32_t first = (QCAMERA_YUV_FMT_NV21 == srcLayout.fmt) ? 1 : 2;
+        int32_t second = 3 - first;
+        for (int32_t r = 0; r < chromaRows; r++) {
+            splitRow(srcC + r * srcLayout.stride[1],
+                     dst + dstLayout.offset[first] + r * dstLayout.stride[first],
+                     dst + dstLayout.offset[second] + r * dstLayout.stride[second],
+                     pairs);
+        }
+    } else if (dstSemiPlanar) {
+        int32_t first = (QCAMERA_YUV_FMT_NV21 == dstLayout.fmt) ? 1 : 2;
+        int32_t second = 3 - first;
+        for (int32_t r = 0; r < chromaRows; r++) {
+            mergeRow(src + srcLayout.offset[first] + r * srcLayout.stride[first],
+                     src + srcLayout.offset[second] + r * srcLayout.stride[second],
+                     dstC + r * dstLayout.stride[1], pairs);
+        }
+    } else {
+        for (int32_t i = 1; i < 3; i++) {
+            copyPlane(src + srcLayout.offset[i], srcLayout.stride[i],
+                      dst + dstLayout.offset[i], dstLayout.stride[i],
+                      pairs, chromaRows);
+        }
+    }
+
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : getFormatName
+ *
+ * DESCRIPTION: printable name of a format
+ *
+ * PARAMETERS :
+ *   @fmt     : frame format
+ *
+ * RETURN     : format name
+ *==========================================================================*/
+const char *QCameraFormatConverter::getFormatName(qcamera_yuv_fmt_t fmt)
+{
+    if (((int)fmt < 0) || (fmt >= QCAMERA_YUV_FMT_MAX)) {
+        return "unknown";
+    }
+    return kFormatNames[fmt];
+}
+
+/*===========================================================================
+ * FUNCTION   : copyPlane
+ *
+ * DESCRIPTION: copy a plane row by row dropping the stride padding, in one
+ *              go if neither side is padded
+ *
+ * PARAMETERS :
+ *   @src       : first row of the source plane
+ *   @srcStride : bytes per source row
+ *   @dst       : first row of the destination plane
+ *   @dstStride : bytes per destination row
+ *   @bytes     : bytes to copy per row
+ *   @rows      : rows to copy
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFormatConverter::copyPlane(const uint8_t *src, int32_t srcStride,
+                                       uint8_t *dst, int32_t dstStride,
+                                       int32_t bytes, int32_t rows)
+{
+    if ((srcStride == bytes) && (dstStride == bytes)) {
+        memcpy(dst, src, (size_t)bytes * rows);
+        return;
+    }
+    for (int32_t r = 0; r < rows; r++) {
+        memcpy(dst + r * dstStride, src + r * srcStride, bytes);
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : swapRow
+ *
+ * DESCRIPTION: swap the bytes of each chroma pair of a row, NV12 <-> NV21
+ *
+ * PARAMETERS :
+ *   @src     : source row
+ *   @dst     : destination row
+ *   @pairs   : chroma pairs in the row
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFormatConverter::swapRow(const uint8_t *src, uint8_t *dst,
+                                     int32_t pairs)
+{
+    int32_t i = 0;
+#if defined(QCAMERA_CONV_NEON)
+    for (; i + 16 <= pairs; i += 16) {
+        uint8x16x2_t in = vld2q_u8(src + 2 * i);
+        uint8x16x2_t out;
+        out.val[0] = in.val[1];
+        out.val[1] = in.val[0];
+        vst2q_u8(dst + 2 * i, out);
+    }
+#elif defined(QCAMERA_CONV_SSE2)
+    for (; i + 8 <= pairs; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), v);
+    }
+#endif
+    for (; i < pairs; i++) {
+        dst[2 * i] = src[2 * i + 1];
+        dst[2 * i + 1] = src[2 * i];
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : splitRow
+ *
+ * DESCRIPTION: split an interleaved chroma row into two planar rows
+ *
+ * PARAMETERS :
+ *   @src     : interleaved source row
+ *   @dst0    : destination of the first byte of each pair
+ *   @dst1    : destination of the second byte of each pair
+ *   @pairs   : chroma pairs in the row
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFormatConverter::splitRow(const uint8_t *src, uint8_t *dst0,
+                                      uint8_t *dst1, int32_t pairs)
+{
+    int32_t i = 0;
+#if defined(QCAMERA_CONV_NEON)
+    for (; i + 16 <= pairs; i += 16) {
+        uint8x16x2_t in = vld2q_u8(src + 2 * i);
+        vst1q_u8(dst0 + i, in.val[0]);
+        vst1q_u8(dst1 + i, in.val[1]);
+    }
+#elif defined(QCAMERA_CONV_SSE2)
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    for (; i + 16 <= pairs; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
+        __m128i first = _mm_packus_epi16(_mm_and_si128(a, mask),
+                                         _mm_and_si128(b, mask));
+        __m128i second = _mm_packus_epi16(_mm_srli_epi16(a, 8),
+                                          _mm_srli_epi16(b, 8));
+        _mm_storeu_si128((__m128i *)(dst0 + i), first);
+        _mm_storeu_si128((__m128i *)(dst1 + i), second);
+    }
+#endif
+    for (; i < pairs; i++) {
+        dst0[i] = src[2 * i];
+        dst1[i] = src[2 * i + 1];
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : mergeRow
+ *
+ * DESCRIPTION: interleave two planar chroma rows into one
+ *
+ * PARAMETERS :
+ *   @src0    : source of the first byte of each pair
+ *   @src1    : source of the second byte of each pair
+ *   @dst     : interleaved destination row
+ *   @pairs   : chroma pairs in the row
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFormatConverter::mergeRow(const uint8_t *src0, const uint8_t *src1,
+                                      uint8_t *dst, int32_t pairs)
+{
+    int32_t i = 0;
+#if defined(QCAMERA_CONV_NEON)
+    for (; i + 16 <= pairs; i += 16) {
+        uint8x16x2_t out;
+        out.val[0] = vld1q_u8(src0 + i);
+        out.val[1] = vld1q_u8(src1 + i);
+        vst2q_u8(dst + 2 * i, out);
+    }
+#elif defined(QCAMERA_CONV_SSE2)
+    for (; i + 16 <= pairs; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(src0 + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src1 + i));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(a, b));
+    }
+#endif
+    for (; i < pairs; i++) {
+        dst[2 * i] = src0[i];
+        dst[2 * i + 1] = src1[i];
+    }
+}
+
+}; // namespace qcamera
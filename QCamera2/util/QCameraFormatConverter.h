@@ -0,0 +1,84 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_FORMAT_CONVERTER_H__
+#define __QCAMERA_FORMAT_CONVERTER_H__
+
+#include <stdint.h>
+
+namespace qcamera {
+
+/* 8 bit 4:2:0 YUV formats handed out with preview callbacks */
+typedef enum {
+    QCAMERA_YUV_FMT_NV21,   // Y plane, interleaved CrCb plane
+    QCAMERA_YUV_FMT_NV12,   // Y plane, interleaved CbCr plane
+    QCAMERA_YUV_FMT_YV12,   // Y plane, Cr plane, Cb plane
+    QCAMERA_YUV_FMT_MAX
+} qcamera_yuv_fmt_t;
+
+/* Plane layout of a frame in a buffer */
+typedef struct {
+    qcamera_yuv_fmt_t fmt;
+    int32_t width;
+    int32_t height;
+    int32_t num_planes;     // 2 for NV21/NV12, 3 for YV12
+    uint32_t offset[3];     // start of each plane in the buffer
+    int32_t stride[3];      // bytes per row of each plane
+    uint32_t frame_len;     // bytes covered by the frame
+} qcamera_yuv_layout_t;
+
+/* Converts frames between plane layouts: removes stride/scanline padding,
+ * swaps NV12/NV21 chroma and splits or merges chroma for YV12. Rows are
+ * processed with NEON or SSE2 where available. Output is bit exact with a
+ * plain per pixel conversion. Stateless and thread safe. */
+class QCameraFormatConverter {
+public:
+    static bool getPackedLayout(qcamera_yuv_fmt_t fmt, int32_t width,
+                                int32_t height, qcamera_yuv_layout_t &layout);
+    static bool isSameLayout(const qcamera_yuv_layout_t &a,
+                             const qcamera_yuv_layout_t &b);
+    static bool convert(const uint8_t *src, const qcamera_yuv_layout_t &srcLayout,
+                        uint8_t *dst, const qcamera_yuv_layout_t &dstLayout);
+    static const char *getFormatName(qcamera_yuv_fmt_t fmt);
+
+private:
+    static bool isValidLayout(const qcamera_yuv_layout_t &layout);
+    static void copyPlane(const uint8_t *src, int32_t srcStride,
+                          uint8_t *dst, int32_t dstStride,
+                          int32_t bytes, int32_t rows);
+    static void swapRow(const uint8_t *src, uint8_t *dst, int32_t pairs);
+    static void splitRow(const uint8_t *src, uint8_t *dst0, uint8_t *dst1,
+                         int32_t pairs);
+    static void mergeRow(const uint8_t *src0, const uint8_t *src1,
+                         uint8_t *dst, int32_t pairs);
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_FORMAT_CONVERTER_H__ */
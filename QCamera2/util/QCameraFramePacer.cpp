@@ -0,0 +1,175 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+#include "QCameraFramePacer.h"
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : QCameraFramePacer
+ *
+ * DESCRIPTION: constructor of QCameraFramePacer
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraFramePacer::QCameraFramePacer()
+    : m_nLatency(0)
+{
+    reset();
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraFramePacer
+ *
+ * DESCRIPTION: deconstructor of QCameraFramePacer
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraFramePacer::~QCameraFramePacer()
+{
+}
+
+/*===========================================================================
+ * FUNCTION   : reset
+ *
+ * DESCRIPTION: forget timing history and stats, e.g. when preview starts.
+ *              The latency setting is kept.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFramePacer::reset()
+{
+    m_timing.reset();
+    m_bScheduled = false;
+    m_nMinDelay = 0;
+    m_nLastTarget = 0;
+    m_nLateFrames = 0;
+    m_bDisplayed = false;
+    m_nLastSensorTs = 0;
+    m_nLastArrival = 0;
+    m_nLastDisplay = 0;
+    m_arrivalJitter.reset();
+    m_displayJitter.reset();
+}
+
+/*===========================================================================
+ * FUNCTION   : setLatency
+ *
+ * DESCRIPTION: set how long frames may wait for delivery jitter to settle
+ *
+ * PARAMETERS :
+ *   @latency : time added to the smallest delivery delay, nsec. 0 or less
+ *              uses half a frame interval.
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFramePacer::setLatency(int64_t latency)
+{
+    m_nLatency = (latency > 0) ? latency : 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : schedule
+ *
+ * DESCRIPTION: display time of a new frame. Has to be called in delivery
+ *              order. The smallest delivery delay follows a shorter delay
+ *              right away and a longer one by 1/kDelayCreep per frame, so
+ *              it settles on the low end of the delivery jitter while still
+ *              following a lasting change of the pipeline depth.
+ *
+ * PARAMETERS :
+ *   @frameIdx : frame index
+ *   @sensorTs : sensor timestamp, nsec
+ *   @arrival  : time the frame was delivered, nsec
+ *
+ * RETURN     : display time, nsec, same clock as arrival
+ *==========================================================================*/
+int64_t QCameraFramePacer::schedule(uint32_t frameIdx, int64_t sensorTs,
+        int64_t arrival)
+{
+    m_timing.update(frameIdx, sensorTs);
+    int64_t interval = m_timing.getFrameInterval();
+
+    int64_t delay = arrival - sensorTs;
+    if (!m_bScheduled || delay < m_nMinDelay) {
+        m_nMinDelay = delay;
+    } else {
+        m_nMinDelay += (delay - m_nMinDelay) / kDelayCreep;
+    }
+
+    int64_t latency = (m_nLatency > 0) ? m_nLatency : interval / 2;
+    int64_t target = sensorTs + m_nMinDelay + latency;
+    if (m_bScheduled && target < m_nLastTarget + interval / 2) {
+        target = m_nLastTarget + interval / 2;
+    }
+    if (target < arrival) {
+        target = arrival;
+        m_nLateFrames++;
+    }
+    m_bScheduled = true;
+    m_nLastTarget = target;
+
+    return target;
+}
+
+/*===========================================================================
+ * FUNCTION   : displayed
+ *
+ * DESCRIPTION: account a frame handed to the display. The interval to the
+ *              previous frame, on arrival and on display, is compared with
+ *              the sensor interval. Used with and without pacing.
+ *
+ * PARAMETERS :
+ *   @sensorTs : sensor timestamp, nsec
+ *   @arrival  : time the frame was delivered, nsec
+ *   @now      : time the frame was displayed, nsec
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFramePacer::displayed(int64_t sensorTs, int64_t arrival, int64_t now)
+{
+    if (m_bDisplayed && sensorTs > m_nLastSensorTs) {
+        int64_t expected = sensorTs - m_nLastSensorTs;
+        m_arrivalJitter.add(llabs(arrival - m_nLastArrival - expected) / 1000);
+        m_displayJitter.add(llabs(now - m_nLastDisplay - expected) / 1000);
+    }
+    m_bDisplayed = true;
+    m_nLastSensorTs = sensorTs;
+    m_nLastArrival = arrival;
+    m_nLastDisplay = now;
+}
+
+}; // namespace qcamera
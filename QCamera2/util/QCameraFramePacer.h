@@ -0,0 +1,79 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_FRAME_PACER_H__
+#define __QCAMERA_FRAME_PACER_H__
+
+#include <stdint.h>
+#include "QCameraFrameTiming.h"
+#include "QCameraLatencyStats.h"
+
+namespace qcamera {
+
+/* Jitter buffer for preview display. Frames are given display times that
+ * keep the cadence of their sensor timestamps: the sensor timestamp plus
+ * the smallest delivery delay seen recently plus a fixed latency, and at
+ * least half a frame interval after the previous frame. Frames delivered
+ * after their slot are displayed on arrival. Also measures how far frame
+ * intervals on arrival and on display stray from the sensor intervals.
+ * Not thread safe, callers serialize access. */
+class QCameraFramePacer {
+public:
+    QCameraFramePacer();
+    virtual ~QCameraFramePacer();
+
+    void reset();
+    void setLatency(int64_t latency);
+    int64_t schedule(uint32_t frameIdx, int64_t sensorTs, int64_t arrival);
+    void displayed(int64_t sensorTs, int64_t arrival, int64_t now);
+    int64_t getFrameInterval() const { return m_timing.getFrameInterval(); };
+    uint32_t getLateFrames() const { return m_nLateFrames; };
+    QCameraLatencyStats &getArrivalJitter() { return m_arrivalJitter; };
+    QCameraLatencyStats &getDisplayJitter() { return m_displayJitter; };
+
+    static const int64_t kDelayCreep = 128;  // 1/n of a longer delay taken per frame
+
+private:
+    QCameraFrameTiming m_timing;    // sensor frame interval
+    int64_t m_nLatency;             // jitter buffer depth, 0 for half an interval
+    bool m_bScheduled;              // min delay and last target are valid
+    int64_t m_nMinDelay;            // sensor to arrival delay, low end
+    int64_t m_nLastTarget;          // display time of the previous frame
+    uint32_t m_nLateFrames;         // frames delivered after their slot
+    bool m_bDisplayed;              // last display times are valid
+    int64_t m_nLastSensorTs;        // previous displayed frame
+    int64_t m_nLastArrival;
+    int64_t m_nLastDisplay;
+    QCameraLatencyStats m_arrivalJitter;    // usec
+    QCameraLatencyStats m_displayJitter;    // usec
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_FRAME_PACER_H__ */
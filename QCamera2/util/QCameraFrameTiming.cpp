@@ -0,0 +1,201 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <stdlib.h>
+#include "QCameraFrameTiming.h"
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : QCameraFrameTiming
+ *
+ * DESCRIPTION: constructor of QCameraFrameTiming
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraFrameTiming::QCameraFrameTiming()
+{
+    reset();
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraFrameTiming
+ *
+ * DESCRIPTION: deconstructor of QCameraFrameTiming
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraFrameTiming::~QCameraFrameTiming()
+{
+}
+
+/*===========================================================================
+ * FUNCTION   : reset
+ *
+ * DESCRIPTION: drop all timing history, e.g. on stream reconfiguration
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFrameTiming::reset()
+{
+    m_bAnchorValid = false;
+    m_nAnchorFrame = 0;
+    m_nAnchorTimestamp = 0;
+    m_nInterval = 0;
+    m_nFrameDuration = 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : update
+ *
+ * DESCRIPTION: feed the sensor timestamp of a frame into the model. The
+ *              per frame interval measured against the previous anchor is
+ *              smoothed, while a jump of more than 25% (fps switch) makes
+ *              the model re-lock to the new interval immediately.
+ *
+ * PARAMETERS :
+ *   @frameNumber : frame number the timestamp belongs to
+ *   @timestamp   : sensor timestamp in nsec
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFrameTiming::update(uint32_t frameNumber, int64_t timestamp)
+{
+    if (timestamp <= 0) {
+        return;
+    }
+
+    if (!m_bAnchorValid) {
+        m_bAnchorValid = true;
+        m_nAnchorFrame = frameNumber;
+        m_nAnchorTimestamp = timestamp;
+        return;
+    }
+
+    if (frameNumber <= m_nAnchorFrame) {
+        // same or older frame, nothing new to learn
+        return;
+    }
+
+    int64_t delta = timestamp - m_nAnchorTimestamp;
+    if (delta > 0) {
+        int64_t observed = delta / (int64_t)(frameNumber - m_nAnchorFrame);
+        if (observed <= kMaxFrameInterval) {
+            if (m_nInterval == 0 ||
+                llabs(observed - m_nInterval) > m_nInterval / 4) {
+                m_nInterval = observed;
+            } else {
+                m_nInterval += (observed - m_nInterval) / 8;
+            }
+        }
+    }
+
+    m_nAnchorFrame = frameNumber;
+    m_nAnchorTimestamp = timestamp;
+}
+
+/*===========================================================================
+ * FUNCTION   : setFrameDuration
+ *
+ * DESCRIPTION: feed the sensor frame duration reported by metadata. A
+ *              duration close to the measured interval is blended into it,
+ *              a jump of more than 25% (fps switch, long exposure) re-seeds
+ *              the interval from it until the next timestamps refine it.
+ *
+ * PARAMETERS :
+ *   @frameDuration : sensor frame duration in nsec
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraFrameTiming::setFrameDuration(int64_t frameDuration)
+{
+    if (frameDuration <= 0 || frameDuration > kMaxFrameInterval) {
+        return;
+    }
+
+    m_nFrameDuration = frameDuration;
+    if (m_nInterval == 0) {
+        return;
+    }
+
+    if (llabs(frameDuration - m_nInterval) > m_nInterval / 4) {
+        m_nInterval = frameDuration;
+    } else {
+        m_nInterval += (frameDuration - m_nInterval) / 4;
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : getFrameInterval
+ *
+ * DESCRIPTION: get the current best estimate of the sensor frame interval
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : frame interval in nsec
+ *==========================================================================*/
+int64_t QCameraFrameTiming::getFrameInterval() const
+{
+    if (m_nInterval > 0) {
+        return m_nInterval;
+    }
+    if (m_nFrameDuration > 0) {
+        return m_nFrameDuration;
+    }
+    return kDefaultFrameInterval;
+}
+
+/*===========================================================================
+ * FUNCTION   : estimateTimestamp
+ *
+ * DESCRIPTION: extrapolate the sensor timestamp of a frame from the latest
+ *              anchor frame and the current frame interval
+ *
+ * PARAMETERS :
+ *   @frameNumber : frame number to estimate the timestamp for
+ *
+ * RETURN     : estimated timestamp in nsec, 0 if no anchor is known yet
+ *==========================================================================*/
+int64_t QCameraFrameTiming::estimateTimestamp(uint32_t frameNumber) const
+{
+    if (!m_bAnchorValid) {
+        return 0;
+    }
+
+    int64_t frames = (int64_t)frameNumber - (int64_t)m_nAnchorFrame;
+    return m_nAnchorTimestamp + frames * getFrameInterval();
+}
+
+}; // namespace qcamera
@@ -0,0 +1,67 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_FRAME_TIMING_H__
+#define __QCAMERA_FRAME_TIMING_H__
+
+#include <stdint.h>
+
+namespace qcamera {
+
+/* Frame timing model of a camera session. It learns the sensor frame
+ * interval from the deltas of consecutive sensor timestamps (falling back
+ * to the frame duration reported in metadata) so that timestamps of frames
+ * without their own metadata can be extrapolated. Not thread safe, callers
+ * serialize access. */
+class QCameraFrameTiming {
+public:
+    QCameraFrameTiming();
+    virtual ~QCameraFrameTiming();
+
+    void reset();
+    void update(uint32_t frameNumber, int64_t timestamp);
+    void setFrameDuration(int64_t frameDuration);
+    int64_t getFrameInterval() const;
+    int64_t estimateTimestamp(uint32_t frameNumber) const;
+    bool isValid() const { return m_bAnchorValid; }
+
+    static const int64_t kDefaultFrameInterval = 33000000LL;  // 30 fps
+    static const int64_t kMaxFrameInterval = 4000000000LL;    // 4 sec exposure
+
+private:
+    bool m_bAnchorValid;        // anchor frame/timestamp are valid
+    uint32_t m_nAnchorFrame;    // latest frame number with a sensor timestamp
+    int64_t m_nAnchorTimestamp; // sensor timestamp of the anchor frame
+    int64_t m_nInterval;        // smoothed measured frame interval, 0 if unknown
+    int64_t m_nFrameDuration;   // frame duration reported by metadata, 0 if unknown
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_FRAME_TIMING_H__ */
@@ -0,0 +1,241 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utils/Errors.h>
+#include <utils/Log.h>
+#include "QCameraJobPool.h"
+
+using namespace android;
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : QCameraJobPool
+ *
+ * DESCRIPTION: constructor of QCameraJobPool
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraJobPool::QCameraJobPool()
+    : m_nWorkers(0)
+{
+    memset(m_name, 0, sizeof(m_name));
+    cam_sem_init(&m_doneSem, 0);
+    pthread_mutex_init(&m_runLock, NULL);
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraJobPool
+ *
+ * DESCRIPTION: deconstructor of QCameraJobPool
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraJobPool::~QCameraJobPool()
+{
+    deinit();
+    pthread_mutex_destroy(&m_runLock);
+    cam_sem_destroy(&m_doneSem);
+}
+
+/*===========================================================================
+ * FUNCTION   : init
+ *
+ * DESCRIPTION: launch the worker threads
+ *
+ * PARAMETERS :
+ *   @numWorkers : number of workers, at most QCAMERA_JOB_POOL_MAX_WORKERS
+ *   @name       : thread name prefix
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraJobPool::init(uint32_t numWorkers, const char *name)
+{
+    if ((m_nWorkers > 0) || (numWorkers == 0) ||
+            (numWorkers > QCAMERA_JOB_POOL_MAX_WORKERS)) {
+        ALOGE("%s: invalid worker count %d", __func__, numWorkers);
+        return BAD_VALUE;
+    }
+
+    strncpy(m_name, (NULL != name) ? name : "CAM_jobPool", sizeof(m_name) - 1);
+    for (uint32_t i = 0; i < numWorkers; i++) {
+        m_workers[i].pool = this;
+        m_workers[i].thread.launch(workerRoutine, &m_workers[i]);
+    }
+    m_nWorkers = numWorkers;
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : deinit
+ *
+ * DESCRIPTION: stop and join the worker threads
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraJobPool::deinit()
+{
+    pthread_mutex_lock(&m_runLock);
+    for (uint32_t i = 0; i < m_nWorkers; i++) {
+        m_workers[i].thread.exit();
+    }
+    m_nWorkers = 0;
+    m_jobQ.flush();
+    pthread_mutex_unlock(&m_runLock);
+}
+
+/*===========================================================================
+ * FUNCTION   : run
+ *
+ * DESCRIPTION: run one job per data pointer on the workers and wait for all
+ *              of them. Jobs that cannot be queued run on the caller.
+ *
+ * PARAMETERS :
+ *   @fn    : job function
+ *   @data  : array of job data, one job each
+ *   @count : number of jobs
+ *
+ * RETURN     : int32_t type of status
+ *              NO_ERROR  -- success
+ *              none-zero failure code
+ *==========================================================================*/
+int32_t QCameraJobPool::run(job_pool_fn_t fn, void **data, uint32_t count)
+{
+    uint32_t queued = 0;
+
+    if ((NULL == fn) || ((NULL == data) && (count > 0))) {
+        return BAD_VALUE;
+    }
+
+    pthread_mutex_lock(&m_runLock);
+    for (uint32_t i = 0; i < count; i++) {
+        job_pool_job_t *job = NULL;
+        if (m_nWorkers > 0) {
+            job = (job_pool_job_t *)malloc(sizeof(job_pool_job_t));
+        }
+        if ((NULL != job)) {
+            job->fn = fn;
+            job->data = data[i];
+            if (m_jobQ.enqueue(job)) {
+                queued++;
+                continue;
+            }
+            free(job);
+        }
+        fn(data[i]);
+    }
+
+    // each woken worker drains the queue until it is empty
+    for (uint32_t i = 0; (i < m_nWorkers) && (i < queued); i++) {
+        m_workers[i].thread.sendCmd(CAMERA_CMD_TYPE_DO_NEXT_JOB, 0, 0);
+    }
+    for (uint32_t i = 0; i < queued; i++) {
+        cam_sem_wait(&m_doneSem);
+    }
+    pthread_mutex_unlock(&m_runLock);
+    return NO_ERROR;
+}
+
+/*===========================================================================
+ * FUNCTION   : runJobs
+ *
+ * DESCRIPTION: run queued jobs until the queue is empty
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraJobPool::runJobs()
+{
+    job_pool_job_t *job = (job_pool_job_t *)m_jobQ.dequeue();
+    while (NULL != job) {
+        job->fn(job->data);
+        free(job);
+        cam_sem_post(&m_doneSem);
+        job = (job_pool_job_t *)m_jobQ.dequeue();
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : workerRoutine
+ *
+ * DESCRIPTION: worker thread routine
+ *
+ * PARAMETERS :
+ *   @data    : job_pool_worker_t of this worker
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void *QCameraJobPool::workerRoutine(void *data)
+{
+    int running = 1;
+    int ret;
+    job_pool_worker_t *worker = (job_pool_worker_t *)data;
+    QCameraCmdThread *cmdThread = &worker->thread;
+    cmdThread->setName(worker->pool->m_name);
+
+    do {
+        do {
+            ret = cam_sem_wait(&cmdThread->cmd_sem);
+            if (ret != 0 && errno != EINVAL) {
+                ALOGE("%s: cam_sem_wait error (%s)",
+                           __func__, strerror(errno));
+                return NULL;
+            }
+        } while (ret != 0);
+
+        camera_cmd_type_t cmd = cmdThread->getCmd();
+        switch (cmd) {
+        case CAMERA_CMD_TYPE_DO_NEXT_JOB:
+            worker->pool->runJobs();
+            break;
+        case CAMERA_CMD_TYPE_EXIT:
+            running = 0;
+            break;
+        default:
+            break;
+        }
+    } while (running);
+
+    return NULL;
+}
+
+}; // namespace qcamera
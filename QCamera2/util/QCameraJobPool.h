@@ -0,0 +1,82 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_JOB_POOL_H__
+#define __QCAMERA_JOB_POOL_H__
+
+#include <pthread.h>
+#include <cam_semaphore.h>
+
+#include "QCameraCmdThread.h"
+
+namespace qcamera {
+
+#define QCAMERA_JOB_POOL_MAX_WORKERS 8
+
+typedef void (*job_pool_fn_t)(void *data);
+
+/* Fixed set of worker threads running a batch of jobs in parallel. The
+ * workers are launched once by init() and sleep on their cmd semaphore
+ * between batches, so a batch costs no thread creation. run() blocks
+ * until every job of the batch returned; one batch runs at a time. */
+class QCameraJobPool {
+public:
+    QCameraJobPool();
+    virtual ~QCameraJobPool();
+
+    int32_t init(uint32_t numWorkers, const char *name);
+    void deinit();
+    int32_t run(job_pool_fn_t fn, void **data, uint32_t count);
+    uint32_t getNumWorkers() const { return m_nWorkers; }
+
+private:
+    typedef struct {
+        job_pool_fn_t fn;
+        void *data;
+    } job_pool_job_t;
+
+    typedef struct {
+        QCameraJobPool *pool;
+        QCameraCmdThread thread;
+    } job_pool_worker_t;
+
+    static void *workerRoutine(void *data);
+    void runJobs();
+
+    job_pool_worker_t m_workers[QCAMERA_JOB_POOL_MAX_WORKERS];
+    uint32_t m_nWorkers;
+    char m_name[16];
+    QCameraQueue m_jobQ;
+    cam_semaphore_t m_doneSem;       // posted once per finished job
+    pthread_mutex_t m_runLock;       // serializes batches
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_JOB_POOL_H__ */
@@ -0,0 +1,270 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*     * Redistributions of source code must retain the above copyright
+*       notice, this list of conditions and the following disclaimer.
+*     * Redistributions in binary form must reproduce the above
+*       copyright notice, this list of conditions and the following
+*       disclaimer in the documentation and/or other materials provided
+*       with the distribution.
+*     * Neither the name of The Linux Foundation nor the names of its
+*       contributors may be used to endorse or promote products derived
+*       from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*/
+
+#include <string.h>
+#include "QCameraLatencyStats.h"
+
+namespace qcamera {
+
+/*===========================================================================
+ * FUNCTION   : QCameraLatencyStats
+ *
+ * DESCRIPTION: constructor of QCameraLatencyStats
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraLatencyStats::QCameraLatencyStats()
+{
+    pthread_mutex_init(&m_lock, NULL);
+    reset();
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraLatencyStats
+ *
+ * DESCRIPTION: deconstructor of QCameraLatencyStats
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraLatencyStats::~QCameraLatencyStats()
+{
+    pthread_mutex_destroy(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : getBucket
+ *
+ * DESCRIPTION: map a sample value to its histogram bucket
+ *
+ * PARAMETERS :
+ *   @value   : sample value
+ *
+ * RETURN     : bucket index
+ *==========================================================================*/
+uint32_t QCameraLatencyStats::getBucket(int64_t value)
+{
+    if (value < LINEAR_BUCKETS) {
+        return (value < 0) ? 0 : (uint32_t)value;
+    }
+
+    uint32_t msb = 63 - __builtin_clzll((uint64_t)value);
+    uint32_t sub = (uint32_t)(value >> (msb - 2)) & (SUB_BUCKETS - 1);
+    uint32_t bucket = LINEAR_BUCKETS + (msb - 4) * SUB_BUCKETS + sub;
+    if (bucket >= MAX_BUCKETS) {
+        bucket = MAX_BUCKETS - 1;
+    }
+    return bucket;
+}
+
+/*===========================================================================
+ * FUNCTION   : getBucketLimit
+ *
+ * DESCRIPTION: get the largest value counted in a histogram bucket
+ *
+ * PARAMETERS :
+ *   @bucket  : bucket index
+ *
+ * RETURN     : upper limit of the bucket
+ *==========================================================================*/
+int64_t QCameraLatencyStats::getBucketLimit(uint32_t bucket)
+{
+    if (bucket < LINEAR_BUCKETS) {
+        return bucket;
+    }
+
+    uint32_t msb = (bucket - LINEAR_BUCKETS) / SUB_BUCKETS + 4;
+    uint32_t sub = (bucket - LINEAR_BUCKETS) % SUB_BUCKETS;
+    int64_t step = 1LL << (msb - 2);
+    return (1LL << msb) + (sub + 1) * step - 1;
+}
+
+/*===========================================================================
+ * FUNCTION   : add
+ *
+ * DESCRIPTION: account one sample
+ *
+ * PARAMETERS :
+ *   @value   : sample value, unit is up to the caller
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraLatencyStats::add(int64_t value)
+{
+    pthread_mutex_lock(&m_lock);
+    m_nBuckets[getBucket(value)]++;
+    if (m_nCount == 0 || value < m_nMin) {
+        m_nMin = value;
+    }
+    if (m_nCount == 0 || value > m_nMax) {
+        m_nMax = value;
+    }
+    m_nCount++;
+    m_nSum += value;
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : reset
+ *
+ * DESCRIPTION: drop all samples
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraLatencyStats::reset()
+{
+    pthread_mutex_lock(&m_lock);
+    memset(m_nBuckets, 0, sizeof(m_nBuckets));
+    m_nCount = 0;
+    m_nSum = 0;
+    m_nMin = 0;
+    m_nMax = 0;
+    pthread_mutex_unlock(&m_lock);
+}
+
+/*===========================================================================
+ * FUNCTION   : getCount
+ *
+ * DESCRIPTION: get number of samples
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : number of samples
+ *==========================================================================*/
+uint32_t QCameraLatencyStats::getCount()
+{
+    uint32_t count;
+    pthread_mutex_lock(&m_lock);
+    count = m_nCount;
+    pthread_mutex_unlock(&m_lock);
+    return count;
+}
+
+/*===========================================================================
+ * FUNCTION   : getMin
+ *
+ * DESCRIPTION: get smallest sample
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : smallest sample, 0 if no samples
+ *==========================================================================*/
+int64_t QCameraLatencyStats::getMin()
+{
+    int64_t val;
+    pthread_mutex_lock(&m_lock);
+    val = m_nMin;
+    pthread_mutex_unlock(&m_lock);
+    return val;
+}
+
+/*===========================================================================
+ * FUNCTION   : getMax
+ *
+ * DESCRIPTION: get largest sample
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : largest sample, 0 if no samples
+ *==========================================================================*/
+int64_t QCameraLatencyStats::getMax()
+{
+    int64_t val;
+    pthread_mutex_lock(&m_lock);
+    val = m_nMax;
+    pthread_mutex_unlock(&m_lock);
+    return val;
+}
+
+/*===========================================================================
+ * FUNCTION   : getMean
+ *
+ * DESCRIPTION: get average of all samples
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : mean value, 0 if no samples
+ *==========================================================================*/
+int64_t QCameraLatencyStats::getMean()
+{
+    int64_t val = 0;
+    pthread_mutex_lock(&m_lock);
+    if (m_nCount > 0) {
+        val = m_nSum / m_nCount;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return val;
+}
+
+/*===========================================================================
+ * FUNCTION   : getPercentile
+ *
+ * DESCRIPTION: get an upper estimate of the given percentile
+ *
+ * PARAMETERS :
+ *   @pct     : percentile, 0 - 100
+ *
+ * RETURN     : percentile value, 0 if no samples
+ *==========================================================================*/
+int64_t QCameraLatencyStats::getPercentile(uint32_t pct)
+{
+    int64_t val = 0;
+
+    pthread_mutex_lock(&m_lock);
+    if (m_nCount > 0) {
+        uint64_t rank = ((uint64_t)m_nCount * (pct > 100 ? 100 : pct) + 99) / 100;
+        uint64_t seen = 0;
+        if (rank == 0) {
+            rank = 1;
+        }
+        val = m_nMax;
+        for (uint32_t i = 0; i < MAX_BUCKETS; i++) {
+            seen += m_nBuckets[i];
+            if (seen >= rank) {
+                val = getBucketLimit(i);
+                break;
+            }
+        }
+        if (val > m_nMax) {
+            val = m_nMax;
+        }
+        if (val < m_nMin) {
+            val = m_nMin;
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+    return val;
+}
+
+}; // namespace qcamera
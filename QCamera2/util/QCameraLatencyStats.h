@@ -0,0 +1,74 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_LATENCY_STATS_H__
+#define __QCAMERA_LATENCY_STATS_H__
+
+#include <pthread.h>
+#include <stdint.h>
+
+namespace qcamera {
+
+/* Fixed size log-linear histogram for latency/occupancy samples. Values
+ * below 16 are counted exactly, larger values fall into 4 buckets per power
+ * of two, so percentiles are accurate to within 25% without allocation. */
+class QCameraLatencyStats {
+public:
+    QCameraLatencyStats();
+    virtual ~QCameraLatencyStats();
+
+    void add(int64_t value);
+    void reset();
+    uint32_t getCount();
+    int64_t getMin();
+    int64_t getMax();
+    int64_t getMean();
+    int64_t getPercentile(uint32_t pct);
+
+private:
+    static uint32_t getBucket(int64_t value);
+    static int64_t getBucketLimit(uint32_t bucket);
+
+    enum {
+        LINEAR_BUCKETS = 16,
+        SUB_BUCKETS = 4,
+        MAX_BUCKETS = LINEAR_BUCKETS + (48 - 4) * SUB_BUCKETS
+    };
+
+    uint32_t m_nBuckets[MAX_BUCKETS];
+    uint32_t m_nCount;
+    int64_t m_nSum;
+    int64_t m_nMin;
+    int64_t m_nMax;
+    pthread_mutex_t m_lock;
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_LATENCY_STATS_H__ */
@@ -0,0 +1,350 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include "QCameraPerfGovernor.h"
+
+namespace qcamera {
+
+static const qcamera_perf_tuning_t kDefaultTuning = {
+    80,                                 // highLoad
+    30,                                 // lowLoad
+    1000000000LL,                       // escalateHold, 1 sec
+    5000000000LL,                       // relaxHold, 5 sec
+    QCAMERA_PERF_LEVEL_THERMAL_SLIGHT,  // maxLoadLevel
+};
+
+static const char *kLevelNames[QCAMERA_PERF_LEVEL_MAX] = {
+    "normal",
+    "reduced-pp",
+    "reduced-jpeg",
+    "thermal-slight",
+    "thermal-big",
+    "thermal-shutdown",
+};
+
+/*===========================================================================
+ * FUNCTION   : QCameraPerfGovernor
+ *
+ * DESCRIPTION: constructor of QCameraPerfGovernor
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraPerfGovernor::QCameraPerfGovernor()
+    : m_bEnabled(true),
+      m_tuning(kDefaultTuning)
+{
+    reset(0);
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraPerfGovernor
+ *
+ * DESCRIPTION: deconstructor of QCameraPerfGovernor
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraPerfGovernor::~QCameraPerfGovernor()
+{
+}
+
+/*===========================================================================
+ * FUNCTION   : reset
+ *
+ * DESCRIPTION: go back to normal level and drop load history and stats,
+ *              e.g. when the camera is opened
+ *
+ * PARAMETERS :
+ *   @now     : current time in nsec
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraPerfGovernor::reset(int64_t now)
+{
+    m_nThermalLevel = 0;
+    m_nLoadLevel = QCAMERA_PERF_LEVEL_NORMAL;
+    m_nLevel = QCAMERA_PERF_LEVEL_NORMAL;
+    m_nLoad = 0;
+    m_nHighSince = -1;
+    m_nLowSince = -1;
+    m_nLevelSince = now;
+    for (int i = 0; i < QCAMERA_PERF_LEVEL_MAX; i++) {
+        m_nLevelTime[i] = 0;
+    }
+    m_nTransitions = 0;
+}
+
+/*===========================================================================
+ * FUNCTION   : setThermalLevel
+ *
+ * DESCRIPTION: take a new platform thermal level. It is applied right
+ *              away in both directions, the thermal engine already has
+ *              its own hysteresis.
+ *
+ * PARAMETERS :
+ *   @thermalLevel : platform thermal level, 0 (none) to 3 (shutdown)
+ *   @now          : current time in nsec
+ *
+ * RETURN     : true  -- effective level changed
+ *              false -- no change
+ *==========================================================================*/
+bool QCameraPerfGovernor::setThermalLevel(int thermalLevel, int64_t now)
+{
+    if (thermalLevel < 0) {
+        thermalLevel = 0;
+    } else if (thermalLevel > QCAMERA_PERF_LEVEL_THERMAL_SHUTDOWN -
+            QCAMERA_PERF_LEVEL_THERMAL_SLIGHT + 1) {
+        thermalLevel = QCAMERA_PERF_LEVEL_THERMAL_SHUTDOWN -
+            QCAMERA_PERF_LEVEL_THERMAL_SLIGHT + 1;
+    }
+    m_nThermalLevel = thermalLevel;
+
+    int level = QCAMERA_PERF_LEVEL_NORMAL;
+    if (m_nThermalLevel > 0) {
+        level = QCAMERA_PERF_LEVEL_THERMAL_SLIGHT + m_nThermalLevel - 1;
+    }
+    if (m_bEnabled && m_nLoadLevel > level) {
+        level = m_nLoadLevel;
+    }
+    return setLevel(level, now);
+}
+
+/*===========================================================================
+ * FUNCTION   : updateLoad
+ *
+ * DESCRIPTION: feed one load sample. The load is smoothed, and has to stay
+ *              above the high mark for escalateHold before the session
+ *              moves up one level, or below the low mark for relaxHold
+ *              before it moves down one level. Load in between keeps the
+ *              current level.
+ *
+ * PARAMETERS :
+ *   @load    : pipeline load sample
+ *   @now     : current time in nsec
+ *
+ * RETURN     : true  -- effective level changed
+ *              false -- no change
+ *==========================================================================*/
+bool QCameraPerfGovernor::updateLoad(const qcamera_perf_load_t &load, int64_t now)
+{
+    m_nLoad = (m_nLoad * 3 + calcLoad(load)) / 4;
+    if (!m_bEnabled) {
+        return false;
+    }
+
+    if (m_nLoad >= m_tuning.highLoad) {
+        m_nLowSince = -1;
+        if (m_nHighSince < 0) {
+            m_nHighSince = now;
+        } else if (now - m_nHighSince >= m_tuning.escalateHold &&
+                m_nLoadLevel < m_tuning.maxLoadLevel) {
+            m_nLoadLevel++;
+            m_nHighSince = now;
+        }
+    } else if (m_nLoad <= m_tuning.lowLoad) {
+        m_nHighSince = -1;
+        if (m_nLowSince < 0) {
+            m_nLowSince = now;
+        } else if (now - m_nLowSince >= m_tuning.relaxHold &&
+                m_nLoadLevel > QCAMERA_PERF_LEVEL_NORMAL) {
+            m_nLoadLevel--;
+            m_nLowSince = now;
+        }
+    } else {
+        m_nHighSince = -1;
+        m_nLowSince = -1;
+    }
+
+    return setThermalLevel(m_nThermalLevel, now);
+}
+
+/*===========================================================================
+ * FUNCTION   : getThermalLevel
+ *
+ * DESCRIPTION: thermal level to use for the fps/frame skip adjustment of
+ *              the effective level
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : thermal level, 0 (none) to 3 (shutdown)
+ *==========================================================================*/
+int QCameraPerfGovernor::getThermalLevel() const
+{
+    if (m_nLevel < QCAMERA_PERF_LEVEL_THERMAL_SLIGHT) {
+        return 0;
+    }
+    return m_nLevel - QCAMERA_PERF_LEVEL_THERMAL_SLIGHT + 1;
+}
+
+/*===========================================================================
+ * FUNCTION   : isPPReduced
+ *
+ * DESCRIPTION: whether optional reprocess features (WNR, CAC) are to be
+ *              skipped
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : true -- skip optional features; false -- otherwise
+ *==========================================================================*/
+bool QCameraPerfGovernor::isPPReduced() const
+{
+    return m_bEnabled && m_nLevel >= QCAMERA_PERF_LEVEL_REDUCED_PP;
+}
+
+/*===========================================================================
+ * FUNCTION   : adjustJpegQuality
+ *
+ * DESCRIPTION: cap the jpeg quality at the current level
+ *
+ * PARAMETERS :
+ *   @quality : jpeg quality set by the application
+ *
+ * RETURN     : jpeg quality to encode with
+ *==========================================================================*/
+int QCameraPerfGovernor::adjustJpegQuality(int quality) const
+{
+    if (m_bEnabled && m_nLevel >= QCAMERA_PERF_LEVEL_REDUCED_JPEG &&
+            quality > kReducedJpegQuality) {
+        return kReducedJpegQuality;
+    }
+    return quality;
+}
+
+/*===========================================================================
+ * FUNCTION   : getTimeInLevel
+ *
+ * DESCRIPTION: total time spent in a level since the last reset
+ *
+ * PARAMETERS :
+ *   @level   : perf level
+ *   @now     : current time in nsec
+ *
+ * RETURN     : time in nsec
+ *==========================================================================*/
+int64_t QCameraPerfGovernor::getTimeInLevel(int level, int64_t now) const
+{
+    if (level < 0 || level >= QCAMERA_PERF_LEVEL_MAX) {
+        return 0;
+    }
+    int64_t time = m_nLevelTime[level];
+    if (level == m_nLevel && now > m_nLevelSince) {
+        time += now - m_nLevelSince;
+    }
+    return time;
+}
+
+/*===========================================================================
+ * FUNCTION   : getLevelName
+ *
+ * DESCRIPTION: printable name of a perf level
+ *
+ * PARAMETERS :
+ *   @level   : perf level
+ *
+ * RETURN     : name string
+ *==========================================================================*/
+const char *QCameraPerfGovernor::getLevelName(int level)
+{
+    if (level < 0 || level >= QCAMERA_PERF_LEVEL_MAX) {
+        return "invalid";
+    }
+    return kLevelNames[level];
+}
+
+/*===========================================================================
+ * FUNCTION   : calcLoad
+ *
+ * DESCRIPTION: instant load of a sample in %. Each signal is scaled to
+ *              its capacity and the busiest one wins, so 100% means one
+ *              stage of the pipeline is saturated. A 25% frame drop rate
+ *              counts as saturated as well.
+ *
+ * PARAMETERS :
+ *   @load    : pipeline load sample
+ *
+ * RETURN     : load in %, capped at kMaxLoad
+ *==========================================================================*/
+uint32_t QCameraPerfGovernor::calcLoad(const qcamera_perf_load_t &load)
+{
+    uint32_t value = 0;
+    uint32_t pct = load.jpegBacklog * 100 / kJpegCapacity;
+    if (pct > value) {
+        value = pct;
+    }
+    pct = load.ppBacklog * 100 / kPPCapacity;
+    if (pct > value) {
+        value = pct;
+    }
+    pct = load.cbBacklog * 100 / kCbCapacity;
+    if (pct > value) {
+        value = pct;
+    }
+    if (load.framesTotal > 0) {
+        pct = load.framesDropped * 400 / load.framesTotal;
+        if (pct > value) {
+            value = pct;
+        }
+    }
+    if (value > kMaxLoad) {
+        value = kMaxLoad;
+    }
+    return value;
+}
+
+/*===========================================================================
+ * FUNCTION   : setLevel
+ *
+ * DESCRIPTION: switch the effective level and account the time spent in
+ *              the previous one
+ *
+ * PARAMETERS :
+ *   @level   : new perf level
+ *   @now     : current time in nsec
+ *
+ * RETURN     : true  -- level changed
+ *              false -- no change
+ *==========================================================================*/
+bool QCameraPerfGovernor::setLevel(int level, int64_t now)
+{
+    if (level == m_nLevel) {
+        return false;
+    }
+    if (now > m_nLevelSince) {
+        m_nLevelTime[m_nLevel] += now - m_nLevelSince;
+    }
+    m_nLevelSince = now;
+    m_nLevel = level;
+    m_nTransitions++;
+    return true;
+}
+
+}; // namespace qcamera
@@ -0,0 +1,120 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_PERF_GOVERNOR_H__
+#define __QCAMERA_PERF_GOVERNOR_H__
+
+#include <stdint.h>
+
+namespace qcamera {
+
+/* Perf levels of a camera session. Every level keeps the mitigations of
+ * the levels below it and adds one more. The top three levels match the
+ * fps/frame skip adjustments of the platform thermal levels. */
+typedef enum {
+    QCAMERA_PERF_LEVEL_NORMAL = 0,
+    QCAMERA_PERF_LEVEL_REDUCED_PP,      // no WNR/CAC in reprocess
+    QCAMERA_PERF_LEVEL_REDUCED_JPEG,    // cap jpeg quality
+    QCAMERA_PERF_LEVEL_THERMAL_SLIGHT,  // -10% fps or skip every 2nd frame
+    QCAMERA_PERF_LEVEL_THERMAL_BIG,     // -20% fps or skip 3 of 4 frames
+    QCAMERA_PERF_LEVEL_THERMAL_SHUTDOWN,// lowest fps or max frame skip
+    QCAMERA_PERF_LEVEL_MAX
+} qcamera_perf_level_t;
+
+/* One load sample of the HAL pipeline */
+typedef struct {
+    uint32_t jpegBacklog;   // jpeg jobs queued or being encoded
+    uint32_t ppBacklog;     // frames queued or being reprocessed
+    uint32_t cbBacklog;     // callbacks pending in the notifier
+    uint32_t framesDropped; // frames lost since the previous sample
+    uint32_t framesTotal;   // frames expected since the previous sample
+} qcamera_perf_load_t;
+
+/* Hysteresis tuning of the governor */
+typedef struct {
+    uint32_t highLoad;      // smoothed load (%) that escalates
+    uint32_t lowLoad;       // smoothed load (%) that relaxes
+    int64_t escalateHold;   // time load has to stay high per escalation (nsec)
+    int64_t relaxHold;      // time load has to stay low per relaxation (nsec)
+    int maxLoadLevel;       // highest level reachable by load alone
+} qcamera_perf_tuning_t;
+
+/* Closed loop perf governor of a camera session. The platform thermal
+ * level sets a floor, measured pipeline load moves the session up and
+ * down from it with hysteresis so that a short burst does not toggle the
+ * preview fps. Not thread safe, callers serialize access. */
+class QCameraPerfGovernor {
+public:
+    QCameraPerfGovernor();
+    virtual ~QCameraPerfGovernor();
+
+    void reset(int64_t now);
+    void setEnabled(bool enabled) { m_bEnabled = enabled; };
+    bool isEnabled() const { return m_bEnabled; };
+    void setTuning(const qcamera_perf_tuning_t &tuning) { m_tuning = tuning; };
+    bool setThermalLevel(int thermalLevel, int64_t now);
+    bool updateLoad(const qcamera_perf_load_t &load, int64_t now);
+
+    int getLevel() const { return m_nLevel; };
+    uint32_t getLoad() const { return m_nLoad; };
+    int getPlatformThermalLevel() const { return m_nThermalLevel; };
+    int getThermalLevel() const;
+    bool isPPReduced() const;
+    int adjustJpegQuality(int quality) const;
+    int64_t getTimeInLevel(int level, int64_t now) const;
+    uint32_t getTransitions() const { return m_nTransitions; };
+
+    static const char *getLevelName(int level);
+    static uint32_t calcLoad(const qcamera_perf_load_t &load);
+
+    static const uint32_t kJpegCapacity = 3;    // backlog counted as 100%
+    static const uint32_t kPPCapacity = 3;
+    static const uint32_t kCbCapacity = 8;
+    static const uint32_t kMaxLoad = 400;
+    static const int kReducedJpegQuality = 85;
+
+private:
+    bool setLevel(int level, int64_t now);
+
+    bool m_bEnabled;
+    qcamera_perf_tuning_t m_tuning;
+    int m_nThermalLevel;        // last platform thermal level
+    int m_nLoadLevel;           // level requested by pipeline load
+    int m_nLevel;               // effective level
+    uint32_t m_nLoad;           // smoothed load in %
+    int64_t m_nHighSince;       // start of the current high load period, 0 if none
+    int64_t m_nLowSince;        // start of the current low load period, 0 if none
+    int64_t m_nLevelSince;      // time the current level was entered
+    int64_t m_nLevelTime[QCAMERA_PERF_LEVEL_MAX]; // accumulated time per level
+    uint32_t m_nTransitions;    // number of level changes
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_PERF_GOVERNOR_H__ */
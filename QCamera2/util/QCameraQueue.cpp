@@ -106,6 +106,24 @@ bool QCameraQueue::isEmpty()
     return flag;
 }
 
+/*===========================================================================
+ * FUNCTION   : getCurrentSize
+ *
+ * DESCRIPTION: return the number of nodes currently in the queue
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : queue size
+ *==========================================================================*/
+int QCameraQueue::getCurrentSize()
+{
+    int size;
+    pthread_mutex_lock(&m_lock);
+    size = m_size;
+    pthread_mutex_unlock(&m_lock);
+    return size;
+}
+
 /*===========================================================================
  * FUNCTION   : enqueue
  *
@@ -211,6 +229,52 @@ void* QCameraQueue::dequeue(bool bFromHead)
     return data;
 }
 
+/*===========================================================================
+ * FUNCTION   : dequeue
+ *
+ * DESCRIPTION: dequeue the first node matching the given data, for
+ *              consumers whose jobs can complete out of order
+ *
+ * PARAMETERS :
+ *   @match      : matching function
+ *   @match_data : data passed to the matching function
+ *
+ * RETURN     : data ptr of the matching node. NULL if no match.
+ *==========================================================================*/
+void* QCameraQueue::dequeue(match_fn_data match, void *match_data)
+{
+    camera_q_node* node = NULL;
+    void* data = NULL;
+    struct cam_list *head = NULL;
+    struct cam_list *pos = NULL;
+
+    if ( NULL == match ) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&m_lock);
+    head = &m_head.list;
+    pos = head->next;
+    while (pos != head) {
+        camera_q_node *cur = member_of(pos, camera_q_node, list);
+        if (match(cur->data, m_userData, match_data)) {
+            cam_list_del_node(&cur->list);
+            m_size--;
+            node = cur;
+            break;
+        }
+        pos = pos->next;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (NULL != node) {
+        data = node->data;
+        free(node);
+    }
+
+    return data;
+}
+
 /*===========================================================================
  * FUNCTION   : flush
  *
@@ -50,7 +50,9 @@ public:
     void flushNodes(match_fn match);
     void flushNodes(match_fn_data match, void *spec_data);
     void* dequeue(bool bFromHead = true);
+    void* dequeue(match_fn_data match, void *match_data);
     bool isEmpty();
+    int getCurrentSize();
 private:
     typedef struct {
         struct cam_list list;
@@ -0,0 +1,459 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include "QCameraSceneDetector.h"
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define QCAMERA_SCENE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define QCAMERA_SCENE_SSE2
+#endif
+
+namespace qcamera {
+
+static const uint32_t kDefaultBudget = 64 * 1024;  // luma pixels per frame
+
+static const int32_t kDarkLevel = 40;           // luma below is dark
+static const int32_t kBrightLevel = 200;        // luma above is bright
+
+static const int32_t kNightMean = 48;           // night: dark on average
+static const int32_t kNightDarkPct = 60;        //        and mostly dark
+static const int32_t kBacklightDelta = 48;      // backlight: border brighter
+static const int32_t kBacklightBrightPct = 20;  //            than center
+static const int32_t kSnowMean = 168;           // snow: bright, flat frame
+static const int32_t kSnowBrightPct = 50;
+static const int32_t kSnowDetail = 6;
+static const int32_t kLandscapeSkyDelta = 32;   // landscape: bright sky over
+static const int32_t kLandscapeDetail = 6;      //            detailed ground
+
+static const char *kSceneNames[QCAMERA_SCENE_MAX] = {
+    "auto",
+    "night",
+    "night-portrait",
+    "backlight",
+    "portrait",
+    "snow",
+    "landscape",
+};
+
+/*===========================================================================
+ * FUNCTION   : QCameraSceneDetector
+ *
+ * DESCRIPTION: constructor of QCameraSceneDetector
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraSceneDetector::QCameraSceneDetector()
+    : m_nMaxBudget(kDefaultBudget),
+      m_nBudget(kDefaultBudget)
+{
+    reset();
+}
+
+/*===========================================================================
+ * FUNCTION   : ~QCameraSceneDetector
+ *
+ * DESCRIPTION: deconstructor of QCameraSceneDetector
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+QCameraSceneDetector::~QCameraSceneDetector()
+{
+}
+
+/*===========================================================================
+ * FUNCTION   : reset
+ *
+ * DESCRIPTION: forget the scene history, e.g. when preview restarts. The
+ *              budget goes back to the one set by the user.
+ *
+ * PARAMETERS : None
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraSceneDetector::reset()
+{
+    m_nBudget = m_nMaxBudget;
+    m_scene = QCAMERA_SCENE_AUTO;
+    m_candidate = QCAMERA_SCENE_AUTO;
+    m_nCandidateFrames = 0;
+    m_nFrames = 0;
+    memset(&m_stats, 0, sizeof(qcamera_scene_stats_t));
+    memset(m_grid, 0, sizeof(m_grid));
+}
+
+/*===========================================================================
+ * FUNCTION   : setBudget
+ *
+ * DESCRIPTION: set the number of luma pixels read per frame. At least one
+ *              row per grid row is always read.
+ *
+ * PARAMETERS :
+ *   @maxPixels : luma pixels per frame
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraSceneDetector::setBudget(uint32_t maxPixels)
+{
+    if (maxPixels < QCAMERA_SCENE_MIN_BUDGET) {
+        maxPixels = QCAMERA_SCENE_MIN_BUDGET;
+    }
+    m_nMaxBudget = maxPixels;
+    m_nBudget = maxPixels;
+}
+
+/*===========================================================================
+ * FUNCTION   : updateBudget
+ *
+ * DESCRIPTION: keep the time spent per frame within a target. The pixel
+ *              budget is halved when a frame took longer than the target,
+ *              and doubled again, up to the user budget, when a frame took
+ *              less than a quarter of it.
+ *
+ * PARAMETERS :
+ *   @elapsedUs : time the last frame took, usec
+ *   @targetUs  : time allowed per frame, usec. 0 disables the adjustment.
+ *
+ * RETURN     : true  -- budget changed
+ *              false -- no change
+ *==========================================================================*/
+bool QCameraSceneDetector::updateBudget(int64_t elapsedUs, int64_t targetUs)
+{
+    uint32_t budget = m_nBudget;
+    if (targetUs <= 0) {
+        return false;
+    }
+    if (elapsedUs > targetUs) {
+        budget /= 2;
+        if (budget < QCAMERA_SCENE_MIN_BUDGET) {
+            budget = QCAMERA_SCENE_MIN_BUDGET;
+        }
+    } else if (elapsedUs * 4 < targetUs) {
+        budget *= 2;
+        if (budget > m_nMaxBudget) {
+            budget = m_nMaxBudget;
+        }
+    }
+    if (budget == m_nBudget) {
+        return false;
+    }
+    m_nBudget = budget;
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : process
+ *
+ * DESCRIPTION: classify one frame and update the reported scene
+ *
+ * PARAMETERS :
+ *   @frame   : preview frame and its metadata
+ *
+ * RETURN     : scene reported after this frame
+ *==========================================================================*/
+qcamera_scene_t QCameraSceneDetector::process(const qcamera_scene_frame_t &frame)
+{
+    uint32_t samples = 0;
+    if (!downscale(frame.luma, frame.width, frame.height, frame.stride,
+            m_nBudget, m_grid, samples)) {
+        return m_scene;
+    }
+    calcStats(m_grid, frame.hist, m_stats);
+    m_stats.samples = samples;
+
+    qcamera_scene_t scene = classify(m_stats, frame.num_faces);
+    if (scene == m_candidate) {
+        if (m_nCandidateFrames < QCAMERA_SCENE_STABLE_FRAMES) {
+            m_nCandidateFrames++;
+        }
+    } else {
+        m_candidate = scene;
+        m_nCandidateFrames = 1;
+    }
+    if (m_nCandidateFrames >= QCAMERA_SCENE_STABLE_FRAMES) {
+        m_scene = m_candidate;
+    }
+    m_nFrames++;
+
+    return m_scene;
+}
+
+/*===========================================================================
+ * FUNCTION   : downscale
+ *
+ * DESCRIPTION: box filter a luma plane down to the scene grid. The frame is
+ *              split into equal cells, leftover columns and rows at the
+ *              edges are skipped. Each cell is averaged over evenly spaced
+ *              rows, as many as the pixel budget allows and at least one.
+ *
+ * PARAMETERS :
+ *   @luma      : Y plane
+ *   @width     : frame width
+ *   @height    : frame height
+ *   @stride    : bytes per luma row
+ *   @maxPixels : luma pixels to read at most
+ *   @grid      : [output] QCAMERA_SCENE_GRID_W x QCAMERA_SCENE_GRID_H cells
+ *   @samples   : [output] luma pixels read
+ *
+ * RETURN     : true -- success; false -- invalid frame
+ *==========================================================================*/
+bool QCameraSceneDetector::downscale(const uint8_t *luma, int32_t width,
+        int32_t height, int32_t stride, uint32_t maxPixels, uint8_t *grid,
+        uint32_t &samples)
+{
+    if ((NULL == luma) || (NULL == grid) || (width < QCAMERA_SCENE_GRID_W) ||
+            (height < QCAMERA_SCENE_GRID_H) || (stride < width)) {
+        return false;
+    }
+
+    int32_t cellW = width / QCAMERA_SCENE_GRID_W;
+    int32_t cellH = height / QCAMERA_SCENE_GRID_H;
+    int32_t x0 = (width - cellW * QCAMERA_SCENE_GRID_W) / 2;
+    int32_t y0 = (height - cellH * QCAMERA_SCENE_GRID_H) / 2;
+    int32_t rows = (int32_t)(maxPixels /
+            (uint32_t)(cellW * QCAMERA_SCENE_GRID_W * QCAMERA_SCENE_GRID_H));
+    if (rows < 1) {
+        rows = 1;
+    } else if (rows > cellH) {
+        rows = cellH;
+    }
+
+    uint32_t sums[QCAMERA_SCENE_GRID_W];
+    uint32_t div = (uint32_t)(cellW * rows);
+    for (int32_t gy = 0; gy < QCAMERA_SCENE_GRID_H; gy++) {
+        memset(sums, 0, sizeof(sums));
+        for (int32_t k = 0; k < rows; k++) {
+            int32_t y = y0 + gy * cellH + (2 * k + 1) * cellH / (2 * rows);
+            const uint8_t *row = luma + (size_t)y * stride + x0;
+            for (int32_t gx = 0; gx < QCAMERA_SCENE_GRID_W; gx++) {
+                sums[gx] += sumBytes(row + gx * cellW, cellW);
+            }
+        }
+        uint8_t *out = grid + gy * QCAMERA_SCENE_GRID_W;
+        for (int32_t gx = 0; gx < QCAMERA_SCENE_GRID_W; gx++) {
+            out[gx] = (uint8_t)((sums[gx] + div / 2) / div);
+        }
+    }
+    samples = div * QCAMERA_SCENE_GRID_W * QCAMERA_SCENE_GRID_H;
+
+    return true;
+}
+
+/*===========================================================================
+ * FUNCTION   : calcStats
+ *
+ * DESCRIPTION: statistics of a scene grid. Dark and bright shares come
+ *              from the ISP histogram when there is one, which covers
+ *              every pixel, and from the grid cells otherwise.
+ *
+ * PARAMETERS :
+ *   @grid    : QCAMERA_SCENE_GRID_W x QCAMERA_SCENE_GRID_H cells
+ *   @hist    : QCAMERA_SCENE_HIST_BINS luma bins, NULL if none
+ *   @stats   : [output] statistics, samples is left untouched
+ *
+ * RETURN     : None
+ *==========================================================================*/
+void QCameraSceneDetector::calcStats(const uint8_t *grid, const uint32_t *hist,
+        qcamera_scene_stats_t &stats)
+{
+    const int32_t cells = QCAMERA_SCENE_GRID_W * QCAMERA_SCENE_GRID_H;
+    const int32_t third = QCAMERA_SCENE_GRID_H / 3;
+    int32_t sum = 0, centerSum = 0, centerCells = 0;
+    int32_t topSum = 0, bottomSum = 0, dark = 0, bright = 0;
+    int32_t gradSum = 0, gradCount = 0;
+
+    for (int32_t gy = 0; gy < QCAMERA_SCENE_GRID_H; gy++) {
+        const uint8_t *row = grid + gy * QCAMERA_SCENE_GRID_W;
+        bool centerRow = (gy >= QCAMERA_SCENE_GRID_H / 4) &&
+                (gy < QCAMERA_SCENE_GRID_H * 3 / 4);
+        for (int32_t gx = 0; gx < QCAMERA_SCENE_GRID_W; gx++) {
+            int32_t v = row[gx];
+            sum += v;
+            if (centerRow && (gx >= QCAMERA_SCENE_GRID_W / 4) &&
+                    (gx < QCAMERA_SCENE_GRID_W * 3 / 4)) {
+                centerSum += v;
+                centerCells++;
+            }
+            if (gy < third) {
+                topSum += v;
+            } else if (gy >= QCAMERA_SCENE_GRID_H - third) {
+                bottomSum += v;
+            }
+            if (v < kDarkLevel) {
+                dark++;
+            } else if (v > kBrightLevel) {
+                bright++;
+            }
+            if (gx > 0) {
+                int32_t d = v - row[gx - 1];
+                gradSum += (d < 0) ? -d : d;
+                gradCount++;
+            }
+            if (gy > 0) {
+                int32_t d = v - row[gx - QCAMERA_SCENE_GRID_W];
+                gradSum += (d < 0) ? -d : d;
+                gradCount++;
+            }
+        }
+    }
+
+    stats.mean = sum / cells;
+    int32_t devSum = 0;
+    for (int32_t i = 0; i < cells; i++) {
+        int32_t d = grid[i] - stats.mean;
+        devSum += (d < 0) ? -d : d;
+    }
+    stats.contrast = devSum / cells;
+    stats.centerDelta = (sum - centerSum) / (cells - centerCells) -
+            centerSum / centerCells;
+    stats.topDelta = (topSum - bottomSum) / (third * QCAMERA_SCENE_GRID_W);
+    stats.detail = gradSum / gradCount;
+    stats.darkPct = dark * 100 / cells;
+    stats.brightPct = bright * 100 / cells;
+
+    if (NULL != hist) {
+        uint64_t total = 0, histDark = 0, histBright = 0;
+        for (int32_t i = 0; i < QCAMERA_SCENE_HIST_BINS; i++) {
+            total += hist[i];
+            if (i < kDarkLevel) {
+                histDark += hist[i];
+            } else if (i > kBrightLevel) {
+                histBright += hist[i];
+            }
+        }
+        if (total > 0) {
+            stats.darkPct = (int32_t)(histDark * 100 / total);
+            stats.brightPct = (int32_t)(histBright * 100 / total);
+        }
+    }
+}
+
+/*===========================================================================
+ * FUNCTION   : classify
+ *
+ * DESCRIPTION: pick the scene of a frame. Exposure problems come first:
+ *              a dark frame is night, a bright border around a darker
+ *              center is backlight. Faces make a portrait. A bright flat
+ *              frame is snow, a bright top over a detailed bottom is a
+ *              landscape.
+ *
+ * PARAMETERS :
+ *   @stats    : frame statistics
+ *   @numFaces : faces detected in the frame
+ *
+ * RETURN     : scene of the frame
+ *==========================================================================*/
+qcamera_scene_t QCameraSceneDetector::classify(const qcamera_scene_stats_t &stats,
+        int32_t numFaces)
+{
+    if ((stats.mean < kNightMean) && (stats.darkPct >= kNightDarkPct)) {
+        return (numFaces > 0) ? QCAMERA_SCENE_NIGHT_PORTRAIT : QCAMERA_SCENE_NIGHT;
+    }
+    if ((stats.centerDelta >= kBacklightDelta) &&
+            (stats.brightPct >= kBacklightBrightPct)) {
+        return QCAMERA_SCENE_BACKLIGHT;
+    }
+    if (numFaces > 0) {
+        return QCAMERA_SCENE_PORTRAIT;
+    }
+    if ((stats.mean >= kSnowMean) && (stats.brightPct >= kSnowBrightPct) &&
+            (stats.detail <= kSnowDetail)) {
+        return QCAMERA_SCENE_SNOW;
+    }
+    if ((stats.topDelta >= kLandscapeSkyDelta) &&
+            (stats.detail >= kLandscapeDetail)) {
+        return QCAMERA_SCENE_LANDSCAPE;
+    }
+    return QCAMERA_SCENE_AUTO;
+}
+
+/*===========================================================================
+ * FUNCTION   : getSceneName
+ *
+ * DESCRIPTION: printable name of a scene
+ *
+ * PARAMETERS :
+ *   @scene   : scene
+ *
+ * RETURN     : name string
+ *==========================================================================*/
+const char *QCameraSceneDetector::getSceneName(qcamera_scene_t scene)
+{
+    if (((int)scene < 0) || (scene >= QCAMERA_SCENE_MAX)) {
+        return "invalid";
+    }
+    return kSceneNames[scene];
+}
+
+/*===========================================================================
+ * FUNCTION   : sumBytes
+ *
+ * DESCRIPTION: sum of a run of bytes
+ *
+ * PARAMETERS :
+ *   @src     : bytes to sum
+ *   @bytes   : number of bytes
+ *
+ * RETURN     : sum
+ *==========================================================================*/
+uint32_t QCameraSceneDetector::sumBytes(const uint8_t *src, int32_t bytes)
+{
+    uint32_t sum = 0;
+    int32_t i = 0;
+#if defined(QCAMERA_SCENE_NEON)
+    uint32x4_t acc = vdupq_n_u32(0);
+    for (; i + 16 <= bytes; i += 16) {
+        acc = vpadalq_u16(acc, vpaddlq_u8(vld1q_u8(src + i)));
+    }
+    uint64x2_t acc64 = vpaddlq_u32(acc);
+    sum = (uint32_t)(vgetq_lane_u64(acc64, 0) + vgetq_lane_u64(acc64, 1));
+#elif defined(QCAMERA_SCENE_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        acc = _mm_add_epi32(acc, _mm_sad_epu8(v, zero));
+    }
+    sum = (uint32_t)(_mm_cvtsi128_si32(acc) +
+            _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#endif
+    for (; i < bytes; i++) {
+        sum += src[i];
+    }
+    return sum;
+}
+
+}; // namespace qcamera
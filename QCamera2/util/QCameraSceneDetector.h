@@ -0,0 +1,122 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_SCENE_DETECTOR_H__
+#define __QCAMERA_SCENE_DETECTOR_H__
+
+#include <stdint.h>
+
+namespace qcamera {
+
+#define QCAMERA_SCENE_GRID_W 32         // luma grid columns
+#define QCAMERA_SCENE_GRID_H 24         // luma grid rows
+#define QCAMERA_SCENE_HIST_BINS 256     // bins of the ISP luma histogram
+#define QCAMERA_SCENE_STABLE_FRAMES 3   // frames a new scene has to hold
+#define QCAMERA_SCENE_MIN_BUDGET (16 * 1024) // luma pixels per frame
+
+/* Scenes the detector tells apart */
+typedef enum {
+    QCAMERA_SCENE_AUTO,             // nothing specific
+    QCAMERA_SCENE_NIGHT,
+    QCAMERA_SCENE_NIGHT_PORTRAIT,
+    QCAMERA_SCENE_BACKLIGHT,
+    QCAMERA_SCENE_PORTRAIT,
+    QCAMERA_SCENE_SNOW,
+    QCAMERA_SCENE_LANDSCAPE,
+    QCAMERA_SCENE_MAX
+} qcamera_scene_t;
+
+/* One preview frame and the metadata that came with it */
+typedef struct {
+    const uint8_t *luma;    // Y plane
+    int32_t width;
+    int32_t height;
+    int32_t stride;         // bytes per luma row
+    const uint32_t *hist;   // QCAMERA_SCENE_HIST_BINS luma bins, NULL if none
+    int32_t num_faces;      // faces detected in the frame
+} qcamera_scene_frame_t;
+
+/* Statistics a frame is classified on, luma values are 0 - 255 */
+typedef struct {
+    int32_t mean;           // mean luma
+    int32_t contrast;       // mean absolute deviation of the grid
+    int32_t darkPct;        // % of the frame below the dark level
+    int32_t brightPct;      // % of the frame above the bright level
+    int32_t centerDelta;    // border mean minus center mean
+    int32_t topDelta;       // top third mean minus bottom third mean
+    int32_t detail;         // mean gradient between neighbouring cells
+    uint32_t samples;       // luma pixels read
+} qcamera_scene_stats_t;
+
+/* Lightweight scene classifier for sensors without ASD. The luma plane is
+ * box filtered down to a QCAMERA_SCENE_GRID_W x QCAMERA_SCENE_GRID_H grid,
+ * reading at most a budget of pixels per frame (whole rows, summed with
+ * NEON or SSE2 where available). Grid and ISP histogram statistics are
+ * classified with fixed thresholds, and a new scene is only reported once
+ * it held for QCAMERA_SCENE_STABLE_FRAMES frames. Not thread safe, one
+ * instance per frame source. */
+class QCameraSceneDetector {
+public:
+    QCameraSceneDetector();
+    virtual ~QCameraSceneDetector();
+
+    void reset();
+    void setBudget(uint32_t maxPixels);
+    uint32_t getBudget() const { return m_nBudget; };
+    bool updateBudget(int64_t elapsedUs, int64_t targetUs);
+    qcamera_scene_t process(const qcamera_scene_frame_t &frame);
+    qcamera_scene_t getScene() const { return m_scene; };
+    const qcamera_scene_stats_t &getStats() const { return m_stats; };
+    uint32_t getFrameCount() const { return m_nFrames; };
+
+    static bool downscale(const uint8_t *luma, int32_t width, int32_t height,
+                          int32_t stride, uint32_t maxPixels, uint8_t *grid,
+                          uint32_t &samples);
+    static void calcStats(const uint8_t *grid, const uint32_t *hist,
+                          qcamera_scene_stats_t &stats);
+    static qcamera_scene_t classify(const qcamera_scene_stats_t &stats,
+                                    int32_t numFaces);
+    static const char *getSceneName(qcamera_scene_t scene);
+
+private:
+    static uint32_t sumBytes(const uint8_t *src, int32_t bytes);
+
+    uint32_t m_nMaxBudget;          // budget set by the user
+    uint32_t m_nBudget;             // budget in use, may be cut on slow frames
+    qcamera_scene_t m_scene;        // reported scene
+    qcamera_scene_t m_candidate;    // last classified scene
+    uint32_t m_nCandidateFrames;    // frames the candidate held
+    uint32_t m_nFrames;             // frames processed since reset
+    qcamera_scene_stats_t m_stats;  // stats of the last frame
+    uint8_t m_grid[QCAMERA_SCENE_GRID_W * QCAMERA_SCENE_GRID_H];
+};
+
+}; // namespace qcamera
+
+#endif /* __QCAMERA_SCENE_DETECTOR_H__ */
@@ -0,0 +1,217 @@
+LOCAL_PATH:= $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_perf_sim.cpp \
+    ../QCameraPerfGovernor.cpp \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+
+LOCAL_MODULE:= qcamera-perf-sim
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_reproc_sim.cpp \
+    ../QCameraQueue.cpp \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+    $(LOCAL_PATH)/../../stack/common \
+
+LOCAL_SHARED_LIBRARIES:= libcutils libutils liblog
+
+LOCAL_MODULE:= qcamera-reproc-sim
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_conv_test.cpp \
+    ../QCameraFormatConverter.cpp \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+
+LOCAL_MODULE:= qcamera-conv-test
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_scene_test.cpp \
+    ../QCameraSceneDetector.cpp \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+
+LOCAL_MODULE:= qcamera-scene-test
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_pacing_sim.cpp \
+    ../QCameraFramePacer.cpp \
+    ../QCameraFrameTiming.cpp \
+    ../QCameraLatencyStats.cpp \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+
+LOCAL_MODULE:= qcamera-pacing-sim
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_timing_test.cpp \
+    ../QCameraFrameTiming.cpp \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+
+LOCAL_MODULE:= qcamera-timing-test
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_hal3_replay.cpp \
+    qcamera_sim_camera.cpp \
+    ../QCameraLatencyStats.cpp \
+    ../QCameraJobPool.cpp \
+    ../QCameraCmdThread.cpp \
+    ../QCameraQueue.cpp \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+    $(LOCAL_PATH)/../../stack/common \
+    $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+
+LOCAL_SHARED_LIBRARIES:= libcutils libutils liblog
+
+LOCAL_MODULE:= qcamera-hal3-replay
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_dispatch_bench.cpp \
+    ../QCameraLatencyStats.cpp \
+    ../../stack/mm-camera-interface/src/mm_camera_stream.c \
+    ../../stack/mm-camera-interface/src/mm_camera_thread.c \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+    $(LOCAL_PATH)/../../stack/common \
+    $(LOCAL_PATH)/../../stack/mm-camera-interface/inc \
+    $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+
+LOCAL_SHARED_LIBRARIES:= libcutils liblog
+
+LOCAL_MODULE:= qcamera-dispatch-bench
+LOCAL_MODULE_TAGS:= tests
+
+# v4l2 calls of mm_camera_stream.c go to the simulated fd source
+LOCAL_CFLAGS += -D_ANDROID_ -Dioctl=mm_dispatch_bench_ioctl
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_map_bench.cpp \
+    ../QCameraLatencyStats.cpp \
+    ../../stack/mm-camera-interface/src/mm_camera_sock.c \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+    $(LOCAL_PATH)/../../stack/common \
+    $(LOCAL_PATH)/../../stack/mm-camera-interface/inc \
+    $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+
+LOCAL_SHARED_LIBRARIES:= libcutils liblog
+
+LOCAL_MODULE:= qcamera-map-bench
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -D_ANDROID_
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_exif_bench.cpp \
+    ../QCameraLatencyStats.cpp \
+    ../../HAL/QCameraExif.cpp \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+    $(LOCAL_PATH)/../../HAL \
+    $(LOCAL_PATH)/../../stack/common \
+    $(LOCAL_PATH)/../../../mm-image-codec/qexif \
+    $(LOCAL_PATH)/../../../mm-image-codec/qomx_core \
+    frameworks/native/include/media/openmax \
+    $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+
+LOCAL_SHARED_LIBRARIES:= libcutils libutils liblog
+
+LOCAL_MODULE:= qcamera-exif-bench
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    qcamera_cb_ring_test.cpp \
+    ../QCameraCallbackMemoryRing.cpp \
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+
+LOCAL_SHARED_LIBRARIES:= liblog
+
+LOCAL_MODULE:= qcamera-cb-ring-test
+LOCAL_MODULE_TAGS:= tests
+
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,338 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Runs QCameraCallbackMemoryRing the way the HAL does: a producer takes a
+ * buffer per frame at the sensor frame rate and hands it to a callback
+ * thread, which holds each buffer for a random time as the client would
+ * and returns it through the release callback. Checks that the ring only
+ * allocates while it fills up, never hands out a buffer still held by the
+ * client, falls back to one-off buffers when the client stalls and that
+ * everything is released after clear(). Exits with 1 on the first failure. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "QCameraCallbackMemoryRing.h"
+
+using namespace qcamera;
+
+#define NSEC_PER_SEC 1000000000LL
+#define BUF_SIZE     512
+
+typedef struct {
+    const char *name;
+    uint32_t fps;
+    int frames;
+    int maxHold;        // max time the client holds a buffer, in 1/100 frames
+    int stallFrame;     // frame the client holds for stallHold frames, -1 if none
+    int stallHold;
+} ring_trace_t;
+
+static const ring_trace_t traces[] = {
+    {"30fps",           30, 90, 200,  -1, 0},
+    {"60fps",           60, 180, 200, -1, 0},
+    {"30fps one stall", 30, 90, 150,  30, 8},
+};
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t allocs;
+    uint32_t releases;
+} fake_heap_t;
+
+static fake_heap_t gHeap = {PTHREAD_MUTEX_INITIALIZER, 0, 0};
+
+static void fakeRelease(camera_memory_t *mem)
+{
+    pthread_mutex_lock(&gHeap.lock);
+    gHeap.releases++;
+    pthread_mutex_unlock(&gHeap.lock);
+    free(mem->data);
+    free(mem);
+}
+
+static camera_memory_t *fakeGetMemory(int /*fd*/, size_t size,
+                                      unsigned int num_bufs, void * /*user*/)
+{
+    camera_memory_t *mem = (camera_memory_t *)calloc(1, sizeof(*mem));
+    if (NULL == mem) {
+        return NULL;
+    }
+    mem->size = size * num_bufs;
+    mem->data = calloc(1, mem->size);
+    mem->release = fakeRelease;
+    if (NULL == mem->data) {
+        free(mem);
+        return NULL;
+    }
+    pthread_mutex_lock(&gHeap.lock);
+    gHeap.allocs++;
+    pthread_mutex_unlock(&gHeap.lock);
+    return mem;
+}
+
+static uint32_t heapAllocs()
+{
+    pthread_mutex_lock(&gHeap.lock);
+    uint32_t allocs = gHeap.allocs;
+    pthread_mutex_unlock(&gHeap.lock);
+    return allocs;
+}
+
+static bool checkHeapEmpty(const char *name)
+{
+    pthread_mutex_lock(&gHeap.lock);
+    bool empty = (gHeap.allocs == gHeap.releases);
+    if (!empty) {
+        printf("%s: %u buffers leaked\n", name, gHeap.allocs - gHeap.releases);
+    }
+    gHeap.allocs = 0;
+    gHeap.releases = 0;
+    pthread_mutex_unlock(&gHeap.lock);
+    return empty;
+}
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void sleepUntil(int64_t t)
+{
+    struct timespec ts;
+    ts.tv_sec = t / NSEC_PER_SEC;
+    ts.tv_nsec = t % NSEC_PER_SEC;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+    }
+}
+
+/* buffer content written by the producer, checked when the client lets go */
+static void fillFrame(camera_memory_t *mem, int frame)
+{
+    memset(mem->data, frame & 0xff, mem->size);
+    memcpy(mem->data, &frame, sizeof(frame));
+}
+
+static bool frameIntact(camera_memory_t *mem, int frame)
+{
+    const uint8_t *p = (const uint8_t *)mem->data;
+    int stored;
+    memcpy(&stored, p, sizeof(stored));
+    return (stored == frame) && (p[mem->size - 1] == (uint8_t)(frame & 0xff));
+}
+
+typedef struct {
+    camera_memory_t *mem;
+    int64_t releaseAt;
+} held_buf_t;
+
+/* callbacks are delivered in order by a single thread, as with the HAL's
+ * callback notifier, so a stalled client holds up all later frames */
+typedef struct {
+    QCameraCallbackMemoryRing *ring;
+    held_buf_t *bufs;
+    int frames;
+    int queued;
+    int corrupted;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} client_t;
+
+static void *clientThread(void *data)
+{
+    client_t *client = (client_t *)data;
+
+    for (int i = 0; i < client->frames; i++) {
+        pthread_mutex_lock(&client->lock);
+        while (client->queued <= i) {
+            pthread_cond_wait(&client->cond, &client->lock);
+        }
+        held_buf_t buf = client->bufs[i];
+        pthread_mutex_unlock(&client->lock);
+
+        sleepUntil(buf.releaseAt);
+        if ((NULL != buf.mem) && !frameIntact(buf.mem, i)) {
+            client->corrupted++;
+        }
+        QCameraCallbackMemoryRing::releaseCallback(buf.mem, client->ring, 0);
+    }
+    return NULL;
+}
+
+static bool runTrace(const ring_trace_t *trace, unsigned int *seed)
+{
+    QCameraCallbackMemoryRing ring(trace->name);
+    client_t client;
+    pthread_t tid;
+    int64_t interval = NSEC_PER_SEC / trace->fps;
+    int lastAlloc = -1;
+    uint32_t allocs = 0;
+
+    memset(&client, 0, sizeof(client));
+    client.ring = &ring;
+    client.frames = trace->frames;
+    client.bufs = (held_buf_t *)calloc(trace->frames, sizeof(held_buf_t));
+    if (NULL == client.bufs) {
+        printf("no mem for %s\n", trace->name);
+        return false;
+    }
+    pthread_mutex_init(&client.lock, NULL);
+    pthread_cond_init(&client.cond, NULL);
+    pthread_create(&tid, NULL, clientThread, &client);
+
+    int64_t start = nowNs();
+    for (int i = 0; i < trace->frames; i++) {
+        int64_t frameTime = start + i * interval;
+        sleepUntil(frameTime);
+
+        uint32_t before = heapAllocs();
+        camera_memory_t *mem = ring.get(fakeGetMemory, BUF_SIZE, NULL);
+        if (heapAllocs() != before) {
+            allocs += heapAllocs() - before;
+            lastAlloc = i;
+        }
+        if (NULL == mem) {
+            printf("%s: no buffer for frame %d\n", trace->name, i);
+            break;
+        }
+        fillFrame(mem, i);
+
+        int64_t hold = interval * (rand_r(seed) % (trace->maxHold + 1)) / 100;
+        if (i == trace->stallFrame) {
+            hold = interval * trace->stallHold;
+        }
+        pthread_mutex_lock(&client.lock);
+        client.bufs[i].mem = mem;
+        client.bufs[i].releaseAt = frameTime + hold;
+        client.queued = i + 1;
+        pthread_cond_signal(&client.cond);
+        pthread_mutex_unlock(&client.lock);
+    }
+
+    // a failed get above leaves the client waiting for frames
+    pthread_mutex_lock(&client.lock);
+    client.queued = trace->frames;
+    pthread_cond_signal(&client.cond);
+    pthread_mutex_unlock(&client.lock);
+    pthread_join(tid, NULL);
+    ring.clear();
+
+    // after a stall the ring refills from one-off buffers and must be
+    // steady again within a ring's worth of frames
+    int warmup = QCAMERA_CB_MEM_RING_SIZE;
+    if (trace->stallFrame >= 0) {
+        warmup = trace->stallFrame + trace->stallHold + QCAMERA_CB_MEM_RING_SIZE;
+    }
+    printf("%-16s %3d frames, %2u allocations, last at frame %d\n",
+        trace->name, trace->frames, allocs, lastAlloc);
+
+    bool ok = true;
+    if (client.corrupted) {
+        printf("%s: %d buffers reused while held by the client\n",
+            trace->name, client.corrupted);
+        ok = false;
+    }
+    if (lastAlloc >= warmup) {
+        printf("%s: allocation in steady state at frame %d\n",
+            trace->name, lastAlloc);
+        ok = false;
+    }
+    if ((trace->stallFrame < 0) && (allocs != QCAMERA_CB_MEM_RING_SIZE)) {
+        printf("%s: %u allocations for a ring of %d\n",
+            trace->name, allocs, QCAMERA_CB_MEM_RING_SIZE);
+        ok = false;
+    }
+    if ((trace->stallFrame >= 0) && (allocs <= QCAMERA_CB_MEM_RING_SIZE)) {
+        printf("%s: stall did not overflow the ring\n", trace->name);
+        ok = false;
+    }
+    pthread_cond_destroy(&client.cond);
+    pthread_mutex_destroy(&client.lock);
+    free(client.bufs);
+    return checkHeapEmpty(trace->name) && ok;
+}
+
+/* buffers still held at clear() and foreign buffers are released by put() */
+static bool checkClearInFlight()
+{
+    QCameraCallbackMemoryRing ring("clear");
+
+    camera_memory_t *held = ring.get(fakeGetMemory, BUF_SIZE, NULL);
+    camera_memory_t *idle = ring.get(fakeGetMemory, BUF_SIZE, NULL);
+    if ((NULL == held) || (NULL == idle) || (held == idle)) {
+        printf("clear: ring handed out the same buffer twice\n");
+        return false;
+    }
+    ring.put(idle);
+    ring.clear();
+    if (heapAllocs() != 2 || gHeap.releases != 1) {
+        printf("clear: idle buffer not released\n");
+        return false;
+    }
+    ring.put(held);
+
+    camera_memory_t *foreign = fakeGetMemory(-1, BUF_SIZE, 1, NULL);
+    QCameraCallbackMemoryRing::releaseCallback(foreign, &ring, 0);
+
+    // a size change drops the idle buffers of the old size
+    camera_memory_t *small = ring.get(fakeGetMemory, BUF_SIZE, NULL);
+    ring.put(small);
+    camera_memory_t *large = ring.get(fakeGetMemory, 2 * BUF_SIZE, NULL);
+    if ((NULL == large) || (large->size != 2 * BUF_SIZE)) {
+        printf("clear: buffer of the old size after a size change\n");
+        return false;
+    }
+    ring.put(large);
+    ring.clear();
+
+    if (!checkHeapEmpty("clear")) {
+        return false;
+    }
+    printf("clear ok\n");
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int seed = (argc > 1) ? (unsigned int)atoi(argv[1]) : 1;
+
+    if (!checkClearInFlight()) {
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(traces) / sizeof(traces[0]); i++) {
+        if (!runTrace(&traces[i], &seed)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,269 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Checks QCameraFormatConverter against a plain per pixel conversion for
+ * all format pairs over padded and packed layouts, odd sizes included, and
+ * times the conversions of a preview frame. Exits with 1 on the first
+ * mismatch. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "QCameraFormatConverter.h"
+
+using namespace qcamera;
+
+#define CONV_TEST_SENTINEL 0xA5
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* layout the way the camera stream pads it: aligned strides and scanlines,
+ * every plane starting on a 4K boundary */
+static void getPaddedLayout(qcamera_yuv_fmt_t fmt, int32_t width, int32_t height,
+                            int32_t align, qcamera_yuv_layout_t &layout)
+{
+    int32_t scanline = (height + 31) & ~31;
+    int32_t chromaScanline = ((height + 1) / 2 + 15) & ~15;
+
+    memset(&layout, 0, sizeof(layout));
+    layout.fmt = fmt;
+    layout.width = width;
+    layout.height = height;
+    layout.stride[0] = (width + align - 1) & ~(align - 1);
+    layout.offset[0] = 0;
+    uint32_t next = (layout.stride[0] * scanline + 4095) & ~4095;
+    if (QCAMERA_YUV_FMT_YV12 == fmt) {
+        layout.num_planes = 3;
+        for (int i = 1; i < 3; i++) {
+            layout.stride[i] = (layout.stride[0] / 2 + align - 1) & ~(align - 1);
+            layout.offset[i] = next;
+            next = (next + layout.stride[i] * chromaScanline + 4095) & ~4095;
+        }
+    } else {
+        layout.num_planes = 2;
+        layout.stride[1] = layout.stride[0];
+        layout.offset[1] = next;
+        next = (next + layout.stride[1] * chromaScanline + 4095) & ~4095;
+    }
+    layout.frame_len = next;
+}
+
+/* chroma sample of a frame, cr selects Cr over Cb */
+static uint8_t *chromaAt(uint8_t *buf, const qcamera_yuv_layout_t &l,
+                         int32_t x, int32_t y, bool cr)
+{
+    switch (l.fmt) {
+    case QCAMERA_YUV_FMT_NV21:
+        return buf + l.offset[1] + y * l.stride[1] + 2 * x + (cr ? 0 : 1);
+    case QCAMERA_YUV_FMT_NV12:
+        return buf + l.offset[1] + y * l.stride[1] + 2 * x + (cr ? 1 : 0);
+    case QCAMERA_YUV_FMT_YV12:
+    default:
+        return buf + l.offset[cr ? 1 : 2] + y * l.stride[cr ? 1 : 2] + x;
+    }
+}
+
+static void referenceConvert(uint8_t *src, const qcamera_yuv_layout_t &sl,
+                             uint8_t *dst, const qcamera_yuv_layout_t &dl)
+{
+    for (int32_t y = 0; y < sl.height; y++) {
+        for (int32_t x = 0; x < sl.width; x++) {
+            dst[dl.offset[0] + y * dl.stride[0] + x] =
+                src[sl.offset[0] + y * sl.stride[0] + x];
+        }
+    }
+    for (int32_t y = 0; y < (sl.height + 1) / 2; y++) {
+        for (int32_t x = 0; x < (sl.width + 1) / 2; x++) {
+            *chromaAt(dst, dl, x, y, true) = *chromaAt(src, sl, x, y, true);
+            *chromaAt(dst, dl, x, y, false) = *chromaAt(src, sl, x, y, false);
+        }
+    }
+}
+
+static bool checkConversion(const qcamera_yuv_layout_t &sl,
+                            const qcamera_yuv_layout_t &dl, unsigned int *seed)
+{
+    uint8_t *src = (uint8_t *)malloc(sl.frame_len);
+    uint8_t *dst = (uint8_t *)malloc(dl.frame_len);
+    uint8_t *ref = (uint8_t *)malloc(dl.frame_len);
+    bool ok = false;
+
+    if ((NULL != src) && (NULL != dst) && (NULL != ref)) {
+        for (uint32_t i = 0; i < sl.frame_len; i++) {
+            src[i] = (uint8_t)rand_r(seed);
+        }
+        memset(dst, CONV_TEST_SENTINEL, dl.frame_len);
+        memset(ref, CONV_TEST_SENTINEL, dl.frame_len);
+        referenceConvert(src, sl, ref, dl);
+        ok = QCameraFormatConverter::convert(src, sl, dst, dl) &&
+            (0 == memcmp(dst, ref, dl.frame_len));
+    }
+    if (!ok) {
+        printf("FAIL %s %dx%d stride %d -> %s stride %d\n",
+            QCameraFormatConverter::getFormatName(sl.fmt), sl.width, sl.height,
+            sl.stride[0], QCameraFormatConverter::getFormatName(dl.fmt),
+            dl.stride[0]);
+    }
+    free(src);
+    free(dst);
+    free(ref);
+    return ok;
+}
+
+static bool checkInvalidInput()
+{
+    qcamera_yuv_layout_t a, b;
+    uint8_t buf[64];
+    bool ok = true;
+
+    ok &= !QCameraFormatConverter::getPackedLayout(QCAMERA_YUV_FMT_MAX, 16, 16, a);
+    ok &= !QCameraFormatConverter::getPackedLayout(QCAMERA_YUV_FMT_NV21, 0, 16, a);
+    QCameraFormatConverter::getPackedLayout(QCAMERA_YUV_FMT_NV21, 16, 16, a);
+    QCameraFormatConverter::getPackedLayout(QCAMERA_YUV_FMT_NV21, 16, 8, b);
+    // size mismatch, frame larger than claimed, null buffers
+    ok &= !QCameraFormatConverter::convert(buf, a, buf, b);
+    b = a;
+    b.frame_len -= 1;
+    ok &= !QCameraFormatConverter::convert(buf, a, buf, b);
+    ok &= !QCameraFormatConverter::convert(NULL, a, buf, a);
+    if (!ok) {
+        printf("FAIL invalid input accepted\n");
+    }
+    return ok;
+}
+
+static void timeConversion(const qcamera_yuv_layout_t &sl,
+                           const qcamera_yuv_layout_t &dl, int frames)
+{
+    uint8_t *src = (uint8_t *)calloc(1, sl.frame_len);
+    uint8_t *dst = (uint8_t *)calloc(1, dl.frame_len);
+    int64_t best = 0;
+    int64_t total = 0;
+
+    if ((NULL == src) || (NULL == dst) || (frames <= 0)) {
+        free(src);
+        free(dst);
+        return;
+    }
+    for (int i = 0; i < frames; i++) {
+        int64_t start = nowNs();
+        QCameraFormatConverter::convert(src, sl, dst, dl);
+        int64_t t = nowNs() - start;
+        total += t;
+        if ((0 == best) || (t < best)) {
+            best = t;
+        }
+    }
+    printf("%s stride %4d -> %s stride %4d: %6lld us/frame avg, %6lld us best\n",
+        QCameraFormatConverter::getFormatName(sl.fmt), sl.stride[0],
+        QCameraFormatConverter::getFormatName(dl.fmt), dl.stride[0],
+        (long long)(total / frames / 1000), (long long)(best / 1000));
+    free(src);
+    free(dst);
+}
+
+int main(int argc, char *argv[])
+{
+    static const int32_t sizes[][2] = {
+        {2, 2}, {6, 4}, {33, 17}, {34, 18}, {62, 30}, {176, 144},
+        {318, 240}, {320, 240}, {642, 482}, {1280, 720}, {1920, 1080},
+    };
+    int32_t width = 1440;
+    int32_t height = 1080;
+    int frames = 50;
+    unsigned int seed = 1;
+    int checks = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "w:h:n:")) != -1) {
+        switch (c) {
+        case 'w':
+            width = atoi(optarg);
+            break;
+        case 'h':
+            height = atoi(optarg);
+            break;
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        default:
+            printf("usage: %s [-w width] [-h height] [-n frames]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!checkInvalidInput()) {
+        return 1;
+    }
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int sf = 0; sf < QCAMERA_YUV_FMT_MAX; sf++) {
+            for (int df = 0; df < QCAMERA_YUV_FMT_MAX; df++) {
+                qcamera_yuv_layout_t layouts[3];
+                QCameraFormatConverter::getPackedLayout((qcamera_yuv_fmt_t)sf,
+                    sizes[s][0], sizes[s][1], layouts[0]);
+                getPaddedLayout((qcamera_yuv_fmt_t)sf, sizes[s][0], sizes[s][1],
+                    32, layouts[1]);
+                getPaddedLayout((qcamera_yuv_fmt_t)sf, sizes[s][0], sizes[s][1],
+                    64, layouts[2]);
+                qcamera_yuv_layout_t dl;
+                QCameraFormatConverter::getPackedLayout((qcamera_yuv_fmt_t)df,
+                    sizes[s][0], sizes[s][1], dl);
+                for (int l = 0; l < 3; l++) {
+                    if (!checkConversion(layouts[l], dl, &seed) ||
+                            !checkConversion(dl, layouts[l], &seed)) {
+                        return 1;
+                    }
+                    checks += 2;
+                }
+            }
+        }
+    }
+    printf("%d conversions bit exact\n", checks);
+
+    qcamera_yuv_layout_t padded, packed;
+    printf("%dx%d, %d frames\n", width, height, frames);
+    getPaddedLayout(QCAMERA_YUV_FMT_NV21, width, height, 64, padded);
+    for (int df = 0; df < QCAMERA_YUV_FMT_MAX; df++) {
+        QCameraFormatConverter::getPackedLayout((qcamera_yuv_fmt_t)df, width,
+            height, packed);
+        timeConversion(padded, packed, frames);
+    }
+    QCameraFormatConverter::getPackedLayout(QCAMERA_YUV_FMT_NV21, width, height,
+        packed);
+    timeConversion(packed, packed, frames);
+
+    return 0;
+}
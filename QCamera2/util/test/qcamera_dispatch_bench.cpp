@@ -0,0 +1,423 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Measures sensor arrival to HAL callback latency of mm_camera_stream.c
+ * with and without direct dispatch. The real stream object, data poll
+ * thread and stream cmd thread run on top of a simulated fd source: the
+ * stream fd is a pipe, a sensor thread completes the oldest buffer queued
+ * through VIDIOC_QBUF at the configured fps, stamps its arrival time and
+ * writes a byte that wakes the poll thread, and VIDIOC_DQBUF hands the
+ * completed buffer back. The module is built with -Dioctl= pointing the
+ * v4l2 calls of mm_camera_stream.c at that source. The callback returns
+ * each buffer right away, the way HAL1 dataNotifyCB only queues it.
+ *
+ * Exits with 1 when a mode loses or reorders frames or leaves a buffer
+ * with a reference count after stream off. */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "QCameraLatencyStats.h"
+
+extern "C" {
+#include "mm_camera.h"
+int32_t mm_stream_qbuf(mm_stream_t *my_obj, mm_camera_buf_def_t *buf);
+}
+
+using namespace qcamera;
+
+#define BENCH_MAX_BUFS        MM_CAMERA_MAX_NUM_FRAMES
+#define BENCH_HANDLE(n)       (((n) << 8) | 0)   // object handle, index 0
+
+typedef struct {
+    int fds[2];                          // [0] stream fd, [1] sensor end
+    pthread_mutex_t lock;
+    uint8_t queued[BENCH_MAX_BUFS];      // VIDIOC_QBUF order
+    uint32_t queuedCnt;
+    uint8_t done[BENCH_MAX_BUFS];        // completed, not yet dequeued
+    uint32_t doneCnt;
+    int64_t arrival[BENCH_MAX_BUFS];     // sensor arrival per buffer
+    uint32_t sequence;
+    uint32_t starved;
+    volatile int running;
+    uint32_t fps;
+    pthread_t tid;
+} bench_source_t;
+
+typedef struct {
+    mm_stream_t *stream;
+    bench_source_t *source;
+    QCameraLatencyStats *latency;
+    int32_t lastFrame;
+    uint32_t frames;
+    uint32_t reordered;
+    int workUs;
+} bench_client_t;
+
+static bench_source_t g_source;
+
+/* mm-camera-interface globals and utilities outside the measured path */
+extern "C" {
+volatile uint32_t gMmCameraIntfLogLevel = 0;
+
+int32_t mm_camera_util_s_ctrl(int32_t /*fd*/, uint32_t /*id*/, int32_t * /*value*/)
+{
+    return -1;
+}
+
+int32_t mm_camera_util_g_ctrl(int32_t /*fd*/, uint32_t /*id*/, int32_t * /*value*/)
+{
+    return -1;
+}
+
+int32_t mm_camera_util_sendmsg(mm_camera_obj_t * /*my_obj*/, void * /*msg*/,
+                               uint32_t /*buf_size*/, int /*sendfd*/)
+{
+    return -1;
+}
+
+int32_t mm_camera_util_bundled_sendmsg(mm_camera_obj_t * /*my_obj*/, void * /*msg*/,
+                                       uint32_t /*buf_size*/,
+                                       int /*sendfds*/[CAM_MAX_NUM_BUFS_PER_MSG],
+                                       int /*numfds*/)
+{
+    return -1;
+}
+
+uint8_t mm_camera_util_chip_is_a_family(void)
+{
+    return 0;
+}
+
+const char *mm_camera_util_get_dev_name(uint32_t /*cam_handler*/)
+{
+    return NULL;
+}
+
+uint8_t mm_camera_util_get_index_by_handler(uint32_t handler)
+{
+    return (handler & 0x000000ff);
+}
+
+/* v4l2 ioctls of the stream fd, see LOCAL_CFLAGS */
+int mm_dispatch_bench_ioctl(int fd, int request, ...)
+{
+    bench_source_t *src = &g_source;
+    void *arg;
+    va_list ap;
+    int rc = 0;
+
+    va_start(ap, request);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    if (fd != src->fds[0]) {
+        errno = EBADF;
+        return -1;
+    }
+
+    pthread_mutex_lock(&src->lock);
+    switch ((unsigned int)request) {
+    case VIDIOC_STREAMON:
+    case VIDIOC_STREAMOFF:
+        break;
+    case VIDIOC_QBUF:
+        {
+            struct v4l2_buffer *vb = (struct v4l2_buffer *)arg;
+            src->queued[src->queuedCnt++] = (uint8_t)vb->index;
+        }
+        break;
+    case VIDIOC_DQBUF:
+        {
+            struct v4l2_buffer *vb = (struct v4l2_buffer *)arg;
+            char byte;
+            if ((0 == src->doneCnt) || (read(src->fds[0], &byte, 1) != 1)) {
+                errno = EAGAIN;
+                rc = -1;
+                break;
+            }
+            uint8_t idx = src->done[0];
+            memmove(src->done, src->done + 1, --src->doneCnt);
+            vb->index = idx;
+            vb->sequence = ++src->sequence;
+            vb->timestamp.tv_sec = (time_t)(src->arrival[idx] / 1000000000LL);
+            vb->timestamp.tv_usec = (long)(src->arrival[idx] % 1000000000LL) / 1000;
+        }
+        break;
+    default:
+        errno = EINVAL;
+        rc = -1;
+        break;
+    }
+    pthread_mutex_unlock(&src->lock);
+    return rc;
+}
+}
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void *sensorRoutine(void *data)
+{
+    bench_source_t *src = (bench_source_t *)data;
+    int64_t interval = 1000000000LL / src->fps;
+    int64_t next = nowNs() + interval;
+
+    while (src->running) {
+        struct timespec ts;
+        ts.tv_sec = (time_t)(next / 1000000000LL);
+        ts.tv_nsec = (long)(next % 1000000000LL);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+        }
+        next += interval;
+
+        pthread_mutex_lock(&src->lock);
+        if (0 == src->queuedCnt) {
+            src->starved++;
+        } else {
+            uint8_t idx = src->queued[0];
+            memmove(src->queued, src->queued + 1, --src->queuedCnt);
+            src->arrival[idx] = nowNs();
+            src->done[src->doneCnt++] = idx;
+            if (write(src->fds[1], "f", 1) != 1) {
+                printf("sensor: wake up write failed\n");
+            }
+        }
+        pthread_mutex_unlock(&src->lock);
+    }
+    return NULL;
+}
+
+static int32_t invalidateBuf(int /*index*/, void * /*user_data*/)
+{
+    return 0;
+}
+
+/* HAL stream callback: takes the latency and gives the buffer back */
+static void streamCb(mm_camera_super_buf_t *bufs, void *userdata)
+{
+    bench_client_t *client = (bench_client_t *)userdata;
+    mm_camera_buf_def_t *buf = bufs->bufs[0];
+    int64_t arrival = client->source->arrival[buf->buf_idx];
+
+    client->latency->add((nowNs() - arrival) / 1000);
+    if ((int32_t)buf->frame_idx <= client->lastFrame) {
+        client->reordered++;
+    }
+    client->lastFrame = (int32_t)buf->frame_idx;
+    client->frames++;
+
+    if (client->workUs > 0) {
+        int64_t end = nowNs() + (int64_t)client->workUs * 1000;
+        while (nowNs() < end) {
+        }
+    }
+    mm_stream_fsm_fn(client->stream, MM_STREAM_EVT_QBUF, buf, NULL);
+}
+
+static bool runMode(bool direct, uint32_t fps, uint32_t frames, uint8_t numBufs,
+                    int workUs)
+{
+    bench_source_t *src = &g_source;
+    QCameraLatencyStats latency;
+    bench_client_t client;
+    mm_camera_obj_t *cam = (mm_camera_obj_t *)calloc(1, sizeof(mm_camera_obj_t));
+    mm_channel_t *ch = (mm_channel_t *)calloc(1, sizeof(mm_channel_t));
+    mm_camera_buf_def_t *bufs =
+        (mm_camera_buf_def_t *)calloc(numBufs, sizeof(mm_camera_buf_def_t));
+    mm_stream_buf_status_t *status =
+        (mm_stream_buf_status_t *)calloc(numBufs, sizeof(mm_stream_buf_status_t));
+    cam_stream_info_t *info = (cam_stream_info_t *)calloc(1, sizeof(cam_stream_info_t));
+    bool ok = true;
+
+    if ((NULL == cam) || (NULL == ch) || (NULL == bufs) || (NULL == status) ||
+            (NULL == info)) {
+        printf("no memory\n");
+        free(cam);
+        free(ch);
+        free(bufs);
+        free(status);
+        free(info);
+        return false;
+    }
+
+    memset(src, 0, sizeof(*src));
+    pthread_mutex_init(&src->lock, NULL);
+    src->fps = fps;
+    if (pipe(src->fds) != 0) {
+        printf("pipe failed\n");
+        return false;
+    }
+    fcntl(src->fds[0], F_SETFL, O_NONBLOCK);
+
+    cam->my_hdl = BENCH_HANDLE(1);
+    ch->my_hdl = BENCH_HANDLE(2);
+    ch->cam_obj = cam;
+    mm_camera_poll_thread_launch(&ch->poll_thread[0], MM_CAMERA_POLL_TYPE_DATA);
+
+    mm_stream_t *stream = &ch->streams[0];
+    stream->my_hdl = BENCH_HANDLE(3);
+    stream->fd = src->fds[0];
+    stream->ch_obj = ch;
+    stream->stream_info = info;
+    info->stream_type = CAM_STREAM_TYPE_PREVIEW;
+    stream->frame_offset.num_planes = 1;
+    pthread_mutex_init(&stream->cb_lock, NULL);
+    pthread_mutex_init(&stream->buf_lock, NULL);
+    stream->buf_num = numBufs;
+    stream->buf = bufs;
+    stream->buf_status = status;
+    stream->mem_vtbl.invalidate_buf = invalidateBuf;
+    stream->mem_vtbl.clean_invalidate_buf = invalidateBuf;
+    stream->direct_dispatch = direct ? 1 : 0;
+
+    memset(&client, 0, sizeof(client));
+    client.stream = stream;
+    client.source = src;
+    client.latency = &latency;
+    client.lastFrame = -1;
+    client.workUs = workUs;
+    stream->buf_cb[0].cb = streamCb;
+    stream->buf_cb[0].user_data = &client;
+    stream->buf_cb[0].cb_count = -1;
+
+    // registered buffers go to the kernel before stream on
+    for (uint8_t i = 0; i < numBufs; i++) {
+        bufs[i].buf_idx = i;
+        bufs[i].num_planes = 1;
+        bufs[i].fd = -1;
+        mm_stream_qbuf(stream, &bufs[i]);
+        status[i].in_kernel = 1;
+    }
+    stream->state = MM_STREAM_STATE_REG;
+    if (0 != mm_stream_fsm_fn(stream, MM_STREAM_EVT_START, NULL, NULL)) {
+        printf("stream on failed\n");
+        ok = false;
+    }
+
+    src->running = 1;
+    pthread_create(&src->tid, NULL, sensorRoutine, src);
+    // frames still arriving after this are cut by stream off
+    usleep((useconds_t)((uint64_t)frames * 1000000 / fps));
+    mm_stream_fsm_fn(stream, MM_STREAM_EVT_STOP, NULL, NULL);
+    src->running = 0;
+    pthread_join(src->tid, NULL);
+    mm_camera_poll_thread_release(&ch->poll_thread[0]);
+
+    uint32_t held = 0;
+    for (uint8_t i = 0; i < numBufs; i++) {
+        if (0 != status[i].buf_refcnt) {
+            held++;
+        }
+    }
+
+    printf("%-10s %5u frames, %u starved, cb latency us p50 %5lld p90 %5lld "
+        "p99 %5lld max %5lld\n", direct ? "direct" : "cmd thread", client.frames,
+        src->starved, (long long)latency.getPercentile(50),
+        (long long)latency.getPercentile(90), (long long)latency.getPercentile(99),
+        (long long)latency.getMax());
+    if (client.frames < frames * 9 / 10) {
+        printf("%s: %u of %u frames delivered\n", direct ? "direct" : "cmd thread",
+            client.frames, frames);
+        ok = false;
+    }
+    if (0 != client.reordered) {
+        printf("%s: %u frames out of order\n", direct ? "direct" : "cmd thread",
+            client.reordered);
+        ok = false;
+    }
+    if (0 != held) {
+        printf("%s: %u buffers still referenced after stream off\n",
+            direct ? "direct" : "cmd thread", held);
+        ok = false;
+    }
+
+    close(src->fds[0]);
+    close(src->fds[1]);
+    pthread_mutex_destroy(&src->lock);
+    pthread_mutex_destroy(&stream->cb_lock);
+    pthread_mutex_destroy(&stream->buf_lock);
+    free(info);
+    free(status);
+    free(bufs);
+    free(ch);
+    free(cam);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t fps = 120;
+    uint32_t frames = 600;
+    int bufs = 6;
+    int workUs = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "f:n:b:w:")) != -1) {
+        switch (c) {
+        case 'f':
+            fps = (uint32_t)atoi(optarg);
+            break;
+        case 'n':
+            frames = (uint32_t)atoi(optarg);
+            break;
+        case 'b':
+            bufs = atoi(optarg);
+            break;
+        case 'w':
+            workUs = atoi(optarg);
+            break;
+        default:
+            printf("usage: %s [-f fps] [-n frames] [-b buffers] "
+                "[-w callback_work_us]\n", argv[0]);
+            return 1;
+        }
+    }
+    if ((0 == fps) || (0 == frames) || (bufs < 1) || (bufs > BENCH_MAX_BUFS)) {
+        printf("invalid configuration\n");
+        return 1;
+    }
+
+    printf("%u fps, %u frames, %d buffers, %d us callback work\n",
+        fps, frames, bufs, workUs);
+    bool ok = runMode(false, fps, frames, (uint8_t)bufs, workUs);
+    ok = runMode(true, fps, frames, (uint8_t)bufs, workUs) && ok;
+    return ok ? 0 : 1;
+}
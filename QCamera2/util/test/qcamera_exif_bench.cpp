@@ -0,0 +1,267 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Measures the per-shot time to prepare the exif tags of a HAL1 capture.
+ * "rebuild" fills a fresh QCameraExif with every tag, including the
+ * make/model property lookups. "template" copies a QCameraExif holding
+ * the static tags, as getExifData does, and adds only the dynamic ones.
+ * Both modes format the same dynamic values from synthetic settings
+ * (local date/time, GPS date stamp) as QCameraParameters does.
+ *
+ * Exits with 1 when the two modes produce different tags, or when a table
+ * with more than MAX_EXIF_TABLE_ENTRIES tags loses any of them. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <cutils/properties.h>
+#include "QCameraExif.h"
+#include "QCameraLatencyStats.h"
+
+using namespace qcamera;
+
+#define BENCH_GPS_METHOD      "GPS"
+#define BENCH_GPS_TIMESTAMP   1413763200
+
+static const char kAsciiPrefix[] = { 0x41, 0x53, 0x43, 0x49, 0x49, 0x0, 0x0, 0x0 };
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void setRational(rat_t *rat, uint32_t num, uint32_t denom)
+{
+    rat->num = num;
+    rat->denom = denom;
+}
+
+static void addStaticTags(QCameraExif *exif)
+{
+    char value[PROPERTY_VALUE_MAX];
+    property_get("ro.product.manufacturer", value, "QCOM-AA");
+    exif->addEntry(EXIFTAGID_MAKE, EXIF_ASCII, strlen(value) + 1, (void *)value);
+    property_get("ro.product.model", value, "QCAM-AA");
+    exif->addEntry(EXIFTAGID_MODEL, EXIF_ASCII, strlen(value) + 1, (void *)value);
+}
+
+// same tags and formatting as QCamera2HardwareInterface::getExifData
+static void addDynamicTags(QCameraExif *exif, time_t now, uint16_t iso)
+{
+    char dateTime[20];
+    struct tm tmLocal;
+    localtime_r(&now, &tmLocal);
+    strftime(dateTime, sizeof(dateTime), "%Y:%m:%d %H:%M:%S", &tmLocal);
+    exif->addEntry(EXIFTAGID_EXIF_DATE_TIME_ORIGINAL, EXIF_ASCII, 20,
+        (void *)dateTime);
+
+    rat_t focalLength;
+    setRational(&focalLength, 470, 100);
+    exif->addEntry(EXIFTAGID_FOCAL_LENGTH, EXIF_RATIONAL, 1, (void *)&focalLength);
+
+    exif->addEntry(EXIFTAGID_ISO_SPEED_RATING, EXIF_SHORT, 1, (void *)&iso);
+
+    char method[sizeof(kAsciiPrefix) + sizeof(BENCH_GPS_METHOD)];
+    memcpy(method, kAsciiPrefix, sizeof(kAsciiPrefix));
+    memcpy(method + sizeof(kAsciiPrefix), BENCH_GPS_METHOD, sizeof(BENCH_GPS_METHOD));
+    exif->addEntry(EXIFTAGID_GPS_PROCESSINGMETHOD, EXIF_ASCII, sizeof(method),
+        (void *)method);
+
+    rat_t latitude[3];
+    setRational(&latitude[0], 37, 1);
+    setRational(&latitude[1], 25, 1);
+    setRational(&latitude[2], 1930, 100);
+    exif->addEntry(EXIFTAGID_GPS_LATITUDE, EXIF_RATIONAL, 3, (void *)latitude);
+    exif->addEntry(EXIFTAGID_GPS_LATITUDE_REF, EXIF_ASCII, 2, (void *)"N");
+
+    rat_t longitude[3];
+    setRational(&longitude[0], 122, 1);
+    setRational(&longitude[1], 5, 1);
+    setRational(&longitude[2], 3960, 100);
+    exif->addEntry(EXIFTAGID_GPS_LONGITUDE, EXIF_RATIONAL, 3, (void *)longitude);
+    exif->addEntry(EXIFTAGID_GPS_LONGITUDE_REF, EXIF_ASCII, 2, (void *)"W");
+
+    rat_t altitude;
+    char altRef = 0;
+    setRational(&altitude, 1200, 100);
+    exif->addEntry(EXIFTAGID_GPS_ALTITUDE, EXIF_RATIONAL, 1, (void *)&altitude);
+    exif->addEntry(EXIFTAGID_GPS_ALTITUDE_REF, EXIF_BYTE, 1, (void *)&altRef);
+
+    char gpsDateStamp[20];
+    rat_t gpsTimeStamp[3];
+    time_t gpsTime = BENCH_GPS_TIMESTAMP;
+    struct tm tmUtc;
+    gmtime_r(&gpsTime, &tmUtc);
+    strftime(gpsDateStamp, sizeof(gpsDateStamp), "%Y:%m:%d", &tmUtc);
+    setRational(&gpsTimeStamp[0], tmUtc.tm_hour, 1);
+    setRational(&gpsTimeStamp[1], tmUtc.tm_min, 1);
+    setRational(&gpsTimeStamp[2], tmUtc.tm_sec, 1);
+    exif->addEntry(EXIFTAGID_GPS_DATESTAMP, EXIF_ASCII, strlen(gpsDateStamp) + 1,
+        (void *)gpsDateStamp);
+    exif->addEntry(EXIFTAGID_GPS_TIMESTAMP, EXIF_RATIONAL, 3, (void *)gpsTimeStamp);
+}
+
+static uint32_t getTypeSize(exif_tag_type_t type)
+{
+    switch (type) {
+    case EXIF_SHORT:
+        return sizeof(uint16_t);
+    case EXIF_LONG:
+    case EXIF_SLONG:
+        return sizeof(uint32_t);
+    case EXIF_RATIONAL:
+    case EXIF_SRATIONAL:
+        return sizeof(rat_t);
+    default:
+        return sizeof(uint8_t);
+    }
+}
+
+static bool isSameEntry(QEXIF_INFO_DATA *a, QEXIF_INFO_DATA *b)
+{
+    exif_tag_entry_t *ea = &a->tag_entry;
+    exif_tag_entry_t *eb = &b->tag_entry;
+    if ((a->tag_id != b->tag_id) || (ea->type != eb->type) ||
+        (ea->count != eb->count)) {
+        return false;
+    }
+    if ((ea->count <= 1) && (EXIF_ASCII != ea->type) &&
+        (EXIF_UNDEFINED != ea->type)) {
+        return 0 == memcmp(&ea->data, &eb->data, getTypeSize(ea->type));
+    }
+    return 0 == memcmp(ea->data._bytes, eb->data._bytes,
+        ea->count * getTypeSize(ea->type));
+}
+
+static bool isSameExif(QCameraExif *a, QCameraExif *b)
+{
+    if (a->getNumOfEntries() != b->getNumOfEntries()) {
+        return false;
+    }
+    for (uint32_t i = 0; i < a->getNumOfEntries(); i++) {
+        if (!isSameEntry(&a->getEntries()[i], &b->getEntries()[i])) {
+            printf("tag 0x%x differs\n", a->getEntries()[i].tag_id);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void printStats(const char *mode, QCameraLatencyStats &stats)
+{
+    printf("%-9s exif prep ns p50 %6lld p90 %6lld max %8lld\n", mode,
+        (long long)stats.getPercentile(50), (long long)stats.getPercentile(90),
+        (long long)stats.getMax());
+}
+
+// tags beyond the initial table size must all be kept
+static bool checkGrowth()
+{
+    QCameraExif exif;
+    uint32_t numTags = MAX_EXIF_TABLE_ENTRIES * 3;
+    for (uint32_t i = 0; i < numTags; i++) {
+        uint32_t value = i;
+        exif.addEntry((exif_tag_id_t)(0x10000 + i), EXIF_LONG, 1, (void *)&value);
+    }
+    if (exif.getNumOfEntries() != numTags) {
+        printf("%u of %u tags kept\n", exif.getNumOfEntries(), numTags);
+        return false;
+    }
+    for (uint32_t i = 0; i < numTags; i++) {
+        if (exif.getEntries()[i].tag_entry.data._long != i) {
+            printf("tag %u lost its value\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t iterations = 10000;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:")) != -1) {
+        switch (c) {
+        case 'n':
+            iterations = (uint32_t)atoi(optarg);
+            break;
+        default:
+            printf("usage: %s [-n iterations]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (0 == iterations) {
+        printf("invalid configuration\n");
+        return 1;
+    }
+
+    QCameraLatencyStats rebuild;
+    QCameraLatencyStats clone;
+    QCameraExif *exifTemplate = new QCameraExif();
+    addStaticTags(exifTemplate);
+    time_t now = time(NULL);
+    bool ok = true;
+
+    for (uint32_t n = 0; n < iterations; n++) {
+        uint16_t iso = (uint16_t)(100 + (n % 8) * 100);
+
+        int64_t start = nowNs();
+        QCameraExif *full = new QCameraExif();
+        addStaticTags(full);
+        addDynamicTags(full, now, iso);
+        rebuild.add(nowNs() - start);
+
+        start = nowNs();
+        QCameraExif *shot = new QCameraExif(*exifTemplate);
+        addDynamicTags(shot, now, iso);
+        clone.add(nowNs() - start);
+
+        if ((0 == n) && !isSameExif(full, shot)) {
+            printf("template and rebuilt exif differ\n");
+            ok = false;
+        }
+        delete full;
+        delete shot;
+        if (!ok) {
+            break;
+        }
+    }
+    delete exifTemplate;
+
+    printf("%u iterations, %d static tags in the template\n", iterations, 2);
+    printStats("rebuild", rebuild);
+    printStats("template", clone);
+    ok = checkGrowth() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,811 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Replays a HAL3 request stream against the simulated mm-camera backend.
+ * The client drives mm_camera_ops_t the way QCamera3HardwareInterface
+ * does: a metadata channel plus one channel per output stream, per request
+ * a set_parms carrying the frame number followed by a qbuf of each
+ * requested buffer, at most kMaxInFlight requests pending, and a request
+ * completes when its metadata and all its buffers came back. Reports
+ * request to result latency, in-flight occupancy and callback CPU time
+ * with the same QCameraLatencyStats the HAL uses in dump().
+ *
+ * A recorded request stream is a text file, one request per line:
+ *     <gap_us> <stream_mask>
+ * gap_us is the time since the previous submission (0: as soon as the
+ * in-flight limit allows), bit n of stream_mask requests output stream n.
+ * Lines starting with '#' are ignored. Without a file a request stream
+ * with preview on every frame, video on every frame and a still every
+ * 30th frame is generated. Exits with 1 when requests do not complete.
+ *
+ * With -F the driver checks flush instead: each cycle fills the pipeline
+ * with requests and flushes it the way QCamera3HardwareInterface::flush
+ * does, output channels stopped concurrently on a QCameraJobPool and the
+ * metadata channel last, then once more with the channels stopped one
+ * after another. Exits with 1 when a pooled flush exceeds its bound, which
+ * is one stream off per worker round plus the metadata stream off, or is
+ * not faster than the serial one. */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "qcamera_sim_camera.h"
+#include "QCameraLatencyStats.h"
+#include "QCameraJobPool.h"
+
+using namespace qcamera;
+
+#define REPLAY_MAX_OUTPUTS    6
+#define REPLAY_MAX_PENDING    64
+#define REPLAY_META_BUFS      16
+#define REPLAY_TIMEOUT_NS     5000000000LL
+#define REPLAY_FLUSH_WORKERS  4      // QCamera3HardwareInterface::kFlushStopWorkers
+#define REPLAY_FLUSH_SLACK_NS 30000000LL
+
+typedef struct {
+    int64_t gapNs;
+    uint32_t streamMask;
+} replay_request_t;
+
+typedef struct {
+    uint32_t frameNumber;
+    int64_t submitTime;
+    uint32_t expected;     // stream mask still to come back
+    uint8_t metaDone;
+    uint8_t inUse;
+} replay_pending_t;
+
+class ReplayClient;
+
+typedef struct {
+    ReplayClient *client;
+    int index;                        // output index, -1 for metadata
+    uint32_t chId;
+    uint32_t streamId;
+    cam_stream_info_t info;
+    mm_camera_stream_config_t config;
+    mm_camera_buf_def_t *bufs;
+    uint8_t *regFlags;
+    uint8_t *mem;
+    uint8_t numBufs;
+    uint32_t bufFrame[MM_CAMERA_MAX_NUM_FRAMES];  // frame number per buffer
+    uint8_t bufBusy[MM_CAMERA_MAX_NUM_FRAMES];
+} replay_stream_t;
+
+class ReplayClient {
+public:
+    ReplayClient(mm_camera_vtbl_t *cam, int outputs, int maxInFlight, int workUs);
+    ~ReplayClient();
+
+    bool start();
+    void stop();
+    int64_t flush(QCameraJobPool *pool);
+    bool submit(uint32_t streamMask);
+    bool waitIdle(int64_t timeoutNs);
+    void report(const char *name);
+    uint32_t getFailures() { return m_nFailures; }
+    uint32_t getInFlight();
+
+private:
+    bool addStream(replay_stream_t *stream, cam_stream_type_t type,
+                   int32_t width, int32_t height, uint8_t numBufs);
+    void handleMetadata(replay_stream_t *stream, mm_camera_buf_def_t *buf);
+    void handleBuffer(replay_stream_t *stream, mm_camera_buf_def_t *buf);
+    void completeLocked(replay_pending_t *pending);
+    void doWork();
+    void teardown();
+
+    static void stopStreamJob(void *data);
+    static void dataCb(mm_camera_super_buf_t *bufs, void *userdata);
+    static int32_t getBufs(cam_frame_len_offset_t *offset, uint8_t *num_bufs,
+                           uint8_t **initial_reg_flag, mm_camera_buf_def_t **bufs,
+                           mm_camera_map_unmap_ops_tbl_t *ops_tbl, void *user_data);
+    static int32_t putBufs(mm_camera_map_unmap_ops_tbl_t *ops_tbl, void *user_data);
+
+    mm_camera_vtbl_t *m_pCam;
+    int m_nOutputs;
+    int m_nMaxInFlight;
+    int m_nWorkUs;
+    replay_stream_t m_metaStream;
+    replay_stream_t m_outStreams[REPLAY_MAX_OUTPUTS];
+    parm_buffer_t *m_pParms;
+    replay_pending_t m_pending[REPLAY_MAX_PENDING];
+    uint32_t m_nNextFrame;
+    uint32_t m_nInFlight;
+    uint32_t m_nFailures;
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_cond;
+
+    QCameraLatencyStats m_latency;      // request to result, usec
+    QCameraLatencyStats m_inFlight;     // pending requests at submit time
+    QCameraLatencyStats m_metaCpu;      // metadata callback cpu, usec
+    QCameraLatencyStats m_bufCpu;       // buffer callback cpu, usec
+};
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t threadCpuNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+ReplayClient::ReplayClient(mm_camera_vtbl_t *cam, int outputs, int maxInFlight,
+                           int workUs)
+    : m_pCam(cam), m_nOutputs(outputs), m_nMaxInFlight(maxInFlight),
+      m_nWorkUs(workUs), m_pParms(NULL), m_nNextFrame(0), m_nInFlight(0),
+      m_nFailures(0)
+{
+    memset(&m_metaStream, 0, sizeof(m_metaStream));
+    memset(m_outStreams, 0, sizeof(m_outStreams));
+    memset(m_pending, 0, sizeof(m_pending));
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_cond, NULL);
+}
+
+ReplayClient::~ReplayClient()
+{
+    free(m_pParms);
+    pthread_cond_destroy(&m_cond);
+    pthread_mutex_destroy(&m_lock);
+}
+
+int32_t ReplayClient::getBufs(cam_frame_len_offset_t *offset, uint8_t *num_bufs,
+                              uint8_t **initial_reg_flag, mm_camera_buf_def_t **bufs,
+                              mm_camera_map_unmap_ops_tbl_t *ops_tbl, void *user_data)
+{
+    replay_stream_t *stream = (replay_stream_t *)user_data;
+    uint32_t len = offset->frame_len;
+
+    stream->bufs = (mm_camera_buf_def_t *)calloc(stream->numBufs,
+        sizeof(mm_camera_buf_def_t));
+    stream->regFlags = (uint8_t *)calloc(stream->numBufs, sizeof(uint8_t));
+    stream->mem = (uint8_t *)calloc(stream->numBufs, len);
+    if ((NULL == stream->bufs) || (NULL == stream->regFlags) ||
+            (NULL == stream->mem)) {
+        free(stream->bufs);
+        free(stream->regFlags);
+        free(stream->mem);
+        stream->bufs = NULL;
+        stream->regFlags = NULL;
+        stream->mem = NULL;
+        return -1;
+    }
+    for (uint8_t i = 0; i < stream->numBufs; i++) {
+        stream->bufs[i].stream_id = stream->streamId;
+        stream->bufs[i].buf_idx = (int8_t)i;
+        stream->bufs[i].fd = -1;
+        stream->bufs[i].buffer = stream->mem + (size_t)i * len;
+        stream->bufs[i].frame_len = len;
+        stream->bufs[i].num_planes = 1;
+        ops_tbl->map_ops(i, -1, -1, len, ops_tbl->userdata);
+        // metadata buffers start with the backend, HAL3 output buffers
+        // are queued per request
+        stream->regFlags[i] = (stream->index < 0) ? 1 : 0;
+        stream->bufBusy[i] = stream->regFlags[i];
+    }
+    *num_bufs = stream->numBufs;
+    *initial_reg_flag = stream->regFlags;
+    *bufs = stream->bufs;
+    return 0;
+}
+
+int32_t ReplayClient::putBufs(mm_camera_map_unmap_ops_tbl_t *ops_tbl, void *user_data)
+{
+    replay_stream_t *stream = (replay_stream_t *)user_data;
+    for (uint8_t i = 0; i < stream->numBufs; i++) {
+        ops_tbl->unmap_ops(i, -1, ops_tbl->userdata);
+    }
+    free(stream->bufs);
+    free(stream->regFlags);
+    free(stream->mem);
+    stream->bufs = NULL;
+    stream->regFlags = NULL;
+    stream->mem = NULL;
+    return 0;
+}
+
+bool ReplayClient::addStream(replay_stream_t *stream, cam_stream_type_t type,
+                             int32_t width, int32_t height, uint8_t numBufs)
+{
+    uint32_t camHandle = m_pCam->camera_handle;
+
+    stream->client = this;
+    stream->numBufs = numBufs;
+    stream->chId = m_pCam->ops->add_channel(camHandle, NULL, NULL, NULL);
+    if (0 == stream->chId) {
+        return false;
+    }
+    stream->streamId = m_pCam->ops->add_stream(camHandle, stream->chId);
+    if (0 == stream->streamId) {
+        return false;
+    }
+    memset(&stream->info, 0, sizeof(stream->info));
+    stream->info.stream_type = type;
+    stream->info.fmt = CAM_FORMAT_YUV_420_NV21;
+    stream->info.dim.width = width;
+    stream->info.dim.height = height;
+    stream->info.num_bufs = numBufs;
+    stream->info.streaming_mode = CAM_STREAMING_MODE_CONTINUOUS;
+
+    memset(&stream->config, 0, sizeof(stream->config));
+    stream->config.stream_info = &stream->info;
+    stream->config.mem_vtbl.user_data = stream;
+    stream->config.mem_vtbl.get_bufs = getBufs;
+    stream->config.mem_vtbl.put_bufs = putBufs;
+    stream->config.stream_cb = dataCb;
+    stream->config.userdata = stream;
+    return 0 == m_pCam->ops->config_stream(camHandle, stream->chId,
+        stream->streamId, &stream->config);
+}
+
+bool ReplayClient::start()
+{
+    static const cam_stream_type_t types[REPLAY_MAX_OUTPUTS] = {
+        CAM_STREAM_TYPE_PREVIEW, CAM_STREAM_TYPE_VIDEO, CAM_STREAM_TYPE_SNAPSHOT,
+        CAM_STREAM_TYPE_PREVIEW, CAM_STREAM_TYPE_VIDEO, CAM_STREAM_TYPE_SNAPSHOT,
+    };
+    uint32_t camHandle = m_pCam->camera_handle;
+
+    m_pParms = (parm_buffer_t *)malloc(sizeof(parm_buffer_t));
+    if (NULL == m_pParms) {
+        return false;
+    }
+    m_pCam->ops->map_buf(camHandle, CAM_MAPPING_BUF_TYPE_PARM_BUF, -1,
+        sizeof(parm_buffer_t));
+
+    m_metaStream.index = -1;
+    if (!addStream(&m_metaStream, CAM_STREAM_TYPE_METADATA, sizeof(metadata_buffer_t),
+            1, REPLAY_META_BUFS)) {
+        return false;
+    }
+    for (int i = 0; i < m_nOutputs; i++) {
+        m_outStreams[i].index = i;
+        if (!addStream(&m_outStreams[i], types[i], 640, 480,
+                (uint8_t)(m_nMaxInFlight + 2))) {
+            return false;
+        }
+    }
+
+    // metadata first, as configureStreams starts it before any request
+    if (0 != m_pCam->ops->start_channel(camHandle, m_metaStream.chId)) {
+        return false;
+    }
+    for (int i = 0; i < m_nOutputs; i++) {
+        if (0 != m_pCam->ops->start_channel(camHandle, m_outStreams[i].chId)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ReplayClient::teardown()
+{
+    uint32_t camHandle = m_pCam->camera_handle;
+    for (int i = 0; i < m_nOutputs; i++) {
+        m_pCam->ops->delete_stream(camHandle, m_outStreams[i].chId,
+            m_outStreams[i].streamId);
+        m_pCam->ops->delete_channel(camHandle, m_outStreams[i].chId);
+    }
+    m_pCam->ops->delete_stream(camHandle, m_metaStream.chId, m_metaStream.streamId);
+    m_pCam->ops->delete_channel(camHandle, m_metaStream.chId);
+    m_pCam->ops->unmap_buf(camHandle, CAM_MAPPING_BUF_TYPE_PARM_BUF);
+}
+
+void ReplayClient::stop()
+{
+    uint32_t camHandle = m_pCam->camera_handle;
+    for (int i = 0; i < m_nOutputs; i++) {
+        m_pCam->ops->stop_channel(camHandle, m_outStreams[i].chId);
+    }
+    m_pCam->ops->stop_channel(camHandle, m_metaStream.chId);
+    teardown();
+}
+
+void ReplayClient::stopStreamJob(void *data)
+{
+    replay_stream_t *stream = (replay_stream_t *)data;
+    ReplayClient *client = stream->client;
+    client->m_pCam->ops->stop_channel(client->m_pCam->camera_handle, stream->chId);
+}
+
+/* stops all channels with requests in flight and drops those requests,
+ * returns the time the channels took to stop */
+int64_t ReplayClient::flush(QCameraJobPool *pool)
+{
+    void *jobs[REPLAY_MAX_OUTPUTS];
+    int64_t start = nowNs();
+
+    for (int i = 0; i < m_nOutputs; i++) {
+        jobs[i] = &m_outStreams[i];
+    }
+    if (NULL != pool) {
+        pool->run(stopStreamJob, jobs, (uint32_t)m_nOutputs);
+    } else {
+        for (int i = 0; i < m_nOutputs; i++) {
+            stopStreamJob(jobs[i]);
+        }
+    }
+    // metadata of in-flight frames keeps flowing until the outputs stopped
+    m_pCam->ops->stop_channel(m_pCam->camera_handle, m_metaStream.chId);
+    int64_t elapsed = nowNs() - start;
+
+    // pending requests are returned with errors
+    pthread_mutex_lock(&m_lock);
+    memset(m_pending, 0, sizeof(m_pending));
+    m_nInFlight = 0;
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_lock);
+
+    teardown();
+    return elapsed;
+}
+
+uint32_t ReplayClient::getInFlight()
+{
+    pthread_mutex_lock(&m_lock);
+    uint32_t inFlight = m_nInFlight;
+    pthread_mutex_unlock(&m_lock);
+    return inFlight;
+}
+
+bool ReplayClient::submit(uint32_t streamMask)
+{
+    uint32_t camHandle = m_pCam->camera_handle;
+    int64_t deadline = nowNs() + REPLAY_TIMEOUT_NS;
+
+    streamMask &= (1 << m_nOutputs) - 1;
+
+    // processCaptureRequest blocks while kMaxInFlight requests are pending
+    pthread_mutex_lock(&m_lock);
+    while ((int)m_nInFlight >= m_nMaxInFlight) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 10000000;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&m_cond, &m_lock, &ts);
+        if (nowNs() > deadline) {
+            pthread_mutex_unlock(&m_lock);
+            printf("request %u: in-flight limit never released\n", m_nNextFrame);
+            m_nFailures++;
+            return false;
+        }
+    }
+
+    uint32_t frameNumber = m_nNextFrame++;
+    replay_pending_t *pending = &m_pending[frameNumber % REPLAY_MAX_PENDING];
+    if (pending->inUse) {
+        pthread_mutex_unlock(&m_lock);
+        printf("request %u: pending slot still busy\n", frameNumber);
+        m_nFailures++;
+        return false;
+    }
+    pending->inUse = 1;
+    pending->frameNumber = frameNumber;
+    pending->metaDone = 0;
+    pending->expected = 0;
+    pending->submitTime = nowNs();
+    m_nInFlight++;
+    m_inFlight.add(m_nInFlight);
+
+    // setFrameParameters: the frame number goes to the backend first
+    memset(m_pParms->is_valid, 0, sizeof(m_pParms->is_valid));
+    memcpy(POINTER_OF_PARAM(CAM_INTF_META_FRAME_NUMBER, m_pParms), &frameNumber,
+        sizeof(frameNumber));
+    m_pParms->is_valid[CAM_INTF_META_FRAME_NUMBER] = 1;
+    if (0 != m_pCam->ops->set_parms(camHandle, m_pParms)) {
+        printf("request %u: set_parms failed\n", frameNumber);
+    }
+
+    // then each requested stream queues one of its buffers
+    for (int i = 0; i < m_nOutputs; i++) {
+        replay_stream_t *stream = &m_outStreams[i];
+        if (!(streamMask & (1 << i))) {
+            continue;
+        }
+        int idx = -1;
+        for (int b = 0; b < stream->numBufs; b++) {
+            if (!stream->bufBusy[b]) {
+                idx = b;
+                break;
+            }
+        }
+        if (idx < 0) {
+            printf("request %u: no free buffer on stream %d\n", frameNumber, i);
+            continue;
+        }
+        stream->bufBusy[idx] = 1;
+        stream->bufFrame[idx] = frameNumber;
+        pending->expected |= 1 << i;
+        if (0 != m_pCam->ops->qbuf(camHandle, stream->chId, &stream->bufs[idx])) {
+            stream->bufBusy[idx] = 0;
+            pending->expected &= ~(1 << i);
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+    return true;
+}
+
+void ReplayClient::doWork()
+{
+    // stand-in for metadata translation and result assembly in the HAL
+    if (m_nWorkUs > 0) {
+        int64_t end = threadCpuNs() + (int64_t)m_nWorkUs * 1000;
+        while (threadCpuNs() < end) {
+        }
+    }
+}
+
+void ReplayClient::completeLocked(replay_pending_t *pending)
+{
+    if (!pending->metaDone || (0 != pending->expected)) {
+        return;
+    }
+    m_latency.add((nowNs() - pending->submitTime) / 1000);
+    pending->inUse = 0;
+    m_nInFlight--;
+    pthread_cond_broadcast(&m_cond);
+}
+
+void ReplayClient::handleMetadata(replay_stream_t *stream, mm_camera_buf_def_t *buf)
+{
+    metadata_buffer_t *meta = (metadata_buffer_t *)buf->buffer;
+    int32_t valid = *(int32_t *)
+        POINTER_OF_META(CAM_INTF_META_FRAME_NUMBER_VALID, meta);
+    uint32_t frameNumber = *(uint32_t *)
+        POINTER_OF_META(CAM_INTF_META_FRAME_NUMBER, meta);
+
+    doWork();
+    pthread_mutex_lock(&m_lock);
+    if (valid) {
+        replay_pending_t *pending = &m_pending[frameNumber % REPLAY_MAX_PENDING];
+        if (pending->inUse && (pending->frameNumber == frameNumber)) {
+            pending->metaDone = 1;
+            completeLocked(pending);
+        }
+    }
+    pthread_mutex_unlock(&m_lock);
+    m_pCam->ops->qbuf(m_pCam->camera_handle, stream->chId, buf);
+}
+
+void ReplayClient::handleBuffer(replay_stream_t *stream, mm_camera_buf_def_t *buf)
+{
+    doWork();
+    pthread_mutex_lock(&m_lock);
+    uint32_t frameNumber = stream->bufFrame[buf->buf_idx];
+    replay_pending_t *pending = &m_pending[frameNumber % REPLAY_MAX_PENDING];
+    if (pending->inUse && (pending->frameNumber == frameNumber)) {
+        pending->expected &= ~(1 << stream->index);
+        completeLocked(pending);
+    }
+    // the framework hands the buffer back with a later request
+    stream->bufBusy[buf->buf_idx] = 0;
+    pthread_mutex_unlock(&m_lock);
+}
+
+void ReplayClient::dataCb(mm_camera_super_buf_t *bufs, void *userdata)
+{
+    replay_stream_t *stream = (replay_stream_t *)userdata;
+    ReplayClient *client = stream->client;
+    int64_t start = threadCpuNs();
+
+    if (stream->index < 0) {
+        client->handleMetadata(stream, bufs->bufs[0]);
+        client->m_metaCpu.add((threadCpuNs() - start) / 1000);
+    } else {
+        client->handleBuffer(stream, bufs->bufs[0]);
+        client->m_bufCpu.add((threadCpuNs() - start) / 1000);
+    }
+}
+
+bool ReplayClient::waitIdle(int64_t timeoutNs)
+{
+    int64_t deadline = nowNs() + timeoutNs;
+    bool idle;
+
+    pthread_mutex_lock(&m_lock);
+    while ((m_nInFlight > 0) && (nowNs() < deadline)) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 10000000;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&m_cond, &m_lock, &ts);
+    }
+    idle = (0 == m_nInFlight);
+    if (!idle) {
+        printf("%u requests never completed\n", m_nInFlight);
+        m_nFailures += m_nInFlight;
+    }
+    pthread_mutex_unlock(&m_lock);
+    return idle;
+}
+
+void ReplayClient::report(const char *name)
+{
+    sim_camera_stats_t stats;
+    sim_camera_get_stats(m_pCam->camera_handle, &stats);
+
+    printf("%s: %u requests, %u sensor frames, %u starved stream frames\n",
+        name, m_latency.getCount(), stats.frames, stats.starved);
+    printf("  request to result us  p50 %6lld p90 %6lld p99 %6lld max %6lld\n",
+        (long long)m_latency.getPercentile(50), (long long)m_latency.getPercentile(90),
+        (long long)m_latency.getPercentile(99), (long long)m_latency.getMax());
+    printf("  in-flight requests    p50 %6lld p90 %6lld p99 %6lld max %6lld\n",
+        (long long)m_inFlight.getPercentile(50), (long long)m_inFlight.getPercentile(90),
+        (long long)m_inFlight.getPercentile(99), (long long)m_inFlight.getMax());
+    printf("  metadata cb cpu us    p50 %6lld p90 %6lld p99 %6lld max %6lld\n",
+        (long long)m_metaCpu.getPercentile(50), (long long)m_metaCpu.getPercentile(90),
+        (long long)m_metaCpu.getPercentile(99), (long long)m_metaCpu.getMax());
+    printf("  buffer cb cpu us      p50 %6lld p90 %6lld p99 %6lld max %6lld\n",
+        (long long)m_bufCpu.getPercentile(50), (long long)m_bufCpu.getPercentile(90),
+        (long long)m_bufCpu.getPercentile(99), (long long)m_bufCpu.getMax());
+}
+
+/* request stream from a recorded trace file */
+static int loadTrace(const char *path, replay_request_t **reqs)
+{
+    FILE *fp = fopen(path, "r");
+    char line[128];
+    int count = 0;
+    int capacity = 0;
+
+    if (NULL == fp) {
+        printf("cannot open %s\n", path);
+        return -1;
+    }
+    *reqs = NULL;
+    while (NULL != fgets(line, sizeof(line), fp)) {
+        long long gapUs;
+        unsigned int mask;
+        if (('#' == line[0]) || (2 != sscanf(line, "%lld %x", &gapUs, &mask))) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            replay_request_t *grown = (replay_request_t *)realloc(*reqs,
+                sizeof(replay_request_t) * capacity);
+            if (NULL == grown) {
+                free(*reqs);
+                fclose(fp);
+                return -1;
+            }
+            *reqs = grown;
+        }
+        (*reqs)[count].gapNs = gapUs * 1000;
+        (*reqs)[count].streamMask = mask;
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+/* preview and video every frame, a still every 30th */
+static int makeTrace(int count, replay_request_t **reqs)
+{
+    *reqs = (replay_request_t *)malloc(sizeof(replay_request_t) * count);
+    if (NULL == *reqs) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        (*reqs)[i].gapNs = 0;
+        (*reqs)[i].streamMask = 0x3 | ((i % 30 == 29) ? 0x4 : 0);
+    }
+    return count;
+}
+
+/* fills the pipeline and flushes it, once pooled and once serially per
+ * cycle */
+static bool runFlush(const sim_camera_cfg_t *cfg, int outputs, int maxInFlight,
+                     int workUs, int cycles)
+{
+    QCameraLatencyStats pooled;
+    QCameraLatencyStats serial;
+    QCameraJobPool pool;
+    uint32_t minInFlight = (uint32_t)maxInFlight;
+    bool ok = true;
+
+    mm_camera_vtbl_t *cam = sim_camera_open(cfg);
+    if ((NULL == cam) || (0 != pool.init(REPLAY_FLUSH_WORKERS, "flushStop"))) {
+        printf("cannot open the simulated camera\n");
+        return false;
+    }
+
+    for (int i = 0; ok && (i < 2 * cycles); i++) {
+        bool usePool = (0 == (i % 2));
+        ReplayClient *client = new ReplayClient(cam, outputs, maxInFlight, workUs);
+        ok = client->start();
+        for (int r = 0; ok && (r < maxInFlight); r++) {
+            ok = client->submit((1 << outputs) - 1);
+        }
+        if (!ok) {
+            printf("cannot fill the pipeline\n");
+            delete client;
+            break;
+        }
+        uint32_t inFlight = client->getInFlight();
+        if (inFlight < minInFlight) {
+            minInFlight = inFlight;
+        }
+        int64_t elapsed = client->flush(usePool ? &pool : NULL);
+        (usePool ? pooled : serial).add(elapsed / 1000);
+        if (0 != client->getInFlight()) {
+            printf("requests left after flush\n");
+            ok = false;
+        }
+        delete client;
+    }
+    pool.deinit();
+    cam->ops->close_camera(cam->camera_handle);
+
+    int64_t rounds = (outputs + REPLAY_FLUSH_WORKERS - 1) / REPLAY_FLUSH_WORKERS;
+    int64_t boundUs = ((rounds + 1) * cfg->streamOffNs + REPLAY_FLUSH_SLACK_NS) / 1000;
+    printf("flush: %d cycles, %d outputs, %u+ requests in flight, "
+        "stream off %lld us\n", cycles, outputs, minInFlight,
+        (long long)(cfg->streamOffNs / 1000));
+    printf("  pooled flush us       p50 %6lld p90 %6lld max %6lld bound %6lld\n",
+        (long long)pooled.getPercentile(50), (long long)pooled.getPercentile(90),
+        (long long)pooled.getMax(), (long long)boundUs);
+    printf("  serial flush us       p50 %6lld p90 %6lld max %6lld\n",
+        (long long)serial.getPercentile(50), (long long)serial.getPercentile(90),
+        (long long)serial.getMax());
+    if (ok && (pooled.getMax() > boundUs)) {
+        printf("pooled flush above the bound\n");
+        ok = false;
+    }
+    if (ok && (outputs > 1) &&
+            (pooled.getPercentile(50) >= serial.getPercentile(50))) {
+        printf("pooled flush not faster than serial\n");
+        ok = false;
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    sim_camera_cfg_t cfg;
+    const char *trace = NULL;
+    int count = 300;
+    int outputs = 3;
+    int flushCycles = 0;
+    int maxInFlight = 5;       // QCamera3HardwareInterface::kMaxInFlight
+    int workUs = 0;
+    replay_request_t *reqs = NULL;
+    int c;
+
+    sim_camera_default_cfg(&cfg);
+    while ((c = getopt(argc, argv, "t:n:f:j:d:o:m:w:F:s:")) != -1) {
+        switch (c) {
+        case 't':
+            trace = optarg;
+            break;
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 'f':
+            cfg.fps = atoi(optarg);
+            break;
+        case 'j':
+            cfg.jitterNs = atoll(optarg) * 1000;
+            break;
+        case 'd':
+            cfg.pipelineDepth = atoi(optarg);
+            break;
+        case 'o':
+            outputs = atoi(optarg);
+            break;
+        case 'm':
+            maxInFlight = atoi(optarg);
+            break;
+        case 'w':
+            workUs = atoi(optarg);
+            break;
+        case 'F':
+            flushCycles = atoi(optarg);
+            break;
+        case 's':
+            cfg.streamOffNs = atoll(optarg) * 1000;
+            break;
+        default:
+            printf("usage: %s [-t trace] [-n requests] [-f fps] [-j jitter_us] "
+                "[-d pipeline_depth] [-o outputs] [-m max_in_flight] "
+                "[-w callback_work_us] [-F flush_cycles] [-s stream_off_us]\n",
+                argv[0]);
+            return 1;
+        }
+    }
+    if ((cfg.fps == 0) || (outputs < 1) || (outputs > REPLAY_MAX_OUTPUTS) ||
+            (maxInFlight < 1) || (maxInFlight + 2 > MM_CAMERA_MAX_NUM_FRAMES) ||
+            (cfg.pipelineDepth > SIM_MAX_DEPTH)) {
+        printf("invalid configuration\n");
+        return 1;
+    }
+
+    if (flushCycles > 0) {
+        return runFlush(&cfg, outputs, maxInFlight, workUs, flushCycles) ? 0 : 1;
+    }
+
+    count = (NULL != trace) ? loadTrace(trace, &reqs) : makeTrace(count, &reqs);
+    if (count <= 0) {
+        printf("empty request stream\n");
+        free(reqs);
+        return 1;
+    }
+
+    mm_camera_vtbl_t *cam = sim_camera_open(&cfg);
+    if (NULL == cam) {
+        printf("cannot open the simulated camera\n");
+        free(reqs);
+        return 1;
+    }
+
+    printf("%d requests, %u fps, jitter %lld us, pipeline depth %u, "
+        "%d outputs, %d in flight, %d us callback work\n", count, cfg.fps,
+        (long long)(cfg.jitterNs / 1000), cfg.pipelineDepth, outputs,
+        maxInFlight, workUs);
+
+    ReplayClient *client = new ReplayClient(cam, outputs, maxInFlight, workUs);
+    bool ok = client->start();
+    if (!ok) {
+        printf("cannot start streams\n");
+    }
+    int64_t next = nowNs();
+    for (int i = 0; ok && (i < count); i++) {
+        next += reqs[i].gapNs;
+        int64_t wait = next - nowNs();
+        if (wait > 0) {
+            usleep((useconds_t)(wait / 1000));
+        }
+        ok = client->submit(reqs[i].streamMask);
+    }
+    ok = client->waitIdle(REPLAY_TIMEOUT_NS) && ok;
+    client->stop();
+    client->report((NULL != trace) ? trace : "generated");
+    ok = ok && (0 == client->getFailures());
+
+    delete client;
+    cam->ops->close_camera(cam->camera_handle);
+    free(reqs);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,361 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Measures the time to map a stream's buffers over the camera domain
+ * socket with one message per buffer and with bundled mapping messages.
+ * The client side uses the send functions of mm_camera_sock.c as
+ * mm_camera_util_sendmsg / mm_camera_util_bundled_sendmsg do. A stand-in
+ * server thread on the other end of a socketpair receives each datagram,
+ * checks its size, msg_type and the fds carried by SCM_RIGHTS against the
+ * buffer entries, maps every fd, spends the configured per-message time
+ * (daemon dispatch and the MAP_UNMAP_DONE event path) and acks with a
+ * status, which the client waits for before the next message as under
+ * msg_lock.
+ *
+ * Exits with 1 when the server rejects a message, sees a wrong number of
+ * messages or buffers, or bundling is not faster than per-buffer mapping. */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "QCameraLatencyStats.h"
+
+extern "C" {
+#include "mm_camera_sock.h"
+}
+
+using namespace qcamera;
+
+#define BENCH_MAX_BUFS        64
+#define BENCH_STREAM_ID       7
+#define BENCH_BUF_SIZE        4096
+
+#ifdef __ANDROID__
+#define BENCH_TMP_DIR         "/data/local/tmp"
+#else
+#define BENCH_TMP_DIR         "/tmp"
+#endif
+
+typedef struct {
+    int sock;                            // server end of the socketpair
+    int costUs;                          // per-message server time
+    uint32_t msgs;
+    uint32_t mapped;
+    uint32_t errors;
+} bench_server_t;
+
+volatile uint32_t gMmCameraIntfLogLevel = 0;
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static bool checkMapping(bench_server_t *srv, const cam_buf_map_type *map, int fd)
+{
+    struct stat st;
+    void *vaddr;
+
+    if ((CAM_MAPPING_BUF_TYPE_STREAM_BUF != map->type) ||
+        (BENCH_STREAM_ID != map->stream_id) || (map->frame_idx >= BENCH_MAX_BUFS) ||
+        (0 != fstat(fd, &st)) || ((off_t)map->size != st.st_size)) {
+        printf("server: bad mapping entry for frame %u\n", map->frame_idx);
+        srv->errors++;
+        return false;
+    }
+    vaddr = mmap(NULL, map->size, PROT_READ, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == vaddr) {
+        printf("server: mmap of frame %u failed %d\n", map->frame_idx, errno);
+        srv->errors++;
+        return false;
+    }
+    munmap(vaddr, map->size);
+    srv->mapped++;
+    return true;
+}
+
+static void *serverRoutine(void *data)
+{
+    bench_server_t *srv = (bench_server_t *)data;
+    cam_sock_bundled_packet_t rcvd;
+    char control[CMSG_SPACE(sizeof(int) * CAM_MAX_NUM_BUFS_PER_MSG)];
+    struct msghdr msgh;
+    struct iovec iov[1];
+    struct cmsghdr *cmsghp;
+    int fds[CAM_MAX_NUM_BUFS_PER_MSG];
+    int numfds;
+    ssize_t len;
+
+    for (;;) {
+        memset(&msgh, 0, sizeof(msgh));
+        iov[0].iov_base = &rcvd;
+        iov[0].iov_len = sizeof(rcvd);
+        msgh.msg_iov = iov;
+        msgh.msg_iovlen = 1;
+        msgh.msg_control = control;
+        msgh.msg_controllen = sizeof(control);
+        len = recvmsg(srv->sock, &msgh, 0);
+        if (len <= 0) {
+            break;
+        }
+
+        numfds = 0;
+        cmsghp = CMSG_FIRSTHDR(&msgh);
+        if ((NULL != cmsghp) && (SOL_SOCKET == cmsghp->cmsg_level) &&
+            (SCM_RIGHTS == cmsghp->cmsg_type)) {
+            numfds = (int)((cmsghp->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            memcpy(fds, CMSG_DATA(cmsghp), sizeof(int) * numfds);
+        }
+
+        int32_t status = 0;
+        if (CAM_MAPPING_TYPE_FD_MAPPING == rcvd.msg_type) {
+            const cam_sock_packet_t *packet = (const cam_sock_packet_t *)&rcvd;
+            if ((sizeof(cam_sock_packet_t) != (size_t)len) || (1 != numfds) ||
+                !checkMapping(srv, &packet->payload.buf_map, fds[0])) {
+                status = -1;
+            }
+        } else if (CAM_MAPPING_TYPE_FD_BUNDLED_MAPPING == rcvd.msg_type) {
+            if ((sizeof(cam_sock_bundled_packet_t) != (size_t)len) ||
+                (rcvd.payload.length != (uint32_t)numfds)) {
+                status = -1;
+            } else {
+                for (int i = 0; i < numfds; i++) {
+                    if (!checkMapping(srv, &rcvd.payload.buf_maps[i], fds[i])) {
+                        status = -1;
+                    }
+                }
+            }
+        } else {
+            status = -1;
+        }
+        if (0 != status) {
+            printf("server: rejected msg_type %u, %zd bytes, %d fds\n",
+                rcvd.msg_type, len, numfds);
+            srv->errors++;
+        }
+        for (int i = 0; i < numfds; i++) {
+            close(fds[i]);
+        }
+        srv->msgs++;
+
+        if (srv->costUs > 0) {
+            usleep((useconds_t)srv->costUs);
+        }
+        if (send(srv->sock, &status, sizeof(status), 0) != sizeof(status)) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+// client side wait for MAP_UNMAP_DONE
+static bool waitAck(int sock)
+{
+    int32_t status = -1;
+    if (recv(sock, &status, sizeof(status), 0) != sizeof(status)) {
+        return false;
+    }
+    return (0 == status);
+}
+
+static void fillMapping(cam_buf_map_type *map, uint32_t idx, int fd)
+{
+    memset(map, 0, sizeof(*map));
+    map->type = CAM_MAPPING_BUF_TYPE_STREAM_BUF;
+    map->stream_id = BENCH_STREAM_ID;
+    map->frame_idx = idx;
+    map->plane_idx = -1;
+    map->fd = fd;
+    map->size = BENCH_BUF_SIZE;
+}
+
+static bool mapPerBuffer(int sock, const int *bufFds, uint32_t numBufs)
+{
+    cam_sock_packet_t packet;
+    for (uint32_t i = 0; i < numBufs; i++) {
+        memset(&packet, 0, sizeof(packet));
+        packet.msg_type = CAM_MAPPING_TYPE_FD_MAPPING;
+        fillMapping(&packet.payload.buf_map, i, bufFds[i]);
+        if ((mm_camera_socket_sendmsg(sock, &packet, sizeof(packet), bufFds[i]) <= 0) ||
+            !waitAck(sock)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// same chunking as QCameraStream::mapStreamBufs
+static bool mapBundled(int sock, const int *bufFds, uint32_t numBufs)
+{
+    cam_sock_bundled_packet_t packet;
+    int sendfds[CAM_MAX_NUM_BUFS_PER_MSG];
+    for (uint32_t start = 0; start < numBufs; start += CAM_MAX_NUM_BUFS_PER_MSG) {
+        memset(&packet, 0, sizeof(packet));
+        packet.msg_type = CAM_MAPPING_TYPE_FD_BUNDLED_MAPPING;
+        for (uint32_t i = start; (i < numBufs) &&
+                (packet.payload.length < CAM_MAX_NUM_BUFS_PER_MSG); i++) {
+            fillMapping(&packet.payload.buf_maps[packet.payload.length], i, bufFds[i]);
+            sendfds[packet.payload.length++] = bufFds[i];
+        }
+        if ((mm_camera_socket_bundle_sendmsg(sock, &packet, sizeof(packet),
+                sendfds, (int)packet.payload.length) <= 0) || !waitAck(sock)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool runMode(bool bundled, const int *bufFds, uint32_t numBufs,
+    uint32_t iterations, int costUs, int64_t *p50)
+{
+    QCameraLatencyStats latency;
+    bench_server_t srv;
+    int socks[2];
+    pthread_t tid;
+    bool ok = true;
+
+    if (0 != socketpair(AF_UNIX, SOCK_DGRAM, 0, socks)) {
+        printf("socketpair failed %d\n", errno);
+        return false;
+    }
+    memset(&srv, 0, sizeof(srv));
+    srv.sock = socks[1];
+    srv.costUs = costUs;
+    pthread_create(&tid, NULL, serverRoutine, &srv);
+
+    for (uint32_t n = 0; n < iterations; n++) {
+        int64_t start = nowNs();
+        if (!(bundled ? mapBundled(socks[0], bufFds, numBufs) :
+                mapPerBuffer(socks[0], bufFds, numBufs))) {
+            printf("%s: mapping failed in iteration %u\n",
+                bundled ? "bundled" : "per-buffer", n);
+            ok = false;
+            break;
+        }
+        latency.add((nowNs() - start) / 1000);
+    }
+
+    // an empty datagram stops the server
+    send(socks[0], NULL, 0, 0);
+    pthread_join(tid, NULL);
+    close(socks[0]);
+    close(socks[1]);
+
+    uint32_t msgsPerMap = bundled ?
+        (numBufs + CAM_MAX_NUM_BUFS_PER_MSG - 1) / CAM_MAX_NUM_BUFS_PER_MSG : numBufs;
+    printf("%-10s %3u msgs per map, map time us p50 %6lld p90 %6lld max %6lld\n",
+        bundled ? "bundled" : "per-buffer", msgsPerMap,
+        (long long)latency.getPercentile(50), (long long)latency.getPercentile(90),
+        (long long)latency.getMax());
+    if (ok && ((srv.msgs != msgsPerMap * iterations) ||
+            (srv.mapped != numBufs * iterations))) {
+        printf("%s: server saw %u msgs and %u buffers, expected %u and %u\n",
+            bundled ? "bundled" : "per-buffer", srv.msgs, srv.mapped,
+            msgsPerMap * iterations, numBufs * iterations);
+        ok = false;
+    }
+    if (0 != srv.errors) {
+        ok = false;
+    }
+    *p50 = latency.getPercentile(50);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t iterations = 200;
+    int numBufs = 16;
+    int costUs = 100;
+    int bufFds[BENCH_MAX_BUFS];
+    int c;
+
+    while ((c = getopt(argc, argv, "n:b:c:")) != -1) {
+        switch (c) {
+        case 'n':
+            iterations = (uint32_t)atoi(optarg);
+            break;
+        case 'b':
+            numBufs = atoi(optarg);
+            break;
+        case 'c':
+            costUs = atoi(optarg);
+            break;
+        default:
+            printf("usage: %s [-n iterations] [-b buffers] "
+                "[-c server_us_per_msg]\n", argv[0]);
+            return 1;
+        }
+    }
+    if ((0 == iterations) || (numBufs < 1) || (numBufs > BENCH_MAX_BUFS) ||
+        (costUs < 0)) {
+        printf("invalid configuration\n");
+        return 1;
+    }
+
+    for (int i = 0; i < numBufs; i++) {
+        char path[] = BENCH_TMP_DIR "/qcamera_map_benchXXXXXX";
+        bufFds[i] = mkstemp(path);
+        if (bufFds[i] < 0) {
+            printf("cannot create buffer in %s\n", BENCH_TMP_DIR);
+            return 1;
+        }
+        unlink(path);
+        if (0 != ftruncate(bufFds[i], BENCH_BUF_SIZE)) {
+            printf("cannot size buffer %d\n", i);
+            return 1;
+        }
+    }
+
+    printf("%u iterations, %d buffers, %d us server time per msg, "
+        "packet %zu bytes, bundled packet %zu bytes\n", iterations, numBufs,
+        costUs, sizeof(cam_sock_packet_t), sizeof(cam_sock_bundled_packet_t));
+    int64_t perBufP50 = 0;
+    int64_t bundledP50 = 0;
+    bool ok = runMode(false, bufFds, (uint32_t)numBufs, iterations, costUs, &perBufP50);
+    ok = runMode(true, bufFds, (uint32_t)numBufs, iterations, costUs, &bundledP50) && ok;
+    if (ok && (numBufs > 1) && (bundledP50 >= perBufP50)) {
+        printf("bundled mapping p50 %lld us not below per-buffer %lld us\n",
+            (long long)bundledP50, (long long)perBufP50);
+        ok = false;
+    }
+
+    for (int i = 0; i < numBufs; i++) {
+        close(bufFds[i]);
+    }
+    return ok ? 0 : 1;
+}
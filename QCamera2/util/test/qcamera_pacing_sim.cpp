@@ -0,0 +1,368 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Simulated preview window for QCameraFramePacer. A sensor fills preview
+ * buffers at a fixed rate, frames reach the HAL through a delivery chain
+ * with bursty stalls, and a compositor latches one queued buffer per vsync
+ * in FIFO order. The same delivery trace is displayed once on arrival and
+ * once through the pacer, and for both the display jitter, frames shown
+ * for an uneven number of vsyncs (judder), failed dequeues and sensor
+ * drops are reported. The run fails when pacing does not beat displaying
+ * on arrival. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "QCameraFramePacer.h"
+
+using namespace qcamera;
+
+#define SIM_TICK 100000LL               // 100 usec
+#define SIM_MAX_BUFS 16
+#define SIM_MIN_KERNEL_BUFS 2           // as QCAMERA_PREVIEW_PACE_MIN_KERNEL_BUFS
+
+typedef enum {
+    BUF_KERNEL,     // free for the sensor
+    BUF_INFLIGHT,   // filled, on its way to the HAL
+    BUF_HAL,        // delivered, waiting for display
+    BUF_QUEUED,     // queued to the window
+    BUF_SCREEN,     // on screen
+    BUF_FREE,       // in the window, can be dequeued
+} buf_state_t;
+
+typedef struct {
+    int64_t frameInterval;  // sensor
+    int64_t vsync;          // display refresh
+    int32_t bufCnt;         // preview buffers
+    int32_t minUndequeued;  // buffers the window keeps
+    int64_t baseDelay;      // sensor to HAL delivery
+    int64_t noise;          // uniform delivery noise
+    int32_t stallPct;       // chance of a delivery stall per frame
+    int64_t stallMax;       // longest stall
+    int64_t latency;        // pacer latency, 0 for default
+    int64_t duration;
+    unsigned int seed;
+} sim_config_t;
+
+typedef struct {
+    buf_state_t state;
+    uint32_t frameIdx;
+    int64_t sensorTs;
+    int64_t arrival;
+    int64_t target;
+    int32_t vsyncs;         // vsyncs on screen
+} sim_buf_t;
+
+typedef struct {
+    uint32_t frames;        // frames displayed
+    uint32_t judder;        // frames not shown for exactly the ideal vsyncs
+    uint32_t dequeueFails;
+    uint32_t sensorDrops;
+    uint32_t overflows;     // paced frames displayed early to feed the sensor
+    uint32_t late;          // paced frames delivered after their slot
+    int64_t latencySum;     // sensor timestamp to first vsync on screen
+    uint32_t latencyCnt;
+    int64_t jitter[3];      // display jitter p50/p95/p99, usec
+    int64_t arrivalJitter[3];
+    int64_t queued[2];      // window queue occupancy p50/max
+} sim_result_t;
+
+static int64_t randRange(unsigned int *seed, int64_t max)
+{
+    if (max <= 0) {
+        return 0;
+    }
+    return (int64_t)(rand_r(seed) % (max / SIM_TICK + 1)) * SIM_TICK;
+}
+
+static int32_t countState(const sim_buf_t *bufs, int32_t cnt, buf_state_t state)
+{
+    int32_t n = 0;
+    for (int32_t i = 0; i < cnt; i++) {
+        if (bufs[i].state == state) {
+            n++;
+        }
+    }
+    return n;
+}
+
+/* enqueue a buffer to the window and dequeue one back, as displayBuffer */
+static void displayBuffer(sim_buf_t *bufs, int32_t cnt, int32_t idx,
+                          int64_t now, int32_t *queue, int32_t &queueLen,
+                          QCameraFramePacer &pacer,
+                          QCameraLatencyStats &occupancy, sim_result_t &res)
+{
+    bufs[idx].state = BUF_QUEUED;
+    bufs[idx].vsyncs = 0;
+    queue[queueLen++] = idx;
+    occupancy.add(queueLen);
+    pacer.displayed(bufs[idx].sensorTs, bufs[idx].arrival, now);
+    res.frames++;
+
+    for (int32_t i = 0; i < cnt; i++) {
+        if (BUF_FREE == bufs[i].state) {
+            bufs[i].state = BUF_KERNEL;
+            return;
+        }
+    }
+    res.dequeueFails++;
+}
+
+static void runSim(const sim_config_t &cfg, bool paced, sim_result_t &res)
+{
+    sim_buf_t bufs[SIM_MAX_BUFS];
+    int32_t queue[SIM_MAX_BUFS];    // window FIFO
+    int32_t queueLen = 0;
+    int32_t hal[SIM_MAX_BUFS];      // delivered frames in order
+    int32_t halLen = 0;
+    int32_t screen = -1;
+    unsigned int seed = cfg.seed;
+    int64_t nextFrame = 0;
+    int64_t nextVsync = cfg.vsync / 3;
+    int64_t lastArrival = 0;
+    uint32_t frameIdx = 0;
+    int32_t idealVsyncs = (int32_t)((cfg.frameInterval + cfg.vsync / 2) / cfg.vsync);
+    QCameraFramePacer pacer;
+    QCameraLatencyStats occupancy;
+
+    memset(&res, 0, sizeof(res));
+    memset(bufs, 0, sizeof(bufs));
+    for (int32_t i = 0; i < cfg.bufCnt; i++) {
+        bufs[i].state = (i < cfg.minUndequeued) ? BUF_FREE : BUF_KERNEL;
+    }
+    pacer.setLatency(cfg.latency);
+
+    for (int64_t now = 0; now < cfg.duration; now += SIM_TICK) {
+        // sensor
+        if (now >= nextFrame) {
+            int32_t idx = -1;
+            for (int32_t i = 0; i < cfg.bufCnt && idx < 0; i++) {
+                if (BUF_KERNEL == bufs[i].state) {
+                    idx = i;
+                }
+            }
+            if (idx < 0) {
+                res.sensorDrops++;
+            } else {
+                int64_t arrival = now + cfg.baseDelay +
+                    randRange(&seed, cfg.noise);
+                if ((int32_t)(rand_r(&seed) % 100) < cfg.stallPct) {
+                    arrival += randRange(&seed, cfg.stallMax);
+                }
+                // delivery is in order, a stall holds back the frames behind
+                if (arrival < lastArrival + SIM_TICK) {
+                    arrival = lastArrival + SIM_TICK;
+                }
+                lastArrival = arrival;
+                bufs[idx].state = BUF_INFLIGHT;
+                bufs[idx].frameIdx = frameIdx;
+                bufs[idx].sensorTs = now;
+                bufs[idx].arrival = arrival;
+            }
+            frameIdx++;
+            nextFrame += cfg.frameInterval;
+        }
+
+        // delivery, in sensor order
+        for (;;) {
+            int32_t idx = -1;
+            for (int32_t i = 0; i < cfg.bufCnt; i++) {
+                if ((BUF_INFLIGHT == bufs[i].state) && (bufs[i].arrival <= now) &&
+                        ((idx < 0) || (bufs[i].sensorTs < bufs[idx].sensorTs))) {
+                    idx = i;
+                }
+            }
+            if (idx < 0) {
+                break;
+            }
+            bufs[idx].state = BUF_HAL;
+            if (paced) {
+                bufs[idx].target = pacer.schedule(bufs[idx].frameIdx,
+                    bufs[idx].sensorTs, bufs[idx].arrival);
+                hal[halLen++] = idx;
+            } else {
+                displayBuffer(bufs, cfg.bufCnt, idx, now, queue, queueLen,
+                    pacer, occupancy, res);
+            }
+        }
+
+        // pacing
+        while (halLen > 0) {
+            int32_t kernel = countState(bufs, cfg.bufCnt, BUF_KERNEL) +
+                countState(bufs, cfg.bufCnt, BUF_INFLIGHT);
+            bool overflow = kernel < SIM_MIN_KERNEL_BUFS;
+            if ((bufs[hal[0]].target > now) && !overflow) {
+                break;
+            }
+            if (bufs[hal[0]].target > now) {
+                res.overflows++;
+            }
+            displayBuffer(bufs, cfg.bufCnt, hal[0], now, queue, queueLen,
+                pacer, occupancy, res);
+            memmove(hal, hal + 1, (halLen - 1) * sizeof(int32_t));
+            halLen--;
+        }
+
+        // compositor
+        if (now >= nextVsync) {
+            if (queueLen > 0) {
+                if (screen >= 0) {
+                    if ((res.frames > 2) && (bufs[screen].vsyncs != idealVsyncs)) {
+                        res.judder++;
+                    }
+                    bufs[screen].state = BUF_FREE;
+                }
+                screen = queue[0];
+                memmove(queue, queue + 1, (queueLen - 1) * sizeof(int32_t));
+                queueLen--;
+                bufs[screen].state = BUF_SCREEN;
+                res.latencySum += now - bufs[screen].sensorTs;
+                res.latencyCnt++;
+            }
+            if (screen >= 0) {
+                bufs[screen].vsyncs++;
+            }
+            nextVsync += cfg.vsync;
+        }
+    }
+
+    res.late = pacer.getLateFrames();
+    static const uint32_t pcts[3] = {50, 95, 99};
+    for (int i = 0; i < 3; i++) {
+        res.jitter[i] = pacer.getDisplayJitter().getPercentile(pcts[i]);
+        res.arrivalJitter[i] = pacer.getArrivalJitter().getPercentile(pcts[i]);
+    }
+    res.queued[0] = occupancy.getPercentile(50);
+    res.queued[1] = occupancy.getMax();
+}
+
+static void printResult(const char *name, const sim_result_t &res)
+{
+    printf("%-8s %5u frames, jitter p50/p95/p99 %5lld/%5lld/%5lld us, "
+        "judder %4u, dequeue fails %4u, sensor drops %3u, latency %3lld ms, "
+        "window queue p50 %lld max %lld",
+        name, res.frames, (long long)res.jitter[0], (long long)res.jitter[1],
+        (long long)res.jitter[2], res.judder, res.dequeueFails, res.sensorDrops,
+        (long long)(res.latencyCnt ? res.latencySum / res.latencyCnt / 1000000 : 0),
+        (long long)res.queued[0], (long long)res.queued[1]);
+    if (res.overflows || res.late) {
+        printf(", late %u, early %u", res.late, res.overflows);
+    }
+    printf("\n");
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [options]\n", name);
+    printf("  -f <fps>   sensor frame rate (default 30)\n");
+    printf("  -r <hz>    display refresh rate (default 60)\n");
+    printf("  -b <n>     preview buffers (default 7)\n");
+    printf("  -u <n>     min undequeued buffers of the window (default 2)\n");
+    printf("  -s <pct>   delivery stall chance per frame (default 10)\n");
+    printf("  -m <ms>    longest delivery stall (default 30)\n");
+    printf("  -l <ms>    pacer latency, 0 for half a frame interval (default 0)\n");
+    printf("  -t <sec>   simulated time (default 60)\n");
+    printf("  -S <seed>  random seed (default 1)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    sim_config_t cfg;
+    cfg.frameInterval = 1000000000LL / 30;
+    cfg.vsync = 1000000000LL / 60;
+    cfg.bufCnt = 7;
+    cfg.minUndequeued = 2;
+    cfg.baseDelay = 8000000LL;
+    cfg.noise = 2000000LL;
+    cfg.stallPct = 10;
+    cfg.stallMax = 30000000LL;
+    cfg.latency = 0;
+    cfg.duration = 60000000000LL;
+    cfg.seed = 1;
+    int c;
+
+    while ((c = getopt(argc, argv, "f:r:b:u:s:m:l:t:S:h")) != -1) {
+        switch (c) {
+        case 'f':
+            cfg.frameInterval = 1000000000LL / atoi(optarg);
+            break;
+        case 'r':
+            cfg.vsync = 1000000000LL / atoi(optarg);
+            break;
+        case 'b':
+            cfg.bufCnt = atoi(optarg);
+            break;
+        case 'u':
+            cfg.minUndequeued = atoi(optarg);
+            break;
+        case 's':
+            cfg.stallPct = atoi(optarg);
+            break;
+        case 'm':
+            cfg.stallMax = atoll(optarg) * 1000000LL;
+            break;
+        case 'l':
+            cfg.latency = atoll(optarg) * 1000000LL;
+            break;
+        case 't':
+            cfg.duration = atoll(optarg) * 1000000000LL;
+            break;
+        case 'S':
+            cfg.seed = (unsigned int)atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if ((cfg.bufCnt <= cfg.minUndequeued) || (cfg.bufCnt > SIM_MAX_BUFS) ||
+            (cfg.frameInterval <= 0) || (cfg.vsync <= 0)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    sim_result_t direct, paced;
+    runSim(cfg, false, direct);
+    runSim(cfg, true, paced);
+    printf("%lld fps on %lld Hz, %d buffers, %d%% stalls up to %lld ms, "
+        "arrival jitter p50/p95/p99 %lld/%lld/%lld us\n",
+        1000000000LL / cfg.frameInterval, 1000000000LL / cfg.vsync,
+        cfg.bufCnt, cfg.stallPct, (long long)(cfg.stallMax / 1000000),
+        (long long)direct.arrivalJitter[0], (long long)direct.arrivalJitter[1],
+        (long long)direct.arrivalJitter[2]);
+    printResult("direct", direct);
+    printResult("paced", paced);
+
+    if ((paced.jitter[1] > direct.jitter[1]) || (paced.judder > direct.judder)) {
+        printf("pacing made display timing worse\n");
+        return 1;
+    }
+    return 0;
+}
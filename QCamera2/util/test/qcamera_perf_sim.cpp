@@ -0,0 +1,189 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Replays load traces through QCameraPerfGovernor so that tuning changes
+ * can be checked offline. A trace has one sample per line:
+ *
+ *   <time_ms> <thermal> <jpeg_backlog> <pp_backlog> <cb_backlog> <dropped> <total>
+ *
+ * Lines may carry any prefix up to a "perf_trace:" tag, so the samples the
+ * HAL logs with persist.camera.hal.debug=2 can be fed in as captured by
+ * logcat. Lines starting with '#' are ignored. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "QCameraPerfGovernor.h"
+
+using namespace qcamera;
+
+static void usage(const char *name)
+{
+    printf("usage: %s [options] <trace file | ->\n", name);
+    printf("  -H <pct>   high load mark (default 80)\n");
+    printf("  -L <pct>   low load mark (default 30)\n");
+    printf("  -u <ms>    escalate hold time (default 1000)\n");
+    printf("  -d <ms>    relax hold time (default 5000)\n");
+    printf("  -m <level> highest level reachable by load (default %d)\n",
+        QCAMERA_PERF_LEVEL_THERMAL_SLIGHT);
+    printf("  -x         governor off, thermal levels only\n");
+    printf("  -v         print every sample\n");
+}
+
+int main(int argc, char *argv[])
+{
+    qcamera_perf_tuning_t tuning;
+    tuning.highLoad = 80;
+    tuning.lowLoad = 30;
+    tuning.escalateHold = 1000000000LL;
+    tuning.relaxHold = 5000000000LL;
+    tuning.maxLoadLevel = QCAMERA_PERF_LEVEL_THERMAL_SLIGHT;
+    bool enabled = true;
+    bool verbose = false;
+    int c;
+
+    while ((c = getopt(argc, argv, "H:L:u:d:m:xvh")) != -1) {
+        switch (c) {
+        case 'H':
+            tuning.highLoad = atoi(optarg);
+            break;
+        case 'L':
+            tuning.lowLoad = atoi(optarg);
+            break;
+        case 'u':
+            tuning.escalateHold = atoll(optarg) * 1000000LL;
+            break;
+        case 'd':
+            tuning.relaxHold = atoll(optarg) * 1000000LL;
+            break;
+        case 'm':
+            tuning.maxLoadLevel = atoi(optarg);
+            break;
+        case 'x':
+            enabled = false;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *fp = stdin;
+    if (strcmp(argv[optind], "-") != 0) {
+        fp = fopen(argv[optind], "r");
+        if (fp == NULL) {
+            printf("cannot open %s\n", argv[optind]);
+            return 1;
+        }
+    }
+
+    QCameraPerfGovernor governor;
+    governor.setTuning(tuning);
+    governor.setEnabled(enabled);
+
+    char line[512];
+    int lineNum = 0;
+    int samples = 0;
+    int thermal = 0;
+    int64_t start = -1;
+    int64_t now = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        lineNum++;
+        char *p = strstr(line, "perf_trace:");
+        p = (p != NULL) ? p + strlen("perf_trace:") : line;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '#' || *p == '\n' || *p == '\0') {
+            continue;
+        }
+
+        long long timeMs;
+        int level;
+        qcamera_perf_load_t load;
+        if (sscanf(p, "%lld %d %u %u %u %u %u", &timeMs, &level,
+                &load.jpegBacklog, &load.ppBacklog, &load.cbBacklog,
+                &load.framesDropped, &load.framesTotal) != 7) {
+            printf("line %d: malformed sample, skipped\n", lineNum);
+            continue;
+        }
+
+        now = timeMs * 1000000LL;
+        if (start < 0) {
+            start = now;
+            governor.reset(now);
+            thermal = 0;
+        }
+        int prevLevel = governor.getLevel();
+        if (level != thermal) {
+            thermal = level;
+            governor.setThermalLevel(thermal, now);
+        }
+        governor.updateLoad(load, now);
+        samples++;
+
+        if (verbose) {
+            printf("%8lld ms  load %3d%%  level %s\n", timeMs - start / 1000000LL,
+                governor.getLoad(),
+                QCameraPerfGovernor::getLevelName(governor.getLevel()));
+        } else if (governor.getLevel() != prevLevel) {
+            printf("%8lld ms  thermal %d  load %3d%%  %s -> %s\n",
+                timeMs - start / 1000000LL, thermal, governor.getLoad(),
+                QCameraPerfGovernor::getLevelName(prevLevel),
+                QCameraPerfGovernor::getLevelName(governor.getLevel()));
+        }
+    }
+    if (fp != stdin) {
+        fclose(fp);
+    }
+
+    if (samples == 0) {
+        printf("no samples\n");
+        return 1;
+    }
+
+    int64_t total = now - start;
+    printf("\n%d samples, %lld ms, %d transitions\n", samples,
+        (long long)(total / 1000000LL), governor.getTransitions());
+    for (int i = 0; i < QCAMERA_PERF_LEVEL_MAX; i++) {
+        int64_t t = governor.getTimeInLevel(i, now);
+        printf("  %-16s %8lld ms  %5.1f%%\n", QCameraPerfGovernor::getLevelName(i),
+            (long long)(t / 1000000LL),
+            total > 0 ? (double)t * 100.0 / (double)total : 0.0);
+    }
+    return 0;
+}
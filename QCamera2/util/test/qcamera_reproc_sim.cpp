@@ -0,0 +1,331 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Simulated reprocess backend for measuring how many reprocess requests
+ * should be kept in flight. Worker threads stand in for the offline
+ * reprocess engines and complete requests after a jittered latency, so
+ * results come back out of order. The dispatch side follows the data proc
+ * thread of QCameraPostProcessor: requests are sent while fewer than the
+ * in-flight limit are ongoing, and results are matched back to their
+ * source through the ongoing queue by frame idx. */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "QCameraQueue.h"
+
+using namespace qcamera;
+
+typedef struct {
+    uint32_t frame_idx;
+} sim_pp_job_t;
+
+typedef struct {
+    uint32_t frame_idx;
+    uint32_t skipped;
+} sim_pp_match_t;
+
+typedef struct {
+    int engines;           // parallel reprocess engines
+    int latencyUs;         // mean reprocess latency
+    int jitterPct;         // +/- latency jitter
+    unsigned int seed;
+} sim_backend_cfg_t;
+
+class SimBackend {
+public:
+    SimBackend(const sim_backend_cfg_t &cfg);
+    ~SimBackend();
+    void submit(uint32_t frame_idx);
+    bool waitResult(uint32_t &frame_idx);
+
+private:
+    static void *workerRoutine(void *data);
+
+    sim_backend_cfg_t m_cfg;
+    QCameraQueue m_reqQ;
+    QCameraQueue m_resultQ;
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_reqCond;
+    pthread_cond_t m_resultCond;
+    pthread_t m_workers[16];
+    int m_nWorkers;
+    bool m_bExit;
+    unsigned int m_seed;
+};
+
+SimBackend::SimBackend(const sim_backend_cfg_t &cfg)
+    : m_cfg(cfg), m_nWorkers(0), m_bExit(false), m_seed(cfg.seed)
+{
+    pthread_mutex_init(&m_lock, NULL);
+    pthread_cond_init(&m_reqCond, NULL);
+    pthread_cond_init(&m_resultCond, NULL);
+    for (int i = 0; i < cfg.engines && i < 16; i++) {
+        if (pthread_create(&m_workers[i], NULL, workerRoutine, this) == 0) {
+            m_nWorkers++;
+        }
+    }
+}
+
+SimBackend::~SimBackend()
+{
+    pthread_mutex_lock(&m_lock);
+    m_bExit = true;
+    pthread_cond_broadcast(&m_reqCond);
+    pthread_mutex_unlock(&m_lock);
+    for (int i = 0; i < m_nWorkers; i++) {
+        pthread_join(m_workers[i], NULL);
+    }
+    pthread_cond_destroy(&m_resultCond);
+    pthread_cond_destroy(&m_reqCond);
+    pthread_mutex_destroy(&m_lock);
+}
+
+void SimBackend::submit(uint32_t frame_idx)
+{
+    uint32_t *req = (uint32_t *)malloc(sizeof(uint32_t));
+    if (req == NULL) {
+        return;
+    }
+    *req = frame_idx;
+    pthread_mutex_lock(&m_lock);
+    m_reqQ.enqueue(req);
+    pthread_cond_signal(&m_reqCond);
+    pthread_mutex_unlock(&m_lock);
+}
+
+bool SimBackend::waitResult(uint32_t &frame_idx)
+{
+    uint32_t *res = NULL;
+    pthread_mutex_lock(&m_lock);
+    while ((res = (uint32_t *)m_resultQ.dequeue()) == NULL) {
+        pthread_cond_wait(&m_resultCond, &m_lock);
+    }
+    pthread_mutex_unlock(&m_lock);
+    frame_idx = *res;
+    free(res);
+    return true;
+}
+
+void *SimBackend::workerRoutine(void *data)
+{
+    SimBackend *pme = (SimBackend *)data;
+    while (true) {
+        uint32_t *req = NULL;
+        int latency;
+        pthread_mutex_lock(&pme->m_lock);
+        while (!pme->m_bExit &&
+                (req = (uint32_t *)pme->m_reqQ.dequeue()) == NULL) {
+            pthread_cond_wait(&pme->m_reqCond, &pme->m_lock);
+        }
+        int span = pme->m_cfg.latencyUs * pme->m_cfg.jitterPct / 100;
+        latency = pme->m_cfg.latencyUs;
+        if (span > 0) {
+            latency += (int)(rand_r(&pme->m_seed) % (2 * span + 1)) - span;
+        }
+        pthread_mutex_unlock(&pme->m_lock);
+        if (req == NULL) {
+            break;
+        }
+
+        usleep(latency);
+
+        pthread_mutex_lock(&pme->m_lock);
+        pme->m_resultQ.enqueue(req);
+        pthread_cond_signal(&pme->m_resultCond);
+        pthread_mutex_unlock(&pme->m_lock);
+    }
+    return NULL;
+}
+
+static bool matchPPFrame(void *data, void *, void *match_data)
+{
+    sim_pp_job_t *job = (sim_pp_job_t *)data;
+    sim_pp_match_t *match = (sim_pp_match_t *)match_data;
+    if (job->frame_idx == match->frame_idx) {
+        return true;
+    }
+    match->skipped++;
+    return false;
+}
+
+static int64_t nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+typedef struct {
+    int64_t totalUs;       // first request to last result
+    int64_t firstShotUs;   // first request to first complete shot
+    uint32_t outOfOrder;   // results passing an older request
+    uint32_t unmatched;    // results without a job, must stay 0
+} sim_result_t;
+
+/* Reprocess `frames` frames, `group` consecutive frames form one shot
+ * (1 for burst, bracket size for HDR). */
+static sim_result_t runCapture(const sim_backend_cfg_t &cfg, uint32_t frames,
+                               uint32_t group, uint32_t inFlightMax)
+{
+    sim_result_t result;
+    memset(&result, 0, sizeof(result));
+
+    SimBackend backend(cfg);
+    QCameraQueue ongoingQ;
+    uint32_t next = 0;
+    uint32_t done = 0;
+    uint32_t *shotDone = (uint32_t *)calloc(frames / group + 1, sizeof(uint32_t));
+    int64_t start = nowUs();
+
+    while (done < frames) {
+        while ((next < frames) && ((0 == inFlightMax) ||
+                ((uint32_t)ongoingQ.getCurrentSize() < inFlightMax))) {
+            sim_pp_job_t *job = (sim_pp_job_t *)malloc(sizeof(sim_pp_job_t));
+            if (job == NULL) {
+                break;
+            }
+            job->frame_idx = next++;
+            ongoingQ.enqueue(job);
+            backend.submit(job->frame_idx);
+        }
+
+        uint32_t frame_idx = 0;
+        backend.waitResult(frame_idx);
+        sim_pp_match_t match;
+        match.frame_idx = frame_idx;
+        match.skipped = 0;
+        sim_pp_job_t *job = (sim_pp_job_t *)ongoingQ.dequeue(matchPPFrame, &match);
+        if (job == NULL) {
+            result.unmatched++;
+            continue;
+        }
+        if (match.skipped > 0) {
+            result.outOfOrder++;
+        }
+        uint32_t shot = job->frame_idx / group;
+        free(job);
+        done++;
+        if ((++shotDone[shot] == group) && (result.firstShotUs == 0)) {
+            result.firstShotUs = nowUs() - start;
+        }
+    }
+    result.totalUs = nowUs() - start;
+    free(shotDone);
+    return result;
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [options]\n", name);
+    printf("  -e <n>   reprocess engines (default 2)\n");
+    printf("  -l <ms>  mean reprocess latency (default 40)\n");
+    printf("  -j <pct> latency jitter (default 30)\n");
+    printf("  -n <n>   burst length (default 10)\n");
+    printf("  -b <n>   hdr bracket size (default 3)\n");
+    printf("  -s <n>   hdr shots (default 3)\n");
+    printf("  -i <n>   reprocess requests in flight (default 4)\n");
+}
+
+static void report(const char *name, uint32_t inFlight, const sim_result_t &serial,
+                   const sim_result_t &parallel)
+{
+    printf("%-10s serial %6lld ms (first %5lld ms)  in flight %d: %6lld ms "
+           "(first %5lld ms)  speedup %.2fx  out of order %d  unmatched %d\n",
+        name, (long long)(serial.totalUs / 1000),
+        (long long)(serial.firstShotUs / 1000), inFlight,
+        (long long)(parallel.totalUs / 1000),
+        (long long)(parallel.firstShotUs / 1000),
+        parallel.totalUs > 0 ? (double)serial.totalUs / (double)parallel.totalUs : 0.0,
+        parallel.outOfOrder, serial.unmatched + parallel.unmatched);
+}
+
+int main(int argc, char *argv[])
+{
+    sim_backend_cfg_t cfg;
+    cfg.engines = 2;
+    cfg.latencyUs = 40000;
+    cfg.jitterPct = 30;
+    cfg.seed = 1;
+    uint32_t burst = 10;
+    uint32_t bracket = 3;
+    uint32_t hdrShots = 3;
+    uint32_t inFlight = 4;
+    int c;
+
+    while ((c = getopt(argc, argv, "e:l:j:n:b:s:i:h")) != -1) {
+        switch (c) {
+        case 'e':
+            cfg.engines = atoi(optarg);
+            break;
+        case 'l':
+            cfg.latencyUs = atoi(optarg) * 1000;
+            break;
+        case 'j':
+            cfg.jitterPct = atoi(optarg);
+            break;
+        case 'n':
+            burst = atoi(optarg);
+            break;
+        case 'b':
+            bracket = atoi(optarg);
+            break;
+        case 's':
+            hdrShots = atoi(optarg);
+            break;
+        case 'i':
+            inFlight = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if ((cfg.engines <= 0) || (burst == 0) || (bracket == 0) || (hdrShots == 0)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%d engines, %d ms +/- %d%% per reprocess\n", cfg.engines,
+        cfg.latencyUs / 1000, cfg.jitterPct);
+
+    sim_result_t serial = runCapture(cfg, burst, 1, 1);
+    sim_result_t parallel = runCapture(cfg, burst, 1, inFlight);
+    report("burst", inFlight, serial, parallel);
+
+    serial = runCapture(cfg, bracket * hdrShots, bracket, 1);
+    parallel = runCapture(cfg, bracket * hdrShots, bracket, inFlight);
+    report("hdr", inFlight, serial, parallel);
+
+    return (serial.unmatched + parallel.unmatched) ? 1 : 0;
+}
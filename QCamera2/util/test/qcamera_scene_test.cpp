@@ -0,0 +1,501 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Checks QCameraSceneDetector on sample YUV frames: the SIMD grid against a
+ * plain per pixel box filter, the scene picked for synthetic night,
+ * backlight, portrait, snow and landscape frames, with and without an ISP
+ * histogram, scene hysteresis and the pixel budget. A captured NV21/NV12
+ * frame can be classified with -f. Exits with 1 on the first failure. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "QCameraSceneDetector.h"
+
+using namespace qcamera;
+
+typedef enum {
+    SAMPLE_FLAT,
+    SAMPLE_NIGHT,
+    SAMPLE_BACKLIGHT,
+    SAMPLE_SNOW,
+    SAMPLE_LANDSCAPE,
+} sample_t;
+
+static int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static uint8_t clampLuma(int32_t v)
+{
+    return (uint8_t)((v < 0) ? 0 : ((v > 255) ? 255 : v));
+}
+
+/* synthetic luma plane of a sample scene, with sensor like noise */
+static void makeSample(sample_t sample, uint8_t *luma, int32_t width,
+                       int32_t height, int32_t stride, unsigned int *seed)
+{
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            int32_t noise = (int32_t)(rand_r(seed) % 9) - 4;
+            int32_t v = 128;
+            switch (sample) {
+            case SAMPLE_FLAT:
+                v = 110 + x * 40 / width;
+                break;
+            case SAMPLE_NIGHT:
+                // dark street with a few lamps
+                v = 14 + y * 16 / height;
+                if (((x / 37) % 11 == 3) && ((y / 29) % 7 == 2)) {
+                    v = 250;
+                }
+                break;
+            case SAMPLE_BACKLIGHT:
+                {
+                    // dark subject in front of a bright window
+                    int32_t dx = (x - width / 2) * 100 / width;
+                    int32_t dy = (y - height / 2) * 100 / height;
+                    v = (dx * dx + dy * dy < 28 * 28) ? 55 : 235;
+                }
+                break;
+            case SAMPLE_SNOW:
+                v = 222 + y * 12 / height;
+                break;
+            case SAMPLE_LANDSCAPE:
+                if (y < height * 2 / 5) {
+                    v = 215 - y * 20 / height;
+                } else {
+                    // fields and trees, structure well above cell size
+                    int32_t bx = x / (width / 13 + 1);
+                    int32_t by = y / (height / 9 + 1);
+                    v = 50 + ((bx * 7 + by * 13) % 9) * 14;
+                }
+                break;
+            }
+            luma[(size_t)y * stride + x] = clampLuma(v + noise);
+        }
+        memset(luma + (size_t)y * stride + width, 0x5A, stride - width);
+    }
+}
+
+static void makeHist(const uint8_t *luma, int32_t width, int32_t height,
+                     int32_t stride, uint32_t *hist)
+{
+    memset(hist, 0, QCAMERA_SCENE_HIST_BINS * sizeof(uint32_t));
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            hist[luma[(size_t)y * stride + x]]++;
+        }
+    }
+}
+
+/* plain per pixel box filter over the same rows downscale picks */
+static void referenceDownscale(const uint8_t *luma, int32_t width,
+                               int32_t height, int32_t stride,
+                               uint32_t maxPixels, uint8_t *grid)
+{
+    int32_t cellW = width / QCAMERA_SCENE_GRID_W;
+    int32_t cellH = height / QCAMERA_SCENE_GRID_H;
+    int32_t x0 = (width - cellW * QCAMERA_SCENE_GRID_W) / 2;
+    int32_t y0 = (height - cellH * QCAMERA_SCENE_GRID_H) / 2;
+    int32_t rows = maxPixels / (cellW * QCAMERA_SCENE_GRID_W * QCAMERA_SCENE_GRID_H);
+    rows = (rows < 1) ? 1 : ((rows > cellH) ? cellH : rows);
+
+    for (int32_t gy = 0; gy < QCAMERA_SCENE_GRID_H; gy++) {
+        for (int32_t gx = 0; gx < QCAMERA_SCENE_GRID_W; gx++) {
+            uint32_t sum = 0;
+            for (int32_t k = 0; k < rows; k++) {
+                int32_t y = y0 + gy * cellH + (2 * k + 1) * cellH / (2 * rows);
+                for (int32_t x = 0; x < cellW; x++) {
+                    sum += luma[(size_t)y * stride + x0 + gx * cellW + x];
+                }
+            }
+            uint32_t div = cellW * rows;
+            grid[gy * QCAMERA_SCENE_GRID_W + gx] = (uint8_t)((sum + div / 2) / div);
+        }
+    }
+}
+
+static bool checkDownscale(unsigned int *seed)
+{
+    static const int32_t sizes[][3] = {
+        {32, 24, 32}, {33, 25, 48}, {100, 75, 128}, {320, 240, 320},
+        {641, 481, 704}, {1280, 720, 1280}, {1440, 1080, 1472},
+        {1920, 1080, 1920}, {4000, 3000, 4032},
+    };
+    static const uint32_t budgets[] = {
+        0, QCAMERA_SCENE_MIN_BUDGET, 64 * 1024, 300 * 1000, 0xFFFFFFFF,
+    };
+    int checks = 0;
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int32_t width = sizes[s][0], height = sizes[s][1], stride = sizes[s][2];
+        uint8_t *luma = (uint8_t *)malloc((size_t)stride * height);
+        if (NULL == luma) {
+            printf("no mem for %dx%d\n", width, height);
+            return false;
+        }
+        for (size_t i = 0; i < (size_t)stride * height; i++) {
+            luma[i] = (uint8_t)rand_r(seed);
+        }
+        for (size_t b = 0; b < sizeof(budgets) / sizeof(budgets[0]); b++) {
+            uint8_t grid[QCAMERA_SCENE_GRID_W * QCAMERA_SCENE_GRID_H];
+            uint8_t ref[QCAMERA_SCENE_GRID_W * QCAMERA_SCENE_GRID_H];
+            uint32_t samples = 0;
+            if (!QCameraSceneDetector::downscale(luma, width, height, stride,
+                    budgets[b], grid, samples)) {
+                printf("downscale %dx%d failed\n", width, height);
+                free(luma);
+                return false;
+            }
+            referenceDownscale(luma, width, height, stride, budgets[b], ref);
+            if (memcmp(grid, ref, sizeof(grid)) != 0) {
+                printf("downscale %dx%d stride %d budget %u mismatch\n",
+                    width, height, stride, budgets[b]);
+                free(luma);
+                return false;
+            }
+            // one row per grid row is the floor, beyond that the budget holds
+            uint32_t floor = (width / QCAMERA_SCENE_GRID_W) *
+                QCAMERA_SCENE_GRID_W * QCAMERA_SCENE_GRID_H;
+            if ((samples > budgets[b]) && (samples > floor)) {
+                printf("downscale %dx%d read %u pixels, budget %u\n",
+                    width, height, samples, budgets[b]);
+                free(luma);
+                return false;
+            }
+            checks++;
+        }
+        free(luma);
+    }
+
+    uint8_t grid[QCAMERA_SCENE_GRID_W * QCAMERA_SCENE_GRID_H];
+    uint8_t luma[64 * 48];
+    uint32_t samples = 0;
+    if (QCameraSceneDetector::downscale(NULL, 64, 48, 64, 0, grid, samples) ||
+            QCameraSceneDetector::downscale(luma, 31, 48, 64, 0, grid, samples) ||
+            QCameraSceneDetector::downscale(luma, 64, 23, 64, 0, grid, samples) ||
+            QCameraSceneDetector::downscale(luma, 64, 48, 63, 0, grid, samples)) {
+        printf("invalid frame accepted\n");
+        return false;
+    }
+
+    printf("%d grids match the reference\n", checks);
+    return true;
+}
+
+/* feed a sample until the reported scene settles */
+static bool checkSample(const char *name, sample_t sample, int32_t numFaces,
+                        qcamera_scene_t expected, unsigned int *seed)
+{
+    const int32_t width = 1280, height = 720, stride = 1280;
+    uint8_t *luma = (uint8_t *)malloc((size_t)stride * height);
+    uint32_t hist[QCAMERA_SCENE_HIST_BINS];
+    if (NULL == luma) {
+        printf("no mem for sample\n");
+        return false;
+    }
+    makeSample(sample, luma, width, height, stride, seed);
+    makeHist(luma, width, height, stride, hist);
+
+    bool ok = true;
+    for (int h = 0; h < 2 && ok; h++) {
+        QCameraSceneDetector detector;
+        qcamera_scene_frame_t frame;
+        frame.luma = luma;
+        frame.width = width;
+        frame.height = height;
+        frame.stride = stride;
+        frame.hist = h ? hist : NULL;
+        frame.num_faces = numFaces;
+        qcamera_scene_t scene = QCAMERA_SCENE_MAX;
+        for (int i = 0; i < QCAMERA_SCENE_STABLE_FRAMES; i++) {
+            scene = detector.process(frame);
+        }
+        const qcamera_scene_stats_t &stats = detector.getStats();
+        printf("%-16s %-9s mean %3d contrast %3d dark %3d%% bright %3d%% "
+            "center %4d top %4d detail %3d -> %s\n", name,
+            h ? "isp hist" : "grid", stats.mean, stats.contrast,
+            stats.darkPct, stats.brightPct, stats.centerDelta,
+            stats.topDelta, stats.detail,
+            QCameraSceneDetector::getSceneName(scene));
+        if (scene != expected) {
+            printf("expected %s\n", QCameraSceneDetector::getSceneName(expected));
+            ok = false;
+        }
+    }
+
+    free(luma);
+    return ok;
+}
+
+/* a new scene is only reported after it held for the stable frame count */
+static bool checkHysteresis(unsigned int *seed)
+{
+    const int32_t width = 640, height = 480;
+    uint8_t *flat = (uint8_t *)malloc(width * height);
+    uint8_t *snow = (uint8_t *)malloc(width * height);
+    bool ok = true;
+    if ((NULL == flat) || (NULL == snow)) {
+        printf("no mem for hysteresis\n");
+        free(flat);
+        free(snow);
+        return false;
+    }
+    makeSample(SAMPLE_FLAT, flat, width, height, width, seed);
+    makeSample(SAMPLE_SNOW, snow, width, height, width, seed);
+
+    // flat, snow, flat, then snow for good
+    static const int pattern[] = {0, 0, 0, 1, 0, 1, 1, 1, 1};
+    static const qcamera_scene_t expected[] = {
+        QCAMERA_SCENE_AUTO, QCAMERA_SCENE_AUTO, QCAMERA_SCENE_AUTO,
+        QCAMERA_SCENE_AUTO, QCAMERA_SCENE_AUTO, QCAMERA_SCENE_AUTO,
+        QCAMERA_SCENE_AUTO, QCAMERA_SCENE_SNOW, QCAMERA_SCENE_SNOW,
+    };
+    QCameraSceneDetector detector;
+    for (size_t i = 0; i < sizeof(pattern) / sizeof(pattern[0]); i++) {
+        qcamera_scene_frame_t frame;
+        frame.luma = pattern[i] ? snow : flat;
+        frame.width = width;
+        frame.height = height;
+        frame.stride = width;
+        frame.hist = NULL;
+        frame.num_faces = 0;
+        qcamera_scene_t scene = detector.process(frame);
+        if (scene != expected[i]) {
+            printf("hysteresis frame %zu: %s, expected %s\n", i,
+                QCameraSceneDetector::getSceneName(scene),
+                QCameraSceneDetector::getSceneName(expected[i]));
+            ok = false;
+            break;
+        }
+    }
+    if (ok && (detector.getFrameCount() != sizeof(pattern) / sizeof(pattern[0]))) {
+        printf("hysteresis frame count %u\n", detector.getFrameCount());
+        ok = false;
+    }
+
+    free(flat);
+    free(snow);
+    return ok;
+}
+
+static bool checkBudget()
+{
+    QCameraSceneDetector detector;
+    detector.setBudget(100);
+    if (detector.getBudget() != QCAMERA_SCENE_MIN_BUDGET) {
+        printf("budget below the minimum accepted\n");
+        return false;
+    }
+    detector.setBudget(128 * 1024);
+    // slow frames halve the budget down to the minimum
+    if (!detector.updateBudget(3000, 2000) ||
+            (detector.getBudget() != 64 * 1024)) {
+        printf("budget not cut on a slow frame\n");
+        return false;
+    }
+    detector.updateBudget(3000, 2000);
+    detector.updateBudget(3000, 2000);
+    if (detector.updateBudget(3000, 2000) ||
+            (detector.getBudget() != QCAMERA_SCENE_MIN_BUDGET)) {
+        printf("budget cut below the minimum\n");
+        return false;
+    }
+    // in between keeps it, fast frames give it back up to the user budget
+    if (detector.updateBudget(1000, 2000) || detector.updateBudget(0, 0)) {
+        printf("budget changed without reason\n");
+        return false;
+    }
+    for (int i = 0; i < 8; i++) {
+        detector.updateBudget(100, 2000);
+    }
+    if (detector.getBudget() != 128 * 1024) {
+        printf("budget not restored, %u\n", detector.getBudget());
+        return false;
+    }
+    detector.updateBudget(3000, 2000);
+    detector.reset();
+    if (detector.getBudget() != 128 * 1024) {
+        printf("budget not restored on reset\n");
+        return false;
+    }
+    printf("budget ok\n");
+    return true;
+}
+
+static void timeDetection(int32_t width, int32_t height, uint32_t budget,
+                          int frames, unsigned int *seed)
+{
+    int32_t stride = (width + 63) & ~63;
+    uint8_t *luma = (uint8_t *)malloc((size_t)stride * height);
+    if (NULL == luma) {
+        printf("no mem for timing\n");
+        return;
+    }
+    makeSample(SAMPLE_LANDSCAPE, luma, width, height, stride, seed);
+
+    QCameraSceneDetector detector;
+    detector.setBudget(budget);
+    qcamera_scene_frame_t frame;
+    frame.luma = luma;
+    frame.width = width;
+    frame.height = height;
+    frame.stride = stride;
+    frame.hist = NULL;
+    frame.num_faces = 0;
+    int64_t best = -1, total = 0;
+    for (int i = 0; i < frames; i++) {
+        int64_t start = nowNs();
+        detector.process(frame);
+        int64_t elapsed = nowNs() - start;
+        total += elapsed;
+        if ((best < 0) || (elapsed < best)) {
+            best = elapsed;
+        }
+    }
+    printf("budget %7u: %7u pixels read, best %5lld us, avg %5lld us\n",
+        budget, detector.getStats().samples, (long long)(best / 1000),
+        (long long)(total / frames / 1000));
+    free(luma);
+}
+
+/* classify a captured frame, NV21 or NV12 with the luma plane first */
+static int classifyFile(const char *path, int32_t width, int32_t height,
+                        int32_t stride, int32_t numFaces, int frames)
+{
+    FILE *fp = fopen(path, "rb");
+    if (NULL == fp) {
+        printf("cannot open %s\n", path);
+        return 1;
+    }
+    size_t len = (size_t)stride * height;
+    uint8_t *luma = (uint8_t *)malloc(len);
+    if ((NULL == luma) || (fread(luma, 1, len, fp) != len)) {
+        printf("cannot read %zu bytes of luma from %s\n", len, path);
+        fclose(fp);
+        free(luma);
+        return 1;
+    }
+    fclose(fp);
+
+    QCameraSceneDetector detector;
+    qcamera_scene_frame_t frame;
+    frame.luma = luma;
+    frame.width = width;
+    frame.height = height;
+    frame.stride = stride;
+    frame.hist = NULL;
+    frame.num_faces = numFaces;
+    qcamera_scene_t scene = QCAMERA_SCENE_AUTO;
+    for (int i = 0; i < frames || i < QCAMERA_SCENE_STABLE_FRAMES; i++) {
+        scene = detector.process(frame);
+    }
+    const qcamera_scene_stats_t &stats = detector.getStats();
+    printf("%s: mean %d contrast %d dark %d%% bright %d%% center %d top %d "
+        "detail %d -> %s\n", path, stats.mean, stats.contrast, stats.darkPct,
+        stats.brightPct, stats.centerDelta, stats.topDelta, stats.detail,
+        QCameraSceneDetector::getSceneName(scene));
+    free(luma);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = NULL;
+    int32_t width = 1920;
+    int32_t height = 1080;
+    int32_t stride = 0;
+    int32_t numFaces = 0;
+    int frames = 100;
+    unsigned int seed = 1;
+    int c;
+
+    while ((c = getopt(argc, argv, "f:w:h:s:F:n:")) != -1) {
+        switch (c) {
+        case 'f':
+            path = optarg;
+            break;
+        case 'w':
+            width = atoi(optarg);
+            break;
+        case 'h':
+            height = atoi(optarg);
+            break;
+        case 's':
+            stride = atoi(optarg);
+            break;
+        case 'F':
+            numFaces = atoi(optarg);
+            break;
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        default:
+            printf("usage: %s [-f frame.yuv [-s stride] [-F faces]] "
+                "[-w width] [-h height] [-n frames]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (NULL != path) {
+        return classifyFile(path, width, height,
+            (stride > 0) ? stride : width, numFaces, frames);
+    }
+
+    if (!checkDownscale(&seed) ||
+            !checkSample("flat", SAMPLE_FLAT, 0, QCAMERA_SCENE_AUTO, &seed) ||
+            !checkSample("night", SAMPLE_NIGHT, 0, QCAMERA_SCENE_NIGHT, &seed) ||
+            !checkSample("night portrait", SAMPLE_NIGHT, 1,
+                QCAMERA_SCENE_NIGHT_PORTRAIT, &seed) ||
+            !checkSample("backlight", SAMPLE_BACKLIGHT, 0,
+                QCAMERA_SCENE_BACKLIGHT, &seed) ||
+            !checkSample("backlit face", SAMPLE_BACKLIGHT, 1,
+                QCAMERA_SCENE_BACKLIGHT, &seed) ||
+            !checkSample("portrait", SAMPLE_FLAT, 2, QCAMERA_SCENE_PORTRAIT, &seed) ||
+            !checkSample("snow", SAMPLE_SNOW, 0, QCAMERA_SCENE_SNOW, &seed) ||
+            !checkSample("landscape", SAMPLE_LANDSCAPE, 0,
+                QCAMERA_SCENE_LANDSCAPE, &seed) ||
+            !checkHysteresis(&seed) ||
+            !checkBudget()) {
+        return 1;
+    }
+
+    printf("%dx%d, %d frames\n", width, height, frames);
+    timeDetection(width, height, QCAMERA_SCENE_MIN_BUDGET, frames, &seed);
+    timeDetection(width, height, 64 * 1024, frames, &seed);
+    timeDetection(width, height, (uint32_t)width * height, frames, &seed);
+
+    return 0;
+}
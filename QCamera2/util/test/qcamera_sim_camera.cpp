@@ -0,0 +1,906 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include "qcamera_sim_camera.h"
+
+#define SIM_MAX_CAMERAS       2
+#define SIM_MAX_STREAMS       MAX_STREAM_NUM_IN_BUNDLE
+#define SIM_MAX_FRAME_BUFS    (SIM_MAX_CHANNELS * SIM_MAX_STREAMS)
+
+struct sim_camera;
+
+typedef struct {
+    uint32_t id;                  // stream handle, 0 if the slot is free
+    uint32_t ch_idx;
+    struct sim_camera *cam;
+    uint8_t configured;
+    mm_camera_stream_config_t config;
+    mm_camera_buf_def_t *bufs;    // from the client's get_bufs
+    uint8_t *reg_flags;
+    uint8_t num_bufs;
+    uint8_t free_q[MM_CAMERA_MAX_NUM_FRAMES];   // queued by the client
+    uint32_t free_head;
+    uint32_t free_cnt;
+    uint8_t ready_q[MM_CAMERA_MAX_NUM_FRAMES];  // waiting for stream_cb
+    uint32_t ready_head;
+    uint32_t ready_cnt;
+    uint8_t active;
+    pthread_t dispatch_tid;
+    pthread_cond_t ready_cond;
+} sim_stream_t;
+
+typedef struct {
+    uint32_t id;                  // channel handle, 0 if the slot is free
+    uint8_t active;
+    mm_camera_buf_notify_t channel_cb;
+    void *userdata;
+    sim_stream_t streams[SIM_MAX_STREAMS];
+} sim_channel_t;
+
+typedef struct {
+    uint8_t valid;
+    int64_t ts;
+    uint32_t num_bufs;
+    struct {
+        uint8_t ch_idx;
+        uint8_t s_idx;
+        uint8_t buf_idx;
+    } bufs[SIM_MAX_FRAME_BUFS];
+} sim_frame_t;
+
+typedef struct sim_camera {
+    mm_camera_vtbl_t vtbl;
+    uint8_t in_use;
+    sim_camera_cfg_t cfg;
+    sim_camera_stats_t stats;
+    pthread_mutex_t lock;
+    mm_camera_event_notify_t evt_cb;
+    void *evt_userdata;
+    sim_channel_t channels[SIM_MAX_CHANNELS];
+    uint32_t parms[SIM_MAX_PARMS];   // frame numbers from set_parms
+    uint32_t parm_head;
+    uint32_t parm_cnt;
+    sim_frame_t pipeline[SIM_MAX_DEPTH + 1];
+    uint32_t frame_idx;
+    uint8_t sensor_on;
+    pthread_cond_t sensor_cond;      // wakes the sensor thread on stop
+    pthread_t sensor_tid;
+    unsigned int seed;
+} sim_camera_t;
+
+static sim_camera_t g_sim_cameras[SIM_MAX_CAMERAS];
+static pthread_mutex_t g_sim_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int64_t sim_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sim_sleep_until(int64_t when)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(when / 1000000000LL);
+    ts.tv_nsec = (long)(when % 1000000000LL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+    }
+}
+
+/* sleeps with cam->lock held until when or until the sensor is stopped */
+static void sim_sensor_wait(sim_camera_t *cam, int64_t when)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(when / 1000000000LL);
+    ts.tv_nsec = (long)(when % 1000000000LL);
+    while (cam->sensor_on &&
+            (pthread_cond_timedwait(&cam->sensor_cond, &cam->lock, &ts) == 0)) {
+    }
+}
+
+static sim_camera_t *sim_get_camera(uint32_t camera_handle)
+{
+    if ((camera_handle == 0) || (camera_handle > SIM_MAX_CAMERAS)) {
+        return NULL;
+    }
+    sim_camera_t *cam = &g_sim_cameras[camera_handle - 1];
+    return cam->in_use ? cam : NULL;
+}
+
+static sim_channel_t *sim_get_channel(sim_camera_t *cam, uint32_t ch_id)
+{
+    if ((ch_id == 0) || (ch_id > SIM_MAX_CHANNELS)) {
+        return NULL;
+    }
+    sim_channel_t *ch = &cam->channels[ch_id - 1];
+    return (ch->id == ch_id) ? ch : NULL;
+}
+
+static sim_stream_t *sim_get_stream(sim_channel_t *ch, uint32_t stream_id)
+{
+    for (int i = 0; i < SIM_MAX_STREAMS; i++) {
+        if ((ch->streams[i].id != 0) && (ch->streams[i].id == stream_id)) {
+            return &ch->streams[i];
+        }
+    }
+    return NULL;
+}
+
+/* the real metadata stream carries one metadata_buffer_t per sensor frame */
+static void sim_fill_metadata(sim_camera_t *cam, mm_camera_buf_def_t *buf,
+                              int32_t frame_valid, uint32_t frame_number)
+{
+    if ((NULL == buf->buffer) || (buf->frame_len < sizeof(metadata_buffer_t))) {
+        return;
+    }
+    metadata_buffer_t *meta = (metadata_buffer_t *)buf->buffer;
+    int64_t ts = (int64_t)buf->ts.tv_sec * 1000000000LL + buf->ts.tv_nsec;
+    int64_t duration = 1000000000LL / cam->cfg.fps;
+    int32_t urgent_valid = 0;
+    cam_frame_dropped_t dropped;
+    memset(&dropped, 0, sizeof(dropped));
+
+    memset(meta->is_valid, 0, sizeof(meta->is_valid));
+    meta->is_tuning_params_valid = 0;
+#define SIM_SET_META(ID, VALUE) do { \
+        memcpy(POINTER_OF_META(ID, meta), &(VALUE), SIZE_OF_PARAM(ID, meta)); \
+        meta->is_valid[ID] = 1; \
+    } while (0)
+    SIM_SET_META(CAM_INTF_META_FRAME_NUMBER_VALID, frame_valid);
+    SIM_SET_META(CAM_INTF_META_FRAME_NUMBER, frame_number);
+    SIM_SET_META(CAM_INTF_META_URGENT_FRAME_NUMBER_VALID, urgent_valid);
+    SIM_SET_META(CAM_INTF_META_SENSOR_TIMESTAMP, ts);
+    SIM_SET_META(CAM_INTF_META_SENSOR_FRAME_DURATION, duration);
+    SIM_SET_META(CAM_INTF_META_PENDING_REQUESTS, cam->parm_cnt);
+    SIM_SET_META(CAM_INTF_META_FRAME_DROPPED, dropped);
+#undef SIM_SET_META
+}
+
+/* start of frame: every active stream with a queued buffer gets one */
+static void sim_capture_frame(sim_camera_t *cam, sim_frame_t *frame, int64_t ts)
+{
+    int32_t frame_valid = 0;
+    uint32_t frame_number = 0;
+
+    cam->frame_idx++;
+    cam->stats.frames++;
+    if (cam->parm_cnt > 0) {
+        frame_valid = 1;
+        frame_number = cam->parms[cam->parm_head];
+        cam->parm_head = (cam->parm_head + 1) % SIM_MAX_PARMS;
+        cam->parm_cnt--;
+        cam->stats.requests++;
+    }
+
+    frame->valid = 1;
+    frame->ts = ts;
+    frame->num_bufs = 0;
+    for (uint32_t c = 0; c < SIM_MAX_CHANNELS; c++) {
+        sim_channel_t *ch = &cam->channels[c];
+        if ((0 == ch->id) || !ch->active) {
+            continue;
+        }
+        for (uint32_t s = 0; s < SIM_MAX_STREAMS; s++) {
+            sim_stream_t *stream = &ch->streams[s];
+            if ((0 == stream->id) || !stream->active) {
+                continue;
+            }
+            if (0 == stream->free_cnt) {
+                cam->stats.starved++;
+                continue;
+            }
+            uint8_t idx = stream->free_q[stream->free_head];
+            stream->free_head = (stream->free_head + 1) % MM_CAMERA_MAX_NUM_FRAMES;
+            stream->free_cnt--;
+
+            mm_camera_buf_def_t *buf = &stream->bufs[idx];
+            buf->stream_id = stream->id;
+            buf->stream_type = stream->config.stream_info->stream_type;
+            buf->frame_idx = cam->frame_idx;
+            buf->ts.tv_sec = (time_t)(ts / 1000000000LL);
+            buf->ts.tv_nsec = (long)(ts % 1000000000LL);
+            if (CAM_STREAM_TYPE_METADATA == buf->stream_type) {
+                sim_fill_metadata(cam, buf, frame_valid, frame_number);
+            }
+            frame->bufs[frame->num_bufs].ch_idx = (uint8_t)c;
+            frame->bufs[frame->num_bufs].s_idx = (uint8_t)s;
+            frame->bufs[frame->num_bufs].buf_idx = idx;
+            frame->num_bufs++;
+        }
+    }
+}
+
+/* end of the ISP pipeline: captured buffers go to their dispatch threads */
+static void sim_deliver_frame(sim_camera_t *cam, sim_frame_t *frame)
+{
+    if (!frame->valid) {
+        return;
+    }
+    for (uint32_t i = 0; i < frame->num_bufs; i++) {
+        sim_channel_t *ch = &cam->channels[frame->bufs[i].ch_idx];
+        sim_stream_t *stream = &ch->streams[frame->bufs[i].s_idx];
+        if (!ch->active || !stream->active) {
+            cam->stats.flushed++;
+            continue;
+        }
+        uint32_t tail = (stream->ready_head + stream->ready_cnt) %
+            MM_CAMERA_MAX_NUM_FRAMES;
+        stream->ready_q[tail] = frame->bufs[i].buf_idx;
+        stream->ready_cnt++;
+        pthread_cond_signal(&stream->ready_cond);
+    }
+    frame->valid = 0;
+}
+
+static void *sim_sensor_routine(void *data)
+{
+    sim_camera_t *cam = (sim_camera_t *)data;
+    int64_t interval = 1000000000LL / cam->cfg.fps;
+    uint32_t depth = cam->cfg.pipelineDepth;
+    int64_t next = sim_now();
+    uint32_t tick = 0;
+
+    if (depth > SIM_MAX_DEPTH) {
+        depth = SIM_MAX_DEPTH;
+    }
+
+    pthread_mutex_lock(&cam->lock);
+    while (cam->sensor_on) {
+        sim_sensor_wait(cam, next);
+        if (!cam->sensor_on) {
+            break;
+        }
+        sim_capture_frame(cam, &cam->pipeline[tick % (depth + 1)], next);
+        tick++;
+
+        int64_t jitter = 0;
+        if (cam->cfg.jitterNs > 0) {
+            jitter = (int64_t)(rand_r(&cam->seed) % (uint32_t)(cam->cfg.jitterNs / 1000 + 1)) * 1000;
+        }
+        if (jitter > 0) {
+            sim_sensor_wait(cam, next + jitter);
+        }
+        // the frame captured depth ticks ago leaves the pipeline
+        sim_deliver_frame(cam, &cam->pipeline[tick % (depth + 1)]);
+        next += interval;
+    }
+    pthread_mutex_unlock(&cam->lock);
+    return NULL;
+}
+
+static void *sim_dispatch_routine(void *data)
+{
+    sim_stream_t *stream = (sim_stream_t *)data;
+    sim_camera_t *cam = stream->cam;
+    sim_channel_t *ch = &cam->channels[stream->ch_idx];
+
+    pthread_mutex_lock(&cam->lock);
+    while (true) {
+        while (stream->active && (0 == stream->ready_cnt)) {
+            pthread_cond_wait(&stream->ready_cond, &cam->lock);
+        }
+        if (!stream->active) {
+            break;
+        }
+        uint8_t idx = stream->ready_q[stream->ready_head];
+        stream->ready_head = (stream->ready_head + 1) % MM_CAMERA_MAX_NUM_FRAMES;
+        stream->ready_cnt--;
+        cam->stats.delivered++;
+
+        mm_camera_super_buf_t super_buf;
+        memset(&super_buf, 0, sizeof(super_buf));
+        super_buf.camera_handle = cam->vtbl.camera_handle;
+        super_buf.ch_id = ch->id;
+        super_buf.num_bufs = 1;
+        super_buf.bufs[0] = &stream->bufs[idx];
+        mm_camera_buf_notify_t cb = stream->config.stream_cb;
+        void *userdata = stream->config.userdata;
+        if (NULL == cb) {
+            cb = ch->channel_cb;
+            userdata = ch->userdata;
+        }
+        pthread_mutex_unlock(&cam->lock);
+        if (NULL != cb) {
+            cb(&super_buf, userdata);
+        }
+        pthread_mutex_lock(&cam->lock);
+    }
+    pthread_mutex_unlock(&cam->lock);
+    return NULL;
+}
+
+static int32_t sim_map_stream_buf_op(uint32_t /*frame_idx*/, int32_t /*plane_idx*/,
+                                     int /*fd*/, uint32_t /*size*/, void * /*userdata*/)
+{
+    return 0;
+}
+
+static int32_t sim_unmap_stream_buf_op(uint32_t /*frame_idx*/, int32_t /*plane_idx*/,
+                                       void * /*userdata*/)
+{
+    return 0;
+}
+
+static int32_t sim_map_stream_bufs_op(const cam_buf_map_type_list * /*buf_map_list*/,
+                                      void * /*userdata*/)
+{
+    return 0;
+}
+
+static void sim_fill_ops_tbl(mm_camera_map_unmap_ops_tbl_t *ops_tbl, sim_stream_t *stream)
+{
+    memset(ops_tbl, 0, sizeof(*ops_tbl));
+    ops_tbl->map_ops = sim_map_stream_buf_op;
+    ops_tbl->unmap_ops = sim_unmap_stream_buf_op;
+    ops_tbl->bundled_map_ops = sim_map_stream_bufs_op;
+    ops_tbl->userdata = stream;
+}
+
+static int32_t sim_query_capability(uint32_t camera_handle)
+{
+    // the capability buffer is left as mapped by the client
+    return (NULL != sim_get_camera(camera_handle)) ? 0 : -1;
+}
+
+static int32_t sim_register_event_notify(uint32_t camera_handle,
+                                         mm_camera_event_notify_t evt_cb,
+                                         void *user_data)
+{
+    sim_camera_t *cam = sim_get_camera(camera_handle);
+    if (NULL == cam) {
+        return -1;
+    }
+    pthread_mutex_lock(&cam->lock);
+    cam->evt_cb = evt_cb;
+    cam->evt_userdata = user_data;
+    pthread_mutex_unlock(&cam->lock);
+    return 0;
+}
+
+static int32_t sim_map_buf(uint32_t camera_handle, uint8_t /*buf_type*/,
+                           int /*fd*/, uint32_t /*size*/)
+{
+    return (NULL != sim_get_camera(camera_handle)) ? 0 : -1;
+}
+
+static int32_t sim_unmap_buf(uint32_t camera_handle, uint8_t /*buf_type*/)
+{
+    return (NULL != sim_get_camera(camera_handle)) ? 0 : -1;
+}
+
+static int32_t sim_set_parms(uint32_t camera_handle, parm_buffer_t *parms)
+{
+    sim_camera_t *cam = sim_get_camera(camera_handle);
+    int32_t rc = 0;
+    if ((NULL == cam) || (NULL == parms)) {
+        return -1;
+    }
+    pthread_mutex_lock(&cam->lock);
+    if (IS_PARAM_AVAILABLE(CAM_INTF_META_FRAME_NUMBER, parms)) {
+        if (cam->parm_cnt < SIM_MAX_PARMS) {
+            uint32_t tail = (cam->parm_head + cam->parm_cnt) % SIM_MAX_PARMS;
+            cam->parms[tail] = *(uint32_t *)
+                POINTER_OF_PARAM(CAM_INTF_META_FRAME_NUMBER, parms);
+            cam->parm_cnt++;
+        } else {
+            rc = -1;
+        }
+    }
+    pthread_mutex_unlock(&cam->lock);
+    return rc;
+}
+
+static int32_t sim_get_parms(uint32_t camera_handle, parm_buffer_t * /*parms*/)
+{
+    return (NULL != sim_get_camera(camera_handle)) ? 0 : -1;
+}
+
+static int32_t sim_no_op(uint32_t camera_handle)
+{
+    return (NULL != sim_get_camera(camera_handle)) ? 0 : -1;
+}
+
+static int32_t sim_prepare_snapshot(uint32_t camera_handle, int32_t /*do_af_flag*/)
+{
+    return sim_no_op(camera_handle);
+}
+
+static int32_t sim_channel_no_op(uint32_t camera_handle, uint32_t /*ch_id*/)
+{
+    return sim_no_op(camera_handle);
+}
+
+static uint32_t sim_add_channel(uint32_t camera_handle,
+                                mm_camera_channel_attr_t * /*attr*/,
+                                mm_camera_buf_notify_t channel_cb,
+                                void *userdata)
+{
+    sim_camera_t *cam = sim_get_camera(camera_handle);
+    uint32_t ch_id = 0;
+    if (NULL == cam) {
+        return 0;
+    }
+    pthread_mutex_lock(&cam->lock);
+    for (uint32_t c = 0; c < SIM_MAX_CHANNELS; c++) {
+        sim_channel_t *ch = &cam->channels[c];
+        if (0 == ch->id) {
+            memset(ch, 0, sizeof(*ch));
+            ch->id = c + 1;
+            ch->channel_cb = channel_cb;
+            ch->userdata = userdata;
+            ch_id = ch->id;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cam->lock);
+    return ch_id;
+}
+
+static int32_t sim_delete_channel(uint32_t camera_handle, uint32_t ch_id)
+{
+    sim_camera_t *cam = sim_get_camera(camera_handle);
+    int32_t rc = -1;
+    if (NULL == cam) {
+        return -1;
+    }
+    pthread_mutex_lock(&cam->lock);
+    sim_channel_t *ch = sim_get_channel(cam, ch_id);
+    if ((NULL != ch) && !ch->active) {
+        ch->id = 0;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&cam->lock);
+    return rc;
+}
+
+static int32_t sim_get_bundle_info(uint32_t camera_handle, uint32_t /*ch_id*/,
+                                   cam_bundle_config_t *bundle_info)
+{
+    if (NULL != bundle_info) {
+        memset(bundle_info, 0, sizeof(*bundle_info));
+    }
+    return sim_no_op(camera_handle);
+}
+
+static uint32_t sim_add_stream(uint32_t camera_handle, uint32_t ch_id)
+{
+    sim_camera_t *cam = sim_get_camera(camera_handle);
+    uint32_t stream_id = 0;
+    if (NULL == cam) {
+        return 0;
+    }
+    pthread_mutex_lock(&cam->lock);
+    sim_channel_t *ch = sim_get_channel(cam, ch_id);
+    if ((NULL != ch) && !ch->active) {
+        for (uint32_t s = 0; s < SIM_MAX_STREAMS; s++) {
+            sim_stream_t *stream = &ch->streams[s];
+            if (0 == stream->id) {
+                memset(stream, 0, sizeof(*stream));
+                stream->id = (ch_id << 8) | (s + 1);
+                stream->ch_idx = ch_id - 1;
+                stream->cam = cam;
+                stream_id = stream->id;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&cam->lock);
+    return stream_id;
+}
+
+static int32_t sim_delete_stream(uint32_t camera_handle, uint32_t ch_id,
+                                 uint32_t stream_id)
+{
+    sim_camera_t *cam = sim_get_camera(camera_handle);
+    int32_t rc = -1;
+    if (NULL == cam) {
+        return -1;
+    }
+    pthread_mutex_lock(&cam->lock);
+    sim_channel_t *ch = sim_get_channel(cam, ch_id);
+    sim_stream_t *stream = (NULL != ch) ? sim_get_stream(ch, stream_id) : NULL;
+    if ((NULL != stream) && !ch->active) {
+        stream->id = 0;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&cam->lock);
+    return rc;
+}
+
+static int32_t sim_config_stream(uint32_t camera_handle, uint32_t ch_id,
+                                 uint32_t stream_id,
+                                 mm_camera_stream_config_t *config)
+{
+    sim_camera_t *cam = sim_get_camera(camera_handle);
+    int32_t rc = -1;
+    if ((NULL == cam) || (NULL == config) || (NULL == config->stream_info)) {
+        return -1;
+    }
+    pthread_mutex_lock(&cam->lock);
+    sim_channel_t *ch = sim_get_channel(cam, ch_id);
+    sim_stream_t *stream = (NULL != ch) ? sim_get_stream(ch, stream_id) : NULL;
+    if ((NULL != stream) && !ch->active) {
+        stream->config = *config;
+        stream->configured = 1;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&cam->lock);
+    return rc;
+}
+
+static int32_t sim_map_stream_buf(uint32_t camera_handle, uint32_t /*ch_id*/,
+                                  uint32_t /*stream_id*/, uint8_t /*buf_type*/,
+                                  uint32_t /*buf_idx*/, int32_t /*plane_idx*/,
+                                  int /*fd*/, uint32_t /*size*/)
+{
+    return sim_no_op(camera_handle);
+}
+
+static int32_t sim_unmap_stream_buf(uint32_t camera_handle, uint32_t /*ch_id*/,
+                                    uint32_t /*stream_id*/, uint8_t /*buf_type*/,
+                                    uint32_t /*buf_idx*/, int32_t /*plane_idx*/)
+{
+    return sim_no_op(camera_handle);
+}
+
+static int32_t sim_stream_parms(uint32_t camera_handle, uint32_t /*ch_id*/,
+                                uint32_t /*s_id*/,
+                                cam_stream_parm_buffer_t * /*parms*/)
+{
+    return sim_no_op(camera_handle);
+}
+
+/* frame length the real interface would derive from the stream info */
+static void sim_calc_offset(cam_stream_info_t *info, cam_frame_len_offset_t *offset)
+{
+    memset(offset, 0, sizeof(*offset));
+    offset->num_planes = 1;
+    if (CAM_STREAM_TYPE_METADATA == info->stream_type) {
+        offset->frame_len = sizeof(metadata_buffer_t);
+    } else if ((info->dim.width > 0) && (info->dim.height > 0)) {
+        offset->frame_len = (uint32_t)(info->dim.width * info->dim.height * 3 / 2);
+    } else {
+        offset->frame_len = 4096;
+    }
+    offset->mp[0].len = offset->frame_len;
+}
+
+static int32_t sim_start_channel(uint32_t camera_handle, uint32_t ch_id)
+{
+    sim_camera_t *cam = sim_get_camera(camera_handle);
+    if (NULL == cam) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&cam->lock);
+    sim_channel_t *ch = sim_get_channel(cam, ch_id);
+    if ((NULL == ch) || ch->active) {
+        pthread_mutex_unlock(&cam->lock);
+        return -1;
+    }
+    pthread_mutex_unlock(&cam->lock);
+
+    // buffers are allocated by the client, outside the camera lock
+    for (uint32_t s = 0; s < SIM_MAX_STREAMS; s++) {
+        sim_stream_t *stream = &ch->streams[s];
+        if ((0 == stream->id) || !stream->configured) {
+            continue;
+        }
+        cam_frame_len_offset_t offset;
+        mm_camera_map_unmap_ops_tbl_t ops_tbl;
+        sim_calc_offset(stream->config.stream_info, &offset);
+        sim_fill_ops_tbl(&ops_tbl, stream);
+        stream->num_bufs = 0;
+        stream->bufs = NULL;
+        stream->reg_flags = NULL;
+        if ((NULL == stream->config.mem_vtbl.get_bufs) ||
+                (0 != stream->config.mem_vtbl.get_bufs(&offset, &stream->num_bufs,
+                    &stream->reg_flags, &stream->bufs, &ops_tbl,
+                    stream->config.mem_vtbl.user_data)) ||
+                (stream->num_bufs > MM_CAMERA_MAX_NUM_FRAMES)) {
+            fprintf(stderr, "sim: get_bufs failed on stream %x\n", stream->id);
+            stream->num_bufs = 0;
+            continue;
+        }
+        stream->free_head = 0;
+        stream->free_cnt = 0;
+        stream->ready_head = 0;
+        stream->ready_cnt = 0;
+        for (uint8_t i = 0; i < stream->num_bufs; i++) {
+            stream->bufs[i].buf_idx = (int8_t)i;
+            stream->bufs[i].stream_id = stream->id;
+            if ((NULL == stream->reg_flags) || stream->reg_flags[i]) {
+                stream->free_q[stream->free_cnt++] = i;
+            }
+        }
+        pthread_cond_init(&stream->ready_cond, NULL);
+        stream->active = 1;
+        if (pthread_create(&stream->dispatch_tid, NULL,
+                sim_dispatch_routine, stream) != 0) {
+            stream->active = 0;
+            pthread_cond_destroy(&stream->ready_cond);
+            if (NULL != stream->config.mem_vtbl.put_bufs) {
+                stream->config.mem_vtbl.put_bufs(&ops_tbl,
+                    stream->config.mem_vtbl.user_data);
+            }
+            stream->num_bufs = 0;
+        }
+    }
+
+    pthread_mutex_lock(&cam->lock);
+    ch->active = 1;
+    if (!cam->sensor_on) {
+        memset(cam->pipeline, 0, sizeof(cam->pipeline));
+        cam->sensor_on = 1;
+        if (pthread_create(&cam->sensor_tid, NULL, sim_sensor_routine, cam) != 0) {
+            cam->sensor_on = 0;
+        }
+    }
+    pthread_mutex_unlock(&cam->lock);
+    return 0;
+}
+
+static int32_t sim_stop_channel(uint32_t camera_handle, uint32_t ch_id)
+{
+    sim_camera_t *cam = sim_get_camera(camera_handle);
+    bool stop_sensor = true;
+    if (NULL == cam) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&cam->lock);
+    sim_channel_t *ch = sim_get_channel(cam, ch_id);
+    if ((NULL == ch) || !ch->active) {
+        pthread_mutex_unlock(&cam->lock);
+        return -1;
+    }
+    ch->active = 0;
+    for (uint32_t s = 0; s < SIM_MAX_STREAMS; s++) {
+        if (ch->streams[s].active) {
+            ch->streams[s].active = 0;
+            pthread_cond_signal(&ch->streams[s].ready_cond);
+        }
+    }
+    for (uint32_t c = 0; c < SIM_MAX_CHANNELS; c++) {
+        if ((0 != cam->channels[c].id) && cam->channels[c].active) {
+            stop_sensor = false;
+        }
+    }
+    if (stop_sensor) {
+        // frame numbers not yet captured are dropped with the stream off
+        cam->sensor_on = 0;
+        cam->parm_cnt = 0;
+        pthread_cond_signal(&cam->sensor_cond);
+    }
+    pthread_mutex_unlock(&cam->lock);
+
+    if (stop_sensor) {
+        pthread_join(cam->sensor_tid, NULL);
+    }
+
+    for (uint32_t s = 0; s < SIM_MAX_STREAMS; s++) {
+        sim_stream_t *stream = &ch->streams[s];
+        if ((0 == stream->id) || (0 == stream->num_bufs)) {
+            continue;
+        }
+        // dispatch threads may be inside stream_cb
+        pthread_join(stream->dispatch_tid, NULL);
+        pthread_cond_destroy(&stream->ready_cond);
+
+        pthread_mutex_lock(&cam->lock);
+        cam->stats.flushed += stream->ready_cnt;
+        stream->ready_cnt = 0;
+        stream->free_cnt = 0;
+        // captured buffers still in the pipeline are never delivered
+        for (uint32_t f = 0; f <= SIM_MAX_DEPTH; f++) {
+            sim_frame_t *frame = &cam->pipeline[f];
+            for (uint32_t i = 0; frame->valid && (i < frame->num_bufs); i++) {
+                if ((frame->bufs[i].ch_idx == ch_id - 1) &&
+                        (frame->bufs[i].s_idx == s)) {
+                    frame->bufs[i] = frame->bufs[--frame->num_bufs];
+                    cam->stats.flushed++;
+                    i--;
+                }
+            }
+        }
+        pthread_mutex_unlock(&cam->lock);
+
+        // stream off and unmap round trip of the real backend
+        if (cam->cfg.streamOffNs > 0) {
+            sim_sleep_until(sim_now() + cam->cfg.streamOffNs);
+        }
+        if (NULL != stream->config.mem_vtbl.put_bufs) {
+            mm_camera_map_unmap_ops_tbl_t ops_tbl;
+            sim_fill_ops_tbl(&ops_tbl, stream);
+            stream->config.mem_vtbl.put_bufs(&ops_tbl,
+                stream->config.mem_vtbl.user_data);
+        }
+        stream->num_bufs = 0;
+        stream->bufs = NULL;
+    }
+    return 0;
+}
+
+static int32_t sim_qbuf(uint32_t camera_handle, uint32_t ch_id,
+                        mm_camera_buf_def_t *buf)
+{
+    sim_camera_t *cam = sim_get_camera(camera_handle);
+    int32_t rc = -1;
+    if ((NULL == cam) || (NULL == buf)) {
+        return -1;
+    }
+    pthread_mutex_lock(&cam->lock);
+    sim_channel_t *ch = sim_get_channel(cam, ch_id);
+    sim_stream_t *stream = (NULL != ch) ? sim_get_stream(ch, buf->stream_id) : NULL;
+    if ((NULL != stream) && stream->active && (buf->buf_idx >= 0) &&
+            (buf->buf_idx < stream->num_bufs) &&
+            (stream->free_cnt < MM_CAMERA_MAX_NUM_FRAMES)) {
+        uint32_t tail = (stream->free_head + stream->free_cnt) %
+            MM_CAMERA_MAX_NUM_FRAMES;
+        stream->free_q[tail] = (uint8_t)buf->buf_idx;
+        stream->free_cnt++;
+        rc = 0;
+    }
+    pthread_mutex_unlock(&cam->lock);
+    return rc;
+}
+
+static int32_t sim_request_super_buf(uint32_t /*camera_handle*/, uint32_t /*ch_id*/,
+                                     uint32_t /*num_buf_requested*/,
+                                     uint32_t /*num_retro_buf_requested*/)
+{
+    // burst mode super buffers are not simulated
+    return -1;
+}
+
+static int32_t sim_flush_super_buf_queue(uint32_t camera_handle, uint32_t /*ch_id*/,
+                                         uint32_t /*frame_idx*/)
+{
+    return sim_no_op(camera_handle);
+}
+
+static int32_t sim_configure_notify_mode(uint32_t camera_handle, uint32_t /*ch_id*/,
+                                         mm_camera_super_buf_notify_mode_t /*mode*/)
+{
+    return sim_no_op(camera_handle);
+}
+
+static int32_t sim_process_advanced_capture(uint32_t camera_handle,
+                                            mm_camera_advanced_capture_t /*type*/,
+                                            uint32_t /*ch_id*/, int8_t /*start_flag*/)
+{
+    return sim_no_op(camera_handle);
+}
+
+static int32_t sim_close_camera(uint32_t camera_handle)
+{
+    sim_camera_t *cam = sim_get_camera(camera_handle);
+    if (NULL == cam) {
+        return -1;
+    }
+    for (uint32_t c = 0; c < SIM_MAX_CHANNELS; c++) {
+        if ((0 != cam->channels[c].id) && cam->channels[c].active) {
+            sim_stop_channel(camera_handle, cam->channels[c].id);
+        }
+    }
+    pthread_mutex_lock(&g_sim_lock);
+    pthread_cond_destroy(&cam->sensor_cond);
+    pthread_mutex_destroy(&cam->lock);
+    cam->in_use = 0;
+    pthread_mutex_unlock(&g_sim_lock);
+    return 0;
+}
+
+static mm_camera_ops_t g_sim_ops = {
+    sim_query_capability,
+    sim_register_event_notify,
+    sim_close_camera,
+    sim_map_buf,
+    sim_unmap_buf,
+    sim_set_parms,
+    sim_get_parms,
+    sim_no_op,                      // do_auto_focus
+    sim_no_op,                      // cancel_auto_focus
+    sim_prepare_snapshot,
+    sim_channel_no_op,              // start_zsl_snapshot
+    sim_channel_no_op,              // stop_zsl_snapshot
+    sim_add_channel,
+    sim_delete_channel,
+    sim_get_bundle_info,
+    sim_add_stream,
+    sim_delete_stream,
+    sim_config_stream,
+    sim_map_stream_buf,
+    sim_unmap_stream_buf,
+    sim_stream_parms,               // set_stream_parms
+    sim_stream_parms,               // get_stream_parms
+    sim_start_channel,
+    sim_stop_channel,
+    sim_qbuf,
+    sim_request_super_buf,
+    sim_channel_no_op,              // cancel_super_buf_request
+    sim_flush_super_buf_queue,
+    sim_configure_notify_mode,
+    sim_process_advanced_capture,
+};
+
+void sim_camera_default_cfg(sim_camera_cfg_t *cfg)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->fps = 30;
+    cfg->jitterNs = 2000000LL;
+    cfg->pipelineDepth = 2;
+    cfg->streamOffNs = 5000000LL;
+    cfg->seed = 1;
+}
+
+mm_camera_vtbl_t *sim_camera_open(const sim_camera_cfg_t *cfg)
+{
+    sim_camera_t *cam = NULL;
+
+    if ((NULL == cfg) || (0 == cfg->fps)) {
+        return NULL;
+    }
+    pthread_mutex_lock(&g_sim_lock);
+    for (uint32_t i = 0; i < SIM_MAX_CAMERAS; i++) {
+        if (!g_sim_cameras[i].in_use) {
+            cam = &g_sim_cameras[i];
+            memset(cam, 0, sizeof(*cam));
+            cam->in_use = 1;
+            cam->cfg = *cfg;
+            cam->seed = cfg->seed;
+            cam->vtbl.camera_handle = i + 1;
+            cam->vtbl.ops = &g_sim_ops;
+            pthread_mutex_init(&cam->lock, NULL);
+            pthread_condattr_t attr;
+            pthread_condattr_init(&attr);
+            pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+            pthread_cond_init(&cam->sensor_cond, &attr);
+            pthread_condattr_destroy(&attr);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_sim_lock);
+    return (NULL != cam) ? &cam->vtbl : NULL;
+}
+
+int32_t sim_camera_get_stats(uint32_t camera_handle, sim_camera_stats_t *stats)
+{
+    sim_camera_t *cam = sim_get_camera(camera_handle);
+    if ((NULL == cam) || (NULL == stats)) {
+        return -1;
+    }
+    pthread_mutex_lock(&cam->lock);
+    *stats = cam->stats;
+    pthread_mutex_unlock(&cam->lock);
+    return 0;
+}
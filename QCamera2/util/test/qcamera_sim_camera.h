@@ -0,0 +1,70 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef __QCAMERA_SIM_CAMERA_H__
+#define __QCAMERA_SIM_CAMERA_H__
+
+#include <stdlib.h>
+#include <string.h>
+#include "mm_camera_interface.h"
+
+/* In-process stand-in for mm-camera-interface. It implements
+ * mm_camera_ops_t without a daemon or kernel driver: a sensor thread
+ * fills queued stream buffers at the configured fps, metadata stream
+ * buffers get synthetic metadata carrying the frame number set by the
+ * latest set_parms, and frames are handed to stream_cb on one dispatch
+ * thread per stream, after a pipeline delay and delivery jitter. Buffers
+ * come from the client's mem_vtbl at start_channel and go back to the
+ * sensor through qbuf, as with the real interface. */
+
+#define SIM_MAX_CHANNELS      8
+#define SIM_MAX_PARMS         64   // frame numbers waiting for a sensor frame
+#define SIM_MAX_DEPTH         8
+
+typedef struct {
+    uint32_t fps;              // sensor frame rate
+    int64_t jitterNs;          // max extra delivery delay per frame
+    uint32_t pipelineDepth;    // frames between capture and delivery
+    int64_t streamOffNs;       // time a stream takes to stop
+    unsigned int seed;
+} sim_camera_cfg_t;
+
+typedef struct {
+    uint32_t frames;           // sensor frames
+    uint32_t requests;         // frames that carried a frame number
+    uint32_t delivered;        // stream buffers handed to stream_cb
+    uint32_t starved;          // stream frames skipped without a queued buffer
+    uint32_t flushed;          // captured buffers dropped by stop_channel
+} sim_camera_stats_t;
+
+void sim_camera_default_cfg(sim_camera_cfg_t *cfg);
+mm_camera_vtbl_t *sim_camera_open(const sim_camera_cfg_t *cfg);
+int32_t sim_camera_get_stats(uint32_t camera_handle, sim_camera_stats_t *stats);
+
+#endif /* __QCAMERA_SIM_CAMERA_H__ */
@@ -0,0 +1,268 @@
+/* Copyright (c) 2013, The Linux Foundataion. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Checks QCameraFrameTiming against synthetic sensor timing traces: steady
+ * 30/60/120 fps with timestamp jitter, fps switches with and without frame
+ * duration metadata, AE driven frame durations that change every frame and
+ * long exposures. Frames without metadata are estimated the way HAL3 back
+ * fills skipped shutters, right after the next frame with a timestamp.
+ * Exits with 1 on the first failure. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "QCameraFrameTiming.h"
+
+using namespace qcamera;
+
+#define NSEC_PER_MSEC 1000000LL
+
+typedef struct {
+    const char *name;
+    int frames;
+    int64_t duration[2];    // frame duration before/after switchFrame
+    int switchFrame;        // first frame with duration[1], frames if none
+    int64_t ramp;           // per frame AE duration swing amplitude, 0 if none
+    int64_t jitter;         // max sensor timestamp jitter
+    int skipEvery;          // every n-th frame has no metadata, 0 if none
+    int skipRun;            // number of consecutive frames skipped
+    bool durationMeta;      // frame duration reported in metadata
+    int settle;             // frames from the switch on excluded from the
+                            // check, a skipped switch frame cannot be placed
+    int64_t tolerance;      // max allowed estimation error
+} timing_trace_t;
+
+static const timing_trace_t traces[] = {
+    {"30fps",            600, {33333333, 33333333}, 600, 0, 200000, 3, 1, true,  0, 1 * NSEC_PER_MSEC},
+    {"60fps",            600, {16666666, 16666666}, 600, 0, 200000, 3, 1, true,  0, 1 * NSEC_PER_MSEC},
+    {"120fps",           600, { 8333333,  8333333}, 600, 0, 100000, 3, 1, true,  0, NSEC_PER_MSEC / 2},
+    {"120fps no meta",   600, { 8333333,  8333333}, 600, 0, 100000, 4, 2, false, 0, NSEC_PER_MSEC / 2},
+    {"30->120fps",       600, {33333333,  8333333}, 300, 0, 100000, 3, 1, true,  1, 1 * NSEC_PER_MSEC},
+    {"120->30fps",       600, { 8333333, 33333333}, 300, 0, 100000, 3, 1, true,  1, 1 * NSEC_PER_MSEC},
+    {"30->60fps no meta",600, {33333333, 16666666}, 300, 0, 100000, 3, 1, false, 3, 1 * NSEC_PER_MSEC},
+    {"AE 40ms +-8ms",    600, {40000000, 40000000}, 600, 8000000, 100000, 3, 1, true, 0, 2 * NSEC_PER_MSEC},
+    {"1s exposure",       30, {1000000000LL, 1000000000LL}, 30, 0, 100000, 2, 1, true, 0, 1 * NSEC_PER_MSEC},
+};
+
+static int64_t jitterOf(int64_t jitter, unsigned int *seed)
+{
+    if (jitter <= 0) {
+        return 0;
+    }
+    return (int64_t)(rand_r(seed) % (2 * jitter + 1)) - jitter;
+}
+
+/* frame duration of a frame in the trace */
+static int64_t durationOf(const timing_trace_t *trace, int frame)
+{
+    int64_t duration = trace->duration[(frame < trace->switchFrame) ? 0 : 1];
+    if (trace->ramp > 0) {
+        // triangle wave with a period of 64 frames, a new value every frame
+        int64_t phase = frame % 64;
+        int64_t tri = (phase < 32) ? phase : (64 - phase);
+        duration += trace->ramp * (tri - 16) / 16;
+    }
+    return duration;
+}
+
+static bool isSkipped(const timing_trace_t *trace, int frame)
+{
+    if ((trace->skipEvery <= 0) || (frame < trace->skipEvery)) {
+        return false;
+    }
+    return (frame % trace->skipEvery) < trace->skipRun;
+}
+
+static bool runTrace(const timing_trace_t *trace, unsigned int *seed)
+{
+    QCameraFrameTiming timing;
+    int64_t *ts = (int64_t *)malloc(sizeof(int64_t) * trace->frames);
+    if (NULL == ts) {
+        printf("no mem for %s\n", trace->name);
+        return false;
+    }
+
+    // start of exposure of a frame follows the duration of the one before
+    int64_t ideal = 1000 * NSEC_PER_MSEC;
+    for (int i = 0; i < trace->frames; i++) {
+        ts[i] = ideal + jitterOf(trace->jitter, seed);
+        ideal += durationOf(trace, i);
+    }
+
+    int pending = -1;
+    int estimated = 0;
+    int64_t maxErr = 0;
+    int worst = -1;
+    for (int i = 0; i < trace->frames; i++) {
+        if (isSkipped(trace, i)) {
+            if (pending < 0) {
+                pending = i;
+            }
+            continue;
+        }
+        if (trace->durationMeta) {
+            timing.setFrameDuration(durationOf(trace, i));
+        }
+        timing.update((uint32_t)i, ts[i]);
+        for (int j = (pending < 0) ? i : pending; j < i; j++) {
+            bool settling = (trace->switchFrame <= j) &&
+                (j < trace->switchFrame + trace->settle);
+            int64_t err = llabs(timing.estimateTimestamp((uint32_t)j) - ts[j]);
+            estimated++;
+            if (!settling && (err > maxErr)) {
+                maxErr = err;
+                worst = j;
+            }
+        }
+        pending = -1;
+    }
+
+    int64_t lastDuration = durationOf(trace, trace->frames - 1);
+    printf("%-18s %3d estimated, max error %5lld us (frame %d), interval %lld us\n",
+        trace->name, estimated, (long long)(maxErr / 1000), worst,
+        (long long)(timing.getFrameInterval() / 1000));
+    free(ts);
+
+    if (0 == estimated) {
+        printf("%s: no frame estimated\n", trace->name);
+        return false;
+    }
+    if (maxErr > trace->tolerance) {
+        printf("%s: error above %lld us\n", trace->name,
+            (long long)(trace->tolerance / 1000));
+        return false;
+    }
+    if (llabs(timing.getFrameInterval() - lastDuration) >
+            lastDuration / 8 + trace->ramp) {
+        printf("%s: interval off the frame duration %lld us\n", trace->name,
+            (long long)(lastDuration / 1000));
+        return false;
+    }
+    return true;
+}
+
+/* a duration update must refine, not discard, a measured interval */
+static bool checkDurationBlend()
+{
+    QCameraFrameTiming timing;
+    int64_t interval = 40 * NSEC_PER_MSEC;
+
+    for (uint32_t i = 0; i < 10; i++) {
+        timing.update(i, 1000 * NSEC_PER_MSEC + i * interval);
+    }
+    if (timing.getFrameInterval() != interval) {
+        printf("blend: measured %lld us\n",
+            (long long)(timing.getFrameInterval() / 1000));
+        return false;
+    }
+
+    // small change, e.g. AE: blended into the measured interval
+    timing.setFrameDuration(interval + 2 * NSEC_PER_MSEC);
+    int64_t blended = timing.getFrameInterval();
+    if ((blended <= interval) || (blended >= interval + NSEC_PER_MSEC)) {
+        printf("blend: %lld us after a 2ms duration change\n",
+            (long long)(blended / 1000));
+        return false;
+    }
+
+    // fps switch: re-seeded from the new duration
+    timing.setFrameDuration(2 * interval);
+    if (timing.getFrameInterval() != 2 * interval) {
+        printf("blend: %lld us after an fps switch\n",
+            (long long)(timing.getFrameInterval() / 1000));
+        return false;
+    }
+
+    printf("duration blend ok\n");
+    return true;
+}
+
+static bool checkDefaults()
+{
+    QCameraFrameTiming timing;
+
+    if (timing.isValid() || (0 != timing.estimateTimestamp(5)) ||
+            (timing.getFrameInterval() != QCameraFrameTiming::kDefaultFrameInterval)) {
+        printf("defaults: fresh model not empty\n");
+        return false;
+    }
+
+    // invalid input is ignored
+    timing.update(1, 0);
+    timing.update(1, -5);
+    timing.setFrameDuration(0);
+    timing.setFrameDuration(QCameraFrameTiming::kMaxFrameInterval + 1);
+    if (timing.isValid() ||
+            (timing.getFrameInterval() != QCameraFrameTiming::kDefaultFrameInterval)) {
+        printf("defaults: invalid input accepted\n");
+        return false;
+    }
+
+    // the first timestamp anchors, the reported duration extrapolates
+    timing.setFrameDuration(50 * NSEC_PER_MSEC);
+    timing.update(10, 2000 * NSEC_PER_MSEC);
+    if (timing.estimateTimestamp(8) != 1900 * NSEC_PER_MSEC) {
+        printf("defaults: estimate %lld us from the duration\n",
+            (long long)(timing.estimateTimestamp(8) / 1000));
+        return false;
+    }
+
+    // stale or repeated frames do not move the anchor
+    timing.update(9, 1990 * NSEC_PER_MSEC);
+    timing.update(10, 2010 * NSEC_PER_MSEC);
+    if (timing.estimateTimestamp(11) != 2050 * NSEC_PER_MSEC) {
+        printf("defaults: anchor moved by an old frame\n");
+        return false;
+    }
+
+    timing.reset();
+    if (timing.isValid() ||
+            (timing.getFrameInterval() != QCameraFrameTiming::kDefaultFrameInterval)) {
+        printf("defaults: reset kept history\n");
+        return false;
+    }
+
+    printf("defaults ok\n");
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int seed = (argc > 1) ? (unsigned int)atoi(argv[1]) : 1;
+
+    if (!checkDefaults() || !checkDurationBlend()) {
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(traces) / sizeof(traces[0]); i++) {
+        if (!runTrace(&traces[i], &seed)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -41,9 +41,14 @@ extern "C" {
 *                                 size id too big to be included
 *                                 in the exif and will be
 *                                 dropped
+*  @ OMX_EVENT_JPEG_SLICE_DONE - Decoder output rows are final,
+*                                 nData1 rows of nData2 are done
+*                                 and pEventData is the output
+*                                 buffer header
 **/
 typedef enum {
- OMX_EVENT_THUMBNAIL_DROPPED = OMX_EventVendorStartUnused+1
+ OMX_EVENT_THUMBNAIL_DROPPED = OMX_EventVendorStartUnused+1,
+ OMX_EVENT_JPEG_SLICE_DONE
 } QOMX_IMAGE_EXT_EVENTS;
 
 /**
@@ -60,6 +65,8 @@ typedef enum {
 #define QOMX_IMAGE_EXT_META_ENC_KEY_NAME      "OMX.QCOM.image.exttype.metaEncKey"
 #define QOMX_IMAGE_EXT_MEM_OPS_NAME      "OMX.QCOM.image.exttype.mem_ops"
 #define QOMX_IMAGE_EXT_JPEG_SPEED_NAME      "OMX.QCOM.image.exttype.jpeg.speed"
+#define QOMX_IMAGE_EXT_STREAMING_NAME      "OMX.QCOM.image.exttype.streaming"
+#define QOMX_IMAGE_EXT_DECODE_PIPELINE_NAME "OMX.QCOM.image.exttype.decodePipeline"
 
 /** QOMX_IMAGE_EXT_INDEXTYPE
 *  This enum is an extension of the OMX_INDEXTYPE enum and
@@ -99,6 +106,12 @@ typedef enum {
   //Name: OMX.QCOM.image.exttype.jpeg.speed
   QOMX_IMAGE_EXT_JPEG_SPEED = 0x07F000B,
 
+  //Name: OMX.QCOM.image.exttype.streaming
+  QOMX_IMAGE_EXT_STREAMING = 0x07F000C,
+
+  //Name: OMX.QCOM.image.exttype.decodePipeline
+  QOMX_IMAGE_EXT_DECODE_PIPELINE = 0x07F000D,
+
 } QOMX_IMAGE_EXT_INDEXTYPE;
 
 /** QOMX_BUFFER_INFO
@@ -309,6 +322,38 @@ typedef struct {
   QOMX_JPEG_SPEED_MODE speedMode;
 } QOMX_JPEG_SPEED;
 
+/** QOMX_JPEG_STREAMING
+* Structure used to enable partial output. The output buffer
+* is returned with FillBufferDone every time nChunkSize more
+* bytes are final, nFilledLen covering everything written so
+* far. The client hands it back with FillThisBuffer and the
+* last return carries OMX_BUFFERFLAG_EOS
+* @bEnable - enable streaming output
+* @nChunkSize - minimum number of new bytes per return
+**/
+typedef struct {
+  OMX_BOOL bEnable;
+  OMX_U32 nChunkSize;
+} QOMX_JPEG_STREAMING;
+
+/** QOMX_JPEG_DECODE_PIPELINE
+* Structure used to decode several images at once. Images
+* queued with EmptyThisBuffer are paired with output buffers in
+* order and up to nMaxJobs are decoded concurrently. The output
+* port is reconfigured with OMX_EventPortSettingsChanged only
+* when the image size changes. GetParameter returns the values
+* in effect
+* @nMaxJobs - maximum number of concurrent decodes, 0 for the
+*             component default
+* @nSliceHeight - send OMX_EVENT_JPEG_SLICE_DONE every time at
+*                 least this many output rows are final, 0 to
+*                 disable
+**/
+typedef struct {
+  OMX_U32 nMaxJobs;
+  OMX_U32 nSliceHeight;
+} QOMX_JPEG_DECODE_PIPELINE;
+
 #ifdef __cplusplus
  }
 #endif
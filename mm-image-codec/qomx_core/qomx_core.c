@@ -42,7 +42,9 @@ static int g_omxcore_cnt = 0;
 static const comp_info_t g_comp_info[] =
 {
   { "OMX.qcom.image.jpeg.encoder", "libqomx_jpegenc.so" },
-  { "OMX.qcom.image.jpeg.decoder", "libqomx_jpegdec.so" }
+  { "OMX.qcom.image.jpeg.decoder", "libqomx_jpegdec.so" },
+  { "OMX.qcom.image.jpeg.encoder_sw", "libqomx_jpegenc_sw.so" },
+  { "OMX.qcom.image.jpeg.decoder_sw", "libqomx_jpegdec_sw.so" }
 };
 
 static int get_idx_from_handle(OMX_IN OMX_HANDLETYPE *ahComp, int *acompIndex,
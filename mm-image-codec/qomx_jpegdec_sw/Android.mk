@@ -0,0 +1,63 @@
+OMX_JPEGDEC_SW_PATH := $(call my-dir)
+
+# ------------------------------------------------------------------------------
+#                Make the shared library (libqomx_jpegdec_sw)
+# ------------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(OMX_JPEGDEC_SW_PATH)
+LOCAL_MODULE_TAGS := optional
+
+omx_jpegdec_sw_defines:= -Werror \
+                         -O3 -ftree-vectorize
+
+LOCAL_CFLAGS := $(omx_jpegdec_sw_defines)
+
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_ARM_NEON := true
+endif
+
+OMX_HEADER_DIR := frameworks/native/include/media/openmax
+
+LOCAL_C_INCLUDES := $(OMX_HEADER_DIR)
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../qexif
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../qomx_core
+
+LOCAL_SRC_FILES := qomx_jpegdec_sw.c \
+                   qomx_jpegdec_sw_core.c
+
+LOCAL_MODULE           := libqomx_jpegdec_sw
+LOCAL_PRELINK_MODULE   := false
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+
+include $(BUILD_SHARED_LIBRARY)
+
+# ------------------------------------------------------------------------------
+#                Decoder benchmark (qomx-jpegdec-sw-bench)
+# ------------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(OMX_JPEGDEC_SW_PATH)
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := $(omx_jpegdec_sw_defines)
+
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_ARM_NEON := true
+endif
+
+LOCAL_C_INCLUDES := $(OMX_HEADER_DIR)
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../qexif
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../qomx_core
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../qomx_jpegenc_sw
+
+# the encoder core makes the synthetic input
+LOCAL_SRC_FILES := test/qomx_jpegdec_sw_bench.c \
+                   qomx_jpegdec_sw_core.c \
+                   ../qomx_jpegenc_sw/qomx_jpegenc_sw_core.c
+
+LOCAL_MODULE           := qomx-jpegdec-sw-bench
+LOCAL_PRELINK_MODULE   := false
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+
+include $(BUILD_EXECUTABLE)
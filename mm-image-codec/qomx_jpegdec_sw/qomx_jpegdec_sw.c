@@ -0,0 +1,1325 @@
+/*Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+
+
+#define LOG_TAG "qomx_jpegdec_sw"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <cutils/properties.h>
+#include "qomx_jpegdec_sw.h"
+
+#define QOMX_JPEGDEC_SW_VERSION 0x00000101
+
+/** qomx_jpegdec_sw_ext_t: Supported extension
+*    @name: extension name
+*    @index: extension index
+**/
+typedef struct {
+  const char *name;
+  QOMX_IMAGE_EXT_INDEXTYPE index;
+} qomx_jpegdec_sw_ext_t;
+
+static const qomx_jpegdec_sw_ext_t g_extensions[] = {
+  { QOMX_IMAGE_EXT_DECODE_PIPELINE_NAME, QOMX_IMAGE_EXT_DECODE_PIPELINE },
+};
+
+/** qomx_jpegdec_sw_slice_t: Slice event context of one decode
+*    @p_comp: component
+*    @p_out: output buffer
+*    @height: image height
+**/
+typedef struct {
+  void *p_comp;
+  OMX_BUFFERHEADERTYPE *p_out;
+  uint32_t height;
+} qomx_jpegdec_sw_slice_t;
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_get_comp
+* Parameters: hComp
+* Return Value : component, NULL if the handle is invalid
+* Description: Get the component from the OMX handle
+==============================================================================*/
+static inline qomx_jpegdec_sw_comp_t *qomx_jpegdec_sw_get_comp(
+  OMX_HANDLETYPE hComp)
+{
+  if (NULL == hComp) {
+    return NULL;
+  }
+  return (qomx_jpegdec_sw_comp_t *)
+    ((OMX_COMPONENTTYPE *)hComp)->pComponentPrivate;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_event
+* Parameters: p_comp, event, data1, data2, p_data
+* Return Value : None
+* Description: Send an event to the client. Must be called without the
+* component lock held
+==============================================================================*/
+static void qomx_jpegdec_sw_event(qomx_jpegdec_sw_comp_t *p_comp,
+  OMX_EVENTTYPE event, OMX_U32 data1, OMX_U32 data2, OMX_PTR p_data)
+{
+  if (p_comp->callbacks.EventHandler) {
+    p_comp->callbacks.EventHandler(p_comp->p_comp, p_comp->app_data, event,
+      data1, data2, p_data);
+  }
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_return_buffer
+* Parameters: p_comp, p_buf
+* Return Value : None
+* Description: Hand a buffer back to the client. Must be called without
+* the component lock held
+==============================================================================*/
+static void qomx_jpegdec_sw_return_buffer(qomx_jpegdec_sw_comp_t *p_comp,
+  OMX_BUFFERHEADERTYPE *p_buf)
+{
+  if (QOMX_JPEGDEC_SW_PORT_OUT == p_buf->nOutputPortIndex) {
+    if (p_comp->callbacks.FillBufferDone) {
+      p_comp->callbacks.FillBufferDone(p_comp->p_comp, p_comp->app_data,
+        p_buf);
+    }
+  } else if (p_comp->callbacks.EmptyBufferDone) {
+    p_comp->callbacks.EmptyBufferDone(p_comp->p_comp, p_comp->app_data,
+      p_buf);
+  }
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_dequeue
+* Parameters: p_port
+* Return Value : oldest queued buffer, NULL if none
+* Description: Remove the oldest buffer from the port queue
+==============================================================================*/
+static OMX_BUFFERHEADERTYPE *qomx_jpegdec_sw_dequeue(
+  qomx_jpegdec_sw_port_t *p_port)
+{
+  OMX_BUFFERHEADERTYPE *p_buf;
+
+  if (0 == p_port->num_queued) {
+    return NULL;
+  }
+  p_buf = p_port->p_queue[0];
+  p_port->num_queued--;
+  memmove(&p_port->p_queue[0], &p_port->p_queue[1],
+    p_port->num_queued * sizeof(p_port->p_queue[0]));
+  return p_buf;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_requeue
+* Parameters: p_port, p_buf
+* Return Value : None
+* Description: Put a buffer back at the head of the port queue
+==============================================================================*/
+static void qomx_jpegdec_sw_requeue(qomx_jpegdec_sw_port_t *p_port,
+  OMX_BUFFERHEADERTYPE *p_buf)
+{
+  if ((NULL == p_buf) || (p_port->num_queued >= QOMX_JPEGDEC_SW_MAX_BUFS)) {
+    return;
+  }
+  memmove(&p_port->p_queue[1], &p_port->p_queue[0],
+    p_port->num_queued * sizeof(p_port->p_queue[0]));
+  p_port->p_queue[0] = p_buf;
+  p_port->num_queued++;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_transition_ready
+* Parameters: p_comp
+* Return Value : TRUE if the pending state transition can complete
+* Description: Loaded to Idle waits for the enabled ports to be populated,
+* Executing to Idle for the decodes to stop and Idle to Loaded for all
+* the buffers to be freed
+==============================================================================*/
+static int qomx_jpegdec_sw_transition_ready(qomx_jpegdec_sw_comp_t *p_comp)
+{
+  qomx_jpegdec_sw_port_t *p_port;
+  int i;
+
+  if (!p_comp->state_pending) {
+    return OMX_FALSE;
+  }
+  if ((OMX_StateIdle == p_comp->target_state) &&
+    (OMX_StateLoaded == p_comp->state)) {
+    for (i = 0; i < QOMX_JPEGDEC_SW_NUM_PORTS; i++) {
+      p_port = &p_comp->ports[i];
+      if (p_port->def.bEnabled && !p_port->def.bPopulated) {
+        return OMX_FALSE;
+      }
+    }
+  } else if (OMX_StateIdle == p_comp->target_state) {
+    if (p_comp->num_active) {
+      return OMX_FALSE;
+    }
+  } else if (OMX_StateLoaded == p_comp->target_state) {
+    for (i = 0; i < QOMX_JPEGDEC_SW_NUM_PORTS; i++) {
+      if (p_comp->ports[i].num_bufs) {
+        return OMX_FALSE;
+      }
+    }
+  }
+  return OMX_TRUE;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_get_frame
+* Parameters: p_def, p_buf, width, height, p_frame, p_size
+* Return Value : 0 on success, -1 if the format or layout is not supported
+* Description: Describe the semi planar frame held by the output buffer,
+* the chroma plane following nSliceHeight luma rows
+==============================================================================*/
+static int qomx_jpegdec_sw_get_frame(OMX_PARAM_PORTDEFINITIONTYPE *p_def,
+  OMX_BUFFERHEADERTYPE *p_buf, uint32_t width, uint32_t height,
+  jpegdec_sw_frame_t *p_frame, uint32_t *p_size)
+{
+  uint32_t chroma_rows, slice;
+  uint64_t size;
+  int color = (int)p_def->format.image.eColorFormat;
+
+  memset(p_frame, 0, sizeof(*p_frame));
+  p_frame->stride = (p_def->format.image.nStride >= (OMX_S32)width) ?
+    (uint32_t)p_def->format.image.nStride : width;
+  slice = (p_def->format.image.nSliceHeight >= height) ?
+    p_def->format.image.nSliceHeight : height;
+
+  switch (color) {
+  case OMX_COLOR_FormatYUV420SemiPlanar:
+    p_frame->chroma_hshift = p_frame->chroma_vshift = 1;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYVU420SemiPlanar:
+    p_frame->chroma_hshift = p_frame->chroma_vshift = 1;
+    p_frame->cr_first = 1;
+    break;
+  case OMX_COLOR_FormatYUV422SemiPlanar:
+    p_frame->chroma_hshift = 1;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYVU422SemiPlanar:
+    p_frame->chroma_hshift = 1;
+    p_frame->cr_first = 1;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYUV422SemiPlanar_h1v2:
+    p_frame->chroma_vshift = 1;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYVU422SemiPlanar_h1v2:
+    p_frame->chroma_vshift = 1;
+    p_frame->cr_first = 1;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYUV444SemiPlanar:
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYVU444SemiPlanar:
+    p_frame->cr_first = 1;
+    break;
+  case OMX_COLOR_FormatMonochrome:
+    break;
+  default:
+    ALOGE("%s:%d] unsupported color format %x", __func__, __LINE__, color);
+    return -1;
+  }
+
+  size = (uint64_t)p_frame->stride * slice;
+  if (OMX_COLOR_FormatMonochrome != color) {
+    /* chroma samples are interleaved, two bytes each */
+    chroma_rows = (slice + p_frame->chroma_vshift) >> p_frame->chroma_vshift;
+    size += (uint64_t)(p_frame->stride << 1 >> p_frame->chroma_hshift) *
+      chroma_rows;
+  }
+  if (p_size) {
+    *p_size = (uint32_t)size;
+  }
+  if (NULL == p_buf) {
+    return 0;
+  }
+  if (size > p_buf->nAllocLen) {
+    ALOGE("%s:%d] frame of %lld bytes exceeds buffer of %d", __func__,
+      __LINE__, (long long)size, (int)p_buf->nAllocLen);
+    return -1;
+  }
+  p_frame->p_luma = p_buf->pBuffer;
+  if (OMX_COLOR_FormatMonochrome != color) {
+    p_frame->p_chroma = p_buf->pBuffer + p_frame->stride * slice;
+  }
+  return 0;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_slice_done
+* Parameters: p_user - slice context, rows - rows done
+* Return Value : None
+* Description: Tell the client that the first rows of the output are final
+==============================================================================*/
+static void qomx_jpegdec_sw_slice_done(void *p_user, uint32_t rows)
+{
+  qomx_jpegdec_sw_slice_t *p_slice = (qomx_jpegdec_sw_slice_t *)p_user;
+  qomx_jpegdec_sw_comp_t *p_comp = (qomx_jpegdec_sw_comp_t *)p_slice->p_comp;
+
+  if (!p_comp->abort) {
+    qomx_jpegdec_sw_event(p_comp, (OMX_EVENTTYPE)OMX_EVENT_JPEG_SLICE_DONE,
+      rows, p_slice->height, p_slice->p_out);
+  }
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_process
+* Parameters: p_comp, p_ctx, p_job
+* Return Value : OMX_ErrorNone on success
+* Description: Decode one image, called from a worker thread without the
+* component lock held
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_process(qomx_jpegdec_sw_comp_t *p_comp,
+  jpegdec_sw_ctx_t *p_ctx, qomx_jpegdec_sw_job_t *p_job)
+{
+  OMX_BUFFERHEADERTYPE *p_in = p_job->p_in;
+  OMX_BUFFERHEADERTYPE *p_out = p_job->p_out;
+  qomx_jpegdec_sw_slice_t slice;
+  jpegdec_sw_frame_t frame;
+  uint32_t size;
+  struct timeval start, end;
+  long long time_us;
+
+  gettimeofday(&start, NULL);
+  if (qomx_jpegdec_sw_get_frame(&p_job->out_def, p_out, p_job->hdr.width,
+    p_job->hdr.height, &frame, &size) < 0) {
+    return OMX_ErrorBadParameter;
+  }
+  slice.p_comp = p_comp;
+  slice.p_out = p_out;
+  slice.height = p_job->hdr.height;
+  if (jpegdec_sw_decode(p_ctx, &p_job->hdr, p_in->pBuffer + p_in->nOffset,
+    p_in->nFilledLen, &frame, p_job->slice_height,
+    qomx_jpegdec_sw_slice_done, &slice, &p_comp->abort) < 0) {
+    return OMX_ErrorStreamCorrupt;
+  }
+  p_out->nOffset = 0;
+  p_out->nFilledLen = size;
+  p_out->nFlags |= OMX_BUFFERFLAG_EOS;
+
+  gettimeofday(&end, NULL);
+  time_us = (end.tv_sec - start.tv_sec) * 1000000LL +
+    (end.tv_usec - start.tv_usec);
+  ALOGI("[KPI Perf] %s: %dx%d decoded %d bytes in %lld us", __func__,
+    p_job->hdr.width, p_job->hdr.height, (int)p_in->nFilledLen, time_us);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_worker
+* Parameters: data - component
+* Return Value : NULL
+* Description: Worker thread, runs the oldest pending decode. Client
+* callbacks are made with the component lock released
+==============================================================================*/
+static void *qomx_jpegdec_sw_worker(void *data)
+{
+  qomx_jpegdec_sw_comp_t *p_comp = (qomx_jpegdec_sw_comp_t *)data;
+  qomx_jpegdec_sw_job_t *p_job;
+  OMX_BUFFERHEADERTYPE *p_in, *p_out;
+  jpegdec_sw_ctx_t *p_ctx;
+  OMX_ERRORTYPE rc;
+  uint32_t i;
+
+  p_ctx = jpegdec_sw_ctx_create();
+  if (NULL == p_ctx) {
+    ALOGE("%s:%d] no memory", __func__, __LINE__);
+    return NULL;
+  }
+
+  pthread_mutex_lock(&p_comp->lock);
+  while (!p_comp->exit) {
+    p_job = NULL;
+    for (i = 0; i < QOMX_JPEGDEC_SW_MAX_JOBS; i++) {
+      if ((QOMX_JPEGDEC_SW_JOB_PENDING == p_comp->jobs[i].state) &&
+        (!p_job || ((int32_t)(p_comp->jobs[i].seq - p_job->seq) < 0))) {
+        p_job = &p_comp->jobs[i];
+      }
+    }
+    if (NULL == p_job) {
+      pthread_cond_wait(&p_comp->cond, &p_comp->lock);
+      continue;
+    }
+    p_job->state = QOMX_JPEGDEC_SW_JOB_RUNNING;
+    p_in = p_job->p_in;
+    p_out = p_job->p_out;
+    pthread_mutex_unlock(&p_comp->lock);
+
+    rc = p_job->rc;
+    if (OMX_ErrorNone == rc) {
+      rc = qomx_jpegdec_sw_process(p_comp, p_ctx, p_job);
+    }
+
+    pthread_mutex_lock(&p_comp->lock);
+    if (p_comp->abort) {
+      /* returned by the transition to idle */
+      qomx_jpegdec_sw_requeue(&p_comp->ports[QOMX_JPEGDEC_SW_PORT_OUT],
+        p_out);
+      qomx_jpegdec_sw_requeue(&p_comp->ports[QOMX_JPEGDEC_SW_PORT_IN], p_in);
+    } else {
+      pthread_mutex_unlock(&p_comp->lock);
+      qomx_jpegdec_sw_return_buffer(p_comp, p_in);
+      /* on error the client completes the job from the error event, the
+       * output buffer is queued again with the next job */
+      if (OMX_ErrorNone == rc) {
+        qomx_jpegdec_sw_return_buffer(p_comp, p_out);
+      } else {
+        p_out->nFilledLen = 0;
+        qomx_jpegdec_sw_event(p_comp, OMX_EventError, rc, 0, p_out);
+      }
+      pthread_mutex_lock(&p_comp->lock);
+    }
+    p_job->state = QOMX_JPEGDEC_SW_JOB_FREE;
+    p_comp->num_active--;
+    pthread_cond_broadcast(&p_comp->cond);
+  }
+  pthread_mutex_unlock(&p_comp->lock);
+  jpegdec_sw_ctx_destroy(p_ctx);
+  return NULL;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_start_workers
+* Parameters: p_comp
+* Return Value : None
+* Description: Start the worker threads missing for max_jobs decodes.
+* Called with the component lock held
+==============================================================================*/
+static void qomx_jpegdec_sw_start_workers(qomx_jpegdec_sw_comp_t *p_comp)
+{
+  while (p_comp->num_workers < p_comp->max_jobs) {
+    if (pthread_create(&p_comp->workers[p_comp->num_workers], NULL,
+      qomx_jpegdec_sw_worker, p_comp)) {
+      ALOGE("%s:%d] cannot create worker %d", __func__, __LINE__,
+        p_comp->num_workers);
+      break;
+    }
+    p_comp->num_workers++;
+  }
+  /* decodes never wait for a worker */
+  if (p_comp->num_workers && (p_comp->max_jobs > p_comp->num_workers)) {
+    p_comp->max_jobs = p_comp->num_workers;
+  }
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_reconfigure
+* Parameters: p_comp, p_hdr
+* Return Value : None
+* Description: Set the output port definition for the image and ask the
+* client to reconfigure the port. Called with the component lock held
+==============================================================================*/
+static void qomx_jpegdec_sw_reconfigure(qomx_jpegdec_sw_comp_t *p_comp,
+  jpegdec_sw_header_t *p_hdr)
+{
+  OMX_PARAM_PORTDEFINITIONTYPE *p_def =
+    &p_comp->ports[QOMX_JPEGDEC_SW_PORT_OUT].def;
+  jpegdec_sw_frame_t frame;
+  uint32_t size;
+
+  p_comp->reconfig = OMX_TRUE;
+  p_comp->out_configured = OMX_FALSE;
+  p_def->format.image.nFrameWidth = p_hdr->width;
+  p_def->format.image.nFrameHeight = p_hdr->height;
+  p_def->format.image.nStride = p_hdr->width;
+  p_def->format.image.nSliceHeight = p_hdr->height;
+  if (!qomx_jpegdec_sw_get_frame(p_def, NULL, p_hdr->width, p_hdr->height,
+    &frame, &size)) {
+    p_def->nBufferSize = size;
+  }
+  ALOGI("%s:%d] output %dx%d", __func__, __LINE__, p_hdr->width,
+    p_hdr->height);
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_dispatch
+* Parameters: p_comp
+* Return Value : TRUE if something was done, FALSE if the component has
+*   to wait for the client or a worker
+* Description: Pair the oldest jpeg with an output buffer. If the output
+* port does not fit the image it is reconfigured first, once the decodes
+* using the current buffers are done. Called with the component lock held,
+* released around the client callbacks
+==============================================================================*/
+static int qomx_jpegdec_sw_dispatch(qomx_jpegdec_sw_comp_t *p_comp)
+{
+  qomx_jpegdec_sw_port_t *p_in_port = &p_comp->ports[QOMX_JPEGDEC_SW_PORT_IN];
+  qomx_jpegdec_sw_port_t *p_out_port =
+    &p_comp->ports[QOMX_JPEGDEC_SW_PORT_OUT];
+  OMX_BUFFERHEADERTYPE *p_in;
+  qomx_jpegdec_sw_job_t *p_job = NULL;
+  int out_ready;
+  uint32_t i;
+
+  if (p_comp->state_pending || (OMX_StateExecuting != p_comp->state) ||
+    p_comp->reconfig || p_comp->out_enable_pending ||
+    !p_in_port->num_queued || (p_comp->num_active >= p_comp->max_jobs)) {
+    return OMX_FALSE;
+  }
+
+  p_in = p_in_port->p_queue[0];
+  if (!p_comp->head_parsed) {
+    p_comp->head_rc = jpegdec_sw_parse(p_in->pBuffer + p_in->nOffset,
+      p_in->nFilledLen, &p_comp->head_hdr);
+    p_comp->head_parsed = OMX_TRUE;
+  }
+  out_ready = p_out_port->def.bEnabled && p_out_port->def.bPopulated;
+
+  if ((p_comp->head_rc < 0) && (!out_ready || !p_comp->pipeline)) {
+    /* without the pipeline the client waits for the port settings, not
+     * for an output buffer */
+    qomx_jpegdec_sw_dequeue(p_in_port);
+    p_comp->head_parsed = OMX_FALSE;
+    pthread_mutex_unlock(&p_comp->lock);
+    qomx_jpegdec_sw_return_buffer(p_comp, p_in);
+    qomx_jpegdec_sw_event(p_comp, OMX_EventError, OMX_ErrorStreamCorrupt, 0,
+      p_in);
+    pthread_mutex_lock(&p_comp->lock);
+    return OMX_TRUE;
+  }
+
+  if ((p_comp->head_rc >= 0) && (!out_ready ||
+    (!p_comp->pipeline && !p_comp->out_configured) ||
+    (p_out_port->def.format.image.nFrameWidth != p_comp->head_hdr.width) ||
+    (p_out_port->def.format.image.nFrameHeight != p_comp->head_hdr.height))) {
+    if (p_comp->num_active) {
+      /* running decodes still use the current buffers */
+      return OMX_FALSE;
+    }
+    qomx_jpegdec_sw_reconfigure(p_comp, &p_comp->head_hdr);
+    pthread_mutex_unlock(&p_comp->lock);
+    qomx_jpegdec_sw_event(p_comp, OMX_EventPortSettingsChanged,
+      QOMX_JPEGDEC_SW_PORT_OUT, OMX_IndexParamPortDefinition, NULL);
+    pthread_mutex_lock(&p_comp->lock);
+    return OMX_TRUE;
+  }
+
+  if (!p_out_port->num_queued) {
+    return OMX_FALSE;
+  }
+  for (i = 0; i < QOMX_JPEGDEC_SW_MAX_JOBS; i++) {
+    if (QOMX_JPEGDEC_SW_JOB_FREE == p_comp->jobs[i].state) {
+      p_job = &p_comp->jobs[i];
+      break;
+    }
+  }
+  if (NULL == p_job) {
+    return OMX_FALSE;
+  }
+
+  p_job->p_in = qomx_jpegdec_sw_dequeue(p_in_port);
+  p_job->p_out = qomx_jpegdec_sw_dequeue(p_out_port);
+  p_job->hdr = p_comp->head_hdr;
+  p_job->out_def = p_out_port->def;
+  p_job->slice_height = p_comp->slice_height;
+  p_job->rc = (p_comp->head_rc < 0) ? OMX_ErrorStreamCorrupt : OMX_ErrorNone;
+  p_job->seq = p_comp->seq++;
+  p_job->state = QOMX_JPEGDEC_SW_JOB_PENDING;
+  p_comp->num_active++;
+  p_comp->head_parsed = OMX_FALSE;
+  if (!p_comp->pipeline) {
+    p_comp->out_configured = OMX_FALSE;
+  }
+  pthread_cond_broadcast(&p_comp->cond);
+  return OMX_TRUE;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_thread
+* Parameters: data - component
+* Return Value : NULL
+* Description: Component thread, completes the state transitions and port
+* enables and hands the images to the workers. Client callbacks are made
+* with the component lock released
+==============================================================================*/
+static void *qomx_jpegdec_sw_thread(void *data)
+{
+  qomx_jpegdec_sw_comp_t *p_comp = (qomx_jpegdec_sw_comp_t *)data;
+  OMX_BUFFERHEADERTYPE *p_ret[QOMX_JPEGDEC_SW_NUM_PORTS *
+    QOMX_JPEGDEC_SW_MAX_BUFS];
+  OMX_STATETYPE new_state;
+  uint32_t i, num_ret;
+
+  pthread_mutex_lock(&p_comp->lock);
+  while (!p_comp->exit) {
+    if (qomx_jpegdec_sw_transition_ready(p_comp)) {
+      num_ret = 0;
+      if ((OMX_StateIdle == p_comp->target_state) &&
+        ((OMX_StateExecuting == p_comp->state) ||
+        (OMX_StatePause == p_comp->state))) {
+        /* hand back everything still queued */
+        for (i = 0; i < QOMX_JPEGDEC_SW_NUM_PORTS; i++) {
+          while (p_comp->ports[i].num_queued) {
+            p_ret[num_ret] = qomx_jpegdec_sw_dequeue(&p_comp->ports[i]);
+            p_ret[num_ret]->nFilledLen = 0;
+            num_ret++;
+          }
+        }
+        p_comp->head_parsed = OMX_FALSE;
+      }
+      if (OMX_StateExecuting == p_comp->target_state) {
+        qomx_jpegdec_sw_start_workers(p_comp);
+      }
+      p_comp->state = new_state = p_comp->target_state;
+      p_comp->state_pending = OMX_FALSE;
+      p_comp->abort = 0;
+      pthread_mutex_unlock(&p_comp->lock);
+
+      for (i = 0; i < num_ret; i++) {
+        qomx_jpegdec_sw_return_buffer(p_comp, p_ret[i]);
+      }
+      ALOGI("%s:%d] state %d", __func__, __LINE__, new_state);
+      qomx_jpegdec_sw_event(p_comp, OMX_EventCmdComplete,
+        OMX_CommandStateSet, new_state, NULL);
+
+      pthread_mutex_lock(&p_comp->lock);
+      continue;
+    }
+
+    if (p_comp->out_enable_pending &&
+      p_comp->ports[QOMX_JPEGDEC_SW_PORT_OUT].def.bPopulated) {
+      p_comp->out_enable_pending = OMX_FALSE;
+      pthread_mutex_unlock(&p_comp->lock);
+      qomx_jpegdec_sw_event(p_comp, OMX_EventCmdComplete,
+        OMX_CommandPortEnable, QOMX_JPEGDEC_SW_PORT_OUT, NULL);
+      pthread_mutex_lock(&p_comp->lock);
+      continue;
+    }
+
+    if ((OMX_StateExecuting == p_comp->state) &&
+      (p_comp->num_workers < p_comp->max_jobs)) {
+      /* the job count was raised after the workers started */
+      qomx_jpegdec_sw_start_workers(p_comp);
+    }
+
+    if (qomx_jpegdec_sw_dispatch(p_comp)) {
+      continue;
+    }
+
+    pthread_cond_wait(&p_comp->cond, &p_comp->lock);
+  }
+  pthread_mutex_unlock(&p_comp->lock);
+  return NULL;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_get_component_version
+* Parameters: hComp, componentName, componentVersion, specVersion,
+*   componentUUID
+* Return Value : OMX_ERRORTYPE
+* Description: Return the component name and version
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_get_component_version(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_OUT OMX_STRING componentName,
+  OMX_OUT OMX_VERSIONTYPE* componentVersion,
+  OMX_OUT OMX_VERSIONTYPE* specVersion,
+  OMX_OUT OMX_UUIDTYPE* componentUUID)
+{
+  (void)componentUUID;
+  if (!qomx_jpegdec_sw_get_comp(hComp) || !componentName ||
+    !componentVersion || !specVersion) {
+    return OMX_ErrorBadParameter;
+  }
+  snprintf(componentName, OMX_MAX_STRINGNAME_SIZE, "%s", QOMX_JPEGDEC_SW_NAME);
+  componentVersion->nVersion = QOMX_JPEGDEC_SW_VERSION;
+  specVersion->nVersion = OMX_VERSION;
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_send_command
+* Parameters: hComp, Cmd, nParam1, pCmdData
+* Return Value : OMX_ERRORTYPE
+* Description: State changes complete from the component thread. Port
+* disable completes before the call returns, so does port enable unless
+* the output port still has to be populated outside the loaded state
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_send_command(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_COMMANDTYPE Cmd,
+  OMX_IN OMX_U32 nParam1,
+  OMX_IN OMX_PTR pCmdData)
+{
+  qomx_jpegdec_sw_comp_t *p_comp = qomx_jpegdec_sw_get_comp(hComp);
+  OMX_STATETYPE state = (OMX_STATETYPE)nParam1;
+  OMX_ERRORTYPE rc = OMX_ErrorNone;
+  uint8_t done[QOMX_JPEGDEC_SW_NUM_PORTS];
+  qomx_jpegdec_sw_port_t *p_port;
+  uint32_t i;
+
+  (void)pCmdData;
+  if (NULL == p_comp) {
+    return OMX_ErrorBadParameter;
+  }
+
+  switch (Cmd) {
+  case OMX_CommandStateSet:
+    pthread_mutex_lock(&p_comp->lock);
+    if (p_comp->state_pending) {
+      rc = OMX_ErrorIncorrectStateOperation;
+    } else if (state == p_comp->state) {
+      rc = OMX_ErrorSameState;
+    } else if (((OMX_StateLoaded == p_comp->state) &&
+      (OMX_StateIdle != state)) ||
+      ((OMX_StateIdle == p_comp->state) && (OMX_StateLoaded != state) &&
+      (OMX_StateExecuting != state) && (OMX_StatePause != state)) ||
+      (((OMX_StateExecuting == p_comp->state) ||
+      (OMX_StatePause == p_comp->state)) && (OMX_StateIdle != state) &&
+      (OMX_StateExecuting != state) && (OMX_StatePause != state))) {
+      rc = OMX_ErrorIncorrectStateTransition;
+    } else {
+      p_comp->target_state = state;
+      p_comp->state_pending = OMX_TRUE;
+      if (OMX_StateIdle == state) {
+        p_comp->abort = 1;
+      }
+      pthread_cond_broadcast(&p_comp->cond);
+    }
+    pthread_mutex_unlock(&p_comp->lock);
+    break;
+  case OMX_CommandPortEnable:
+  case OMX_CommandPortDisable:
+    if ((OMX_ALL != nParam1) && (nParam1 >= QOMX_JPEGDEC_SW_NUM_PORTS)) {
+      return OMX_ErrorBadPortIndex;
+    }
+    pthread_mutex_lock(&p_comp->lock);
+    for (i = 0; i < QOMX_JPEGDEC_SW_NUM_PORTS; i++) {
+      done[i] = OMX_FALSE;
+      if ((OMX_ALL != nParam1) && (i != nParam1)) {
+        continue;
+      }
+      p_port = &p_comp->ports[i];
+      done[i] = OMX_TRUE;
+      if (OMX_CommandPortDisable == Cmd) {
+        p_port->def.bEnabled = OMX_FALSE;
+        if (QOMX_JPEGDEC_SW_PORT_OUT == i) {
+          p_comp->out_enable_pending = OMX_FALSE;
+        }
+        continue;
+      }
+      p_port->def.bEnabled = OMX_TRUE;
+      if (QOMX_JPEGDEC_SW_PORT_OUT == i) {
+        /* the client has taken the new settings */
+        p_comp->reconfig = OMX_FALSE;
+        p_comp->out_configured = OMX_TRUE;
+        if ((OMX_StateLoaded != p_comp->state) && !p_port->def.bPopulated) {
+          p_comp->out_enable_pending = OMX_TRUE;
+          done[i] = OMX_FALSE;
+        }
+      }
+    }
+    pthread_cond_broadcast(&p_comp->cond);
+    pthread_mutex_unlock(&p_comp->lock);
+    for (i = 0; i < QOMX_JPEGDEC_SW_NUM_PORTS; i++) {
+      if (done[i]) {
+        qomx_jpegdec_sw_event(p_comp, OMX_EventCmdComplete, Cmd, i, NULL);
+      }
+    }
+    break;
+  default:
+    rc = OMX_ErrorNotImplemented;
+    break;
+  }
+  if (OMX_ErrorNone != rc) {
+    ALOGE("%s:%d] cmd %d param %d failed %d", __func__, __LINE__, Cmd,
+      (int)nParam1, rc);
+  }
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_default_jobs
+* Parameters: None
+* Return Value : number of concurrent decodes
+* Description: persist.camera.jpeg.swdec.threads if set, otherwise one
+* decode per core up to QOMX_JPEGDEC_SW_DEFAULT_JOBS
+==============================================================================*/
+static uint32_t qomx_jpegdec_sw_default_jobs(void)
+{
+  char prop[PROPERTY_VALUE_MAX];
+  long jobs;
+
+  property_get("persist.camera.jpeg.swdec.threads", prop, "0");
+  jobs = atoi(prop);
+  if (jobs <= 0) {
+    jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs > QOMX_JPEGDEC_SW_DEFAULT_JOBS) {
+      jobs = QOMX_JPEGDEC_SW_DEFAULT_JOBS;
+    }
+  }
+  if (jobs < 1) {
+    jobs = 1;
+  }
+  return (jobs > QOMX_JPEGDEC_SW_MAX_JOBS) ? QOMX_JPEGDEC_SW_MAX_JOBS :
+    (uint32_t)jobs;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_set
+* Parameters: p_comp, index, p_data
+* Return Value : OMX_ERRORTYPE
+* Description: Common handler for SetParameter and SetConfig
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_set(qomx_jpegdec_sw_comp_t *p_comp,
+  int index, OMX_PTR p_data)
+{
+  OMX_PARAM_PORTDEFINITIONTYPE *p_def;
+  QOMX_JPEG_DECODE_PIPELINE *p_pipeline;
+
+  switch (index) {
+  case OMX_IndexParamPortDefinition:
+    p_def = (OMX_PARAM_PORTDEFINITIONTYPE *)p_data;
+    if (p_def->nPortIndex >= QOMX_JPEGDEC_SW_NUM_PORTS) {
+      return OMX_ErrorBadPortIndex;
+    }
+    p_comp->ports[p_def->nPortIndex].def.format = p_def->format;
+    p_comp->ports[p_def->nPortIndex].def.nBufferCountActual =
+      p_def->nBufferCountActual;
+    p_comp->ports[p_def->nPortIndex].def.nBufferSize = p_def->nBufferSize;
+    break;
+  case QOMX_IMAGE_EXT_DECODE_PIPELINE:
+    p_pipeline = (QOMX_JPEG_DECODE_PIPELINE *)p_data;
+    p_comp->pipeline = OMX_TRUE;
+    p_comp->max_jobs = p_pipeline->nMaxJobs ? p_pipeline->nMaxJobs :
+      qomx_jpegdec_sw_default_jobs();
+    if (p_comp->max_jobs > QOMX_JPEGDEC_SW_MAX_JOBS) {
+      p_comp->max_jobs = QOMX_JPEGDEC_SW_MAX_JOBS;
+    }
+    p_comp->slice_height = p_pipeline->nSliceHeight;
+    pthread_cond_broadcast(&p_comp->cond);
+    break;
+  default:
+    ALOGE("%s:%d] unsupported index %x", __func__, __LINE__, index);
+    return OMX_ErrorUnsupportedIndex;
+  }
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_set_parameter
+* Parameters: hComp, nIndex, pData
+* Return Value : OMX_ERRORTYPE
+* Description: Set a parameter
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_set_parameter(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_INDEXTYPE nIndex,
+  OMX_IN OMX_PTR pData)
+{
+  qomx_jpegdec_sw_comp_t *p_comp = qomx_jpegdec_sw_get_comp(hComp);
+  OMX_ERRORTYPE rc;
+
+  if (!p_comp || !pData) {
+    return OMX_ErrorBadParameter;
+  }
+  pthread_mutex_lock(&p_comp->lock);
+  rc = qomx_jpegdec_sw_set(p_comp, (int)nIndex, pData);
+  pthread_mutex_unlock(&p_comp->lock);
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_set_config
+* Parameters: hComp, nIndex, pConfig
+* Return Value : OMX_ERRORTYPE
+* Description: Set a configuration
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_set_config(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_INDEXTYPE nIndex,
+  OMX_IN OMX_PTR pConfig)
+{
+  return qomx_jpegdec_sw_set_parameter(hComp, nIndex, pConfig);
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_get_parameter
+* Parameters: hComp, nParamIndex, pComponentParameterStructure
+* Return Value : OMX_ERRORTYPE
+* Description: Get a port definition or the pipeline settings in effect
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_get_parameter(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_INDEXTYPE nParamIndex,
+  OMX_INOUT OMX_PTR pComponentParameterStructure)
+{
+  qomx_jpegdec_sw_comp_t *p_comp = qomx_jpegdec_sw_get_comp(hComp);
+  OMX_PARAM_PORTDEFINITIONTYPE *p_def;
+  QOMX_JPEG_DECODE_PIPELINE *p_pipeline;
+
+  if (!p_comp || !pComponentParameterStructure) {
+    return OMX_ErrorBadParameter;
+  }
+  if (QOMX_IMAGE_EXT_DECODE_PIPELINE == (int)nParamIndex) {
+    p_pipeline = (QOMX_JPEG_DECODE_PIPELINE *)pComponentParameterStructure;
+    pthread_mutex_lock(&p_comp->lock);
+    p_pipeline->nMaxJobs = p_comp->max_jobs;
+    p_pipeline->nSliceHeight = p_comp->slice_height;
+    pthread_mutex_unlock(&p_comp->lock);
+    return OMX_ErrorNone;
+  }
+  if (OMX_IndexParamPortDefinition != nParamIndex) {
+    return OMX_ErrorUnsupportedIndex;
+  }
+  p_def = (OMX_PARAM_PORTDEFINITIONTYPE *)pComponentParameterStructure;
+  if (p_def->nPortIndex >= QOMX_JPEGDEC_SW_NUM_PORTS) {
+    return OMX_ErrorBadPortIndex;
+  }
+  pthread_mutex_lock(&p_comp->lock);
+  *p_def = p_comp->ports[p_def->nPortIndex].def;
+  pthread_mutex_unlock(&p_comp->lock);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_get_config
+* Parameters: hComp, nIndex, pComponentConfigStructure
+* Return Value : OMX_ERRORTYPE
+* Description: No configuration is readable
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_get_config(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_INDEXTYPE nIndex,
+  OMX_INOUT OMX_PTR pComponentConfigStructure)
+{
+  (void)hComp;
+  (void)nIndex;
+  (void)pComponentConfigStructure;
+  return OMX_ErrorUnsupportedIndex;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_get_extension_index
+* Parameters: hComp, cParameterName, pIndexType
+* Return Value : OMX_ERRORTYPE
+* Description: Map an extension name to its index
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_get_extension_index(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_STRING cParameterName,
+  OMX_OUT OMX_INDEXTYPE* pIndexType)
+{
+  uint32_t i;
+
+  if (!qomx_jpegdec_sw_get_comp(hComp) || !cParameterName || !pIndexType) {
+    return OMX_ErrorBadParameter;
+  }
+  for (i = 0; i < sizeof(g_extensions) / sizeof(g_extensions[0]); i++) {
+    if (!strcmp(cParameterName, g_extensions[i].name)) {
+      *pIndexType = (OMX_INDEXTYPE)g_extensions[i].index;
+      return OMX_ErrorNone;
+    }
+  }
+  return OMX_ErrorUnsupportedIndex;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_get_state
+* Parameters: hComp, pState
+* Return Value : OMX_ERRORTYPE
+* Description: Get the current state
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_get_state(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_OUT OMX_STATETYPE* pState)
+{
+  qomx_jpegdec_sw_comp_t *p_comp = qomx_jpegdec_sw_get_comp(hComp);
+
+  if (!p_comp || !pState) {
+    return OMX_ErrorBadParameter;
+  }
+  pthread_mutex_lock(&p_comp->lock);
+  *pState = p_comp->state;
+  pthread_mutex_unlock(&p_comp->lock);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_use_buffer
+* Parameters: hComp, ppBufferHdr, nPortIndex, pAppPrivate, nSizeBytes,
+*   pBuffer
+* Return Value : OMX_ERRORTYPE
+* Description: Register a client buffer while moving from loaded to idle,
+* or while populating a port that was enabled later. A buffer registered
+* again on the same port gets its existing header back
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_use_buffer(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_INOUT OMX_BUFFERHEADERTYPE** ppBufferHdr,
+  OMX_IN OMX_U32 nPortIndex,
+  OMX_IN OMX_PTR pAppPrivate,
+  OMX_IN OMX_U32 nSizeBytes,
+  OMX_IN OMX_U8* pBuffer)
+{
+  qomx_jpegdec_sw_comp_t *p_comp = qomx_jpegdec_sw_get_comp(hComp);
+  qomx_jpegdec_sw_port_t *p_port;
+  OMX_BUFFERHEADERTYPE *p_buf = NULL;
+  OMX_ERRORTYPE rc = OMX_ErrorNone;
+  uint32_t i;
+
+  if (!p_comp || !ppBufferHdr || !pBuffer) {
+    return OMX_ErrorBadParameter;
+  }
+  if (nPortIndex >= QOMX_JPEGDEC_SW_NUM_PORTS) {
+    return OMX_ErrorBadPortIndex;
+  }
+
+  pthread_mutex_lock(&p_comp->lock);
+  p_port = &p_comp->ports[nPortIndex];
+  for (i = 0; i < p_port->num_bufs; i++) {
+    if (p_port->p_bufs[i]->pBuffer == pBuffer) {
+      p_buf = p_port->p_bufs[i];
+      break;
+    }
+  }
+  if (p_buf) {
+    p_buf->nAllocLen = nSizeBytes;
+    p_buf->pAppPrivate = pAppPrivate;
+    *ppBufferHdr = p_buf;
+  } else if (((OMX_StateLoaded == p_comp->state) && !p_comp->state_pending) ||
+    ((OMX_StateLoaded != p_comp->state) && p_port->def.bPopulated)) {
+    rc = OMX_ErrorIncorrectStateOperation;
+  } else if (p_port->num_bufs >= QOMX_JPEGDEC_SW_MAX_BUFS) {
+    rc = OMX_ErrorInsufficientResources;
+  } else if (NULL == (p_buf = calloc(1, sizeof(*p_buf)))) {
+    rc = OMX_ErrorInsufficientResources;
+  } else {
+    p_buf->nSize = sizeof(*p_buf);
+    p_buf->nVersion.nVersion = OMX_VERSION;
+    p_buf->pBuffer = pBuffer;
+    p_buf->nAllocLen = nSizeBytes;
+    p_buf->pAppPrivate = pAppPrivate;
+    if (QOMX_JPEGDEC_SW_PORT_OUT == nPortIndex) {
+      p_buf->nOutputPortIndex = nPortIndex;
+      p_buf->nInputPortIndex = OMX_ALL;
+    } else {
+      p_buf->nInputPortIndex = nPortIndex;
+      p_buf->nOutputPortIndex = OMX_ALL;
+    }
+    p_port->p_bufs[p_port->num_bufs++] = p_buf;
+    p_port->def.bPopulated = (p_port->num_bufs >=
+      p_port->def.nBufferCountActual) ? OMX_TRUE : OMX_FALSE;
+    *ppBufferHdr = p_buf;
+    pthread_cond_broadcast(&p_comp->cond);
+  }
+  pthread_mutex_unlock(&p_comp->lock);
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_free_buffer
+* Parameters: hComp, nPortIndex, pBuffer
+* Return Value : OMX_ERRORTYPE
+* Description: Release a buffer header
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_free_buffer(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_U32 nPortIndex,
+  OMX_IN OMX_BUFFERHEADERTYPE* pBuffer)
+{
+  qomx_jpegdec_sw_comp_t *p_comp = qomx_jpegdec_sw_get_comp(hComp);
+  qomx_jpegdec_sw_port_t *p_port;
+  uint32_t i;
+
+  if (!p_comp || !pBuffer) {
+    return OMX_ErrorBadParameter;
+  }
+  if (nPortIndex >= QOMX_JPEGDEC_SW_NUM_PORTS) {
+    return OMX_ErrorBadPortIndex;
+  }
+
+  pthread_mutex_lock(&p_comp->lock);
+  p_port = &p_comp->ports[nPortIndex];
+  for (i = 0; i < p_port->num_bufs; i++) {
+    if (p_port->p_bufs[i] == pBuffer) {
+      break;
+    }
+  }
+  if (i == p_port->num_bufs) {
+    pthread_mutex_unlock(&p_comp->lock);
+    return OMX_ErrorBadParameter;
+  }
+  p_port->num_bufs--;
+  memmove(&p_port->p_bufs[i], &p_port->p_bufs[i + 1],
+    (p_port->num_bufs - i) * sizeof(p_port->p_bufs[0]));
+  for (i = 0; i < p_port->num_queued; i++) {
+    if (p_port->p_queue[i] == pBuffer) {
+      p_port->num_queued--;
+      memmove(&p_port->p_queue[i], &p_port->p_queue[i + 1],
+        (p_port->num_queued - i) * sizeof(p_port->p_queue[0]));
+      break;
+    }
+  }
+  p_port->def.bPopulated = OMX_FALSE;
+  free(pBuffer);
+  pthread_cond_broadcast(&p_comp->cond);
+  pthread_mutex_unlock(&p_comp->lock);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_queue_buffer
+* Parameters: hComp, pBuffer, nPortIndex
+* Return Value : OMX_ERRORTYPE
+* Description: Queue a buffer on a port for the component thread
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_queue_buffer(OMX_HANDLETYPE hComp,
+  OMX_BUFFERHEADERTYPE *pBuffer, OMX_U32 nPortIndex)
+{
+  qomx_jpegdec_sw_comp_t *p_comp = qomx_jpegdec_sw_get_comp(hComp);
+  qomx_jpegdec_sw_port_t *p_port;
+  OMX_ERRORTYPE rc = OMX_ErrorNone;
+
+  if (!p_comp || !pBuffer) {
+    return OMX_ErrorBadParameter;
+  }
+  if (nPortIndex >= QOMX_JPEGDEC_SW_NUM_PORTS) {
+    return OMX_ErrorBadPortIndex;
+  }
+
+  pthread_mutex_lock(&p_comp->lock);
+  p_port = &p_comp->ports[nPortIndex];
+  if ((OMX_StateExecuting != p_comp->state) &&
+    (OMX_StatePause != p_comp->state)) {
+    rc = OMX_ErrorIncorrectStateOperation;
+  } else if (p_port->num_queued >= QOMX_JPEGDEC_SW_MAX_BUFS) {
+    rc = OMX_ErrorInsufficientResources;
+  } else {
+    if (QOMX_JPEGDEC_SW_PORT_OUT == nPortIndex) {
+      pBuffer->nFilledLen = 0;
+      pBuffer->nFlags = 0;
+    } else if (!pBuffer->nFilledLen) {
+      /* clients of the hw decoder pass the whole buffer */
+      pBuffer->nFilledLen = pBuffer->nAllocLen - pBuffer->nOffset;
+    }
+    p_port->p_queue[p_port->num_queued++] = pBuffer;
+    pthread_cond_broadcast(&p_comp->cond);
+  }
+  pthread_mutex_unlock(&p_comp->lock);
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_empty_this_buffer
+* Parameters: hComp, pBuffer
+* Return Value : OMX_ERRORTYPE
+* Description: Queue a jpeg buffer
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_empty_this_buffer(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_BUFFERHEADERTYPE* pBuffer)
+{
+  return qomx_jpegdec_sw_queue_buffer(hComp, pBuffer,
+    QOMX_JPEGDEC_SW_PORT_IN);
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_fill_this_buffer
+* Parameters: hComp, pBuffer
+* Return Value : OMX_ERRORTYPE
+* Description: Queue an output buffer
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_fill_this_buffer(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_BUFFERHEADERTYPE* pBuffer)
+{
+  return qomx_jpegdec_sw_queue_buffer(hComp, pBuffer,
+    QOMX_JPEGDEC_SW_PORT_OUT);
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_set_callbacks
+* Parameters: hComp, pCallbacks, pAppData
+* Return Value : OMX_ERRORTYPE
+* Description: Set the client callbacks
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_set_callbacks(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_CALLBACKTYPE* pCallbacks,
+  OMX_IN OMX_PTR pAppData)
+{
+  qomx_jpegdec_sw_comp_t *p_comp = qomx_jpegdec_sw_get_comp(hComp);
+
+  if (!p_comp || !pCallbacks) {
+    return OMX_ErrorBadParameter;
+  }
+  pthread_mutex_lock(&p_comp->lock);
+  p_comp->callbacks = *pCallbacks;
+  p_comp->app_data = pAppData;
+  pthread_mutex_unlock(&p_comp->lock);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_deinit
+* Parameters: hComp
+* Return Value : OMX_ERRORTYPE
+* Description: Stop the threads and free the component
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegdec_sw_deinit(OMX_IN OMX_HANDLETYPE hComp)
+{
+  qomx_jpegdec_sw_comp_t *p_comp = qomx_jpegdec_sw_get_comp(hComp);
+  uint32_t i, j;
+
+  if (NULL == p_comp) {
+    return OMX_ErrorBadParameter;
+  }
+  pthread_mutex_lock(&p_comp->lock);
+  p_comp->exit = OMX_TRUE;
+  p_comp->abort = 1;
+  pthread_cond_broadcast(&p_comp->cond);
+  pthread_mutex_unlock(&p_comp->lock);
+  pthread_join(p_comp->thread, NULL);
+  for (i = 0; i < p_comp->num_workers; i++) {
+    pthread_join(p_comp->workers[i], NULL);
+  }
+
+  for (i = 0; i < QOMX_JPEGDEC_SW_NUM_PORTS; i++) {
+    for (j = 0; j < p_comp->ports[i].num_bufs; j++) {
+      free(p_comp->ports[i].p_bufs[j]);
+    }
+  }
+  pthread_cond_destroy(&p_comp->cond);
+  pthread_mutex_destroy(&p_comp->lock);
+
+  ((OMX_COMPONENTTYPE *)hComp)->pComponentPrivate = NULL;
+  free(p_comp);
+  free(hComp);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegdec_sw_init_port
+* Parameters: p_port, index
+* Return Value : None
+* Description: Set the default port definition. The output port starts
+* disabled, it is configured once the first image is parsed
+==============================================================================*/
+static void qomx_jpegdec_sw_init_port(qomx_jpegdec_sw_port_t *p_port,
+  uint32_t index)
+{
+  OMX_PARAM_PORTDEFINITIONTYPE *p_def = &p_port->def;
+
+  p_def->nSize = sizeof(*p_def);
+  p_def->nVersion.nVersion = OMX_VERSION;
+  p_def->nPortIndex = index;
+  p_def->eDir = (QOMX_JPEGDEC_SW_PORT_OUT == index) ? OMX_DirOutput :
+    OMX_DirInput;
+  p_def->nBufferCountActual = 1;
+  p_def->nBufferCountMin = 1;
+  p_def->bEnabled = (QOMX_JPEGDEC_SW_PORT_OUT == index) ? OMX_FALSE :
+    OMX_TRUE;
+  p_def->eDomain = OMX_PortDomainImage;
+  p_def->format.image.eCompressionFormat =
+    (QOMX_JPEGDEC_SW_PORT_IN == index) ? OMX_IMAGE_CodingJPEG :
+    OMX_IMAGE_CodingUnused;
+  p_def->format.image.eColorFormat =
+    (OMX_COLOR_FORMATTYPE)OMX_QCOM_IMG_COLOR_FormatYVU420SemiPlanar;
+}
+
+/*==============================================================================
+* Function : getInstance
+* Parameters: None
+* Return Value : component object, NULL on failure
+* Description: Entry point used by the OMX core, allocates the component
+* and starts its thread. The workers start with the first move to
+* executing
+==============================================================================*/
+void *getInstance(void)
+{
+  qomx_jpegdec_sw_comp_t *p_comp;
+  uint32_t i;
+
+  p_comp = calloc(1, sizeof(*p_comp));
+  if (NULL == p_comp) {
+    ALOGE("%s:%d] no memory", __func__, __LINE__);
+    return NULL;
+  }
+  p_comp->state = p_comp->target_state = OMX_StateLoaded;
+  for (i = 0; i < QOMX_JPEGDEC_SW_NUM_PORTS; i++) {
+    qomx_jpegdec_sw_init_port(&p_comp->ports[i], i);
+  }
+  p_comp->max_jobs = qomx_jpegdec_sw_default_jobs();
+  pthread_mutex_init(&p_comp->lock, NULL);
+  pthread_cond_init(&p_comp->cond, NULL);
+  if (pthread_create(&p_comp->thread, NULL, qomx_jpegdec_sw_thread,
+    p_comp)) {
+    ALOGE("%s:%d] cannot create thread", __func__, __LINE__);
+    pthread_cond_destroy(&p_comp->cond);
+    pthread_mutex_destroy(&p_comp->lock);
+    free(p_comp);
+    return NULL;
+  }
+  return p_comp;
+}
+
+/*==============================================================================
+* Function : create_component_fns
+* Parameters: p_obj - object returned by getInstance
+* Return Value : OMX component handle, NULL on failure
+* Description: Entry point used by the OMX core, fills in the component
+* function table
+==============================================================================*/
+OMX_COMPONENTTYPE *create_component_fns(OMX_PTR p_obj)
+{
+  qomx_jpegdec_sw_comp_t *p_comp = (qomx_jpegdec_sw_comp_t *)p_obj;
+  OMX_COMPONENTTYPE *p_handle;
+
+  if (NULL == p_comp) {
+    return NULL;
+  }
+  p_handle = calloc(1, sizeof(*p_handle));
+  if (NULL == p_handle) {
+    ALOGE("%s:%d] no memory", __func__, __LINE__);
+    return NULL;
+  }
+  p_handle->nSize = sizeof(*p_handle);
+  p_handle->nVersion.nVersion = OMX_VERSION;
+  p_handle->pComponentPrivate = p_comp;
+  p_handle->GetComponentVersion = qomx_jpegdec_sw_get_component_version;
+  p_handle->SendCommand = qomx_jpegdec_sw_send_command;
+  p_handle->GetParameter = qomx_jpegdec_sw_get_parameter;
+  p_handle->SetParameter = qomx_jpegdec_sw_set_parameter;
+  p_handle->GetConfig = qomx_jpegdec_sw_get_config;
+  p_handle->SetConfig = qomx_jpegdec_sw_set_config;
+  p_handle->GetExtensionIndex = qomx_jpegdec_sw_get_extension_index;
+  p_handle->GetState = qomx_jpegdec_sw_get_state;
+  p_handle->UseBuffer = qomx_jpegdec_sw_use_buffer;
+  p_handle->FreeBuffer = qomx_jpegdec_sw_free_buffer;
+  p_handle->EmptyThisBuffer = qomx_jpegdec_sw_empty_this_buffer;
+  p_handle->FillThisBuffer = qomx_jpegdec_sw_fill_this_buffer;
+  p_handle->SetCallbacks = qomx_jpegdec_sw_set_callbacks;
+  p_handle->ComponentDeInit = qomx_jpegdec_sw_deinit;
+  p_comp->p_comp = p_handle;
+  return p_handle;
+}
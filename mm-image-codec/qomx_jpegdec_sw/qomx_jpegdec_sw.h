@@ -0,0 +1,164 @@
+/*Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+
+
+#ifndef QOMX_JPEGDEC_SW_H
+#define QOMX_JPEGDEC_SW_H
+
+#include <pthread.h>
+#include "OMX_Component.h"
+#include "QOMX_JpegExtensions.h"
+#include "qomx_jpegdec_sw_core.h"
+
+#define QOMX_JPEGDEC_SW_NAME "OMX.qcom.image.jpeg.decoder_sw"
+
+/* Port indices, same layout as the hardware decoder */
+#define QOMX_JPEGDEC_SW_PORT_IN 0
+#define QOMX_JPEGDEC_SW_PORT_OUT 1
+#define QOMX_JPEGDEC_SW_NUM_PORTS 2
+
+#define QOMX_JPEGDEC_SW_MAX_BUFS 32
+
+/* Upper bound of concurrent decodes, one worker thread each */
+#define QOMX_JPEGDEC_SW_MAX_JOBS 8
+
+/* Default number of concurrent decodes when the cores allow it */
+#define QOMX_JPEGDEC_SW_DEFAULT_JOBS 4
+
+/** qomx_jpegdec_sw_port_t: Port state
+*    @def: port definition
+*    @p_bufs: buffer headers allocated on the port
+*    @num_bufs: number of buffer headers
+*    @p_queue: buffers queued by the client, oldest first
+*    @num_queued: number of queued buffers
+**/
+typedef struct {
+  OMX_PARAM_PORTDEFINITIONTYPE def;
+  OMX_BUFFERHEADERTYPE *p_bufs[QOMX_JPEGDEC_SW_MAX_BUFS];
+  uint32_t num_bufs;
+  OMX_BUFFERHEADERTYPE *p_queue[QOMX_JPEGDEC_SW_MAX_BUFS];
+  uint32_t num_queued;
+} qomx_jpegdec_sw_port_t;
+
+/** qomx_jpegdec_sw_job_state_t: Decode slot state
+*    @QOMX_JPEGDEC_SW_JOB_FREE: slot is unused
+*    @QOMX_JPEGDEC_SW_JOB_PENDING: buffers paired, waiting for a worker
+*    @QOMX_JPEGDEC_SW_JOB_RUNNING: a worker is decoding
+**/
+typedef enum {
+  QOMX_JPEGDEC_SW_JOB_FREE,
+  QOMX_JPEGDEC_SW_JOB_PENDING,
+  QOMX_JPEGDEC_SW_JOB_RUNNING,
+} qomx_jpegdec_sw_job_state_t;
+
+/** qomx_jpegdec_sw_job_t: One decode, the settings are copied from the
+*   component when the buffers are paired
+*    @state: slot state
+*    @seq: pairing order, workers pick the oldest pending job
+*    @p_in: jpeg buffer
+*    @p_out: output buffer
+*    @hdr: parsed headers of the jpeg
+*    @out_def: output port definition
+*    @slice_height: rows between slice events, 0 for none
+*    @rc: OMX_ErrorNone, or the error to report without decoding
+**/
+typedef struct {
+  qomx_jpegdec_sw_job_state_t state;
+  uint32_t seq;
+  OMX_BUFFERHEADERTYPE *p_in;
+  OMX_BUFFERHEADERTYPE *p_out;
+  jpegdec_sw_header_t hdr;
+  OMX_PARAM_PORTDEFINITIONTYPE out_def;
+  uint32_t slice_height;
+  OMX_ERRORTYPE rc;
+} qomx_jpegdec_sw_job_t;
+
+/** qomx_jpegdec_sw_comp_t: Software decoder component
+*    @p_comp: OMX component handle
+*    @callbacks: client callbacks
+*    @app_data: client data passed back in the callbacks
+*    @state: current state
+*    @target_state: state requested by the client
+*    @state_pending: a state transition is in progress
+*    @ports: input and output ports
+*    @pipeline: the client set QOMX_IMAGE_EXT_DECODE_PIPELINE. Without it
+*           every image is announced with PortSettingsChanged like the
+*           hardware decoder does
+*    @max_jobs: concurrent decodes
+*    @slice_height: rows between slice events, 0 for none
+*    @reconfig: PortSettingsChanged was sent, the output port is
+*           re-enabled by the client
+*    @out_enable_pending: output port enable completes once populated
+*    @out_configured: output port matches the next image, legacy mode
+*    @head_hdr: parsed headers of the oldest queued jpeg
+*    @head_rc: parse result of head_hdr
+*    @head_parsed: head_hdr is valid
+*    @jobs: decode slots
+*    @num_active: slots in use
+*    @seq: pairing counter
+*    @workers: worker threads
+*    @num_workers: number of worker threads
+*    @thread: component thread
+*    @lock: component lock
+*    @cond: signalled on every change the threads may act on
+*    @exit: the threads should exit
+*    @abort: stop the decodes in progress
+**/
+typedef struct {
+  OMX_COMPONENTTYPE *p_comp;
+  OMX_CALLBACKTYPE callbacks;
+  OMX_PTR app_data;
+  OMX_STATETYPE state;
+  OMX_STATETYPE target_state;
+  uint8_t state_pending;
+  qomx_jpegdec_sw_port_t ports[QOMX_JPEGDEC_SW_NUM_PORTS];
+  uint8_t pipeline;
+  uint32_t max_jobs;
+  uint32_t slice_height;
+  uint8_t reconfig;
+  uint8_t out_enable_pending;
+  uint8_t out_configured;
+  jpegdec_sw_header_t head_hdr;
+  int head_rc;
+  uint8_t head_parsed;
+  qomx_jpegdec_sw_job_t jobs[QOMX_JPEGDEC_SW_MAX_JOBS];
+  uint32_t num_active;
+  uint32_t seq;
+  pthread_t workers[QOMX_JPEGDEC_SW_MAX_JOBS];
+  uint32_t num_workers;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int exit;
+  volatile int abort;
+} qomx_jpegdec_sw_comp_t;
+
+void *getInstance(void);
+OMX_COMPONENTTYPE *create_component_fns(OMX_PTR p_obj);
+
+#endif
@@ -0,0 +1,964 @@
+/*Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+
+
+#define LOG_TAG "qomx_jpegdec_sw"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include "qomx_jpegdec_sw_core.h"
+
+#define DCTSIZE 8
+#define DCTSIZE2 64
+
+/* Codes up to this length are decoded with a single table lookup */
+#define HUFF_LOOKAHEAD 9
+
+/* Bits kept available in the bit buffer before decoding a symbol,
+ * a 16 bit code followed by up to 11 extra bits */
+#define BITS_MIN 32
+
+/* Markers */
+#define M_SOI 0xD8
+#define M_EOI 0xD9
+#define M_SOF0 0xC0
+#define M_SOF1 0xC1
+#define M_DHT 0xC4
+#define M_DAC 0xCC
+#define M_DQT 0xDB
+#define M_DRI 0xDD
+#define M_SOS 0xDA
+#define M_RST0 0xD0
+#define M_RST7 0xD7
+#define M_TEM 0x01
+
+/** jpegdec_sw_huff_t: Derived huffman decoding table
+*    @lookup: (length << 8) | symbol for every HUFF_LOOKAHEAD bit
+*           prefix, 0 if the code is longer
+*    @maxcode: largest code of each length, -1 if there is none
+*    @valoffset: index in vals of the code 0 of each length
+*    @vals: symbols in code order
+**/
+typedef struct {
+  uint16_t lookup[1 << HUFF_LOOKAHEAD];
+  int32_t maxcode[17];
+  int32_t valoffset[17];
+  uint8_t vals[256];
+} jpegdec_sw_huff_t;
+
+/** jpegdec_sw_bits_t: Entropy coded data reader
+*    @p_cur: next byte to read
+*    @p_end: end of the data
+*    @acc: bit buffer, MSB aligned
+*    @bits: number of valid bits in acc
+*    @marker: a marker was reached, zeros are fed from here on
+**/
+typedef struct {
+  const uint8_t *p_cur;
+  const uint8_t *p_end;
+  uint64_t acc;
+  int32_t bits;
+  int marker;
+} jpegdec_sw_bits_t;
+
+/** jpegdec_sw_ctx: Decoder state
+*    @dc: derived DC tables
+*    @ac: derived AC tables
+*    @qf: dequantization multipliers with the IDCT scaling folded in
+*    @p_planes: component samples of one MCU row
+*    @planes_size: allocated size of p_planes
+**/
+struct jpegdec_sw_ctx {
+  jpegdec_sw_huff_t dc[4];
+  jpegdec_sw_huff_t ac[4];
+  float qf[4][DCTSIZE2];
+  uint8_t *p_planes;
+  uint32_t planes_size;
+};
+
+/* natural order index of each zigzag position */
+static const uint8_t natural_order[DCTSIZE2] = {
+  0, 1, 8, 16, 9, 2, 3, 10,
+  17, 24, 32, 25, 18, 11, 4, 5,
+  12, 19, 26, 33, 40, 48, 41, 34,
+  27, 20, 13, 6, 7, 14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36,
+  29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46,
+  53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/* AAN scale factors, cos(k*PI/16) * sqrt(2) for k > 0 */
+static const float aan_scale[DCTSIZE] = {
+  1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+  1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+};
+
+/*==============================================================================
+* Function : jpegdec_sw_be16
+* Parameters: p
+* Return Value : big endian 16 bit value at p
+* Description: Read a marker segment field
+==============================================================================*/
+static inline uint32_t jpegdec_sw_be16(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 8) | p[1];
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_parse_dqt
+* Parameters: p_seg, len, p_hdr
+* Return Value : 0 on success, -1 on failure
+* Description: Read the quantization tables of a DQT segment
+==============================================================================*/
+static int jpegdec_sw_parse_dqt(const uint8_t *p_seg, uint32_t len,
+  jpegdec_sw_header_t *p_hdr)
+{
+  uint32_t pq, tq, k, val;
+
+  while (len) {
+    pq = p_seg[0] >> 4;
+    tq = p_seg[0] & 0xF;
+    if ((pq > 1) || (tq > 3) || (len < 1 + DCTSIZE2 * (pq + 1))) {
+      return -1;
+    }
+    p_seg++;
+    for (k = 0; k < DCTSIZE2; k++) {
+      val = pq ? jpegdec_sw_be16(&p_seg[2 * k]) : p_seg[k];
+      p_hdr->qtable[tq][natural_order[k]] = (uint16_t)(val ? val : 1);
+    }
+    p_seg += DCTSIZE2 * (pq + 1);
+    len -= 1 + DCTSIZE2 * (pq + 1);
+    p_hdr->qtable_set |= 1 << tq;
+  }
+  return 0;
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_parse_dht
+* Parameters: p_seg, len, p_hdr
+* Return Value : 0 on success, -1 on failure
+* Description: Read the huffman tables of a DHT segment
+==============================================================================*/
+static int jpegdec_sw_parse_dht(const uint8_t *p_seg, uint32_t len,
+  jpegdec_sw_header_t *p_hdr)
+{
+  uint32_t tc, th, i, count;
+  uint8_t *p_bits, *p_vals;
+
+  while (len) {
+    if (len < 17) {
+      return -1;
+    }
+    tc = p_seg[0] >> 4;
+    th = p_seg[0] & 0xF;
+    if ((tc > 1) || (th > 3)) {
+      return -1;
+    }
+    p_bits = tc ? p_hdr->ac_bits[th] : p_hdr->dc_bits[th];
+    p_vals = tc ? p_hdr->ac_vals[th] : p_hdr->dc_vals[th];
+    p_bits[0] = 0;
+    for (i = 1, count = 0; i <= 16; i++) {
+      p_bits[i] = p_seg[i];
+      count += p_seg[i];
+    }
+    if ((count > 256) || (len < 17 + count)) {
+      return -1;
+    }
+    memcpy(p_vals, &p_seg[17], count);
+    p_seg += 17 + count;
+    len -= 17 + count;
+    p_hdr->huff_set |= 1 << (th + 4 * tc);
+  }
+  return 0;
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_parse_sof
+* Parameters: p_seg, len, p_hdr
+* Return Value : 0 on success, -1 on failure
+* Description: Read the frame header. Only 8 bit images with one or three
+* components and sampling factors of 1 or 2 are supported
+==============================================================================*/
+static int jpegdec_sw_parse_sof(const uint8_t *p_seg, uint32_t len,
+  jpegdec_sw_header_t *p_hdr)
+{
+  jpegdec_sw_comp_t *p_comp;
+  uint32_t i, h_max = 1, v_max = 1;
+
+  if ((len < 6) || (8 != p_seg[0])) {
+    ALOGE("%s:%d] unsupported precision", __func__, __LINE__);
+    return -1;
+  }
+  p_hdr->height = jpegdec_sw_be16(&p_seg[1]);
+  p_hdr->width = jpegdec_sw_be16(&p_seg[3]);
+  p_hdr->num_comps = p_seg[5];
+  if (!p_hdr->width || !p_hdr->height ||
+    ((1 != p_hdr->num_comps) && (3 != p_hdr->num_comps)) ||
+    (len < 6 + 3 * p_hdr->num_comps)) {
+    ALOGE("%s:%d] unsupported frame %dx%d comps %d", __func__, __LINE__,
+      p_hdr->width, p_hdr->height, p_hdr->num_comps);
+    return -1;
+  }
+  for (i = 0; i < p_hdr->num_comps; i++) {
+    p_comp = &p_hdr->comps[i];
+    p_comp->id = p_seg[6 + 3 * i];
+    p_comp->h_samp = p_seg[7 + 3 * i] >> 4;
+    p_comp->v_samp = p_seg[7 + 3 * i] & 0xF;
+    p_comp->tq = p_seg[8 + 3 * i];
+    if ((p_comp->h_samp < 1) || (p_comp->h_samp > 2) ||
+      (p_comp->v_samp < 1) || (p_comp->v_samp > 2) || (p_comp->tq > 3)) {
+      ALOGE("%s:%d] unsupported component %d", __func__, __LINE__, i);
+      return -1;
+    }
+    if (p_comp->h_samp > h_max) {
+      h_max = p_comp->h_samp;
+    }
+    if (p_comp->v_samp > v_max) {
+      v_max = p_comp->v_samp;
+    }
+  }
+  /* a single component scan is not interleaved, one block per MCU */
+  if (1 == p_hdr->num_comps) {
+    p_hdr->comps[0].h_samp = p_hdr->comps[0].v_samp = 1;
+  }
+  return 0;
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_parse_sos
+* Parameters: p_seg, len, p_hdr
+* Return Value : 0 on success, -1 on failure
+* Description: Read the scan header. The scan must hold all the components
+* of a sequential image
+==============================================================================*/
+static int jpegdec_sw_parse_sos(const uint8_t *p_seg, uint32_t len,
+  jpegdec_sw_header_t *p_hdr)
+{
+  jpegdec_sw_comp_t *p_comp;
+  uint32_t i, ns;
+
+  if (!p_hdr->num_comps || (len < 1)) {
+    return -1;
+  }
+  ns = p_seg[0];
+  if ((ns != p_hdr->num_comps) || (len < 4 + 2 * ns)) {
+    ALOGE("%s:%d] unsupported scan with %d components", __func__, __LINE__,
+      ns);
+    return -1;
+  }
+  for (i = 0; i < ns; i++) {
+    /* scan components follow the frame order */
+    p_comp = &p_hdr->comps[i];
+    if (p_seg[1 + 2 * i] != p_comp->id) {
+      return -1;
+    }
+    p_comp->td = p_seg[2 + 2 * i] >> 4;
+    p_comp->ta = p_seg[2 + 2 * i] & 0xF;
+    if ((p_comp->td > 3) || (p_comp->ta > 3) ||
+      !(p_hdr->huff_set & (1 << p_comp->td)) ||
+      !(p_hdr->huff_set & (1 << (p_comp->ta + 4))) ||
+      !(p_hdr->qtable_set & (1 << p_comp->tq))) {
+      ALOGE("%s:%d] missing table for component %d", __func__, __LINE__, i);
+      return -1;
+    }
+  }
+  if ((0 != p_seg[1 + 2 * ns]) || (63 != p_seg[2 + 2 * ns]) ||
+    (0 != p_seg[3 + 2 * ns])) {
+    return -1;
+  }
+  return 0;
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_parse
+* Parameters: p_data, len, p_hdr
+* Return Value : 0 on success, -1 if the image is invalid or not baseline
+* Description: Read the headers up to the first scan
+==============================================================================*/
+int jpegdec_sw_parse(const uint8_t *p_data, uint32_t len,
+  jpegdec_sw_header_t *p_hdr)
+{
+  uint32_t pos = 2, seg_len, marker;
+  int sof_seen = 0;
+  int rc;
+
+  memset(p_hdr, 0, sizeof(*p_hdr));
+  if ((len < 4) || (0xFF != p_data[0]) || (M_SOI != p_data[1])) {
+    ALOGE("%s:%d] not a jpeg", __func__, __LINE__);
+    return -1;
+  }
+
+  while (pos < len) {
+    if (0xFF != p_data[pos]) {
+      ALOGE("%s:%d] marker expected at %d", __func__, __LINE__, pos);
+      return -1;
+    }
+    while ((pos < len) && (0xFF == p_data[pos])) {
+      pos++;
+    }
+    if (pos >= len) {
+      break;
+    }
+    marker = p_data[pos++];
+    if ((M_SOI == marker) || (M_TEM == marker) ||
+      ((marker >= M_RST0) && (marker <= M_RST7))) {
+      continue;
+    }
+    if ((M_EOI == marker) || (pos + 2 > len)) {
+      break;
+    }
+    seg_len = jpegdec_sw_be16(&p_data[pos]);
+    if ((seg_len < 2) || (pos + seg_len > len)) {
+      ALOGE("%s:%d] truncated marker %x", __func__, __LINE__, marker);
+      return -1;
+    }
+
+    rc = 0;
+    switch (marker) {
+    case M_DQT:
+      rc = jpegdec_sw_parse_dqt(&p_data[pos + 2], seg_len - 2, p_hdr);
+      break;
+    case M_DHT:
+      rc = jpegdec_sw_parse_dht(&p_data[pos + 2], seg_len - 2, p_hdr);
+      break;
+    case M_SOF0:
+    case M_SOF1:
+      rc = jpegdec_sw_parse_sof(&p_data[pos + 2], seg_len - 2, p_hdr);
+      sof_seen = 1;
+      break;
+    case M_DRI:
+      rc = (seg_len < 4) ? -1 : 0;
+      if (!rc) {
+        p_hdr->restart_interval = jpegdec_sw_be16(&p_data[pos + 2]);
+      }
+      break;
+    case M_SOS:
+      if (!sof_seen) {
+        return -1;
+      }
+      rc = jpegdec_sw_parse_sos(&p_data[pos + 2], seg_len - 2, p_hdr);
+      if (!rc) {
+        p_hdr->scan_offset = pos + seg_len;
+        return 0;
+      }
+      break;
+    default:
+      /* progressive, lossless, hierarchical and arithmetic coding */
+      if (((marker >= 0xC2) && (marker <= 0xCF) && (M_DHT != marker)) ||
+        (M_DAC == marker)) {
+        ALOGE("%s:%d] unsupported coding %x", __func__, __LINE__, marker);
+        return -1;
+      }
+      /* APPn, COM and anything else is skipped */
+      break;
+    }
+    if (rc < 0) {
+      ALOGE("%s:%d] bad marker %x", __func__, __LINE__, marker);
+      return -1;
+    }
+    pos += seg_len;
+  }
+  ALOGE("%s:%d] no scan found", __func__, __LINE__);
+  return -1;
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_derive_huff
+* Parameters: p_bits, p_vals, p_huff
+* Return Value : 0 on success, -1 if the table is invalid
+* Description: Generate the decoding tables from the BITS/HUFFVAL lists as
+* described in T.81 Annex C and F.2.2.3
+==============================================================================*/
+static int jpegdec_sw_derive_huff(const uint8_t *p_bits,
+  const uint8_t *p_vals, jpegdec_sw_huff_t *p_huff)
+{
+  uint32_t len, i, k = 0, code = 0, fill, first;
+
+  memset(p_huff->lookup, 0, sizeof(p_huff->lookup));
+  for (len = 1; len <= 16; len++) {
+    p_huff->valoffset[len] = (int32_t)k - (int32_t)code;
+    for (i = 0; i < p_bits[len]; i++, k++, code++) {
+      p_huff->vals[k] = p_vals[k];
+      if (len <= HUFF_LOOKAHEAD) {
+        first = code << (HUFF_LOOKAHEAD - len);
+        for (fill = 0; fill < (1u << (HUFF_LOOKAHEAD - len)); fill++) {
+          p_huff->lookup[first + fill] = (uint16_t)((len << 8) | p_vals[k]);
+        }
+      }
+    }
+    p_huff->maxcode[len] = p_bits[len] ? (int32_t)code - 1 : -1;
+    /* the all ones code is reserved */
+    if (code > (1u << len) - (len < 16 ? 0 : 1)) {
+      return -1;
+    }
+    code <<= 1;
+  }
+  return 0;
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_fill_bits
+* Parameters: p_bits
+* Return Value : None
+* Description: Top up the bit buffer, removing the stuffed zero bytes.
+* Once a marker is reached zeros are fed instead
+==============================================================================*/
+static inline void jpegdec_sw_fill_bits(jpegdec_sw_bits_t *p_bits)
+{
+  uint32_t c;
+
+  while (p_bits->bits <= 56) {
+    c = 0;
+    if (!p_bits->marker && (p_bits->p_cur < p_bits->p_end)) {
+      c = *p_bits->p_cur++;
+      if (0xFF == c) {
+        if ((p_bits->p_cur < p_bits->p_end) && (0 == *p_bits->p_cur)) {
+          p_bits->p_cur++;
+        } else {
+          /* leave the reader on the marker */
+          p_bits->p_cur--;
+          p_bits->marker = 1;
+          c = 0;
+        }
+      }
+    }
+    p_bits->acc |= (uint64_t)c << (56 - p_bits->bits);
+    p_bits->bits += 8;
+  }
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_get_bits
+* Parameters: p_bits, n
+* Return Value : next n bits, 1 <= n <= 16
+* Description: Consume n bits, the caller keeps the buffer topped up
+==============================================================================*/
+static inline uint32_t jpegdec_sw_get_bits(jpegdec_sw_bits_t *p_bits,
+  uint32_t n)
+{
+  uint32_t v = (uint32_t)(p_bits->acc >> (64 - n));
+  p_bits->acc <<= n;
+  p_bits->bits -= n;
+  return v;
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_decode_huff
+* Parameters: p_bits, p_huff
+* Return Value : decoded symbol, -1 for an invalid code
+* Description: Decode one huffman coded symbol
+==============================================================================*/
+static inline int jpegdec_sw_decode_huff(jpegdec_sw_bits_t *p_bits,
+  const jpegdec_sw_huff_t *p_huff)
+{
+  uint32_t entry, len;
+  int32_t code;
+
+  if (p_bits->bits < BITS_MIN) {
+    jpegdec_sw_fill_bits(p_bits);
+  }
+  entry = p_huff->lookup[p_bits->acc >> (64 - HUFF_LOOKAHEAD)];
+  if (entry) {
+    p_bits->acc <<= entry >> 8;
+    p_bits->bits -= entry >> 8;
+    return entry & 0xFF;
+  }
+  for (len = HUFF_LOOKAHEAD + 1; len <= 16; len++) {
+    code = (int32_t)(p_bits->acc >> (64 - len));
+    if (code <= p_huff->maxcode[len]) {
+      p_bits->acc <<= len;
+      p_bits->bits -= len;
+      return p_huff->vals[code + p_huff->valoffset[len]];
+    }
+  }
+  return -1;
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_extend
+* Parameters: v, s
+* Return Value : signed value of the s bit magnitude category v
+* Description: EXTEND procedure of T.81 F.2.2.1
+==============================================================================*/
+static inline int32_t jpegdec_sw_extend(uint32_t v, uint32_t s)
+{
+  return (v < (1u << (s - 1))) ? (int32_t)v - (int32_t)((1u << s) - 1) :
+    (int32_t)v;
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_decode_block
+* Parameters: p_bits, p_dc, p_ac, p_pred, p_coef
+* Return Value : zigzag index of the last coefficient decoded, -1 on error
+* Description: Decode the coefficients of one block in natural order. The
+* caller clears p_coef
+==============================================================================*/
+static int jpegdec_sw_decode_block(jpegdec_sw_bits_t *p_bits,
+  const jpegdec_sw_huff_t *p_dc, const jpegdec_sw_huff_t *p_ac,
+  int32_t *p_pred, int16_t *p_coef)
+{
+  int s, r, rs, k, last = 0;
+
+  s = jpegdec_sw_decode_huff(p_bits, p_dc);
+  if ((s < 0) || (s > 11)) {
+    return -1;
+  }
+  if (s) {
+    *p_pred += jpegdec_sw_extend(jpegdec_sw_get_bits(p_bits, s), s);
+  }
+  p_coef[0] = (int16_t)*p_pred;
+
+  for (k = 1; k < DCTSIZE2; k++) {
+    rs = jpegdec_sw_decode_huff(p_bits, p_ac);
+    if (rs < 0) {
+      return -1;
+    }
+    r = rs >> 4;
+    s = rs & 0xF;
+    if (s) {
+      k += r;
+      if ((k >= DCTSIZE2) || (s > 10)) {
+        return -1;
+      }
+      p_coef[natural_order[k]] =
+        (int16_t)jpegdec_sw_extend(jpegdec_sw_get_bits(p_bits, s), s);
+      last = k;
+    } else if (15 == r) {
+      k += 15;
+    } else {
+      break;
+    }
+  }
+  return last;
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_clamp
+* Parameters: v - sample with the level shift applied
+* Return Value : v rounded and clamped to 0..255
+* Description: Convert an IDCT output to a pixel
+==============================================================================*/
+static inline uint8_t jpegdec_sw_clamp(float v)
+{
+  int32_t i = (int32_t)(v + 128.5f);
+  return (uint8_t)((i < 0) ? 0 : ((i > 255) ? 255 : i));
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_idct
+* Parameters: p_coef, p_qf, p_out, stride
+* Return Value : None
+* Description: Dequantize and inverse transform one block with the AAN
+* algorithm, the scaling being folded into p_qf
+==============================================================================*/
+static void jpegdec_sw_idct(const int16_t *p_coef, const float *p_qf,
+  uint8_t *p_out, uint32_t stride)
+{
+  float ws[DCTSIZE2];
+  float tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  float tmp10, tmp11, tmp12, tmp13, z5, z10, z11, z12, z13;
+  const int16_t *c;
+  const float *q;
+  float *w;
+  uint32_t i;
+
+  /* columns */
+  for (i = 0; i < DCTSIZE; i++) {
+    c = p_coef + i;
+    q = p_qf + i;
+    w = ws + i;
+    if (!c[8] && !c[16] && !c[24] && !c[32] && !c[40] && !c[48] && !c[56]) {
+      tmp0 = c[0] * q[0];
+      w[0] = w[8] = w[16] = w[24] = w[32] = w[40] = w[48] = w[56] = tmp0;
+      continue;
+    }
+    tmp0 = c[0] * q[0];
+    tmp1 = c[16] * q[16];
+    tmp2 = c[32] * q[32];
+    tmp3 = c[48] * q[48];
+    tmp10 = tmp0 + tmp2;
+    tmp11 = tmp0 - tmp2;
+    tmp13 = tmp1 + tmp3;
+    tmp12 = (tmp1 - tmp3) * 1.414213562f - tmp13;
+    tmp0 = tmp10 + tmp13;
+    tmp3 = tmp10 - tmp13;
+    tmp1 = tmp11 + tmp12;
+    tmp2 = tmp11 - tmp12;
+
+    tmp4 = c[8] * q[8];
+    tmp5 = c[24] * q[24];
+    tmp6 = c[40] * q[40];
+    tmp7 = c[56] * q[56];
+    z13 = tmp6 + tmp5;
+    z10 = tmp6 - tmp5;
+    z11 = tmp4 + tmp7;
+    z12 = tmp4 - tmp7;
+    tmp7 = z11 + z13;
+    tmp11 = (z11 - z13) * 1.414213562f;
+    z5 = (z10 + z12) * 1.847759065f;
+    tmp10 = z12 * 1.082392200f - z5;
+    tmp12 = z10 * -2.613125930f + z5;
+    tmp6 = tmp12 - tmp7;
+    tmp5 = tmp11 - tmp6;
+    tmp4 = tmp10 + tmp5;
+
+    w[0] = tmp0 + tmp7;
+    w[56] = tmp0 - tmp7;
+    w[8] = tmp1 + tmp6;
+    w[48] = tmp1 - tmp6;
+    w[16] = tmp2 + tmp5;
+    w[40] = tmp2 - tmp5;
+    w[32] = tmp3 + tmp4;
+    w[24] = tmp3 - tmp4;
+  }
+
+  /* rows */
+  for (i = 0; i < DCTSIZE; i++, p_out += stride) {
+    w = ws + i * DCTSIZE;
+    tmp10 = w[0] + w[4];
+    tmp11 = w[0] - w[4];
+    tmp13 = w[2] + w[6];
+    tmp12 = (w[2] - w[6]) * 1.414213562f - tmp13;
+    tmp0 = tmp10 + tmp13;
+    tmp3 = tmp10 - tmp13;
+    tmp1 = tmp11 + tmp12;
+    tmp2 = tmp11 - tmp12;
+
+    z13 = w[5] + w[3];
+    z10 = w[5] - w[3];
+    z11 = w[1] + w[7];
+    z12 = w[1] - w[7];
+    tmp7 = z11 + z13;
+    tmp11 = (z11 - z13) * 1.414213562f;
+    z5 = (z10 + z12) * 1.847759065f;
+    tmp10 = z12 * 1.082392200f - z5;
+    tmp12 = z10 * -2.613125930f + z5;
+    tmp6 = tmp12 - tmp7;
+    tmp5 = tmp11 - tmp6;
+    tmp4 = tmp10 + tmp5;
+
+    p_out[0] = jpegdec_sw_clamp(tmp0 + tmp7);
+    p_out[7] = jpegdec_sw_clamp(tmp0 - tmp7);
+    p_out[1] = jpegdec_sw_clamp(tmp1 + tmp6);
+    p_out[6] = jpegdec_sw_clamp(tmp1 - tmp6);
+    p_out[2] = jpegdec_sw_clamp(tmp2 + tmp5);
+    p_out[5] = jpegdec_sw_clamp(tmp2 - tmp5);
+    p_out[4] = jpegdec_sw_clamp(tmp3 + tmp4);
+    p_out[3] = jpegdec_sw_clamp(tmp3 - tmp4);
+  }
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_idct_dc
+* Parameters: dc, p_qf, p_out, stride
+* Return Value : None
+* Description: Inverse transform of a block with only a DC coefficient
+==============================================================================*/
+static inline void jpegdec_sw_idct_dc(int16_t dc, const float *p_qf,
+  uint8_t *p_out, uint32_t stride)
+{
+  uint8_t v = jpegdec_sw_clamp(dc * p_qf[0]);
+  uint32_t i;
+
+  for (i = 0; i < DCTSIZE; i++, p_out += stride) {
+    memset(p_out, v, DCTSIZE);
+  }
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_restart
+* Parameters: p_bits
+* Return Value : None
+* Description: Drop the padding bits of the interval and skip past the next
+* RST marker. If the marker is missing the rest of the image decodes as
+* flat blocks
+==============================================================================*/
+static void jpegdec_sw_restart(jpegdec_sw_bits_t *p_bits)
+{
+  const uint8_t *p = p_bits->p_cur;
+
+  p_bits->acc = 0;
+  p_bits->bits = 0;
+  while (p + 1 < p_bits->p_end) {
+    if ((0xFF == p[0]) && (p[1] >= M_RST0) && (p[1] <= M_RST7)) {
+      p_bits->p_cur = p + 2;
+      p_bits->marker = 0;
+      return;
+    }
+    if ((0xFF == p[0]) && (0 != p[1]) && (0xFF != p[1])) {
+      break;
+    }
+    p++;
+  }
+  ALOGE("%s:%d] restart marker missing", __func__, __LINE__);
+  p_bits->p_cur = p_bits->p_end;
+  p_bits->marker = 1;
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_put_chroma
+* Parameters: p_hdr, p_frame, p_cb, p_cr, cb_stride, cr_stride, y0, rows
+* Return Value : None
+* Description: Resample the chroma of one MCU row to the output subsampling
+* and interleave it. Each output sample averages the source samples
+* covering it, or replicates the nearest one when upsampling
+==============================================================================*/
+static void jpegdec_sw_put_chroma(const jpegdec_sw_header_t *p_hdr,
+  jpegdec_sw_frame_t *p_frame, const uint8_t *p_cb, const uint8_t *p_cr,
+  uint32_t cb_stride, uint32_t cr_stride, uint32_t y0, uint32_t rows)
+{
+  const jpegdec_sw_comp_t *p_comps = p_hdr->comps;
+  uint32_t oh = p_frame->chroma_hshift, ov = p_frame->chroma_vshift;
+  uint32_t h_max = p_comps[0].h_samp, v_max = p_comps[0].v_samp;
+  uint32_t cw = (p_hdr->width + (1 << oh) - 1) >> oh;
+  uint32_t oy, oy_end, ox, ly, c, sh, sv, r0, r1, c0, c1;
+  uint32_t cb_off = p_frame->cr_first ? 1 : 0;
+  const uint8_t *p_src, *p_row0, *p_row1;
+  uint32_t src_stride;
+  uint8_t *p_out;
+
+  for (c = 1; c < 3; c++) {
+    if (p_comps[c].h_samp > h_max) {
+      h_max = p_comps[c].h_samp;
+    }
+    if (p_comps[c].v_samp > v_max) {
+      v_max = p_comps[c].v_samp;
+    }
+  }
+
+  oy_end = (y0 + rows + (1 << ov) - 1) >> ov;
+  for (c = 1; c < 3; c++) {
+    p_src = (1 == c) ? p_cb : p_cr;
+    src_stride = (1 == c) ? cb_stride : cr_stride;
+    sh = h_max / p_comps[c].h_samp;
+    sv = v_max / p_comps[c].v_samp;
+    for (oy = y0 >> ov; oy < oy_end; oy++) {
+      ly = (oy << ov) - y0;
+      r0 = ly / sv;
+      r1 = (ov && (1 == sv)) ? r0 + 1 : r0;
+      p_row0 = p_src + r0 * src_stride;
+      p_row1 = p_src + r1 * src_stride;
+      p_out = p_frame->p_chroma + oy * p_frame->stride +
+        ((1 == c) ? cb_off : 1 - cb_off);
+      if ((sh == (1u << oh)) && (r0 == r1)) {
+        /* same subsampling, plain interleave */
+        for (ox = 0; ox < cw; ox++) {
+          p_out[2 * ox] = p_row0[ox];
+        }
+        continue;
+      }
+      for (ox = 0; ox < cw; ox++) {
+        c0 = (ox << oh) / sh;
+        c1 = (oh && (1 == sh)) ? c0 + 1 : c0;
+        p_out[2 * ox] = (uint8_t)((p_row0[c0] + p_row0[c1] + p_row1[c0] +
+          p_row1[c1] + 2) >> 2);
+      }
+    }
+  }
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_ctx_create
+* Parameters: None
+* Return Value : decoder state, NULL on failure
+* Description: Allocate the state of one decoder
+==============================================================================*/
+jpegdec_sw_ctx_t *jpegdec_sw_ctx_create(void)
+{
+  return (jpegdec_sw_ctx_t *)calloc(1, sizeof(jpegdec_sw_ctx_t));
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_ctx_destroy
+* Parameters: p_ctx
+* Return Value : None
+* Description: Free the decoder state
+==============================================================================*/
+void jpegdec_sw_ctx_destroy(jpegdec_sw_ctx_t *p_ctx)
+{
+  if (p_ctx) {
+    free(p_ctx->p_planes);
+    free(p_ctx);
+  }
+}
+
+/*==============================================================================
+* Function : jpegdec_sw_decode
+* Parameters: p_ctx, p_hdr, p_data, len, p_frame, slice_rows, rows_cb,
+*   p_user, p_abort
+* Return Value : 0 on success, -1 on failure
+* Description: Decode the image parsed into p_hdr one MCU row at a time.
+* Every MCU row is written to the output as soon as it is decoded and
+* rows_cb is called whenever at least slice_rows new rows are final,
+* the last call covering the full height
+==============================================================================*/
+int jpegdec_sw_decode(jpegdec_sw_ctx_t *p_ctx, const jpegdec_sw_header_t *p_hdr,
+  const uint8_t *p_data, uint32_t len, jpegdec_sw_frame_t *p_frame,
+  uint32_t slice_rows, jpegdec_sw_rows_cb_t rows_cb, void *p_user,
+  volatile int *p_abort)
+{
+  const jpegdec_sw_comp_t *p_comp;
+  jpegdec_sw_bits_t bits;
+  int16_t coef[DCTSIZE2];
+  int32_t pred[JPEGDEC_SW_MAX_COMPS];
+  uint8_t *p_plane[JPEGDEC_SW_MAX_COMPS];
+  uint32_t plane_stride[JPEGDEC_SW_MAX_COMPS];
+  uint32_t h_max = 1, v_max = 1, mcu_w, mcu_h, mcus_x, mcus_y;
+  uint32_t c, i, mx, my, bx, by, y0, rows, size, reported = 0;
+  uint32_t restart_left;
+  uint8_t *p_blk;
+  int last;
+
+  if (p_hdr->scan_offset >= len) {
+    return -1;
+  }
+  for (i = 0; i < 4; i++) {
+    if (((p_hdr->huff_set & (1 << i)) &&
+      jpegdec_sw_derive_huff(p_hdr->dc_bits[i], p_hdr->dc_vals[i],
+      &p_ctx->dc[i])) ||
+      ((p_hdr->huff_set & (1 << (i + 4))) &&
+      jpegdec_sw_derive_huff(p_hdr->ac_bits[i], p_hdr->ac_vals[i],
+      &p_ctx->ac[i]))) {
+      ALOGE("%s:%d] bad huffman table %d", __func__, __LINE__, i);
+      return -1;
+    }
+    for (c = 0; c < DCTSIZE2; c++) {
+      p_ctx->qf[i][c] = p_hdr->qtable[i][c] * aan_scale[c / DCTSIZE] *
+        aan_scale[c % DCTSIZE] / 8.0f;
+    }
+  }
+
+  for (c = 0; c < p_hdr->num_comps; c++) {
+    if (p_hdr->comps[c].h_samp > h_max) {
+      h_max = p_hdr->comps[c].h_samp;
+    }
+    if (p_hdr->comps[c].v_samp > v_max) {
+      v_max = p_hdr->comps[c].v_samp;
+    }
+  }
+  mcu_w = DCTSIZE * h_max;
+  mcu_h = DCTSIZE * v_max;
+  mcus_x = (p_hdr->width + mcu_w - 1) / mcu_w;
+  mcus_y = (p_hdr->height + mcu_h - 1) / mcu_h;
+
+  /* samples of one MCU row for each component */
+  size = 0;
+  for (c = 0; c < p_hdr->num_comps; c++) {
+    plane_stride[c] = mcus_x * p_hdr->comps[c].h_samp * DCTSIZE;
+    size += plane_stride[c] * p_hdr->comps[c].v_samp * DCTSIZE;
+  }
+  if (size > p_ctx->planes_size) {
+    free(p_ctx->p_planes);
+    p_ctx->p_planes = malloc(size);
+    p_ctx->planes_size = p_ctx->p_planes ? size : 0;
+    if (NULL == p_ctx->p_planes) {
+      return -1;
+    }
+  }
+  p_plane[0] = p_ctx->p_planes;
+  for (c = 1; c < p_hdr->num_comps; c++) {
+    p_plane[c] = p_plane[c - 1] +
+      plane_stride[c - 1] * p_hdr->comps[c - 1].v_samp * DCTSIZE;
+  }
+
+  memset(&bits, 0, sizeof(bits));
+  bits.p_cur = p_data + p_hdr->scan_offset;
+  bits.p_end = p_data + len;
+  memset(pred, 0, sizeof(pred));
+  restart_left = p_hdr->restart_interval;
+
+  for (my = 0; my < mcus_y; my++) {
+    if (p_abort && *p_abort) {
+      return -1;
+    }
+    for (mx = 0; mx < mcus_x; mx++) {
+      if (p_hdr->restart_interval) {
+        if (0 == restart_left) {
+          jpegdec_sw_restart(&bits);
+          memset(pred, 0, sizeof(pred));
+          restart_left = p_hdr->restart_interval;
+        }
+        restart_left--;
+      }
+      for (c = 0; c < p_hdr->num_comps; c++) {
+        p_comp = &p_hdr->comps[c];
+        for (by = 0; by < p_comp->v_samp; by++) {
+          for (bx = 0; bx < p_comp->h_samp; bx++) {
+            memset(coef, 0, sizeof(coef));
+            last = jpegdec_sw_decode_block(&bits, &p_ctx->dc[p_comp->td],
+              &p_ctx->ac[p_comp->ta], &pred[c], coef);
+            if (last < 0) {
+              ALOGE("%s:%d] corrupt data at MCU %d,%d", __func__, __LINE__,
+                mx, my);
+              return -1;
+            }
+            p_blk = p_plane[c] + by * DCTSIZE * plane_stride[c] +
+              (mx * p_comp->h_samp + bx) * DCTSIZE;
+            if (0 == last) {
+              jpegdec_sw_idct_dc(coef[0], p_ctx->qf[p_comp->tq], p_blk,
+                plane_stride[c]);
+            } else {
+              jpegdec_sw_idct(coef, p_ctx->qf[p_comp->tq], p_blk,
+                plane_stride[c]);
+            }
+          }
+        }
+      }
+    }
+
+    y0 = my * mcu_h;
+    rows = (p_hdr->height - y0 < mcu_h) ? p_hdr->height - y0 : mcu_h;
+    for (i = 0; i < rows; i++) {
+      memcpy(p_frame->p_luma + (y0 + i) * p_frame->stride,
+        p_plane[0] + i * plane_stride[0], p_hdr->width);
+    }
+    if (p_frame->p_chroma) {
+      if (3 == p_hdr->num_comps) {
+        jpegdec_sw_put_chroma(p_hdr, p_frame, p_plane[1], p_plane[2],
+          plane_stride[1], plane_stride[2], y0, rows);
+      } else {
+        for (i = y0 >> p_frame->chroma_vshift;
+          i < (y0 + rows + (1 << p_frame->chroma_vshift) - 1) >>
+          p_frame->chroma_vshift; i++) {
+          memset(p_frame->p_chroma + i * p_frame->stride, 0x80,
+            2 * ((p_hdr->width + (1 << p_frame->chroma_hshift) - 1) >>
+            p_frame->chroma_hshift));
+        }
+      }
+    }
+
+    if (rows_cb && slice_rows &&
+      ((y0 + rows - reported >= slice_rows) || (y0 + rows == p_hdr->height))) {
+      reported = y0 + rows;
+      rows_cb(p_user, reported);
+    }
+  }
+  return 0;
+}
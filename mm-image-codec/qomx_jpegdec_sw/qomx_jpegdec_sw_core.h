@@ -0,0 +1,118 @@
+/*Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+
+
+#ifndef QOMX_JPEGDEC_SW_CORE_H
+#define QOMX_JPEGDEC_SW_CORE_H
+
+#include <stdint.h>
+
+#define JPEGDEC_SW_MAX_COMPS 3
+
+/** jpegdec_sw_comp_t: Frame component
+*    @id: component identifier
+*    @h_samp: horizontal sampling factor
+*    @v_samp: vertical sampling factor
+*    @tq: quantization table index
+*    @td: DC huffman table index
+*    @ta: AC huffman table index
+**/
+typedef struct {
+  uint8_t id;
+  uint8_t h_samp;
+  uint8_t v_samp;
+  uint8_t tq;
+  uint8_t td;
+  uint8_t ta;
+} jpegdec_sw_comp_t;
+
+/** jpegdec_sw_header_t: Parsed baseline jpeg header
+*    @width: image width
+*    @height: image height
+*    @num_comps: number of components, 1 or 3
+*    @comps: components in scan order
+*    @restart_interval: MCUs per restart interval, 0 if none
+*    @qtable: quantization tables in natural order
+*    @qtable_set: bitmask of the tables defined
+*    @dc_bits: DC huffman BITS lists
+*    @dc_vals: DC huffman HUFFVAL lists
+*    @ac_bits: AC huffman BITS lists
+*    @ac_vals: AC huffman HUFFVAL lists
+*    @huff_set: bitmask of the tables defined, DC in the low nibble
+*    @scan_offset: offset of the entropy coded data
+**/
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  uint32_t num_comps;
+  jpegdec_sw_comp_t comps[JPEGDEC_SW_MAX_COMPS];
+  uint32_t restart_interval;
+  uint16_t qtable[4][64];
+  uint32_t qtable_set;
+  uint8_t dc_bits[4][17];
+  uint8_t dc_vals[4][256];
+  uint8_t ac_bits[4][17];
+  uint8_t ac_vals[4][256];
+  uint32_t huff_set;
+  uint32_t scan_offset;
+} jpegdec_sw_header_t;
+
+/** jpegdec_sw_frame_t: Semi planar output frame
+*    @p_luma: luma plane
+*    @p_chroma: interleaved chroma plane, NULL for monochrome
+*    @stride: luma and chroma stride in bytes
+*    @chroma_hshift: log2 of the horizontal chroma subsampling
+*    @chroma_vshift: log2 of the vertical chroma subsampling
+*    @cr_first: chroma plane is CrCb interleaved
+**/
+typedef struct {
+  uint8_t *p_luma;
+  uint8_t *p_chroma;
+  uint32_t stride;
+  uint32_t chroma_hshift;
+  uint32_t chroma_vshift;
+  uint8_t cr_first;
+} jpegdec_sw_frame_t;
+
+/* Called when luma rows [0, rows) and the matching chroma rows of
+ * the output are final */
+typedef void (*jpegdec_sw_rows_cb_t)(void *p_user, uint32_t rows);
+
+/* Opaque decoder state, one per concurrently running decode */
+typedef struct jpegdec_sw_ctx jpegdec_sw_ctx_t;
+
+int jpegdec_sw_parse(const uint8_t *p_data, uint32_t len,
+  jpegdec_sw_header_t *p_hdr);
+jpegdec_sw_ctx_t *jpegdec_sw_ctx_create(void);
+void jpegdec_sw_ctx_destroy(jpegdec_sw_ctx_t *p_ctx);
+int jpegdec_sw_decode(jpegdec_sw_ctx_t *p_ctx, const jpegdec_sw_header_t *p_hdr,
+  const uint8_t *p_data, uint32_t len, jpegdec_sw_frame_t *p_frame,
+  uint32_t slice_rows, jpegdec_sw_rows_cb_t rows_cb, void *p_user,
+  volatile int *p_abort);
+
+#endif
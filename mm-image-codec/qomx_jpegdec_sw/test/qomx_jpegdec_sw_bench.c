@@ -0,0 +1,382 @@
+/*Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include "qomx_jpegdec_sw_core.h"
+#include "qomx_jpegenc_sw_core.h"
+
+#define BENCH_MAX_SIZES 3
+#define BENCH_MAX_THREADS 8
+
+/** bench_size_t: Benchmark resolution
+*    @width: frame width
+*    @height: frame height
+*    @name: label printed in the report
+**/
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  const char *name;
+} bench_size_t;
+
+/** bench_ctx_t: Images shared by the decode threads
+*    @p_data: jpeg
+*    @len: jpeg size
+*    @p_hdr: parsed headers
+*    @p_out: output frames, one per thread
+*    @count: images to decode
+*    @next: next image to hand out
+*    @failed: a decode failed
+*    @lock: protects next and failed
+**/
+typedef struct {
+  const uint8_t *p_data;
+  uint32_t len;
+  const jpegdec_sw_header_t *p_hdr;
+  uint8_t *p_out[BENCH_MAX_THREADS];
+  uint32_t count;
+  uint32_t next;
+  int failed;
+  pthread_mutex_t lock;
+} bench_ctx_t;
+
+/** bench_thread_t: Decode thread
+*    @p_ctx: shared state
+*    @index: thread index, selects the output frame
+**/
+typedef struct {
+  bench_ctx_t *p_ctx;
+  uint32_t index;
+} bench_thread_t;
+
+/* 8, 13 and 16 MP sensors */
+static const bench_size_t g_sizes[BENCH_MAX_SIZES] = {
+  { 3264, 2448, "8MP" },
+  { 4208, 3120, "13MP" },
+  { 4608, 3456, "16MP" },
+};
+
+/*==============================================================================
+* Function : bench_now_us
+* Parameters: None
+* Return Value : current time in microseconds
+* Description: Monotonic enough wall clock for the measurements
+==============================================================================*/
+static uint64_t bench_now_us(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/*==============================================================================
+* Function : bench_make_jpeg
+* Parameters: width, height, p_out
+* Return Value : 0 on success, -1 on failure
+* Description: Encode a synthetic NV21 frame with gradients, edges and
+* noise so that the decoder sees camera like content
+==============================================================================*/
+static int bench_make_jpeg(uint32_t width, uint32_t height,
+  jpegenc_sw_buf_t *p_out)
+{
+  jpegenc_sw_pool_t *p_pool;
+  jpegenc_sw_config_t config;
+  jpegenc_sw_frame_t frame;
+  uint8_t *p_buf, *p_chroma;
+  uint32_t x, y, seed = 0x1234567;
+  int rc;
+
+  p_buf = malloc(width * height * 3 / 2);
+  if (NULL == p_buf) {
+    return -1;
+  }
+  p_chroma = p_buf + width * height;
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      seed = seed * 1103515245 + 12345;
+      p_buf[y * width + x] = (uint8_t)(((x * 255) / width + (y & 0x40) +
+        ((x / 64 + y / 64) & 1) * 32 + ((seed >> 16) & 0xF)) & 0xFF);
+    }
+  }
+  for (y = 0; y < height / 2; y++) {
+    for (x = 0; x < width / 2; x++) {
+      p_chroma[y * width + 2 * x] = (uint8_t)(96 + (x * 64) / width);
+      p_chroma[y * width + 2 * x + 1] = (uint8_t)(160 - (y * 64) / height);
+    }
+  }
+
+  memset(&frame, 0, sizeof(frame));
+  frame.p_luma = p_buf;
+  frame.p_chroma = p_chroma;
+  frame.width = width;
+  frame.height = height;
+  frame.stride = width;
+  frame.chroma_hshift = frame.chroma_vshift = 1;
+  frame.cr_first = 1;
+  memset(&config, 0, sizeof(config));
+  jpegenc_sw_set_quality(config.qtable, 85);
+
+  rc = -1;
+  p_pool = jpegenc_sw_pool_create(0);
+  if (p_pool) {
+    rc = jpegenc_sw_encode(p_pool, &frame, &config, NULL, 0, p_out, NULL);
+    jpegenc_sw_pool_destroy(p_pool);
+  }
+  free(p_buf);
+  return rc;
+}
+
+/*==============================================================================
+* Function : bench_decode_thread
+* Parameters: data - bench_thread_t
+* Return Value : NULL
+* Description: Decode images until the shared count is reached
+==============================================================================*/
+static void *bench_decode_thread(void *data)
+{
+  bench_thread_t *p_thread = (bench_thread_t *)data;
+  bench_ctx_t *p_ctx = p_thread->p_ctx;
+  const jpegdec_sw_header_t *p_hdr = p_ctx->p_hdr;
+  jpegdec_sw_frame_t frame;
+  jpegdec_sw_ctx_t *p_dec;
+  int done = 0;
+
+  p_dec = jpegdec_sw_ctx_create();
+  memset(&frame, 0, sizeof(frame));
+  frame.p_luma = p_ctx->p_out[p_thread->index];
+  frame.p_chroma = frame.p_luma + p_hdr->width * p_hdr->height;
+  frame.stride = p_hdr->width;
+  frame.chroma_hshift = frame.chroma_vshift = 1;
+  frame.cr_first = 1;
+
+  while (!done) {
+    pthread_mutex_lock(&p_ctx->lock);
+    done = p_ctx->failed || (p_ctx->next >= p_ctx->count);
+    p_ctx->next++;
+    pthread_mutex_unlock(&p_ctx->lock);
+    if (done) {
+      break;
+    }
+    if (!p_dec || jpegdec_sw_decode(p_dec, p_hdr, p_ctx->p_data, p_ctx->len,
+      &frame, 0, NULL, NULL, NULL) < 0) {
+      pthread_mutex_lock(&p_ctx->lock);
+      p_ctx->failed = 1;
+      pthread_mutex_unlock(&p_ctx->lock);
+      break;
+    }
+  }
+  jpegdec_sw_ctx_destroy(p_dec);
+  return NULL;
+}
+
+/*==============================================================================
+* Function : bench_run
+* Parameters: p_ctx, num_threads, p_name
+* Return Value : 0 on success, -1 on failure
+* Description: Decode p_ctx->count images spread over num_threads
+* threads and print the throughput
+==============================================================================*/
+static int bench_run(bench_ctx_t *p_ctx, uint32_t num_threads,
+  const char *p_name)
+{
+  pthread_t threads[BENCH_MAX_THREADS];
+  bench_thread_t args[BENCH_MAX_THREADS];
+  uint64_t start, total;
+  uint32_t i, started = 0;
+  double mp = (double)p_ctx->p_hdr->width * p_ctx->p_hdr->height / 1000000.0;
+
+  p_ctx->next = 0;
+  p_ctx->failed = 0;
+  start = bench_now_us();
+  for (i = 0; i < num_threads; i++) {
+    args[i].p_ctx = p_ctx;
+    args[i].index = i;
+    if (pthread_create(&threads[i], NULL, bench_decode_thread, &args[i])) {
+      break;
+    }
+    started++;
+  }
+  for (i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  total = bench_now_us() - start;
+  if (p_ctx->failed || !started) {
+    fprintf(stderr, "Decode failed\n");
+    return -1;
+  }
+  fprintf(stderr, "%-6s %4dx%-4d threads %d %3d images %8.2f ms "
+    "%6.2f fps %6.1f MP/s\n", p_name, p_ctx->p_hdr->width,
+    p_ctx->p_hdr->height, started, p_ctx->count, total / 1000.0,
+    p_ctx->count * 1000000.0 / total, mp * p_ctx->count * 1000000.0 / total);
+  return 0;
+}
+
+/*==============================================================================
+* Function : bench_usage
+* Parameters: None
+* Return Value : None
+* Description: Print the options
+==============================================================================*/
+static void bench_usage(void)
+{
+  fprintf(stderr, "Usage: qomx-jpegdec-sw-bench [options]\n");
+  fprintf(stderr, "  -I FILE\t\tJPEG input file\n");
+  fprintf(stderr, "  -O FILE\t\tDump the last decoded image as NV21\n");
+  fprintf(stderr, "  -n COUNT\t\tImages per measurement (default 8)\n");
+  fprintf(stderr, "  -t THREADS\t\tMaximum thread count (default all cores)\n");
+  fprintf(stderr, "Without -I the 8, 13 and 16 MP synthetic images are used\n");
+}
+
+int main(int argc, char **argv)
+{
+  bench_ctx_t ctx;
+  jpegdec_sw_header_t hdr;
+  jpegenc_sw_buf_t jpeg;
+  uint32_t num_sizes = BENCH_MAX_SIZES, max_threads = 0, count = 8;
+  uint32_t i, t, frame_size;
+  char *in_file = NULL, *out_file = NULL;
+  uint8_t *p_file = NULL;
+  long cores, len;
+  FILE *fp;
+  int c, rc = 0;
+
+  while ((c = getopt(argc, argv, "I:O:n:t:")) != -1) {
+    switch (c) {
+    case 'I':
+      in_file = optarg;
+      break;
+    case 'O':
+      out_file = optarg;
+      break;
+    case 'n':
+      count = atoi(optarg);
+      break;
+    case 't':
+      max_threads = atoi(optarg);
+      break;
+    default:
+      bench_usage();
+      return 1;
+    }
+  }
+  if (in_file) {
+    fp = fopen(in_file, "rb");
+    if (fp) {
+      fseek(fp, 0, SEEK_END);
+      len = ftell(fp);
+      fseek(fp, 0, SEEK_SET);
+      p_file = (len > 0) ? malloc(len) : NULL;
+      if (p_file && (fread(p_file, 1, len, fp) != (size_t)len)) {
+        free(p_file);
+        p_file = NULL;
+      }
+      fclose(fp);
+    }
+    if (NULL == p_file) {
+      fprintf(stderr, "Cannot read %s\n", in_file);
+      return 1;
+    }
+    num_sizes = 1;
+  }
+  if (0 == max_threads) {
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+    max_threads = (cores > 0) ? (uint32_t)cores : 1;
+  }
+  if (max_threads > BENCH_MAX_THREADS) {
+    max_threads = BENCH_MAX_THREADS;
+  }
+  if (0 == count) {
+    count = 1;
+  }
+
+  memset(&jpeg, 0, sizeof(jpeg));
+  memset(&ctx, 0, sizeof(ctx));
+  pthread_mutex_init(&ctx.lock, NULL);
+  for (i = 0; i < num_sizes; i++) {
+    if (p_file) {
+      ctx.p_data = p_file;
+      ctx.len = (uint32_t)len;
+    } else {
+      if (bench_make_jpeg(g_sizes[i].width, g_sizes[i].height, &jpeg) < 0) {
+        fprintf(stderr, "Cannot encode %dx%d image\n", g_sizes[i].width,
+          g_sizes[i].height);
+        rc = 1;
+        break;
+      }
+      ctx.p_data = jpeg.p_data;
+      ctx.len = jpeg.len;
+    }
+    if (jpegdec_sw_parse(ctx.p_data, ctx.len, &hdr) < 0) {
+      fprintf(stderr, "Unsupported jpeg\n");
+      rc = 1;
+      break;
+    }
+    ctx.p_hdr = &hdr;
+    ctx.count = count;
+    frame_size = hdr.width * hdr.height + 2 * ((hdr.width + 1) / 2) *
+      ((hdr.height + 1) / 2);
+    for (t = 0; t < max_threads; t++) {
+      ctx.p_out[t] = malloc(frame_size);
+      if (NULL == ctx.p_out[t]) {
+        rc = 1;
+      }
+    }
+
+    /* 1, 2, 4 ... threads and the maximum */
+    for (t = 1; !rc && (t <= max_threads);
+      t = (t * 2 > max_threads && t != max_threads) ? max_threads : t * 2) {
+      if (bench_run(&ctx, t, p_file ? "file" : g_sizes[i].name) < 0) {
+        rc = 1;
+      }
+    }
+
+    if (!rc && out_file && (i == num_sizes - 1)) {
+      fp = fopen(out_file, "wb");
+      if (fp) {
+        fwrite(ctx.p_out[0], 1, frame_size, fp);
+        fclose(fp);
+      }
+    }
+    for (t = 0; t < max_threads; t++) {
+      free(ctx.p_out[t]);
+      ctx.p_out[t] = NULL;
+    }
+    if (rc) {
+      break;
+    }
+  }
+  pthread_mutex_destroy(&ctx.lock);
+  jpegenc_sw_buf_release(&jpeg);
+  free(p_file);
+  return rc;
+}
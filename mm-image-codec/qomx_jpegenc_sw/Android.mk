@@ -0,0 +1,61 @@
+OMX_JPEGENC_SW_PATH := $(call my-dir)
+
+# ------------------------------------------------------------------------------
+#                Make the shared library (libqomx_jpegenc_sw)
+# ------------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(OMX_JPEGENC_SW_PATH)
+LOCAL_MODULE_TAGS := optional
+
+omx_jpegenc_sw_defines:= -Werror \
+                         -O3 -ftree-vectorize
+
+LOCAL_CFLAGS := $(omx_jpegenc_sw_defines)
+
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_ARM_NEON := true
+endif
+
+OMX_HEADER_DIR := frameworks/native/include/media/openmax
+
+LOCAL_C_INCLUDES := $(OMX_HEADER_DIR)
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../qexif
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../qomx_core
+
+LOCAL_SRC_FILES := qomx_jpegenc_sw.c \
+                   qomx_jpegenc_sw_core.c \
+                   qomx_jpegenc_sw_exif.c
+
+LOCAL_MODULE           := libqomx_jpegenc_sw
+LOCAL_PRELINK_MODULE   := false
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+
+include $(BUILD_SHARED_LIBRARY)
+
+# ------------------------------------------------------------------------------
+#                Encoder benchmark (qomx-jpegenc-sw-bench)
+# ------------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+LOCAL_PATH := $(OMX_JPEGENC_SW_PATH)
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_CFLAGS := $(omx_jpegenc_sw_defines)
+
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_ARM_NEON := true
+endif
+
+LOCAL_C_INCLUDES := $(OMX_HEADER_DIR)
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../qexif
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/../qomx_core
+
+LOCAL_SRC_FILES := test/qomx_jpegenc_sw_bench.c \
+                   qomx_jpegenc_sw_core.c
+
+LOCAL_MODULE           := qomx-jpegenc-sw-bench
+LOCAL_PRELINK_MODULE   := false
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,1393 @@
+/*Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+
+#define LOG_TAG "qomx_jpegenc_sw"
+#include <utils/Log.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cutils/properties.h>
+#include "qomx_jpegenc_sw.h"
+
+#define QOMX_JPEGENC_SW_VERSION 0x00000101
+
+/** qomx_jpegenc_sw_ext_t: Supported extension
+*    @name: extension name
+*    @index: extension index
+**/
+typedef struct {
+  const char *name;
+  QOMX_IMAGE_EXT_INDEXTYPE index;
+} qomx_jpegenc_sw_ext_t;
+
+/* Mobicat is not supported */
+static const qomx_jpegenc_sw_ext_t g_extensions[] = {
+  { QOMX_IMAGE_EXT_EXIF_NAME, QOMX_IMAGE_EXT_EXIF },
+  { QOMX_IMAGE_EXT_THUMBNAIL_NAME, QOMX_IMAGE_EXT_THUMBNAIL },
+  { QOMX_IMAGE_EXT_BUFFER_OFFSET_NAME, QOMX_IMAGE_EXT_BUFFER_OFFSET },
+  { QOMX_IMAGE_EXT_ENCODING_MODE_NAME, QOMX_IMAGE_EXT_ENCODING_MODE },
+  { QOMX_IMAGE_EXT_WORK_BUFFER_NAME, QOMX_IMAGE_EXT_WORK_BUFFER },
+  { QOMX_IMAGE_EXT_METADATA_NAME, QOMX_IMAGE_EXT_METADATA },
+  { QOMX_IMAGE_EXT_META_ENC_KEY_NAME, QOMX_IMAGE_EXT_META_ENC_KEY },
+  { QOMX_IMAGE_EXT_MEM_OPS_NAME, QOMX_IMAGE_EXT_MEM_OPS },
+  { QOMX_IMAGE_EXT_JPEG_SPEED_NAME, QOMX_IMAGE_EXT_JPEG_SPEED },
+  { QOMX_IMAGE_EXT_STREAMING_NAME, QOMX_IMAGE_EXT_STREAMING },
+};
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_get_comp
+* Parameters: hComp
+* Return Value : component, NULL if the handle is invalid
+* Description: Get the component from the OMX handle
+==============================================================================*/
+static inline qomx_jpegenc_sw_comp_t *qomx_jpegenc_sw_get_comp(
+  OMX_HANDLETYPE hComp)
+{
+  if (NULL == hComp) {
+    return NULL;
+  }
+  return (qomx_jpegenc_sw_comp_t *)
+    ((OMX_COMPONENTTYPE *)hComp)->pComponentPrivate;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_event
+* Parameters: p_comp, event, data1, data2
+* Return Value : None
+* Description: Send an event to the client. Must be called without the
+* component lock held
+==============================================================================*/
+static void qomx_jpegenc_sw_event(qomx_jpegenc_sw_comp_t *p_comp,
+  OMX_EVENTTYPE event, OMX_U32 data1, OMX_U32 data2)
+{
+  if (p_comp->callbacks.EventHandler) {
+    p_comp->callbacks.EventHandler(p_comp->p_comp, p_comp->app_data, event,
+      data1, data2, NULL);
+  }
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_return_buffer
+* Parameters: p_comp, p_buf
+* Return Value : None
+* Description: Hand a buffer back to the client. Must be called without
+* the component lock held
+==============================================================================*/
+static void qomx_jpegenc_sw_return_buffer(qomx_jpegenc_sw_comp_t *p_comp,
+  OMX_BUFFERHEADERTYPE *p_buf)
+{
+  if (QOMX_JPEGENC_SW_PORT_OUT == p_buf->nOutputPortIndex) {
+    if (p_comp->callbacks.FillBufferDone) {
+      p_comp->callbacks.FillBufferDone(p_comp->p_comp, p_comp->app_data,
+        p_buf);
+    }
+  } else if (p_comp->callbacks.EmptyBufferDone) {
+    p_comp->callbacks.EmptyBufferDone(p_comp->p_comp, p_comp->app_data,
+      p_buf);
+  }
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_dequeue
+* Parameters: p_port
+* Return Value : oldest queued buffer, NULL if none
+* Description: Remove the oldest buffer from the port queue
+==============================================================================*/
+static OMX_BUFFERHEADERTYPE *qomx_jpegenc_sw_dequeue(
+  qomx_jpegenc_sw_port_t *p_port)
+{
+  OMX_BUFFERHEADERTYPE *p_buf;
+
+  if (0 == p_port->num_queued) {
+    return NULL;
+  }
+  p_buf = p_port->p_queue[0];
+  p_port->num_queued--;
+  memmove(&p_port->p_queue[0], &p_port->p_queue[1],
+    p_port->num_queued * sizeof(p_port->p_queue[0]));
+  return p_buf;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_requeue
+* Parameters: p_port, p_buf
+* Return Value : None
+* Description: Put a buffer back at the head of the port queue
+==============================================================================*/
+static void qomx_jpegenc_sw_requeue(qomx_jpegenc_sw_port_t *p_port,
+  OMX_BUFFERHEADERTYPE *p_buf)
+{
+  if ((NULL == p_buf) || (p_port->num_queued >= QOMX_JPEGENC_SW_MAX_BUFS)) {
+    return;
+  }
+  memmove(&p_port->p_queue[1], &p_port->p_queue[0],
+    p_port->num_queued * sizeof(p_port->p_queue[0]));
+  p_port->p_queue[0] = p_buf;
+  p_port->num_queued++;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_transition_ready
+* Parameters: p_comp
+* Return Value : TRUE if the pending state transition can complete
+* Description: Loaded to Idle waits for the enabled ports to be populated,
+* Idle to Loaded waits for all the buffers to be freed
+==============================================================================*/
+static int qomx_jpegenc_sw_transition_ready(qomx_jpegenc_sw_comp_t *p_comp)
+{
+  qomx_jpegenc_sw_port_t *p_port;
+  int i;
+
+  if (!p_comp->state_pending) {
+    return OMX_FALSE;
+  }
+  if ((OMX_StateIdle == p_comp->target_state) &&
+    (OMX_StateLoaded == p_comp->state)) {
+    for (i = 0; i < QOMX_JPEGENC_SW_NUM_PORTS; i++) {
+      p_port = &p_comp->ports[i];
+      if (p_port->def.bEnabled && !p_port->def.bPopulated) {
+        return OMX_FALSE;
+      }
+    }
+  } else if (OMX_StateLoaded == p_comp->target_state) {
+    for (i = 0; i < QOMX_JPEGENC_SW_NUM_PORTS; i++) {
+      if (p_comp->ports[i].num_bufs) {
+        return OMX_FALSE;
+      }
+    }
+  }
+  return OMX_TRUE;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_job_ready
+* Parameters: p_comp
+* Return Value : TRUE if the buffers for an encode are queued
+* Description: An encode needs the main image, the output buffer and the
+* thumbnail if the thumbnail port is enabled
+==============================================================================*/
+static int qomx_jpegenc_sw_job_ready(qomx_jpegenc_sw_comp_t *p_comp)
+{
+  if (p_comp->state_pending || (OMX_StateExecuting != p_comp->state)) {
+    return OMX_FALSE;
+  }
+  if (!p_comp->ports[QOMX_JPEGENC_SW_PORT_MAIN].num_queued ||
+    !p_comp->ports[QOMX_JPEGENC_SW_PORT_OUT].num_queued) {
+    return OMX_FALSE;
+  }
+  if (p_comp->ports[QOMX_JPEGENC_SW_PORT_THUMB].def.bEnabled &&
+    !p_comp->ports[QOMX_JPEGENC_SW_PORT_THUMB].num_queued) {
+    return OMX_FALSE;
+  }
+  return OMX_TRUE;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_get_frame
+* Parameters: p_def, p_offset, p_buf, width, height, p_frame
+* Return Value : 0 on success, -1 if the format or layout is not supported
+* Description: Describe the semi planar frame held by the buffer
+==============================================================================*/
+static int qomx_jpegenc_sw_get_frame(OMX_PARAM_PORTDEFINITIONTYPE *p_def,
+  QOMX_YUV_FRAME_INFO *p_offset, OMX_BUFFERHEADERTYPE *p_buf,
+  uint32_t width, uint32_t height, jpegenc_sw_frame_t *p_frame)
+{
+  uint32_t chroma_start, chroma_rows, slice;
+  int color = (int)p_def->format.image.eColorFormat;
+
+  memset(p_frame, 0, sizeof(*p_frame));
+  p_frame->width = width;
+  p_frame->height = height;
+  p_frame->stride = (p_def->format.image.nStride > 0) ?
+    (uint32_t)p_def->format.image.nStride : width;
+  slice = (p_def->format.image.nSliceHeight >= height) ?
+    p_def->format.image.nSliceHeight : height;
+
+  switch (color) {
+  case OMX_COLOR_FormatYUV420SemiPlanar:
+    p_frame->chroma_hshift = p_frame->chroma_vshift = 1;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYVU420SemiPlanar:
+    p_frame->chroma_hshift = p_frame->chroma_vshift = 1;
+    p_frame->cr_first = 1;
+    break;
+  case OMX_COLOR_FormatYUV422SemiPlanar:
+    p_frame->chroma_hshift = 1;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYVU422SemiPlanar:
+    p_frame->chroma_hshift = 1;
+    p_frame->cr_first = 1;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYUV422SemiPlanar_h1v2:
+    p_frame->chroma_vshift = 1;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYVU422SemiPlanar_h1v2:
+    p_frame->chroma_vshift = 1;
+    p_frame->cr_first = 1;
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYUV444SemiPlanar:
+    break;
+  case OMX_QCOM_IMG_COLOR_FormatYVU444SemiPlanar:
+    p_frame->cr_first = 1;
+    break;
+  case OMX_COLOR_FormatMonochrome:
+    break;
+  default:
+    ALOGE("%s:%d] unsupported color format %x", __func__, __LINE__, color);
+    return -1;
+  }
+
+  if ((p_frame->stride < width) ||
+    ((uint64_t)p_offset->yOffset + (uint64_t)p_frame->stride * (height - 1) +
+    width > p_buf->nAllocLen)) {
+    ALOGE("%s:%d] luma plane exceeds buffer", __func__, __LINE__);
+    return -1;
+  }
+  p_frame->p_luma = p_buf->pBuffer + p_offset->yOffset;
+  if (OMX_COLOR_FormatMonochrome == color) {
+    return 0;
+  }
+
+  chroma_start = p_offset->cbcrStartOffset[0] ?
+    p_offset->cbcrStartOffset[0] : (p_offset->yOffset + p_frame->stride * slice);
+  chroma_start += p_offset->cbcrOffset[0];
+  chroma_rows = (height + p_frame->chroma_vshift) >> p_frame->chroma_vshift;
+  if ((uint64_t)chroma_start + (uint64_t)p_frame->stride * (chroma_rows - 1) +
+    2 * ((width + p_frame->chroma_hshift) >> p_frame->chroma_hshift) >
+    p_buf->nAllocLen) {
+    ALOGE("%s:%d] chroma plane exceeds buffer", __func__, __LINE__);
+    return -1;
+  }
+  p_frame->p_chroma = p_buf->pBuffer + chroma_start;
+  return 0;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_set_crop
+* Parameters: p_config, p_frame, left, top, crop_w, crop_h, out_w, out_h
+* Return Value : None
+* Description: Fill the crop and scale settings, clipping the crop window
+* to the frame. Zero sizes select the full frame and no scaling
+==============================================================================*/
+static void qomx_jpegenc_sw_set_crop(jpegenc_sw_config_t *p_config,
+  jpegenc_sw_frame_t *p_frame, int32_t left, int32_t top, uint32_t crop_w,
+  uint32_t crop_h, uint32_t out_w, uint32_t out_h)
+{
+  if ((left < 0) || ((uint32_t)left >= p_frame->width)) {
+    left = 0;
+  }
+  if ((top < 0) || ((uint32_t)top >= p_frame->height)) {
+    top = 0;
+  }
+  if (!crop_w || !crop_h) {
+    left = top = 0;
+    crop_w = p_frame->width;
+    crop_h = p_frame->height;
+  }
+  /* crop sizes may be rounded up by the client */
+  if ((uint32_t)left + crop_w > p_frame->width) {
+    crop_w = p_frame->width - left;
+  }
+  if ((uint32_t)top + crop_h > p_frame->height) {
+    crop_h = p_frame->height - top;
+  }
+  p_config->crop_left = left;
+  p_config->crop_top = top;
+  p_config->crop_width = crop_w;
+  p_config->crop_height = crop_h;
+  p_config->out_width = (out_w && out_h) ? out_w : crop_w;
+  p_config->out_height = (out_w && out_h) ? out_h : crop_h;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_encode_thumbnail
+* Parameters: p_comp, p_job, p_buf, quality
+* Return Value : 0 on success, -1 on failure
+* Description: Encode the thumbnail into p_comp->thumb_out
+==============================================================================*/
+static int qomx_jpegenc_sw_encode_thumbnail(qomx_jpegenc_sw_comp_t *p_comp,
+  qomx_jpegenc_sw_job_t *p_job, OMX_BUFFERHEADERTYPE *p_buf,
+  uint32_t quality)
+{
+  QOMX_THUMBNAIL_INFO *p_info = &p_job->thumb_info;
+  jpegenc_sw_frame_t frame;
+  jpegenc_sw_config_t config;
+
+  if (qomx_jpegenc_sw_get_frame(&p_job->thumb_def, &p_info->tmbOffset, p_buf,
+    p_info->input_width, p_info->input_height, &frame) < 0) {
+    return -1;
+  }
+  memset(&config, 0, sizeof(config));
+  qomx_jpegenc_sw_set_crop(&config, &frame, p_info->crop_info.nLeft,
+    p_info->crop_info.nTop, p_info->crop_info.nWidth,
+    p_info->crop_info.nHeight, p_info->output_width, p_info->output_height);
+  config.rotation = p_info->rotation;
+  jpegenc_sw_set_quality(config.qtable, quality);
+
+  return jpegenc_sw_encode(p_comp->p_pool, &frame, &config, NULL, 0,
+    &p_comp->thumb_out, &p_comp->abort);
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_build_exif
+* Parameters: p_comp, p_job, p_thumb_buf, width, height
+* Return Value : 0 on success, -1 on failure
+* Description: Encode the thumbnail and build the exif marker. If the
+* marker does not fit in 64K the thumbnail is encoded again at lower
+* quality, and dropped if that does not help either
+==============================================================================*/
+static int qomx_jpegenc_sw_build_exif(qomx_jpegenc_sw_comp_t *p_comp,
+  qomx_jpegenc_sw_job_t *p_job, OMX_BUFFERHEADERTYPE *p_thumb_buf,
+  uint32_t width, uint32_t height)
+{
+  uint32_t quality = p_job->thumb_info.quality;
+  uint8_t *p_thumb = NULL;
+  uint32_t thumb_len = 0;
+  int rc;
+
+  if ((quality < 1) || (quality > 100)) {
+    quality = QOMX_JPEGENC_SW_THUMB_QUALITY;
+  }
+  if (p_thumb_buf && !p_job->thumb_set) {
+    ALOGE("%s:%d] thumbnail not configured, skipping", __func__, __LINE__);
+    p_thumb_buf = NULL;
+  }
+
+  while (1) {
+    if (p_thumb_buf) {
+      if (qomx_jpegenc_sw_encode_thumbnail(p_comp, p_job, p_thumb_buf,
+        quality) < 0) {
+        if (p_comp->abort) {
+          return -1;
+        }
+        ALOGE("%s:%d] thumbnail encode failed, skipping", __func__, __LINE__);
+        p_thumb_buf = NULL;
+        continue;
+      }
+      p_thumb = p_comp->thumb_out.p_data;
+      thumb_len = p_comp->thumb_out.len;
+    } else {
+      p_thumb = NULL;
+      thumb_len = 0;
+    }
+
+    rc = jpegenc_sw_exif_build(p_job->p_exif, p_job->num_exif, width, height,
+      p_thumb, thumb_len, &p_comp->app1);
+    if (JPEGENC_SW_EXIF_TOO_BIG != rc) {
+      return rc;
+    }
+    if (quality > QOMX_JPEGENC_SW_THUMB_MIN_QUALITY) {
+      quality = quality / 2;
+      if (quality < QOMX_JPEGENC_SW_THUMB_MIN_QUALITY) {
+        quality = QOMX_JPEGENC_SW_THUMB_MIN_QUALITY;
+      }
+      ALOGI("%s:%d] thumbnail too big, retry at quality %d", __func__,
+        __LINE__, quality);
+    } else {
+      ALOGE("%s:%d] thumbnail too big, dropped", __func__, __LINE__);
+      if (!p_comp->abort) {
+        qomx_jpegenc_sw_event(p_comp,
+          (OMX_EVENTTYPE)OMX_EVENT_THUMBNAIL_DROPPED, 0, 0);
+      }
+      p_thumb_buf = NULL;
+    }
+  }
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_stream_progress
+* Parameters: data - component, final_len - output bytes that are final
+* Return Value : None
+* Description: Return the output buffer with what is final so far once
+* another chunk is complete. Called from the component thread without the
+* component lock held. While the client still holds the buffer from the
+* previous return the new bytes wait for the next chunk or the end
+==============================================================================*/
+static void qomx_jpegenc_sw_stream_progress(void *data, uint32_t final_len)
+{
+  qomx_jpegenc_sw_comp_t *p_comp = (qomx_jpegenc_sw_comp_t *)data;
+  OMX_BUFFERHEADERTYPE *p_out;
+  uint32_t chunk_size;
+
+  pthread_mutex_lock(&p_comp->lock);
+  p_out = p_comp->p_stream_out;
+  chunk_size = p_comp->streaming.nChunkSize ? p_comp->streaming.nChunkSize : 1;
+  if (p_comp->stream_held || p_comp->abort ||
+    (final_len < p_comp->stream_len + chunk_size)) {
+    pthread_mutex_unlock(&p_comp->lock);
+    return;
+  }
+  p_comp->stream_held = OMX_TRUE;
+  p_comp->stream_len = final_len;
+  p_out->nOffset = 0;
+  p_out->nFilledLen = final_len;
+  p_out->nFlags = 0;
+  pthread_mutex_unlock(&p_comp->lock);
+
+  qomx_jpegenc_sw_return_buffer(p_comp, p_out);
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_stream_wait
+* Parameters: p_comp
+* Return Value : 0 once the output buffer is back, -1 on abort
+* Description: Wait for the client to hand back the output buffer after
+* a partial return, so that the final return does not overlap it
+==============================================================================*/
+static int qomx_jpegenc_sw_stream_wait(qomx_jpegenc_sw_comp_t *p_comp)
+{
+  int rc = 0;
+
+  pthread_mutex_lock(&p_comp->lock);
+  while (p_comp->stream_held && !p_comp->abort) {
+    pthread_cond_wait(&p_comp->cond, &p_comp->lock);
+  }
+  if (p_comp->stream_held) {
+    rc = -1;
+  }
+  pthread_mutex_unlock(&p_comp->lock);
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_process
+* Parameters: p_comp, p_job, p_in, p_thumb, p_out
+* Return Value : OMX_ErrorNone on success
+* Description: Encode one image, called from the component thread without
+* the component lock held
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_process(qomx_jpegenc_sw_comp_t *p_comp,
+  qomx_jpegenc_sw_job_t *p_job, OMX_BUFFERHEADERTYPE *p_in,
+  OMX_BUFFERHEADERTYPE *p_thumb, OMX_BUFFERHEADERTYPE *p_out)
+{
+  jpegenc_sw_frame_t frame;
+  jpegenc_sw_config_t config;
+  jpegenc_sw_buf_t out_buf;
+  omx_jpeg_ouput_buf_t *p_out_desc;
+  uint32_t width, height;
+  struct timeval start, end;
+  long long time_us;
+
+  gettimeofday(&start, NULL);
+
+  if (NULL == p_comp->p_pool) {
+    char prop[PROPERTY_VALUE_MAX];
+    property_get("persist.camera.jpeg.swenc.threads", prop, "0");
+    p_comp->p_pool = jpegenc_sw_pool_create(atoi(prop));
+    if (NULL == p_comp->p_pool) {
+      return OMX_ErrorInsufficientResources;
+    }
+  }
+
+  if (qomx_jpegenc_sw_get_frame(&p_job->main_def, &p_job->main_offset, p_in,
+    p_job->main_def.format.image.nFrameWidth,
+    p_job->main_def.format.image.nFrameHeight, &frame) < 0) {
+    return OMX_ErrorBadParameter;
+  }
+  memset(&config, 0, sizeof(config));
+  qomx_jpegenc_sw_set_crop(&config, &frame, p_job->in_crop.nLeft,
+    p_job->in_crop.nTop, p_job->in_crop.nWidth, p_job->in_crop.nHeight,
+    p_job->out_crop.nWidth, p_job->out_crop.nHeight);
+  config.rotation = p_job->rotation;
+  memcpy(config.qtable, p_job->qtable, sizeof(config.qtable));
+  /* partial returns need the image in the client buffer itself */
+  if (p_job->streaming.bEnable && !p_job->mem_ops.get_memory) {
+    config.progress = qomx_jpegenc_sw_stream_progress;
+    config.p_progress_data = p_comp;
+  }
+
+  width = config.out_width;
+  height = config.out_height;
+  if ((90 == config.rotation) || (270 == config.rotation)) {
+    width = config.out_height;
+    height = config.out_width;
+  }
+
+  if (qomx_jpegenc_sw_build_exif(p_comp, p_job, p_thumb, width, height) < 0) {
+    ALOGE("%s:%d] exif failed", __func__, __LINE__);
+    return OMX_ErrorUndefined;
+  }
+
+  /* without an allocator encode straight into the client buffer */
+  if (p_job->mem_ops.get_memory) {
+    out_buf = p_comp->main_out;
+  } else {
+    memset(&out_buf, 0, sizeof(out_buf));
+    out_buf.p_data = p_out->pBuffer;
+    out_buf.size = p_out->nAllocLen;
+    out_buf.fixed = 1;
+  }
+  if (jpegenc_sw_encode(p_comp->p_pool, &frame, &config, p_comp->app1.p_data,
+    p_comp->app1.len, &out_buf, &p_comp->abort) < 0) {
+    if (p_job->mem_ops.get_memory) {
+      p_comp->main_out = out_buf;
+    }
+    ALOGE("%s:%d] encode failed", __func__, __LINE__);
+    return OMX_ErrorInsufficientResources;
+  }
+  if (config.progress && (qomx_jpegenc_sw_stream_wait(p_comp) < 0)) {
+    return OMX_ErrorInsufficientResources;
+  }
+
+  if (p_job->mem_ops.get_memory) {
+    p_comp->main_out = out_buf;
+    p_out_desc = (omx_jpeg_ouput_buf_t *)p_out->pBuffer;
+    p_out_desc->size = out_buf.len;
+    if (p_job->mem_ops.get_memory(p_out_desc) || !p_out_desc->vaddr) {
+      ALOGE("%s:%d] cannot allocate %d bytes", __func__, __LINE__,
+        out_buf.len);
+      return OMX_ErrorInsufficientResources;
+    }
+    memcpy(p_out_desc->vaddr, out_buf.p_data, out_buf.len);
+  }
+  p_out->nOffset = 0;
+  p_out->nFilledLen = out_buf.len;
+  p_out->nFlags |= OMX_BUFFERFLAG_EOS;
+
+  gettimeofday(&end, NULL);
+  time_us = (end.tv_sec - start.tv_sec) * 1000000LL +
+    (end.tv_usec - start.tv_usec);
+  ALOGI("[KPI Perf] %s: %dx%d rot %d encoded %d bytes in %lld us, "
+    "%d threads, %d bytes streamed", __func__, width, height,
+    config.rotation, out_buf.len, time_us,
+    jpegenc_sw_pool_threads(p_comp->p_pool), p_comp->stream_len);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_thread
+* Parameters: data - component
+* Return Value : NULL
+* Description: Component thread, completes the state transitions and runs
+* the encodes. Client callbacks are made with the component lock released
+==============================================================================*/
+static void *qomx_jpegenc_sw_thread(void *data)
+{
+  qomx_jpegenc_sw_comp_t *p_comp = (qomx_jpegenc_sw_comp_t *)data;
+  OMX_BUFFERHEADERTYPE *p_ret[QOMX_JPEGENC_SW_NUM_PORTS *
+    QOMX_JPEGENC_SW_MAX_BUFS];
+  OMX_BUFFERHEADERTYPE *p_in, *p_thumb, *p_out;
+  qomx_jpegenc_sw_job_t job;
+  OMX_STATETYPE new_state;
+  OMX_ERRORTYPE rc;
+  uint32_t i, num_ret;
+
+  pthread_mutex_lock(&p_comp->lock);
+  while (!p_comp->exit) {
+    if (qomx_jpegenc_sw_transition_ready(p_comp)) {
+      num_ret = 0;
+      if ((OMX_StateIdle == p_comp->target_state) &&
+        ((OMX_StateExecuting == p_comp->state) ||
+        (OMX_StatePause == p_comp->state))) {
+        /* hand back everything still queued */
+        for (i = 0; i < QOMX_JPEGENC_SW_NUM_PORTS; i++) {
+          while (p_comp->ports[i].num_queued) {
+            p_ret[num_ret] = qomx_jpegenc_sw_dequeue(&p_comp->ports[i]);
+            p_ret[num_ret]->nFilledLen = 0;
+            num_ret++;
+          }
+        }
+      }
+      p_comp->state = new_state = p_comp->target_state;
+      p_comp->state_pending = OMX_FALSE;
+      p_comp->abort = 0;
+      pthread_mutex_unlock(&p_comp->lock);
+
+      for (i = 0; i < num_ret; i++) {
+        qomx_jpegenc_sw_return_buffer(p_comp, p_ret[i]);
+      }
+      ALOGI("%s:%d] state %d", __func__, __LINE__, new_state);
+      qomx_jpegenc_sw_event(p_comp, OMX_EventCmdComplete,
+        OMX_CommandStateSet, new_state);
+
+      pthread_mutex_lock(&p_comp->lock);
+      continue;
+    }
+
+    if (qomx_jpegenc_sw_job_ready(p_comp)) {
+      p_in = qomx_jpegenc_sw_dequeue(&p_comp->ports[QOMX_JPEGENC_SW_PORT_MAIN]);
+      p_out = qomx_jpegenc_sw_dequeue(&p_comp->ports[QOMX_JPEGENC_SW_PORT_OUT]);
+      p_thumb = qomx_jpegenc_sw_dequeue(
+        &p_comp->ports[QOMX_JPEGENC_SW_PORT_THUMB]);
+
+      /* the job takes over the exif tags, new tags go to the next job */
+      memset(&job, 0, sizeof(job));
+      job.main_def = p_comp->ports[QOMX_JPEGENC_SW_PORT_MAIN].def;
+      job.thumb_def = p_comp->ports[QOMX_JPEGENC_SW_PORT_THUMB].def;
+      job.main_offset = p_comp->main_offset;
+      job.in_crop = p_comp->in_crop;
+      job.out_crop = p_comp->out_crop;
+      job.rotation = p_comp->rotation;
+      memcpy(job.qtable, p_comp->qtable, sizeof(job.qtable));
+      job.thumb_info = p_comp->thumb_info;
+      job.thumb_set = p_comp->thumb_set;
+      job.mem_ops = p_comp->mem_ops;
+      job.streaming = p_comp->streaming;
+      job.p_exif = p_comp->p_exif;
+      job.num_exif = p_comp->num_exif;
+      p_comp->p_exif = NULL;
+      p_comp->num_exif = p_comp->exif_size = 0;
+      p_comp->p_stream_out = p_out;
+      p_comp->stream_held = OMX_FALSE;
+      p_comp->stream_len = 0;
+      pthread_mutex_unlock(&p_comp->lock);
+
+      rc = qomx_jpegenc_sw_process(p_comp, &job, p_in, p_thumb, p_out);
+      free(job.p_exif);
+
+      pthread_mutex_lock(&p_comp->lock);
+      p_comp->p_stream_out = NULL;
+      if (p_comp->abort) {
+        /* returned by the transition to idle, unless the client still
+         * holds the output from a partial return */
+        qomx_jpegenc_sw_requeue(&p_comp->ports[QOMX_JPEGENC_SW_PORT_THUMB],
+          p_thumb);
+        if (!p_comp->stream_held) {
+          qomx_jpegenc_sw_requeue(&p_comp->ports[QOMX_JPEGENC_SW_PORT_OUT],
+            p_out);
+        }
+        qomx_jpegenc_sw_requeue(&p_comp->ports[QOMX_JPEGENC_SW_PORT_MAIN],
+          p_in);
+        p_comp->stream_held = OMX_FALSE;
+        continue;
+      }
+      pthread_mutex_unlock(&p_comp->lock);
+
+      qomx_jpegenc_sw_return_buffer(p_comp, p_in);
+      if (p_thumb) {
+        qomx_jpegenc_sw_return_buffer(p_comp, p_thumb);
+      }
+      /* on error the client completes the job from the error event, the
+       * output buffer is queued again with the next job */
+      if (OMX_ErrorNone == rc) {
+        qomx_jpegenc_sw_return_buffer(p_comp, p_out);
+      } else {
+        p_out->nFilledLen = 0;
+        qomx_jpegenc_sw_event(p_comp, OMX_EventError, rc, rc);
+      }
+
+      pthread_mutex_lock(&p_comp->lock);
+      continue;
+    }
+
+    pthread_cond_wait(&p_comp->cond, &p_comp->lock);
+  }
+  pthread_mutex_unlock(&p_comp->lock);
+  return NULL;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_get_component_version
+* Parameters: hComp, componentName, componentVersion, specVersion,
+*   componentUUID
+* Return Value : OMX_ERRORTYPE
+* Description: Return the component name and version
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_get_component_version(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_OUT OMX_STRING componentName,
+  OMX_OUT OMX_VERSIONTYPE* componentVersion,
+  OMX_OUT OMX_VERSIONTYPE* specVersion,
+  OMX_OUT OMX_UUIDTYPE* componentUUID)
+{
+  (void)componentUUID;
+  if (!qomx_jpegenc_sw_get_comp(hComp) || !componentName ||
+    !componentVersion || !specVersion) {
+    return OMX_ErrorBadParameter;
+  }
+  snprintf(componentName, OMX_MAX_STRINGNAME_SIZE, "%s", QOMX_JPEGENC_SW_NAME);
+  componentVersion->nVersion = QOMX_JPEGENC_SW_VERSION;
+  specVersion->nVersion = OMX_VERSION;
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_send_command
+* Parameters: hComp, Cmd, nParam1, pCmdData
+* Return Value : OMX_ERRORTYPE
+* Description: State changes complete from the component thread. Port
+* enable and disable complete before the call returns
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_send_command(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_COMMANDTYPE Cmd,
+  OMX_IN OMX_U32 nParam1,
+  OMX_IN OMX_PTR pCmdData)
+{
+  qomx_jpegenc_sw_comp_t *p_comp = qomx_jpegenc_sw_get_comp(hComp);
+  OMX_STATETYPE state = (OMX_STATETYPE)nParam1;
+  OMX_ERRORTYPE rc = OMX_ErrorNone;
+  uint32_t i;
+
+  (void)pCmdData;
+  if (NULL == p_comp) {
+    return OMX_ErrorBadParameter;
+  }
+
+  switch (Cmd) {
+  case OMX_CommandStateSet:
+    pthread_mutex_lock(&p_comp->lock);
+    if (p_comp->state_pending) {
+      rc = OMX_ErrorIncorrectStateOperation;
+    } else if (state == p_comp->state) {
+      rc = OMX_ErrorSameState;
+    } else if (((OMX_StateLoaded == p_comp->state) &&
+      (OMX_StateIdle != state)) ||
+      ((OMX_StateIdle == p_comp->state) && (OMX_StateLoaded != state) &&
+      (OMX_StateExecuting != state) && (OMX_StatePause != state)) ||
+      (((OMX_StateExecuting == p_comp->state) ||
+      (OMX_StatePause == p_comp->state)) && (OMX_StateIdle != state) &&
+      (OMX_StateExecuting != state) && (OMX_StatePause != state))) {
+      rc = OMX_ErrorIncorrectStateTransition;
+    } else {
+      p_comp->target_state = state;
+      p_comp->state_pending = OMX_TRUE;
+      if (OMX_StateIdle == state) {
+        p_comp->abort = 1;
+      }
+      pthread_cond_signal(&p_comp->cond);
+    }
+    pthread_mutex_unlock(&p_comp->lock);
+    break;
+  case OMX_CommandPortEnable:
+  case OMX_CommandPortDisable:
+    pthread_mutex_lock(&p_comp->lock);
+    for (i = 0; i < QOMX_JPEGENC_SW_NUM_PORTS; i++) {
+      if ((OMX_ALL == nParam1) || (i == nParam1)) {
+        p_comp->ports[i].def.bEnabled =
+          (OMX_CommandPortEnable == Cmd) ? OMX_TRUE : OMX_FALSE;
+      }
+    }
+    pthread_cond_signal(&p_comp->cond);
+    pthread_mutex_unlock(&p_comp->lock);
+    if ((OMX_ALL != nParam1) && (nParam1 >= QOMX_JPEGENC_SW_NUM_PORTS)) {
+      return OMX_ErrorBadPortIndex;
+    }
+    qomx_jpegenc_sw_event(p_comp, OMX_EventCmdComplete, Cmd, nParam1);
+    break;
+  default:
+    rc = OMX_ErrorNotImplemented;
+    break;
+  }
+  if (OMX_ErrorNone != rc) {
+    ALOGE("%s:%d] cmd %d param %d failed %d", __func__, __LINE__, Cmd,
+      (int)nParam1, rc);
+  }
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_set
+* Parameters: p_comp, index, p_data
+* Return Value : OMX_ERRORTYPE
+* Description: Common handler for SetParameter and SetConfig, the client
+* uses both for the extension indices
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_set(qomx_jpegenc_sw_comp_t *p_comp,
+  int index, OMX_PTR p_data)
+{
+  OMX_PARAM_PORTDEFINITIONTYPE *p_def;
+  OMX_IMAGE_PARAM_QFACTORTYPE *p_qfactor;
+  OMX_IMAGE_PARAM_QUANTIZATIONTABLETYPE *p_qtable;
+  OMX_CONFIG_ROTATIONTYPE *p_rotate;
+  QOMX_EXIF_INFO *p_exif_info;
+  QEXIF_INFO_DATA *p_exif;
+  uint32_t i, size, table;
+  int rotation;
+
+  switch (index) {
+  case OMX_IndexParamPortDefinition:
+    p_def = (OMX_PARAM_PORTDEFINITIONTYPE *)p_data;
+    if (p_def->nPortIndex >= QOMX_JPEGENC_SW_NUM_PORTS) {
+      return OMX_ErrorBadPortIndex;
+    }
+    p_comp->ports[p_def->nPortIndex].def.format = p_def->format;
+    p_comp->ports[p_def->nPortIndex].def.nBufferCountActual =
+      p_def->nBufferCountActual;
+    p_comp->ports[p_def->nPortIndex].def.nBufferSize = p_def->nBufferSize;
+    break;
+  case OMX_IndexConfigCommonRotate:
+    p_rotate = (OMX_CONFIG_ROTATIONTYPE *)p_data;
+    rotation = p_rotate->nRotation % 360;
+    if (rotation < 0) {
+      rotation += 360;
+    }
+    if (rotation % 90) {
+      return OMX_ErrorBadParameter;
+    }
+    p_comp->rotation = (uint32_t)rotation;
+    break;
+  case OMX_IndexConfigCommonInputCrop:
+    p_comp->in_crop = *(OMX_CONFIG_RECTTYPE *)p_data;
+    break;
+  case OMX_IndexConfigCommonOutputCrop:
+    p_comp->out_crop = *(OMX_CONFIG_RECTTYPE *)p_data;
+    break;
+  case OMX_IndexParamQFactor:
+    p_qfactor = (OMX_IMAGE_PARAM_QFACTORTYPE *)p_data;
+    jpegenc_sw_set_quality(p_comp->qtable, p_qfactor->nQFactor);
+    break;
+  case OMX_IndexParamQuantizationTable:
+    p_qtable = (OMX_IMAGE_PARAM_QUANTIZATIONTABLETYPE *)p_data;
+    table = (OMX_IMAGE_QuantizationTableLuma == p_qtable->eQuantizationTable) ?
+      0 : 1;
+    for (i = 0; i < 64; i++) {
+      p_comp->qtable[table][i] = p_qtable->nQuantizationMatrix[i] ?
+        p_qtable->nQuantizationMatrix[i] : 1;
+    }
+    break;
+  case QOMX_IMAGE_EXT_BUFFER_OFFSET:
+    p_comp->main_offset = *(QOMX_YUV_FRAME_INFO *)p_data;
+    break;
+  case QOMX_IMAGE_EXT_THUMBNAIL:
+    p_comp->thumb_info = *(QOMX_THUMBNAIL_INFO *)p_data;
+    p_comp->thumb_set = OMX_TRUE;
+    break;
+  case QOMX_IMAGE_EXT_MEM_OPS:
+    p_comp->mem_ops = *(QOMX_MEM_OPS *)p_data;
+    break;
+  case QOMX_IMAGE_EXT_STREAMING:
+    p_comp->streaming = *(QOMX_JPEG_STREAMING *)p_data;
+    break;
+  case QOMX_IMAGE_EXT_EXIF:
+    p_exif_info = (QOMX_EXIF_INFO *)p_data;
+    if (!p_exif_info->numOfEntries) {
+      break;
+    }
+    if (!p_exif_info->exif_data) {
+      return OMX_ErrorBadParameter;
+    }
+    size = p_comp->num_exif + p_exif_info->numOfEntries;
+    if (size > p_comp->exif_size) {
+      p_exif = realloc(p_comp->p_exif, size * sizeof(*p_exif));
+      if (NULL == p_exif) {
+        return OMX_ErrorInsufficientResources;
+      }
+      p_comp->p_exif = p_exif;
+      p_comp->exif_size = size;
+    }
+    memcpy(&p_comp->p_exif[p_comp->num_exif], p_exif_info->exif_data,
+      p_exif_info->numOfEntries * sizeof(*p_exif));
+    p_comp->num_exif = size;
+    break;
+  case QOMX_IMAGE_EXT_ENCODING_MODE:
+  case QOMX_IMAGE_EXT_JPEG_SPEED:
+  case QOMX_IMAGE_EXT_WORK_BUFFER:
+  case QOMX_IMAGE_EXT_METADATA:
+  case QOMX_IMAGE_EXT_META_ENC_KEY:
+    /* no hardware settings to apply */
+    break;
+  default:
+    ALOGE("%s:%d] unsupported index %x", __func__, __LINE__, index);
+    return OMX_ErrorUnsupportedIndex;
+  }
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_set_parameter
+* Parameters: hComp, nIndex, pData
+* Return Value : OMX_ERRORTYPE
+* Description: Set a parameter
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_set_parameter(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_INDEXTYPE nIndex,
+  OMX_IN OMX_PTR pData)
+{
+  qomx_jpegenc_sw_comp_t *p_comp = qomx_jpegenc_sw_get_comp(hComp);
+  OMX_ERRORTYPE rc;
+
+  if (!p_comp || !pData) {
+    return OMX_ErrorBadParameter;
+  }
+  pthread_mutex_lock(&p_comp->lock);
+  rc = qomx_jpegenc_sw_set(p_comp, (int)nIndex, pData);
+  pthread_mutex_unlock(&p_comp->lock);
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_set_config
+* Parameters: hComp, nIndex, pConfig
+* Return Value : OMX_ERRORTYPE
+* Description: Set a configuration
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_set_config(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_INDEXTYPE nIndex,
+  OMX_IN OMX_PTR pConfig)
+{
+  return qomx_jpegenc_sw_set_parameter(hComp, nIndex, pConfig);
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_get_parameter
+* Parameters: hComp, nParamIndex, pComponentParameterStructure
+* Return Value : OMX_ERRORTYPE
+* Description: Get a parameter, only the port definitions are readable
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_get_parameter(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_INDEXTYPE nParamIndex,
+  OMX_INOUT OMX_PTR pComponentParameterStructure)
+{
+  qomx_jpegenc_sw_comp_t *p_comp = qomx_jpegenc_sw_get_comp(hComp);
+  OMX_PARAM_PORTDEFINITIONTYPE *p_def =
+    (OMX_PARAM_PORTDEFINITIONTYPE *)pComponentParameterStructure;
+
+  if (!p_comp || !p_def) {
+    return OMX_ErrorBadParameter;
+  }
+  if (OMX_IndexParamPortDefinition != nParamIndex) {
+    return OMX_ErrorUnsupportedIndex;
+  }
+  if (p_def->nPortIndex >= QOMX_JPEGENC_SW_NUM_PORTS) {
+    return OMX_ErrorBadPortIndex;
+  }
+  pthread_mutex_lock(&p_comp->lock);
+  *p_def = p_comp->ports[p_def->nPortIndex].def;
+  pthread_mutex_unlock(&p_comp->lock);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_get_config
+* Parameters: hComp, nIndex, pComponentConfigStructure
+* Return Value : OMX_ERRORTYPE
+* Description: No configuration is readable
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_get_config(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_INDEXTYPE nIndex,
+  OMX_INOUT OMX_PTR pComponentConfigStructure)
+{
+  (void)hComp;
+  (void)nIndex;
+  (void)pComponentConfigStructure;
+  return OMX_ErrorUnsupportedIndex;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_get_extension_index
+* Parameters: hComp, cParameterName, pIndexType
+* Return Value : OMX_ERRORTYPE
+* Description: Map an extension name to its index
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_get_extension_index(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_STRING cParameterName,
+  OMX_OUT OMX_INDEXTYPE* pIndexType)
+{
+  uint32_t i;
+
+  if (!qomx_jpegenc_sw_get_comp(hComp) || !cParameterName || !pIndexType) {
+    return OMX_ErrorBadParameter;
+  }
+  for (i = 0; i < sizeof(g_extensions) / sizeof(g_extensions[0]); i++) {
+    if (!strcmp(cParameterName, g_extensions[i].name)) {
+      *pIndexType = (OMX_INDEXTYPE)g_extensions[i].index;
+      return OMX_ErrorNone;
+    }
+  }
+  return OMX_ErrorUnsupportedIndex;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_get_state
+* Parameters: hComp, pState
+* Return Value : OMX_ERRORTYPE
+* Description: Get the current state
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_get_state(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_OUT OMX_STATETYPE* pState)
+{
+  qomx_jpegenc_sw_comp_t *p_comp = qomx_jpegenc_sw_get_comp(hComp);
+
+  if (!p_comp || !pState) {
+    return OMX_ErrorBadParameter;
+  }
+  pthread_mutex_lock(&p_comp->lock);
+  *pState = p_comp->state;
+  pthread_mutex_unlock(&p_comp->lock);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_use_buffer
+* Parameters: hComp, ppBufferHdr, nPortIndex, pAppPrivate, nSizeBytes,
+*   pBuffer
+* Return Value : OMX_ERRORTYPE
+* Description: Register a client buffer while moving from loaded to idle
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_use_buffer(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_INOUT OMX_BUFFERHEADERTYPE** ppBufferHdr,
+  OMX_IN OMX_U32 nPortIndex,
+  OMX_IN OMX_PTR pAppPrivate,
+  OMX_IN OMX_U32 nSizeBytes,
+  OMX_IN OMX_U8* pBuffer)
+{
+  qomx_jpegenc_sw_comp_t *p_comp = qomx_jpegenc_sw_get_comp(hComp);
+  qomx_jpegenc_sw_port_t *p_port;
+  OMX_BUFFERHEADERTYPE *p_buf;
+  OMX_ERRORTYPE rc = OMX_ErrorNone;
+
+  if (!p_comp || !ppBufferHdr || !pBuffer) {
+    return OMX_ErrorBadParameter;
+  }
+  if (nPortIndex >= QOMX_JPEGENC_SW_NUM_PORTS) {
+    return OMX_ErrorBadPortIndex;
+  }
+
+  pthread_mutex_lock(&p_comp->lock);
+  p_port = &p_comp->ports[nPortIndex];
+  if ((OMX_StateLoaded != p_comp->state) || !p_comp->state_pending) {
+    rc = OMX_ErrorIncorrectStateOperation;
+  } else if (p_port->num_bufs >= QOMX_JPEGENC_SW_MAX_BUFS) {
+    rc = OMX_ErrorInsufficientResources;
+  } else if (NULL == (p_buf = calloc(1, sizeof(*p_buf)))) {
+    rc = OMX_ErrorInsufficientResources;
+  } else {
+    p_buf->nSize = sizeof(*p_buf);
+    p_buf->nVersion.nVersion = OMX_VERSION;
+    p_buf->pBuffer = pBuffer;
+    p_buf->nAllocLen = nSizeBytes;
+    p_buf->pAppPrivate = pAppPrivate;
+    if (QOMX_JPEGENC_SW_PORT_OUT == nPortIndex) {
+      p_buf->nOutputPortIndex = nPortIndex;
+      p_buf->nInputPortIndex = OMX_ALL;
+    } else {
+      p_buf->nInputPortIndex = nPortIndex;
+      p_buf->nOutputPortIndex = OMX_ALL;
+    }
+    p_port->p_bufs[p_port->num_bufs++] = p_buf;
+    p_port->def.bPopulated = (p_port->num_bufs >=
+      p_port->def.nBufferCountActual) ? OMX_TRUE : OMX_FALSE;
+    *ppBufferHdr = p_buf;
+    pthread_cond_signal(&p_comp->cond);
+  }
+  pthread_mutex_unlock(&p_comp->lock);
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_free_buffer
+* Parameters: hComp, nPortIndex, pBuffer
+* Return Value : OMX_ERRORTYPE
+* Description: Release a buffer header
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_free_buffer(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_U32 nPortIndex,
+  OMX_IN OMX_BUFFERHEADERTYPE* pBuffer)
+{
+  qomx_jpegenc_sw_comp_t *p_comp = qomx_jpegenc_sw_get_comp(hComp);
+  qomx_jpegenc_sw_port_t *p_port;
+  uint32_t i;
+
+  if (!p_comp || !pBuffer) {
+    return OMX_ErrorBadParameter;
+  }
+  if (nPortIndex >= QOMX_JPEGENC_SW_NUM_PORTS) {
+    return OMX_ErrorBadPortIndex;
+  }
+
+  pthread_mutex_lock(&p_comp->lock);
+  p_port = &p_comp->ports[nPortIndex];
+  for (i = 0; i < p_port->num_bufs; i++) {
+    if (p_port->p_bufs[i] == pBuffer) {
+      break;
+    }
+  }
+  if (i == p_port->num_bufs) {
+    pthread_mutex_unlock(&p_comp->lock);
+    return OMX_ErrorBadParameter;
+  }
+  p_port->num_bufs--;
+  memmove(&p_port->p_bufs[i], &p_port->p_bufs[i + 1],
+    (p_port->num_bufs - i) * sizeof(p_port->p_bufs[0]));
+  for (i = 0; i < p_port->num_queued; i++) {
+    if (p_port->p_queue[i] == pBuffer) {
+      p_port->num_queued--;
+      memmove(&p_port->p_queue[i], &p_port->p_queue[i + 1],
+        (p_port->num_queued - i) * sizeof(p_port->p_queue[0]));
+      break;
+    }
+  }
+  p_port->def.bPopulated = OMX_FALSE;
+  free(pBuffer);
+  pthread_cond_signal(&p_comp->cond);
+  pthread_mutex_unlock(&p_comp->lock);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_queue_buffer
+* Parameters: hComp, pBuffer, nPortIndex
+* Return Value : OMX_ERRORTYPE
+* Description: Queue a buffer on a port for the component thread
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_queue_buffer(OMX_HANDLETYPE hComp,
+  OMX_BUFFERHEADERTYPE *pBuffer, OMX_U32 nPortIndex)
+{
+  qomx_jpegenc_sw_comp_t *p_comp = qomx_jpegenc_sw_get_comp(hComp);
+  qomx_jpegenc_sw_port_t *p_port;
+  OMX_ERRORTYPE rc = OMX_ErrorNone;
+
+  if (!p_comp || !pBuffer) {
+    return OMX_ErrorBadParameter;
+  }
+  if (nPortIndex >= QOMX_JPEGENC_SW_NUM_PORTS) {
+    return OMX_ErrorBadPortIndex;
+  }
+
+  pthread_mutex_lock(&p_comp->lock);
+  p_port = &p_comp->ports[nPortIndex];
+  if ((OMX_StateExecuting != p_comp->state) &&
+    (OMX_StatePause != p_comp->state)) {
+    rc = OMX_ErrorIncorrectStateOperation;
+  } else if (p_port->num_queued >= QOMX_JPEGENC_SW_MAX_BUFS) {
+    rc = OMX_ErrorInsufficientResources;
+  } else if ((pBuffer == p_comp->p_stream_out) && p_comp->stream_held) {
+    /* back from a partial return, the encode goes on filling it */
+    p_comp->stream_held = OMX_FALSE;
+    pthread_cond_signal(&p_comp->cond);
+  } else {
+    if (QOMX_JPEGENC_SW_PORT_OUT == nPortIndex) {
+      pBuffer->nFilledLen = 0;
+      pBuffer->nFlags = 0;
+    }
+    p_port->p_queue[p_port->num_queued++] = pBuffer;
+    pthread_cond_signal(&p_comp->cond);
+  }
+  pthread_mutex_unlock(&p_comp->lock);
+  return rc;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_empty_this_buffer
+* Parameters: hComp, pBuffer
+* Return Value : OMX_ERRORTYPE
+* Description: Queue a main image or thumbnail buffer
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_empty_this_buffer(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_BUFFERHEADERTYPE* pBuffer)
+{
+  if (!pBuffer) {
+    return OMX_ErrorBadParameter;
+  }
+  return qomx_jpegenc_sw_queue_buffer(hComp, pBuffer,
+    pBuffer->nInputPortIndex);
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_fill_this_buffer
+* Parameters: hComp, pBuffer
+* Return Value : OMX_ERRORTYPE
+* Description: Queue an output buffer
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_fill_this_buffer(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_BUFFERHEADERTYPE* pBuffer)
+{
+  return qomx_jpegenc_sw_queue_buffer(hComp, pBuffer,
+    QOMX_JPEGENC_SW_PORT_OUT);
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_set_callbacks
+* Parameters: hComp, pCallbacks, pAppData
+* Return Value : OMX_ERRORTYPE
+* Description: Set the client callbacks
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_set_callbacks(
+  OMX_IN OMX_HANDLETYPE hComp,
+  OMX_IN OMX_CALLBACKTYPE* pCallbacks,
+  OMX_IN OMX_PTR pAppData)
+{
+  qomx_jpegenc_sw_comp_t *p_comp = qomx_jpegenc_sw_get_comp(hComp);
+
+  if (!p_comp || !pCallbacks) {
+    return OMX_ErrorBadParameter;
+  }
+  pthread_mutex_lock(&p_comp->lock);
+  p_comp->callbacks = *pCallbacks;
+  p_comp->app_data = pAppData;
+  pthread_mutex_unlock(&p_comp->lock);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_deinit
+* Parameters: hComp
+* Return Value : OMX_ERRORTYPE
+* Description: Stop the component thread and free the component
+==============================================================================*/
+static OMX_ERRORTYPE qomx_jpegenc_sw_deinit(OMX_IN OMX_HANDLETYPE hComp)
+{
+  qomx_jpegenc_sw_comp_t *p_comp = qomx_jpegenc_sw_get_comp(hComp);
+  uint32_t i, j;
+
+  if (NULL == p_comp) {
+    return OMX_ErrorBadParameter;
+  }
+  pthread_mutex_lock(&p_comp->lock);
+  p_comp->exit = OMX_TRUE;
+  p_comp->abort = 1;
+  pthread_cond_signal(&p_comp->cond);
+  pthread_mutex_unlock(&p_comp->lock);
+  pthread_join(p_comp->thread, NULL);
+
+  for (i = 0; i < QOMX_JPEGENC_SW_NUM_PORTS; i++) {
+    for (j = 0; j < p_comp->ports[i].num_bufs; j++) {
+      free(p_comp->ports[i].p_bufs[j]);
+    }
+  }
+  if (p_comp->p_pool) {
+    jpegenc_sw_pool_destroy(p_comp->p_pool);
+  }
+  jpegenc_sw_buf_release(&p_comp->thumb_out);
+  jpegenc_sw_buf_release(&p_comp->app1);
+  jpegenc_sw_buf_release(&p_comp->main_out);
+  free(p_comp->p_exif);
+  pthread_cond_destroy(&p_comp->cond);
+  pthread_mutex_destroy(&p_comp->lock);
+
+  ((OMX_COMPONENTTYPE *)hComp)->pComponentPrivate = NULL;
+  free(p_comp);
+  free(hComp);
+  return OMX_ErrorNone;
+}
+
+/*==============================================================================
+* Function : qomx_jpegenc_sw_init_port
+* Parameters: p_port, index
+* Return Value : None
+* Description: Set the default port definition
+==============================================================================*/
+static void qomx_jpegenc_sw_init_port(qomx_jpegenc_sw_port_t *p_port,
+  uint32_t index)
+{
+  OMX_PARAM_PORTDEFINITIONTYPE *p_def = &p_port->def;
+
+  p_def->nSize = sizeof(*p_def);
+  p_def->nVersion.nVersion = OMX_VERSION;
+  p_def->nPortIndex = index;
+  p_def->eDir = (QOMX_JPEGENC_SW_PORT_OUT == index) ? OMX_DirOutput :
+    OMX_DirInput;
+  p_def->nBufferCountActual = 1;
+  p_def->nBufferCountMin = 1;
+  p_def->bEnabled = OMX_TRUE;
+  p_def->eDomain = OMX_PortDomainImage;
+  p_def->format.image.eCompressionFormat =
+    (QOMX_JPEGENC_SW_PORT_OUT == index) ? OMX_IMAGE_CodingJPEG :
+    OMX_IMAGE_CodingUnused;
+  p_def->format.image.eColorFormat =
+    (OMX_COLOR_FORMATTYPE)OMX_QCOM_IMG_COLOR_FormatYVU420SemiPlanar;
+}
+
+/*==============================================================================
+* Function : getInstance
+* Parameters: None
+* Return Value : component object, NULL on failure
+* Description: Entry point used by the OMX core, allocates the component
+* and starts its thread
+==============================================================================*/
+void *getInstance(void)
+{
+  qomx_jpegenc_sw_comp_t *p_comp;
+  uint32_t i;
+
+  p_comp = calloc(1, sizeof(*p_comp));
+  if (NULL == p_comp) {
+    ALOGE("%s:%d] no memory", __func__, __LINE__);
+    return NULL;
+  }
+  p_comp->state = p_comp->target_state = OMX_StateLoaded;
+  for (i = 0; i < QOMX_JPEGENC_SW_NUM_PORTS; i++) {
+    qomx_jpegenc_sw_init_port(&p_comp->ports[i], i);
+  }
+  jpegenc_sw_set_quality(p_comp->qtable, QOMX_JPEGENC_SW_DEFAULT_QUALITY);
+  pthread_mutex_init(&p_comp->lock, NULL);
+  pthread_cond_init(&p_comp->cond, NULL);
+  if (pthread_create(&p_comp->thread, NULL, qomx_jpegenc_sw_thread,
+    p_comp)) {
+    ALOGE("%s:%d] cannot create thread", __func__, __LINE__);
+    pthread_cond_destroy(&p_comp->cond);
+    pthread_mutex_destroy(&p_comp->lock);
+    free(p_comp);
+    return NULL;
+  }
+  return p_comp;
+}
+
+/*==============================================================================
+* Function : create_component_fns
+* Parameters: p_obj - object returned by getInstance
+* Return Value : OMX component handle, NULL on failure
+* Description: Entry point used by the OMX core, fills in the component
+* function table
+==============================================================================*/
+OMX_COMPONENTTYPE *create_component_fns(OMX_PTR p_obj)
+{
+  qomx_jpegenc_sw_comp_t *p_comp = (qomx_jpegenc_sw_comp_t *)p_obj;
+  OMX_COMPONENTTYPE *p_handle;
+
+  if (NULL == p_comp) {
+    return NULL;
+  }
+  p_handle = calloc(1, sizeof(*p_handle));
+  if (NULL == p_handle) {
+    ALOGE("%s:%d] no memory", __func__, __LINE__);
+    return NULL;
+  }
+  p_handle->nSize = sizeof(*p_handle);
+  p_handle->nVersion.nVersion = OMX_VERSION;
+  p_handle->pComponentPrivate = p_comp;
+  p_handle->GetComponentVersion = qomx_jpegenc_sw_get_component_version;
+  p_handle->SendCommand = qomx_jpegenc_sw_send_command;
+  p_handle->GetParameter = qomx_jpegenc_sw_get_parameter;
+  p_handle->SetParameter = qomx_jpegenc_sw_set_parameter;
+  p_handle->GetConfig = qomx_jpegenc_sw_get_config;
+  p_handle->SetConfig = qomx_jpegenc_sw_set_config;
+  p_handle->GetExtensionIndex = qomx_jpegenc_sw_get_extension_index;
+  p_handle->GetState = qomx_jpegenc_sw_get_state;
+  p_handle->UseBuffer = qomx_jpegenc_sw_use_buffer;
+  p_handle->FreeBuffer = qomx_jpegenc_sw_free_buffer;
+  p_handle->EmptyThisBuffer = qomx_jpegenc_sw_empty_this_buffer;
+  p_handle->FillThisBuffer = qomx_jpegenc_sw_fill_this_buffer;
+  p_handle->SetCallbacks = qomx_jpegenc_sw_set_callbacks;
+  p_handle->ComponentDeInit = qomx_jpegenc_sw_deinit;
+  p_comp->p_comp = p_handle;
+  return p_handle;
+}
@@ -0,0 +1,169 @@
+/*Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+
+#ifndef QOMX_JPEGENC_SW_H
+#define QOMX_JPEGENC_SW_H
+
+#include <pthread.h>
+#include "OMX_Component.h"
+#include "QOMX_JpegExtensions.h"
+#include "qomx_jpegenc_sw_core.h"
+
+#define QOMX_JPEGENC_SW_NAME "OMX.qcom.image.jpeg.encoder_sw"
+
+/* Port indices, same layout as the hardware encoder */
+#define QOMX_JPEGENC_SW_PORT_MAIN 0
+#define QOMX_JPEGENC_SW_PORT_OUT 1
+#define QOMX_JPEGENC_SW_PORT_THUMB 2
+#define QOMX_JPEGENC_SW_NUM_PORTS 3
+
+#define QOMX_JPEGENC_SW_MAX_BUFS 32
+#define QOMX_JPEGENC_SW_DEFAULT_QUALITY 85
+#define QOMX_JPEGENC_SW_THUMB_QUALITY 75
+
+/* Lowest quality tried before the thumbnail is dropped from the exif */
+#define QOMX_JPEGENC_SW_THUMB_MIN_QUALITY 30
+
+/** qomx_jpegenc_sw_port_t: Port state
+*    @def: port definition
+*    @p_bufs: buffer headers allocated on the port
+*    @num_bufs: number of buffer headers
+*    @p_queue: buffers queued by the client, oldest first
+*    @num_queued: number of queued buffers
+**/
+typedef struct {
+  OMX_PARAM_PORTDEFINITIONTYPE def;
+  OMX_BUFFERHEADERTYPE *p_bufs[QOMX_JPEGENC_SW_MAX_BUFS];
+  uint32_t num_bufs;
+  OMX_BUFFERHEADERTYPE *p_queue[QOMX_JPEGENC_SW_MAX_BUFS];
+  uint32_t num_queued;
+} qomx_jpegenc_sw_port_t;
+
+/** qomx_jpegenc_sw_job_t: Settings of one encode, copied from the
+*   component when the buffers are picked up
+*    @main_def: main image port definition
+*    @thumb_def: thumbnail port definition
+*    @main_offset: main image plane offsets
+*    @in_crop: main image crop
+*    @out_crop: main image scaled size
+*    @rotation: main image rotation
+*    @qtable: main image quantization tables
+*    @thumb_info: thumbnail settings
+*    @thumb_set: thumbnail settings were configured
+*    @p_exif: exif tags, owned by the job
+*    @num_exif: number of exif tags
+*    @mem_ops: output memory allocator
+*    @streaming: partial output settings
+**/
+typedef struct {
+  OMX_PARAM_PORTDEFINITIONTYPE main_def;
+  OMX_PARAM_PORTDEFINITIONTYPE thumb_def;
+  QOMX_YUV_FRAME_INFO main_offset;
+  OMX_CONFIG_RECTTYPE in_crop;
+  OMX_CONFIG_RECTTYPE out_crop;
+  uint32_t rotation;
+  uint8_t qtable[2][64];
+  QOMX_THUMBNAIL_INFO thumb_info;
+  uint8_t thumb_set;
+  QEXIF_INFO_DATA *p_exif;
+  uint32_t num_exif;
+  QOMX_MEM_OPS mem_ops;
+  QOMX_JPEG_STREAMING streaming;
+} qomx_jpegenc_sw_job_t;
+
+/** qomx_jpegenc_sw_comp_t: Software encoder component
+*    @p_comp: OMX component handle
+*    @callbacks: client callbacks
+*    @app_data: client data passed back in the callbacks
+*    @state: current state
+*    @target_state: state requested by the client
+*    @state_pending: a state transition is in progress
+*    @ports: input, output and thumbnail ports
+*    @main_offset: main image plane offsets
+*    @in_crop: main image crop
+*    @out_crop: main image scaled size
+*    @rotation: main image rotation
+*    @qtable: main image quantization tables
+*    @thumb_info: thumbnail settings
+*    @thumb_set: thumbnail settings were configured
+*    @p_exif: exif tags accumulated for the next encode
+*    @num_exif: number of exif tags
+*    @exif_size: allocated exif tag entries
+*    @mem_ops: output memory allocator
+*    @streaming: partial output settings for the next encode
+*    @p_stream_out: output buffer of the encode being streamed
+*    @stream_held: p_stream_out is with the client after a partial return
+*    @stream_len: output length returned with the last partial return
+*    @p_pool: encoder worker pool
+*    @thumb_out: encoded thumbnail
+*    @app1: exif marker segment
+*    @main_out: main image scratch buffer used with mem_ops
+*    @thread: component thread
+*    @lock: component lock
+*    @cond: signalled on every change the thread may act on
+*    @exit: the thread should exit
+*    @abort: stop the encode in progress
+**/
+typedef struct {
+  OMX_COMPONENTTYPE *p_comp;
+  OMX_CALLBACKTYPE callbacks;
+  OMX_PTR app_data;
+  OMX_STATETYPE state;
+  OMX_STATETYPE target_state;
+  uint8_t state_pending;
+  qomx_jpegenc_sw_port_t ports[QOMX_JPEGENC_SW_NUM_PORTS];
+  QOMX_YUV_FRAME_INFO main_offset;
+  OMX_CONFIG_RECTTYPE in_crop;
+  OMX_CONFIG_RECTTYPE out_crop;
+  uint32_t rotation;
+  uint8_t qtable[2][64];
+  QOMX_THUMBNAIL_INFO thumb_info;
+  uint8_t thumb_set;
+  QEXIF_INFO_DATA *p_exif;
+  uint32_t num_exif;
+  uint32_t exif_size;
+  QOMX_MEM_OPS mem_ops;
+  QOMX_JPEG_STREAMING streaming;
+  OMX_BUFFERHEADERTYPE *p_stream_out;
+  uint8_t stream_held;
+  uint32_t stream_len;
+  jpegenc_sw_pool_t *p_pool;
+  jpegenc_sw_buf_t thumb_out;
+  jpegenc_sw_buf_t app1;
+  jpegenc_sw_buf_t main_out;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int exit;
+  volatile int abort;
+} qomx_jpegenc_sw_comp_t;
+
+void *getInstance(void);
+OMX_COMPONENTTYPE *create_component_fns(OMX_PTR p_obj);
+
+#endif
@@ -0,0 +1,1328 @@
+/*Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+
+#define LOG_TAG "qomx_jpegenc_sw"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "qomx_jpegenc_sw_core.h"
+
+#define DCTSIZE 8
+#define DCTSIZE2 64
+#define MCU_MAX_BLOCKS 6
+
+/* Worst case size of one entropy coded MCU, with byte stuffing */
+#define MCU_MAX_BYTES (MCU_MAX_BLOCKS * DCTSIZE2 * 27 * 2 / 8 + 64)
+
+/* Initial size of the per band entropy coded buffers */
+#define BAND_BUF_MIN_SIZE (64 * 1024)
+
+/* Markers */
+#define M_SOI 0xD8
+#define M_EOI 0xD9
+#define M_SOF0 0xC0
+#define M_DHT 0xC4
+#define M_DQT 0xDB
+#define M_DRI 0xDD
+#define M_SOS 0xDA
+#define M_APP0 0xE0
+#define M_RST0 0xD0
+
+/** jpegenc_sw_huff_t: Derived huffman encoding table
+*    @code: code for each symbol
+*    @size: code length for each symbol, 0 if not present
+**/
+typedef struct {
+  uint16_t code[256];
+  uint8_t size[256];
+} jpegenc_sw_huff_t;
+
+/** jpegenc_sw_bits_t: Entropy coder state of one band
+*    @p_buf: output buffer of the band
+*    @acc: bit accumulator
+*    @nbits: number of valid bits in the accumulator
+*    @error: buffer allocation failed
+**/
+typedef struct {
+  jpegenc_sw_buf_t *p_buf;
+  uint64_t acc;
+  int nbits;
+  int error;
+} jpegenc_sw_bits_t;
+
+/** jpegenc_sw_job_t: Description of one image encode shared by
+*    all the workers
+*    @p_frame: input frame
+*    @num_comps: 1 for monochrome, 3 for 4:2:0 color
+*    @mcu_w: MCU width in pixels
+*    @mcu_h: MCU height in pixels
+*    @mcus_per_row: number of MCUs per MCU row
+*    @mcu_rows: number of MCU rows
+*    @rows_per_band: MCU rows per restart interval
+*    @num_bands: number of restart intervals
+*    @next_band: next band to be picked up by a worker
+*    @p_lx: luma byte offset indexed by output column
+*    @p_ly: luma byte offset indexed by output row
+*    @p_cx: chroma byte offset indexed by output chroma column
+*    @p_cy: chroma byte offset indexed by output chroma row
+*    @lstep: luma offsets of the 2x2 box filter neighbours
+*    @cstep: chroma offsets of the 2x2 box filter neighbours
+*    @box: average 2x2 input pixels per output pixel
+*    @cb_off: byte offset of Cb within a chroma pair
+*    @recip: quantization reciprocals in DCT output order
+*    @p_abort: set by the client to stop the encode
+*    @error: set by a worker if its band failed
+*    @p_done: bands that are encoded, only used when streaming
+*    @stitched: bands appended to the output so far when streaming
+*    @progress: streaming output callback
+*    @p_progress_data: data passed to progress
+**/
+typedef struct {
+  jpegenc_sw_frame_t *p_frame;
+  uint32_t num_comps;
+  uint32_t mcu_w;
+  uint32_t mcu_h;
+  uint32_t mcus_per_row;
+  uint32_t mcu_rows;
+  uint32_t rows_per_band;
+  uint32_t num_bands;
+  volatile int32_t next_band;
+  uint32_t *p_lx;
+  uint32_t *p_ly;
+  uint32_t *p_cx;
+  uint32_t *p_cy;
+  uint32_t lstep[2];
+  uint32_t cstep[2];
+  uint8_t box;
+  uint32_t cb_off;
+  float recip[2][DCTSIZE2];
+  volatile int *p_abort;
+  volatile int error;
+  uint8_t *p_done;
+  uint32_t stitched;
+  jpegenc_sw_progress_t progress;
+  void *p_progress_data;
+} jpegenc_sw_job_t;
+
+/** jpegenc_sw_pool: Worker pool
+*    @threads: worker threads
+*    @num_threads: number of workers, including the caller
+*    @lock: pool lock
+*    @work_cond: signalled when a new job is posted
+*    @done_cond: signalled when the last worker is done, and for every
+*              band done when streaming
+*    @p_job: current job
+*    @generation: incremented for every job posted
+*    @busy: number of workers still working on the job
+*    @exit: workers should exit
+*    @p_bands: per band entropy coded output, kept across jobs
+*    @num_band_bufs: number of entries in p_bands
+**/
+struct jpegenc_sw_pool {
+  pthread_t threads[JPEGENC_SW_MAX_THREADS];
+  uint32_t num_threads;
+  pthread_mutex_t lock;
+  pthread_cond_t work_cond;
+  pthread_cond_t done_cond;
+  jpegenc_sw_job_t *p_job;
+  uint32_t generation;
+  uint32_t busy;
+  int exit;
+  jpegenc_sw_buf_t *p_bands;
+  uint32_t num_band_bufs;
+};
+
+/* ITU-T T.81 Annex K tables */
+static const uint8_t std_luma_qtable[DCTSIZE2] = {
+  16, 11, 10, 16, 24, 40, 51, 61,
+  12, 12, 14, 19, 26, 58, 60, 55,
+  14, 13, 16, 24, 40, 57, 69, 56,
+  14, 17, 22, 29, 51, 87, 80, 62,
+  18, 22, 37, 56, 68, 109, 103, 77,
+  24, 35, 55, 64, 81, 104, 113, 92,
+  49, 64, 78, 87, 103, 121, 120, 101,
+  72, 92, 95, 98, 112, 100, 103, 99
+};
+
+static const uint8_t std_chroma_qtable[DCTSIZE2] = {
+  17, 18, 24, 47, 99, 99, 99, 99,
+  18, 21, 26, 66, 99, 99, 99, 99,
+  24, 26, 56, 99, 99, 99, 99, 99,
+  47, 66, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99,
+  99, 99, 99, 99, 99, 99, 99, 99
+};
+
+static const uint8_t dc_luma_bits[17] =
+  { 0, 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t dc_luma_vals[] =
+  { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t dc_chroma_bits[17] =
+  { 0, 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8_t dc_chroma_vals[] =
+  { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t ac_luma_bits[17] =
+  { 0, 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uint8_t ac_luma_vals[] = {
+  0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
+  0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+  0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+  0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+  0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16,
+  0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+  0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+  0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+  0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+  0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
+  0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+  0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98,
+  0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+  0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+  0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+  0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4,
+  0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+  0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+  0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+  0xf9, 0xfa
+};
+
+static const uint8_t ac_chroma_bits[17] =
+  { 0, 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8_t ac_chroma_vals[] = {
+  0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21,
+  0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+  0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+  0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+  0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34,
+  0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+  0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38,
+  0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+  0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+  0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+  0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+  0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+  0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96,
+  0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+  0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+  0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+  0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2,
+  0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+  0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9,
+  0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+  0xf9, 0xfa
+};
+
+/* natural order index of each zigzag position */
+static const uint8_t natural_order[DCTSIZE2] = {
+  0, 1, 8, 16, 9, 2, 3, 10,
+  17, 24, 32, 25, 18, 11, 4, 5,
+  12, 19, 26, 33, 40, 48, 41, 34,
+  27, 20, 13, 6, 7, 14, 21, 28,
+  35, 42, 49, 56, 57, 50, 43, 36,
+  29, 22, 15, 23, 30, 37, 44, 51,
+  58, 59, 52, 45, 38, 31, 39, 46,
+  53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/* AAN scale factors, cos(k*PI/16) * sqrt(2) for k > 0 */
+static const float aan_scale[DCTSIZE] = {
+  1.0f, 1.387039845f, 1.306562965f, 1.175875602f,
+  1.0f, 0.785694958f, 0.541196100f, 0.275899379f
+};
+
+static pthread_once_t g_tables_once = PTHREAD_ONCE_INIT;
+static jpegenc_sw_huff_t g_dc_huff[2];
+static jpegenc_sw_huff_t g_ac_huff[2];
+
+/* position of each zigzag coefficient in the transposed DCT output */
+static uint8_t g_zigzag_src[DCTSIZE2];
+
+/*==============================================================================
+* Function : jpegenc_sw_derive_huff
+* Parameters: p_bits, p_vals, p_huff
+* Return Value : None
+* Description: Generate the code table from the BITS/HUFFVAL lists as
+* described in T.81 Annex C
+==============================================================================*/
+static void jpegenc_sw_derive_huff(const uint8_t *p_bits,
+  const uint8_t *p_vals, jpegenc_sw_huff_t *p_huff)
+{
+  uint32_t code = 0;
+  int len, i, k = 0;
+
+  memset(p_huff, 0, sizeof(*p_huff));
+  for (len = 1; len <= 16; len++) {
+    for (i = 0; i < p_bits[len]; i++) {
+      p_huff->code[p_vals[k]] = (uint16_t)code;
+      p_huff->size[p_vals[k]] = (uint8_t)len;
+      code++;
+      k++;
+    }
+    code <<= 1;
+  }
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_init_tables
+* Parameters: None
+* Return Value : None
+* Description: One time initialization of the constant tables
+==============================================================================*/
+static void jpegenc_sw_init_tables(void)
+{
+  int k, nat;
+
+  jpegenc_sw_derive_huff(dc_luma_bits, dc_luma_vals, &g_dc_huff[0]);
+  jpegenc_sw_derive_huff(dc_chroma_bits, dc_chroma_vals, &g_dc_huff[1]);
+  jpegenc_sw_derive_huff(ac_luma_bits, ac_luma_vals, &g_ac_huff[0]);
+  jpegenc_sw_derive_huff(ac_chroma_bits, ac_chroma_vals, &g_ac_huff[1]);
+
+  for (k = 0; k < DCTSIZE2; k++) {
+    nat = natural_order[k];
+    g_zigzag_src[k] = (uint8_t)((nat % DCTSIZE) * DCTSIZE + nat / DCTSIZE);
+  }
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_set_quality
+* Parameters: qtable, quality
+* Return Value : None
+* Description: Scale the standard quantization tables to the given
+* quality using the IJG convention
+==============================================================================*/
+void jpegenc_sw_set_quality(uint8_t qtable[2][64], uint32_t quality)
+{
+  uint32_t scale, i;
+  uint32_t val;
+
+  if (quality < 1) {
+    quality = 1;
+  } else if (quality > 100) {
+    quality = 100;
+  }
+  scale = (quality < 50) ? (5000 / quality) : (200 - quality * 2);
+
+  for (i = 0; i < DCTSIZE2; i++) {
+    val = (std_luma_qtable[i] * scale + 50) / 100;
+    qtable[0][i] = (uint8_t)((val < 1) ? 1 : ((val > 255) ? 255 : val));
+    val = (std_chroma_qtable[i] * scale + 50) / 100;
+    qtable[1][i] = (uint8_t)((val < 1) ? 1 : ((val > 255) ? 255 : val));
+  }
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_buf_reserve
+* Parameters: p_buf, extra
+* Return Value : 0 on success, -1 if the buffer cannot hold extra bytes
+* Description: Make sure there is room for extra more bytes
+==============================================================================*/
+static int jpegenc_sw_buf_reserve(jpegenc_sw_buf_t *p_buf, uint32_t extra)
+{
+  uint32_t new_size;
+  uint8_t *p_data;
+
+  if (p_buf->size - p_buf->len >= extra) {
+    return 0;
+  }
+  if (p_buf->fixed) {
+    return -1;
+  }
+  new_size = p_buf->size ? p_buf->size : BAND_BUF_MIN_SIZE;
+  while (new_size - p_buf->len < extra) {
+    new_size *= 2;
+  }
+  p_data = realloc(p_buf->p_data, new_size);
+  if (NULL == p_data) {
+    return -1;
+  }
+  p_buf->p_data = p_data;
+  p_buf->size = new_size;
+  return 0;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_buf_release
+* Parameters: p_buf
+* Return Value : None
+* Description: Free a buffer allocated by the encoder
+==============================================================================*/
+void jpegenc_sw_buf_release(jpegenc_sw_buf_t *p_buf)
+{
+  if (!p_buf->fixed) {
+    free(p_buf->p_data);
+  }
+  memset(p_buf, 0, sizeof(*p_buf));
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_put_bits
+* Parameters: p_bits, code, size
+* Return Value : None
+* Description: Append size bits to the entropy coded segment. The caller
+* has reserved MCU_MAX_BYTES for the current MCU
+==============================================================================*/
+static inline void jpegenc_sw_put_bits(jpegenc_sw_bits_t *p_bits,
+  uint32_t code, int size)
+{
+  jpegenc_sw_buf_t *p_buf;
+  uint8_t c;
+
+  p_bits->acc = (p_bits->acc << size) | (code & ((1U << size) - 1));
+  p_bits->nbits += size;
+  if (p_bits->nbits < 32) {
+    return;
+  }
+  p_buf = p_bits->p_buf;
+  while (p_bits->nbits >= 8) {
+    p_bits->nbits -= 8;
+    c = (uint8_t)(p_bits->acc >> p_bits->nbits);
+    p_buf->p_data[p_buf->len++] = c;
+    if (0xFF == c) {
+      p_buf->p_data[p_buf->len++] = 0;
+    }
+  }
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_flush_bits
+* Parameters: p_bits
+* Return Value : None
+* Description: Pad the last byte of the segment with ones and flush it
+==============================================================================*/
+static void jpegenc_sw_flush_bits(jpegenc_sw_bits_t *p_bits)
+{
+  jpegenc_sw_buf_t *p_buf = p_bits->p_buf;
+  uint8_t c;
+
+  jpegenc_sw_put_bits(p_bits, 0x7F, 7);
+  while (p_bits->nbits >= 8) {
+    p_bits->nbits -= 8;
+    c = (uint8_t)(p_bits->acc >> p_bits->nbits);
+    p_buf->p_data[p_buf->len++] = c;
+    if (0xFF == c) {
+      p_buf->p_data[p_buf->len++] = 0;
+    }
+  }
+  p_bits->nbits = 0;
+  p_bits->acc = 0;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_fdct_pass
+* Parameters: p_data
+* Return Value : None
+* Description: One pass of the AAN float forward DCT over the columns of
+* an 8x8 block. Every statement works on 8 independent columns so the
+* compiler can vectorize the pass
+==============================================================================*/
+static inline void jpegenc_sw_fdct_pass(float *p_data)
+{
+  float tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+  float tmp10, tmp11, tmp12, tmp13;
+  float z1, z2, z3, z4, z5, z11, z13;
+  int i;
+
+  for (i = 0; i < DCTSIZE; i++) {
+    tmp0 = p_data[i + 8 * 0] + p_data[i + 8 * 7];
+    tmp7 = p_data[i + 8 * 0] - p_data[i + 8 * 7];
+    tmp1 = p_data[i + 8 * 1] + p_data[i + 8 * 6];
+    tmp6 = p_data[i + 8 * 1] - p_data[i + 8 * 6];
+    tmp2 = p_data[i + 8 * 2] + p_data[i + 8 * 5];
+    tmp5 = p_data[i + 8 * 2] - p_data[i + 8 * 5];
+    tmp3 = p_data[i + 8 * 3] + p_data[i + 8 * 4];
+    tmp4 = p_data[i + 8 * 3] - p_data[i + 8 * 4];
+
+    /* even part */
+    tmp10 = tmp0 + tmp3;
+    tmp13 = tmp0 - tmp3;
+    tmp11 = tmp1 + tmp2;
+    tmp12 = tmp1 - tmp2;
+
+    p_data[i + 8 * 0] = tmp10 + tmp11;
+    p_data[i + 8 * 4] = tmp10 - tmp11;
+
+    z1 = (tmp12 + tmp13) * 0.707106781f;
+    p_data[i + 8 * 2] = tmp13 + z1;
+    p_data[i + 8 * 6] = tmp13 - z1;
+
+    /* odd part */
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+
+    z5 = (tmp10 - tmp12) * 0.382683433f;
+    z2 = 0.541196100f * tmp10 + z5;
+    z4 = 1.306562965f * tmp12 + z5;
+    z3 = tmp11 * 0.707106781f;
+
+    z11 = tmp7 + z3;
+    z13 = tmp7 - z3;
+
+    p_data[i + 8 * 5] = z13 + z2;
+    p_data[i + 8 * 3] = z13 - z2;
+    p_data[i + 8 * 1] = z11 + z4;
+    p_data[i + 8 * 7] = z11 - z4;
+  }
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_fdct_quant
+* Parameters: p_data, p_recip, p_coef
+* Return Value : None
+* Description: 2D forward DCT and quantization of one block. The second
+* column pass runs on the transposed block, so the output is transposed
+* which is accounted for by g_zigzag_src and the reciprocal table
+==============================================================================*/
+static void jpegenc_sw_fdct_quant(float *p_data, const float *p_recip,
+  int16_t *p_coef)
+{
+  float tmp[DCTSIZE2];
+  float v;
+  int i, j;
+
+  jpegenc_sw_fdct_pass(p_data);
+  for (i = 0; i < DCTSIZE; i++) {
+    for (j = 0; j < DCTSIZE; j++) {
+      tmp[j * DCTSIZE + i] = p_data[i * DCTSIZE + j];
+    }
+  }
+  jpegenc_sw_fdct_pass(tmp);
+
+  for (i = 0; i < DCTSIZE2; i++) {
+    /* round to nearest, the bias keeps the truncation positive */
+    v = tmp[i] * p_recip[i] + 16384.5f;
+    p_coef[i] = (int16_t)((int)v - 16384);
+  }
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_encode_block
+* Parameters: p_bits, p_coef, p_last_dc, comp
+* Return Value : None
+* Description: Huffman code one quantized block
+==============================================================================*/
+static void jpegenc_sw_encode_block(jpegenc_sw_bits_t *p_bits,
+  const int16_t *p_coef, int *p_last_dc, int comp)
+{
+  const jpegenc_sw_huff_t *p_dc = &g_dc_huff[comp];
+  const jpegenc_sw_huff_t *p_ac = &g_ac_huff[comp];
+  int temp, temp2, nbits, k, r = 0, sym;
+
+  temp = temp2 = p_coef[0] - *p_last_dc;
+  *p_last_dc = p_coef[0];
+  if (temp < 0) {
+    temp = -temp;
+    temp2--;
+  }
+  nbits = temp ? (32 - __builtin_clz(temp)) : 0;
+  jpegenc_sw_put_bits(p_bits, p_dc->code[nbits], p_dc->size[nbits]);
+  if (nbits) {
+    jpegenc_sw_put_bits(p_bits, (uint32_t)temp2, nbits);
+  }
+
+  for (k = 1; k < DCTSIZE2; k++) {
+    temp = p_coef[g_zigzag_src[k]];
+    if (0 == temp) {
+      r++;
+      continue;
+    }
+    while (r > 15) {
+      jpegenc_sw_put_bits(p_bits, p_ac->code[0xF0], p_ac->size[0xF0]);
+      r -= 16;
+    }
+    temp2 = temp;
+    if (temp < 0) {
+      temp = -temp;
+      temp2--;
+    }
+    nbits = 32 - __builtin_clz(temp);
+    if (nbits > 10) {
+      /* 8 bit AC coefficients fit in 10 bits, clamp rounding overshoot */
+      nbits = 10;
+      temp2 = (temp2 < 0) ? -1024 : 1023;
+    }
+    sym = (r << 4) + nbits;
+    jpegenc_sw_put_bits(p_bits, p_ac->code[sym], p_ac->size[sym]);
+    jpegenc_sw_put_bits(p_bits, (uint32_t)temp2, nbits);
+    r = 0;
+  }
+  if (r > 0) {
+    jpegenc_sw_put_bits(p_bits, p_ac->code[0], p_ac->size[0]);
+  }
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_fetch_block
+* Parameters: p_plane, p_x, p_y, step, box, p_data
+* Return Value : None
+* Description: Gather an 8x8 block of samples through the column and row
+* offset maps and level shift them. The maps already include crop, scale,
+* rotation and edge replication
+==============================================================================*/
+static inline void jpegenc_sw_fetch_block(const uint8_t *p_plane,
+  const uint32_t *p_x, const uint32_t *p_y, const uint32_t *step,
+  uint8_t box, float *p_data)
+{
+  const uint8_t *p_row;
+  int i, j;
+
+  for (j = 0; j < DCTSIZE; j++) {
+    p_row = p_plane + p_y[j];
+    if (box) {
+      for (i = 0; i < DCTSIZE; i++) {
+        const uint8_t *p = p_row + p_x[i];
+        p_data[j * DCTSIZE + i] = (float)((p[0] + p[step[0]] + p[step[1]] +
+          p[step[0] + step[1]] + 2) >> 2) - 128.0f;
+      }
+    } else {
+      for (i = 0; i < DCTSIZE; i++) {
+        p_data[j * DCTSIZE + i] = (float)p_row[p_x[i]] - 128.0f;
+      }
+    }
+  }
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_encode_band
+* Parameters: p_job, band, p_out
+* Return Value : 0 on success, -1 on failure
+* Description: Encode the MCU rows of one restart interval into its own
+* entropy coded segment. DC prediction restarts at every band so the
+* bands can be coded independently
+==============================================================================*/
+static int jpegenc_sw_encode_band(jpegenc_sw_job_t *p_job, uint32_t band,
+  jpegenc_sw_buf_t *p_out)
+{
+  jpegenc_sw_frame_t *p_frame = p_job->p_frame;
+  jpegenc_sw_bits_t bits;
+  float data[DCTSIZE2];
+  int16_t coef[DCTSIZE2];
+  int last_dc[3] = {0, 0, 0};
+  uint32_t row, row_end, mcu, bx, by, x0, y0;
+
+  memset(&bits, 0, sizeof(bits));
+  bits.p_buf = p_out;
+  p_out->len = 0;
+
+  row = band * p_job->rows_per_band;
+  row_end = row + p_job->rows_per_band;
+  if (row_end > p_job->mcu_rows) {
+    row_end = p_job->mcu_rows;
+  }
+
+  for (; row < row_end; row++) {
+    if (p_job->p_abort && *p_job->p_abort) {
+      return -1;
+    }
+    y0 = row * p_job->mcu_h;
+    for (mcu = 0; mcu < p_job->mcus_per_row; mcu++) {
+      if (jpegenc_sw_buf_reserve(p_out, MCU_MAX_BYTES) < 0) {
+        ALOGE("%s:%d] cannot grow band buffer", __func__, __LINE__);
+        return -1;
+      }
+      x0 = mcu * p_job->mcu_w;
+      for (by = 0; by < p_job->mcu_h; by += DCTSIZE) {
+        for (bx = 0; bx < p_job->mcu_w; bx += DCTSIZE) {
+          jpegenc_sw_fetch_block(p_frame->p_luma, p_job->p_lx + x0 + bx,
+            p_job->p_ly + y0 + by, p_job->lstep, p_job->box, data);
+          jpegenc_sw_fdct_quant(data, p_job->recip[0], coef);
+          jpegenc_sw_encode_block(&bits, coef, &last_dc[0], 0);
+        }
+      }
+      if (p_job->num_comps > 1) {
+        jpegenc_sw_fetch_block(p_frame->p_chroma + p_job->cb_off,
+          p_job->p_cx + x0 / 2, p_job->p_cy + y0 / 2, p_job->cstep,
+          p_job->box, data);
+        jpegenc_sw_fdct_quant(data, p_job->recip[1], coef);
+        jpegenc_sw_encode_block(&bits, coef, &last_dc[1], 1);
+
+        jpegenc_sw_fetch_block(p_frame->p_chroma + (1 - p_job->cb_off),
+          p_job->p_cx + x0 / 2, p_job->p_cy + y0 / 2, p_job->cstep,
+          p_job->box, data);
+        jpegenc_sw_fdct_quant(data, p_job->recip[1], coef);
+        jpegenc_sw_encode_block(&bits, coef, &last_dc[2], 1);
+      }
+    }
+  }
+  jpegenc_sw_flush_bits(&bits);
+  return 0;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_next_band
+* Parameters: p_pool, p_job, p_band
+* Return Value : 1 if a band was encoded, 0 if all are taken, -1 on failure
+* Description: Pick up the next band of the current job and encode it.
+* When streaming the band is marked done for the stitching thread
+==============================================================================*/
+static int jpegenc_sw_next_band(jpegenc_sw_pool_t *p_pool,
+  jpegenc_sw_job_t *p_job)
+{
+  int32_t band;
+  int rc = 1;
+
+  band = __sync_fetch_and_add(&p_job->next_band, 1);
+  if (band >= (int32_t)p_job->num_bands) {
+    return 0;
+  }
+  if (jpegenc_sw_encode_band(p_job, (uint32_t)band,
+    &p_pool->p_bands[band]) < 0) {
+    rc = -1;
+    /* let the other workers drain the job quickly */
+    p_job->error = 1;
+    p_job->next_band = (int32_t)p_job->num_bands;
+  }
+  if (p_job->p_done) {
+    pthread_mutex_lock(&p_pool->lock);
+    p_job->p_done[band] = 1;
+    pthread_cond_broadcast(&p_pool->done_cond);
+    pthread_mutex_unlock(&p_pool->lock);
+  }
+  return rc;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_run_bands
+* Parameters: p_pool, p_job
+* Return Value : 0 on success, -1 on failure
+* Description: Pick up bands of the current job until all are taken
+==============================================================================*/
+static int jpegenc_sw_run_bands(jpegenc_sw_pool_t *p_pool,
+  jpegenc_sw_job_t *p_job)
+{
+  int ret, rc = 0;
+
+  while ((ret = jpegenc_sw_next_band(p_pool, p_job)) != 0) {
+    if (ret < 0) {
+      rc = -1;
+    }
+  }
+  return rc;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_worker
+* Parameters: data - worker pool
+* Return Value : NULL
+* Description: Worker thread main loop
+==============================================================================*/
+static void *jpegenc_sw_worker(void *data)
+{
+  jpegenc_sw_pool_t *p_pool = (jpegenc_sw_pool_t *)data;
+  jpegenc_sw_job_t *p_job;
+  uint32_t generation = 0;
+
+  pthread_mutex_lock(&p_pool->lock);
+  while (1) {
+    while (!p_pool->exit && (generation == p_pool->generation)) {
+      pthread_cond_wait(&p_pool->work_cond, &p_pool->lock);
+    }
+    if (p_pool->exit) {
+      break;
+    }
+    generation = p_pool->generation;
+    p_job = p_pool->p_job;
+    pthread_mutex_unlock(&p_pool->lock);
+
+    jpegenc_sw_run_bands(p_pool, p_job);
+
+    pthread_mutex_lock(&p_pool->lock);
+    if (--p_pool->busy == 0) {
+      pthread_cond_signal(&p_pool->done_cond);
+    }
+  }
+  pthread_mutex_unlock(&p_pool->lock);
+  return NULL;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_pool_create
+* Parameters: num_threads - number of threads, 0 for one per online core
+* Return Value : worker pool, NULL on failure
+* Description: Create the worker pool. The calling thread also encodes,
+* so num_threads - 1 workers are spawned
+==============================================================================*/
+jpegenc_sw_pool_t *jpegenc_sw_pool_create(uint32_t num_threads)
+{
+  jpegenc_sw_pool_t *p_pool;
+  long cores;
+  uint32_t i;
+
+  pthread_once(&g_tables_once, jpegenc_sw_init_tables);
+
+  if (0 == num_threads) {
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = (cores > 0) ? (uint32_t)cores : 1;
+  }
+  if (num_threads > JPEGENC_SW_MAX_THREADS) {
+    num_threads = JPEGENC_SW_MAX_THREADS;
+  }
+
+  p_pool = calloc(1, sizeof(jpegenc_sw_pool_t));
+  if (NULL == p_pool) {
+    return NULL;
+  }
+  pthread_mutex_init(&p_pool->lock, NULL);
+  pthread_cond_init(&p_pool->work_cond, NULL);
+  pthread_cond_init(&p_pool->done_cond, NULL);
+
+  p_pool->num_threads = 1;
+  for (i = 1; i < num_threads; i++) {
+    if (pthread_create(&p_pool->threads[i], NULL, jpegenc_sw_worker,
+      p_pool)) {
+      ALOGE("%s:%d] cannot create worker %d", __func__, __LINE__, i);
+      break;
+    }
+    p_pool->num_threads++;
+  }
+  ALOGI("%s:%d] %d threads", __func__, __LINE__, p_pool->num_threads);
+  return p_pool;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_pool_destroy
+* Parameters: p_pool
+* Return Value : None
+* Description: Stop the workers and free the pool
+==============================================================================*/
+void jpegenc_sw_pool_destroy(jpegenc_sw_pool_t *p_pool)
+{
+  uint32_t i;
+
+  if (NULL == p_pool) {
+    return;
+  }
+  pthread_mutex_lock(&p_pool->lock);
+  p_pool->exit = 1;
+  pthread_cond_broadcast(&p_pool->work_cond);
+  pthread_mutex_unlock(&p_pool->lock);
+
+  for (i = 1; i < p_pool->num_threads; i++) {
+    pthread_join(p_pool->threads[i], NULL);
+  }
+  for (i = 0; i < p_pool->num_band_bufs; i++) {
+    jpegenc_sw_buf_release(&p_pool->p_bands[i]);
+  }
+  free(p_pool->p_bands);
+  pthread_cond_destroy(&p_pool->done_cond);
+  pthread_cond_destroy(&p_pool->work_cond);
+  pthread_mutex_destroy(&p_pool->lock);
+  free(p_pool);
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_pool_threads
+* Parameters: p_pool
+* Return Value : number of encoding threads
+* Description: Number of threads working on each encode
+==============================================================================*/
+uint32_t jpegenc_sw_pool_threads(jpegenc_sw_pool_t *p_pool)
+{
+  return p_pool->num_threads;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_build_map
+* Parameters: p_map, count, pad_count, start, span, limit, scale, reverse,
+* box
+* Return Value : None
+* Description: Fill the sample offsets of one output axis. Output index i
+* maps to the input sample at the center of its footprint within
+* [start, start + span), walked backwards if reverse is set. Indices
+* beyond count replicate the last sample. With box the offset points at
+* the first of the two samples averaged. Values are multiplied by scale
+* to turn them into byte offsets
+==============================================================================*/
+static void jpegenc_sw_build_map(uint32_t *p_map, uint32_t count,
+  uint32_t pad_count, uint32_t start, uint32_t span, uint32_t limit,
+  uint32_t scale, uint8_t reverse, uint8_t box)
+{
+  uint32_t i, idx, src;
+
+  for (i = 0; i < pad_count; i++) {
+    idx = (i < count) ? i : (count - 1);
+    if (reverse) {
+      idx = count - 1 - idx;
+    }
+    src = start + (uint32_t)(((2 * (uint64_t)idx + 1) * span) /
+      (2 * (uint64_t)count));
+    if (box && src > start) {
+      /* the 2x2 box covers src - 1 and src */
+      src--;
+    }
+    if (src + box >= limit) {
+      src = limit - 1 - box;
+    }
+    p_map[i] = src * scale;
+  }
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_put_marker
+* Parameters: p_buf, marker, len
+* Return Value : None
+* Description: Write a marker and its segment length
+==============================================================================*/
+static void jpegenc_sw_put_marker(jpegenc_sw_buf_t *p_buf, uint8_t marker,
+  uint32_t len)
+{
+  uint8_t *p = p_buf->p_data + p_buf->len;
+
+  p[0] = 0xFF;
+  p[1] = marker;
+  p_buf->len += 2;
+  if (len) {
+    p[2] = (uint8_t)(len >> 8);
+    p[3] = (uint8_t)(len & 0xFF);
+    p_buf->len += 2;
+  }
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_put_dht
+* Parameters: p_buf, index, p_bits, p_vals
+* Return Value : None
+* Description: Write one huffman table definition
+==============================================================================*/
+static void jpegenc_sw_put_dht(jpegenc_sw_buf_t *p_buf, uint8_t index,
+  const uint8_t *p_bits, const uint8_t *p_vals)
+{
+  uint32_t i, count = 0;
+
+  p_buf->p_data[p_buf->len++] = index;
+  for (i = 1; i <= 16; i++) {
+    p_buf->p_data[p_buf->len++] = p_bits[i];
+    count += p_bits[i];
+  }
+  memcpy(p_buf->p_data + p_buf->len, p_vals, count);
+  p_buf->len += count;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_write_headers
+* Parameters: p_job, p_config, width, height, p_app1, app1_len, p_out
+* Return Value : 0 on success, -1 on failure
+* Description: Write the JPEG headers up to and including SOS
+==============================================================================*/
+static int jpegenc_sw_write_headers(jpegenc_sw_job_t *p_job,
+  jpegenc_sw_config_t *p_config, uint32_t width, uint32_t height,
+  uint8_t *p_app1, uint32_t app1_len, jpegenc_sw_buf_t *p_out)
+{
+  static const uint8_t jfif[] = {
+    'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0
+  };
+  uint32_t ntables = (p_job->num_comps > 1) ? 2 : 1;
+  uint32_t i, t;
+  uint8_t *p;
+
+  if (jpegenc_sw_buf_reserve(p_out, app1_len + 1024) < 0) {
+    return -1;
+  }
+
+  jpegenc_sw_put_marker(p_out, M_SOI, 0);
+  if (p_app1 && app1_len) {
+    memcpy(p_out->p_data + p_out->len, p_app1, app1_len);
+    p_out->len += app1_len;
+  } else {
+    jpegenc_sw_put_marker(p_out, M_APP0, 2 + sizeof(jfif));
+    memcpy(p_out->p_data + p_out->len, jfif, sizeof(jfif));
+    p_out->len += sizeof(jfif);
+  }
+
+  jpegenc_sw_put_marker(p_out, M_DQT, 2 + 65 * ntables);
+  for (t = 0; t < ntables; t++) {
+    p_out->p_data[p_out->len++] = (uint8_t)t;
+    for (i = 0; i < DCTSIZE2; i++) {
+      p_out->p_data[p_out->len++] = p_config->qtable[t][natural_order[i]];
+    }
+  }
+
+  jpegenc_sw_put_marker(p_out, M_SOF0, 8 + 3 * p_job->num_comps);
+  p = p_out->p_data + p_out->len;
+  p[0] = 8;
+  p[1] = (uint8_t)(height >> 8);
+  p[2] = (uint8_t)(height & 0xFF);
+  p[3] = (uint8_t)(width >> 8);
+  p[4] = (uint8_t)(width & 0xFF);
+  p[5] = (uint8_t)p_job->num_comps;
+  p_out->len += 6;
+  for (i = 0; i < p_job->num_comps; i++) {
+    p = p_out->p_data + p_out->len;
+    p[0] = (uint8_t)(i + 1);
+    p[1] = (p_job->num_comps > 1 && 0 == i) ? 0x22 : 0x11;
+    p[2] = (i > 0) ? 1 : 0;
+    p_out->len += 3;
+  }
+
+  jpegenc_sw_put_marker(p_out, M_DHT, 2 + (ntables *
+    (2 * 17 + sizeof(dc_luma_vals) + sizeof(ac_luma_vals))));
+  jpegenc_sw_put_dht(p_out, 0x00, dc_luma_bits, dc_luma_vals);
+  jpegenc_sw_put_dht(p_out, 0x10, ac_luma_bits, ac_luma_vals);
+  if (ntables > 1) {
+    jpegenc_sw_put_dht(p_out, 0x01, dc_chroma_bits, dc_chroma_vals);
+    jpegenc_sw_put_dht(p_out, 0x11, ac_chroma_bits, ac_chroma_vals);
+  }
+
+  if (p_job->num_bands > 1) {
+    t = p_job->rows_per_band * p_job->mcus_per_row;
+    jpegenc_sw_put_marker(p_out, M_DRI, 4);
+    p_out->p_data[p_out->len++] = (uint8_t)(t >> 8);
+    p_out->p_data[p_out->len++] = (uint8_t)(t & 0xFF);
+  }
+
+  jpegenc_sw_put_marker(p_out, M_SOS, 6 + 2 * p_job->num_comps);
+  p_out->p_data[p_out->len++] = (uint8_t)p_job->num_comps;
+  for (i = 0; i < p_job->num_comps; i++) {
+    p_out->p_data[p_out->len++] = (uint8_t)(i + 1);
+    p_out->p_data[p_out->len++] = (i > 0) ? 0x11 : 0x00;
+  }
+  p_out->p_data[p_out->len++] = 0;
+  p_out->p_data[p_out->len++] = DCTSIZE2 - 1;
+  p_out->p_data[p_out->len++] = 0;
+  return 0;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_append_band
+* Parameters: p_pool, p_job, band, p_out
+* Return Value : 0 on success, -1 if the output buffer is too small
+* Description: Append the entropy coded data of a band to the output,
+* followed by its RSTn marker unless it is the last band
+==============================================================================*/
+static int jpegenc_sw_append_band(jpegenc_sw_pool_t *p_pool,
+  jpegenc_sw_job_t *p_job, uint32_t band, jpegenc_sw_buf_t *p_out)
+{
+  jpegenc_sw_buf_t *p_band = &p_pool->p_bands[band];
+
+  if (jpegenc_sw_buf_reserve(p_out, p_band->len + 4) < 0) {
+    ALOGE("%s:%d] output buffer too small", __func__, __LINE__);
+    return -1;
+  }
+  memcpy(p_out->p_data + p_out->len, p_band->p_data, p_band->len);
+  p_out->len += p_band->len;
+  if (band + 1 < p_job->num_bands) {
+    jpegenc_sw_put_marker(p_out, (uint8_t)(M_RST0 + (band & 7)), 0);
+  }
+  return 0;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_stitch_bands
+* Parameters: p_pool, p_job, p_out, wait
+* Return Value : 0 on success, -1 on failure
+* Description: Append the bands that are done, in order, and report the
+* new final length. With wait set it blocks until all bands are appended
+==============================================================================*/
+static int jpegenc_sw_stitch_bands(jpegenc_sw_pool_t *p_pool,
+  jpegenc_sw_job_t *p_job, jpegenc_sw_buf_t *p_out, int wait)
+{
+  uint32_t start = p_job->stitched;
+
+  pthread_mutex_lock(&p_pool->lock);
+  while (p_job->stitched < p_job->num_bands) {
+    if (p_job->error) {
+      pthread_mutex_unlock(&p_pool->lock);
+      return -1;
+    }
+    if (!p_job->p_done[p_job->stitched]) {
+      if (!wait) {
+        break;
+      }
+      pthread_cond_wait(&p_pool->done_cond, &p_pool->lock);
+      continue;
+    }
+    /* a band that is done is not written by the workers anymore */
+    pthread_mutex_unlock(&p_pool->lock);
+    if (jpegenc_sw_append_band(p_pool, p_job, p_job->stitched, p_out) < 0) {
+      return -1;
+    }
+    p_job->stitched++;
+    pthread_mutex_lock(&p_pool->lock);
+  }
+  pthread_mutex_unlock(&p_pool->lock);
+
+  if (p_job->stitched != start) {
+    p_job->progress(p_job->p_progress_data, p_out->len);
+  }
+  return 0;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_stream_bands
+* Parameters: p_pool, p_job, p_out
+* Return Value : 0 on success, -1 on failure
+* Description: Streaming variant of jpegenc_sw_run_bands for the calling
+* thread. It stitches the bands finished so far after each of its own,
+* then waits for the remaining ones
+==============================================================================*/
+static int jpegenc_sw_stream_bands(jpegenc_sw_pool_t *p_pool,
+  jpegenc_sw_job_t *p_job, jpegenc_sw_buf_t *p_out)
+{
+  int ret;
+
+  while ((ret = jpegenc_sw_next_band(p_pool, p_job)) != 0) {
+    if ((ret < 0) || (jpegenc_sw_stitch_bands(p_pool, p_job, p_out, 0) < 0)) {
+      p_job->error = 1;
+      p_job->next_band = (int32_t)p_job->num_bands;
+      return -1;
+    }
+  }
+  if (jpegenc_sw_stitch_bands(p_pool, p_job, p_out, 1) < 0) {
+    p_job->error = 1;
+    return -1;
+  }
+  return 0;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_encode
+* Parameters: p_pool, p_frame, p_config, p_app1, app1_len, p_out, p_abort
+* Return Value : 0 on success, -1 on failure or abort
+* Description: Encode one frame into p_out. The image is split into bands
+* of MCU rows which are separated by restart markers, so that each band
+* can be entropy coded by a different thread. p_app1 is a complete APP1
+* marker segment written after SOI, a JFIF header is written if NULL
+==============================================================================*/
+int jpegenc_sw_encode(jpegenc_sw_pool_t *p_pool, jpegenc_sw_frame_t *p_frame,
+  jpegenc_sw_config_t *p_config, uint8_t *p_app1, uint32_t app1_len,
+  jpegenc_sw_buf_t *p_out, volatile int *p_abort)
+{
+  jpegenc_sw_job_t job;
+  uint32_t crop_x, crop_y, crop_w, crop_h, scaled_w, scaled_h;
+  uint32_t width, height, pad_w, pad_h, max_rows, i, interval;
+  uint32_t cw, ch, cx, cy, cwidth, cheight;
+  uint8_t transpose, rev_x, rev_y;
+  uint32_t *p_maps = NULL;
+  int rc = -1;
+
+  memset(&job, 0, sizeof(job));
+  if (!p_frame->p_luma || !p_frame->width || !p_frame->height ||
+    p_frame->chroma_hshift > 1 || p_frame->chroma_vshift > 1) {
+    ALOGE("%s:%d] invalid frame", __func__, __LINE__);
+    return -1;
+  }
+
+  crop_x = p_config->crop_left;
+  crop_y = p_config->crop_top;
+  crop_w = p_config->crop_width ? p_config->crop_width : p_frame->width;
+  crop_h = p_config->crop_height ? p_config->crop_height : p_frame->height;
+  if ((crop_x + crop_w > p_frame->width) ||
+    (crop_y + crop_h > p_frame->height)) {
+    ALOGE("%s:%d] invalid crop %dx%d+%d+%d frame %dx%d", __func__, __LINE__,
+      crop_w, crop_h, crop_x, crop_y, p_frame->width, p_frame->height);
+    return -1;
+  }
+  scaled_w = p_config->out_width ? p_config->out_width : crop_w;
+  scaled_h = p_config->out_height ? p_config->out_height : crop_h;
+
+  transpose = (90 == p_config->rotation) || (270 == p_config->rotation);
+  width = transpose ? scaled_h : scaled_w;
+  height = transpose ? scaled_w : scaled_h;
+  if ((width > 65535) || (height > 65535)) {
+    ALOGE("%s:%d] output too large %dx%d", __func__, __LINE__,
+      width, height);
+    return -1;
+  }
+
+  job.p_frame = p_frame;
+  job.p_abort = p_abort;
+  job.num_comps = p_frame->p_chroma ? 3 : 1;
+  job.mcu_w = job.mcu_h = (job.num_comps > 1) ? 16 : 8;
+  job.mcus_per_row = (width + job.mcu_w - 1) / job.mcu_w;
+  job.mcu_rows = (height + job.mcu_h - 1) / job.mcu_h;
+  job.cb_off = p_frame->cr_first ? 1 : 0;
+  /* downscaling by 2 or more averages 2x2 input pixels */
+  job.box = (crop_w >= 2 * scaled_w) && (crop_h >= 2 * scaled_h) &&
+    (crop_w >= 4) && (crop_h >= 4);
+
+  /* split into bands, the restart interval is limited to 16 bits. A
+   * single thread only needs bands to stream the output */
+  job.num_bands = p_pool->num_threads * JPEGENC_SW_BANDS_PER_THREAD;
+  if ((1 == p_pool->num_threads) && (NULL == p_config->progress)) {
+    job.num_bands = 1;
+  }
+  if (job.num_bands > job.mcu_rows) {
+    job.num_bands = job.mcu_rows;
+  }
+  job.rows_per_band = (job.mcu_rows + job.num_bands - 1) / job.num_bands;
+  max_rows = 65535 / job.mcus_per_row;
+  if (job.rows_per_band > max_rows) {
+    job.rows_per_band = max_rows ? max_rows : 1;
+  }
+  job.num_bands = (job.mcu_rows + job.rows_per_band - 1) / job.rows_per_band;
+  interval = job.rows_per_band * job.mcus_per_row;
+  if ((job.num_bands > 1) && (interval > 65535)) {
+    ALOGE("%s:%d] restart interval too large", __func__, __LINE__);
+    return -1;
+  }
+
+  /* sample maps, one entry per padded output column/row */
+  pad_w = job.mcus_per_row * job.mcu_w;
+  pad_h = job.mcu_rows * job.mcu_h;
+  p_maps = malloc(sizeof(uint32_t) * (pad_w + pad_h) * 3 / 2 + 64);
+  if (NULL == p_maps) {
+    return -1;
+  }
+  job.p_lx = p_maps;
+  job.p_ly = job.p_lx + pad_w;
+  job.p_cx = job.p_ly + pad_h;
+  job.p_cy = job.p_cx + pad_w / 2;
+
+  /* with rotation the output columns walk the input rows and vice versa.
+   * rev_x/rev_y reverse the input column/row direction */
+  rev_x = (180 == p_config->rotation) || (270 == p_config->rotation);
+  rev_y = (90 == p_config->rotation) || (180 == p_config->rotation);
+  cx = crop_x >> p_frame->chroma_hshift;
+  cy = crop_y >> p_frame->chroma_vshift;
+  cw = (crop_w + (crop_x & p_frame->chroma_hshift)) >> p_frame->chroma_hshift;
+  ch = (crop_h + (crop_y & p_frame->chroma_vshift)) >> p_frame->chroma_vshift;
+  cwidth = (p_frame->width + p_frame->chroma_hshift) >>
+    p_frame->chroma_hshift;
+  cheight = (p_frame->height + p_frame->chroma_vshift) >>
+    p_frame->chroma_vshift;
+  if (cw < 1) {
+    cw = 1;
+  }
+  if (ch < 1) {
+    ch = 1;
+  }
+  job.box = job.box && (cw >= 2) && (ch >= 2);
+
+  if (!transpose) {
+    jpegenc_sw_build_map(job.p_lx, scaled_w, pad_w, crop_x, crop_w,
+      p_frame->width, 1, rev_x, job.box);
+    jpegenc_sw_build_map(job.p_ly, scaled_h, pad_h, crop_y, crop_h,
+      p_frame->height, p_frame->stride, rev_y, job.box);
+    jpegenc_sw_build_map(job.p_cx, (scaled_w + 1) / 2, pad_w / 2, cx, cw,
+      cwidth, 2, rev_x, job.box);
+    jpegenc_sw_build_map(job.p_cy, (scaled_h + 1) / 2, pad_h / 2, cy, ch,
+      cheight, p_frame->stride, rev_y, job.box);
+  } else {
+    jpegenc_sw_build_map(job.p_lx, scaled_h, pad_w, crop_y, crop_h,
+      p_frame->height, p_frame->stride, rev_y, job.box);
+    jpegenc_sw_build_map(job.p_ly, scaled_w, pad_h, crop_x, crop_w,
+      p_frame->width, 1, rev_x, job.box);
+    jpegenc_sw_build_map(job.p_cx, (scaled_h + 1) / 2, pad_w / 2, cy, ch,
+      cheight, p_frame->stride, rev_y, job.box);
+    jpegenc_sw_build_map(job.p_cy, (scaled_w + 1) / 2, pad_h / 2, cx, cw,
+      cwidth, 2, rev_x, job.box);
+  }
+  job.lstep[0] = 1;
+  job.lstep[1] = p_frame->stride;
+  job.cstep[0] = 2;
+  job.cstep[1] = p_frame->stride;
+
+  /* reciprocals in transposed DCT output order, including the AAN scale */
+  for (i = 0; i < DCTSIZE2; i++) {
+    uint32_t r = i % DCTSIZE, c = i / DCTSIZE;
+    float scale = aan_scale[r] * aan_scale[c] * 8.0f;
+    job.recip[0][i] = 1.0f / (p_config->qtable[0][r * DCTSIZE + c] * scale);
+    job.recip[1][i] = 1.0f / (p_config->qtable[1][r * DCTSIZE + c] * scale);
+  }
+
+  /* band buffers are kept in the pool across encodes */
+  if (p_pool->num_band_bufs < job.num_bands) {
+    jpegenc_sw_buf_t *p_bands = realloc(p_pool->p_bands,
+      job.num_bands * sizeof(jpegenc_sw_buf_t));
+    if (NULL == p_bands) {
+      goto end;
+    }
+    memset(p_bands + p_pool->num_band_bufs, 0,
+      (job.num_bands - p_pool->num_band_bufs) * sizeof(jpegenc_sw_buf_t));
+    p_pool->p_bands = p_bands;
+    p_pool->num_band_bufs = job.num_bands;
+  }
+
+  p_out->len = 0;
+  if (jpegenc_sw_write_headers(&job, p_config, width, height, p_app1,
+    app1_len, p_out) < 0) {
+    ALOGE("%s:%d] cannot write headers", __func__, __LINE__);
+    goto end;
+  }
+
+  if (p_config->progress) {
+    job.p_done = calloc(job.num_bands, sizeof(uint8_t));
+    if (NULL == job.p_done) {
+      goto end;
+    }
+    job.progress = p_config->progress;
+    job.p_progress_data = p_config->p_progress_data;
+    job.progress(job.p_progress_data, p_out->len);
+  }
+
+  /* post the job to the workers and take part in it */
+  pthread_mutex_lock(&p_pool->lock);
+  p_pool->p_job = &job;
+  p_pool->busy = p_pool->num_threads - 1;
+  p_pool->generation++;
+  pthread_cond_broadcast(&p_pool->work_cond);
+  pthread_mutex_unlock(&p_pool->lock);
+
+  if (job.p_done) {
+    rc = jpegenc_sw_stream_bands(p_pool, &job, p_out);
+  } else {
+    rc = jpegenc_sw_run_bands(p_pool, &job);
+  }
+
+  pthread_mutex_lock(&p_pool->lock);
+  while (p_pool->busy) {
+    pthread_cond_wait(&p_pool->done_cond, &p_pool->lock);
+  }
+  if (job.error) {
+    rc = -1;
+  }
+  p_pool->p_job = NULL;
+  pthread_mutex_unlock(&p_pool->lock);
+
+  if (rc < 0 || (p_abort && *p_abort)) {
+    rc = -1;
+    goto end;
+  }
+
+  /* stitch the bands together with RSTn markers, done as they finish
+   * when streaming */
+  for (i = job.stitched; i < job.num_bands; i++) {
+    if (jpegenc_sw_append_band(p_pool, &job, i, p_out) < 0) {
+      rc = -1;
+      goto end;
+    }
+  }
+  jpegenc_sw_put_marker(p_out, M_EOI, 0);
+
+end:
+  free(job.p_done);
+  free(p_maps);
+  return rc;
+}
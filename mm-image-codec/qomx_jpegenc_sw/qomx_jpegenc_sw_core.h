@@ -0,0 +1,131 @@
+/*Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+
+#ifndef QOMX_JPEGENC_SW_CORE_H
+#define QOMX_JPEGENC_SW_CORE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "OMX_Core.h"
+#include "QOMX_JpegExtensions.h"
+
+/* Maximum number of encoder worker threads */
+#define JPEGENC_SW_MAX_THREADS 8
+
+/* Number of restart interval bands handed out per worker thread.
+ * Having more bands than threads keeps all the cores busy when
+ * some bands turn out to be more expensive than others */
+#define JPEGENC_SW_BANDS_PER_THREAD 4
+
+/* Returned by jpegenc_sw_exif_build if the APP1 marker does not fit
+ * into the 64K segment limit */
+#define JPEGENC_SW_EXIF_TOO_BIG (-2)
+
+/** jpegenc_sw_buf_t: Growable output buffer
+*    @p_data: buffer address
+*    @size: allocated size
+*    @len: filled length
+*    @fixed: buffer is owned by the caller and cannot grow
+**/
+typedef struct {
+  uint8_t *p_data;
+  uint32_t size;
+  uint32_t len;
+  uint8_t fixed;
+} jpegenc_sw_buf_t;
+
+/** jpegenc_sw_frame_t: Semi planar input frame
+*    @p_luma: luma plane
+*    @p_chroma: interleaved chroma plane, NULL for monochrome
+*    @width: frame width
+*    @height: frame height
+*    @stride: luma and chroma stride in bytes
+*    @chroma_hshift: log2 of the horizontal chroma subsampling
+*    @chroma_vshift: log2 of the vertical chroma subsampling
+*    @cr_first: chroma plane is CrCb interleaved
+**/
+typedef struct {
+  uint8_t *p_luma;
+  uint8_t *p_chroma;
+  uint32_t width;
+  uint32_t height;
+  uint32_t stride;
+  uint32_t chroma_hshift;
+  uint32_t chroma_vshift;
+  uint8_t cr_first;
+} jpegenc_sw_frame_t;
+
+/* Streaming output callback, see jpegenc_sw_config_t */
+typedef void (*jpegenc_sw_progress_t)(void *p_data, uint32_t final_len);
+
+/** jpegenc_sw_config_t: Encode parameters
+*    @crop_left: crop window left offset, in input pixels
+*    @crop_top: crop window top offset, in input pixels
+*    @crop_width: crop window width, 0 for the full frame
+*    @crop_height: crop window height, 0 for the full frame
+*    @out_width: width of the scaled output before rotation,
+*              0 for the crop width
+*    @out_height: height of the scaled output before rotation,
+*              0 for the crop height
+*    @rotation: clockwise rotation, 0/90/180/270
+*    @qtable: luma and chroma quantization tables in natural order
+*    @progress: optional, called from the encoding thread every time more
+*              of the output is final. The bytes below final_len are not
+*              changed again by the encode, a growable output buffer may
+*              still move
+*    @p_progress_data: passed back to progress
+**/
+typedef struct {
+  uint32_t crop_left;
+  uint32_t crop_top;
+  uint32_t crop_width;
+  uint32_t crop_height;
+  uint32_t out_width;
+  uint32_t out_height;
+  uint32_t rotation;
+  uint8_t qtable[2][64];
+  jpegenc_sw_progress_t progress;
+  void *p_progress_data;
+} jpegenc_sw_config_t;
+
+/* Opaque worker pool, one per encoder instance */
+typedef struct jpegenc_sw_pool jpegenc_sw_pool_t;
+
+jpegenc_sw_pool_t *jpegenc_sw_pool_create(uint32_t num_threads);
+void jpegenc_sw_pool_destroy(jpegenc_sw_pool_t *p_pool);
+uint32_t jpegenc_sw_pool_threads(jpegenc_sw_pool_t *p_pool);
+void jpegenc_sw_set_quality(uint8_t qtable[2][64], uint32_t quality);
+int jpegenc_sw_encode(jpegenc_sw_pool_t *p_pool, jpegenc_sw_frame_t *p_frame,
+  jpegenc_sw_config_t *p_config, uint8_t *p_app1, uint32_t app1_len,
+  jpegenc_sw_buf_t *p_out, volatile int *p_abort);
+void jpegenc_sw_buf_release(jpegenc_sw_buf_t *p_buf);
+int jpegenc_sw_exif_build(QEXIF_INFO_DATA *p_tags, uint32_t num_tags,
+  uint32_t width, uint32_t height, uint8_t *p_thumb, uint32_t thumb_len,
+  jpegenc_sw_buf_t *p_app1);
+
+#endif
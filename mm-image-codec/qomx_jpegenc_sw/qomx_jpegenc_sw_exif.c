@@ -0,0 +1,465 @@
+/*Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+
+#define LOG_TAG "qomx_jpegenc_sw"
+#include <utils/Log.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include "qomx_jpegenc_sw_core.h"
+
+/* IFDs written into the APP1 marker */
+#define EXIF_IFD0 0
+#define EXIF_IFD_EXIF 1
+#define EXIF_IFD_GPS 2
+#define EXIF_IFD1 3
+#define EXIF_IFD_MAX 4
+
+/* Tags generated by the encoder */
+#define EXIF_EXTRA_TAGS 4
+
+#define TAG_COMPRESSION 0x0103
+#define TAG_JPEG_IF_OFFSET 0x0201
+#define TAG_JPEG_IF_LENGTH 0x0202
+#define TAG_EXIF_IFD 0x8769
+#define TAG_GPS_IFD 0x8825
+#define TAG_EXIF_VERSION 0x9000
+#define TAG_PIXEL_X 0xA002
+#define TAG_PIXEL_Y 0xA003
+#define TAG_INTEROP_IFD 0xA005
+
+/* APP1 marker, length and "Exif\0\0" precede the TIFF header */
+#define APP1_HEADER_SIZE 10
+
+/** jpegenc_sw_exif_entry_t: One IFD entry to be written
+*    @tag: TIFF tag
+*    @type: exif_tag_type_t
+*    @count: number of elements
+*    @p_data: element data in host order, NULL to use value
+*    @value: inline SHORT/LONG value of the generated tags
+**/
+typedef struct {
+  uint16_t tag;
+  uint16_t type;
+  uint32_t count;
+  const void *p_data;
+  uint32_t value;
+} jpegenc_sw_exif_entry_t;
+
+/** jpegenc_sw_exif_ifd_t: IFD being assembled
+*    @p_entries: entries sorted by tag
+*    @num_entries: number of entries
+*    @offset: offset of the IFD from the TIFF header
+*    @data_offset: offset of the values which do not fit inline
+**/
+typedef struct {
+  jpegenc_sw_exif_entry_t *p_entries;
+  uint32_t num_entries;
+  uint32_t offset;
+  uint32_t data_offset;
+} jpegenc_sw_exif_ifd_t;
+
+/*==============================================================================
+* Function : jpegenc_sw_exif_type_size
+* Parameters: type
+* Return Value : size of one element, 0 for unknown types
+* Description: Element size of the exif data type
+==============================================================================*/
+static uint32_t jpegenc_sw_exif_type_size(uint16_t type)
+{
+  switch (type) {
+  case EXIF_BYTE:
+  case EXIF_ASCII:
+  case EXIF_UNDEFINED:
+    return 1;
+  case EXIF_SHORT:
+    return 2;
+  case EXIF_LONG:
+  case EXIF_SLONG:
+    return 4;
+  case EXIF_RATIONAL:
+  case EXIF_SRATIONAL:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_exif_value_size
+* Parameters: p_entry
+* Return Value : size of the entry value in bytes
+* Description: Size of the value, values of up to 4 bytes are stored in
+* the IFD entry itself
+==============================================================================*/
+static uint32_t jpegenc_sw_exif_value_size(jpegenc_sw_exif_entry_t *p_entry)
+{
+  return jpegenc_sw_exif_type_size(p_entry->type) * p_entry->count;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_exif_add
+* Parameters: p_ifd, p_entry
+* Return Value : None
+* Description: Insert the entry keeping the IFD sorted by tag. An entry
+* with the same tag is replaced, so later values win
+==============================================================================*/
+static void jpegenc_sw_exif_add(jpegenc_sw_exif_ifd_t *p_ifd,
+  jpegenc_sw_exif_entry_t *p_entry)
+{
+  uint32_t i = 0;
+
+  while ((i < p_ifd->num_entries) && (p_ifd->p_entries[i].tag < p_entry->tag)) {
+    i++;
+  }
+  if ((i < p_ifd->num_entries) && (p_ifd->p_entries[i].tag == p_entry->tag)) {
+    p_ifd->p_entries[i] = *p_entry;
+    return;
+  }
+  memmove(&p_ifd->p_entries[i + 1], &p_ifd->p_entries[i],
+    (p_ifd->num_entries - i) * sizeof(jpegenc_sw_exif_entry_t));
+  p_ifd->p_entries[i] = *p_entry;
+  p_ifd->num_entries++;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_exif_find
+* Parameters: p_ifd, tag
+* Return Value : entry, NULL if not present
+* Description: Look up an entry by tag
+==============================================================================*/
+static jpegenc_sw_exif_entry_t *jpegenc_sw_exif_find(
+  jpegenc_sw_exif_ifd_t *p_ifd, uint16_t tag)
+{
+  uint32_t i;
+
+  for (i = 0; i < p_ifd->num_entries; i++) {
+    if (p_ifd->p_entries[i].tag == tag) {
+      return &p_ifd->p_entries[i];
+    }
+  }
+  return NULL;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_exif_add_value
+* Parameters: p_ifd, tag, type, value
+* Return Value : None
+* Description: Add a generated SHORT or LONG entry with a single value
+==============================================================================*/
+static void jpegenc_sw_exif_add_value(jpegenc_sw_exif_ifd_t *p_ifd,
+  uint16_t tag, uint16_t type, uint32_t value)
+{
+  jpegenc_sw_exif_entry_t entry;
+
+  memset(&entry, 0, sizeof(entry));
+  entry.tag = tag;
+  entry.type = type;
+  entry.count = 1;
+  entry.value = value;
+  jpegenc_sw_exif_add(p_ifd, &entry);
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_exif_ifd_of
+* Parameters: tag_id
+* Return Value : IFD index, -1 if the tag is generated by the encoder
+* Description: The IFD of a qexif tag is given by its offset in
+* exif_tag_offset_t
+==============================================================================*/
+static int jpegenc_sw_exif_ifd_of(exif_tag_id_t tag_id)
+{
+  uint32_t offset = tag_id >> 16;
+  uint16_t tag = tag_id & 0xFFFF;
+
+  switch (tag) {
+  case TAG_EXIF_IFD:
+  case TAG_GPS_IFD:
+  case TAG_INTEROP_IFD:
+  case TAG_JPEG_IF_OFFSET:
+  case TAG_JPEG_IF_LENGTH:
+  case TAG_PIXEL_X:
+  case TAG_PIXEL_Y:
+    return -1;
+  default:
+    break;
+  }
+
+  if (offset < NEW_SUBFILE_TYPE) {
+    return EXIF_IFD_GPS;
+  } else if (offset < TN_IMAGE_WIDTH) {
+    return EXIF_IFD0;
+  } else if (offset < EXPOSURE_TIME) {
+    /* IFD1 is generated from the encoded thumbnail */
+    return -1;
+  }
+  return EXIF_IFD_EXIF;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_exif_put16
+* Parameters: p, val
+* Return Value : None
+* Description: Store a 16 bit value in host byte order
+==============================================================================*/
+static inline void jpegenc_sw_exif_put16(uint8_t *p, uint16_t val)
+{
+  memcpy(p, &val, sizeof(val));
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_exif_put32
+* Parameters: p, val
+* Return Value : None
+* Description: Store a 32 bit value in host byte order
+==============================================================================*/
+static inline void jpegenc_sw_exif_put32(uint8_t *p, uint32_t val)
+{
+  memcpy(p, &val, sizeof(val));
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_exif_layout
+* Parameters: p_ifd, offset
+* Return Value : offset following the IFD and its data
+* Description: Assign the offsets of the IFD and its out of line values
+==============================================================================*/
+static uint32_t jpegenc_sw_exif_layout(jpegenc_sw_exif_ifd_t *p_ifd,
+  uint32_t offset)
+{
+  uint32_t i, size;
+
+  p_ifd->offset = offset;
+  p_ifd->data_offset = offset + 2 + 12 * p_ifd->num_entries + 4;
+  offset = p_ifd->data_offset;
+  for (i = 0; i < p_ifd->num_entries; i++) {
+    size = jpegenc_sw_exif_value_size(&p_ifd->p_entries[i]);
+    if (size > 4) {
+      offset += (size + 1) & ~1;
+    }
+  }
+  return offset;
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_exif_write_ifd
+* Parameters: p_tiff, p_ifd, next
+* Return Value : None
+* Description: Write the IFD entries and values. next is the offset of
+* the next IFD in the chain, 0 for the last one
+==============================================================================*/
+static void jpegenc_sw_exif_write_ifd(uint8_t *p_tiff,
+  jpegenc_sw_exif_ifd_t *p_ifd, uint32_t next)
+{
+  jpegenc_sw_exif_entry_t *p_entry;
+  uint8_t *p = p_tiff + p_ifd->offset;
+  uint32_t data_offset = p_ifd->data_offset;
+  uint32_t i, size;
+
+  jpegenc_sw_exif_put16(p, (uint16_t)p_ifd->num_entries);
+  p += 2;
+  for (i = 0; i < p_ifd->num_entries; i++, p += 12) {
+    p_entry = &p_ifd->p_entries[i];
+    size = jpegenc_sw_exif_value_size(p_entry);
+    jpegenc_sw_exif_put16(p, p_entry->tag);
+    jpegenc_sw_exif_put16(p + 2, p_entry->type);
+    jpegenc_sw_exif_put32(p + 4, p_entry->count);
+    memset(p + 8, 0, 4);
+    if (NULL == p_entry->p_data) {
+      if (EXIF_SHORT == p_entry->type) {
+        jpegenc_sw_exif_put16(p + 8, (uint16_t)p_entry->value);
+      } else {
+        jpegenc_sw_exif_put32(p + 8, p_entry->value);
+      }
+    } else if (size <= 4) {
+      memcpy(p + 8, p_entry->p_data, size);
+    } else {
+      jpegenc_sw_exif_put32(p + 8, data_offset);
+      memcpy(p_tiff + data_offset, p_entry->p_data, size);
+      if (size & 1) {
+        p_tiff[data_offset + size] = 0;
+      }
+      data_offset += (size + 1) & ~1;
+    }
+  }
+  jpegenc_sw_exif_put32(p, next);
+}
+
+/*==============================================================================
+* Function : jpegenc_sw_exif_build
+* Parameters: p_tags, num_tags, width, height, p_thumb, thumb_len, p_app1
+* Return Value : 0 on success, JPEGENC_SW_EXIF_TOO_BIG if the marker does
+* not fit in 64K, -1 on other failures
+* Description: Build the complete APP1 marker segment from the client tags.
+* The pointer tags, the pixel dimensions and IFD1 for the thumbnail are
+* generated here. Values are stored in host byte order with the matching
+* TIFF byte order mark
+==============================================================================*/
+int jpegenc_sw_exif_build(QEXIF_INFO_DATA *p_tags, uint32_t num_tags,
+  uint32_t width, uint32_t height, uint8_t *p_thumb, uint32_t thumb_len,
+  jpegenc_sw_buf_t *p_app1)
+{
+  static const uint8_t exif_version[4] = { '0', '2', '2', '0' };
+  static const uint8_t exif_header[6] = { 'E', 'x', 'i', 'f', 0, 0 };
+  jpegenc_sw_exif_ifd_t ifd[EXIF_IFD_MAX];
+  jpegenc_sw_exif_entry_t *p_entries, entry;
+  exif_tag_entry_t *p_tag;
+  uint32_t i, offset, thumb_offset = 0, total;
+  uint8_t *p_tiff;
+  uint8_t *p_data;
+  int idx, rc = 0;
+
+  p_entries = calloc((num_tags + EXIF_EXTRA_TAGS) * EXIF_IFD_MAX,
+    sizeof(jpegenc_sw_exif_entry_t));
+  if (NULL == p_entries) {
+    return -1;
+  }
+  memset(ifd, 0, sizeof(ifd));
+  for (i = 0; i < EXIF_IFD_MAX; i++) {
+    ifd[i].p_entries = p_entries + i * (num_tags + EXIF_EXTRA_TAGS);
+  }
+
+  for (i = 0; i < num_tags; i++) {
+    p_tag = &p_tags[i].tag_entry;
+    idx = jpegenc_sw_exif_ifd_of(p_tags[i].tag_id);
+    if ((idx < 0) || (0 == p_tag->count) ||
+      (0 == jpegenc_sw_exif_type_size(p_tag->type))) {
+      continue;
+    }
+    memset(&entry, 0, sizeof(entry));
+    entry.tag = (uint16_t)(p_tags[i].tag_id & 0xFFFF);
+    entry.type = (uint16_t)p_tag->type;
+    entry.count = p_tag->count;
+    if ((EXIF_ASCII == p_tag->type) || (EXIF_UNDEFINED == p_tag->type) ||
+      (p_tag->count > 1)) {
+      entry.p_data = p_tag->data._bytes;
+    } else {
+      entry.p_data = &p_tag->data;
+    }
+    if (NULL == entry.p_data) {
+      continue;
+    }
+    jpegenc_sw_exif_add(&ifd[idx], &entry);
+  }
+
+  jpegenc_sw_exif_add_value(&ifd[EXIF_IFD_EXIF], TAG_PIXEL_X, EXIF_LONG,
+    width);
+  jpegenc_sw_exif_add_value(&ifd[EXIF_IFD_EXIF], TAG_PIXEL_Y, EXIF_LONG,
+    height);
+  if (!jpegenc_sw_exif_find(&ifd[EXIF_IFD_EXIF], TAG_EXIF_VERSION)) {
+    memset(&entry, 0, sizeof(entry));
+    entry.tag = TAG_EXIF_VERSION;
+    entry.type = EXIF_UNDEFINED;
+    entry.count = sizeof(exif_version);
+    entry.p_data = exif_version;
+    jpegenc_sw_exif_add(&ifd[EXIF_IFD_EXIF], &entry);
+  }
+  jpegenc_sw_exif_add_value(&ifd[EXIF_IFD0], TAG_EXIF_IFD, EXIF_LONG, 0);
+  if (ifd[EXIF_IFD_GPS].num_entries) {
+    jpegenc_sw_exif_add_value(&ifd[EXIF_IFD0], TAG_GPS_IFD, EXIF_LONG, 0);
+  }
+  if (p_thumb && thumb_len) {
+    jpegenc_sw_exif_add_value(&ifd[EXIF_IFD1], TAG_COMPRESSION, EXIF_SHORT, 6);
+    jpegenc_sw_exif_add_value(&ifd[EXIF_IFD1], TAG_JPEG_IF_OFFSET,
+      EXIF_LONG, 0);
+    jpegenc_sw_exif_add_value(&ifd[EXIF_IFD1], TAG_JPEG_IF_LENGTH,
+      EXIF_LONG, thumb_len);
+  }
+
+  /* TIFF header, then IFD0, Exif, GPS and IFD1 each followed by its data */
+  offset = 8;
+  for (i = 0; i < EXIF_IFD_MAX; i++) {
+    if (ifd[i].num_entries) {
+      offset = jpegenc_sw_exif_layout(&ifd[i], offset);
+    }
+  }
+  if (ifd[EXIF_IFD1].num_entries) {
+    thumb_offset = offset;
+    offset += thumb_len;
+  }
+  total = APP1_HEADER_SIZE + offset;
+  if (total - 2 > 0xFFFF) {
+    ALOGE("%s:%d] exif size %d exceeds APP1 limit", __func__, __LINE__,
+      total);
+    rc = p_thumb ? JPEGENC_SW_EXIF_TOO_BIG : -1;
+    goto end;
+  }
+
+  jpegenc_sw_exif_find(&ifd[EXIF_IFD0], TAG_EXIF_IFD)->value =
+    ifd[EXIF_IFD_EXIF].offset;
+  if (ifd[EXIF_IFD_GPS].num_entries) {
+    jpegenc_sw_exif_find(&ifd[EXIF_IFD0], TAG_GPS_IFD)->value =
+      ifd[EXIF_IFD_GPS].offset;
+  }
+  if (ifd[EXIF_IFD1].num_entries) {
+    jpegenc_sw_exif_find(&ifd[EXIF_IFD1], TAG_JPEG_IF_OFFSET)->value =
+      thumb_offset;
+  }
+
+  if (p_app1->size < total) {
+    p_data = realloc(p_app1->p_data, total);
+    if (NULL == p_data) {
+      rc = -1;
+      goto end;
+    }
+    p_app1->p_data = p_data;
+    p_app1->size = total;
+  }
+  p_data = p_app1->p_data;
+  memset(p_data, 0, total);
+  p_data[0] = 0xFF;
+  p_data[1] = 0xE1;
+  p_data[2] = (uint8_t)((total - 2) >> 8);
+  p_data[3] = (uint8_t)((total - 2) & 0xFF);
+  memcpy(p_data + 4, exif_header, sizeof(exif_header));
+
+  p_tiff = p_data + APP1_HEADER_SIZE;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  p_tiff[0] = p_tiff[1] = 'M';
+#else
+  p_tiff[0] = p_tiff[1] = 'I';
+#endif
+  jpegenc_sw_exif_put16(p_tiff + 2, 0x002A);
+  jpegenc_sw_exif_put32(p_tiff + 4, 8);
+
+  jpegenc_sw_exif_write_ifd(p_tiff, &ifd[EXIF_IFD0],
+    ifd[EXIF_IFD1].num_entries ? ifd[EXIF_IFD1].offset : 0);
+  jpegenc_sw_exif_write_ifd(p_tiff, &ifd[EXIF_IFD_EXIF], 0);
+  if (ifd[EXIF_IFD_GPS].num_entries) {
+    jpegenc_sw_exif_write_ifd(p_tiff, &ifd[EXIF_IFD_GPS], 0);
+  }
+  if (ifd[EXIF_IFD1].num_entries) {
+    jpegenc_sw_exif_write_ifd(p_tiff, &ifd[EXIF_IFD1], 0);
+    memcpy(p_tiff + thumb_offset, p_thumb, thumb_len);
+  }
+  p_app1->len = total;
+
+end:
+  free(p_entries);
+  return rc;
+}
@@ -0,0 +1,403 @@
+/*Copyright (c) 2014, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above
+      copyright notice, this list of conditions and the following
+      disclaimer in the documentation and/or other materials provided
+      with the distribution.
+    * Neither the name of The Linux Foundation nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "qomx_jpegenc_sw_core.h"
+
+#define BENCH_MAX_SIZES 3
+
+/** bench_size_t: Benchmark resolution
+*    @width: frame width
+*    @height: frame height
+*    @name: label printed in the report
+**/
+typedef struct {
+  uint32_t width;
+  uint32_t height;
+  const char *name;
+} bench_size_t;
+
+/** bench_stream_t: Streaming output check
+*    @p_out: output buffer of the encode
+*    @p_copy: copy of the bytes reported final
+*    @copy_size: allocated size of p_copy
+*    @final_len: last length reported final
+*    @chunks: number of progress calls
+*    @start_us: start of the encode
+*    @first_us: time the first scan data was final
+*    @error: a progress call went backwards or p_copy could not grow
+**/
+typedef struct {
+  jpegenc_sw_buf_t *p_out;
+  uint8_t *p_copy;
+  uint32_t copy_size;
+  uint32_t final_len;
+  uint32_t chunks;
+  uint64_t start_us;
+  uint64_t first_us;
+  int error;
+} bench_stream_t;
+
+/* 8, 13 and 16 MP sensors */
+static const bench_size_t g_sizes[BENCH_MAX_SIZES] = {
+  { 3264, 2448, "8MP" },
+  { 4208, 3120, "13MP" },
+  { 4608, 3456, "16MP" },
+};
+
+/*==============================================================================
+* Function : bench_now_us
+* Parameters: None
+* Return Value : current time in microseconds
+* Description: Monotonic enough wall clock for the measurements
+==============================================================================*/
+static uint64_t bench_now_us(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/*==============================================================================
+* Function : bench_fill_frame
+* Parameters: p_buf, width, height
+* Return Value : None
+* Description: Fill an NV21 frame with a mix of gradients, edges and
+* noise so that the entropy coder sees camera like content
+==============================================================================*/
+static void bench_fill_frame(uint8_t *p_buf, uint32_t width, uint32_t height)
+{
+  uint8_t *p_chroma = p_buf + width * height;
+  uint32_t x, y, seed = 0x1234567;
+
+  for (y = 0; y < height; y++) {
+    for (x = 0; x < width; x++) {
+      seed = seed * 1103515245 + 12345;
+      p_buf[y * width + x] = (uint8_t)(((x * 255) / width + (y & 0x40) +
+        ((x / 64 + y / 64) & 1) * 32 + ((seed >> 16) & 0xF)) & 0xFF);
+    }
+  }
+  for (y = 0; y < height / 2; y++) {
+    for (x = 0; x < width / 2; x++) {
+      p_chroma[y * width + 2 * x] = (uint8_t)(96 + (x * 64) / width);
+      p_chroma[y * width + 2 * x + 1] = (uint8_t)(160 - (y * 64) / height);
+    }
+  }
+}
+
+/*==============================================================================
+* Function : bench_stream_progress
+* Parameters: data - stream check, final_len - bytes reported final
+* Return Value : None
+* Description: Keep a copy of the bytes reported final, as a client
+* writing them out would
+==============================================================================*/
+static void bench_stream_progress(void *data, uint32_t final_len)
+{
+  bench_stream_t *p_stream = (bench_stream_t *)data;
+  uint8_t *p_copy;
+
+  /* the first call covers the headers only */
+  if (1 == p_stream->chunks) {
+    p_stream->first_us = bench_now_us();
+  }
+  p_stream->chunks++;
+  if (final_len <= p_stream->final_len) {
+    p_stream->error = 1;
+    return;
+  }
+  if (final_len > p_stream->copy_size) {
+    p_copy = realloc(p_stream->p_copy, final_len * 2);
+    if (NULL == p_copy) {
+      p_stream->error = 1;
+      return;
+    }
+    p_stream->p_copy = p_copy;
+    p_stream->copy_size = final_len * 2;
+  }
+  memcpy(p_stream->p_copy + p_stream->final_len,
+    p_stream->p_out->p_data + p_stream->final_len,
+    final_len - p_stream->final_len);
+  p_stream->final_len = final_len;
+}
+
+/*==============================================================================
+* Function : bench_stream_check
+* Parameters: p_pool, p_frame, p_config, p_ref, p_name
+* Return Value : 0 on success, -1 on failure
+* Description: Encode with streaming output. Every byte reported final
+* must match the finished image, the scan data must come in more than
+* one chunk with the first one well before the end, and with more than one
+* thread the bands are the same as without streaming, so the image must
+* be identical to p_ref
+==============================================================================*/
+static int bench_stream_check(jpegenc_sw_pool_t *p_pool,
+  jpegenc_sw_frame_t *p_frame, jpegenc_sw_config_t *p_config,
+  jpegenc_sw_buf_t *p_ref, const char *p_name)
+{
+  jpegenc_sw_config_t config = *p_config;
+  jpegenc_sw_buf_t out;
+  bench_stream_t stream;
+  uint64_t total_us;
+  int rc = 0;
+
+  memset(&out, 0, sizeof(out));
+  memset(&stream, 0, sizeof(stream));
+  stream.p_out = &out;
+  config.progress = bench_stream_progress;
+  config.p_progress_data = &stream;
+
+  stream.start_us = bench_now_us();
+  if (jpegenc_sw_encode(p_pool, p_frame, &config, NULL, 0, &out, NULL)) {
+    fprintf(stderr, "Streaming encode failed\n");
+    rc = -1;
+    goto end;
+  }
+  total_us = bench_now_us() - stream.start_us;
+
+  if (stream.error || (stream.chunks < 3) || (stream.final_len > out.len) ||
+    memcmp(stream.p_copy, out.p_data, stream.final_len)) {
+    fprintf(stderr, "%s: streamed output does not match the image, "
+      "%d chunks, %d of %d bytes\n", p_name, stream.chunks,
+      stream.final_len, out.len);
+    rc = -1;
+  } else if ((jpegenc_sw_pool_threads(p_pool) > 1) &&
+    ((out.len != p_ref->len) || memcmp(out.p_data, p_ref->p_data, out.len))) {
+    fprintf(stderr, "%s: streamed image differs from the plain encode\n",
+      p_name);
+    rc = -1;
+  } else if (stream.first_us - stream.start_us >= total_us / 2) {
+    fprintf(stderr, "%s: first scan data only after %llu of %llu us\n",
+      p_name,
+      (unsigned long long)(stream.first_us - stream.start_us),
+      (unsigned long long)total_us);
+    rc = -1;
+  }
+  fprintf(stderr, "%-6s streaming %d chunks, first data %7.2f ms, "
+    "last %d of %d bytes at %7.2f ms\n", p_name, stream.chunks,
+    (stream.first_us - stream.start_us) / 1000.0, stream.final_len,
+    out.len, total_us / 1000.0);
+
+end:
+  free(stream.p_copy);
+  jpegenc_sw_buf_release(&out);
+  return rc;
+}
+
+/*==============================================================================
+* Function : bench_usage
+* Parameters: None
+* Return Value : None
+* Description: Print the options
+==============================================================================*/
+static void bench_usage(void)
+{
+  fprintf(stderr, "Usage: qomx-jpegenc-sw-bench [options]\n");
+  fprintf(stderr, "  -I FILE\t\tNV21 input file, requires -W and -H\n");
+  fprintf(stderr, "  -W WIDTH\t\tInput width\n");
+  fprintf(stderr, "  -H HEIGHT\t\tInput height\n");
+  fprintf(stderr, "  -O FILE\t\tDump the last encoded image\n");
+  fprintf(stderr, "  -Q QUALITY\t\tJPEG quality (default 85)\n");
+  fprintf(stderr, "  -n COUNT\t\tEncodes per measurement (default 5)\n");
+  fprintf(stderr, "  -t THREADS\t\tMaximum thread count (default all cores)\n");
+  fprintf(stderr, "  -r ROTATION\t\tRotation 0/90/180/270\n");
+  fprintf(stderr, "Without -I the 8, 13 and 16 MP synthetic frames are used\n");
+}
+
+/*==============================================================================
+* Function : bench_run
+* Parameters: p_frame, p_config, num_threads, count, p_out, p_name
+* Return Value : 0 on success, -1 on failure
+* Description: Encode the frame count times with num_threads threads and
+* print the average time and throughput, then check the streaming output
+==============================================================================*/
+static int bench_run(jpegenc_sw_frame_t *p_frame,
+  jpegenc_sw_config_t *p_config, uint32_t num_threads, uint32_t count,
+  jpegenc_sw_buf_t *p_out, const char *p_name)
+{
+  jpegenc_sw_pool_t *p_pool;
+  uint64_t start, total = 0, best = (uint64_t)-1, t;
+  uint32_t i;
+  int rc;
+  double mp = (double)p_frame->width * p_frame->height / 1000000.0;
+
+  p_pool = jpegenc_sw_pool_create(num_threads);
+  if (NULL == p_pool) {
+    fprintf(stderr, "Cannot create worker pool\n");
+    return -1;
+  }
+
+  /* warm up, sizes the band buffers */
+  if (jpegenc_sw_encode(p_pool, p_frame, p_config, NULL, 0, p_out, NULL)) {
+    fprintf(stderr, "Encode failed\n");
+    jpegenc_sw_pool_destroy(p_pool);
+    return -1;
+  }
+
+  for (i = 0; i < count; i++) {
+    start = bench_now_us();
+    jpegenc_sw_encode(p_pool, p_frame, p_config, NULL, 0, p_out, NULL);
+    t = bench_now_us() - start;
+    total += t;
+    if (t < best) {
+      best = t;
+    }
+  }
+  fprintf(stderr, "%-6s %4dx%-4d threads %d avg %7.2f ms best %7.2f ms "
+    "%6.1f MP/s size %d\n", p_name, p_frame->width, p_frame->height,
+    jpegenc_sw_pool_threads(p_pool), total / 1000.0 / count,
+    best / 1000.0, mp * 1000000.0 / ((double)total / count), p_out->len);
+  rc = bench_stream_check(p_pool, p_frame, p_config, p_out, p_name);
+  jpegenc_sw_pool_destroy(p_pool);
+  return rc;
+}
+
+int main(int argc, char **argv)
+{
+  jpegenc_sw_config_t config;
+  jpegenc_sw_frame_t frame;
+  jpegenc_sw_buf_t out;
+  bench_size_t sizes[BENCH_MAX_SIZES];
+  uint32_t num_sizes = BENCH_MAX_SIZES, max_threads = 0, count = 5;
+  uint32_t quality = 85, i, t;
+  char *in_file = NULL, *out_file = NULL;
+  uint8_t *p_buf;
+  long cores;
+  FILE *fp;
+  int c, rc = 0;
+
+  memset(&config, 0, sizeof(config));
+  memset(&out, 0, sizeof(out));
+  memcpy(sizes, g_sizes, sizeof(sizes));
+
+  while ((c = getopt(argc, argv, "I:O:W:H:Q:n:t:r:")) != -1) {
+    switch (c) {
+    case 'I':
+      in_file = optarg;
+      break;
+    case 'O':
+      out_file = optarg;
+      break;
+    case 'W':
+      sizes[0].width = atoi(optarg);
+      break;
+    case 'H':
+      sizes[0].height = atoi(optarg);
+      break;
+    case 'Q':
+      quality = atoi(optarg);
+      break;
+    case 'n':
+      count = atoi(optarg);
+      break;
+    case 't':
+      max_threads = atoi(optarg);
+      break;
+    case 'r':
+      config.rotation = atoi(optarg);
+      break;
+    default:
+      bench_usage();
+      return 1;
+    }
+  }
+  if (in_file) {
+    sizes[0].name = "file";
+    num_sizes = 1;
+  }
+  if (0 == max_threads) {
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+    max_threads = (cores > 0) ? (uint32_t)cores : 1;
+  }
+  if (max_threads > JPEGENC_SW_MAX_THREADS) {
+    max_threads = JPEGENC_SW_MAX_THREADS;
+  }
+  if (0 == count) {
+    count = 1;
+  }
+  jpegenc_sw_set_quality(config.qtable, quality);
+
+  for (i = 0; i < num_sizes; i++) {
+    p_buf = malloc(sizes[i].width * sizes[i].height * 3 / 2);
+    if (NULL == p_buf) {
+      fprintf(stderr, "Cannot allocate %dx%d frame\n", sizes[i].width,
+        sizes[i].height);
+      rc = 1;
+      break;
+    }
+    if (in_file) {
+      fp = fopen(in_file, "rb");
+      if (!fp || fread(p_buf, 1, sizes[i].width * sizes[i].height * 3 / 2,
+        fp) != sizes[i].width * sizes[i].height * 3 / 2) {
+        fprintf(stderr, "Cannot read %s\n", in_file);
+        if (fp) {
+          fclose(fp);
+        }
+        free(p_buf);
+        rc = 1;
+        break;
+      }
+      fclose(fp);
+    } else {
+      bench_fill_frame(p_buf, sizes[i].width, sizes[i].height);
+    }
+
+    memset(&frame, 0, sizeof(frame));
+    frame.p_luma = p_buf;
+    frame.p_chroma = p_buf + sizes[i].width * sizes[i].height;
+    frame.width = sizes[i].width;
+    frame.height = sizes[i].height;
+    frame.stride = sizes[i].width;
+    frame.chroma_hshift = frame.chroma_vshift = 1;
+    frame.cr_first = 1;
+
+    /* 1, 2, 4 ... threads and the maximum */
+    for (t = 1; t <= max_threads; t = (t * 2 > max_threads && t != max_threads)
+      ? max_threads : t * 2) {
+      if (bench_run(&frame, &config, t, count, &out, sizes[i].name) < 0) {
+        rc = 1;
+        break;
+      }
+    }
+    free(p_buf);
+  }
+
+  if (out_file && out.len) {
+    fp = fopen(out_file, "wb");
+    if (fp) {
+      fwrite(out.p_data, 1, out.len, fp);
+      fclose(fp);
+    }
+  }
+  jpegenc_sw_buf_release(&out);
+  return rc;
+}